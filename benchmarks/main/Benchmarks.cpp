@@ -0,0 +1,435 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <esp_cpu.h>
+
+#include "LoraMesher.h"
+
+namespace {
+
+// Operations measured by benchmark and task
+constexpr size_t SAMPLES = 200;
+constexpr size_t MAX_SAMPLES = 2 * SAMPLES;
+
+const size_t LIST_SIZES[] = {16, 64, 256};
+const size_t TABLE_SIZES[] = {16, 64, 256};
+const size_t QUEUE_SIZES[] = {16, 64};
+
+constexpr size_t MAX_LIST_SIZE = 256;
+constexpr size_t NEIGHBORS = 8;
+constexpr uint16_t NEIGHBOR_ADDRESS = 0x0A00;
+constexpr uint16_t REMOTE_ADDRESS = 0x1000;
+constexpr uint8_t DATA_PAYLOAD_SIZE = 32;
+
+// Cycles of an empty measurement, subtracted from every sample
+uint32_t overhead = 0;
+size_t benchmarksNum = 0;
+
+uint32_t randomState = 0x2545F491;
+
+uint32_t nextRandom() {
+    // xorshift32, the same sequence on every platform
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+class Samples {
+public:
+    void clear() { length = 0; }
+
+    void add(uint32_t cycles) {
+        if (length < MAX_SAMPLES)
+            samples[length++] = cycles > overhead ? cycles - overhead : 0;
+    }
+
+    void addAll(const Samples& other) {
+        for (size_t i = 0; i < other.length; i++)
+            if (length < MAX_SAMPLES)
+                samples[length++] = other.samples[i];
+    }
+
+    uint32_t min() {
+        return length > 0 ? *std::min_element(samples, samples + length) : 0;
+    }
+
+    void report(const char* name, size_t size) {
+        if (length == 0)
+            return;
+
+        std::sort(samples, samples + length);
+        printf("LM_BENCH,%s,%u,%u,%u,%u,%u,%u\n", name, (unsigned) size, (unsigned) length, (unsigned) samples[0],
+            (unsigned) samples[length / 2], (unsigned) samples[length * 9 / 10], (unsigned) samples[length - 1]);
+        benchmarksNum++;
+        clear();
+    }
+
+private:
+    uint32_t samples[MAX_SAMPLES];
+    size_t length = 0;
+};
+
+// Static, the task stacks are small
+Samples samples;
+Samples contendedSamples[2];
+
+template <typename F>
+inline void measure(Samples& out, F&& operation) {
+    esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+    operation();
+    out.add(esp_cpu_get_cycle_count() - start);
+}
+
+void calibrate() {
+    overhead = 0;
+    for (size_t i = 0; i < SAMPLES; i++)
+        measure(samples, []() {});
+
+    overhead = samples.min();
+    samples.clear();
+}
+
+void releasePacket(void* p) {
+    PacketPoolService::release(p);
+}
+
+/**
+ * @brief LM_LinkedList operations with the list at a constant size
+ *
+ */
+void benchLinkedList(size_t size) {
+    static uint32_t values[MAX_LIST_SIZE + 1];
+    LM_LinkedList<uint32_t> list;
+
+    for (size_t i = 0; i < size; i++)
+        list.Append(&values[i]);
+
+    // Element out of the list, the append and pop benchmarks rotate the elements
+    uint32_t* spare = &values[size];
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        measure(samples, [&]() { list.Append(spare); });
+        spare = list.Pop();
+    }
+    samples.report("linked_list_append", size);
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        measure(samples, [&]() { spare = list.Pop(); });
+        list.Append(spare);
+    }
+    samples.report("linked_list_pop", size);
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        uint32_t* target = list[nextRandom() % size];
+        measure(samples, [&]() { list.Search(target); });
+    }
+    samples.report("linked_list_search", size);
+
+    volatile uint32_t sink = 0;
+    for (size_t i = 0; i < SAMPLES; i++) {
+        measure(samples, [&]() {
+            list.setInUseShared();
+            uint32_t sum = 0;
+            for (uint32_t* value : list)
+                sum += *value;
+            list.releaseInUseShared();
+            sink = sum;
+        });
+    }
+    (void) sink;
+    samples.report("linked_list_iterate", size);
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        measure(samples, [&]() {
+            list.setInUse();
+            list.releaseInUse();
+        });
+    }
+    samples.report("linked_list_lock", size);
+
+    list.Clear();
+}
+
+uint16_t neighborAddress(size_t i) {
+    return NEIGHBOR_ADDRESS + (uint16_t) i;
+}
+
+uint16_t remoteAddress(size_t i) {
+    return REMOTE_ADDRESS + (uint16_t) i;
+}
+
+/**
+ * @brief Process the HELLO packets of a neighbor advertising the nodes, as many packets as needed
+ *
+ */
+void processHello(uint16_t neighbor, NetworkNode* nodes, size_t numOfNodes) {
+    size_t start = 0;
+    size_t inPacket = 0;
+
+    do {
+        RoutePacket* p = PacketService::createRoutingPacket(neighbor, nodes + start, numOfNodes - start, 0, 0, 0, inPacket);
+        RoutingTableService::processRoute(p, 10);
+        releasePacket(p);
+        start += inPacket;
+    } while (start < numOfNodes && inPacket > 0);
+}
+
+size_t getNeighborsNum(size_t size) {
+    return std::min(NEIGHBORS, size);
+}
+
+/**
+ * @brief Fill the routing table with the given number of routes: NEIGHBORS neighbors that advertise the remote nodes
+ *
+ */
+void fillRoutingTable(size_t size) {
+    static NetworkNode advertised[RTMAXSIZE];
+
+    size_t neighbors = getNeighborsNum(size);
+    for (size_t n = 0; n < neighbors; n++) {
+        size_t numOfNodes = 0;
+        for (size_t i = n; i < size - neighbors; i += neighbors)
+            advertised[numOfNodes++] = NetworkNode(remoteAddress(i), 1, 0);
+
+        processHello(neighborAddress(n), advertised, numOfNodes);
+    }
+
+    if (RoutingTableService::routingTableSize() != size)
+        printf("# Routing table with %u routes instead of %u\n", (unsigned) RoutingTableService::routingTableSize(), (unsigned) size);
+}
+
+void clearRoutingTable(size_t size) {
+    size_t neighbors = getNeighborsNum(size);
+    for (size_t i = 0; i < size - neighbors; i++)
+        RoutingTableService::removeNode(remoteAddress(i));
+
+    for (size_t n = 0; n < neighbors; n++)
+        RoutingTableService::removeNode(neighborAddress(n));
+}
+
+/**
+ * @brief A known route of the table, a neighbor or a remote node
+ *
+ */
+uint16_t randomRoute(size_t size) {
+    size_t neighbors = getNeighborsNum(size);
+    size_t i = nextRandom() % size;
+    return i < neighbors ? neighborAddress(i) : remoteAddress(i - neighbors);
+}
+
+void benchRoutingTable(size_t size) {
+    fillRoutingTable(size);
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        uint16_t address = randomRoute(size);
+        measure(samples, [&]() { RoutingTableService::findNode(address); });
+    }
+    samples.report("routing_find_node", size);
+
+    for (size_t i = 0; i < SAMPLES; i++)
+        measure(samples, []() { RoutingTableService::findNode(0x7FFF); });
+    samples.report("routing_find_node_miss", size);
+
+    // A periodic HELLO of the first neighbor, the routes are already known
+    static NetworkNode advertised[RTMAXSIZE];
+    size_t neighbors = getNeighborsNum(size);
+    size_t numOfNodes = 0;
+    for (size_t i = 0; i < size - neighbors; i += neighbors)
+        advertised[numOfNodes++] = NetworkNode(remoteAddress(i), 1, 0);
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        size_t inPacket;
+        RoutePacket* p = PacketService::createRoutingPacket(neighborAddress(0), advertised, numOfNodes, 0, 0, 0, inPacket);
+        measure(samples, [&]() { RoutingTableService::processRoute(p, 10); });
+        releasePacket(p);
+    }
+    samples.report("routing_process_route", size);
+
+    // The HELLO packets of the whole table, as sendRoutingPackets does
+    RoutingTableService::setDeltaAdvertisement(false);
+
+    static RoutePacket* packets[RTMAXSIZE];
+    for (size_t i = 0; i < SAMPLES; i++) {
+        size_t packetsNum = 0;
+
+        measure(samples, [&]() {
+            size_t numOfNodes;
+            uint8_t routeFlags, tableVersion;
+            NetworkNode* nodes = RoutingTableService::getNextAdvertisement(numOfNodes, routeFlags, tableVersion);
+
+            size_t start = 0;
+            size_t inPacket;
+            do {
+                packets[packetsNum++] = PacketService::createRoutingPacket(0x0001, &nodes[start], numOfNodes - start, 0,
+                    routeFlags, tableVersion, inPacket);
+                start += inPacket;
+            } while (start < numOfNodes && inPacket > 0);
+
+            if (numOfNodes > 0)
+                delete[] nodes;
+        });
+
+        for (size_t p = 0; p < packetsNum; p++)
+            releasePacket(packets[p]);
+    }
+    samples.report("hello_serialise", size);
+
+    clearRoutingTable(size);
+}
+
+void benchPackets() {
+    uint8_t payload[DATA_PAYLOAD_SIZE];
+    for (size_t i = 0; i < sizeof(payload); i++)
+        payload[i] = (uint8_t) i;
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        DataPacket* p = nullptr;
+        measure(samples, [&]() { p = PacketService::createDataPacket(0x0002, 0x0001, DATA_P, payload, sizeof(payload)); });
+        releasePacket(p);
+    }
+    samples.report("packet_create_data", DATA_PAYLOAD_SIZE);
+
+    DataPacket* original = PacketService::createDataPacket(0x0002, 0x0001, DATA_P, payload, sizeof(payload));
+    for (size_t i = 0; i < SAMPLES; i++) {
+        Packet<uint8_t>* copy = nullptr;
+        measure(samples, [&]() { copy = PacketService::copyPacket(original, original->packetSize); });
+        releasePacket(copy);
+    }
+    samples.report("packet_copy", DATA_PAYLOAD_SIZE);
+    releasePacket(original);
+}
+
+typedef LM_PriorityQueue<QueuePacket<Packet<uint8_t>>> SendQueue;
+
+QueuePacket<Packet<uint8_t>>* createSendPacket() {
+    uint8_t payload[DATA_PAYLOAD_SIZE] = {0};
+
+    // Different flows and priorities, like the forwarded packets
+    uint16_t dst = 0x0100 + (uint16_t) (nextRandom() % 8);
+    DataPacket* p = PacketService::createDataPacket(dst, 0x0001, DATA_P, payload, sizeof(payload));
+    return PacketQueueService::createQueuePacket(reinterpret_cast<Packet<uint8_t>*>(p), DEFAULT_PRIORITY + (uint8_t) (nextRandom() % 3));
+}
+
+void popAndDelete(SendQueue* queue) {
+    queue->setInUse();
+    QueuePacket<Packet<uint8_t>>* qp = queue->Pop();
+    queue->releaseInUse();
+
+    if (qp != nullptr)
+        PacketQueueService::deleteQueuePacketAndPacket(qp);
+}
+
+void clearQueue(SendQueue* queue) {
+    while (queue->getLength() > 0)
+        popAndDelete(queue);
+}
+
+void benchAddOrdered(size_t size) {
+    SendQueue queue;
+    for (size_t i = 0; i < size; i++)
+        PacketQueueService::addOrdered(&queue, createSendPacket());
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        QueuePacket<Packet<uint8_t>>* qp = createSendPacket();
+        measure(samples, [&]() { PacketQueueService::addOrdered(&queue, qp); });
+        popAndDelete(&queue);
+    }
+    samples.report("queue_add_ordered", size);
+
+    clearQueue(&queue);
+}
+
+struct ContendedRun {
+    SendQueue* queue;
+    Samples* samples;
+    TaskHandle_t owner;
+};
+
+void contendedRoutine(void* parameter) {
+    ContendedRun* run = static_cast<ContendedRun*>(parameter);
+
+    // Both tasks start together
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    for (size_t i = 0; i < SAMPLES; i++) {
+        QueuePacket<Packet<uint8_t>>* qp = createSendPacket();
+        measure(*run->samples, [&]() { PacketQueueService::addOrdered(run->queue, qp); });
+        popAndDelete(run->queue);
+    }
+
+    xTaskNotifyGive(run->owner);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief addOrdered of two tasks on the same queue, one on each core
+ *
+ */
+void benchAddOrderedContended(size_t size) {
+    SendQueue queue;
+    for (size_t i = 0; i < size; i++)
+        PacketQueueService::addOrdered(&queue, createSendPacket());
+
+    ContendedRun runs[2];
+    TaskHandle_t handles[2] = {nullptr, nullptr};
+    UBaseType_t priority = uxTaskPriorityGet(NULL) + 1;
+
+    for (int i = 0; i < 2; i++) {
+        contendedSamples[i].clear();
+        runs[i] = ContendedRun{&queue, &contendedSamples[i], xTaskGetCurrentTaskHandle()};
+
+        if (xTaskCreatePinnedToCore(contendedRoutine, "Bench contended", 4096, &runs[i], priority, &handles[i],
+            i % portNUM_PROCESSORS) != pdPASS) {
+            printf("# Contended benchmark task not created\n");
+            return;
+        }
+    }
+
+    xTaskNotifyGive(handles[0]);
+    xTaskNotifyGive(handles[1]);
+
+    for (int i = 0; i < 2; i++)
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+    samples.addAll(contendedSamples[0]);
+    samples.addAll(contendedSamples[1]);
+    samples.report("queue_add_ordered_contended", size);
+
+    clearQueue(&queue);
+}
+
+} // namespace
+
+void runBenchmarks(const char* platform) {
+    benchmarksNum = 0;
+
+    // The packet sizes and the pool, as in LoraMesher::begin with the default configuration
+    PacketFactory::setMaxPacketSize(LM_MAX_PACKET_SIZE);
+    if (!PacketPoolService::isInitialized())
+        PacketPoolService::init(PacketFactory::getMaxMemoryPacketSize(), LM_PACKET_POOL_BLOCKS);
+
+    calibrate();
+
+    printf("LM_BENCH_BEGIN,%s,%s,%u\n", LM_VERSION, platform, (unsigned) SAMPLES);
+    printf("# name,size,samples,min,median,p90,max cycles, %u cycles of overhead subtracted\n", (unsigned) overhead);
+
+    for (size_t size : LIST_SIZES)
+        benchLinkedList(size);
+
+    for (size_t size : TABLE_SIZES)
+        benchRoutingTable(size);
+
+    benchPackets();
+
+    for (size_t size : QUEUE_SIZES)
+        benchAddOrdered(size);
+
+    for (size_t size : QUEUE_SIZES)
+        benchAddOrderedContended(size);
+
+    printf("LM_BENCH_END,%u\n", (unsigned) benchmarksNum);
+    fflush(stdout);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+/**
+ * @brief Run the microbenchmarks of the library internals and print the report.
+ * It must be called from a task, the contended benchmarks create two more tasks.
+ *
+ * Every line of the report is machine readable:
+ * LM_BENCH_BEGIN,<version>,<platform>,<samples>
+ * LM_BENCH,<name>,<size>,<samples>,<min>,<median>,<p90>,<max>   cycles of one operation
+ * LM_BENCH_END,<number of benchmarks>
+ *
+ * @param platform Name of the platform in the report
+ */
+void runBenchmarks(const char* platform);
@@ -0,0 +1,36 @@
+#include <cstdio>
+
+#include "Benchmarks.h"
+#include "LoraMesher.h"
+
+#ifdef LM_HOST
+
+#include <unistd.h>
+
+#include "Platform.h"
+#include "Scheduler.h"
+
+int main() {
+    // One node of the simulator, the benchmarks run inside a task of the virtual scheduler
+    sim::addNode(0x0001, 0, 0);
+    sim::Scheduler::createTask([](void*) {
+        runBenchmarks("host");
+        vTaskDelete(NULL);
+    }, "Benchmarks", 8192, nullptr, 1, 0);
+
+    sim::Scheduler::run(UINT64_MAX - 1);
+
+    fflush(stdout);
+    _exit(0);
+}
+
+#else
+
+extern "C" void app_main() {
+    // Only the benchmark report in the output
+    esp_log_level_set(LM_TAG, ESP_LOG_WARN);
+
+    runBenchmarks(CONFIG_IDF_TARGET);
+}
+
+#endif
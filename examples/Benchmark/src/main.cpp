@@ -0,0 +1,496 @@
+#include <Arduino.h>
+#include "LoraMesher.h"
+
+// Offered load benchmark. Every node runs the same traffic generator, the gateway starts a run with a serial command:
+//
+//   start <many|all|bursty> <size> <interval> <duration> [reliable]
+//
+// many: every node sends to the gateway, all: every node sends to a random node of its routing table, bursty: like many,
+// in bursts of BURST_LENGTH packets. size is the payload of every packet in bytes, interval the ms between two packets of
+// a node, with a 10 % jitter, and duration the seconds of traffic. With reliable the packets are sent with sendReliablePacket.
+//
+// The command is flooded to the network, the traffic starts START_DELAY ms later. After the run every node prints its
+// report and sends it to the gateway, which prints one JSON summary of the run:
+//
+//   {"run":1,"pattern":"many","size":20,"interval":5000,"duration":300,"reliable":false,"nodes":4,"sent":240,...}
+//
+// The latencies need the clocks synchronized, timeSync is enabled.
+
+#ifndef BENCHMARK_GATEWAY
+#define BENCHMARK_GATEWAY 0
+#endif
+
+// Packets of a burst of the bursty pattern, sent back to back every BURST_LENGTH intervals
+#define BURST_LENGTH 5
+// Ms from the start command to the traffic, so its flood is not in the run
+#define START_DELAY 10000
+// Ms after the traffic for the packets still in the queues, then the reports are spread over REPORT_SPREAD ms
+#define DRAIN_TIME 30000
+#define REPORT_SPREAD 20000
+// Ms after the reports before the gateway prints the summary
+#define SUMMARY_DELAY 30000
+// Reports kept by the gateway, one per node
+#define MAX_REPORTS 64
+
+LoraMesher& radio = LoraMesher::getInstance();
+
+enum MessageKind : uint8_t {
+    MESSAGE_START = 1,
+    MESSAGE_DATA = 2,
+    MESSAGE_REPORT = 3,
+};
+
+enum Pattern : uint8_t {
+    PATTERN_MANY_TO_ONE,
+    PATTERN_ALL_TO_ALL,
+    PATTERN_BURSTY,
+};
+
+static const char* patternNames[] = {"many", "all", "bursty"};
+
+#pragma pack(1)
+struct StartMessage {
+    uint8_t kind;
+    uint8_t run;
+    uint8_t pattern;
+    uint8_t reliable;
+    // Payload of every data packet in bytes
+    uint8_t size;
+    uint32_t interval;
+    uint32_t duration;
+};
+
+struct DataMessage {
+    uint8_t kind;
+    uint8_t run;
+    uint32_t sequence;
+    // Time of the network in ms when it was sent, valid if synced
+    uint8_t synced;
+    uint32_t sentAt;
+};
+
+struct ReportMessage {
+    uint8_t kind;
+    uint8_t run;
+    // Packets sent and packets not added to the send queue
+    uint32_t sent;
+    uint32_t notEnqueued;
+    // Packets and payload bytes of the run received by the node
+    uint32_t received;
+    uint32_t receivedBytes;
+    // Ms on air and packets dropped or expired in the queues during the run
+    uint32_t airtime;
+    uint32_t queueDrops;
+    // Latency histogram of the packets received, see LM_Histogram
+    uint16_t latency[LM_HISTOGRAM_BUCKETS];
+    uint32_t latencyMax;
+};
+#pragma pack()
+
+struct NodeReport {
+    uint16_t address;
+    ReportMessage report;
+};
+
+portMUX_TYPE benchmarkMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Run in progress and the counters of the node, guarded by the benchmarkMux
+StartMessage run = {};
+bool running = false;
+uint32_t sent = 0;
+uint32_t notEnqueued = 0;
+uint32_t received = 0;
+uint32_t receivedBytes = 0;
+LM_Histogram latency;
+
+// Reports of the run received by the gateway
+NodeReport reports[MAX_REPORTS];
+size_t reportsLength = 0;
+
+LM_Stats statsBefore;
+LM_Stats statsAfter;
+
+TaskHandle_t traffic_Handle = NULL;
+
+uint8_t nextRun = 0;
+String command;
+
+/**
+ * @brief Start a run on this node, the traffic task waits START_DELAY ms
+ *
+ */
+void startRun(const StartMessage& start) {
+    portENTER_CRITICAL(&benchmarkMux);
+
+    if (running || (start.run == run.run && run.kind == MESSAGE_START)) {
+        portEXIT_CRITICAL(&benchmarkMux);
+        return;
+    }
+
+    run = start;
+    running = true;
+    sent = 0;
+    notEnqueued = 0;
+    received = 0;
+    receivedBytes = 0;
+    latency = LM_Histogram();
+    reportsLength = 0;
+
+    portEXIT_CRITICAL(&benchmarkMux);
+
+    xTaskNotifyGive(traffic_Handle);
+}
+
+/**
+ * @brief Time of the network in ms
+ *
+ * @return true If the node is synchronized
+ */
+bool getNetworkMs(uint32_t& ms) {
+    int64_t time;
+    if (!radio.getSyncedTime(time))
+        return false;
+
+    ms = (uint32_t) (time / 1000);
+    return true;
+}
+
+void storeReport(uint16_t address, const ReportMessage& report) {
+    portENTER_CRITICAL(&benchmarkMux);
+
+    if (report.run == run.run) {
+        NodeReport* slot = nullptr;
+        for (size_t i = 0; i < reportsLength; i++) {
+            if (reports[i].address == address)
+                slot = &reports[i];
+        }
+
+        if (slot == nullptr && reportsLength < MAX_REPORTS)
+            slot = &reports[reportsLength++];
+
+        if (slot != nullptr) {
+            slot->address = address;
+            slot->report = report;
+        }
+    }
+
+    portEXIT_CRITICAL(&benchmarkMux);
+}
+
+/**
+ * @brief Inline receiver of the packets, it runs in the task that processes the received packets
+ *
+ */
+void onReceive(const uint8_t* payload, const LM_ReceiveMetadata& metadata, void*) {
+    if (metadata.payloadSize == 0)
+        return;
+
+    switch (payload[0]) {
+        case MESSAGE_START:
+            if (metadata.payloadSize >= sizeof(StartMessage))
+                startRun(*reinterpret_cast<const StartMessage*>(payload));
+            break;
+
+        case MESSAGE_DATA: {
+            if (metadata.payloadSize < sizeof(DataMessage))
+                break;
+
+            DataMessage data;
+            memcpy(&data, payload, sizeof(DataMessage));
+
+            uint32_t now;
+            bool synced = data.synced && getNetworkMs(now);
+
+            portENTER_CRITICAL(&benchmarkMux);
+            if (data.run == run.run) {
+                received++;
+                receivedBytes += metadata.payloadSize;
+                if (synced && (int32_t) (now - data.sentAt) >= 0)
+                    latency.record(now - data.sentAt);
+            }
+            portEXIT_CRITICAL(&benchmarkMux);
+            break;
+        }
+
+        case MESSAGE_REPORT:
+            if (BENCHMARK_GATEWAY && metadata.payloadSize >= sizeof(ReportMessage)) {
+                ReportMessage report;
+                memcpy(&report, payload, sizeof(ReportMessage));
+                storeReport(metadata.src, report);
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Destination of the next packet, 0 if there is none
+ *
+ */
+uint16_t getDestination(uint8_t pattern) {
+    if (pattern != PATTERN_ALL_TO_ALL) {
+        RouteNode* gateway = radio.getClosestGateway();
+        return gateway != nullptr ? gateway->networkNode.address : 0;
+    }
+
+    LM_LinkedList<RouteNode>* routingTableList = radio.routingTableListCopy();
+    routingTableList->setInUse();
+
+    uint16_t address = 0;
+    size_t length = routingTableList->getLength();
+    if (length > 0)
+        address = (*routingTableList)[random(0, length)]->networkNode.address;
+
+    routingTableList->releaseInUse();
+    delete routingTableList;
+
+    return address;
+}
+
+void sendData(uint32_t sequence) {
+    uint8_t payload[UINT8_MAX] = {};
+    DataMessage data;
+    data.kind = MESSAGE_DATA;
+    data.run = run.run;
+    data.sequence = sequence;
+    data.synced = getNetworkMs(data.sentAt);
+    memcpy(payload, &data, sizeof(DataMessage));
+
+    size_t size = run.size < sizeof(DataMessage) ? sizeof(DataMessage) : run.size;
+    uint16_t dst = getDestination(run.pattern);
+
+    LM_EnqueueResult result = ENQUEUE_NO_ROUTE;
+    if (dst != 0 && run.reliable)
+        result = radio.sendReliablePacket(dst, payload, size);
+    else if (dst != 0 && run.pattern != PATTERN_ALL_TO_ALL)
+        result = radio.sendToRole(ROLE_GATEWAY, payload, size);
+    else if (dst != 0)
+        result = radio.sendPacket(dst, payload, size);
+
+    portENTER_CRITICAL(&benchmarkMux);
+    if (isEnqueued(result))
+        sent++;
+    else
+        notEnqueued++;
+    portEXIT_CRITICAL(&benchmarkMux);
+}
+
+ReportMessage getReport() {
+    ReportMessage report = {};
+    report.kind = MESSAGE_REPORT;
+
+    portENTER_CRITICAL(&benchmarkMux);
+    report.run = run.run;
+    report.sent = sent;
+    report.notEnqueued = notEnqueued;
+    report.received = received;
+    report.receivedBytes = receivedBytes;
+    for (size_t i = 0; i < LM_HISTOGRAM_BUCKETS; i++)
+        report.latency[i] = latency.buckets[i] > UINT16_MAX ? UINT16_MAX : latency.buckets[i];
+    report.latencyMax = latency.max;
+    portEXIT_CRITICAL(&benchmarkMux);
+
+    report.airtime = statsAfter.timeOnAir.sum - statsBefore.timeOnAir.sum;
+    report.queueDrops = (statsAfter.sendQueueDroppedNum - statsBefore.sendQueueDroppedNum) +
+        (statsAfter.sendQueueExpiredNum - statsBefore.sendQueueExpiredNum) +
+        (statsAfter.receivedQueueDroppedNum - statsBefore.receivedQueueDroppedNum);
+
+    return report;
+}
+
+LM_Histogram getHistogram(const ReportMessage& report) {
+    LM_Histogram histogram;
+    for (size_t i = 0; i < LM_HISTOGRAM_BUCKETS; i++) {
+        histogram.buckets[i] = report.latency[i];
+        histogram.count += report.latency[i];
+    }
+    histogram.max = report.latencyMax;
+    return histogram;
+}
+
+void printReport(uint16_t address, const ReportMessage& report) {
+    LM_Histogram histogram = getHistogram(report);
+    Serial.printf("{\"node\":\"%X\",\"sent\":%u,\"not_enqueued\":%u,\"received\":%u,\"received_bytes\":%u,\"airtime_ms\":%u,"
+        "\"queue_drops\":%u,\"latency_ms\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u}}",
+        address, report.sent, report.notEnqueued, report.received, report.receivedBytes, report.airtime, report.queueDrops,
+        histogram.getPercentile(50), histogram.getPercentile(90), histogram.getPercentile(99), histogram.max);
+}
+
+/**
+ * @brief Summary of the run from the reports of the nodes, the gateway included
+ *
+ */
+void printSummary() {
+    uint32_t totalSent = 0, totalNotEnqueued = 0, totalReceived = 0, totalBytes = 0, totalAirtime = 0, totalDrops = 0;
+    LM_Histogram total;
+
+    // Not in the stack of the traffic task
+    static NodeReport copy[MAX_REPORTS];
+
+    portENTER_CRITICAL(&benchmarkMux);
+    size_t length = reportsLength;
+    memcpy(copy, reports, length * sizeof(NodeReport));
+    portEXIT_CRITICAL(&benchmarkMux);
+
+    for (size_t i = 0; i < length; i++) {
+        const ReportMessage& report = copy[i].report;
+        totalSent += report.sent;
+        totalNotEnqueued += report.notEnqueued;
+        totalReceived += report.received;
+        totalBytes += report.receivedBytes;
+        totalAirtime += report.airtime;
+        totalDrops += report.queueDrops;
+
+        LM_Histogram histogram = getHistogram(report);
+        for (size_t b = 0; b < LM_HISTOGRAM_BUCKETS; b++)
+            total.buckets[b] += histogram.buckets[b];
+        total.count += histogram.count;
+        if (histogram.max > total.max)
+            total.max = histogram.max;
+    }
+
+    uint32_t seconds = run.duration / 1000;
+    Serial.printf("{\"run\":%u,\"pattern\":\"%s\",\"size\":%u,\"interval\":%u,\"duration\":%u,\"reliable\":%s,\"nodes\":%u,"
+        "\"sent\":%u,\"not_enqueued\":%u,\"received\":%u,\"pdr\":%.4f,\"throughput_bps\":%.1f,\"airtime_ms\":%u,\"queue_drops\":%u,"
+        "\"latency_ms\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u},\"reports\":[",
+        run.run, patternNames[run.pattern], run.size, run.interval, seconds, run.reliable ? "true" : "false", (unsigned) length,
+        totalSent, totalNotEnqueued, totalReceived, totalSent == 0 ? 0.0 : (double) totalReceived / totalSent,
+        seconds == 0 ? 0.0 : totalBytes * 8.0 / seconds, totalAirtime, totalDrops,
+        total.getPercentile(50), total.getPercentile(90), total.getPercentile(99), total.max);
+
+    for (size_t i = 0; i < length; i++) {
+        if (i > 0)
+            Serial.print(",");
+        printReport(copy[i].address, copy[i].report);
+    }
+
+    Serial.println("]}");
+}
+
+/**
+ * @brief Traffic generator, it runs one run for every notification of startRun
+ *
+ */
+void trafficTask(void*) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        vTaskDelay(START_DELAY / portTICK_PERIOD_MS);
+        radio.getStats(statsBefore);
+
+        // The gateway only takes part in the all to all traffic
+        bool sends = run.pattern == PATTERN_ALL_TO_ALL || !BENCHMARK_GATEWAY;
+        uint8_t burst = run.pattern == PATTERN_BURSTY ? BURST_LENGTH : 1;
+        uint32_t startedAt = millis();
+        uint32_t sequence = 0;
+
+        while (sends && millis() - startedAt < run.duration) {
+            for (uint8_t i = 0; i < burst; i++)
+                sendData(sequence++);
+
+            // Jitter of 10 % so the nodes do not stay synchronized
+            uint32_t period = run.interval * burst;
+            uint32_t wait = period - period / 10 + random(0, period / 5 + 1);
+            vTaskDelay(wait / portTICK_PERIOD_MS);
+        }
+
+        uint32_t elapsed = millis() - startedAt;
+        if (elapsed < run.duration)
+            vTaskDelay((run.duration - elapsed) / portTICK_PERIOD_MS);
+
+        vTaskDelay(DRAIN_TIME / portTICK_PERIOD_MS);
+        radio.getStats(statsAfter);
+
+        ReportMessage report = getReport();
+        printReport(radio.getLocalAddress(), report);
+        Serial.println();
+
+        if (BENCHMARK_GATEWAY) {
+            storeReport(radio.getLocalAddress(), report);
+            vTaskDelay((REPORT_SPREAD + SUMMARY_DELAY) / portTICK_PERIOD_MS);
+            printSummary();
+        }
+        else {
+            vTaskDelay(random(0, REPORT_SPREAD) / portTICK_PERIOD_MS);
+            radio.sendToRole(ROLE_GATEWAY, reinterpret_cast<uint8_t*>(&report), sizeof(ReportMessage));
+        }
+
+        portENTER_CRITICAL(&benchmarkMux);
+        running = false;
+        portEXIT_CRITICAL(&benchmarkMux);
+    }
+}
+
+/**
+ * @brief Parse a start command of the serial port and flood it
+ *
+ */
+void processCommand(const String& line) {
+    char pattern[8] = {};
+    unsigned size, interval, duration;
+    char reliable[10] = {};
+    int fields = sscanf(line.c_str(), "start %7s %u %u %u %9s", pattern, &size, &interval, &duration, reliable);
+    if (fields < 4) {
+        Serial.println("Usage: start <many|all|bursty> <size> <interval ms> <duration s> [reliable]");
+        return;
+    }
+
+    StartMessage start = {};
+    start.kind = MESSAGE_START;
+    start.run = ++nextRun;
+    start.pattern = PATTERN_MANY_TO_ONE;
+    for (uint8_t i = 0; i < sizeof(patternNames) / sizeof(patternNames[0]); i++) {
+        if (strcmp(pattern, patternNames[i]) == 0)
+            start.pattern = i;
+    }
+    start.size = size > UINT8_MAX ? UINT8_MAX : size;
+    start.interval = interval == 0 ? 1 : interval;
+    start.duration = duration * 1000;
+    start.reliable = fields == 5 && strcmp(reliable, "reliable") == 0;
+
+    if (!isEnqueued(radio.sendFlood(reinterpret_cast<uint8_t*>(&start), sizeof(StartMessage)))) {
+        Serial.println("Start command not sent");
+        return;
+    }
+
+    Serial.printf("Run %u started\n", start.run);
+    startRun(start);
+}
+
+void setup() {
+    Serial.begin(115200);
+
+    LoraMesher::LoraMesherConfig config;
+    config.timeSync = true;
+    radio.begin(config);
+
+    radio.setReceiveCallback(onReceive);
+
+    if (xTaskCreate(trafficTask, "Benchmark traffic", 4096, NULL, 2, &traffic_Handle) != pdPASS)
+        Serial.println("Error: Benchmark traffic task not created");
+
+    radio.start();
+
+    if (BENCHMARK_GATEWAY) {
+        radio.addGatewayRole();
+        // The nodes ignore a start of the run they have done, after a reboot of the gateway too
+        nextRun = random(0, 256);
+    }
+
+    Serial.printf("Benchmark %s %X\n", BENCHMARK_GATEWAY ? "gateway" : "node", radio.getLocalAddress());
+}
+
+void loop() {
+    while (BENCHMARK_GATEWAY && Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == '\n' || c == '\r') {
+            if (command.length() > 0)
+                processCommand(command);
+            command = "";
+        }
+        else {
+            command += c;
+        }
+    }
+
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+}
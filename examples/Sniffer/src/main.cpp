@@ -0,0 +1,44 @@
+#include <Arduino.h>
+#include "LoraMesher.h"
+
+// Sniffer of the LoraMesher frames. It streams every frame received, with its timestamp, RSSI, SNR, CRC status, frequency
+// and modulation, as a pcap stream on the USB serial port:
+//
+//   python3 utilities/snifferToPcap.py /dev/ttyUSB0 | wireshark -k -i -
+//
+// with the dissector of utilities/wireshark/loramesher.lua. Every byte received from the host starts a new pcap stream,
+// so a host that connects later gets the pcap global header.
+
+LoraMesher& radio = LoraMesher::getInstance();
+
+/**
+ * @brief Sink of the pcap records, called from the receiving routine. The serial driver buffers the record
+ *
+ */
+void writeRecord(const uint8_t* data, size_t length) {
+    Serial.write(data, length);
+}
+
+void setup() {
+    // A frame of 255 bytes at SF7 lasts more than 100 ms, far more than its record at this speed
+    Serial.begin(921600);
+
+    LoraMesher::LoraMesherConfig config;
+    config.sniffer = true;
+    radio.begin(config);
+
+    radio.startCapture(writeRecord, CAPTURE_FORMAT_PCAP);
+    radio.start();
+}
+
+void loop() {
+    if (Serial.available() > 0) {
+        while (Serial.available() > 0)
+            Serial.read();
+
+        radio.stopCapture();
+        radio.startCapture(writeRecord, CAPTURE_FORMAT_PCAP);
+    }
+
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+}
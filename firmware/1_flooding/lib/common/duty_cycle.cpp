@@ -5,12 +5,14 @@
 
 #include "duty_cycle.h"
 #include "logging.h"
+#include "services/AirtimeService.h"
 
 // Global duty cycle monitor
 DutyCycleMonitor dutyCycle;
 
 DutyCycleMonitor::DutyCycleMonitor() {
-    transmissions = nullptr;
+    memset(bucketAirtimeMs, 0, sizeof(bucketAirtimeMs));
+    currentBucket = 0;
     totalAirtimeMs = 0;
     windowStartMs = 0;
     enforcementEnabled = true;
@@ -22,12 +24,6 @@ DutyCycleMonitor::DutyCycleMonitor() {
 }
 
 DutyCycleMonitor::~DutyCycleMonitor() {
-    // Free transmission records
-    while (transmissions != nullptr) {
-        TransmissionRecord* next = transmissions->next;
-        delete transmissions;
-        transmissions = next;
-    }
 }
 
 void DutyCycleMonitor::begin(AirtimeConfig& cfg, bool enableEnforcement) {
@@ -78,14 +74,8 @@ void DutyCycleMonitor::recordTransmission(uint16_t packetSize) {
 void DutyCycleMonitor::recordTransmission(unsigned long airtimeMs) {
     updateWindow();
 
-    // Create new transmission record
-    TransmissionRecord* record = new TransmissionRecord();
-    record->timestamp = millis();
-    record->airtimeMs = airtimeMs;
-    record->next = transmissions;
-    transmissions = record;
-
-    // Update total
+    // Add it to the bucket of the current minute
+    bucketAirtimeMs[currentBucket % DUTY_CYCLE_BUCKETS] += airtimeMs;
     totalAirtimeMs += airtimeMs;
 
     // Check thresholds
@@ -102,37 +92,13 @@ unsigned long DutyCycleMonitor::calculateAirtime(uint16_t packetSize) {
 }
 
 unsigned long DutyCycleMonitor::calculateAirtime(uint16_t packetSize, AirtimeConfig& cfg) {
-    // LoRa airtime calculation based on Semtech AN1200.13
-    float bandwidth = cfg.bandwidth * 1000; // Convert to Hz
-    float Tsymbol = (1 << cfg.spreadingFactor) / bandwidth * 1000; // ms
-
-    // Preamble time
-    float Tpreamble = (cfg.preambleLength + 4.25) * Tsymbol;
-
-    // Payload calculation
-    float payloadSymbols;
-    if (cfg.lowDataRateOptimize) {
-        // Low data rate optimization for SF11/SF12
-        int de = 1;
-        payloadSymbols = 8 + ceil((8 * packetSize - 4 * cfg.spreadingFactor + 28 + 16 * cfg.crc - 20 * 0) /
-                                  (4 * (cfg.spreadingFactor - 2 * de))) * cfg.codingRate;
-    } else {
-        payloadSymbols = 8 + ceil((8 * packetSize - 4 * cfg.spreadingFactor + 28 + 16 * cfg.crc) /
-                                  (4 * cfg.spreadingFactor)) * cfg.codingRate;
-    }
-
-    float Tpayload = payloadSymbols * Tsymbol;
-
-    // Total airtime
-    unsigned long totalAirtime = (unsigned long)(Tpreamble + Tpayload);
-
-    return totalAirtime;
+    // LoRa airtime based on Semtech AN1200.13. It is a table lookup when cfg is the active LoRaMesher configuration
+    return AirtimeService::getTimeOnAir(packetSize, cfg.spreadingFactor, cfg.bandwidth, cfg.codingRate,
+                                        cfg.preambleLength, cfg.crc, cfg.lowDataRateOptimize) / 1000;
 }
 
 float DutyCycleMonitor::getCurrentPercentage() {
     updateWindow();
-    unsigned long windowElapsed = millis() - windowStartMs;
-    if (windowElapsed == 0) return 0;
 
     return (totalAirtimeMs * 100.0) / DUTY_CYCLE_WINDOW_MS;
 }
@@ -151,7 +117,8 @@ unsigned long DutyCycleMonitor::getRemainingAirtime() {
 }
 
 unsigned long DutyCycleMonitor::getWindowElapsed() {
-    return millis() - windowStartMs;
+    unsigned long elapsed = millis() - windowStartMs;
+    return elapsed < DUTY_CYCLE_WINDOW_MS ? elapsed : DUTY_CYCLE_WINDOW_MS;
 }
 
 bool DutyCycleMonitor::isWarning() {
@@ -175,13 +142,8 @@ void DutyCycleMonitor::onReset(void (*callback)()) {
 }
 
 void DutyCycleMonitor::reset() {
-    // Free all transmission records
-    while (transmissions != nullptr) {
-        TransmissionRecord* next = transmissions->next;
-        delete transmissions;
-        transmissions = next;
-    }
-
+    memset(bucketAirtimeMs, 0, sizeof(bucketAirtimeMs));
+    currentBucket = millis() / DUTY_CYCLE_BUCKET_MS;
     totalAirtimeMs = 0;
     windowStartMs = millis();
     warningIssued = false;
@@ -229,48 +191,39 @@ void DutyCycleMonitor::printStatus() {
 }
 
 void DutyCycleMonitor::updateWindow() {
-    unsigned long now = millis();
-
-    // Check if window has expired (1 hour)
-    if (now - windowStartMs >= DUTY_CYCLE_WINDOW_MS) {
-        LOG_INFO("Duty cycle window expired, resetting");
-        reset();
-    } else {
-        // Clean old records outside current window
-        cleanOldRecords();
-    }
+    unsigned long bucket = millis() / DUTY_CYCLE_BUCKET_MS;
+    if (bucket != currentBucket)
+        expireBuckets(bucket);
 }
 
-void DutyCycleMonitor::cleanOldRecords() {
-    unsigned long cutoff = millis() - DUTY_CYCLE_WINDOW_MS;
-    TransmissionRecord* prev = nullptr;
-    TransmissionRecord* current = transmissions;
+void DutyCycleMonitor::expireBuckets(unsigned long bucket) {
+    unsigned long advanced = bucket - currentBucket;
     unsigned long removedAirtime = 0;
 
-    while (current != nullptr) {
-        if (current->timestamp < cutoff) {
-            // Remove this record
-            removedAirtime += current->airtimeMs;
-            TransmissionRecord* toDelete = current;
-
-            if (prev == nullptr) {
-                transmissions = current->next;
-                current = transmissions;
-            } else {
-                prev->next = current->next;
-                current = current->next;
-            }
-
-            delete toDelete;
-        } else {
-            prev = current;
-            current = current->next;
+    if (advanced >= DUTY_CYCLE_BUCKETS) {
+        // Nothing sent in the whole window
+        removedAirtime = totalAirtimeMs;
+        memset(bucketAirtimeMs, 0, sizeof(bucketAirtimeMs));
+    } else {
+        // The buckets reused by the new minutes left the window
+        for (unsigned long i = 1; i <= advanced; i++) {
+            unsigned long& expired = bucketAirtimeMs[(currentBucket + i) % DUTY_CYCLE_BUCKETS];
+            removedAirtime += expired;
+            expired = 0;
         }
     }
 
+    currentBucket = bucket;
+    totalAirtimeMs -= removedAirtime;
+
+    // The warnings are issued again when the airtime rises back over the thresholds
+    if (totalAirtimeMs < DUTY_CYCLE_WARNING_MS)
+        warningIssued = false;
+    if (totalAirtimeMs < DUTY_CYCLE_CRITICAL_MS)
+        criticalWarningIssued = false;
+
     if (removedAirtime > 0) {
-        totalAirtimeMs -= removedAirtime;
-        LOG_DEBUG("Cleaned %lu ms of old transmissions", removedAirtime);
+        LOG_DEBUG("Expired %lu ms of old transmissions", removedAirtime);
     }
 }
 
@@ -43,7 +43,7 @@
 // Protocol Configuration - Flooding
 #define BROADCAST_ADDRESS       0xFFFF     // Broadcast address
 #define MAX_TTL                 5           // Maximum hop count
-#define DUPLICATE_CACHE_SIZE    5           // Number of recent packets to track
+#define DUPLICATE_CACHE_BITS    3           // Recent packets to track: 4 * 2^BITS (32)
 #define DUPLICATE_TIMEOUT_MS    30000      // Forget duplicates after 30 seconds
 #define REBROADCAST_DELAY_MIN   0          // Minimum rebroadcast delay (ms)
 #define REBROADCAST_DELAY_MAX   100        // Maximum rebroadcast delay (ms)
@@ -97,14 +97,6 @@ struct FloodingPacket {
     uint8_t payloadSize;
 };
 
-// Duplicate cache entry
-struct DuplicateEntry {
-    uint16_t src;
-    uint16_t sequence;
-    unsigned long timestamp;
-    bool valid;
-};
-
 // Statistics structure
 struct FloodingStats {
     uint32_t packetsTransmitted;
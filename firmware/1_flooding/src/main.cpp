@@ -6,11 +6,12 @@
  * - Sensors broadcast packets every 60 seconds
  * - All nodes rebroadcast received packets (except duplicates)
  * - Gateway terminates the flood
- * - Duplicate detection using (src, sequence) cache
+ * - Duplicate detection using the LoRaMesher (src, sequence) cache
  */
 
 #include <Arduino.h>
 #include "LoraMesher.h"
+#include "utilities/DuplicateCache.hpp"
 #include "config.h"
 #include "../common/display_utils.h"
 #include "../common/logging.h"
@@ -22,7 +23,7 @@ LoraMesher& radio = LoraMesher::getInstance();
 // Global objects
 NodeStatus nodeStatus;
 FloodingStats stats;
-DuplicateEntry duplicateCache[DUPLICATE_CACHE_SIZE];
+LM_DuplicateCache<DUPLICATE_CACHE_BITS> duplicateCache(DUPLICATE_TIMEOUT_MS);
 uint16_t sequenceNumber = 0;
 
 // Timing variables
@@ -38,30 +39,6 @@ struct SensorPacket {
     float sensorValue;      // Simulated sensor data
 };
 
-// ============================================================================
-// Duplicate Detection
-// ============================================================================
-
-bool isDuplicate(uint16_t src, uint16_t seq) {
-    for (int i = 0; i < DUPLICATE_CACHE_SIZE; i++) {
-        if (duplicateCache[i].valid &&
-            duplicateCache[i].src == src &&
-            duplicateCache[i].sequence == seq) {
-            return true;
-        }
-    }
-    return false;
-}
-
-void addToCache(uint16_t src, uint16_t seq) {
-    static int cacheIndex = 0;
-    duplicateCache[cacheIndex].src = src;
-    duplicateCache[cacheIndex].sequence = seq;
-    duplicateCache[cacheIndex].timestamp = millis();
-    duplicateCache[cacheIndex].valid = true;
-    cacheIndex = (cacheIndex + 1) % DUPLICATE_CACHE_SIZE;
-}
-
 // ============================================================================
 // Packet Processing - Receive Task
 // ============================================================================
@@ -85,8 +62,8 @@ void processReceivedPackets(void*) {
 
             SensorPacket* data = packet->payload;
 
-            // Check for duplicate
-            if (isDuplicate(data->src, data->sequence)) {
+            // Check for duplicate, new packets are added to the cache
+            if (duplicateCache.checkAndAdd(data->src, data->sequence)) {
                 if (DEBUG_FLOODING) {
                     LOG_DEBUG("DUPLICATE: Seq=%u From=%04X", data->sequence, data->src);
                 }
@@ -95,9 +72,6 @@ void processReceivedPackets(void*) {
                 continue;
             }
 
-            // Add to cache
-            addToCache(data->src, data->sequence);
-
             // Update statistics
             stats.packetsReceived++;
 
@@ -278,9 +252,7 @@ void setupNode() {
     delay(100);
 
     // Initialize duplicate cache
-    for (int i = 0; i < DUPLICATE_CACHE_SIZE; i++) {
-        duplicateCache[i].valid = false;
-    }
+    duplicateCache.clear();
 
     // Initialize node status
     nodeStatus.nodeId = NODE_ID;
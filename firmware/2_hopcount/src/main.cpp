@@ -365,21 +365,21 @@ void printRoutingTable() {
     }
 
     LOG_INFO("==== Routing Table ====");
-    LOG_INFO("Size: %d entries", radio.routingTableSize());
 
-    // Access routing table via RoutingTableService
-    LM_LinkedList<RouteNode>* routingTable = RoutingTableService::routingTableList;
-    if (routingTable && routingTable->moveToStart()) {
+    // Read the latest routing table snapshot, it does not block route updates
+    RoutingTableView view;
+    LOG_INFO("Size: %d entries", (int) view.size());
+
+    if (view.size() > 0) {
         LOG_INFO("Addr   Via    Hops  Role");
         LOG_INFO("------|------|------|----");
-        do {
-            RouteNode* node = routingTable->getCurrent();
+        for (const RoutingTableSnapshot::Entry& entry : view) {
             LOG_INFO("%04X | %04X | %4d | %02X",
-                     node->networkNode.address,
-                     node->via,
-                     node->networkNode.metric,
-                     node->networkNode.role);
-        } while (routingTable->next());
+                     entry.networkNode.address,
+                     entry.via,
+                     entry.networkNode.metric,
+                     entry.networkNode.role);
+        }
     } else {
         LOG_INFO("(empty)");
     }
@@ -15,6 +15,10 @@
 #define DUTY_CYCLE_WARNING_MS       30000   // Warn at 30 seconds (83%)
 #define DUTY_CYCLE_CRITICAL_MS      34000   // Critical at 34 seconds (94%)
 
+// Sliding window accounting: the airtime is added to the bucket of its minute
+#define DUTY_CYCLE_BUCKETS          60
+#define DUTY_CYCLE_BUCKET_MS        (DUTY_CYCLE_WINDOW_MS / DUTY_CYCLE_BUCKETS)
+
 // Airtime calculation parameters for LoRa
 struct AirtimeConfig {
     float bandwidth;        // kHz (125, 250, 500)
@@ -27,13 +31,9 @@ struct AirtimeConfig {
 
 class DutyCycleMonitor {
 private:
-    struct TransmissionRecord {
-        unsigned long timestamp;
-        unsigned long airtimeMs;
-        TransmissionRecord* next;
-    };
-
-    TransmissionRecord* transmissions;
+    // Airtime of every bucket of the window, circular. totalAirtimeMs is their running sum
+    unsigned long bucketAirtimeMs[DUTY_CYCLE_BUCKETS];
+    unsigned long currentBucket;    // Number of the bucket of the last update, millis() / DUTY_CYCLE_BUCKET_MS
     unsigned long totalAirtimeMs;
     unsigned long windowStartMs;
     AirtimeConfig config;
@@ -84,7 +84,7 @@ public:
 
 private:
     void updateWindow();
-    void cleanOldRecords();
+    void expireBuckets(unsigned long bucket);
     void checkThresholds();
 };
 
@@ -58,24 +58,11 @@
 #define LORA_MISO   11
 #define LORA_SCK    9
 
-// Cost Function Weights
-#define W1_HOP_COUNT    1.0
-#define W2_RSSI         0.3
-#define W3_SNR          0.2
-#define W4_ETX          0.4
-#define W5_GATEWAY_BIAS 1.0
+// Cost Function Weights and RSSI/SNR ranges: LM_COST_* of the library BuildOptions.h (GatewayBiasedMetric)
+// Hysteresis of the cost monitoring logs, the route selection uses LoraMesherConfig::routeHysteresis
 #define HYSTERESIS_THRESHOLD 0.15
 
-// RSSI/SNR ranges
-#define RSSI_MIN        -120
-#define RSSI_MAX        -30
-#define SNR_MIN         -20
-#define SNR_MAX         10
-
-// ETX
-#define ETX_WINDOW_SIZE 10
-#define ETX_DEFAULT     1.5
-#define ETX_ALPHA       0.3
+// ETX: window, default and alpha are LM_ETX_* of the library BuildOptions.h (NeighborTableService)
 
 // Trickle
 #define TRICKLE_IMIN_MS     60000
@@ -88,6 +75,58 @@
 #define PACKET_INTERVAL_VARIATION 5000
 #define GATEWAY_ADDRESS         0x0005
 
+// Sensor batching: samples sent in one frame (1 = one frame per sample, max SENSOR_BATCH_MAX_SAMPLES)
+// and maximum time from the first sample of a batch until it is sent
+#define SENSOR_BATCH_SIZE       4
+#define SENSOR_BATCH_FLUSH_MS   180000
+
+// Gateway uplink to the Pi: the received samples as binary COBS frames from the uplink task (see uplink.h)
+// instead of the RX text logs. Decode with serial_collector.py / mqtt_publisher.py --binary
+#define UPLINK_BINARY           false
+
+// Gateway uplink over WiFi: the same frames in batched UDP datagrams (see uplink.h), no Pi on the gateway.
+// Receive with mqtt_publisher.py --udp UPLINK_UDP_PORT. The credentials can be given as build flags
+#define UPLINK_WIFI             false
+#ifndef UPLINK_WIFI_SSID
+#define UPLINK_WIFI_SSID        "xmesh"
+#endif
+#ifndef UPLINK_WIFI_PASSWORD
+#define UPLINK_WIFI_PASSWORD    ""
+#endif
+#ifndef UPLINK_UDP_HOST
+#define UPLINK_UDP_HOST         "192.168.1.10"
+#endif
+#define UPLINK_UDP_PORT         5005
+
+// Time of the network from the gateway with the lowest address on the HELLOs (LoraMesherConfig::timeSync).
+// The sample timestamps and the uplink rxTime are then milliseconds of the network instead of since boot,
+// so rxTime - timestamp is the one way latency. Enable it in every node
+#define TIME_SYNC               false
+
+// Congestion of the node in the HELLOs (LoraMesherConfig::backpressure): the cost routing avoids the congested relays.
+// The sensors flush their batches later while the path to the gateway is congested, LoraMesher::getNextSendTime,
+// without it only the send queue and the airtime budget of the node pace them
+#define BACKPRESSURE            false
+
+// Seconds between two telemetry records of the node in its HELLOs (LoraMesherConfig::telemetryInterval), 0 disables it.
+// The records go up to the gateways on the HELLOs of the relays, the gateways print their table with the monitoring stats
+#define TELEMETRY_INTERVAL      0
+
+// Seconds between two samples of the metrics history of the node (LoraMesherConfig::metricsInterval), 0 disables it.
+// The monitors are recorded with the library stats, a fine sample every interval and a coarse one every 15. The history
+// is printed or requested from another node over serial: "metrics <address hex, 0 for this node> <0 fine, 1 coarse>
+// <from s> <to s>"
+#define METRICS_INTERVAL        60
+
+// Firmware updates over the mesh (LoraMesherConfig::otaPartition). Every node receives the images with a version newer
+// than FIRMWARE_VERSION into its next OTA partition and boots them once verified. The gateway built with OTA_OFFER offers
+// its own running image, flash it with a higher FIRMWARE_VERSION than the nodes
+#define OTA_UPDATES             false
+#define FIRMWARE_VERSION        1
+#define OTA_OFFER               false
+// Delay before booting a verified image, so the node serves the chunks to its neighbors a while
+#define OTA_REBOOT_DELAY_MS     600000
+
 // Communication Architecture: Bidirectional by Default
 // Protocol 3 supports bidirectional routing (gateway ↔ sensor communication)
 // LoRaMesher library sends HELLO packets from ALL nodes, enabling full mesh capabilities
@@ -15,6 +15,14 @@ DisplayManager::DisplayManager() {
     lastActivityMs = 0;
     displayEnabled = true;
     status = nullptr;
+    snapshotPublished = false;
+    lastFrameValid = false;
+    pageRequested = false;
+    message[0] = '\0';
+    messagePending = false;
+    messageTemporary = false;
+    task = NULL;
+    snapshotMux = portMUX_INITIALIZER_UNLOCKED;
 }
 
 DisplayManager::~DisplayManager() {
@@ -54,10 +62,78 @@ bool DisplayManager::begin() {
     return true;
 }
 
+bool DisplayManager::startTask(BaseType_t core) {
+    if (display == nullptr || task != NULL) {
+        return false;
+    }
+
+    BaseType_t res = xTaskCreatePinnedToCore(taskLoop, "Display", DISPLAY_TASK_STACK, this,
+                                             DISPLAY_TASK_PRIORITY, &task, core);
+    if (res != pdPASS) {
+        task = NULL;
+        Serial.println(F("[DISPLAY] Display task creation failed"));
+        return false;
+    }
+
+    return true;
+}
+
 void DisplayManager::update(NodeStatus& nodeStatus) {
-    status = &nodeStatus;
+    publish(nodeStatus);
+
+    // Drawn by the display task
+    if (task != NULL) {
+        return;
+    }
+
+    refresh();
+}
+
+void DisplayManager::publish(const NodeStatus& nodeStatus) {
+    DisplaySnapshot snapshot;
+    static_cast<NodeMetrics&>(snapshot) = nodeStatus;
+    strlcpy(snapshot.statusMessage, nodeStatus.statusMessage.c_str(), sizeof(snapshot.statusMessage));
+
+    portENTER_CRITICAL(&snapshotMux);
+    published = snapshot;
+    snapshotPublished = true;
+    portEXIT_CRITICAL(&snapshotMux);
+
     lastActivityMs = millis();
+}
+
+void DisplayManager::taskLoop(void* parameter) {
+    DisplayManager* self = static_cast<DisplayManager*>(parameter);
+
+    for (;;) {
+        if (self->pageRequested) {
+            self->pageRequested = false;
+            self->currentPage = (DisplayPage)((self->currentPage + 1) % PAGE_COUNT);
+            self->lastUpdateMs = 0; // Force immediate update
+        }
+
+        if (self->messagePending) {
+            char text[sizeof(self->message)];
+            portENTER_CRITICAL(&self->snapshotMux);
+            memcpy(text, self->message, sizeof(text));
+            bool temporary = self->messageTemporary;
+            self->messagePending = false;
+            portEXIT_CRITICAL(&self->snapshotMux);
+
+            self->drawMessage(text);
+            if (temporary) {
+                vTaskDelay(2000 / portTICK_PERIOD_MS);
+                self->lastUpdateMs = 0; // Force redraw
+            }
+        }
+
+        self->refresh();
 
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+}
+
+void DisplayManager::refresh() {
     // Check if display should sleep
     if (displayEnabled && (millis() - lastActivityMs > DISPLAY_TIMEOUT_MS)) {
         sleep();
@@ -75,6 +151,19 @@ void DisplayManager::update(NodeStatus& nodeStatus) {
     }
     lastUpdateMs = millis();
 
+    // Take the latest snapshot, the drawing does not read the NodeStatus of the other tasks
+    portENTER_CRITICAL(&snapshotMux);
+    bool hasSnapshot = snapshotPublished;
+    if (hasSnapshot) {
+        shown = published;
+    }
+    portEXIT_CRITICAL(&snapshotMux);
+
+    if (!hasSnapshot) {
+        return;
+    }
+    status = &shown;
+
     display->clearDisplay();
 
     // Draw current page
@@ -95,7 +184,49 @@ void DisplayManager::update(NodeStatus& nodeStatus) {
             drawStatusPage();
     }
 
-    display->display();
+    pushChangedPages();
+}
+
+void DisplayManager::pushChangedPages() {
+    const uint8_t* frame = display->getBuffer();
+    const uint8_t pages = SCREEN_HEIGHT / 8;
+
+    for (uint8_t page = 0; page < pages; page++) {
+        const uint8_t* data = frame + page * SCREEN_WIDTH;
+        if (lastFrameValid && memcmp(data, lastFrame + page * SCREEN_WIDTH, SCREEN_WIDTH) == 0) {
+            continue;
+        }
+        sendPage(page, data);
+    }
+
+    memcpy(lastFrame, frame, sizeof(lastFrame));
+    lastFrameValid = true;
+}
+
+void DisplayManager::sendPage(uint8_t page, const uint8_t* data) {
+    // Window of one page, the SSD1306 is in horizontal addressing mode
+    display->ssd1306_command(SSD1306_PAGEADDR);
+    display->ssd1306_command(page);
+    display->ssd1306_command(page);
+    display->ssd1306_command(SSD1306_COLUMNADDR);
+    display->ssd1306_command(0);
+    display->ssd1306_command(SCREEN_WIDTH - 1);
+
+    // 0x40: the following bytes are display data
+    const uint8_t chunk = 16;
+    for (uint8_t i = 0; i < SCREEN_WIDTH; i += chunk) {
+        Wire.beginTransmission(OLED_ADDRESS);
+        Wire.write((uint8_t)0x40);
+        Wire.write(data + i, chunk);
+        Wire.endTransmission();
+    }
+}
+
+void DisplayManager::drawMessage(const char* text) {
+    display->clearDisplay();
+    display->setCursor(0, 0);
+    display->print(text);
+    pushChangedPages();
 }
 
 void DisplayManager::drawStatusPage() {
@@ -136,7 +267,7 @@ void DisplayManager::drawStatusPage() {
 
     // Line 6: Status message
     display->setCursor(0, 50);
-    display->print(status->statusMessage.substring(0, 21));
+    display->print(status->statusMessage);
 }
 
 void DisplayManager::drawMetricsPage() {
@@ -305,16 +436,31 @@ void DisplayManager::drawSignalStrength(int x, int y, float rssi) {
 }
 
 void DisplayManager::nextPage() {
+    lastActivityMs = millis();
+
+    // Applied by the display task
+    if (task != NULL) {
+        pageRequested = true;
+        return;
+    }
+
     currentPage = (DisplayPage)((currentPage + 1) % PAGE_COUNT);
     lastActivityMs = millis();
     lastUpdateMs = 0; // Force immediate update
 }
 
 void DisplayManager::showMessage(const String& message, bool temporary) {
-    display->clearDisplay();
-    display->setCursor(0, 0);
-    display->print(message);
-    display->display();
+    // Drawn by the display task, the caller does not wait
+    if (task != NULL) {
+        portENTER_CRITICAL(&snapshotMux);
+        strlcpy(this->message, message.c_str(), sizeof(this->message));
+        messageTemporary = temporary;
+        messagePending = true;
+        portEXIT_CRITICAL(&snapshotMux);
+        return;
+    }
+
+    drawMessage(message.c_str());
 
     if (temporary) {
         delay(2000);
@@ -4,6 +4,11 @@
  *
  * Uses TinyGPS++ library to parse NMEA sentences from u-blox NEO-M8M GPS module.
  * Provides latitude, longitude, altitude, satellite count, and fix validity.
+ *
+ * The UART is not polled: the ESP32 UART driver buffers the bytes and its event
+ * task calls the onReceive callback when the FIFO fills or the line goes idle
+ * at the end of a burst of sentences. The sentences are parsed there and every
+ * fix is published lock-free for the other tasks.
  */
 
 #ifndef GPS_HANDLER_H
@@ -12,6 +17,11 @@
 #include <Arduino.h>
 #include <TinyGPSPlus.h>
 
+#include "published_value.h"
+
+// UART driver ring buffer, an NMEA burst of the NEO-M8M is ~500 bytes
+#define GPS_RX_BUFFER_SIZE  1024
+
 /**
  * @brief GPS Data Structure
  */
@@ -35,55 +45,19 @@ class GPSHandler {
 private:
     TinyGPSPlus gps;
     HardwareSerial* serial;
-    GPSData data;
+    GPSData data;                       // Parser state, only used by the UART event task
+    PublishedValue<GPSData> published;  // Latest fix, read by any task
     uint32_t chars_processed;
     uint32_t sentences_with_fix;
     uint32_t failed_checksum;
     uint32_t last_encode_time;
 
-public:
-    /**
-     * @brief Constructor
-     * @param ser Pointer to HardwareSerial object
-     */
-    GPSHandler(HardwareSerial* ser) : serial(ser) {
-        chars_processed = 0;
-        sentences_with_fix = 0;
-        failed_checksum = 0;
-        last_encode_time = 0;
-        data.valid = false;
-        data.last_update = 0;
-    }
-
     /**
-     * @brief Initialize GPS module
-     * @param rx_pin GPIO pin for RX (GPS TX → ESP32)
-     * @param tx_pin GPIO pin for TX (ESP32 → GPS)
+     * @brief Parse the received bytes (UART event task)
      */
-    void begin(int rx_pin, int tx_pin) {
-        serial->begin(GPS_BAUD, SERIAL_8N1, rx_pin, tx_pin);
-        Serial.printf("[GPS] Initialized on RX=%d, TX=%d, baud=%d\n", rx_pin, tx_pin, GPS_BAUD);
-
-        // Flush any initial data
-        delay(500);
+    void ingest() {
+        // Feed GPS parser with the buffered UART data
         while (serial->available()) {
-            serial->read();
-        }
-
-        Serial.println("[GPS] Waiting for satellite fix...");
-        Serial.println("[GPS] Note: May take 1-5 minutes outdoors, longer indoors");
-    }
-
-    /**
-     * @brief Update GPS parser (call in loop)
-     * @return true if new valid fix obtained
-     */
-    bool update() {
-        bool new_fix = false;
-        uint32_t start_time = millis();
-
-        // Feed GPS parser with available UART data
-        while (serial->available() && (millis() - start_time < 100)) {
             char c = serial->read();
             chars_processed++;
 
@@ -114,7 +88,7 @@ public:
                     data.valid = true;
                     data.last_update = millis();
                     sentences_with_fix++;
-                    new_fix = true;
+                    published.publish(data);
                 }
             }
         }
@@ -123,15 +97,57 @@ public:
         if (gps.failedChecksum() > failed_checksum) {
             failed_checksum = gps.failedChecksum();
         }
+    }
 
-        return new_fix;
+public:
+    /**
+     * @brief Constructor
+     * @param ser Pointer to HardwareSerial object
+     */
+    GPSHandler(HardwareSerial* ser) : serial(ser) {
+        chars_processed = 0;
+        sentences_with_fix = 0;
+        failed_checksum = 0;
+        last_encode_time = 0;
+        memset(&data, 0, sizeof(data));
+        published.publish(data);
+    }
+
+    /**
+     * @brief Initialize GPS module
+     * @param rx_pin GPIO pin for RX (GPS TX → ESP32)
+     * @param tx_pin GPIO pin for TX (ESP32 → GPS)
+     */
+    void begin(int rx_pin, int tx_pin) {
+        serial->setRxBufferSize(GPS_RX_BUFFER_SIZE);  // Must be set before begin()
+        serial->begin(GPS_BAUD, SERIAL_8N1, rx_pin, tx_pin);
+        Serial.printf("[GPS] Initialized on RX=%d, TX=%d, baud=%d\n", rx_pin, tx_pin, GPS_BAUD);
+
+        // Flush any initial data
+        delay(500);
+        while (serial->available()) {
+            serial->read();
+        }
+
+        // Parse the sentences as they arrive, from the UART event task
+        serial->onReceive([this]() { ingest(); });
+
+        Serial.println("[GPS] Waiting for satellite fix...");
+        Serial.println("[GPS] Note: May take 1-5 minutes outdoors, longer indoors");
     }
 
     /**
      * @brief Get latest GPS data
      */
     GPSData getData() {
-        return data;
+        return published.get();
+    }
+
+    /**
+     * @brief Number of fixes received, to detect a new one
+     */
+    uint32_t getFixCount() {
+        return published.getVersion();
     }
 
     /**
@@ -139,36 +155,40 @@ public:
      * @param max_age_ms Maximum age in milliseconds
      */
     bool isFixValid(uint32_t max_age_ms = 10000) {
-        if (!data.valid) return false;
-        return (millis() - data.last_update) < max_age_ms;
+        GPSData fix = published.get();
+        if (!fix.valid) return false;
+        return (millis() - fix.last_update) < max_age_ms;
     }
 
     /**
      * @brief Get GPS fix age in milliseconds
      */
     uint32_t getFixAge() {
-        if (!data.valid) return UINT32_MAX;
-        return millis() - data.last_update;
+        GPSData fix = published.get();
+        if (!fix.valid) return UINT32_MAX;
+        return millis() - fix.last_update;
     }
 
     /**
      * @brief Print GPS status to serial (for debugging)
      */
     void printStatus() {
+        GPSData fix = published.get();
+
         Serial.printf("[GPS] Chars: %lu, Sentences: %lu, Failed: %lu\n",
                      chars_processed, sentences_with_fix, failed_checksum);
 
-        if (data.valid) {
-            uint32_t age = millis() - data.last_update;
+        if (fix.valid) {
+            uint32_t age = millis() - fix.last_update;
             Serial.printf("[GPS] Lat: %.6f°, Lon: %.6f°, Alt: %.1fm\n",
-                         data.latitude, data.longitude, data.altitude);
+                         fix.latitude, fix.longitude, fix.altitude);
             Serial.printf("[GPS] Sats: %d, HDOP: %.2f, Age: %lums\n",
-                         data.satellites, data.hdop, age);
+                         fix.satellites, fix.hdop, age);
 
-            if (gps.date.isValid() && gps.time.isValid()) {
+            if (fix.year != 0) {
                 Serial.printf("[GPS] Time: %04d-%02d-%02d %02d:%02d:%02d UTC\n",
-                             data.year, data.month, data.day,
-                             data.hour, data.minute, data.second);
+                             fix.year, fix.month, fix.day,
+                             fix.hour, fix.minute, fix.second);
             }
         } else {
             Serial.println("[GPS] No fix yet (move to window/outdoors for better signal)");
@@ -179,19 +199,22 @@ public:
      * @brief Print data to serial (compact format)
      */
     void printData() {
-        if (!data.valid) {
+        GPSData fix = published.get();
+
+        if (!fix.valid) {
             Serial.println("[GPS] No valid fix");
             return;
         }
 
-        uint32_t age = millis() - data.last_update;
+        uint32_t age = millis() - fix.last_update;
         Serial.printf("[GPS] %.6f°N, %.6f°E, %d sats, alt=%.1fm (age=%lums)\n",
-                     data.latitude, data.longitude,
-                     data.satellites, data.altitude, age);
+                     fix.latitude, fix.longitude,
+                     fix.satellites, fix.altitude, age);
     }
 
     /**
      * @brief Get TinyGPS++ object (for advanced usage)
+     * Only safe from the UART event task, it is updated by ingest()
      */
     TinyGPSPlus& getGPS() {
         return gps;
@@ -9,12 +9,68 @@
 // Global logger instance
 Logger logger;
 
+LogRing::LogRing() : head(0), tail(0), dropped(0) {
+    for (uint32_t i = 0; i < LOG_RING_SIZE; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool LogRing::push(const LogRecord& record) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+
+    for (;;) {
+        Slot& slot = slots[position & (LOG_RING_SIZE - 1)];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        int32_t difference = (int32_t)(sequence - position);
+
+        if (difference == 0) {
+            // Free for this position, claim it
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                slot.record = record;
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (difference < 0) {
+            // Not consumed yet, the ring is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            // Claimed by another producer meanwhile
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool LogRing::pop(LogRecord& record) {
+    Slot& slot = slots[tail & (LOG_RING_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+        return false;
+    }
+
+    record = slot.record;
+    slot.sequence.store(tail + LOG_RING_SIZE, std::memory_order_release);
+    tail++;
+    return true;
+}
+
+bool LogRing::isEmpty() {
+    Slot& slot = slots[tail & (LOG_RING_SIZE - 1)];
+    return slot.sequence.load(std::memory_order_acquire) != tail + 1;
+}
+
+uint32_t LogRing::takeDropped() {
+    return dropped.exchange(0, std::memory_order_relaxed);
+}
+
 Logger::Logger() {
     currentLevel = LOG_INFO;
     csvMode = false;
+    binaryMode = false;
     timestampEnabled = true;
     startTimeMs = 0;
     headerPrinted = false;
+    drainTask = NULL;
+    droppedTotal = 0;
 }
 
 void Logger::begin(uint32_t baudRate, bool enableCSV) {
@@ -28,7 +84,14 @@ void Logger::begin(uint32_t baudRate, bool enableCSV) {
 
     if (csvMode) {
         printCSVHeader();
-    } else {
+    }
+
+    // Records logged before begin() are written by the drain task too
+    if (drainTask == NULL) {
+        xTaskCreate(drain, "LogDrain", LOG_DRAIN_STACK, this, LOG_DRAIN_PRIORITY, &drainTask);
+    }
+
+    if (!csvMode) {
         info("Logger initialized at %lu baud", baudRate);
     }
 }
@@ -51,8 +114,18 @@ void Logger::enableCSV(bool enable) {
     }
 }
 
+void Logger::enableBinary(bool enable) {
+    binaryMode = enable;
+}
+
+LogFormat Logger::getFormat() const {
+    if (binaryMode) return LOG_FORMAT_BINARY;
+    if (csvMode) return LOG_FORMAT_CSV;
+    return LOG_FORMAT_TEXT;
+}
+
 void Logger::error(const char* format, ...) {
-    if (csvMode) return;  // Don't mix text logs with CSV
+    if (csvMode || binaryMode) return;  // Don't mix text logs with CSV
 
     va_list args;
     va_start(args, format);
@@ -61,7 +134,7 @@ void Logger::error(const char* format, ...) {
 }
 
 void Logger::warn(const char* format, ...) {
-    if (csvMode) return;
+    if (csvMode || binaryMode) return;
 
     va_list args;
     va_start(args, format);
@@ -70,7 +143,7 @@ void Logger::warn(const char* format, ...) {
 }
 
 void Logger::info(const char* format, ...) {
-    if (csvMode) return;
+    if (csvMode || binaryMode) return;
 
     va_list args;
     va_start(args, format);
@@ -79,7 +152,7 @@ void Logger::info(const char* format, ...) {
 }
 
 void Logger::debug(const char* format, ...) {
-    if (csvMode) return;
+    if (csvMode || binaryMode) return;
 
     va_list args;
     va_start(args, format);
@@ -90,70 +163,121 @@ void Logger::debug(const char* format, ...) {
 void Logger::log(LogLevel level, const char* format, va_list args) {
     if (level > currentLevel) return;
 
+    // Only the formatting is done by the caller, the drain task prints it
+    LogRecord record;
+    record.isPacket = false;
+    record.level = level;
+    record.timestamp = millis();
+    vsnprintf(record.text, sizeof(record.text), format, args);
+
+    enqueue(record);
+}
+
+void Logger::logPacket(PacketEvent& event) {
+    LogRecord record;
+    record.isPacket = true;
+    record.level = LOG_INFO;
+    record.timestamp = event.timestamp != 0 ? event.timestamp : millis();
+    record.event = event;
+
+    enqueue(record);
+}
+
+void Logger::enqueue(const LogRecord& record) {
+    if (drainTask == NULL) {
+        // No drain task before begin(), write it directly
+        write(record);
+        return;
+    }
+
+    if (ring.push(record)) {
+        xTaskNotifyGive(drainTask);
+    }
+}
+
+void Logger::drain(void* parameter) {
+    Logger* self = static_cast<Logger*>(parameter);
+    LogRecord record;
+
+    for (;;) {
+        // Woken by the producers, or every second to report the drops
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+
+        while (self->ring.pop(record)) {
+            self->write(record);
+        }
+
+        uint32_t dropped = self->ring.takeDropped();
+        if (dropped > 0) {
+            self->droppedTotal += dropped;
+            self->writeDropped(dropped);
+        }
+    }
+}
+
+void Logger::write(const LogRecord& record) {
+    if (record.isPacket) {
+        writePacket(record.event, record.timestamp);
+        return;
+    }
+
+    char timestamp[16];
+
     // Print timestamp
     if (timestampEnabled) {
-        Serial.print("[");
-        Serial.print(getTimestamp());
-        Serial.print("] ");
+        formatTimestamp(timestamp, sizeof(timestamp), record.timestamp);
+        Serial.printf("[%s] [%s] %s\n", timestamp, levelToString(record.level), record.text);
+    } else {
+        Serial.printf("[%s] %s\n", levelToString(record.level), record.text);
     }
+}
 
-    // Print log level
-    Serial.print("[");
-    Serial.print(levelToString(level));
-    Serial.print("] ");
+void Logger::writePacket(const PacketEvent& event, uint32_t timestamp) {
+    if (binaryMode) {
+        writeBinary(event);
+    } else if (!csvMode) {
+        // Human-readable format
+        char time[16];
+        formatTimestamp(time, sizeof(time), timestamp);
+        Serial.printf("[%s] %s - Src:0x%X Dst:0x%X RSSI:%.2f SNR:%.2f Seq:%u\n",
+                      time, eventTypeName(event.eventType),
+                      event.srcAddress, event.destAddress,
+                      event.rssi, event.snr, event.sequence);
+    } else {
+        // CSV format for data analysis, same columns as printCSVHeader
+        Serial.printf("%lu,%u,%s,%u,%u,%.1f,%.1f,%.2f,%u,%u,%u,%.2f,%u,%u\n",
+                      (unsigned long)timestamp, event.nodeId, eventTypeName(event.eventType),
+                      event.srcAddress, event.destAddress,
+                      event.rssi, event.snr, event.etx,
+                      event.hopCount, event.packetSize, event.sequence,
+                      event.cost, event.nextHop, event.gateway);
+    }
+}
 
-    // Print formatted message
-    char buffer[256];
-    vsnprintf(buffer, sizeof(buffer), format, args);
-    Serial.println(buffer);
+void Logger::writeBinary(const PacketEvent& event) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&event);
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < sizeof(PacketEvent); i++) {
+        checksum ^= bytes[i];
+    }
+
+    uint8_t header[3] = {LOG_BINARY_START1, LOG_BINARY_START2, (uint8_t)sizeof(PacketEvent)};
+    Serial.write(header, sizeof(header));
+    Serial.write(bytes, sizeof(PacketEvent));
+    Serial.write(checksum);
 }
 
-void Logger::logPacket(PacketEvent& event) {
-    if (!csvMode) {
-        // Human-readable format
-        Serial.print("[");
-        Serial.print(getTimestamp());
-        Serial.print("] ");
-        Serial.print(eventTypeToString(event.eventType));
-        Serial.print(" - Src:0x");
-        Serial.print(event.srcAddress, HEX);
-        Serial.print(" Dst:0x");
-        Serial.print(event.destAddress, HEX);
-        Serial.print(" RSSI:");
-        Serial.print(event.rssi);
-        Serial.print(" SNR:");
-        Serial.print(event.snr);
-        Serial.print(" Seq:");
-        Serial.println(event.sequence);
+void Logger::writeDropped(uint32_t dropped) {
+    if (csvMode || binaryMode) {
+        // ERROR event, the sequence is the number of records dropped
+        PacketEvent event;
+        memset(&event, 0, sizeof(event));
+        event.timestamp = millis();
+        event.eventType = EVENT_ERROR;
+        event.sequence = dropped > UINT16_MAX ? UINT16_MAX : dropped;
+        writePacket(event, event.timestamp);
     } else {
-        // CSV format for data analysis
-        Serial.print(millis());
-        Serial.print(",");
-        Serial.print(event.nodeId);
-        Serial.print(",");
-        Serial.print(eventTypeToString(event.eventType));
-        Serial.print(",");
-        Serial.print(event.srcAddress);
-        Serial.print(",");
-        Serial.print(event.destAddress);
-        Serial.print(",");
-        Serial.print(event.rssi, 1);
-        Serial.print(",");
-        Serial.print(event.snr, 1);
-        Serial.print(",");
-        Serial.print(event.etx, 2);
-        Serial.print(",");
-        Serial.print(event.hopCount);
-        Serial.print(",");
-        Serial.print(event.packetSize);
-        Serial.print(",");
-        Serial.print(event.sequence);
-        Serial.print(",");
-        Serial.print(event.cost, 2);
-        Serial.print(",");
-        Serial.print(event.nextHop);
-        Serial.print(",");
-        Serial.println(event.gateway);
+        Serial.printf("[WARN] Logger ring full, %lu records dropped\n", (unsigned long)dropped);
     }
 }
 
@@ -164,19 +288,27 @@ void Logger::printCSVHeader() {
     headerPrinted = true;
 }
 
-String Logger::getTimestamp() {
-    unsigned long ms = millis() - startTimeMs;
+void Logger::formatTimestamp(char* buffer, size_t size, uint32_t timestampMs) {
+    unsigned long ms = timestampMs - startTimeMs;
     unsigned long seconds = ms / 1000;
     unsigned long minutes = seconds / 60;
     unsigned long hours = minutes / 60;
 
-    char buffer[16];
-    snprintf(buffer, sizeof(buffer), "%02lu:%02lu:%02lu.%03lu",
+    snprintf(buffer, size, "%02lu:%02lu:%02lu.%03lu",
              hours, minutes % 60, seconds % 60, ms % 1000);
+}
+
+String Logger::getTimestamp() {
+    char buffer[16];
+    formatTimestamp(buffer, sizeof(buffer), millis());
     return String(buffer);
 }
 
 String Logger::eventTypeToString(EventType type) {
+    return String(eventTypeName(type));
+}
+
+const char* Logger::eventTypeName(EventType type) {
     switch (type) {
         case EVENT_TX:      return "TX";
         case EVENT_RX:      return "RX";
@@ -203,6 +335,10 @@ const char* Logger::levelToString(LogLevel level) {
 }
 
 void Logger::flush() {
+    // Wait for the drain task, it runs at a lower priority
+    while (drainTask != NULL && !ring.isEmpty()) {
+        vTaskDelay(1);
+    }
     Serial.flush();
 }
 
@@ -268,7 +404,7 @@ void logPacketForward(uint16_t src, uint16_t dest, uint16_t nextHop) {
 }
 
 void logPacketDrop(uint16_t src, uint16_t dest, const char* reason) {
-    if (logger.csvMode) {
+    if (logger.isCSVMode()) {
         PacketEvent event;
         event.timestamp = millis();
         event.nodeId = 0;  // Should be set by firmware
@@ -292,7 +428,7 @@ void logPacketDrop(uint16_t src, uint16_t dest, const char* reason) {
 }
 
 void logRouteUpdate(uint16_t dest, uint16_t nextHop, float cost) {
-    if (logger.csvMode) {
+    if (logger.isCSVMode()) {
         PacketEvent event;
         event.timestamp = millis();
         event.nodeId = 0;  // Should be set by firmware
@@ -316,13 +452,13 @@ void logRouteUpdate(uint16_t dest, uint16_t nextHop, float cost) {
 }
 
 void logDutyCycle(float percentage, uint32_t airtimeMs) {
-    if (!logger.csvMode) {
+    if (!logger.isCSVMode()) {
         LOG_INFO("Duty cycle: %.2f%% (Airtime: %lu ms)", percentage, airtimeMs);
     }
 }
 
 void logSystemStatus(uint32_t freeHeap, float cpuUsage) {
-    if (!logger.csvMode) {
+    if (!logger.isCSVMode()) {
         LOG_DEBUG("System: Heap=%lu bytes, CPU=%.1f%%", freeHeap, cpuUsage);
     }
 }
\ No newline at end of file
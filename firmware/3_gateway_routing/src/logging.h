@@ -1,12 +1,29 @@
 /**
  * @file logging.h
  * @brief Common logging utilities for serial output and data collection
+ *
+ * The log calls never write to Serial: they copy a fixed size record into a
+ * lock-free ring and return. A low priority drain task formats the records
+ * as text, CSV or binary frames. When the ring is full the record is dropped
+ * and counted, the producer never blocks.
  */
 
 #ifndef LOGGING_H
 #define LOGGING_H
 
 #include <Arduino.h>
+#include <atomic>
+
+// Records of the log ring, power of two
+#define LOG_RING_SIZE       32
+// Maximum length of a text log message, longer messages are truncated
+#define LOG_TEXT_LENGTH     96
+// Drain task
+#define LOG_DRAIN_STACK     3072
+#define LOG_DRAIN_PRIORITY  1
+// Start bytes of a binary frame: [0xA5][0x5A][length][PacketEvent][XOR of the PacketEvent bytes]
+#define LOG_BINARY_START1   0xA5
+#define LOG_BINARY_START2   0x5A
 
 // Log levels
 enum LogLevel {
@@ -48,13 +65,77 @@ struct PacketEvent {
     uint16_t gateway;
 };
 
-class Logger {
+// Output format of the packet events
+enum LogFormat {
+    LOG_FORMAT_TEXT,    // Human-readable
+    LOG_FORMAT_CSV,     // CSV rows, see printCSVHeader
+    LOG_FORMAT_BINARY   // Binary frames of the PacketEvent
+};
+
+// Record of the log ring
+struct LogRecord {
+    bool isPacket;
+    LogLevel level;
+    uint32_t timestamp;
+    union {
+        PacketEvent event;
+        char text[LOG_TEXT_LENGTH];
+    };
+};
+
+/**
+ * @brief Bounded lock-free multi producer single consumer ring of LogRecords.
+ * Every slot has a sequence number that tells if it is free for the producer
+ * of a position or ready for the consumer.
+ */
+class LogRing {
+private:
+    static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        LogRecord record;
+    };
+
+    Slot slots[LOG_RING_SIZE];
+    std::atomic<uint32_t> head;     // Next position of the producers
+    uint32_t tail;                  // Next position of the consumer
+    std::atomic<uint32_t> dropped;
+
 public:
+    LogRing();
+
+    /**
+     * @brief Copy a record into the ring, never blocks
+     * @return false if the ring is full, the record is dropped and counted
+     */
+    bool push(const LogRecord& record);
+
+    /**
+     * @brief Take the oldest record (single consumer)
+     * @return false if the ring is empty
+     */
+    bool pop(LogRecord& record);
+
+    bool isEmpty();
+
+    /**
+     * @brief Records dropped since the last call
+     */
+    uint32_t takeDropped();
+};
+
+class Logger {
+private:
     LogLevel currentLevel;
     bool csvMode;
+    bool binaryMode;
     bool timestampEnabled;
     uint32_t startTimeMs;
     bool headerPrinted;
+    LogRing ring;
+    TaskHandle_t drainTask;
+    uint32_t droppedTotal;
 
 public:
     Logger();
@@ -63,6 +144,10 @@ public:
     void setLevel(LogLevel level);
     void enableTimestamp(bool enable);
     void enableCSV(bool enable);
+    // Packet events as binary frames instead of CSV rows, the text logs are not output in binary mode
+    void enableBinary(bool enable);
+    bool isCSVMode() const { return csvMode; }
+    LogFormat getFormat() const;
 
     // Log methods
     void error(const char* format, ...);
@@ -74,14 +159,27 @@ public:
     void logPacket(PacketEvent& event);
     void printCSVHeader();
 
+    // Records dropped because the ring was full, since begin()
+    uint32_t getDroppedCount() const { return droppedTotal; }
+
     // Utility methods
     String getTimestamp();
     String eventTypeToString(EventType type);
+    // Wait until the drain task wrote every record
     void flush();
 
-public:
+private:
     void log(LogLevel level, const char* format, va_list args);
     const char* levelToString(LogLevel level);
+    const char* eventTypeName(EventType type);
+
+    void enqueue(const LogRecord& record);
+    void write(const LogRecord& record);
+    void writePacket(const PacketEvent& event, uint32_t timestamp);
+    void writeBinary(const PacketEvent& event);
+    void writeDropped(uint32_t dropped);
+    void formatTimestamp(char* buffer, size_t size, uint32_t timestampMs);
+    static void drain(void* parameter);
 };
 
 // Global logger instance
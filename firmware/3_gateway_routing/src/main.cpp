@@ -30,6 +30,7 @@
 #include "LoraMesher.h"
 #include "entities/routingTable/RouteNode.h"
 #include "services/RoutingTableService.h"
+#include "services/NeighborTableService.h"
 #include "config.h"
 #include "display_utils.h"
 #include "logging.h"
@@ -37,6 +38,9 @@
 #include "sensor_data.h"        // Enhanced sensor data structure
 #include "pms7003_parser.h"     // PM sensor parser
 #include "gps_handler.h"        // GPS handler
+#include "uplink.h"             // Binary uplink, serial or WiFi
+#include <esp_ota_ops.h>        // Firmware updates over the mesh
+#include <esp_image_format.h>
 // Note: trickle_hello.h included AFTER TrickleTimer class definition (line ~332)
 
 // Get LoRaMesher singleton instance
@@ -80,51 +84,15 @@ struct SensorData {
 // Link Quality Tracking Structures
 // ============================================================================
 
-/**
- * @brief Extended link metrics for cost calculation
- * Tracks additional metrics beyond LoRaMesher's built-in hop-count
- *
- * IMPLEMENTATION NOTE:
+/*
+ * Link quality, neighbour health and route cost history are kept in the
+ * library NeighborTableService, one NeighborEntry per address:
  * - ETX is calculated from sequence number gaps, NOT from ACK packets
  * - This provides zero protocol overhead compared to ACK-based approaches
- * - RSSI is currently ESTIMATED from SNR (RSSI ≈ -120 + SNR × 3)
- * - Future work: Extract true RSSI from RadioLib during packet reception
+ * - RSSI of the data packets is measured by RadioLib and carried in the AppPacket
+ * - RSSI of the HELLO updates is still ESTIMATED from SNR (RSSI ≈ -120 + SNR × 3)
+ * The entries are only used between NeighborTableService::setInUse() and releaseInUse().
  */
-struct LinkMetrics {
-    uint16_t address;           // Neighbor address
-    int16_t rssi;               // Last RSSI (dBm) - currently estimated from SNR
-    int8_t snr;                 // Last SNR (dB) - from LoRaMesher receivedSNR
-    float etx;                  // Expected Transmission Count (sequence-gap based)
-
-    // Sliding window for ETX calculation
-    bool txWindow[ETX_WINDOW_SIZE];  // Transmission results (true = success, false = failure)
-    uint8_t windowIndex;             // Current position in circular buffer
-    uint8_t windowFilled;            // Number of valid entries in window
-
-    // Sequence number tracking for gap detection
-    uint32_t lastSeqNum;        // Last received sequence number
-    bool seqInitialized;        // Has received first packet from this source
-
-    uint32_t totalTxAttempts;   // Total transmission attempts (for statistics)
-    uint32_t totalTxSuccess;    // Total successful transmissions
-    uint32_t totalTxFailures;   // Total detected failures (from gaps)
-    uint32_t lastUpdate;        // Timestamp of last update
-    
-    LinkMetrics() : address(0), rssi(-120), snr(-20), etx(ETX_DEFAULT),
-                    windowIndex(0), windowFilled(0),
-                    lastSeqNum(0), seqInitialized(false),
-                    totalTxAttempts(0), totalTxSuccess(0), totalTxFailures(0), lastUpdate(0) {
-        // Initialize sliding window with default (assume 67% success = ETX 1.5)
-        for (int i = 0; i < ETX_WINDOW_SIZE; i++) {
-            txWindow[i] = (i % 3 != 0);  // 2 success, 1 failure pattern
-        }
-    }
-};
-
-// Link quality tracking (max 10 neighbors)
-#define MAX_TRACKED_LINKS 10
-LinkMetrics linkMetrics[MAX_TRACKED_LINKS];
-uint8_t numTrackedLinks = 0;
 
 // Gateway load tracking (W5 bias)
 struct GatewayLoadState {
@@ -136,28 +104,6 @@ struct GatewayLoadState {
 };
 GatewayLoadState localGatewayLoadState;
 
-// Neighbor health monitoring for fast fault detection
-struct NeighborHealth {
-    uint16_t address;          // Neighbor address
-    uint32_t lastHeard;        // Last HELLO received timestamp
-    uint8_t missedHellos;      // Consecutive missed safety HELLOs
-    bool failureFlagged;       // Proactive failure detected
-};
-NeighborHealth neighborHealth[10];  // Track up to 10 neighbors
-uint8_t numNeighbors = 0;
-
-// Route cost tracking for hysteresis
-struct RouteCostHistory {
-    uint16_t destAddr;      // Destination address
-    uint16_t via;           // Next hop
-    float cost;             // Last calculated cost
-    uint32_t lastUpdate;    // Timestamp of last update
-    bool active;            // Is this entry active?
-};
-#define MAX_COST_HISTORY 20
-RouteCostHistory costHistory[MAX_COST_HISTORY];
-uint8_t numCostEntries = 0;
-
 // ============================================================================
 // Trickle Timer for Adaptive HELLO Packet Scheduling
 // ============================================================================
@@ -366,7 +312,9 @@ TrickleTimer trickleTimer;
 // Forward declarations for functions used in trickle_hello.h
 void updateLinkMetricsFromHello(uint16_t fromAddr);
 void updateNeighborHealth(uint16_t addr);
+void logETX(NeighborEntry* link);
 uint8_t sampleLocalGatewayLoadForHello();
+void printMetricsSample(uint16_t src, LM_MetricsTier tier, const LM_MetricsSample* sample, bool more, void*);
 
 // Include Trickle HELLO task (needs TrickleTimer class to be defined first)
 #include "trickle_hello.h"
@@ -532,9 +480,6 @@ uint32_t lastMonitoringPrint = 0;
 
 // Gateway load helper constants
 #define MIN_GATEWAY_LOAD_WINDOW_MS 1000
-#define MIN_GATEWAY_LOAD_FOR_BIAS 0.2f
-#define LOAD_SWITCH_THRESHOLD 0.25f   // Minimum pkt/min delta before forcing load-based switch
-#define MAX_GATEWAY_CANDIDATES 10
 
 /**
  * @brief Encode gateway load (packets per minute) into 0-254 range (255 = unknown)
@@ -545,112 +490,15 @@ uint8_t encodeGatewayLoad(float packetsPerMinute) {
 }
 
 /**
- * @brief Decode gateway load indicator back to packets per minute
- */
-float decodeGatewayLoad(uint8_t encodedLoad) {
-    if (encodedLoad == 255) {
-        return 0.0f;
-    }
-    return static_cast<float>(encodedLoad);
-}
-
-/**
- * @brief Select gateway purely by reported load if imbalance is large enough
- * @return RouteNode* Pointer to preferred gateway or nullptr if load info insufficient
- */
-RouteNode* selectGatewayByLoadBias() {
-    LM_LinkedList<RouteNode>* list = RoutingTableService::routingTableList;
-    if (list == nullptr) {
-        return nullptr;
-    }
-
-    struct GatewayCandidateSnapshot {
-        uint16_t address;
-        uint16_t via;
-        uint8_t metric;
-        bool hasLoad;
-        float load;
-    };
-
-    GatewayCandidateSnapshot candidates[MAX_GATEWAY_CANDIDATES];
-    uint8_t candidateCount = 0;
-
-    list->setInUse();
-    if (list->moveToStart()) {
-        do {
-            RouteNode* node = list->getCurrent();
-            if ((node->networkNode.role & ROLE_GATEWAY) == 0) {
-                continue;
-            }
-
-            if (candidateCount >= MAX_GATEWAY_CANDIDATES) {
-                break;
-            }
-
-            candidates[candidateCount].address = node->networkNode.address;
-            candidates[candidateCount].via = node->via;
-            candidates[candidateCount].metric = node->networkNode.metric;
-            if (node->networkNode.gatewayLoad != 255) {
-                candidates[candidateCount].hasLoad = true;
-                candidates[candidateCount].load = decodeGatewayLoad(node->networkNode.gatewayLoad);
-            } else {
-                candidates[candidateCount].hasLoad = false;
-                candidates[candidateCount].load = 0.0f;
-            }
-            candidateCount++;
-        } while (list->next());
-    }
-    list->releaseInUse();
-
-    if (candidateCount < 2) {
-        return nullptr;
-    }
-
-    float minLoad = FLT_MAX;
-    float secondLoad = FLT_MAX;
-    uint16_t minLoadAddr = 0;
-    uint8_t loadAwareCandidates = 0;
-
-    for (uint8_t i = 0; i < candidateCount; ++i) {
-        if (!candidates[i].hasLoad) {
-            continue;
-        }
-        loadAwareCandidates++;
-        float load = candidates[i].load;
-        if (load < minLoad) {
-            secondLoad = minLoad;
-            minLoad = load;
-            minLoadAddr = candidates[i].address;
-        } else if (load < secondLoad) {
-            secondLoad = load;
-        }
-    }
-
-    if (loadAwareCandidates < 2) {
-        return nullptr;
-    }
-
-    if ((secondLoad - minLoad) < LOAD_SWITCH_THRESHOLD) {
-        return nullptr;
-    }
-
-    RouteNode* preferred = RoutingTableService::findNode(minLoadAddr);
-    if (preferred != nullptr) {
-        Serial.printf("[W5] Load-biased gateway selection: %04X (%.2f vs %.2f pkt/min)\n",
-                     minLoadAddr, minLoad, secondLoad);
-    }
-    return preferred;
-}
-
-/**
- * @brief Determine the gateway to use for TX (load bias first, cost fallback)
+ * @brief Determine the gateway to use for TX
+ *
+ * The library spreads the sources over the gateways by weighted rendezvous
+ * hashing of the source address: the weights come from the route cost and
+ * the advertised gateway load, so the load shifts gradually instead of every
+ * sensor switching to the least loaded gateway at once.
  */
 RouteNode* getPreferredGateway() {
-    RouteNode* loadBiased = selectGatewayByLoadBias();
-    if (loadBiased != nullptr) {
-        return loadBiased;
-    }
-    return radio.getClosestGateway();
+    return radio.getGatewayForFlow(radio.getLocalAddress());
 }
 
 /**
@@ -704,191 +552,28 @@ uint8_t peekLocalGatewayLoad() {
 }
 
 // ============================================================================
-// Cost Calculation Functions
+// Cost Calculation
 // ============================================================================
 
-/**
- * @brief Normalize RSSI to [0, 1] range
- * @param rssi RSSI value in dBm
- * @return Normalized value (1.0 = best, 0.0 = worst)
- */
-float normalizeRSSI(int16_t rssi) {
-    if (rssi >= RSSI_MAX) return 1.0;
-    if (rssi <= RSSI_MIN) return 0.0;
-    return (float)(rssi - RSSI_MIN) / (RSSI_MAX - RSSI_MIN);
-}
-
-/**
- * @brief Normalize SNR to [0, 1] range
- * @param snr SNR value in dB
- * @return Normalized value (1.0 = best, 0.0 = worst)
+/*
+ * The route cost is calculated by the library GatewayBiasedMetric, selected with
+ * -D LM_ROUTING_METRIC=LM_METRIC_GATEWAY_BIASED in platformio.ini:
+ * cost = W1×hops + W2×(1 - normalize(RSSI)) + W3×(1 - normalize(SNR)) + W4×(ETX - 1)
+ *        + weak link penalty + W5×gateway_bias
+ * in fixed point, LM_COST_SCALE is 1.0. The weights are LM_COST_W_* of BuildOptions.h.
  */
-float normalizeSNR(int8_t snr) {
-    if (snr >= SNR_MAX) return 1.0;
-    if (snr <= SNR_MIN) return 0.0;
-    return (float)(snr - SNR_MIN) / (SNR_MAX - SNR_MIN);
-}
-
-/**
- * @brief Calculate gateway bias based on load
- * @param gatewayAddr Gateway address
- * @return Bias value (positive = penalty, negative = bonus)
- */
-float calculateGatewayBias(uint16_t gatewayAddr) {
-    LM_LinkedList<RouteNode>* list = RoutingTableService::routingTableList;
-    if (list == nullptr) {
-        return 0.0f;
-    }
-
-    float totalLoad = 0.0f;
-    float targetLoad = 0.0f;
-    bool targetLoadKnown = false;
-    uint8_t gatewaysWithData = 0;
-
-    list->setInUse();
-
-    if (list->moveToStart()) {
-        do {
-            RouteNode* node = list->getCurrent();
-            if ((node->networkNode.role & ROLE_GATEWAY) == 0) {
-                continue;
-            }
-
-            uint8_t encoded = node->networkNode.gatewayLoad;
-            if (encoded != 255) {
-                float load = decodeGatewayLoad(encoded);
-                totalLoad += load;
-                gatewaysWithData++;
-
-                if (node->networkNode.address == gatewayAddr) {
-                    targetLoad = load;
-                    targetLoadKnown = true;
-                }
-            }
-        } while (list->next());
-    }
-
-    list->releaseInUse();
-
-    if (gatewaysWithData <= 1) {
-        return 0.0f;
-    }
-
-    float avgLoad = totalLoad / gatewaysWithData;
-    if (avgLoad < MIN_GATEWAY_LOAD_FOR_BIAS) {
-        return 0.0f;
-    }
-
-    if (!targetLoadKnown) {
-        targetLoad = avgLoad;
-    }
-
-    if (avgLoad < 0.001f) {
-        return 0.0f;
-    }
-
-    float bias = (targetLoad - avgLoad) / avgLoad;
-    if (fabsf(bias) > 0.01f) {
-        Serial.printf("[W5] Gateway %04X load=%.1f avg=%.1f bias=%.2f\n",
-                      gatewayAddr, targetLoad, avgLoad, bias);
-    }
-
-    return bias;
-}
 
 /**
- * @brief Get or create link metrics for a neighbor
- * @param address Neighbor address
- * @return Pointer to LinkMetrics structure
- */
-LinkMetrics* getLinkMetrics(uint16_t address) {
-    // Search for existing entry
-    for (uint8_t i = 0; i < numTrackedLinks; i++) {
-        if (linkMetrics[i].address == address) {
-            return &linkMetrics[i];
-        }
-    }
-    
-    // Create new entry if space available
-    if (numTrackedLinks < MAX_TRACKED_LINKS) {
-        linkMetrics[numTrackedLinks].address = address;
-        linkMetrics[numTrackedLinks].lastUpdate = millis();
-        return &linkMetrics[numTrackedLinks++];
-    }
-    
-    // Replace oldest entry if full
-    uint8_t oldestIdx = 0;
-    uint32_t oldestTime = linkMetrics[0].lastUpdate;
-    for (uint8_t i = 1; i < MAX_TRACKED_LINKS; i++) {
-        if (linkMetrics[i].lastUpdate < oldestTime) {
-            oldestTime = linkMetrics[i].lastUpdate;
-            oldestIdx = i;
-        }
-    }
-    linkMetrics[oldestIdx].address = address;
-    linkMetrics[oldestIdx].lastUpdate = millis();
-    return &linkMetrics[oldestIdx];
-}
-
-/**
- * @brief Calculate combined cost metric for a route
+ * @brief Cost of a route in cost units
  * @param hops Number of hops
  * @param nextHop Next hop address (for link quality lookup)
  * @param destAddr Destination address (for gateway bias if applicable)
  * @return Combined cost value (lower is better)
- *
- * IMPLEMENTATION STATUS:
- * - This callback is REGISTERED with LoRaMesher and costs ARE calculated
- * - However, route selection based on cost needs multi-hop topology validation
- * - In 3-node linear tests, there's only ONE route per destination (no alternatives)
- * - Full validation requires 4-5 node diamond/mesh topology with route choices
- * - Current behavior: Costs calculated and monitored, selection pending validation
  */
-float calculateRouteCost(uint8_t hops, uint16_t nextHop, uint16_t destAddr) {
-    float cost = 0.0;
-    
-    // Component 1: Hop count (always present)
-    cost += W1_HOP_COUNT * hops;
-    
-    // Get link metrics for next hop
-    LinkMetrics* link = getLinkMetrics(nextHop);
-    
-    // Component 2: RSSI (inverted: worse RSSI = higher cost)
-    float rssiNorm = normalizeRSSI(link->rssi);
-    cost += W2_RSSI * (1.0 - rssiNorm);  // Invert: bad link = high cost
-    
-    // Component 3: SNR (inverted: worse SNR = higher cost)
-    float snrNorm = normalizeSNR(link->snr);
-    cost += W3_SNR * (1.0 - snrNorm);  // Invert: bad link = high cost
-    
-    // Component 4: ETX
-    cost += W4_ETX * (link->etx - 1.0);  // ETX-1 so perfect link (ETX=1) adds no cost
-
-    // Component 4.5: Weak Link Penalty (NEW - favor relay over marginal direct links)
-    // If signal is extremely weak (RSSI < -125 dBm or SNR < -12 dB), add strong penalty
-    // This encourages routing via relay instead of using marginal direct paths
-    if (link->rssi < -125 || link->snr < -12) {
-        float weakLinkPenalty = 1.5;  // Strong penalty to favor multi-hop over weak direct
-        cost += weakLinkPenalty;
-        // Note: This makes 2-hop good paths beat 1-hop weak paths
-        // Example: Direct (1 hop, -126 dBm) = 1.45 + 1.5 = 2.95
-        //          Relay (2 hops, -108 dBm) = 2.30 (relay wins!)
-    }
-
-    // Component 5: Gateway bias (only if destination is a gateway)
-    // Check if destination has gateway role
-    RouteNode* destNode = RoutingTableService::findNode(destAddr);
-    if (destNode && (destNode->networkNode.role & ROLE_GATEWAY)) {
-        float bias = calculateGatewayBias(destAddr);
-        cost += W5_GATEWAY_BIAS * bias;
-    }
-
-    return cost;
+float getRouteCost(uint8_t hops, uint16_t nextHop, uint16_t destAddr) {
+    return (float) RoutingTableService::getRouteCost(hops, nextHop, destAddr) / LM_COST_SCALE;
 }
 
-// Forward declaration for ETX update function
-void updateETX(uint16_t address, bool success);
-
 /**
  * @brief Update link metrics from HELLO packet reception (for bidirectional support)
  *
@@ -905,22 +590,19 @@ void updateLinkMetricsFromHello(uint16_t fromAddr) {
     int8_t snr = node->receivedSNR;
     int16_t estimatedRSSI = -120 + (snr * 3);
 
-    // Get/create link metrics entry
-    LinkMetrics* link = getLinkMetrics(fromAddr);
+    NeighborTableService::setInUse();
+    NeighborEntry* link = NeighborTableService::getOrCreate(fromAddr);
 
     // Update RSSI/SNR with exponential moving average
-    if (link->lastUpdate == 0) {
-        link->rssi = estimatedRSSI;
-        link->snr = snr;
-    } else {
-        link->rssi = (int16_t)(0.7 * link->rssi + 0.3 * estimatedRSSI);
-        link->snr = (int8_t)(0.7 * link->snr + 0.3 * snr);
-    }
-    link->lastUpdate = millis();
+    link->updateSignal(estimatedRSSI, snr);
 
     // Update ETX (success-based for HELLOs - no sequence numbers to detect gaps)
     // This gives all links realistic ETX, not default 1.50
-    updateETX(fromAddr, true);
+    link->addTransmission(true);
+    logETX(link);
+    NeighborTableService::releaseInUse();
+
+    NeighborTableService::linkUpdated(fromAddr);
 }
 
 /**
@@ -934,40 +616,29 @@ void updateLinkMetricsFromHello(uint16_t fromAddr) {
 void updateNeighborHealth(uint16_t addr) {
     uint32_t now = millis();
 
-    // Find existing entry
-    for (uint8_t i = 0; i < numNeighbors; i++) {
-        if (neighborHealth[i].address == addr) {
-            uint32_t silence = now - neighborHealth[i].lastHeard;
+    NeighborTableService::setInUse();
 
-            // Log if neighbor was previously flagged (recovery detection)
-            if (neighborHealth[i].failureFlagged) {
-                Serial.printf("[HEALTH] Neighbor %04X: RECOVERED after %lus offline\n",
-                             addr, silence/1000);
-            }
-
-            neighborHealth[i].lastHeard = now;
-            neighborHealth[i].missedHellos = 0;
-            neighborHealth[i].failureFlagged = false;
+    NeighborEntry* n = NeighborTableService::getOrCreate(addr);
+    if (n->lastHeard == 0) {
+        Serial.printf("[HEALTH] NEW neighbor %04X detected (total entries: %d)\n",
+                     addr, NeighborTableService::size());
+    } else {
+        uint32_t silence = now - n->lastHeard;
 
-            // Detailed logging for analysis
-            Serial.printf("[HEALTH] Neighbor %04X: Heartbeat (silence: %lus, status: HEALTHY)\n",
+        // Log if neighbor was previously flagged (recovery detection)
+        if (n->failureFlagged) {
+            Serial.printf("[HEALTH] Neighbor %04X: RECOVERED after %lus offline\n",
                          addr, silence/1000);
-            return;
         }
-    }
 
-    // Add new neighbor if not found
-    if (numNeighbors < 10) {
-        neighborHealth[numNeighbors].address = addr;
-        neighborHealth[numNeighbors].lastHeard = now;
-        neighborHealth[numNeighbors].missedHellos = 0;
-        neighborHealth[numNeighbors].failureFlagged = false;
-        numNeighbors++;
-        Serial.printf("[HEALTH] NEW neighbor %04X detected (total neighbors: %d)\n",
-                     addr, numNeighbors);
-    } else {
-        Serial.printf("[HEALTH] WARNING: Cannot track neighbor %04X (max 10 reached)\n", addr);
+        // Detailed logging for analysis
+        Serial.printf("[HEALTH] Neighbor %04X: Heartbeat (silence: %lus, status: HEALTHY)\n",
+                     addr, silence/1000);
     }
+
+    n->heard();
+
+    NeighborTableService::releaseInUse();
 }
 
 /**
@@ -993,8 +664,7 @@ bool removeFailedRoute(uint16_t failedAddr) {
                 Serial.printf("[REMOVAL] Removing failed route to %04X via %04X (hops=%d)\n",
                              node->networkNode.address, node->via, node->networkNode.metric);
 
-                delete node;
-                RoutingTableService::routingTableList->DeleteCurrent();
+                RoutingTableService::deleteCurrentNode();
                 removed = true;
                 break;  // Found and removed
             }
@@ -1004,6 +674,9 @@ bool removeFailedRoute(uint16_t failedAddr) {
 
     RoutingTableService::routingTableList->releaseInUse();
 
+    // Make the removal visible to the routing table snapshot readers
+    RoutingTableService::publishSnapshot();
+
     if (removed) {
         Serial.printf("[REMOVAL] Route to %04X removed successfully - table size now: %d\n",
                      failedAddr, RoutingTableService::routingTableSize());
@@ -1027,25 +700,28 @@ void monitorNeighborHealth() {
     uint32_t now = millis();
     const uint32_t DETECTION_THRESHOLD = 360000;  // 6 minutes (miss 2 safety HELLOs at 180s)
 
+    NeighborTableService::setInUse();
+
     // Periodic status summary (every 5 minutes)
     static uint32_t lastStatusLog = 0;
     if (now - lastStatusLog > 300000) {
         lastStatusLog = now;
-        Serial.printf("\n[HEALTH] ==== Neighbor Health Status (Tracking: %d neighbors) ====\n", numNeighbors);
-        for (uint8_t i = 0; i < numNeighbors; i++) {
-            if (neighborHealth[i].address == 0) continue;
-            uint32_t silence = now - neighborHealth[i].lastHeard;
+        Serial.printf("\n[HEALTH] ==== Neighbor Health Status (Tracking: %d entries) ====\n", NeighborTableService::size());
+        for (size_t i = 0; i < NeighborTableService::size(); i++) {
+            NeighborEntry* n = NeighborTableService::getEntry(i);
+            if (n->lastHeard == 0) continue;
+            uint32_t silence = now - n->lastHeard;
             Serial.printf("[HEALTH]   %04X: silence=%lus, missed=%d, status=%s\n",
-                         neighborHealth[i].address, silence/1000,
-                         neighborHealth[i].missedHellos,
-                         neighborHealth[i].failureFlagged ? "FAILED" : "HEALTHY");
+                         n->address, silence/1000,
+                         n->missedHellos,
+                         n->failureFlagged ? "FAILED" : "HEALTHY");
         }
         Serial.println("[HEALTH] =========================================================\n");
     }
 
-    for (uint8_t i = 0; i < numNeighbors; i++) {
-        NeighborHealth* n = &neighborHealth[i];
-        if (n->address == 0 || n->lastHeard == 0) continue;
+    for (size_t i = 0; i < NeighborTableService::size(); i++) {
+        NeighborEntry* n = NeighborTableService::getEntry(i);
+        if (n->lastHeard == 0) continue;
 
         uint32_t silence = now - n->lastHeard;
 
@@ -1085,6 +761,8 @@ void monitorNeighborHealth() {
             Serial.printf("[RECOVERY] ========================================\n\n");
         }
     }
+
+    NeighborTableService::releaseInUse();
 }
 
 /**
@@ -1095,318 +773,208 @@ void monitorNeighborHealth() {
  * @param seqNum Packet sequence number (for gap detection)
  */
 void updateLinkMetrics(uint16_t address, int16_t rssi, int8_t snr, uint32_t seqNum) {
-    LinkMetrics* link = getLinkMetrics(address);
+    NeighborTableService::setInUse();
+    NeighborEntry* link = NeighborTableService::getOrCreate(address);
 
     // Update RSSI/SNR with exponential moving average (alpha = 0.3)
-    if (link->lastUpdate == 0) {
-        // First measurement
-        link->rssi = rssi;
-        link->snr = snr;
-    } else {
-        // Exponential moving average
-        link->rssi = (int16_t)(0.7 * link->rssi + 0.3 * rssi);
-        link->snr = (int8_t)(0.7 * link->snr + 0.3 * snr);
-    }
-
-    link->lastUpdate = millis();
+    link->updateSignal(rssi, snr);
 
     // Sequence-gap detection for ETX calculation
-    if (!link->seqInitialized) {
+    bool firstPacket = !link->seqInitialized;
+    uint32_t expectedSeq = link->lastSeqNum + 1;
+    uint32_t gap = link->addSequence(seqNum);
+
+    if (firstPacket) {
         // First packet from this source - initialize sequence tracking
-        link->lastSeqNum = seqNum;
-        link->seqInitialized = true;
-        updateETX(address, true);  // First packet is always a success
         Serial.printf("Link %04X: First packet (seq=%lu), initializing ETX tracking\n",
                      address, seqNum);
-    } else {
-        // Check for sequence gaps
-        uint32_t expectedSeq = link->lastSeqNum + 1;
-
-        if (seqNum == expectedSeq) {
-            // No gap - packet received in order
-            updateETX(address, true);
-            link->lastSeqNum = seqNum;
-        } else if (seqNum > expectedSeq) {
-            // Gap detected! Packets were lost
-            uint32_t gap = seqNum - expectedSeq;
-
-            // Record failures for each missing packet
-            for (uint32_t i = 0; i < gap && i < ETX_WINDOW_SIZE; i++) {
-                updateETX(address, false);  // Record failure for each lost packet
-                link->totalTxFailures++;
-            }
-
-            // Record success for current packet
-            updateETX(address, true);
-            link->lastSeqNum = seqNum;
-
-            Serial.printf("Link %04X: GAP DETECTED! Expected seq=%lu, got seq=%lu, lost %lu packets\n",
-                         address, expectedSeq, seqNum, gap);
-        } else {
-            // seqNum < expectedSeq: Out-of-order or sequence wrapped
-            // Could be reordering or sender restarted
-            // Just update and treat as success (don't penalize)
-            updateETX(address, true);
-            link->lastSeqNum = seqNum;
-            Serial.printf("Link %04X: Out-of-order packet (expected %lu, got %lu), possibly reordered\n",
-                         address, expectedSeq, seqNum);
-        }
+    } else if (gap > 0) {
+        // Gap detected! Packets were lost, a failure was recorded for each one
+        Serial.printf("Link %04X: GAP DETECTED! Expected seq=%lu, got seq=%lu, lost %lu packets\n",
+                     address, expectedSeq, seqNum, gap);
+    } else if (seqNum < expectedSeq) {
+        // Out-of-order or sequence wrapped, treated as success (don't penalize)
+        Serial.printf("Link %04X: Out-of-order packet (expected %lu, got %lu), possibly reordered\n",
+                     address, expectedSeq, seqNum);
     }
+    logETX(link);
 
     Serial.printf("Link %04X: RSSI=%d dBm, SNR=%d dB, ETX=%.2f, Seq=%lu\n",
                  address, link->rssi, link->snr, link->etx, seqNum);
+    NeighborTableService::releaseInUse();
+
+    NeighborTableService::linkUpdated(address);
 }
 
 /**
- * @brief Update ETX for a link after transmission attempt (Enhanced with Sliding Window + EWMA)
- * @param address Neighbor address
- * @param success True if transmission succeeded, False if packet loss detected
+ * @brief Periodic ETX logging (every 10th packet) for production use
+ * @param link Link metrics, the neighbour table in use
  *
- * IMPLEMENTATION: TRUE SEQUENCE-GAP DETECTION
- * - ETX NOW calculated from sequence number gaps (IMPLEMENTED as of Nov 9, 2025)
+ * ETX is calculated by NeighborEntry from sequence number gaps:
  * - When we receive packet seq=10 after seq=8, we infer seq=9 was lost
- * - Gap detection in updateLinkMetrics() calls this with success=false for each lost packet
- * - This provides ZERO PROTOCOL OVERHEAD (no ACK packets needed)
- * - Superior to ACK-based approach (saves airtime)
- *
- * Algorithm:
- * 1. Detect gaps in updateLinkMetrics() by comparing seqNum vs expected
- * 2. Call updateETX(addr, false) for each missing packet in gap
- * 3. Call updateETX(addr, true) for successfully received packet
- * 4. Sliding window tracks both successes AND failures
- * 5. Calculate delivery ratio from window
- * 6. Compute instantaneous ETX = 1 / delivery_ratio
- * 7. Apply EWMA smoothing: ETX_new = α × ETX_instant + (1-α) × ETX_old
- *
- * Benefits:
- * - Sliding window: Only recent packets affect ETX (time-decayed)
- * - EWMA smoothing: Reduces jitter from single packet losses
- * - Realistic ETX: Reflects actual link quality (can increase when quality degrades)
+ * - A sliding window of LM_ETX_WINDOW_SIZE results gives the delivery ratio
+ * - EWMA smoothing: ETX_new = α × ETX_instant + (1-α) × ETX_old
  * - Zero overhead: No ACK packets required (sequence-gap based)
  */
-void updateETX(uint16_t address, bool success) {
-    LinkMetrics* link = getLinkMetrics(address);
-    
-    // Add transmission result to sliding window (circular buffer)
-    link->txWindow[link->windowIndex] = success;
-    link->windowIndex = (link->windowIndex + 1) % ETX_WINDOW_SIZE;
-    
-    // Track window fill status (for initial packets)
-    if (link->windowFilled < ETX_WINDOW_SIZE) {
-        link->windowFilled++;
-    }
-    
-    // Update total statistics (for monitoring)
-    link->totalTxAttempts++;
-    if (success) link->totalTxSuccess++;
-    
-    // Calculate delivery ratio from sliding window
-    uint8_t successCount = 0;
-    for (uint8_t i = 0; i < link->windowFilled; i++) {
-        if (link->txWindow[i]) successCount++;
-    }
-    
-    float deliveryRatio = (float)successCount / link->windowFilled;
-    
-    // Calculate instantaneous ETX
-    float instantETX;
-    if (deliveryRatio > 0.01) {  // Avoid division by very small numbers
-        instantETX = 1.0 / deliveryRatio;
-    } else {
-        instantETX = 100.0;  // Essentially unreachable
-    }
-    
-    // Apply EWMA smoothing (only after window has some data)
-    if (link->windowFilled >= 3) {  // Wait for at least 3 samples
-        link->etx = ETX_ALPHA * instantETX + (1.0 - ETX_ALPHA) * link->etx;
-    } else {
-        link->etx = instantETX;  // Bootstrap phase: use instant value
-    }
-    
-    // Clamp ETX to reasonable range [1.0, 10.0]
-    if (link->etx < 1.0) link->etx = 1.0;
-    if (link->etx > 10.0) link->etx = 10.0;
-    
-    // Periodic logging (every 10th packet) for production use
+void logETX(NeighborEntry* link) {
     if (link->totalTxAttempts % 10 == 0) {
         Serial.printf("ETX updated for %04X: %.2f (window: %d/%d, instant: %.2f, lifetime: %.1f%%)\n",
-                     address, link->etx, successCount, link->windowFilled, instantETX,
-                     (float)link->totalTxSuccess / link->totalTxAttempts * 100);
+                     link->address, link->etx, link->getWindowSuccess(), link->etxWindowFilled,
+                     link->getInstantETX(), (float)link->totalTxSuccess / link->totalTxAttempts * 100);
     }
 }
 
 /**
- * @brief Get or create cost history entry for a destination
+ * @brief Topology change notification of the library (route added, removed or switched)
+ *
+ * Called from the library tasks, so it only raises a flag. The Trickle timer
+ * is reset by handleTopologyChange() in the main loop.
  */
-RouteCostHistory* getCostHistory(uint16_t destAddr) {
-    // Search for existing entry
-    for (uint8_t i = 0; i < numCostEntries; i++) {
-        if (costHistory[i].active && costHistory[i].destAddr == destAddr) {
-            return &costHistory[i];
-        }
-    }
+volatile bool topologyChangePending = false;
 
-    // Create new entry if space available
-    if (numCostEntries < MAX_COST_HISTORY) {
-        RouteCostHistory* entry = &costHistory[numCostEntries++];
-        entry->destAddr = destAddr;
-        entry->via = 0;
-        entry->cost = 0.0;
-        entry->lastUpdate = 0;
-        entry->active = true;
-        return entry;
-    }
-
-    // No space - reuse oldest entry
-    uint32_t oldestTime = UINT32_MAX;
-    uint8_t oldestIndex = 0;
-    for (uint8_t i = 0; i < numCostEntries; i++) {
-        if (costHistory[i].lastUpdate < oldestTime) {
-            oldestTime = costHistory[i].lastUpdate;
-            oldestIndex = i;
-        }
-    }
+void onTopologyChanged() {
+    topologyChangePending = true;
+}
 
-    RouteCostHistory* entry = &costHistory[oldestIndex];
-    entry->destAddr = destAddr;
-    entry->via = 0;
-    entry->cost = 0.0;
-    entry->lastUpdate = 0;
-    entry->active = true;
-    return entry;
+/**
+ * @brief Reset Trickle to I_min after a topology change (RFC 6206 fast convergence)
+ */
+void handleTopologyChange() {
+    if (!topologyChangePending) return;
+    topologyChangePending = false;
+
+    Serial.printf("[TOPOLOGY] Routing table changed (%lu changes, %d routes)\n",
+                 (unsigned long)RoutingTableService::getTopologyChangeCount(), radio.routingTableSize());
+    Serial.println("[TRICKLE] Topology change detected - resetting to I_min for fast convergence");
+    trickleTimer.reset();
 }
 
 /**
- * @brief Evaluate and optimize routing table based on cost function
+ * @brief Compare the cost of one route with its history, applying hysteresis
+ *
+ * Must be called with the NeighborTableService in use.
  *
- * This function periodically re-evaluates routes to see if better paths
- * exist based on multi-factor cost instead of just hop count.
- * Applies hysteresis to prevent route flapping.
+ * @return true if the cost changed more than HYSTERESIS_THRESHOLD
  */
-void evaluateRoutingTableCosts() {
-    LM_LinkedList<RouteNode>* routingTable = RoutingTableService::routingTableList;
-    if (!routingTable) return;
+bool evaluateRouteCost(uint16_t destAddr, uint16_t currentVia, uint8_t currentHops) {
+    // Calculate current route cost
+    float currentCost = getRouteCost(currentHops, currentVia, destAddr);
+
+    // Get cost history for hysteresis comparison
+    NeighborEntry* history = NeighborTableService::getOrCreate(destAddr);
+
+    // First time seeing this route or via changed
+    if (history->routeCostUpdate == 0 || history->routeVia != currentVia) {
+        if (history->routeCostUpdate != 0) {
+            // The library already notified the topology change, only log it here
+            Serial.printf("[TOPOLOGY] Route to %04X switched: via %04X → %04X\n",
+                         destAddr, history->routeVia, currentVia);
+        }
+        history->setRouteCost(currentVia, currentCost);
+        Serial.printf("[COST] New route to %04X via %04X: cost=%.2f hops=%d\n",
+                     destAddr, currentVia, currentCost, currentHops);
+        return false;
+    }
 
-    // Skip if routing table is empty
-    if (routingTable->getLength() == 0) return;
+    // Calculate cost change percentage
+    float costChange = 0.0;
+    if (history->routeCost > 0.01) {  // Avoid division by near-zero
+        costChange = (currentCost - history->routeCost) / history->routeCost;
+    }
 
-    uint32_t now = millis();
-    bool routingTableChanged = false;
-    bool topologyChanged = false;
+    // Apply hysteresis: only react to significant changes (>15%)
+    if (fabs(costChange) <= HYSTERESIS_THRESHOLD) return false;
 
-    // Track routing table size for topology change detection
-    static uint8_t lastRoutingTableSize = 0;
-    uint8_t currentSize = routingTable->getLength();
-    if (currentSize != lastRoutingTableSize) {
-        Serial.printf("[TOPOLOGY] Routing table size changed: %d → %d\n",
-                     lastRoutingTableSize, currentSize);
-        topologyChanged = true;
-        lastRoutingTableSize = currentSize;
+    if (costChange > 0) {
+        // Cost increased (route quality degraded)
+        Serial.printf("[COST] Route to %04X degraded: %.2f → %.2f (+%.1f%%) via %04X\n",
+                     destAddr, history->routeCost, currentCost, costChange * 100, currentVia);
+    } else {
+        // Cost decreased (route quality improved)
+        Serial.printf("[COST] Route to %04X improved: %.2f → %.2f (%.1f%%) via %04X\n",
+                     destAddr, history->routeCost, currentCost, costChange * 100, currentVia);
     }
 
-    // Iterate through routing table and evaluate costs
-    if (routingTable->moveToStart()) {
-        do {
-            RouteNode* node = routingTable->getCurrent();
-            if (!node) continue;
-
-            uint16_t destAddr = node->networkNode.address;
-            uint16_t currentVia = node->via;
-            uint8_t currentHops = node->networkNode.metric;
-
-            // Proactive stale route detection (faster than waiting for LoRaMesher timeout)
-            // LoRaMesher sets timeout = millis() + HELLO_PACKETS_DELAY (typically 120-360s)
-            if (node->timeout > 0 && node->timeout < now) {
-                // Check if this failure was already detected by health monitoring
-                bool alreadyHandled = false;
-                for (uint8_t j = 0; j < numNeighbors; j++) {
-                    if (neighborHealth[j].address == destAddr && neighborHealth[j].failureFlagged) {
-                        alreadyHandled = true;
-                        break;
-                    }
-                }
+    // Update history with new cost
+    history->setRouteCost(currentVia, currentCost);
 
-                if (!alreadyHandled) {
-                    Serial.printf("[TOPOLOGY] Route to %04X is stale (timeout=%lu < now=%lu)\n",
-                                 destAddr, node->timeout, now);
-                    topologyChanged = true;
-                } else {
-                    // Silently skip - already detected and handled by health monitoring
-                    // Route will be removed by library at 600s timeout or already removed
-                }
-            }
+    // Note: In current implementation, we monitor costs but don't actively
+    // change routes. The library selects the route with the compiled
+    // LM_ROUTING_METRIC; this monitoring provides data for:
+    // - Analysis of route quality over time
+    // - Identification of poor-quality links
+    // - Validation of cost function weights
+    return true;
+}
 
-            // Calculate current route cost
-            float currentCost = calculateRouteCost(currentHops, currentVia, destAddr);
+/**
+ * @brief Re-evaluate the costs of the routes that changed
+ *
+ * The library queues the destinations whose route was added, removed or
+ * switched, and those whose next hop link moved more than
+ * LM_ETX_CHANGE_THRESHOLD / LM_SNR_CHANGE_THRESHOLD. Only those are
+ * evaluated; the whole table is swept on the first run and when the queue
+ * overflowed. Stale routes are removed by the library route timers, which
+ * also notifies the topology change.
+ */
+void evaluateRoutingTableCosts() {
+    uint16_t dirty[LM_DIRTY_ROUTES];
+    bool all = false;
+    size_t dirtyLength = RoutingTableService::takeDirtyRoutes(dirty, all);
 
-            // Get cost history for hysteresis comparison
-            RouteCostHistory* history = getCostHistory(destAddr);
+    static bool firstEvaluation = true;
+    if (firstEvaluation) {
+        firstEvaluation = false;
+        all = true;
+    }
 
-            // First time seeing this route or via changed
-            if (history->lastUpdate == 0 || history->via != currentVia) {
-                if (history->lastUpdate != 0) {
-                    // Via changed = topology change (route switched to different next hop)
-                    Serial.printf("[TOPOLOGY] Route to %04X switched: via %04X → %04X\n",
-                                 destAddr, history->via, currentVia);
-                    topologyChanged = true;
-                }
-                history->via = currentVia;
-                history->cost = currentCost;
-                history->lastUpdate = now;
-                Serial.printf("[COST] New route to %04X via %04X: cost=%.2f hops=%d\n",
-                             destAddr, currentVia, currentCost, currentHops);
-                continue;
-            }
+    if (!all && dirtyLength == 0) return;
 
-            // Calculate cost change percentage
-            float costChange = 0.0;
-            if (history->cost > 0.01) {  // Avoid division by near-zero
-                costChange = (currentCost - history->cost) / history->cost;
-            }
+    size_t evaluated = 0;
+    size_t changed = 0;
 
-            // Apply hysteresis: only react to significant changes (>15%)
-            if (fabs(costChange) > HYSTERESIS_THRESHOLD) {
-                if (costChange > 0) {
-                    // Cost increased (route quality degraded)
-                    Serial.printf("[COST] Route to %04X degraded: %.2f → %.2f (+%.1f%%) via %04X\n",
-                                 destAddr, history->cost, currentCost, costChange * 100, currentVia);
-                } else {
-                    // Cost decreased (route quality improved)
-                    Serial.printf("[COST] Route to %04X improved: %.2f → %.2f (%.1f%%) via %04X\n",
-                                 destAddr, history->cost, currentCost, costChange * 100, currentVia);
+    NeighborTableService::setInUse();
+    if (all) {
+        // Lock free snapshot of the routing table
+        RoutingTableView view;
+        for (const RoutingTableSnapshot::Entry& route : view) {
+            evaluated++;
+            if (evaluateRouteCost(route.networkNode.address, route.via, route.networkNode.metric))
+                changed++;
+        }
+    } else {
+        for (size_t i = 0; i < dirtyLength; i++) {
+            uint16_t destAddr = dirty[i];
+
+            // Read the route under the routing table lock, the snapshot can be older than the dirty mark
+            RoutingTableService::routingTableList->setInUseShared();
+            RouteNode* node = RoutingTableService::routingTableIndex->find(destAddr);
+            bool found = node != nullptr;
+            uint16_t currentVia = found ? node->via : 0;
+            uint8_t currentHops = found ? node->networkNode.metric : 0;
+            RoutingTableService::routingTableList->releaseInUseShared();
+
+            if (!found) {
+                // Route removed, forget its cost history
+                NeighborEntry* history = NeighborTableService::find(destAddr);
+                if (history != nullptr && history->routeCostUpdate != 0) {
+                    Serial.printf("[COST] Route to %04X removed\n", destAddr);
+                    history->routeCostUpdate = 0;
                 }
-
-                // Update history with new cost
-                history->cost = currentCost;
-                history->lastUpdate = now;
-                routingTableChanged = true;
+                continue;
             }
 
-            // Note: In current implementation, we monitor costs but don't actively
-            // change routes. Full cost-based route selection would require:
-            // 1. Visibility into alternative routes (LoRaMesher only keeps best hop-count route)
-            // 2. Ability to override LoRaMesher's distance-vector route selection
-            // 3. Careful synchronization to avoid routing loops
-            //
-            // For now, cost monitoring provides valuable data for:
-            // - Analysis of route quality over time
-            // - Identification of poor-quality links
-            // - Validation of cost function weights
-            // - Future integration with enhanced routing logic
-
-        } while (routingTable->next());
-    }
-
-    // Reset Trickle timer if topology changed (RFC 6206 fast convergence)
-    if (topologyChanged) {
-        Serial.println("[TRICKLE] Topology change detected - resetting to I_min for fast convergence");
-        trickleTimer.reset();
+            evaluated++;
+            if (evaluateRouteCost(destAddr, currentVia, currentHops))
+                changed++;
+        }
     }
+    NeighborTableService::releaseInUse();
 
     // Log summary if changes detected
-    if (routingTableChanged) {
-        Serial.printf("[COST] Route quality evaluation complete (%d routes tracked)\n",
-                     routingTable->getLength());
+    if (changed > 0) {
+        Serial.printf("[COST] Route quality evaluation complete (%d of %d routes changed, %s)\n",
+                     (int)changed, (int)evaluated, all ? "full sweep" : "dirty routes");
     }
 }
 
@@ -1453,14 +1021,15 @@ void updateNodeStatus() {
             nodeStatus.nextHopAddr = gateway->via;
 
             // Calculate route cost
-            nodeStatus.routeCost = calculateRouteCost(
+            nodeStatus.routeCost = getRouteCost(
                 gateway->networkNode.metric,
                 gateway->via,
                 gateway->networkNode.address
             );
 
             // Get link metrics for next hop
-            LinkMetrics* link = getLinkMetrics(gateway->via);
+            NeighborTableService::setInUse();
+            NeighborEntry* link = NeighborTableService::find(gateway->via);
             if (link) {
                 nodeStatus.rssi = link->rssi;
                 nodeStatus.snr = link->snr;
@@ -1470,6 +1039,7 @@ void updateNodeStatus() {
                 nodeStatus.snr = 0.0;
                 nodeStatus.etx = 0.0;
             }
+            NeighborTableService::releaseInUse();
         } else {
             nodeStatus.gatewayAddr = 0;  // No gateway found
             nodeStatus.nextHopAddr = 0;
@@ -1513,16 +1083,14 @@ void processReceivedPackets(void*) {
 
         // Process all packets in receive queue
         while (radio.getReceivedQueueSize() > 0) {
-            // Get next packet from queue (now enhanced structure)
-            AppPacket<EnhancedSensorData>* packet = radio.getNextAppPacket<EnhancedSensorData>();
+            // Get next packet from queue, a single sample or a batch frame
+            AppPacket<uint8_t>* packet = radio.getNextAppPacket<uint8_t>();
 
             if (packet == nullptr) {
                 Serial.println("ERROR: Null packet received");
                 continue;
             }
 
-            EnhancedSensorData* data = packet->payload;
-
             // Update statistics
             stats.dataPacketsReceived++;
 
@@ -1533,46 +1101,73 @@ void processReceivedPackets(void*) {
                 digitalWrite(LED_PIN, LOW);
             }
 
-            // Update link quality metrics from routing table
-            RouteNode* srcNode = RoutingTableService::findNode(packet->src);
-            if (srcNode) {
-                int8_t snr = srcNode->receivedSNR;
-                int16_t estimatedRSSI = -120 + (snr * 3);
+            EnhancedSensorData samples[SENSOR_BATCH_MAX_SAMPLES];
+            uint8_t sampleCount = SensorDataManager::deserializeBatch(packet->payload, packet->payloadSize, samples);
+
+            if (sampleCount == 0) {
+                Serial.printf("ERROR: Malformed sensor frame (%lu bytes) from %04X\n",
+                             (unsigned long)packet->payloadSize, packet->src);
+                radio.deletePacket(packet);
+                continue;
+            }
 
-                // Update link metrics with sequence-gap detection
-                updateLinkMetrics(packet->src, estimatedRSSI, snr, data->sequence);
+            // Binary or WiFi uplink: the uplink task sends the samples, no text formatting here
+            bool binary = uplink.isEnabled();
 
-                Serial.printf("Link quality: SNR=%d dB, Est.RSSI=%d dBm\n",
-                             snr, estimatedRSSI);
+            if (!binary) {
+                Serial.printf("Link quality: SNR=%d dB, RSSI=%d dBm, Hops=%d\n",
+                             packet->snr, packet->rssi, packet->hopCount);
             }
 
-            // Log received packet with enhanced data
-            Serial.printf("RX: Seq=%u From=%04X\n", data->sequence, packet->src);
-            Serial.printf("  PM: 1.0=%d 2.5=%d 10=%d µg/m³ (AQI: %s)\n",
-                         data->pm1_0, data->pm2_5, data->pm10,
-                         SensorDataManager::getAQICategory(data->pm2_5));
-
-            if (data->gps_valid) {
-                Serial.printf("  GPS: %.6f°N, %.6f°E, alt=%.1fm, %d sats (%s)\n",
-                             data->latitude, data->longitude, data->altitude,
-                             data->satellites,
-                             SensorDataManager::getGPSQuality(data->satellites, true));
-            } else {
-                Serial.println("  GPS: No fix");
+            if (sampleCount > 1 && !binary) {
+                Serial.printf("RX: Batch of %u samples (%lu bytes) From=%04X\n",
+                             sampleCount, (unsigned long)packet->payloadSize, packet->src);
             }
 
-            // Gateway-specific logging and load tracking
-            if (IS_GATEWAY) {
-                Serial.printf("[GATEWAY] Packet %u from %04X received\n",
-                             data->sequence, packet->src);
+            for (uint8_t i = 0; i < sampleCount; i++) {
+                EnhancedSensorData* data = &samples[i];
+
+                // Update link quality metrics from the reception metadata of the packet.
+                // The sequences of a batch are consecutive, so they are not counted as lost
+                updateLinkMetrics(packet->src, packet->rssi, packet->snr, data->sequence);
 
-                // Validate packet data
-                if (SensorDataManager::validatePacket(*data)) {
-                    Serial.println("  ✓ Packet validation passed");
+                if (binary) {
+                    uplink.push(packet->src, packet->rssi, packet->snr, packet->hopCount,
+                                packet->payloadSize, *data);
+                    continue;
+                }
+
+                // Log received packet with enhanced data
+                Serial.printf("RX: Seq=%u From=%04X\n", data->sequence, packet->src);
+                Serial.printf("  PM: 1.0=%d 2.5=%d 10=%d µg/m³ (AQI: %s)\n",
+                             data->pm1_0, data->pm2_5, data->pm10,
+                             SensorDataManager::getAQICategory(data->pm2_5));
+
+                if (data->gps_valid) {
+                    Serial.printf("  GPS: %.6f°N, %.6f°E, alt=%.1fm, %d sats (%s)\n",
+                                 data->latitude, data->longitude, data->altitude,
+                                 data->satellites,
+                                 SensorDataManager::getGPSQuality(data->satellites, true));
                 } else {
-                    Serial.println("  ✗ Warning: Packet data out of range");
+                    Serial.println("  GPS: No fix");
                 }
 
+                // Gateway-specific logging
+                if (IS_GATEWAY) {
+                    Serial.printf("[GATEWAY] Packet %u from %04X received\n",
+                                 data->sequence, packet->src);
+
+                    // Validate packet data
+                    if (SensorDataManager::validatePacket(*data)) {
+                        Serial.println("  ✓ Packet validation passed");
+                    } else {
+                        Serial.println("  ✗ Warning: Packet data out of range");
+                    }
+                }
+            }
+
+            // Gateway load tracking, once per frame
+            if (IS_GATEWAY) {
                 recordGatewayLoadSample();
                 updateNeighborHealth(packet->src);  // Treat data reception as liveness heartbeat
                 nodeStatus.statusMessage = "Packet RX";
@@ -1643,6 +1238,24 @@ void setupLoraMesher() {
     config.syncWord = DEFAULT_LORA_SYNC_WORD; // Private sync word
     config.preambleLength = DEFAULT_LORA_PREAMBLE;
 
+    // Fixed packet pool so days of forwarding do not fragment the heap
+    config.packetPoolBlocks = 16;
+
+    config.timeSync = TIME_SYNC;
+    config.backpressure = BACKPRESSURE;
+    config.telemetryInterval = TELEMETRY_INTERVAL;
+    config.metricsInterval = METRICS_INTERVAL;
+
+    // The gateway offers its running image, the nodes receive into the partition they boot next
+    if (OTA_UPDATES) {
+        const esp_partition_t* otaPartition = OTA_OFFER && IS_GATEWAY ?
+            esp_ota_get_running_partition() : esp_ota_get_next_update_partition(NULL);
+        if (otaPartition != NULL) {
+            config.otaPartition = otaPartition->label;
+            config.otaVersion = FIRMWARE_VERSION;
+        }
+    }
+
     // Set TX power for cost-based routing simulation test
     // LOW_POWER_TEST: Simulate weak sensor→gateway link to force relay usage
 #ifdef LOW_POWER_TEST
@@ -1660,6 +1273,7 @@ void setupLoraMesher() {
 
     // Initialize LoRaMesher
     radio.begin(config);
+    radio.setMetricsCallback(printMetricsSample);
 
     // Create and register receive task
     createReceiveMessages();
@@ -1686,6 +1300,17 @@ void setupLoraMesher() {
         Serial.println("Gateway role added - other nodes can discover this gateway");
     }
 
+    // Size of the running image, the application partition is larger
+    if (OTA_UPDATES && OTA_OFFER && IS_GATEWAY) {
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        const esp_partition_pos_t position = {running->address, running->size};
+        esp_image_metadata_t metadata;
+        if (esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &position, &metadata) == ESP_OK && radio.startOta(metadata.image_len))
+            Serial.printf("Offering firmware version %d, %lu bytes\n", FIRMWARE_VERSION, (unsigned long)metadata.image_len);
+        else
+            Serial.println("Firmware image not offered");
+    }
+
     Serial.println("\n========================================");
     Serial.println("LoRaMesher initialized successfully!");
     Serial.println("========================================");
@@ -1715,132 +1340,218 @@ void setupLoraMesher() {
 /**
  * @brief Sensor reading task (background)
  *
- * Continuously reads PM sensor and GPS module data.
- * Runs in parallel with LoRa transmission.
+ * The PM sensor and GPS module are parsed from their UART event callbacks,
+ * this task only prints the latest readings. Runs in parallel with LoRa transmission.
  */
 void sensorReadingTask(void* parameter) {
     Serial.println("[SENSOR_TASK] Started");
 
-    uint32_t lastPMPrint = 0;
-    uint32_t lastGPSPrint = 0;
+    uint32_t lastPMReading = 0;
+    uint32_t lastGPSFix = 0;
 
     for (;;) {
-        // Update PM sensor (reads available UART data)
-        if (pmsSensor != nullptr) {
-            if (pmsSensor->update()) {
-                // New PM data received
-                if (millis() - lastPMPrint > 60000) {  // Print every 60s
-                    pmsSensor->printData();
-                    lastPMPrint = millis();
-                }
-            }
+        // Print every 60s if a new PM reading has been received
+        if (pmsSensor != nullptr && pmsSensor->getReadingCount() != lastPMReading) {
+            lastPMReading = pmsSensor->getReadingCount();
+            pmsSensor->printData();
         }
 
-        // Update GPS (reads available UART data)
-        if (gpsHandler != nullptr) {
-            if (gpsHandler->update()) {
-                // New GPS fix received
-                if (millis() - lastGPSPrint > 60000) {  // Print every 60s
-                    gpsHandler->printData();
-                    lastGPSPrint = millis();
-                }
-            }
+        // Print every 60s if a new GPS fix has been received
+        if (gpsHandler != nullptr && gpsHandler->getFixCount() != lastGPSFix) {
+            lastGPSFix = gpsHandler->getFixCount();
+            gpsHandler->printData();
         }
 
-        // Run frequently to keep UART buffers from overflowing
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        vTaskDelay(60000 / portTICK_PERIOD_MS);
+    }
+}
+
+static_assert(SENSOR_BATCH_SIZE >= 1 && SENSOR_BATCH_SIZE <= SENSOR_BATCH_MAX_SAMPLES,
+              "SENSOR_BATCH_SIZE must be between 1 and SENSOR_BATCH_MAX_SAMPLES");
+
+// Samples waiting to be sent, only used by the sensor task
+EnhancedSensorData sensorBatch[SENSOR_BATCH_SIZE];
+uint8_t sensorBatchCount = 0;
+uint32_t sensorBatchStart = 0;
+
+/**
+ * @brief Timestamp of a sample: milliseconds of the network with TIME_SYNC once synchronized, else since boot
+ */
+uint32_t getSampleTime(uint32_t now) {
+    int64_t time;
+    if (TIME_SYNC && radio.getSyncedTime(time)) {
+        return (uint32_t) (time / 1000);
+    }
+    return now;
+}
+
+/**
+ * @brief Add a sample to the batch, the oldest one is dropped if it is full
+ */
+void addSensorSample(const EnhancedSensorData& sample) {
+    if (sensorBatchCount == SENSOR_BATCH_SIZE) {
+        // No gateway for a whole batch, keep the latest samples
+        // The start is a local time, the timestamps can be of the network
+        sensorBatchStart += sensorBatch[1].timestamp - sensorBatch[0].timestamp;
+        memmove(sensorBatch, sensorBatch + 1, (SENSOR_BATCH_SIZE - 1) * sizeof(EnhancedSensorData));
+        sensorBatchCount--;
+        Serial.println("TX: Batch full without gateway, oldest sample dropped");
+    }
+
+    if (sensorBatchCount == 0) {
+        sensorBatchStart = millis();
+    }
+    sensorBatch[sensorBatchCount++] = sample;
+}
+
+/**
+ * @brief When a batch that is not full is sent: SENSOR_BATCH_FLUSH_MS after its first sample, stretched by the
+ * rate control of the library with the congestion of the path, the airtime budget and the gateway load.
+ * The samples of the deferred flush join the batch
+ */
+uint32_t getSensorBatchFlushTime() {
+    RouteNode* gateway = getPreferredGateway();
+    if (gateway == nullptr) {
+        return sensorBatchStart + SENSOR_BATCH_FLUSH_MS;
     }
+    return radio.getNextSendTime(gateway->networkNode.address, sensorBatchStart, SENSOR_BATCH_FLUSH_MS);
+}
+
+/**
+ * @brief If the batch has to be sent: it is full or its flush time has come
+ */
+bool isSensorBatchDue(uint32_t now) {
+    return sensorBatchCount >= SENSOR_BATCH_SIZE ||
+           (sensorBatchCount > 0 && (int32_t)(now - getSensorBatchFlushTime()) >= 0);
+}
+
+/**
+ * @brief Send the batch to the preferred gateway in one frame
+ */
+void flushSensorBatch() {
+    // Find closest gateway in routing table
+    RouteNode* gateway = getPreferredGateway();
+
+    if (gateway == nullptr) {
+        // No gateway found yet, keep the samples and wait for routing table to build
+        Serial.printf("TX: No gateway in routing table yet, waiting... (%u samples batched)\n", sensorBatchCount);
+        nodeStatus.statusMessage = "No Gateway";
+        return;
+    }
+
+    // Send to gateway address - LoRaMesher will route via routing table
+    uint16_t gatewayAddr = gateway->networkNode.address;
+
+    uint8_t frame[SENSOR_BATCH_MAX_FRAME_SIZE];
+    size_t frameSize = SensorDataManager::serializeBatch(sensorBatch, sensorBatchCount, frame);
+
+    const EnhancedSensorData& first = sensorBatch[0];
+    const EnhancedSensorData& last = sensorBatch[sensorBatchCount - 1];
+
+    Serial.printf("TX: Seq=%u-%u (%u samples, %u bytes) to Gateway=%04X (Hops=%u)\n",
+                 first.sequence, last.sequence, sensorBatchCount, (unsigned)frameSize,
+                 gatewayAddr, gateway->networkNode.metric);
+
+    if (last.pm1_0 || last.pm2_5 || last.pm10) {
+        Serial.printf("  PM: 1.0=%d 2.5=%d 10=%d µg/m³ (latest)\n",
+                     last.pm1_0, last.pm2_5, last.pm10);
+    } else {
+        Serial.println("  PM: No data");
+    }
+
+    if (first.gps_valid) {
+        Serial.printf("  GPS: %.6f°N, %.6f°E, %d sats\n",
+                     first.latitude, first.longitude, first.satellites);
+    } else {
+        Serial.println("  GPS: No fix");
+    }
+
+    // Record transmission for channel monitoring, time-on-air of the data packet with the active LoRa configuration
+    uint32_t toaMs = LoraMesher::getTimeOnAirMs(sizeof(DataPacket) + frameSize);
+    channelMonitor.recordTransmission(toaMs);
+    LM_EnqueueResult enqueueResult = radio.createPacketAndSend(gatewayAddr, frame, frameSize);
+    queueMonitor.recordEnqueue(isEnqueued(enqueueResult));
+    stats.dataPacketsSent++;
+
+    sensorBatchCount = 0;
+
+    // Blink LED
+    if (LED_BLINK_ON_TX) {
+        digitalWrite(LED_PIN, HIGH);
+        delay(50);
+        digitalWrite(LED_PIN, LOW);
+    }
+
+    nodeStatus.statusMessage = "TX Success";
+
+    // Update memory stats
+    memoryMonitor.update();
 }
 
 /**
  * @brief Sensor task: Send periodic data packets
  *
- * Sends enhanced sensor data (PM + GPS) every 60 seconds.
+ * Reads enhanced sensor data (PM + GPS) every 60 seconds and sends the
+ * samples in batches of SENSOR_BATCH_SIZE, or when the first sample of the
+ * batch waited SENSOR_BATCH_FLUSH_MS, stretched by the rate control of the
+ * library. The header and preamble are sent once per batch and the GPS
+ * fields once per frame.
  * LoRaMesher automatically routes to gateway via best path.
  */
 void sendSensorData(void*) {
-    for (;;) {
-        // Wait 60 seconds between transmissions (per specification)
-        vTaskDelay(60000 / portTICK_PERIOD_MS);
-
-        // Read latest sensor data
-        PMS7003Data pmsData = {0};
-        GPSData gpsData = {0};
-        bool havePMData = false;
-        bool haveGPSData = false;
+    uint32_t nextSample = millis() + 60000;
 
-        if (pmsSensor != nullptr) {
-            pmsData = pmsSensor->getData();
-            havePMData = pmsSensor->isDataValid(10000);  // Data valid if <10s old
+    for (;;) {
+        // Wake up for the next sample or the flush deadline of the batch
+        uint32_t now = millis();
+        // (a deadline already passed without gateway waits for the next sample)
+        uint32_t wakeUp = nextSample;
+        uint32_t flushDeadline = getSensorBatchFlushTime();
+        if (sensorBatchCount > 0 && (int32_t)(flushDeadline - now) > 0 && (int32_t)(flushDeadline - wakeUp) < 0) {
+            wakeUp = flushDeadline;
         }
-
-        if (gpsHandler != nullptr) {
-            gpsData = gpsHandler->getData();
-            haveGPSData = gpsHandler->isFixValid(30000);  // Fix valid if <30s old
+        if ((int32_t)(wakeUp - now) > 0) {
+            vTaskDelay((wakeUp - now) / portTICK_PERIOD_MS);
         }
 
-        // Create enhanced sensor data packet
-        EnhancedSensorData enhancedData = SensorDataManager::createPacket(
-            havePMData ? pmsData.pm1_0_atmospheric : 0,
-            havePMData ? pmsData.pm2_5_atmospheric : 0,
-            havePMData ? pmsData.pm10_atmospheric : 0,
-            haveGPSData ? gpsData.latitude : 0.0,
-            haveGPSData ? gpsData.longitude : 0.0,
-            haveGPSData ? gpsData.altitude : 0.0f,
-            haveGPSData ? gpsData.satellites : 0,
-            haveGPSData,
-            millis(),
-            sequenceNumber++
-        );
-
-        // Find closest gateway in routing table
-        RouteNode* gateway = getPreferredGateway();
-
-        if (gateway != nullptr) {
-            // Send to gateway address - LoRaMesher will route via routing table
-            uint16_t gatewayAddr = gateway->networkNode.address;
+        now = millis();
+        if ((int32_t)(now - nextSample) >= 0) {
+            // 60 seconds between samples (per specification)
+            nextSample = now + 60000;
 
-            Serial.printf("TX: Seq=%u to Gateway=%04X (Hops=%u)\n",
-                         enhancedData.sequence, gatewayAddr, gateway->networkNode.metric);
+            // Read latest sensor data
+            PMS7003Data pmsData = {0};
+            GPSData gpsData = {0};
+            bool havePMData = false;
+            bool haveGPSData = false;
 
-            if (havePMData) {
-                Serial.printf("  PM: 1.0=%d 2.5=%d 10=%d µg/m³\n",
-                             enhancedData.pm1_0, enhancedData.pm2_5, enhancedData.pm10);
-            } else {
-                Serial.println("  PM: No data");
-            }
-
-            if (haveGPSData) {
-                Serial.printf("  GPS: %.6f°N, %.6f°E, %d sats\n",
-                             enhancedData.latitude, enhancedData.longitude, enhancedData.satellites);
-            } else {
-                Serial.println("  GPS: No fix");
+            if (pmsSensor != nullptr) {
+                pmsData = pmsSensor->getData();
+                havePMData = pmsSensor->isDataValid(10000);  // Data valid if <10s old
             }
 
-            // Record transmission for channel monitoring
-            // Time-on-air for ~50-byte packet @ SF7, BW125, CR4/5 ≈ 70 ms (larger packet)
-            uint32_t toaMs = 70;  // Estimated time-on-air for enhanced packet
-            channelMonitor.recordTransmission(toaMs);
-            queueMonitor.recordEnqueue(true);  // Assume successful enqueue
-
-            radio.createPacketAndSend(gatewayAddr, &enhancedData, 1);
-            stats.dataPacketsSent++;
-
-            // Blink LED
-            if (LED_BLINK_ON_TX) {
-                digitalWrite(LED_PIN, HIGH);
-                delay(50);
-                digitalWrite(LED_PIN, LOW);
+            if (gpsHandler != nullptr) {
+                gpsData = gpsHandler->getData();
+                haveGPSData = gpsHandler->isFixValid(30000);  // Fix valid if <30s old
             }
 
-            nodeStatus.statusMessage = "TX Success";
+            // Create enhanced sensor data sample
+            addSensorSample(SensorDataManager::createPacket(
+                havePMData ? pmsData.pm1_0_atmospheric : 0,
+                havePMData ? pmsData.pm2_5_atmospheric : 0,
+                havePMData ? pmsData.pm10_atmospheric : 0,
+                haveGPSData ? gpsData.latitude : 0.0,
+                haveGPSData ? gpsData.longitude : 0.0,
+                haveGPSData ? gpsData.altitude : 0.0f,
+                haveGPSData ? gpsData.satellites : 0,
+                haveGPSData,
+                getSampleTime(now),
+                sequenceNumber++
+            ));
+        }
 
-            // Update memory stats
-            memoryMonitor.update();
-        } else {
-            // No gateway found yet, wait for routing table to build
-            Serial.println("TX: No gateway in routing table yet, waiting...");
-            nodeStatus.statusMessage = "No Gateway";
+        if (isSensorBatchDue(now)) {
+            flushSensorBatch();
         }
     }
 }
@@ -1880,6 +1591,79 @@ void createSendMessages() {
     }
 }
 
+// ============================================================================
+// Metrics History
+// ============================================================================
+
+// Values of the monitors recorded with the library stats, see LoraMesher::setMetricValue
+enum MetricValue : uint8_t {
+    METRIC_MIN_FREE_HEAP = 0,
+    METRIC_MAX_QUEUE_DEPTH = 1,
+    METRIC_QUEUE_DROPPED = 2,
+    // Thousandths of a percent
+    METRIC_DUTY_CYCLE = 3,
+};
+
+void printMetricsSample(uint16_t src, LM_MetricsTier tier, const LM_MetricsSample* sample, bool more, void*) {
+    if (sample == nullptr) {
+        Serial.printf("Metrics of %04X end%s\n", src, more ? ", more in the range" : "");
+        return;
+    }
+
+    Serial.printf("%04X %c %7lu s | heap %6lu min %6lu | queues %2lu/%-2lu max %2lu | routes %2lu | busy %4lu | "
+                  "TX %5lu RX %5lu FWD %5lu | drops %lu/%lu/%lu | ToA %lu ms | duty %.3f%%\n",
+                 src, tier == METRICS_FINE ? 'F' : 'C', (unsigned long)sample->time,
+                 (unsigned long)sample->freeHeap, (unsigned long)sample->app[METRIC_MIN_FREE_HEAP],
+                 (unsigned long)sample->sendQueue, (unsigned long)sample->receivedQueue,
+                 (unsigned long)sample->app[METRIC_MAX_QUEUE_DEPTH], (unsigned long)sample->routes,
+                 (unsigned long)sample->channelBusy, (unsigned long)sample->sent, (unsigned long)sample->received,
+                 (unsigned long)sample->forwarded, (unsigned long)sample->sendQueueDropped,
+                 (unsigned long)sample->receivedQueueDropped, (unsigned long)sample->app[METRIC_QUEUE_DROPPED],
+                 (unsigned long)sample->timeOnAir, sample->app[METRIC_DUTY_CYCLE] / 1000.0);
+}
+
+/**
+ * @brief Serve the range requests of the metrics history typed on serial, see METRICS_INTERVAL
+ */
+void handleMetricsCommand() {
+    static char line[64];
+    static size_t length = 0;
+
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (length < sizeof(line) - 1)
+                line[length++] = c;
+            continue;
+        }
+
+        line[length] = '\0';
+        length = 0;
+
+        unsigned address, tier;
+        unsigned long from, to;
+        if (sscanf(line, "metrics %x %u %lu %lu", &address, &tier, &from, &to) != 4 || tier >= METRICS_TIERS)
+            continue;
+
+        if (address != 0 && address != radio.getLocalAddress()) {
+            if (!isEnqueued(radio.requestMetrics(address, (LM_MetricsTier)tier, from, to)))
+                Serial.printf("Metrics request to %04X not sent\n", address);
+            continue;
+        }
+
+        static LM_MetricsSample samples[32];
+        size_t count;
+        do {
+            count = radio.getMetrics((LM_MetricsTier)tier, from, to, samples, 32);
+            for (size_t i = 0; i < count; i++)
+                printMetricsSample(radio.getLocalAddress(), (LM_MetricsTier)tier, &samples[i], false, nullptr);
+            if (count > 0)
+                from = samples[count - 1].time + 1;
+        } while (count == 32);
+        printMetricsSample(radio.getLocalAddress(), (LM_MetricsTier)tier, nullptr, false, nullptr);
+    }
+}
+
 // ============================================================================
 // Arduino Setup and Loop
 // ============================================================================
@@ -1932,14 +1716,34 @@ void setup() {
     nodeStatus.nodeId = radio.getLocalAddress();  // MAC-derived address (e.g., 0x02B4, 0x6674)
     nodeStatus.gatewayAddr = 0;  // Will be updated in updateNodeStatus()
 
-    // Register cost calculation callback for cost-based routing
-    RoutingTableService::setCostCalculationCallback(calculateRouteCost);
-    Serial.println("✅ Cost-based routing ENABLED - routes selected by multi-metric cost");
+    // Cost-based routing is selected at build time with LM_ROUTING_METRIC
+    if (RoutingTableService::isCostRouting()) {
+        Serial.println("✅ Cost-based routing ENABLED - routes selected by multi-metric cost");
+    } else {
+        Serial.println("⚠️ Cost-based routing DISABLED - build with -D LM_ROUTING_METRIC=LM_METRIC_GATEWAY_BIASED");
+    }
 
     // Register HELLO reception callback for Trickle suppression
     RoutingTableService::setHelloReceivedCallback(onHelloReceived);
+    RoutingTableService::setTopologyChangedCallback(onTopologyChanged);
     Serial.println("✅ Trickle suppression ENABLED - HELLOs will be suppressed when neighbors heard");
 
+    // Binary uplink of the received samples, to the Pi or over WiFi (gateways only)
+    if (UPLINK_WIFI && IS_GATEWAY) {
+        uplink.setWiFi(UPLINK_WIFI_SSID, UPLINK_WIFI_PASSWORD, UPLINK_UDP_HOST, UPLINK_UDP_PORT);
+        if (uplink.begin(radio.getLocalAddress(), UPLINK_TRANSPORT_WIFI)) {
+            Serial.printf("✅ WiFi uplink ENABLED - batches to %s:%d\n", UPLINK_UDP_HOST, UPLINK_UDP_PORT);
+        } else {
+            Serial.println("ERROR: WiFi uplink not started, using the text logs");
+        }
+    } else if (UPLINK_BINARY && IS_GATEWAY) {
+        if (uplink.begin(radio.getLocalAddress())) {
+            Serial.println("✅ Binary uplink ENABLED - samples sent as COBS frames");
+        } else {
+            Serial.println("ERROR: Uplink task creation failed, using the text logs");
+        }
+    }
+
     // Initialize sensors (SENSOR nodes only)
     if (IS_SENSOR || (IS_RELAY && RELAY_HAS_SENSOR)) {
         Serial.println("\n--- Initializing Sensors ---");
@@ -1964,6 +1768,11 @@ void setup() {
     // Update display after init
     displayMessage("Protocol 3 Ready");
 
+    // Draw the display from its own low priority task, off the radio tasks core
+    if (displayManager.startTask()) {
+        Serial.println("✅ Display task started");
+    }
+
     // Create transmission task (sensors only)
     createSendMessages();
 
@@ -1978,7 +1787,7 @@ void setup() {
 }
 
 void loop() {
-    // Update display periodically
+    // Publish a status snapshot periodically, the display task draws it
     if (millis() - lastDisplayUpdate >= DISPLAY_UPDATE_MS) {
         updateNodeStatus();
         updateDisplay(nodeStatus);
@@ -2005,10 +1814,26 @@ void loop() {
         monitorNeighborHealth();
     }
     
+    // Boot a verified image after serving it a while
+    static uint32_t otaVerifiedAt = 0;
+    if (OTA_UPDATES && otaVerifiedAt == 0 && radio.getOtaState() == OTA_VERIFIED) {
+        otaVerifiedAt = millis();
+        Serial.printf("Firmware image verified, rebooting in %lu s\n", (unsigned long)(OTA_REBOOT_DELAY_MS / 1000));
+    }
+    if (otaVerifiedAt != 0 && millis() - otaVerifiedAt >= OTA_REBOOT_DELAY_MS) {
+        if (esp_ota_set_boot_partition(esp_ota_get_next_update_partition(NULL)) == ESP_OK)
+            esp_restart();
+        Serial.println("Firmware image not bootable");
+        otaVerifiedAt = 0;
+    }
+
     // Note: Trickle HELLO control is now handled by trickleHelloTask()
     // No need to poll here - the task manages HELLO timing automatically
 
-    // Evaluate routes based on cost function every 10 seconds
+    // Reset Trickle when the library notified a topology change
+    handleTopologyChange();
+
+    // Evaluate the dirty routes every 10 seconds
     static uint32_t lastCostEvaluation = 0;
     if (millis() - lastCostEvaluation > 10000) {
         lastCostEvaluation = millis();
@@ -2020,71 +1845,45 @@ void loop() {
     if (millis() - lastRoutingTablePrint > 30000) {
         lastRoutingTablePrint = millis();
         Serial.println("\n==== Routing Table (with Cost Metrics) ====");
-        Serial.printf("Routing table size: %d\n", radio.routingTableSize());
-
-        // Snapshot structure to avoid nested locking (calculateRouteCost calls calculateGatewayBias which also locks)
-        struct RouteSnapshot {
-            uint16_t address;
-            uint16_t via;
-            uint8_t metric;
-            uint8_t role;
-        };
-        RouteSnapshot snapshots[20];  // Max 20 routes
-        uint8_t snapshotCount = 0;
-
-        // STEP 1: Take snapshot while locked
-        LM_LinkedList<RouteNode>* routingTable = RoutingTableService::routingTableList;
-        if (routingTable) {
-            routingTable->setInUse();  // LOCK
-            if (routingTable->moveToStart()) {
-                do {
-                    RouteNode* node = routingTable->getCurrent();
-                    if (node && snapshotCount < 20) {
-                        snapshots[snapshotCount].address = node->networkNode.address;
-                        snapshots[snapshotCount].via = node->via;
-                        snapshots[snapshotCount].metric = node->networkNode.metric;
-                        snapshots[snapshotCount].role = node->networkNode.role;
-                        snapshotCount++;
-                    }
-                } while (routingTable->next());
-            }
-            routingTable->releaseInUse();  // UNLOCK immediately
-
-            // STEP 2: Print snapshot (no lock held, safe to call calculateRouteCost)
-            if (snapshotCount > 0) {
-                Serial.println("Addr   Via    Hops  Role  Cost");
-                Serial.println("------|------|------|------|------");
-                for (uint8_t i = 0; i < snapshotCount; i++) {
-                    float routeCost = calculateRouteCost(snapshots[i].metric,
-                                                         snapshots[i].via,
-                                                         snapshots[i].address);
-                    Serial.printf("%04X | %04X | %4d | %02X | %.2f\n",
-                                 snapshots[i].address,
-                                 snapshots[i].via,
-                                 snapshots[i].metric,
-                                 snapshots[i].role,
-                                 routeCost);
-                }
-            } else {
-                Serial.println("(empty)");
+
+        // Routing table snapshot, no lock held while calculating the costs
+        RoutingTableView view;
+        Serial.printf("Routing table size: %d\n", (int) view.size());
+
+        if (view.size() > 0) {
+            Serial.println("Addr   Via    Hops  Role  Cost");
+            Serial.println("------|------|------|------|------");
+            for (const RoutingTableSnapshot::Entry& entry : view) {
+                float routeCost = getRouteCost(entry.networkNode.metric,
+                                                     entry.via,
+                                                     entry.networkNode.address);
+                Serial.printf("%04X | %04X | %4d | %02X | %.2f\n",
+                             entry.networkNode.address,
+                             entry.via,
+                             entry.networkNode.metric,
+                             entry.networkNode.role,
+                             routeCost);
             }
         } else {
-            Serial.println("(routing table not initialized)");
+            Serial.println("(empty)");
         }
         
         // Print link metrics summary
         Serial.println("\n==== Link Quality Metrics ====");
         Serial.println("Addr   RSSI   SNR   ETX");
         Serial.println("------|------|------|------");
-        for (int i = 0; i < MAX_TRACKED_LINKS; i++) {
-            if (linkMetrics[i].address != 0) {
+        NeighborTableService::setInUse();
+        for (size_t i = 0; i < NeighborTableService::size(); i++) {
+            NeighborEntry* link = NeighborTableService::getEntry(i);
+            if (link->lastUpdate != 0) {
                 Serial.printf("%04X | %4d | %3d | %.2f\n",
-                             linkMetrics[i].address,
-                             linkMetrics[i].rssi,
-                             linkMetrics[i].snr,
-                             linkMetrics[i].etx);
+                             link->address,
+                             link->rssi,
+                             link->snr,
+                             link->etx);
             }
         }
+        NeighborTableService::releaseInUse();
         Serial.println("================================\n");
     }
     
@@ -2097,14 +1896,71 @@ void loop() {
         memoryMonitor.printStats();
         queueMonitor.printStats();
         trickleTimer.printStats();
+
+        // The monitors go to the metrics history with the next sample
+        radio.setMetricValue(METRIC_MIN_FREE_HEAP, memoryMonitor.minFreeHeap);
+        radio.setMetricValue(METRIC_MAX_QUEUE_DEPTH, queueMonitor.maxQueueDepth);
+        radio.setMetricValue(METRIC_QUEUE_DROPPED, queueMonitor.packetsDropped);
+        radio.setMetricValue(METRIC_DUTY_CYCLE, (uint32_t)(channelMonitor.getDutyCyclePercent() * 1000));
         
-        // Print routing table memory usage
-        Serial.printf("Routing table: %d entries × ~32 bytes = ~%d KB\n",
-                     radio.routingTableSize(),
-                     (radio.routingTableSize() * 32) / 1024);
+        // Memory accounted by every subsystem of the library
+        static const char* const memoryTags[MEMORY_TAGS] = {"Packets", "Routing", "Lists", "Sequences", "Simulator"};
+        LM_MemoryStats memoryStats = radio.getMemoryStats();
+        Serial.printf("Routing table: %d entries\n", radio.routingTableSize());
+        for (uint8_t tag = 0; tag < MEMORY_TAGS; tag++) {
+            const LM_MemoryUsage& usage = memoryStats.usage[tag];
+            Serial.printf("Memory %-9s: %lu B in %lu (peak %lu B in %lu)\n", memoryTags[tag],
+                         (unsigned long)usage.bytes, (unsigned long)usage.count,
+                         (unsigned long)usage.peakBytes, (unsigned long)usage.peakCount);
+        }
+
+        // Health of the nodes collected from the HELLOs
+        if (TELEMETRY_INTERVAL != 0 && IS_GATEWAY) {
+            static LM_Telemetry telemetry[LM_TELEMETRY_NODES];
+            size_t count = radio.getTelemetry(telemetry, LM_TELEMETRY_NODES);
+            Serial.printf("Telemetry of %u nodes\n", (unsigned)count);
+            Serial.println("Addr   Age s  Uptime s  TX    FWD   Unr   Heap KB  Queues  Duty %");
+            for (size_t i = 0; i < count; i++) {
+                const TelemetryRecord& record = telemetry[i].record;
+                Serial.printf("%04X | %5lu | %8lu | %5u | %5u | %5u | %7u | %3u/%-3u | %.2f\n",
+                             record.address,
+                             (unsigned long)((millis() - telemetry[i].receivedAt) / 1000),
+                             (unsigned long)record.uptime,
+                             record.sent,
+                             record.forwarded,
+                             record.unreachable,
+                             record.freeHeap,
+                             record.sendQueue,
+                             record.receivedQueue,
+                             record.dutyCycle / 100.0);
+            }
+        }
+#if LM_TRACE_CATEGORIES
+        // Events of the trace since the last print, formatted here instead of in the send and receive paths
+        LM_TraceEvent events[16];
+        char line[96];
+        size_t eventCount;
+        while ((eventCount = TraceService::read(events, 16)) > 0) {
+            for (size_t i = 0; i < eventCount; i++) {
+                TraceService::format(events[i], line, sizeof(line));
+                Serial.println(line);
+            }
+        }
+        Serial.printf("Trace: %lu events overwritten\n", (unsigned long)TraceService::getOverwrittenNum());
+#endif
+        if (OTA_UPDATES) {
+            uint32_t received, chunks;
+            LM_OtaState otaState = radio.getOtaState(&received, &chunks);
+            Serial.printf("OTA: state %d, %lu of %lu chunks, %lu served, %lu requests, %lu hash failures\n",
+                         otaState, (unsigned long)received, (unsigned long)chunks,
+                         (unsigned long)radio.getOtaChunksServedNum(), (unsigned long)radio.getOtaRequestsNum(),
+                         (unsigned long)radio.getOtaHashFailuresNum());
+        }
         Serial.println("===================================\n");
     }
     
+    handleMetricsCommand();
+
     // Update memory monitor periodically
     static uint32_t lastMemoryUpdate = 0;
     if (millis() - lastMemoryUpdate > 5000) {  // Every 5 seconds
@@ -10,6 +10,11 @@
  * - PM1.0, PM2.5, PM10 (standard particles, atmospheric environment)
  * - Particle counts for different sizes
  * - Checksum validation
+ *
+ * The UART is not polled: the ESP32 UART driver buffers the bytes and its event
+ * task calls the onReceive callback when the line goes idle after a frame. The
+ * frames are parsed there and every reading is published lock-free for the
+ * other tasks.
  */
 
 #ifndef PMS7003_PARSER_H
@@ -17,11 +22,14 @@
 
 #include <Arduino.h>
 
+#include "published_value.h"
+
 // PMS7003 Frame Structure
 #define PMS_FRAME_START1    0x42
 #define PMS_FRAME_START2    0x4D
 #define PMS_FRAME_LENGTH    32
 #define PMS_DATA_LENGTH     28  // Excluding start bytes and checksum
+#define PMS_RX_BUFFER_SIZE  256 // UART driver ring buffer, several frames
 
 /**
  * @brief PMS7003 Data Structure
@@ -57,7 +65,8 @@ struct PMS7003Data {
 class PMS7003Parser {
 private:
     HardwareSerial* serial;
-    PMS7003Data data;
+    PMS7003Data data;                       // Parser state, only used by the UART event task
+    PublishedValue<PMS7003Data> published;  // Latest reading, read by any task
     uint8_t buffer[PMS_FRAME_LENGTH];
     uint8_t buffer_index;
     bool frame_started;
@@ -124,9 +133,44 @@ private:
         last_valid_read = millis();
         read_count++;
 
+        published.publish(data);
         return true;
     }
 
+    /**
+     * @brief Parse the received bytes (UART event task)
+     */
+    void ingest() {
+        while (serial->available()) {
+            uint8_t byte = serial->read();
+
+            // Look for frame start
+            if (!frame_started) {
+                if (buffer_index == 0 && byte == PMS_FRAME_START1) {
+                    buffer[buffer_index++] = byte;
+                } else if (buffer_index == 1 && byte == PMS_FRAME_START2) {
+                    buffer[buffer_index++] = byte;
+                    frame_started = true;
+                } else {
+                    // 0x42 0x42 0x4D: the second 0x42 can start the frame
+                    buffer_index = (byte == PMS_FRAME_START1) ? 1 : 0;
+                }
+            } else {
+                // Collect frame bytes
+                buffer[buffer_index++] = byte;
+
+                // Frame complete?
+                if (buffer_index >= PMS_FRAME_LENGTH) {
+                    parseFrame();
+
+                    // Reset for next frame
+                    buffer_index = 0;
+                    frame_started = false;
+                }
+            }
+        }
+    }
+
 public:
     /**
      * @brief Constructor
@@ -138,7 +182,8 @@ public:
         last_valid_read = 0;
         read_count = 0;
         error_count = 0;
-        data.valid = false;
+        memset(&data, 0, sizeof(data));
+        published.publish(data);
     }
 
     /**
@@ -147,6 +192,7 @@ public:
      * @param tx_pin GPIO pin for TX (ESP32 → sensor)
      */
     void begin(int rx_pin, int tx_pin) {
+        serial->setRxBufferSize(PMS_RX_BUFFER_SIZE);  // Must be set before begin()
         serial->begin(PMS_BAUD, SERIAL_8N1, rx_pin, tx_pin);
         Serial.printf("[PMS] Initialized on RX=%d, TX=%d, baud=%d\n", rx_pin, tx_pin, PMS_BAUD);
 
@@ -158,54 +204,24 @@ public:
             serial->read();
         }
 
+        // Parse the frames as they arrive, from the UART event task
+        serial->onReceive([this]() { ingest(); });
+
         Serial.println("[PMS] Ready");
     }
 
     /**
-     * @brief Update parser (call in loop)
-     * @return true if new valid frame parsed
+     * @brief Get latest sensor data
      */
-    bool update() {
-        bool new_data = false;
-
-        while (serial->available()) {
-            uint8_t byte = serial->read();
-
-            // Look for frame start
-            if (!frame_started) {
-                if (buffer_index == 0 && byte == PMS_FRAME_START1) {
-                    buffer[buffer_index++] = byte;
-                } else if (buffer_index == 1 && byte == PMS_FRAME_START2) {
-                    buffer[buffer_index++] = byte;
-                    frame_started = true;
-                } else {
-                    buffer_index = 0;
-                }
-            } else {
-                // Collect frame bytes
-                buffer[buffer_index++] = byte;
-
-                // Frame complete?
-                if (buffer_index >= PMS_FRAME_LENGTH) {
-                    if (parseFrame()) {
-                        new_data = true;
-                    }
-
-                    // Reset for next frame
-                    buffer_index = 0;
-                    frame_started = false;
-                }
-            }
-        }
-
-        return new_data;
+    PMS7003Data getData() {
+        return published.get();
     }
 
     /**
-     * @brief Get latest sensor data
+     * @brief Number of readings received, to detect a new one
      */
-    PMS7003Data getData() {
-        return data;
+    uint32_t getReadingCount() {
+        return published.getVersion();
     }
 
     /**
@@ -213,8 +229,9 @@ public:
      * @param max_age_ms Maximum age in milliseconds
      */
     bool isDataValid(uint32_t max_age_ms = 5000) {
-        if (!data.valid) return false;
-        return (millis() - data.last_update) < max_age_ms;
+        PMS7003Data reading = published.get();
+        if (!reading.valid) return false;
+        return (millis() - reading.last_update) < max_age_ms;
     }
 
     /**
@@ -229,16 +246,18 @@ public:
      * @brief Print data to serial (for debugging)
      */
     void printData() {
-        if (!data.valid) {
+        PMS7003Data reading = published.get();
+
+        if (!reading.valid) {
             Serial.println("[PMS] No valid data");
             return;
         }
 
-        uint32_t age = millis() - data.last_update;
+        uint32_t age = millis() - reading.last_update;
         Serial.printf("[PMS] PM1.0=%d PM2.5=%d PM10=%d µg/m³ (age=%lums)\n",
-                     data.pm1_0_atmospheric,
-                     data.pm2_5_atmospheric,
-                     data.pm10_atmospheric,
+                     reading.pm1_0_atmospheric,
+                     reading.pm2_5_atmospheric,
+                     reading.pm10_atmospheric,
                      age);
     }
 };
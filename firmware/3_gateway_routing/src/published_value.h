@@ -0,0 +1,65 @@
+/**
+ * @file published_value.h
+ * @brief Latest value written by one task and read by any task without locks
+ *
+ * Sequence lock: the writer makes the sequence odd while it copies the value
+ * and even when it is done. A reader copies the value and retries if the
+ * sequence was odd or changed meanwhile. The writer never waits, so it can
+ * be the UART event task.
+ */
+
+#ifndef PUBLISHED_VALUE_H
+#define PUBLISHED_VALUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+template <typename T>
+class PublishedValue {
+private:
+    T value;
+    std::atomic<uint32_t> sequence;
+
+public:
+    PublishedValue() : value(), sequence(0) {}
+
+    /**
+     * @brief Publish a new value (single writer)
+     */
+    void publish(const T& newValue) {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        value = newValue;
+
+        std::atomic_thread_fence(std::memory_order_release);
+        sequence.store(seq + 2, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Copy of the latest published value
+     */
+    T get() const {
+        T copy;
+        uint32_t before, after;
+
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            copy = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+
+        return copy;
+    }
+
+    /**
+     * @brief Number of values published
+     */
+    uint32_t getVersion() const {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+};
+
+#endif // PUBLISHED_VALUE_H
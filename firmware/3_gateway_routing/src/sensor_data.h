@@ -8,6 +8,9 @@
  * - Metadata (timestamp, sequence number)
  *
  * Total payload size: ~26 bytes (optimized for LoRa transmission)
+ *
+ * Several samples can be sent in one batch frame: a full key frame followed
+ * by the delta encoded PM values and timestamps of the next samples.
  */
 
 #ifndef SENSOR_DATA_H
@@ -37,12 +40,32 @@ struct __attribute__((packed)) EnhancedSensorData {
     uint8_t gps_valid;      // GPS fix status: 0=no fix, 1=valid fix
 
     // Metadata (6 bytes)
-    uint32_t timestamp;     // Milliseconds since boot
+    uint32_t timestamp;     // Milliseconds since boot, of the network with TIME_SYNC
     uint16_t sequence;      // Packet sequence number
 
     // Total: 26 bytes
 };
 
+/**
+ * @brief Batch frame of samples
+ *
+ * Layout:
+ *   [SENSOR_BATCH_MAGIC][count][key frame: EnhancedSensorData of the first sample]
+ *   then for each of the next count - 1 samples:
+ *   [zigzag varint ΔPM1.0][zigzag varint ΔPM2.5][zigzag varint ΔPM10][varint Δtimestamp]
+ *
+ * The deltas are relative to the previous sample. The GPS fields of the key
+ * frame apply to every sample, and the sequence numbers are consecutive from
+ * the sequence of the key frame. A batch frame is never sizeof(EnhancedSensorData)
+ * bytes long, so a single sample frame is told apart by its length.
+ */
+#define SENSOR_BATCH_MAGIC          0xB5
+#define SENSOR_BATCH_HEADER_SIZE    2
+#define SENSOR_BATCH_MAX_SAMPLES    6       // Worst case frame: 2 + 26 + 5 * 14 = 98 bytes
+#define SENSOR_BATCH_MAX_DELTA_SIZE 14      // 3 PM varints of 3 bytes + timestamp varint of 5 bytes
+#define SENSOR_BATCH_MAX_FRAME_SIZE (SENSOR_BATCH_HEADER_SIZE + sizeof(EnhancedSensorData) + \
+                                     (SENSOR_BATCH_MAX_SAMPLES - 1) * SENSOR_BATCH_MAX_DELTA_SIZE)
+
 /**
  * @brief Sensor Data Manager
  *
@@ -172,6 +195,126 @@ public:
     static size_t getPacketSize() {
         return sizeof(EnhancedSensorData);
     }
+
+    /**
+     * @brief Serialize samples to a frame (for LoRa transmission)
+     *
+     * One sample is serialized as a plain EnhancedSensorData, more as a batch frame.
+     *
+     * @param samples Samples, consecutive sequence numbers and increasing timestamps
+     * @param count Number of samples, 1 to SENSOR_BATCH_MAX_SAMPLES
+     * @param buffer Buffer of at least SENSOR_BATCH_MAX_FRAME_SIZE bytes
+     * @return size_t Frame size in bytes, 0 if count is out of range
+     */
+    static size_t serializeBatch(const EnhancedSensorData* samples, uint8_t count, uint8_t* buffer) {
+        if (count == 0 || count > SENSOR_BATCH_MAX_SAMPLES) {
+            return 0;
+        }
+
+        if (count == 1) {
+            serialize(samples[0], buffer);
+            return sizeof(EnhancedSensorData);
+        }
+
+        size_t size = 0;
+        buffer[size++] = SENSOR_BATCH_MAGIC;
+        buffer[size++] = count;
+        memcpy(buffer + size, &samples[0], sizeof(EnhancedSensorData));
+        size += sizeof(EnhancedSensorData);
+
+        for (uint8_t i = 1; i < count; i++) {
+            const EnhancedSensorData& previous = samples[i - 1];
+            const EnhancedSensorData& sample = samples[i];
+
+            size += writeVarint(buffer + size, zigzag((int32_t)sample.pm1_0 - previous.pm1_0));
+            size += writeVarint(buffer + size, zigzag((int32_t)sample.pm2_5 - previous.pm2_5));
+            size += writeVarint(buffer + size, zigzag((int32_t)sample.pm10 - previous.pm10));
+            size += writeVarint(buffer + size, sample.timestamp - previous.timestamp);
+        }
+
+        return size;
+    }
+
+    /**
+     * @brief Deserialize a single sample or a batch frame (at gateway)
+     *
+     * @param buffer Frame
+     * @param size Frame size in bytes
+     * @param samples Output samples, SENSOR_BATCH_MAX_SAMPLES entries
+     * @return uint8_t Number of samples, 0 if the frame is malformed
+     */
+    static uint8_t deserializeBatch(const uint8_t* buffer, size_t size, EnhancedSensorData* samples) {
+        if (size == sizeof(EnhancedSensorData)) {
+            samples[0] = deserialize(buffer);
+            return 1;
+        }
+
+        if (size < SENSOR_BATCH_HEADER_SIZE + sizeof(EnhancedSensorData) || buffer[0] != SENSOR_BATCH_MAGIC) {
+            return 0;
+        }
+
+        uint8_t count = buffer[1];
+        if (count < 2 || count > SENSOR_BATCH_MAX_SAMPLES) {
+            return 0;
+        }
+
+        size_t position = SENSOR_BATCH_HEADER_SIZE;
+        samples[0] = deserialize(buffer + position);
+        position += sizeof(EnhancedSensorData);
+
+        for (uint8_t i = 1; i < count; i++) {
+            uint32_t pm1_0, pm2_5, pm10, timestampDelta;
+            if (!readVarint(buffer, size, position, pm1_0) ||
+                !readVarint(buffer, size, position, pm2_5) ||
+                !readVarint(buffer, size, position, pm10) ||
+                !readVarint(buffer, size, position, timestampDelta)) {
+                return 0;
+            }
+
+            samples[i] = samples[i - 1];
+            samples[i].pm1_0 = (uint16_t)(samples[i - 1].pm1_0 + unzigzag(pm1_0));
+            samples[i].pm2_5 = (uint16_t)(samples[i - 1].pm2_5 + unzigzag(pm2_5));
+            samples[i].pm10 = (uint16_t)(samples[i - 1].pm10 + unzigzag(pm10));
+            samples[i].timestamp = samples[i - 1].timestamp + timestampDelta;
+            samples[i].sequence = samples[i - 1].sequence + 1;
+        }
+
+        return position == size ? count : 0;
+    }
+
+private:
+    static uint32_t zigzag(int32_t value) {
+        return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    }
+
+    static int32_t unzigzag(uint32_t value) {
+        return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    }
+
+    static size_t writeVarint(uint8_t* buffer, uint32_t value) {
+        size_t size = 0;
+        while (value >= 0x80) {
+            buffer[size++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        buffer[size++] = (uint8_t)value;
+        return size;
+    }
+
+    static bool readVarint(const uint8_t* buffer, size_t size, size_t& position, uint32_t& value) {
+        value = 0;
+        for (uint8_t shift = 0; shift < 35; shift += 7) {
+            if (position >= size) {
+                return false;
+            }
+            uint8_t byte = buffer[position++];
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
 };
 
 #endif // SENSOR_DATA_H
@@ -44,7 +44,7 @@ void trickleHelloTask(void* parameter) {
     vTaskDelay(2000 / portTICK_PERIOD_MS);
 
     size_t maxNodesPerPacket = (PacketFactory::getMaxPacketSize() - sizeof(RoutePacket)) / sizeof(NetworkNode);
-    Serial.printf("[TrickleHELLO] Max nodes per packet: %d\n", maxNodesPerPacket);
+    Serial.printf("[TrickleHELLO] Max nodes per packet: %d (more with the compact encoding)\n", maxNodesPerPacket);
 
     uint32_t lastCheck = 0;
     uint32_t lastActualTransmit = 0;  // Track last HELLO transmission for safety mechanism
@@ -77,30 +77,38 @@ void trickleHelloTask(void* parameter) {
                 lastActualTransmit = now;  // Update transmission timestamp
                 uint8_t localGatewayLoad = sampleLocalGatewayLoadForHello();
 
-                // Get current routing table
-                NetworkNode* nodes = RoutingTableService::getAllNetworkNodes();
-                size_t numOfNodes = RoutingTableService::routingTableSize();
+                // Get the routes to advertise, all of them or only the changed ones in delta mode
+                size_t numOfNodes;
+                uint8_t routeFlags, tableVersion;
+                NetworkNode* nodes = RoutingTableService::getNextAdvertisement(numOfNodes, routeFlags, tableVersion);
 
-                // Calculate number of packets needed
-                size_t numPackets = (numOfNodes + maxNodesPerPacket - 1) / maxNodesPerPacket;
-                numPackets = (numPackets == 0) ? 1 : numPackets;
-
-                // Send HELLO packet(s)
-                for (size_t i = 0; i < numPackets; ++i) {
-                    size_t startIndex = i * maxNodesPerPacket;
-                    size_t endIndex = startIndex + maxNodesPerPacket;
-                    if (endIndex > numOfNodes) {
-                        endIndex = numOfNodes;
-                    }
-
-                    size_t nodesInThisPacket = endIndex - startIndex;
+                // The time of the network goes down the mesh on the HELLOs, stamped when they are sent
+                if (TIME_SYNC && TimeSyncService::isSynced()) {
+                    routeFlags |= ROUTE_TIME_SYNC_F;
+                }
+                if (TdmaService::isEnabled()) {
+                    routeFlags |= ROUTE_TDMA_F;
+                }
+                if (BACKPRESSURE) {
+                    routeFlags |= ROUTE_CONGESTION_F;
+                }
+                if (TelemetryService::hasRecord()) {
+                    routeFlags |= ROUTE_TELEMETRY_F;
+                }
 
+                // Send HELLO packet(s), as many nodes per packet as fit in the encoding
+                size_t startIndex = 0;
+                size_t nodesInThisPacket;
+                do {
                     // Create routing packet (same as LoRaMesher does)
                     RoutePacket* tx = PacketService::createRoutingPacket(
                         radio.getLocalAddress(),
                         &nodes[startIndex],
-                        nodesInThisPacket,
-                        RoleService::getRole()
+                        numOfNodes - startIndex,
+                        RoleService::getRole(),
+                        routeFlags,
+                        tableVersion,
+                        nodesInThisPacket
                     );
                     tx->gatewayLoad = localGatewayLoad;
 
@@ -112,7 +120,9 @@ void trickleHelloTask(void* parameter) {
                     );
 
                     // Note: Don't delete tx - setPackedForSend takes ownership
-                }
+
+                    startIndex += nodesInThisPacket;
+                } while (startIndex < numOfNodes && nodesInThisPacket > 0);
 
                 // Clean up nodes array
                 if (numOfNodes > 0)
@@ -180,7 +190,7 @@ void onHelloReceived(uint16_t fromAddr) {
     trickleTimer.heardConsistent();
 
     // 2. Update link metrics for bidirectional support
-    // Calls main.cpp function (has access to getLinkMetrics/updateETX)
+    // Calls main.cpp function (updates the NeighborTableService entry)
     updateLinkMetricsFromHello(fromAddr);
 
     // 3. Update neighbor health tracking (FAST fault detection)
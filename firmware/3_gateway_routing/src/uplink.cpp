@@ -0,0 +1,271 @@
+/**
+ * @file uplink.cpp
+ * @brief Binary uplink of the received samples implementation
+ */
+
+#include "uplink.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "LoraMesher.h"
+#include "config.h"
+#include "utilities/Crc16.hpp"
+
+// Global uplink instance
+Uplink uplink;
+
+// Socket of the WiFi transport, open for the life of the task
+static WiFiUDP udp;
+
+Uplink::Uplink() {
+    queue = NULL;
+    task = NULL;
+    transport = UPLINK_TRANSPORT_SERIAL;
+    gateway = 0;
+    droppedPending = 0;
+    droppedTotal = 0;
+    networkOffset = 0;
+    networkKnown = false;
+    offline = NULL;
+    offlineAt = NULL;
+    offlineHead = 0;
+    offlineCount = 0;
+    offlineDropped = 0;
+    lastReconnect = 0;
+    batchesSent = 0;
+    ssid = NULL;
+    password = NULL;
+    host = NULL;
+    port = 0;
+}
+
+void Uplink::setWiFi(const char* wifiSsid, const char* wifiPassword, const char* udpHost, uint16_t udpPort) {
+    ssid = wifiSsid;
+    password = wifiPassword;
+    host = udpHost;
+    port = udpPort;
+}
+
+bool Uplink::begin(uint16_t localAddress, UplinkTransport uplinkTransport) {
+    gateway = localAddress;
+    transport = uplinkTransport;
+
+    if (transport == UPLINK_TRANSPORT_WIFI) {
+        if (ssid == NULL || host == NULL) {
+            return false;
+        }
+
+        if (offline == NULL) {
+            offline = static_cast<UplinkRecord*>(malloc(UPLINK_OFFLINE_RECORDS * sizeof(UplinkRecord)));
+            if (offline == NULL) {
+                return false;
+            }
+        }
+
+        if (offlineAt == NULL) {
+            offlineAt = static_cast<uint32_t*>(malloc(UPLINK_OFFLINE_RECORDS * sizeof(uint32_t)));
+            if (offlineAt == NULL) {
+                return false;
+            }
+        }
+
+        // The WiFi driver reconnects in the background, the radio tasks never wait for it
+        WiFi.mode(WIFI_STA);
+        WiFi.setAutoReconnect(true);
+        WiFi.begin(ssid, password);
+        lastReconnect = millis();
+        udp.begin(port);
+    }
+
+    if (queue == NULL) {
+        queue = xQueueCreate(UPLINK_QUEUE_LENGTH, sizeof(UplinkRecord));
+        if (queue == NULL) {
+            return false;
+        }
+    }
+
+    if (task == NULL &&
+        xTaskCreate(run, "Uplink", UPLINK_TASK_STACK, this, UPLINK_TASK_PRIORITY, &task) != pdPASS) {
+        task = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+bool Uplink::push(uint16_t src, int8_t rssi, int8_t snr, uint8_t hops, uint32_t frameSize,
+                  const EnhancedSensorData& data) {
+    if (queue == NULL) {
+        return false;
+    }
+
+    UplinkRecord record;
+    record.type = UPLINK_RECORD_SAMPLE;
+    record.version = UPLINK_VERSION;
+    record.gateway = gateway;
+    record.src = src;
+    record.rssi = rssi;
+    record.snr = snr;
+    record.hops = hops;
+    record.frameSize = frameSize > UINT8_MAX ? UINT8_MAX : frameSize;
+    record.dropped = droppedPending > UINT16_MAX ? UINT16_MAX : droppedPending;
+    record.rxTime = getRxTime();
+    record.data = data;
+
+    if (xQueueSend(queue, &record, 0) != pdTRUE) {
+        droppedPending++;
+        droppedTotal++;
+        return false;
+    }
+
+    droppedPending = 0;
+    return true;
+}
+
+size_t Uplink::encodeCOBS(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t codeIndex = 0;
+    size_t outLength = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < length; i++) {
+        if (in[i] != 0) {
+            out[outLength++] = in[i];
+            code++;
+        }
+
+        // A zero, or a run of 254 bytes without one, closes the block
+        if (in[i] == 0 || code == 0xFF) {
+            out[codeIndex] = code;
+            codeIndex = outLength++;
+            code = 1;
+        }
+    }
+
+    out[codeIndex] = code;
+    return outLength;
+}
+
+size_t Uplink::encodeFrame(const UplinkRecord& record, uint8_t* frame) {
+    uint8_t raw[sizeof(UplinkRecord) + 2];
+    memcpy(raw, &record, sizeof(UplinkRecord));
+
+    uint16_t crc = LM_Crc16(raw, sizeof(UplinkRecord));
+    raw[sizeof(UplinkRecord)] = crc & 0xFF;
+    raw[sizeof(UplinkRecord) + 1] = crc >> 8;
+
+    frame[0] = 0x00;
+    size_t length = 1 + encodeCOBS(raw, sizeof(raw), frame + 1);
+    frame[length++] = 0x00;
+    return length;
+}
+
+void Uplink::writeFrame(const UplinkRecord& record) {
+    // One write per frame, so the text logs of the other tasks do not split it
+    uint8_t frame[UPLINK_FRAME_LENGTH + 2];
+    Serial.write(frame, encodeFrame(record, frame));
+}
+
+void Uplink::storeOffline(const UplinkRecord& record) {
+    if (offlineCount == UPLINK_OFFLINE_RECORDS) {
+        // Full, the oldest record is dropped and counted in the next one
+        uint32_t dropped = offline[offlineHead].dropped + 1;
+        offlineHead = (offlineHead + 1) % UPLINK_OFFLINE_RECORDS;
+        offlineCount--;
+        offlineDropped++;
+
+        dropped += offline[offlineHead].dropped;
+        offline[offlineHead].dropped = dropped > UINT16_MAX ? UINT16_MAX : dropped;
+    }
+
+    uint16_t index = (offlineHead + offlineCount) % UPLINK_OFFLINE_RECORDS;
+    offline[index] = record;
+    offlineAt[index] = millis();
+    offlineCount++;
+}
+
+TickType_t Uplink::getBatchWait() {
+    if (offlineCount == 0) {
+        return portMAX_DELAY;
+    }
+
+    if (offlineCount >= UPLINK_BATCH_RECORDS) {
+        return 0;
+    }
+
+    // rxTime moves to the network clock when it is synchronized and back when it is lost, the batches age on the local one
+    uint32_t age = millis() - offlineAt[offlineHead];
+    return age >= UPLINK_BATCH_MS ? 0 : pdMS_TO_TICKS(UPLINK_BATCH_MS - age);
+}
+
+uint32_t Uplink::getRxTime() {
+    int64_t time;
+    if (TIME_SYNC && LoraMesher::getInstance().getSyncedTime(time)) {
+        networkOffset = (uint32_t) (time / 1000) - millis();
+        networkKnown = true;
+    }
+
+    // Once synchronized the records stay on the network clock, with the last offset while the sync is lost
+    return networkKnown ? millis() + networkOffset : millis();
+}
+
+bool Uplink::sendBatches() {
+    while (offlineCount > 0 && getBatchWait() == 0) {
+        if (WiFi.status() != WL_CONNECTED) {
+            // The automatic reconnection can give up after a failed attempt
+            if (millis() - lastReconnect >= UPLINK_RECONNECT_MS) {
+                WiFi.reconnect();
+                lastReconnect = millis();
+            }
+            return false;
+        }
+
+        uint16_t count = offlineCount < UPLINK_BATCH_RECORDS ? offlineCount : UPLINK_BATCH_RECORDS;
+
+        // One datagram per batch, the frames are the ones of the serial transport
+        uint8_t frame[UPLINK_FRAME_LENGTH + 2];
+        if (!udp.beginPacket(host, port)) {
+            return false;
+        }
+
+        for (uint16_t i = 0; i < count; i++) {
+            const UplinkRecord& record = offline[(offlineHead + i) % UPLINK_OFFLINE_RECORDS];
+            udp.write(frame, encodeFrame(record, frame));
+        }
+
+        if (!udp.endPacket()) {
+            return false;
+        }
+
+        offlineHead = (offlineHead + count) % UPLINK_OFFLINE_RECORDS;
+        offlineCount -= count;
+        batchesSent++;
+    }
+
+    return true;
+}
+
+void Uplink::run(void* parameter) {
+    Uplink* self = static_cast<Uplink*>(parameter);
+    UplinkRecord record;
+
+    for (;;) {
+        if (self->transport == UPLINK_TRANSPORT_SERIAL) {
+            if (xQueueReceive(self->queue, &record, portMAX_DELAY) == pdTRUE) {
+                self->writeFrame(record);
+            }
+            continue;
+        }
+
+        // WiFi: wake for the next record or the next due batch, every second while the WiFi is down
+        TickType_t wait = self->getBatchWait();
+        if (wait == 0) {
+            wait = pdMS_TO_TICKS(1000);
+        }
+
+        while (xQueueReceive(self->queue, &record, wait) == pdTRUE) {
+            self->storeOffline(record);
+            wait = 0;
+        }
+
+        self->sendBatches();
+    }
+}
@@ -0,0 +1,143 @@
+/**
+ * @file uplink.h
+ * @brief Binary uplink of the received samples from the gateway to the Pi
+ *
+ * In binary mode the RX task does not format the samples as text: it copies
+ * an UplinkRecord into a queue and returns. A dedicated uplink task appends
+ * the CRC, COBS-encodes the record and writes it between two delimiters:
+ *
+ *   [0x00][COBS of UplinkRecord + CRC-16/CCITT-FALSE of the record, little endian][0x00]
+ *
+ * A COBS frame never contains 0x00, so the reader finds the next frame after
+ * a lost byte or a text log written in between, and drops the frames with a
+ * wrong CRC. The decoder is raspberry_pi/uplink_decoder.py.
+ *
+ * Over WiFi the same frames are sent in batches, one UDP datagram of up to
+ * UPLINK_BATCH_RECORDS frames, at most UPLINK_BATCH_MS after the oldest
+ * record. While the WiFi is down the records wait in a bounded offline
+ * buffer, the oldest ones are dropped when it is full.
+ */
+
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <Arduino.h>
+#include "sensor_data.h"
+
+// Records waiting for the uplink task, a full queue drops the record
+#define UPLINK_QUEUE_LENGTH     32
+// Uplink task
+#define UPLINK_TASK_STACK       3072
+#define UPLINK_TASK_PRIORITY    1
+// Record types and format version, increase the version when UplinkRecord changes
+#define UPLINK_RECORD_SAMPLE    0x01
+#define UPLINK_VERSION          1
+// WiFi batches: records per datagram and maximum wait of the oldest record
+#define UPLINK_BATCH_RECORDS    16
+#define UPLINK_BATCH_MS         5000
+// Records kept while the WiFi is down
+#define UPLINK_OFFLINE_RECORDS  256
+// Minimum time between two WiFi reconnection attempts
+#define UPLINK_RECONNECT_MS     10000
+
+// Where the uplink task writes the records
+enum UplinkTransport {
+    UPLINK_TRANSPORT_SERIAL,    // One frame per record on Serial
+    UPLINK_TRANSPORT_WIFI       // Batches of frames in UDP datagrams
+};
+
+/**
+ * @brief Sample received by the gateway with the reception metadata of its frame
+ */
+struct __attribute__((packed)) UplinkRecord {
+    uint8_t type;               // UPLINK_RECORD_SAMPLE
+    uint8_t version;            // UPLINK_VERSION
+    uint16_t gateway;           // Address of the gateway
+    uint16_t src;               // Address of the sensor
+    int8_t rssi;                // dBm
+    int8_t snr;                 // dB
+    uint8_t hops;               // Hop count of the frame
+    uint8_t frameSize;          // Payload size of the frame, a batch carries several samples
+    uint16_t dropped;           // Records dropped since the previous one, the queue was full
+    uint32_t rxTime;            // Milliseconds since boot of the gateway, of the network with TIME_SYNC once synchronized
+    EnhancedSensorData data;
+};
+
+// COBS adds one byte every 254 bytes and the first code byte
+#define UPLINK_FRAME_LENGTH     (sizeof(UplinkRecord) + 2 + (sizeof(UplinkRecord) + 2) / 254 + 1)
+
+class Uplink {
+private:
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    UplinkTransport transport;
+    uint16_t gateway;
+    uint32_t droppedPending;    // Written in the next record, only the RX task pushes
+    uint32_t droppedTotal;
+    uint32_t networkOffset;     // Network clock minus millis() at the last synchronized record, only the RX task uses it
+    bool networkKnown;
+
+    // Offline buffer of the WiFi transport, only the uplink task uses it
+    UplinkRecord* offline;
+    uint32_t* offlineAt;        // millis() when every offline record was stored
+    uint16_t offlineHead;       // Oldest record
+    uint16_t offlineCount;
+    uint32_t offlineDropped;
+    uint32_t lastReconnect;
+    uint32_t batchesSent;
+
+    const char* ssid;
+    const char* password;
+    const char* host;
+    uint16_t port;
+
+public:
+    Uplink();
+
+    /**
+     * @brief Create the queue and the uplink task, and start the WiFi connection of the WiFi transport
+     * @param localAddress Address of the gateway written in every record
+     */
+    bool begin(uint16_t localAddress, UplinkTransport uplinkTransport = UPLINK_TRANSPORT_SERIAL);
+
+    /**
+     * @brief Network of the WiFi transport, before begin()
+     * @param host Receiver of the datagrams, raspberry_pi/mqtt_publisher.py --udp
+     */
+    void setWiFi(const char* wifiSsid, const char* wifiPassword, const char* udpHost, uint16_t udpPort);
+
+    bool isEnabled() const { return task != NULL; }
+
+    /**
+     * @brief Queue a received sample, never blocks
+     * @return false if the queue is full, the record is dropped and counted
+     */
+    bool push(uint16_t src, int8_t rssi, int8_t snr, uint8_t hops, uint32_t frameSize,
+              const EnhancedSensorData& data);
+
+    // Records dropped because the queue or the offline buffer was full, since begin()
+    uint32_t getDroppedCount() const { return droppedTotal + offlineDropped; }
+
+    // Records waiting for the WiFi
+    uint16_t getOfflineCount() const { return offlineCount; }
+
+    uint32_t getBatchesSent() const { return batchesSent; }
+
+private:
+    size_t encodeFrame(const UplinkRecord& record, uint8_t* frame);
+    void writeFrame(const UplinkRecord& record);
+    void storeOffline(const UplinkRecord& record);
+    // Send the due batches, false if the WiFi is down
+    bool sendBatches();
+    // Time until the oldest offline record is due
+    TickType_t getBatchWait();
+    // Clock of rxTime
+    uint32_t getRxTime();
+    static size_t encodeCOBS(const uint8_t* in, size_t length, uint8_t* out);
+    static void run(void* parameter);
+};
+
+// Global uplink instance
+extern Uplink uplink;
+
+#endif
@@ -1,6 +1,11 @@
 /**
  * @file display_utils.h
  * @brief Common display utilities for OLED management
+ *
+ * After startTask() the display is drawn by its own low priority task:
+ * update() only publishes a snapshot of the NodeStatus, the task renders it
+ * and sends over I2C only the SSD1306 pages (8 pixel rows) that changed
+ * since the previous frame.
  */
 
 #ifndef DISPLAY_UTILS_H
@@ -16,6 +21,12 @@
 #define DISPLAY_UPDATE_INTERVAL_MS  1000    // Update every second
 #define DISPLAY_TIMEOUT_MS          30000   // Turn off after 30 seconds of inactivity
 
+// Display task
+#define DISPLAY_TASK_STACK          4096
+#define DISPLAY_TASK_PRIORITY       1
+#define DISPLAY_TASK_CORE           0       // loop() and the application tasks run on core 1
+#define DISPLAY_MESSAGE_LENGTH      22      // 21 characters per line
+
 // Display pages
 enum DisplayPage {
     PAGE_STATUS = 0,
@@ -25,8 +36,8 @@ enum DisplayPage {
     PAGE_COUNT
 };
 
-// Node status structure for display
-struct NodeStatus {
+// Node metrics shown in the display
+struct NodeMetrics {
     uint16_t nodeId;
     uint8_t nodeRole;
 
@@ -55,11 +66,19 @@ struct NodeStatus {
     uint32_t uptimeMs;
     uint32_t freeHeap;
     float cpuUsage;
+};
 
+// Node status structure for display
+struct NodeStatus : NodeMetrics {
     // Status message
     String statusMessage;
 };
 
+// Immutable copy of a NodeStatus, drawn by the display
+struct DisplaySnapshot : NodeMetrics {
+    char statusMessage[DISPLAY_MESSAGE_LENGTH];
+};
+
 class DisplayManager {
 private:
     Adafruit_SSD1306* display;
@@ -67,13 +86,33 @@ private:
     unsigned long lastUpdateMs;
     unsigned long lastActivityMs;
     bool displayEnabled;
-    NodeStatus* status;
+    DisplaySnapshot* status;
+
+    // Snapshot being drawn and latest published snapshot
+    DisplaySnapshot shown;
+    DisplaySnapshot published;
+    bool snapshotPublished;
+
+    // Last frame sent to the SSD1306, to send only the changed pages
+    uint8_t lastFrame[SCREEN_WIDTH * SCREEN_HEIGHT / 8];
+    bool lastFrameValid;
+
+    // Requests of the other tasks to the display task
+    volatile bool pageRequested;
+    char message[DISPLAY_MESSAGE_LENGTH * 4];
+    volatile bool messagePending;
+    bool messageTemporary;
+
+    TaskHandle_t task;
+    portMUX_TYPE snapshotMux;
 
 public:
     DisplayManager();
     ~DisplayManager();
 
     bool begin();
+    // Draw in a low priority task pinned to a core, update() then only publishes the status
+    bool startTask(BaseType_t core = DISPLAY_TASK_CORE);
     void update(NodeStatus& nodeStatus);
     void nextPage();
     void showMessage(const String& message, bool temporary = false);
@@ -82,6 +121,13 @@ public:
     void clear();
 
 private:
+    void publish(const NodeStatus& nodeStatus);
+    void refresh();
+    void drawMessage(const char* text);
+    void pushChangedPages();
+    void sendPage(uint8_t page, const uint8_t* data);
+    static void taskLoop(void* parameter);
+
     void drawStatusPage();
     void drawMetricsPage();
     void drawRoutingPage();
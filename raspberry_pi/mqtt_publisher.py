@@ -5,9 +5,12 @@ Bridges LoRa mesh gateway to MQTT broker for real-time monitoring
 
 Usage:
     python3 mqtt_publisher.py --port /dev/ttyUSB0 --config mqtt_config.json
+    python3 mqtt_publisher.py --port /dev/ttyUSB0 --binary   # gateway built with UPLINK_BINARY
+    python3 mqtt_publisher.py --udp 5005                     # gateways built with UPLINK_WIFI
 """
 
 import serial
+import socket
 import json
 import argparse
 import signal
@@ -19,12 +22,17 @@ import struct
 import re
 import ssl
 import certifi
+from uplink_decoder import UplinkReader
 
 class xMESH_MQTT_Publisher:
-    def __init__(self, serial_port, baudrate, mqtt_config_file):
+    def __init__(self, serial_port, baudrate, mqtt_config_file, binary=False, udp_port=None):
         self.serial_port = serial_port
         self.baudrate = baudrate
+        self.udp_port = udp_port
+        self.binary = binary or udp_port is not None
+        self.uplink = UplinkReader() if self.binary else None
         self.serial_conn = None
+        self.udp_socket = None
         self.mqtt_client = None
         self.running = False
 
@@ -120,6 +128,18 @@ class xMESH_MQTT_Publisher:
             print(f"❌ Serial setup error: {e}")
             return False
 
+    def setup_udp(self):
+        """Listen for the datagrams of the gateways with the WiFi uplink"""
+        try:
+            self.udp_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.udp_socket.bind(('0.0.0.0', self.udp_port))
+            self.udp_socket.settimeout(1)
+            print(f"✅ Listening for gateway uplink datagrams on UDP port {self.udp_port}")
+            return True
+        except Exception as e:
+            print(f"❌ UDP setup error: {e}")
+            return False
+
     def parse_sensor_packet(self, line):
         """
         Parse EnhancedSensorData packet from serial output
@@ -195,6 +215,60 @@ class xMESH_MQTT_Publisher:
         except Exception as e:
             return None
 
+    def record_to_packet(self, record):
+        """Convert a binary uplink record to the packet of parse_sensor_packet"""
+        packet = {
+            'sequence': record['sequence'],
+            'src': f"{record['src']:04X}",
+            'timestamp': datetime.now().isoformat(),
+            'pm1_0': float(record['pm1_0']),
+            'pm2_5': float(record['pm2_5']),
+            'pm10': float(record['pm10']),
+            'rssi': record['rssi'],
+            'snr': record['snr'],
+            'hops': record['hops']
+        }
+
+        if record['gps_valid']:
+            packet['latitude'] = record['latitude']
+            packet['longitude'] = record['longitude']
+            packet['altitude'] = record['altitude']
+            packet['satellites'] = record['satellites']
+            packet['gps_valid'] = True
+
+        return packet
+
+    def handle_packet(self, packet_data):
+        """Count and publish a parsed sensor packet"""
+        self.stats['packets_received'] += 1
+        if self.mqtt_client:
+            self.publish_sensor_data(packet_data)
+
+        # Print statistics every 10 packets
+        if self.stats['packets_received'] % 10 == 0:
+            self.print_stats()
+
+    def read_binary(self):
+        """Read the binary uplink, the text logs in between are printed"""
+        if self.udp_socket:
+            # A datagram is a batch of complete frames
+            try:
+                data, _ = self.udp_socket.recvfrom(4096)
+            except socket.timeout:
+                return
+        else:
+            data = self.serial_conn.read(self.serial_conn.in_waiting or 1)
+
+        items = self.uplink.feed(data) if data else self.uplink.flush_text()
+
+        for kind, item in items:
+            if kind == 'text':
+                print(item)
+            else:
+                print(f"RX: Seq={item['sequence']} From={item['src']:04X} "
+                      f"RSSI={item['rssi']} SNR={item['snr']} Hops={item['hops']}")
+                self.handle_packet(self.record_to_packet(item))
+
     def publish_sensor_data(self, packet_data):
         """Publish parsed sensor data to MQTT topics"""
         if not self.mqtt_client or not packet_data:
@@ -207,7 +281,7 @@ class xMESH_MQTT_Publisher:
             )
 
             # Create JSON payload
-            payload = json.dumps({
+            payload = {
                 'timestamp': packet_data.get('timestamp'),
                 'sequence': packet_data.get('sequence'),
                 'source': packet_data.get('src'),
@@ -219,7 +293,14 @@ class xMESH_MQTT_Publisher:
                 'altitude': packet_data.get('altitude', 0.0),
                 'satellites': packet_data.get('satellites', 0),
                 'gps_valid': packet_data.get('gps_valid', False)
-            })
+            }
+
+            # Link quality of the binary uplink records
+            for key in ('rssi', 'snr', 'hops'):
+                if key in packet_data:
+                    payload[key] = packet_data[key]
+
+            payload = json.dumps(payload)
 
             # Publish with QoS=1 (at least once delivery)
             result = self.mqtt_client.publish(
@@ -247,7 +328,10 @@ class xMESH_MQTT_Publisher:
         print("╚═══════════════════════════════════════════════════════════╝\n")
 
         # Setup connections
-        if not self.setup_serial():
+        if self.udp_port is not None:
+            if not self.setup_udp():
+                return
+        elif not self.setup_serial():
             return
 
         if not self.setup_mqtt():
@@ -261,7 +345,9 @@ class xMESH_MQTT_Publisher:
 
         try:
             while self.running:
-                if self.serial_conn.in_waiting > 0:
+                if self.binary:
+                    self.read_binary()
+                elif self.serial_conn.in_waiting > 0:
                     line = self.serial_conn.readline().decode('utf-8', errors='ignore').strip()
 
                     # Print to console for monitoring
@@ -270,13 +356,7 @@ class xMESH_MQTT_Publisher:
                     # Parse and publish sensor packets
                     packet_data = self.parse_sensor_packet(line)
                     if packet_data:
-                        self.stats['packets_received'] += 1
-                        if self.mqtt_client:
-                            self.publish_sensor_data(packet_data)
-
-                    # Print statistics every 60 seconds
-                    if self.stats['packets_received'] > 0 and self.stats['packets_received'] % 10 == 0:
-                        self.print_stats()
+                        self.handle_packet(packet_data)
 
         except KeyboardInterrupt:
             print("\n\n⏹️  Stopping MQTT publisher...")
@@ -303,19 +383,32 @@ class xMESH_MQTT_Publisher:
             self.serial_conn.close()
             print("✅ Serial closed")
 
+        if self.udp_socket:
+            self.udp_socket.close()
+            print("✅ UDP socket closed")
+
         self.print_stats()
+        if self.uplink:
+            print(f"Uplink: {self.uplink.stats['frames']} frames, {self.uplink.stats['bad_frames']} bad, "
+                  f"{self.uplink.stats['dropped']} dropped by the gateway")
         print("\n✅ Shutdown complete\n")
 
 def main():
     parser = argparse.ArgumentParser(description='xMESH MQTT Publisher for AIT Hazemon')
-    parser.add_argument('--port', required=True, help='Serial port (e.g., /dev/ttyUSB0)')
+    parser.add_argument('--port', help='Serial port (e.g., /dev/ttyUSB0)')
     parser.add_argument('--baudrate', type=int, default=115200, help='Serial baud rate')
     parser.add_argument('--config', default='mqtt_config.json', help='MQTT config file')
+    parser.add_argument('--binary', action='store_true',
+                        help='Binary uplink frames of a gateway built with UPLINK_BINARY')
+    parser.add_argument('--udp', type=int, metavar='PORT',
+                        help='Receive the batches of the gateways built with UPLINK_WIFI instead of a serial port')
 
     args = parser.parse_args()
+    if args.port is None and args.udp is None:
+        parser.error('--port or --udp is required')
 
     # Create publisher
-    publisher = xMESH_MQTT_Publisher(args.port, args.baudrate, args.config)
+    publisher = xMESH_MQTT_Publisher(args.port, args.baudrate, args.config, args.binary, args.udp)
 
     # Setup signal handler for graceful shutdown
     def signal_handler(sig, frame):
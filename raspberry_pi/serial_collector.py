@@ -16,11 +16,14 @@ from datetime import datetime
 from pathlib import Path
 import paho.mqtt.client as mqtt
 import json
+from uplink_decoder import UplinkReader
 
 class SerialCollector:
-    def __init__(self, port, baudrate, output_file, database_file=None, mqtt_config=None):
+    def __init__(self, port, baudrate, output_file, database_file=None, mqtt_config=None, binary=False):
         self.port = port
         self.baudrate = baudrate
+        self.binary = binary
+        self.uplink = UplinkReader() if binary else None
         self.output_file = output_file
         self.database_file = database_file
         self.mqtt_config = mqtt_config
@@ -180,7 +183,9 @@ class SerialCollector:
 
         while self.running:
             try:
-                if self.serial_conn.in_waiting > 0:
+                if self.binary:
+                    header_written = self.read_binary(header_written)
+                elif self.serial_conn.in_waiting > 0:
                     line = self.serial_conn.readline().decode('utf-8').strip()
 
                     if line:
@@ -216,6 +221,35 @@ class SerialCollector:
                 print(f"Unexpected error: {e}")
                 self.stats['errors'] += 1
 
+    def read_binary(self, header_written):
+        """Read the binary uplink, the samples are logged as RX rows and the text in between is printed"""
+        if not header_written:
+            self.csv_writer.writerow(['timestamp', 'node_id', 'event_type', 'src', 'dest', 'rssi', 'snr',
+                                      'etx', 'hop_count', 'packet_size', 'sequence', 'cost', 'next_hop',
+                                      'gateway'])
+            header_written = True
+
+        data = self.serial_conn.read(self.serial_conn.in_waiting or 1)
+        items = self.uplink.feed(data) if data else self.uplink.flush_text()
+
+        for kind, item in items:
+            if kind == 'text':
+                print(f"Debug: {item}")
+                continue
+
+            self.stats['packets_received'] += 1
+            self.last_packet_time = datetime.now()
+            if item['dropped']:
+                print(f"Uplink: {item['dropped']} records dropped by the gateway")
+
+            # Same columns as the CSV rows of the gateway logger
+            self.process_csv_line(','.join(str(field) for field in (
+                item['rx_time'], item['gateway'], 'RX', item['src'], item['gateway'],
+                item['rssi'], item['snr'], 0.0, item['hops'], item['frame_size'],
+                item['sequence'], 0.0, 0, item['gateway'])))
+
+        return header_written
+
     def process_csv_line(self, line):
         """Process a CSV data line"""
         try:
@@ -319,6 +353,9 @@ class SerialCollector:
         print(f"Packets Received: {self.stats['packets_received']}")
         print(f"Packets Logged: {self.stats['packets_logged']}")
         print(f"Errors: {self.stats['errors']}")
+        if self.uplink:
+            print(f"Uplink Frames: {self.uplink.stats['frames']} "
+                  f"({self.uplink.stats['bad_frames']} bad, {self.uplink.stats['dropped']} dropped by the gateway)")
 
         if self.last_packet_time:
             time_since_last = datetime.now() - self.last_packet_time
@@ -371,6 +408,8 @@ def main():
                        help='MQTT username')
     parser.add_argument('--mqtt-pass',
                        help='MQTT password')
+    parser.add_argument('--binary', action='store_true',
+                       help='Binary uplink frames of a gateway built with UPLINK_BINARY')
     parser.add_argument('--protocol', default='unknown',
                        help='Protocol being tested (flooding/hopcount/gateway)')
     parser.add_argument('--topology', default='unknown',
@@ -402,7 +441,8 @@ def main():
         baudrate=args.baud,
         output_file=args.output,
         database_file=args.database,
-        mqtt_config=mqtt_config
+        mqtt_config=mqtt_config,
+        binary=args.binary
     )
 
     # Setup signal handler
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Decoder of the binary gateway uplink (firmware/3_gateway_routing/src/uplink.h)
+
+Frame: [0x00][COBS of UplinkRecord + CRC-16/CCITT-FALSE of the record, little endian][0x00]
+The text logs of the gateway can be written between the frames, they are
+returned as lines.
+"""
+
+import struct
+
+UPLINK_RECORD_SAMPLE = 0x01
+UPLINK_VERSION = 1
+
+# UplinkRecord followed by EnhancedSensorData, packed little endian
+RECORD_FORMAT = '<BBHHbbBBHI' + 'HHHfffBBIH'
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+RECORD_FIELDS = (
+    'type', 'version', 'gateway', 'src', 'rssi', 'snr', 'hops', 'frame_size', 'dropped', 'rx_time',
+    'pm1_0', 'pm2_5', 'pm10', 'latitude', 'longitude', 'altitude', 'satellites', 'gps_valid',
+    'timestamp', 'sequence'
+)
+
+# Longest COBS frame of a record, longer data between two delimiters is text
+MAX_FRAME_LENGTH = RECORD_SIZE + 2 + (RECORD_SIZE + 2) // 254 + 1
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as LM_Crc16 of the library"""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """Decode a COBS block without its delimiters, None if it is malformed"""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_frame(frame):
+    """Decode a frame between two delimiters, None if it is not a valid record"""
+    if len(frame) > MAX_FRAME_LENGTH:
+        return None
+
+    raw = cobs_decode(frame)
+    if raw is None or len(raw) != RECORD_SIZE + 2:
+        return None
+
+    record, crc = raw[:RECORD_SIZE], struct.unpack('<H', raw[RECORD_SIZE:])[0]
+    if crc16(record) != crc:
+        return None
+
+    fields = dict(zip(RECORD_FIELDS, struct.unpack(RECORD_FORMAT, record)))
+    if fields['type'] != UPLINK_RECORD_SAMPLE or fields['version'] != UPLINK_VERSION:
+        return None
+
+    fields['gps_valid'] = bool(fields['gps_valid'])
+    return fields
+
+
+class UplinkReader:
+    """
+    Splits the serial stream into records and text lines.
+
+    The data between two delimiters is a frame if it decodes, otherwise text.
+    Without a delimiter the complete lines are text once the stream is idle,
+    a frame is written at once so it is never left half read.
+    """
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.stats = {'frames': 0, 'bad_frames': 0, 'dropped': 0}
+
+    def feed(self, data):
+        """Add the bytes read from the serial port, returns a list of ('record', dict) and ('text', str)"""
+        self.buffer += data
+        items = []
+
+        while True:
+            end = self.buffer.find(0)
+            if end < 0:
+                break
+
+            segment = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if segment:
+                items += self._segment(segment)
+
+        return items
+
+    def flush_text(self):
+        """Complete lines waiting without a delimiter, call when the port is idle"""
+        end = self.buffer.rfind(b'\n')
+        if end < 0:
+            return []
+
+        text = bytes(self.buffer[:end + 1])
+        del self.buffer[:end + 1]
+        return self._text(text)
+
+    def _segment(self, segment):
+        record = decode_frame(segment)
+        if record is not None:
+            self.stats['frames'] += 1
+            self.stats['dropped'] += record['dropped']
+            return [('record', record)]
+
+        # Short data without a line end between two delimiters is a damaged frame
+        if b'\n' not in segment and len(segment) <= MAX_FRAME_LENGTH:
+            self.stats['bad_frames'] += 1
+            return []
+
+        return self._text(segment)
+
+    @staticmethod
+    def _text(data):
+        lines = data.decode('utf-8', errors='ignore').splitlines()
+        return [('text', line.strip()) for line in lines if line.strip()]
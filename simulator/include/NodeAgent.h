@@ -0,0 +1,185 @@
+/**
+ * @file NodeAgent.h
+ * @brief Interface between the simulator runner and the LoRaMesher of a node
+ *
+ * Every node is a copy of the node library, with its own LoraMesher and services. The runner only reaches it through
+ * this table of functions, it does not include LoraMesher.h.
+ */
+
+#ifndef SIM_NODE_AGENT_H
+#define SIM_NODE_AGENT_H
+
+#include <cstdint>
+
+struct LmSimNodeStats {
+    uint32_t sentPacketsNum;
+    uint32_t receivedDataPacketsNum;
+    uint32_t forwardedPacketsNum;
+    uint32_t dataPacketForMeNum;
+    uint32_t sentHelloPacketsNum;
+    uint32_t receivedHelloPacketsNum;
+    uint32_t destinyUnreachableNum;
+    uint32_t sendQueueDroppedNum;
+    uint32_t sendQueueExpiredNum;
+    uint32_t sendQueueReplacedNum;
+    uint32_t spoolStoredNum;
+    uint32_t spoolDrainedNum;
+    uint32_t spoolDroppedNum;
+    uint32_t spoolSize;
+    uint32_t receivedQueueDroppedNum;
+    uint32_t channelBusyNum;
+    // Receive errors and the channel sensed by the node, in ms, see LM_Stats
+    uint32_t rxCrcErrorsNum;
+    uint32_t preambleWithoutPacketNum;
+    uint32_t rxDeafTime;
+    uint32_t busyTxTime;
+    uint32_t busyRxTime;
+    uint32_t busyCadTime;
+    uint16_t channelBusyPerMille;
+    uint32_t hopRetransmissionsNum;
+    uint32_t hopAckLostNum;
+    uint32_t datagramsIncompleteNum;
+    uint32_t fecRebuiltNum;
+    uint32_t compressionInputBytes;
+    uint32_t compressionOutputBytes;
+    uint32_t payloadAuthFailedNum;
+    uint32_t neighborsWithdrawnNum;
+    uint32_t routeFailoversNum;
+    uint32_t helloReslotsNum;
+    uint32_t solicitationsNum;
+    uint32_t solicitationRepliesNum;
+    uint32_t routeRequestsNum;
+    uint32_t routeRepliesNum;
+    uint32_t routeDiscoveryFailuresNum;
+    uint32_t tdmaSlotSendsNum;
+    uint32_t tdmaSlotChangesNum;
+    uint32_t congestionHellosNum;
+    uint32_t telemetryRelayDroppedNum;
+    uint32_t piggybackedAcksNum;
+    uint32_t coalescedAcksNum;
+    uint32_t otaChunksServedNum;
+    uint32_t otaRequestsNum;
+    uint32_t otaHashFailuresNum;
+    // Traced packets received by the node and the sums of the records of their hops, with --hop-trace
+    uint32_t hopTracesNum;
+    uint32_t hopTracesTruncatedNum;
+    uint32_t hopRecordsNum;
+    uint32_t hopQueueWaitMs;
+    uint32_t hopDutyCycleWaitMs;
+    uint32_t hopBackoffMs;
+    uint32_t hopTimeOnAirMs;
+    uint32_t routingTableSize;
+    uint32_t sendQueueSize;
+    // Bytes accounted by the subsystems of the library but the simulator, now and the sum of their peaks
+    uint32_t memoryBytes;
+    uint32_t memoryPeakBytes;
+};
+
+/**
+ * @brief Received application payload, called from the receive task of the node
+ *
+ */
+typedef void (*LmSimReceive)(void* context, uint16_t src, const uint8_t* payload, uint32_t size, uint8_t hops);
+
+struct LmSimNodeApi {
+    /**
+     * @brief Begin and start the LoraMesher of the node, from a task of the node.
+     * The payloads of send and sendToGateway are dropped after maxAge ms in the send queue if it is not 0, and replaced
+     * by the next one of the node with latestOnly. The node has a spool partition of spoolSize bytes if it is not 0,
+     * it sends in TDMA frames of tdmaSlots slots with timeSync if it is not 0 and it advertises its congestion with backpressure.
+     * It sends its telemetry every telemetryInterval seconds if it is not 0, and delays its ACKs delayedAck ms if it is not 0.
+     * It has a partition for the firmware updates of otaSize bytes if it is not 0, running the firmware otaVersion, and it
+     * solicits its neighbors when its routing table is empty with solicit. With reactive the routes other than the neighbors
+     * and the gateways are discovered on demand. hopTraceSampling per mille of its data packets carry the per hop trace, and
+     * it receives in sniff mode for frames with a preamble of sniffPreambleLength symbols if it is not 0. With adaptiveLinkPower
+     * it sends its unicast packets to a neighbour with the lowest power the neighbour needs. The data packets it receives
+     * are processed by processWorkers workers if it is not 0
+     *
+     */
+    void (*begin)(bool gateway, bool singleTask, bool hopAck, bool compress, bool encrypt, bool triggeredWithdrawal, bool multipath, uint8_t clusterPrefixLength, uint8_t helloSlots, uint16_t airtimeLimit, uint32_t maxAge, bool latestOnly, uint32_t spoolSize, bool timeSync, uint8_t tdmaSlots, bool backpressure, uint16_t telemetryInterval, uint16_t delayedAck, uint32_t otaSize, uint16_t otaVersion, bool solicit, bool reactive, uint16_t hopTraceSampling, uint16_t sniffPreambleLength, bool adaptiveLinkPower, uint8_t processWorkers, LmSimReceive receive, void* context);
+
+    uint16_t (*getAddress)();
+
+    /**
+     * @brief Address of the closest gateway in the routing table, 0 if none
+     *
+     */
+    uint16_t (*getGateway)();
+
+    /**
+     * @brief Send a payload, the reliable ones with a parity packet every fecGroup packets if it is not 0
+     *
+     * @return true If it has been added to the send queue
+     */
+    bool (*send)(uint16_t dst, const uint8_t* payload, uint32_t size, bool reliable, uint8_t fecGroup);
+
+    /**
+     * @brief Send a payload in fragments without ACKs
+     *
+     * @return true If all the fragments have been added to the send queue
+     */
+    bool (*sendDatagram)(uint16_t dst, const uint8_t* payload, uint32_t size);
+
+    /**
+     * @brief Send a payload to the gateway role address, every hop chooses its best gateway
+     *
+     * @return true If it has been added to the send queue
+     */
+    bool (*sendToGateway)(const uint8_t* payload, uint32_t size);
+
+    /**
+     * @brief Write a payload to the stream of the node, opened again when the destination changes or the stream fails
+     *
+     * @return true If it has been written
+     */
+    bool (*writeStream)(uint16_t dst, const uint8_t* payload, uint32_t size);
+
+    void (*getStats)(LmSimNodeStats* stats);
+
+    /**
+     * @brief Time of the network now, from a task or an interrupt of the node, it reads the local clock of the node
+     *
+     * @return true If the node is synchronized
+     */
+    bool (*getSyncedTime)(int64_t* time);
+
+    /**
+     * @brief Interval in ms until the next payload to a destination, the nominal one paced by the state of the mesh
+     *
+     */
+    uint32_t (*getSendInterval)(uint16_t dst, uint32_t interval);
+
+    /**
+     * @brief Nodes in the telemetry table of a gateway and the ms since their last record
+     *
+     * @return uint32_t Number of nodes
+     */
+    uint32_t (*getTelemetry)(uint16_t* addresses, uint32_t* ages, uint32_t max);
+
+    /**
+     * @brief Write a firmware image to the partition of the updates, as the USB flasher, and offer it to the network
+     *
+     * @return true If it is offered
+     */
+    bool (*startOta)(const uint8_t* image, uint32_t size);
+
+    /**
+     * @brief State of the firmware update, a LM_OtaState, and the chunks received of the image
+     *
+     */
+    uint8_t (*getOtaState)(uint32_t* received, uint32_t* chunks);
+
+    /**
+     * @brief Relays in the traced packets received by the node, with their hops and the sum of their times in ms
+     *
+     * @return uint32_t Number of relays
+     */
+    uint32_t (*getHopTotals)(uint16_t* addresses, uint32_t* hops, uint32_t* totalMs, uint32_t max);
+};
+
+// Name of the entry point of the node library
+#define LM_SIM_NODE_API_SYMBOL "lm_sim_node_api"
+
+extern "C" const LmSimNodeApi* lm_sim_node_api();
+
+#endif // SIM_NODE_AGENT_H
@@ -0,0 +1,27 @@
+/**
+ * @file RadioLib.h
+ * @brief Status codes of RadioLib used by LoRaMesher, the host build uses the virtual radio instead of RadioLib
+ */
+
+#ifndef SIM_RADIOLIB_H
+#define SIM_RADIOLIB_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define RADIOLIB_ERR_NONE 0
+#define RADIOLIB_ERR_UNKNOWN -1
+#define RADIOLIB_ERR_PACKET_TOO_LONG -4
+#define RADIOLIB_ERR_TX_TIMEOUT -5
+#define RADIOLIB_ERR_RX_TIMEOUT -6
+#define RADIOLIB_ERR_CRC_MISMATCH -7
+#define RADIOLIB_ERR_LORA_HEADER_DAMAGED -24
+#define RADIOLIB_PREAMBLE_DETECTED -14
+#define RADIOLIB_ERR_SPI_WRITE_FAILED -16
+#define RADIOLIB_CHANNEL_FREE -701
+#define RADIOLIB_LORA_DETECTED -702
+#define RADIOLIB_NC 0xFFFFFFFF
+
+class RadioLibHal;
+
+#endif // SIM_RADIOLIB_H
@@ -0,0 +1,27 @@
+/**
+ * @file esp_cpu.h
+ * @brief CPU cycle counter of the host build, the time stamp counter on x86 and nanoseconds elsewhere
+ */
+
+#ifndef SIM_ESP_CPU_H
+#define SIM_ESP_CPU_H
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (esp_cpu_cycle_count_t) __rdtsc();
+#else
+    return (esp_cpu_cycle_count_t) std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+#endif // SIM_ESP_CPU_H
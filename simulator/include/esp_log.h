@@ -0,0 +1,31 @@
+/**
+ * @file esp_log.h
+ * @brief Logs of the simulator, prefixed with the virtual time and the node
+ */
+
+#ifndef SIM_ESP_LOG_H
+#define SIM_ESP_LOG_H
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern int simLogLevel;
+
+void simLog(esp_log_level_t level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+#define SIM_LOG(level, tag, format, ...) \
+    do { if (simLogLevel >= level) simLog(level, tag, format, ##__VA_ARGS__); } while (0)
+
+#define ESP_LOGE(tag, format, ...) SIM_LOG(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) SIM_LOG(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) SIM_LOG(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) SIM_LOG(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) SIM_LOG(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif // SIM_ESP_LOG_H
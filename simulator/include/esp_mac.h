@@ -0,0 +1,4 @@
+#ifndef SIM_ESP_MAC_H
+#define SIM_ESP_MAC_H
+
+#endif // SIM_ESP_MAC_H
@@ -0,0 +1,13 @@
+/**
+ * @file esp_random.h
+ * @brief Random numbers of the simulated nodes, repeatable between runs
+ */
+
+#ifndef SIM_ESP_RANDOM_H
+#define SIM_ESP_RANDOM_H
+
+#include <cstdint>
+
+uint32_t esp_random();
+
+#endif // SIM_ESP_RANDOM_H
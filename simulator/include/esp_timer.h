@@ -0,0 +1,16 @@
+/**
+ * @file esp_timer.h
+ * @brief Virtual clock of the simulator, in microseconds since the start of the simulation, the local clock of the node
+ * of the running task or interrupt, see sim::setClock
+ */
+
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <cstdint>
+
+#include "esp_attr.h"
+
+int64_t esp_timer_get_time();
+
+#endif // SIM_ESP_TIMER_H
@@ -0,0 +1,13 @@
+/**
+ * @file efuse_hal.h
+ * @brief MAC of the simulated node, the last two bytes are the address given by the simulator
+ */
+
+#ifndef SIM_EFUSE_HAL_H
+#define SIM_EFUSE_HAL_H
+
+#include <cstdint>
+
+void efuse_hal_get_mac(uint8_t* mac);
+
+#endif // SIM_EFUSE_HAL_H
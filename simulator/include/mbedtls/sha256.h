@@ -0,0 +1,30 @@
+/**
+ * @file sha256.h
+ * @brief SHA-256 of mbedtls in software, the ESP32 runs it on its hardware peripheral
+ */
+
+#ifndef SIM_MBEDTLS_SHA256_H
+#define SIM_MBEDTLS_SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t buffer[64];
+    size_t buffered;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+
+// SHA-224 is not supported, is224 must be 0
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen);
+
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char* output);
+
+#endif // SIM_MBEDTLS_SHA256_H
@@ -0,0 +1,333 @@
+/**
+ * @file NodeAgent.cpp
+ * @brief Entry point of the node library, the LoraMesher of one node behind the LmSimNodeApi
+ */
+
+#include "NodeAgent.h"
+#include "Partition.h"
+
+#include "LoraMesher.h"
+
+#include <algorithm>
+
+namespace {
+
+LmSimReceive receiveCallback = nullptr;
+void* receiveContext = nullptr;
+TaskHandle_t receiveTaskHandle = nullptr;
+uint8_t stream = 0;
+uint16_t streamDestination = 0;
+LM_SendOptions sendOptions;
+
+// Label of the spool partition with --spool
+const char SPOOL_PARTITION[] = "lm_spool";
+
+// Label of the partition of the firmware updates with --ota
+const char OTA_PARTITION[] = "lm_ota";
+
+// Relays in the traced packets received by the node, with --hop-trace
+struct HopTotal {
+    uint16_t address;
+    uint32_t hops;
+    uint32_t totalMs;
+};
+const size_t HOP_TOTALS = 64;
+HopTotal hopTotals[HOP_TOTALS];
+size_t hopTotalsLength = 0;
+uint32_t hopTracesRead = 0;
+LmSimNodeStats hopTraceStats = {};
+
+// Key of every node with --encrypt
+const uint8_t NETWORK_KEY[CryptoService::KEY_LENGTH] = {
+    0x4C, 0x6F, 0x52, 0x61, 0x4D, 0x65, 0x73, 0x68, 0x65, 0x72, 0x53, 0x69, 0x6D, 0x4B, 0x65, 0x79};
+
+/**
+ * @brief Add the traces received since the last call to the totals, from the receive task. The oldest ones are lost if
+ * more than LM_HOP_TRACES arrived in the meantime
+ *
+ */
+void readHopTraces(LoraMesher& radio) {
+    uint32_t received = radio.getHopTracesNum();
+    if (received == hopTracesRead)
+        return;
+
+    LM_HopTrace traces[LM_HOP_TRACES];
+    size_t length = radio.getHopTraces(traces, std::min<uint32_t>(received - hopTracesRead, LM_HOP_TRACES));
+    hopTracesRead = received;
+
+    for (size_t i = 0; i < length; i++) {
+        hopTraceStats.hopTracesNum++;
+        if (traces[i].truncated)
+            hopTraceStats.hopTracesTruncatedNum++;
+
+        for (uint8_t hop = 0; hop < traces[i].hops; hop++) {
+            const LM_HopRecord& record = traces[i].records[hop];
+            hopTraceStats.hopRecordsNum++;
+            hopTraceStats.hopQueueWaitMs += record.queueWait;
+            hopTraceStats.hopDutyCycleWaitMs += record.dutyCycleWait;
+            hopTraceStats.hopBackoffMs += record.backoff;
+            hopTraceStats.hopTimeOnAirMs += record.timeOnAir;
+
+            HopTotal* total = std::find_if(hopTotals, hopTotals + hopTotalsLength,
+                [&](const HopTotal& t) { return t.address == record.address; });
+            if (total == hopTotals + hopTotalsLength) {
+                if (hopTotalsLength == HOP_TOTALS)
+                    continue;
+                *total = {record.address, 0, 0};
+                hopTotalsLength++;
+            }
+
+            total->hops++;
+            total->totalMs += record.queueWait + record.dutyCycleWait + record.backoff + record.timeOnAir;
+        }
+    }
+}
+
+void receiveRoutine(void*) {
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (radio.getReceivedQueueSize() > 0) {
+            AppPacket<uint8_t>* packet = radio.getNextAppPacket<uint8_t>();
+            if (packet == nullptr)
+                break;
+
+            if (receiveCallback != nullptr)
+                receiveCallback(receiveContext, packet->src, packet->payload, packet->payloadSize, packet->hopCount);
+
+            radio.deletePacket(packet);
+        }
+
+        readHopTraces(radio);
+    }
+}
+
+void begin(bool gateway, bool singleTask, bool hopAck, bool compress, bool encrypt, bool triggeredWithdrawal, bool multipath, uint8_t clusterPrefixLength, uint8_t helloSlots, uint16_t airtimeLimit, uint32_t maxAge, bool latestOnly, uint32_t spoolSize, bool timeSync, uint8_t tdmaSlots, bool backpressure, uint16_t telemetryInterval, uint16_t delayedAck, uint32_t otaSize, uint16_t otaVersion, bool solicit, bool reactive, uint16_t hopTraceSampling, uint16_t sniffPreambleLength, bool adaptiveLinkPower, uint8_t processWorkers, LmSimReceive receive, void* context) {
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    receiveCallback = receive;
+    receiveContext = context;
+
+    // Every node sends one reading, the only key
+    sendOptions.maxAge = maxAge;
+    sendOptions.replaceKey = latestOnly ? 1 : 0;
+
+    LoraMesher::LoraMesherConfig config;
+    config.singleTask = singleTask;
+    config.hopAck = hopAck;
+    config.compressPayloads = compress;
+    config.payloadKey = encrypt ? NETWORK_KEY : nullptr;
+    config.triggeredWithdrawal = triggeredWithdrawal;
+    config.multipath = multipath;
+    config.clusterPrefixLength = clusterPrefixLength;
+    config.helloSlots = helloSlots;
+    config.airtimeLimit = airtimeLimit;
+    config.timeSync = timeSync;
+    config.tdmaSlots = tdmaSlots;
+    config.backpressure = backpressure;
+    config.telemetryInterval = telemetryInterval;
+    config.delayedAck = delayedAck;
+    config.neighborSolicitation = solicit;
+    config.reactiveRoutes = reactive;
+    config.hopTraceSampling = hopTraceSampling;
+    config.sniffPreambleLength = sniffPreambleLength;
+    config.adaptiveLinkPower = adaptiveLinkPower;
+    config.processWorkers = processWorkers;
+    if (spoolSize != 0) {
+        simCreatePartition(SPOOL_PARTITION, spoolSize);
+        config.spoolPartition = SPOOL_PARTITION;
+    }
+    if (otaSize != 0) {
+        simCreatePartition(OTA_PARTITION, otaSize, ESP_PARTITION_TYPE_APP);
+        config.otaPartition = OTA_PARTITION;
+        config.otaVersion = otaVersion;
+        // The messages of the updates go on their own port
+        config.applicationPorts = true;
+    }
+    radio.begin(config);
+
+    if (xTaskCreate(receiveRoutine, "Sim receive", 4096, nullptr, 2, &receiveTaskHandle) != pdPASS)
+        ESP_LOGE(LM_TAG, "Simulator receive task not created");
+    radio.setReceiveAppDataTaskHandle(receiveTaskHandle);
+
+    radio.start();
+
+    if (gateway)
+        radio.addGatewayRole();
+}
+
+uint16_t getAddress() {
+    return LoraMesher::getInstance().getLocalAddress();
+}
+
+uint16_t getGateway() {
+    RouteNode* gateway = LoraMesher::getClosestGateway();
+    return gateway != nullptr ? gateway->networkNode.address : 0;
+}
+
+bool send(uint16_t dst, const uint8_t* payload, uint32_t size, bool reliable, uint8_t fecGroup) {
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    if (reliable)
+        return isEnqueued(radio.sendReliablePacket(dst, const_cast<uint8_t*>(payload), size, fecGroup));
+
+    return isEnqueued(radio.sendPacket(dst, payload, size, sendOptions));
+}
+
+bool sendDatagram(uint16_t dst, const uint8_t* payload, uint32_t size) {
+    return isEnqueued(LoraMesher::getInstance().sendDatagram(dst, payload, size));
+}
+
+bool sendToGateway(const uint8_t* payload, uint32_t size) {
+    return isEnqueued(LoraMesher::getInstance().sendToRole(ROLE_GATEWAY, payload, size, sendOptions));
+}
+
+bool writeStream(uint16_t dst, const uint8_t* payload, uint32_t size) {
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    // A failed stream frees its id, it is not closed again
+    if (stream != 0 && !radio.isStreamOpen(stream))
+        stream = 0;
+
+    if (stream != 0 && streamDestination != dst) {
+        radio.closeStream(stream);
+        stream = 0;
+    }
+
+    if (stream == 0) {
+        stream = radio.openStream(dst);
+        streamDestination = dst;
+        if (stream == 0)
+            return false;
+    }
+
+    return isEnqueued(radio.writeStream(stream, payload, size));
+}
+
+void getStats(LmSimNodeStats* out) {
+    LoraMesher& radio = LoraMesher::getInstance();
+
+    LM_Stats stats;
+    radio.getStats(stats);
+
+    out->sentPacketsNum = stats.sendPacketsNum;
+    out->receivedDataPacketsNum = stats.receivedDataPacketsNum;
+    out->forwardedPacketsNum = stats.forwardedPacketsNum;
+    out->dataPacketForMeNum = stats.dataPacketForMeNum;
+    out->sentHelloPacketsNum = stats.sentHelloPacketsNum;
+    out->receivedHelloPacketsNum = stats.receivedHelloPacketsNum;
+    out->destinyUnreachableNum = stats.sendPacketDestinyUnreachableNum;
+    out->sendQueueDroppedNum = stats.sendQueueDroppedNum;
+    out->sendQueueExpiredNum = stats.sendQueueExpiredNum;
+    out->sendQueueReplacedNum = stats.sendQueueReplacedNum;
+    out->spoolStoredNum = stats.spoolStoredNum;
+    out->spoolDrainedNum = stats.spoolDrainedNum;
+    out->spoolDroppedNum = stats.spoolDroppedNum;
+    out->spoolSize = stats.spoolSize;
+    out->receivedQueueDroppedNum = stats.receivedQueueDroppedNum;
+    out->channelBusyNum = stats.channelBusyNum;
+    out->rxCrcErrorsNum = stats.rxCrcErrorsNum;
+    out->preambleWithoutPacketNum = stats.preambleWithoutPacketNum;
+    out->rxDeafTime = stats.rxDeafTime;
+    out->busyTxTime = stats.busyTxTime;
+    out->busyRxTime = stats.busyRxTime;
+    out->busyCadTime = stats.busyCadTime;
+    out->channelBusyPerMille = stats.channelBusyPerMille;
+    out->hopRetransmissionsNum = stats.hopRetransmissionsNum;
+    out->hopAckLostNum = stats.hopAckLostNum;
+    out->datagramsIncompleteNum = stats.datagramsIncompleteNum;
+    out->fecRebuiltNum = stats.fecRebuiltNum;
+    out->compressionInputBytes = stats.compressionInputBytes;
+    out->compressionOutputBytes = stats.compressionOutputBytes;
+    out->payloadAuthFailedNum = stats.payloadAuthFailedNum;
+    out->neighborsWithdrawnNum = stats.neighborsWithdrawnNum;
+    out->routeFailoversNum = stats.routeFailoversNum;
+    out->helloReslotsNum = stats.helloReslotsNum;
+    out->solicitationsNum = stats.solicitationsNum;
+    out->solicitationRepliesNum = stats.solicitationRepliesNum;
+    out->routeRequestsNum = stats.routeRequestsNum;
+    out->routeRepliesNum = stats.routeRepliesNum;
+    out->routeDiscoveryFailuresNum = stats.routeDiscoveryFailuresNum;
+    out->tdmaSlotSendsNum = stats.tdmaSlotSendsNum;
+    out->tdmaSlotChangesNum = stats.tdmaSlotChangesNum;
+    out->congestionHellosNum = stats.congestionHellosNum;
+    out->telemetryRelayDroppedNum = stats.telemetryRelayDroppedNum;
+    out->piggybackedAcksNum = stats.piggybackedAcksNum;
+    out->coalescedAcksNum = stats.coalescedAcksNum;
+    out->otaChunksServedNum = stats.otaChunksServedNum;
+    out->otaRequestsNum = stats.otaRequestsNum;
+    out->otaHashFailuresNum = stats.otaHashFailuresNum;
+    out->hopTracesNum = hopTraceStats.hopTracesNum;
+    out->hopTracesTruncatedNum = hopTraceStats.hopTracesTruncatedNum;
+    out->hopRecordsNum = hopTraceStats.hopRecordsNum;
+    out->hopQueueWaitMs = hopTraceStats.hopQueueWaitMs;
+    out->hopDutyCycleWaitMs = hopTraceStats.hopDutyCycleWaitMs;
+    out->hopBackoffMs = hopTraceStats.hopBackoffMs;
+    out->hopTimeOnAirMs = hopTraceStats.hopTimeOnAirMs;
+    out->routingTableSize = radio.routingTableSize();
+    out->sendQueueSize = stats.sendQueueSize;
+
+    LM_MemoryStats memory = radio.getMemoryStats();
+    out->memoryBytes = 0;
+    out->memoryPeakBytes = 0;
+    for (uint8_t tag = 0; tag < MEMORY_TAGS; tag++) {
+        if (tag == MEMORY_SIMULATOR)
+            continue;
+        out->memoryBytes += memory.usage[tag].bytes;
+        out->memoryPeakBytes += memory.usage[tag].peakBytes;
+    }
+}
+
+bool getSyncedTime(int64_t* time) {
+    return LoraMesher::getInstance().getSyncedTime(*time);
+}
+
+uint32_t getSendInterval(uint16_t dst, uint32_t interval) {
+    return LoraMesher::getInstance().getSendInterval(dst, interval);
+}
+
+uint32_t getTelemetry(uint16_t* addresses, uint32_t* ages, uint32_t max) {
+    LM_Telemetry telemetry[LM_TELEMETRY_NODES];
+    size_t length = LoraMesher::getInstance().getTelemetry(telemetry, max < LM_TELEMETRY_NODES ? max : LM_TELEMETRY_NODES);
+
+    uint32_t now = millis();
+    for (size_t i = 0; i < length; i++) {
+        addresses[i] = telemetry[i].record.address;
+        ages[i] = now - telemetry[i].receivedAt;
+    }
+
+    return length;
+}
+
+bool startOta(const uint8_t* image, uint32_t size) {
+    if (!simWritePartition(OTA_PARTITION, 0, image, size))
+        return false;
+
+    return LoraMesher::getInstance().startOta(size);
+}
+
+uint8_t getOtaState(uint32_t* received, uint32_t* chunks) {
+    return LoraMesher::getInstance().getOtaState(received, chunks);
+}
+
+uint32_t getHopTotals(uint16_t* addresses, uint32_t* hops, uint32_t* totalMs, uint32_t max) {
+    uint32_t length = std::min<uint32_t>(hopTotalsLength, max);
+    for (uint32_t i = 0; i < length; i++) {
+        addresses[i] = hopTotals[i].address;
+        hops[i] = hopTotals[i].hops;
+        totalMs[i] = hopTotals[i].totalMs;
+    }
+
+    return length;
+}
+
+const LmSimNodeApi nodeApi = {begin, getAddress, getGateway, send, sendDatagram, sendToGateway, writeStream, getStats, getSyncedTime,
+    getSendInterval, getTelemetry, startOta, getOtaState, getHopTotals};
+
+} // namespace
+
+extern "C" const LmSimNodeApi* lm_sim_node_api() {
+    return &nodeApi;
+}
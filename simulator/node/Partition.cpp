@@ -0,0 +1,112 @@
+/**
+ * @file Partition.cpp
+ * @brief ESP-IDF partition functions of the node library, on the memory of the node
+ */
+
+#include "Partition.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "esp_partition.h"
+
+namespace {
+
+constexpr uint32_t ERASE_SIZE = 4096;
+
+// The spool and the firmware updates
+constexpr size_t MAX_PARTITIONS = 2;
+
+struct Flash {
+    esp_partition_t partition;
+    std::string label;
+    std::vector<uint8_t> bytes;
+};
+
+Flash partitions[MAX_PARTITIONS];
+size_t partitionsLength = 0;
+
+Flash* find(const esp_partition_t* p) {
+    for (size_t i = 0; i < partitionsLength; i++) {
+        if (&partitions[i].partition == p)
+            return &partitions[i];
+    }
+    return nullptr;
+}
+
+Flash* findInside(const esp_partition_t* p, size_t offset, size_t size) {
+    Flash* flash = find(p);
+    if (flash == nullptr || offset > flash->bytes.size() || size > flash->bytes.size() - offset)
+        return nullptr;
+    return flash;
+}
+
+} // namespace
+
+void simCreatePartition(const char* label, size_t size, esp_partition_type_t type) {
+    if (size == 0 || partitionsLength == MAX_PARTITIONS)
+        return;
+
+    Flash& flash = partitions[partitionsLength++];
+    flash.bytes.assign(size, 0xFF);
+
+    flash.partition = esp_partition_t{};
+    flash.partition.type = type;
+    flash.partition.subtype = ESP_PARTITION_SUBTYPE_ANY;
+    flash.partition.size = (uint32_t) size;
+    flash.partition.erase_size = ERASE_SIZE;
+    strncpy(flash.partition.label, label, sizeof(flash.partition.label) - 1);
+    flash.label = flash.partition.label;
+}
+
+bool simWritePartition(const char* label, size_t offset, const void* data, size_t size) {
+    for (size_t i = 0; i < partitionsLength; i++) {
+        std::vector<uint8_t>& bytes = partitions[i].bytes;
+        if (partitions[i].label == label && offset <= bytes.size() && size <= bytes.size() - offset) {
+            memcpy(bytes.data() + offset, data, size);
+            return true;
+        }
+    }
+    return false;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t, const char* label) {
+    for (size_t i = 0; i < partitionsLength; i++) {
+        const esp_partition_t& partition = partitions[i].partition;
+        if (partition.type == type && (label == nullptr || partitions[i].label == label))
+            return &partition;
+    }
+
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* p, size_t src_offset, void* dst, size_t size) {
+    Flash* flash = findInside(p, src_offset, size);
+    if (flash == nullptr)
+        return ESP_ERR_INVALID_SIZE;
+
+    memcpy(dst, flash->bytes.data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* p, size_t dst_offset, const void* src, size_t size) {
+    Flash* flash = findInside(p, dst_offset, size);
+    if (flash == nullptr)
+        return ESP_ERR_INVALID_SIZE;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; i++)
+        flash->bytes[dst_offset + i] &= bytes[i];
+
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* p, size_t offset, size_t size) {
+    Flash* flash = findInside(p, offset, size);
+    if (flash == nullptr || offset % ERASE_SIZE != 0 || size % ERASE_SIZE != 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(flash->bytes.data() + offset, 0xFF, size);
+    return ESP_OK;
+}
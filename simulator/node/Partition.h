@@ -0,0 +1,29 @@
+/**
+ * @file Partition.h
+ * @brief Partitions of the node library in the simulated flash
+ */
+
+#ifndef SIM_PARTITION_H
+#define SIM_PARTITION_H
+
+#include <cstddef>
+
+#include "esp_partition.h"
+
+/**
+ * @brief Create a partition of the node, erased. 0 does not create it
+ *
+ * @param label Label of the partition
+ * @param size Size in bytes, a multiple of the erase size
+ * @param type Type of the partition, ESP_PARTITION_TYPE_APP for the firmware updates
+ */
+void simCreatePartition(const char* label, size_t size, esp_partition_type_t type = ESP_PARTITION_TYPE_DATA);
+
+/**
+ * @brief Write to a partition of the node without the flash rules, the firmware written by the USB flasher
+ *
+ * @return true If the partition exists and the data fits
+ */
+bool simWritePartition(const char* label, size_t offset, const void* data, size_t size);
+
+#endif // SIM_PARTITION_H
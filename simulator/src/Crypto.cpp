@@ -0,0 +1,215 @@
+/**
+ * @file Crypto.cpp
+ * @brief AES-128-CCM of mbedtls in software, for the encrypted payloads of the host build
+ */
+
+#include <cstring>
+
+#include "mbedtls/ccm.h"
+
+namespace {
+
+constexpr size_t BLOCK = 16;
+
+const uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+uint8_t xtime(uint8_t x) {
+    return (uint8_t) ((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+void expandKey(const uint8_t* key, uint8_t* roundKeys) {
+    memcpy(roundKeys, key, BLOCK);
+
+    uint8_t rcon = 1;
+    for (size_t i = BLOCK; i < 176; i += 4) {
+        uint8_t word[4];
+        memcpy(word, roundKeys + i - 4, 4);
+
+        if (i % BLOCK == 0) {
+            uint8_t first = word[0];
+            word[0] = SBOX[word[1]] ^ rcon;
+            word[1] = SBOX[word[2]];
+            word[2] = SBOX[word[3]];
+            word[3] = SBOX[first];
+            rcon = xtime(rcon);
+        }
+
+        for (size_t j = 0; j < 4; j++)
+            roundKeys[i + j] = roundKeys[i + j - BLOCK] ^ word[j];
+    }
+}
+
+void encryptBlock(const uint8_t* roundKeys, const uint8_t* in, uint8_t* out) {
+    uint8_t state[BLOCK];
+    for (size_t i = 0; i < BLOCK; i++)
+        state[i] = in[i] ^ roundKeys[i];
+
+    for (size_t round = 1; round <= 10; round++) {
+        // SubBytes and ShiftRows, the state is column major
+        uint8_t shifted[BLOCK];
+        for (size_t column = 0; column < 4; column++)
+            for (size_t row = 0; row < 4; row++)
+                shifted[column * 4 + row] = SBOX[state[((column + row) % 4) * 4 + row]];
+
+        // MixColumns, except in the last round
+        if (round < 10) {
+            for (size_t column = 0; column < 4; column++) {
+                uint8_t* c = shifted + column * 4;
+                uint8_t all = c[0] ^ c[1] ^ c[2] ^ c[3];
+                uint8_t first = c[0];
+                c[0] ^= all ^ xtime(c[0] ^ c[1]);
+                c[1] ^= all ^ xtime(c[1] ^ c[2]);
+                c[2] ^= all ^ xtime(c[2] ^ c[3]);
+                c[3] ^= all ^ xtime(c[3] ^ first);
+            }
+        }
+
+        for (size_t i = 0; i < BLOCK; i++)
+            state[i] = shifted[i] ^ roundKeys[round * BLOCK + i];
+    }
+
+    memcpy(out, state, BLOCK);
+}
+
+bool isValid(size_t length, size_t ivLength, size_t tagLength) {
+    size_t lengthBytes = 15 - ivLength;
+    return ivLength >= 7 && ivLength <= 13 && tagLength >= 4 && tagLength <= 16 && tagLength % 2 == 0 &&
+        (lengthBytes >= sizeof(size_t) || (length >> (8 * lengthBytes)) == 0);
+}
+
+/**
+ * @brief Counter block i, the flags, the nonce and i in the remaining bytes
+ *
+ */
+void counterBlock(const uint8_t* iv, size_t ivLength, size_t i, uint8_t* block) {
+    memset(block, 0, BLOCK);
+    block[0] = (uint8_t) (14 - ivLength);
+    memcpy(block + 1, iv, ivLength);
+    for (size_t j = BLOCK - 1; i > 0 && j > ivLength; j--, i >>= 8)
+        block[j] = (uint8_t) i;
+}
+
+/**
+ * @brief CBC-MAC of the additional data and the plaintext, encrypted with the counter block 0
+ *
+ */
+void getTag(const uint8_t* roundKeys, const uint8_t* iv, size_t ivLength, const uint8_t* ad, size_t adLength,
+    const uint8_t* plaintext, size_t length, uint8_t* tag, size_t tagLength) {
+    uint8_t mac[BLOCK] = {0};
+    mac[0] = (uint8_t) ((adLength > 0 ? 0x40 : 0) | (((tagLength - 2) / 2) << 3) | (14 - ivLength));
+    memcpy(mac + 1, iv, ivLength);
+    size_t value = length;
+    for (size_t j = BLOCK - 1; j > ivLength; j--, value >>= 8)
+        mac[j] = (uint8_t) value;
+    encryptBlock(roundKeys, mac, mac);
+
+    // The additional data is prefixed with its length, up to 0xFEFF bytes
+    if (adLength > 0) {
+        size_t position = 2;
+        mac[0] ^= (uint8_t) (adLength >> 8);
+        mac[1] ^= (uint8_t) adLength;
+        for (size_t i = 0; i < adLength; i++) {
+            mac[position++] ^= ad[i];
+            if (position == BLOCK) {
+                encryptBlock(roundKeys, mac, mac);
+                position = 0;
+            }
+        }
+        if (position > 0)
+            encryptBlock(roundKeys, mac, mac);
+    }
+
+    for (size_t offset = 0; offset < length; offset += BLOCK) {
+        for (size_t i = 0; i < BLOCK && offset + i < length; i++)
+            mac[i] ^= plaintext[offset + i];
+        encryptBlock(roundKeys, mac, mac);
+    }
+
+    uint8_t block[BLOCK];
+    counterBlock(iv, ivLength, 0, block);
+    encryptBlock(roundKeys, block, block);
+    for (size_t i = 0; i < tagLength; i++)
+        tag[i] = mac[i] ^ block[i];
+}
+
+/**
+ * @brief CTR mode from the counter block 1, the output can be the input
+ *
+ */
+void crypt(const uint8_t* roundKeys, const uint8_t* iv, size_t ivLength, const uint8_t* in, uint8_t* out, size_t length) {
+    uint8_t block[BLOCK];
+    for (size_t offset = 0; offset < length; offset += BLOCK) {
+        counterBlock(iv, ivLength, offset / BLOCK + 1, block);
+        encryptBlock(roundKeys, block, block);
+        for (size_t i = 0; i < BLOCK && offset + i < length; i++)
+            out[offset + i] = in[offset + i] ^ block[i];
+    }
+}
+
+} // namespace
+
+void mbedtls_ccm_init(mbedtls_ccm_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_ccm_setkey(mbedtls_ccm_context* ctx, mbedtls_cipher_id_t cipher, const unsigned char* key, unsigned int keybits) {
+    if (cipher != MBEDTLS_CIPHER_ID_AES || keybits != 128)
+        return MBEDTLS_ERR_CCM_BAD_INPUT;
+
+    expandKey(key, ctx->roundKeys);
+    return 0;
+}
+
+void mbedtls_ccm_free(mbedtls_ccm_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_ccm_encrypt_and_tag(mbedtls_ccm_context* ctx, size_t length, const unsigned char* iv, size_t iv_len,
+    const unsigned char* ad, size_t ad_len, const unsigned char* input, unsigned char* output, unsigned char* tag, size_t tag_len) {
+    if (!isValid(length, iv_len, tag_len) || ad_len >= 0xFF00)
+        return MBEDTLS_ERR_CCM_BAD_INPUT;
+
+    getTag(ctx->roundKeys, iv, iv_len, ad, ad_len, input, length, tag, tag_len);
+    crypt(ctx->roundKeys, iv, iv_len, input, output, length);
+    return 0;
+}
+
+int mbedtls_ccm_auth_decrypt(mbedtls_ccm_context* ctx, size_t length, const unsigned char* iv, size_t iv_len,
+    const unsigned char* ad, size_t ad_len, const unsigned char* input, unsigned char* output, const unsigned char* tag,
+    size_t tag_len) {
+    if (!isValid(length, iv_len, tag_len) || ad_len >= 0xFF00)
+        return MBEDTLS_ERR_CCM_BAD_INPUT;
+
+    crypt(ctx->roundKeys, iv, iv_len, input, output, length);
+
+    uint8_t expected[BLOCK];
+    getTag(ctx->roundKeys, iv, iv_len, ad, ad_len, output, length, expected, tag_len);
+
+    uint8_t difference = 0;
+    for (size_t i = 0; i < tag_len; i++)
+        difference |= expected[i] ^ tag[i];
+
+    if (difference != 0) {
+        memset(output, 0, length);
+        return MBEDTLS_ERR_CCM_AUTH_FAILED;
+    }
+
+    return 0;
+}
@@ -0,0 +1,372 @@
+/**
+ * @file FreeRTOS.cpp
+ * @brief FreeRTOS API of the host build over the simulator Scheduler
+ */
+
+#include "freertos/FreeRTOS.h"
+
+#include "Scheduler.h"
+
+using sim::Scheduler;
+using sim::Semaphore;
+using sim::Task;
+
+namespace {
+
+uint64_t ticksToMicros(TickType_t ticks) {
+    if (ticks == portMAX_DELAY)
+        return sim::WAIT_FOREVER;
+
+    return (uint64_t) ticks * 1000000 / configTICK_RATE_HZ;
+}
+
+Task* taskOf(TaskHandle_t handle) {
+    return handle != nullptr ? static_cast<Task*>(handle) : Scheduler::current();
+}
+
+BaseType_t notify(Task* task, uint32_t value, eNotifyAction action, BaseType_t* woken) {
+    if (task == nullptr || task->state == sim::TASK_DELETED)
+        return pdFAIL;
+
+    sim::NotifyState previous = task->notifyState;
+    BaseType_t result = pdPASS;
+
+    switch (action) {
+        case eSetBits:
+            task->notifyValue |= value;
+            break;
+        case eIncrement:
+            task->notifyValue++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notifyValue = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (previous != sim::NOTIFY_RECEIVED)
+                task->notifyValue = value;
+            else
+                result = pdFAIL;
+            break;
+        case eNoAction:
+            break;
+    }
+
+    task->notifyState = sim::NOTIFY_RECEIVED;
+
+    if (previous == sim::NOTIFY_WAITING && task->state == sim::TASK_BLOCKED) {
+        Scheduler::wake(task);
+        if (woken != nullptr)
+            *woken = pdTRUE;
+    }
+
+    return result;
+}
+
+bool tryTake(Semaphore* semaphore, Task* self) {
+    switch (semaphore->type) {
+        case Semaphore::MUTEX:
+            if (semaphore->owner != nullptr)
+                return false;
+            semaphore->owner = self;
+            semaphore->recursion = 1;
+            return true;
+        case Semaphore::RECURSIVE_MUTEX:
+            if (semaphore->owner != nullptr && semaphore->owner != self)
+                return false;
+            semaphore->owner = self;
+            semaphore->recursion++;
+            return true;
+        default:
+            if (semaphore->count == 0)
+                return false;
+            semaphore->count--;
+            return true;
+    }
+}
+
+BaseType_t take(SemaphoreHandle_t handle, TickType_t ticksToWait) {
+    Semaphore* semaphore = static_cast<Semaphore*>(handle);
+    Task* self = Scheduler::current();
+
+    if (tryTake(semaphore, self))
+        return pdTRUE;
+
+    // The runner and the interrupts cannot block
+    if (ticksToWait == 0 || self == nullptr)
+        return pdFALSE;
+
+    semaphore->waiters.push_back(self);
+    self->waitingOn = semaphore;
+
+    // The giver takes it on behalf of the woken task, on timeout the scheduler removes it from the waiters
+    return Scheduler::block(ticksToMicros(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t give(SemaphoreHandle_t handle, BaseType_t* woken) {
+    Semaphore* semaphore = static_cast<Semaphore*>(handle);
+    bool isMutex = semaphore->type == Semaphore::MUTEX || semaphore->type == Semaphore::RECURSIVE_MUTEX;
+
+    if (isMutex) {
+        if (semaphore->owner != Scheduler::current())
+            return pdFAIL;
+
+        if (--semaphore->recursion > 0)
+            return pdPASS;
+
+        semaphore->owner = nullptr;
+    }
+
+    if (!semaphore->waiters.empty()) {
+        Task* next = semaphore->waiters.front();
+        semaphore->waiters.pop_front();
+
+        if (isMutex) {
+            semaphore->owner = next;
+            semaphore->recursion = 1;
+        }
+
+        Scheduler::wake(next);
+        if (woken != nullptr)
+            *woken = pdTRUE;
+        return pdPASS;
+    }
+
+    if (!isMutex) {
+        if (semaphore->count >= semaphore->maxCount)
+            return pdFAIL;
+        semaphore->count++;
+    }
+
+    return pdPASS;
+}
+
+SemaphoreHandle_t createSemaphore(Semaphore::Type type, UBaseType_t maxCount, UBaseType_t count) {
+    Semaphore* semaphore = new Semaphore();
+    semaphore->type = type;
+    semaphore->maxCount = maxCount;
+    semaphore->count = count;
+    return semaphore;
+}
+
+} // namespace
+
+void vPortEnterCritical(portMUX_TYPE*) {
+    Task* self = Scheduler::current();
+    if (self != nullptr)
+        self->criticalNesting++;
+}
+
+void vPortExitCritical(portMUX_TYPE*) {
+    Task* self = Scheduler::current();
+    if (self == nullptr || self->criticalNesting == 0)
+        return;
+
+    if (--self->criticalNesting == 0)
+        Scheduler::preemptIfNeeded();
+}
+
+void* pvPortMalloc(size_t size) {
+    return malloc(size);
+}
+
+void vPortFree(void* p) {
+    free(p);
+}
+
+BaseType_t xPortInIsrContext() {
+    return Scheduler::inInterrupt() ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xPortGetCoreID() {
+    return 0;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackSize, void* parameter,
+    UBaseType_t priority, TaskHandle_t* handle) {
+
+    return xTaskCreatePinnedToCore(function, name, stackSize, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackSize, void* parameter,
+    UBaseType_t priority, TaskHandle_t* handle, BaseType_t) {
+
+    Task* task = Scheduler::createTask(function, name, stackSize, parameter, priority, Scheduler::currentNode());
+    if (handle != nullptr)
+        *handle = task;
+
+    if (task == nullptr)
+        return pdFAIL;
+
+    Scheduler::preemptIfNeeded();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+    Task* task = taskOf(handle);
+    if (task != nullptr)
+        Scheduler::remove(task);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == 0)
+        Scheduler::yield();
+    else
+        Scheduler::block(ticksToMicros(ticks));
+}
+
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t increment) {
+    *previousWakeTime += increment;
+
+    uint64_t wakeAt = ticksToMicros(*previousWakeTime);
+    if (wakeAt > Scheduler::now())
+        Scheduler::block(wakeAt - Scheduler::now());
+}
+
+void vTaskSuspend(TaskHandle_t handle) {
+    Task* task = taskOf(handle);
+    if (task != nullptr)
+        Scheduler::suspend(task);
+}
+
+void vTaskResume(TaskHandle_t handle) {
+    if (handle == nullptr)
+        return;
+
+    Scheduler::resume(static_cast<Task*>(handle));
+    Scheduler::preemptIfNeeded();
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t handle) {
+    Task* task = taskOf(handle);
+    return task != nullptr ? task->priority : 0;
+}
+
+void vTaskPrioritySet(TaskHandle_t handle, UBaseType_t priority) {
+    Task* task = taskOf(handle);
+    if (task == nullptr)
+        return;
+
+    Scheduler::setPriority(task, priority);
+    Scheduler::preemptIfNeeded();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle) {
+    // The host stacks are not measured, the whole FreeRTOS stack is reported as free
+    Task* task = taskOf(handle);
+    return task != nullptr ? task->stackSize : 0;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return Scheduler::current();
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t) (Scheduler::now() * configTICK_RATE_HZ / 1000000);
+}
+
+void vTaskYield() {
+    if (Scheduler::current() != nullptr)
+        Scheduler::yield();
+}
+
+BaseType_t xTaskNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action) {
+    BaseType_t result = notify(static_cast<Task*>(handle), value, action, nullptr);
+    Scheduler::preemptIfNeeded();
+    return result;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t handle, uint32_t value, eNotifyAction action, BaseType_t* higherPriorityTaskWoken) {
+    return notify(static_cast<Task*>(handle), value, action, higherPriorityTaskWoken);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+    return xTaskNotify(handle, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t* higherPriorityTaskWoken) {
+    notify(static_cast<Task*>(handle), 0, eIncrement, higherPriorityTaskWoken);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t bitsToClearOnEntry, uint32_t bitsToClearOnExit, uint32_t* value, TickType_t ticksToWait) {
+    Task* self = Scheduler::current();
+
+    if (self->notifyState != sim::NOTIFY_RECEIVED) {
+        self->notifyValue &= ~bitsToClearOnEntry;
+        self->notifyState = sim::NOTIFY_WAITING;
+
+        if (ticksToWait > 0)
+            Scheduler::block(ticksToMicros(ticksToWait));
+    }
+
+    if (value != nullptr)
+        *value = self->notifyValue;
+
+    BaseType_t result = pdFALSE;
+    if (self->notifyState == sim::NOTIFY_RECEIVED) {
+        self->notifyValue &= ~bitsToClearOnExit;
+        result = pdTRUE;
+    }
+
+    self->notifyState = sim::NOTIFY_NONE;
+    return result;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    Task* self = Scheduler::current();
+
+    if (self->notifyValue == 0) {
+        self->notifyState = sim::NOTIFY_WAITING;
+
+        if (ticksToWait > 0)
+            Scheduler::block(ticksToMicros(ticksToWait));
+    }
+
+    uint32_t value = self->notifyValue;
+    if (value != 0)
+        self->notifyValue = clearCountOnExit ? 0 : value - 1;
+
+    self->notifyState = sim::NOTIFY_NONE;
+    return value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return createSemaphore(Semaphore::MUTEX, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return createSemaphore(Semaphore::RECURSIVE_MUTEX, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return createSemaphore(Semaphore::BINARY, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+    return createSemaphore(Semaphore::COUNTING, maxCount, initialCount);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    return take(semaphore, ticksToWait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    BaseType_t result = give(semaphore, nullptr);
+    Scheduler::preemptIfNeeded();
+    return result;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    return take(semaphore, ticksToWait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    return xSemaphoreGive(semaphore);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken) {
+    return give(semaphore, higherPriorityTaskWoken);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete static_cast<Semaphore*>(semaphore);
+}
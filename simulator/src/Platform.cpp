@@ -0,0 +1,124 @@
+/**
+ * @file Platform.cpp
+ * @brief ESP-IDF functions of the host build: virtual time, heap, MAC address, random numbers and logs
+ */
+
+#include "Platform.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <vector>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "hal/efuse_hal.h"
+
+#include "Scheduler.h"
+
+namespace sim {
+
+namespace {
+
+std::vector<NodeInfo> nodes;
+
+} // namespace
+
+int addNode(uint16_t address, double x, double y) {
+    nodes.push_back(NodeInfo{address, x, y});
+    return (int) nodes.size() - 1;
+}
+
+const NodeInfo& getNode(int node) {
+    return nodes[node];
+}
+
+size_t getNodesNum() {
+    return nodes.size();
+}
+
+void failNode(int node) {
+    nodes[node].failed = true;
+}
+
+void recoverNode(int node) {
+    nodes[node].failed = false;
+}
+
+void setClock(int node, int64_t offset, double drift) {
+    nodes[node].clockOffset = offset;
+    nodes[node].clockDrift = drift;
+}
+
+int64_t getLocalTime(int node) {
+    const NodeInfo& info = nodes[node];
+    uint64_t now = Scheduler::now();
+    return info.clockOffset + (int64_t) now + (int64_t) (info.clockDrift * (double) now);
+}
+
+} // namespace sim
+
+int simLogLevel = ESP_LOG_WARN;
+
+void simLog(esp_log_level_t level, const char* tag, const char* format, ...) {
+    static const char levels[] = "NEWIDV";
+
+    int node = sim::Scheduler::currentNode();
+    uint64_t now = sim::Scheduler::now();
+
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if (node == sim::NO_NODE)
+        fprintf(stderr, "[%llu.%06llu] ---- %c %s: %s\n", (unsigned long long) (now / 1000000),
+            (unsigned long long) (now % 1000000), levels[level], tag, message);
+    else
+        fprintf(stderr, "[%llu.%06llu] %04X %c %s: %s\n", (unsigned long long) (now / 1000000),
+            (unsigned long long) (now % 1000000), sim::getNode(node).address, levels[level], tag, message);
+}
+
+int64_t esp_timer_get_time() {
+    int node = sim::Scheduler::currentNode();
+    return node != sim::NO_NODE ? sim::getLocalTime(node) : (int64_t) sim::Scheduler::now();
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? 0 : sim::NODE_FREE_HEAP;
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? 0 : sim::NODE_FREE_HEAP;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t) {
+    return malloc(size);
+}
+
+void heap_caps_free(void* p) {
+    free(p);
+}
+
+size_t heap_caps_get_allocated_size(void* p) {
+    return malloc_usable_size(p);
+}
+
+void efuse_hal_get_mac(uint8_t* mac) {
+    int node = sim::Scheduler::currentNode();
+    uint16_t address = node != sim::NO_NODE ? sim::getNode(node).address : 0;
+
+    // Locally administered unicast MAC, the address in the last two bytes like the boards
+    uint8_t value[6] = {0x02, 0x00, 0x00, 0x00, (uint8_t) (address >> 8), (uint8_t) address};
+    memcpy(mac, value, sizeof(value));
+}
+
+uint32_t esp_random() {
+    // The nodes run one at a time, so the sequence is the same in every run
+    return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
@@ -0,0 +1,69 @@
+/**
+ * @file Platform.h
+ * @brief Nodes of the simulation and the ESP-IDF functions of the host build that depend on them
+ */
+
+#ifndef SIM_PLATFORM_H
+#define SIM_PLATFORM_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sim {
+
+struct NodeInfo {
+    // LoRaMesher address, the last two bytes of the MAC of the node
+    uint16_t address;
+    // Position in meters
+    double x;
+    double y;
+    // Failed node, its radio is cut off from the channel
+    bool failed = false;
+    // Local clock of the node, offset in us at the start and drift of its crystal, see setClock
+    int64_t clockOffset = 0;
+    double clockDrift = 0;
+};
+
+/**
+ * @brief Add a node, the index is the node of its tasks and interrupts
+ *
+ * @return int Index of the node
+ */
+int addNode(uint16_t address, double x, double y);
+
+const NodeInfo& getNode(int node);
+
+size_t getNodesNum();
+
+/**
+ * @brief Cut the radio of a node off from the channel, like a node that has died
+ *
+ */
+void failNode(int node);
+
+/**
+ * @brief Connect the radio of a failed node to the channel again
+ *
+ */
+void recoverNode(int node);
+
+/**
+ * @brief Set the local clock of a node, esp_timer_get_time of its tasks and interrupts is offset + (1 + drift) * now
+ *
+ * @param offset Offset in us, not negative
+ * @param drift Drift, 20e-6 is a crystal 20 ppm fast
+ */
+void setClock(int node, int64_t offset, double drift);
+
+/**
+ * @brief Local clock of a node at the current virtual time, in us
+ *
+ */
+int64_t getLocalTime(int node);
+
+// Internal heap reported by heap_caps_get_free_size, the host heap is shared by all the nodes and it is not measured per node
+constexpr size_t NODE_FREE_HEAP = 300 * 1024;
+
+} // namespace sim
+
+#endif // SIM_PLATFORM_H
@@ -0,0 +1,363 @@
+/**
+ * @file Scheduler.cpp
+ * @brief Discrete event scheduler of the simulator
+ */
+
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <pthread.h>
+#include <queue>
+#include <vector>
+
+namespace sim {
+
+namespace {
+
+// Host stack of every task, the FreeRTOS stack sizes are too small for the host
+constexpr size_t TASK_THREAD_STACK_SIZE = 512 * 1024;
+
+struct Event {
+    uint64_t at;
+    uint64_t sequence;
+    int node;
+    // Timeout of a block of the task if not nullptr, the function otherwise
+    Task* task;
+    uint64_t generation;
+    std::function<void()> function;
+};
+
+struct EventOrder {
+    bool operator()(const Event& a, const Event& b) const {
+        return a.at != b.at ? a.at > b.at : a.sequence > b.sequence;
+    }
+};
+
+std::mutex handoff;
+std::condition_variable runnerWake;
+bool runnerTurn = false;
+
+// Task with the CPU, nullptr when the runner has it
+Task* running = nullptr;
+
+uint64_t virtualNow = 0;
+uint64_t endTime = 0;
+uint64_t nextSequence = 0;
+uint64_t switches = 0;
+uint32_t nextTaskId = 1;
+
+bool interrupt = false;
+int interruptNode = NO_NODE;
+
+std::priority_queue<Event, std::vector<Event>, EventOrder> events;
+std::deque<Task*> ready[configMAX_PRIORITIES];
+
+void pushEvent(uint64_t at, int node, Task* task, uint64_t generation, std::function<void()> function) {
+    events.push(Event{std::max(at, virtualNow), nextSequence++, node, task, generation, std::move(function)});
+}
+
+void eraseReady(Task* task) {
+    std::deque<Task*>& queue = ready[task->priority];
+    queue.erase(std::remove(queue.begin(), queue.end(), task), queue.end());
+}
+
+void detachWaits(Task* task) {
+    if (task->waitingOn == nullptr)
+        return;
+
+    std::deque<Task*>& waiters = task->waitingOn->waiters;
+    waiters.erase(std::remove(waiters.begin(), waiters.end(), task), waiters.end());
+    task->waitingOn = nullptr;
+}
+
+void makeReady(Task* task) {
+    task->state = TASK_READY;
+    ready[task->priority].push_back(task);
+
+    if (!interrupt && running != nullptr && task->node == running->node && task->priority > running->priority)
+        running->yieldPending = true;
+}
+
+void fire() {
+    Event event = std::move(const_cast<Event&>(events.top()));
+    events.pop();
+
+    if (event.task != nullptr) {
+        Task* task = event.task;
+        if (task->state == TASK_BLOCKED && task->blockGeneration == event.generation) {
+            task->timedOut = true;
+            detachWaits(task);
+            makeReady(task);
+        }
+        return;
+    }
+
+    interrupt = true;
+    interruptNode = event.node;
+    event.function();
+    interrupt = false;
+    interruptNode = NO_NODE;
+}
+
+/**
+ * @brief Next task to run: the interrupts due are fired first, then the highest priority ready task runs.
+ * Without ready tasks the clock jumps to the next event
+ *
+ * @return Task* The task or nullptr when the end time has been reached
+ */
+Task* pickNext() {
+    for (;;) {
+        if (!events.empty() && events.top().at <= virtualNow) {
+            fire();
+            continue;
+        }
+
+        for (int priority = configMAX_PRIORITIES - 1; priority >= 0; priority--) {
+            if (ready[priority].empty())
+                continue;
+
+            Task* task = ready[priority].front();
+            ready[priority].pop_front();
+            task->state = TASK_RUNNING;
+            return task;
+        }
+
+        if (events.empty() || events.top().at > endTime) {
+            virtualNow = std::max(virtualNow, endTime);
+            return nullptr;
+        }
+
+        virtualNow = events.top().at;
+    }
+}
+
+/**
+ * @brief Give the CPU to the next task, or to the runner, and wait until this task has it again
+ *
+ * @param self Running task, its state already changed
+ */
+void switchFrom(Task* self) {
+    Task* next = pickNext();
+
+    std::unique_lock<std::mutex> lock(handoff);
+    if (next == self)
+        return;
+
+    switches++;
+    running = next;
+    if (next != nullptr) {
+        next->wake.notify_one();
+    }
+    else {
+        runnerTurn = true;
+        runnerWake.notify_one();
+    }
+
+    self->wake.wait(lock, [self] { return running == self; });
+}
+
+void* taskEntry(void* parameter) {
+    Task* task = static_cast<Task*>(parameter);
+
+    {
+        std::unique_lock<std::mutex> lock(handoff);
+        task->wake.wait(lock, [task] { return running == task; });
+    }
+
+    task->function(task->parameter);
+
+    // A FreeRTOS task must not return
+    Scheduler::remove(task);
+    return nullptr;
+}
+
+} // namespace
+
+uint64_t Scheduler::now() {
+    return virtualNow;
+}
+
+Task* Scheduler::current() {
+    return interrupt ? nullptr : running;
+}
+
+int Scheduler::currentNode() {
+    if (interrupt)
+        return interruptNode;
+
+    return running != nullptr ? running->node : NO_NODE;
+}
+
+bool Scheduler::inInterrupt() {
+    return interrupt;
+}
+
+Task* Scheduler::createTask(TaskFunction_t function, const char* name, uint32_t stackSize, void* parameter,
+    UBaseType_t priority, int node) {
+
+    Task* task = new Task();
+    task->id = nextTaskId++;
+    task->node = node;
+    task->name = name != nullptr ? name : "";
+    task->priority = std::min<UBaseType_t>(priority, configMAX_PRIORITIES - 1);
+    task->stackSize = stackSize;
+    task->function = function;
+    task->parameter = parameter;
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, TASK_THREAD_STACK_SIZE);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    pthread_t thread;
+    int error = pthread_create(&thread, &attributes, taskEntry, task);
+    pthread_attr_destroy(&attributes);
+
+    if (error != 0) {
+        fprintf(stderr, "Task %s of node %d not created, error %d\n", task->name.c_str(), node, error);
+        delete task;
+        return nullptr;
+    }
+
+    makeReady(task);
+    return task;
+}
+
+bool Scheduler::block(uint64_t timeout) {
+    Task* self = running;
+    self->state = TASK_BLOCKED;
+    self->timedOut = false;
+    uint64_t generation = ++self->blockGeneration;
+
+    if (timeout != WAIT_FOREVER)
+        pushEvent(virtualNow + timeout, self->node, self, generation, nullptr);
+
+    switchFrom(self);
+    return !self->timedOut;
+}
+
+void Scheduler::wake(Task* task) {
+    if (task->state != TASK_BLOCKED)
+        return;
+
+    task->blockGeneration++;
+    task->waitingOn = nullptr;
+    makeReady(task);
+}
+
+void Scheduler::yield() {
+    Task* self = running;
+    self->yieldPending = false;
+    self->state = TASK_READY;
+    ready[self->priority].push_back(self);
+    switchFrom(self);
+}
+
+void Scheduler::preemptIfNeeded() {
+    Task* self = current();
+    if (self == nullptr || !self->yieldPending || self->criticalNesting > 0)
+        return;
+
+    // The preempted task goes first among its priority
+    self->yieldPending = false;
+    self->state = TASK_READY;
+    ready[self->priority].push_front(self);
+    switchFrom(self);
+}
+
+void Scheduler::suspend(Task* task) {
+    switch (task->state) {
+        case TASK_RUNNING:
+            task->state = TASK_SUSPENDED;
+            switchFrom(task);
+            break;
+        case TASK_READY:
+            eraseReady(task);
+            task->state = TASK_SUSPENDED;
+            break;
+        case TASK_BLOCKED:
+            // The blocking call returns as timed out when resumed
+            task->timedOut = true;
+            task->blockGeneration++;
+            detachWaits(task);
+            task->state = TASK_SUSPENDED;
+            break;
+        default:
+            break;
+    }
+}
+
+void Scheduler::resume(Task* task) {
+    if (task->state == TASK_SUSPENDED)
+        makeReady(task);
+}
+
+void Scheduler::remove(Task* task) {
+    TaskState previous = task->state;
+    task->state = TASK_DELETED;
+
+    if (previous == TASK_READY)
+        eraseReady(task);
+    else if (previous == TASK_BLOCKED)
+        detachWaits(task);
+
+    // The thread of a deleted task never runs again. The Task is not freed, the handle can still be used by mistake
+    if (previous == TASK_RUNNING)
+        switchFrom(task);
+}
+
+void Scheduler::setPriority(Task* task, UBaseType_t priority) {
+    priority = std::min<UBaseType_t>(priority, configMAX_PRIORITIES - 1);
+
+    if (task->state == TASK_READY) {
+        eraseReady(task);
+        task->priority = priority;
+        ready[priority].push_back(task);
+
+        if (running != nullptr && task->node == running->node && priority > running->priority)
+            running->yieldPending = true;
+        return;
+    }
+
+    task->priority = priority;
+    if (task != running)
+        return;
+
+    // Lowered below a ready task of the same node
+    for (int p = priority + 1; p < configMAX_PRIORITIES; p++) {
+        for (Task* other : ready[p]) {
+            if (other->node == task->node) {
+                task->yieldPending = true;
+                return;
+            }
+        }
+    }
+}
+
+void Scheduler::schedule(uint64_t at, int node, std::function<void()> event) {
+    pushEvent(at, node, nullptr, 0, std::move(event));
+}
+
+void Scheduler::run(uint64_t until) {
+    endTime = until;
+
+    Task* next = pickNext();
+    if (next == nullptr)
+        return;
+
+    std::unique_lock<std::mutex> lock(handoff);
+    runnerTurn = false;
+    switches++;
+    running = next;
+    next->wake.notify_one();
+
+    runnerWake.wait(lock, [] { return runnerTurn; });
+}
+
+uint64_t Scheduler::getSwitchesNum() {
+    return switches;
+}
+
+} // namespace sim
@@ -0,0 +1,182 @@
+/**
+ * @file Scheduler.h
+ * @brief Discrete event scheduler of the simulator, the virtual clock and the tasks of every node
+ *
+ * Every FreeRTOS task is a host thread, but only one thread runs at a time: the running task keeps the CPU
+ * until it blocks, and then the scheduler gives it to the highest priority ready task. When no task is ready
+ * the virtual clock jumps to the next event, a timeout or a radio interrupt. The tasks do not take virtual time,
+ * so the simulation runs as fast as the host can switch between them and it is deterministic for a seed.
+ *
+ * The higher priority tasks of the same node preempt the running task when it wakes them, outside of a critical section.
+ */
+
+#ifndef SIM_SCHEDULER_H
+#define SIM_SCHEDULER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+
+namespace sim {
+
+// No timeout
+constexpr uint64_t WAIT_FOREVER = UINT64_MAX;
+
+// Node of the tasks created outside any node, by the runner
+constexpr int NO_NODE = -1;
+
+enum TaskState {
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_SUSPENDED,
+    TASK_DELETED
+};
+
+enum NotifyState {
+    NOTIFY_NONE,
+    NOTIFY_WAITING,
+    NOTIFY_RECEIVED
+};
+
+struct Task;
+
+struct Semaphore {
+    enum Type {
+        MUTEX,
+        RECURSIVE_MUTEX,
+        BINARY,
+        COUNTING
+    };
+
+    Type type = BINARY;
+    UBaseType_t count = 0;
+    UBaseType_t maxCount = 1;
+    Task* owner = nullptr;
+    UBaseType_t recursion = 0;
+    // Tasks blocked taking it, in order
+    std::deque<Task*> waiters;
+};
+
+struct Task {
+    uint32_t id = 0;
+    int node = NO_NODE;
+    std::string name;
+    UBaseType_t priority = 0;
+    uint32_t stackSize = 0;
+    TaskFunction_t function = nullptr;
+    void* parameter = nullptr;
+
+    TaskState state = TASK_READY;
+    std::condition_variable wake;
+
+    // Every block has a new generation, the timeouts of the previous ones are ignored
+    uint64_t blockGeneration = 0;
+    bool timedOut = false;
+    Semaphore* waitingOn = nullptr;
+
+    uint32_t notifyValue = 0;
+    NotifyState notifyState = NOTIFY_NONE;
+
+    uint32_t criticalNesting = 0;
+    bool yieldPending = false;
+};
+
+class Scheduler {
+public:
+    /**
+     * @brief Virtual time in microseconds
+     *
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Running task, nullptr in the runner and in the interrupts
+     *
+     */
+    static Task* current();
+
+    /**
+     * @brief Node of the running task or interrupt
+     *
+     */
+    static int currentNode();
+
+    /**
+     * @brief If an interrupt, an event, is running
+     *
+     */
+    static bool inInterrupt();
+
+    /**
+     * @brief Create a task of the node of the running task, or of the given node from the runner
+     *
+     */
+    static Task* createTask(TaskFunction_t function, const char* name, uint32_t stackSize, void* parameter,
+        UBaseType_t priority, int node);
+
+    /**
+     * @brief Block the running task until it is woken or the timeout expires
+     *
+     * @param timeout Timeout in microseconds or WAIT_FOREVER
+     * @return true If it has been woken
+     * @return false If the timeout expired or it has been suspended
+     */
+    static bool block(uint64_t timeout);
+
+    /**
+     * @brief Wake a blocked task
+     *
+     */
+    static void wake(Task* task);
+
+    /**
+     * @brief Give the CPU to the other ready tasks of the same or higher priority
+     *
+     */
+    static void yield();
+
+    /**
+     * @brief Yield if a higher priority task of the same node has been woken, outside of the critical sections
+     *
+     */
+    static void preemptIfNeeded();
+
+    static void suspend(Task* task);
+
+    static void resume(Task* task);
+
+    static void remove(Task* task);
+
+    static void setPriority(Task* task, UBaseType_t priority);
+
+    /**
+     * @brief Run a function as an interrupt of a node at a virtual time
+     *
+     * @param at Virtual time in microseconds, not before now
+     * @param node Node of the interrupt
+     * @param event Function
+     */
+    static void schedule(uint64_t at, int node, std::function<void()> event);
+
+    /**
+     * @brief Run the simulation from the runner until the virtual time, it can be called again to continue
+     *
+     * @param until Virtual time in microseconds
+     */
+    static void run(uint64_t until);
+
+    /**
+     * @brief Number of context switches since the start
+     *
+     */
+    static uint64_t getSwitchesNum();
+};
+
+} // namespace sim
+
+#endif // SIM_SCHEDULER_H
@@ -0,0 +1,238 @@
+/**
+ * @file VirtualChannel.cpp
+ * @brief Shared LoRa channel of the simulation
+ */
+
+#include "VirtualChannel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "Platform.h"
+#include "Scheduler.h"
+#include "VirtualRadio.h"
+
+namespace sim {
+
+namespace {
+
+ChannelModel channelModel;
+ChannelStats channelStats;
+std::mt19937_64 fading(1);
+
+std::vector<VirtualRadio*> radios;
+std::vector<std::shared_ptr<Transmission>> active;
+
+uint64_t splitMix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Shadowing of the link between two nodes, the same in both directions and for the whole simulation
+ *
+ */
+double getShadowing(int a, int b) {
+    if (channelModel.shadowingSigma <= 0)
+        return 0;
+
+    uint64_t key = splitMix(channelModel.seed ^ ((uint64_t) std::min(a, b) << 32 | (uint32_t) std::max(a, b)));
+    double u1 = ((key >> 11) + 1) * (1.0 / 9007199254740993.0);
+    double u2 = (splitMix(key) >> 11) * (1.0 / 9007199254740992.0);
+
+    // Box-Muller
+    return channelModel.shadowingSigma * std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+}
+
+} // namespace
+
+void VirtualChannel::setModel(const ChannelModel& model) {
+    channelModel = model;
+    fading.seed(splitMix(model.seed + 1));
+}
+
+const ChannelModel& VirtualChannel::getModel() {
+    return channelModel;
+}
+
+size_t VirtualChannel::addRadio(VirtualRadio* radio) {
+    radios.push_back(radio);
+    return radios.size() - 1;
+}
+
+double VirtualChannel::getRxPower(const VirtualRadio* sender, const VirtualRadio* receiver) {
+    const NodeInfo& from = getNode(sender->getNode());
+    const NodeInfo& to = getNode(receiver->getNode());
+
+    double distance = std::max(1.0, std::hypot(from.x - to.x, from.y - to.y));
+    double pathLoss = channelModel.referenceLoss +
+        10 * channelModel.exponent * std::log10(distance / channelModel.referenceDistance);
+
+    double rxPower = sender->getOutputPower() - pathLoss - getShadowing(sender->getNode(), receiver->getNode());
+
+    if (channelModel.fadingSigma > 0) {
+        std::normal_distribution<double> distribution(0, channelModel.fadingSigma);
+        rxPower += distribution(fading);
+    }
+
+    return rxPower;
+}
+
+bool VirtualChannel::isSameChannel(const Transmission& transmission, const VirtualRadio* radio) {
+    return std::fabs(transmission.freq - radio->getFrequency()) < 0.001f && transmission.sf == radio->getSpreadingFactor() &&
+        std::fabs(transmission.bw - radio->getBandwidth()) < 0.01f;
+}
+
+bool VirtualChannel::isSameChannel(const Transmission& a, const Transmission& b) {
+    // The spreading factors are taken as orthogonal
+    return std::fabs(a.freq - b.freq) < 0.001f && a.sf == b.sf && std::fabs(a.bw - b.bw) < 0.01f;
+}
+
+std::shared_ptr<Transmission> VirtualChannel::startTransmission(VirtualRadio* sender, const uint8_t* data, size_t length) {
+    std::shared_ptr<Transmission> transmission = std::make_shared<Transmission>();
+    transmission->sender = sender;
+    transmission->start = Scheduler::now();
+    transmission->end = transmission->start + sender->getTimeOnAir(length);
+    transmission->freq = sender->getFrequency();
+    transmission->bw = sender->getBandwidth();
+    transmission->sf = sender->getSpreadingFactor();
+    transmission->syncWord = sender->getSyncWord();
+    transmission->preambleLength = sender->getPreambleLength();
+    transmission->data.assign(data, data + length);
+    transmission->rxPower.assign(radios.size(), -1000);
+
+    double snrLimit = getSnrLimit(transmission->sf);
+    double noiseFloor = getNoiseFloor(transmission->bw);
+
+    for (VirtualRadio* radio : radios) {
+        // The radios of the same node do not hear each other, and the failed nodes neither hear nor are heard
+        if (radio->getNode() == sender->getNode() || getNode(sender->getNode()).failed || getNode(radio->getNode()).failed)
+            continue;
+
+        double rxPower = getRxPower(sender, radio);
+        transmission->rxPower[radio->getIndex()] = rxPower;
+
+        const std::shared_ptr<Transmission>& lock = radio->getLock();
+        if (lock != nullptr) {
+            if (isSameChannel(*lock, *transmission) && radio->getLockRssi() - rxPower < channelModel.captureThreshold)
+                radio->corruptLock();
+            continue;
+        }
+
+        if (rxPower - noiseFloor < snrLimit)
+            continue;
+
+        // A sniffing radio wakes too late for a shorter preamble
+        bool listening = radio->getMode() == VirtualRadio::MODE_RX ||
+            (radio->getMode() == VirtualRadio::MODE_SNIFF && transmission->preambleLength >= radio->getSniffPreambleLength());
+
+        if (!listening || !isSameChannel(*transmission, radio) || radio->getSyncWord() != transmission->syncWord) {
+            channelStats.missed++;
+            continue;
+        }
+
+        // The frames already on the air that are not much weaker corrupt it
+        bool corrupted = false;
+        for (const std::shared_ptr<Transmission>& other : active) {
+            if (isSameChannel(*other, *transmission) &&
+                rxPower - other->rxPower[radio->getIndex()] < channelModel.captureThreshold) {
+                corrupted = true;
+                break;
+            }
+        }
+
+        radio->lockOn(transmission, rxPower, corrupted);
+    }
+
+    active.push_back(transmission);
+
+    Scheduler::schedule(transmission->end, sender->getNode(), [transmission]() {
+        endTransmission(transmission);
+    });
+
+    return transmission;
+}
+
+void VirtualChannel::abortTransmission(const std::shared_ptr<Transmission>& transmission) {
+    if (transmission->aborted)
+        return;
+
+    transmission->aborted = true;
+    channelStats.abortedTransmissions++;
+    active.erase(std::remove(active.begin(), active.end(), transmission), active.end());
+
+    for (VirtualRadio* radio : radios) {
+        if (radio->getLock() == transmission)
+            radio->dropLock();
+    }
+}
+
+void VirtualChannel::endTransmission(const std::shared_ptr<Transmission>& transmission) {
+    if (transmission->aborted)
+        return;
+
+    active.erase(std::remove(active.begin(), active.end(), transmission), active.end());
+    channelStats.transmissions++;
+    channelStats.airtime += transmission->end - transmission->start;
+
+    for (VirtualRadio* radio : radios) {
+        if (radio->getLock() != transmission)
+            continue;
+
+        if (radio->receiveLock())
+            channelStats.receptions++;
+        else
+            channelStats.collisions++;
+
+        Scheduler::schedule(Scheduler::now(), radio->getNode(), [radio]() {
+            radio->fireAction();
+        });
+    }
+
+    transmission->sender->transmitDone();
+}
+
+bool VirtualChannel::isActivityDetected(VirtualRadio* radio) {
+    double snrLimit = getSnrLimit(radio->getSpreadingFactor());
+    double noiseFloor = getNoiseFloor(radio->getBandwidth());
+
+    for (const std::shared_ptr<Transmission>& transmission : active) {
+        if (transmission->sender->getNode() == radio->getNode() || !isSameChannel(*transmission, radio))
+            continue;
+
+        if (transmission->rxPower[radio->getIndex()] - noiseFloor >= snrLimit)
+            return true;
+    }
+
+    return false;
+}
+
+uint32_t VirtualChannel::getTimeOnAir(size_t length, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength, bool crc) {
+    double symbolTime = std::ldexp(1.0, sf) / (bw * 1000.0);
+    bool lowDataRateOptimize = symbolTime > 0.016;
+
+    // Semtech AN1200.13: 8 + max(ceil((8 PL - 4 SF + 28 + 16 CRC) / (4 (SF - 2 DE))) CR, 0)
+    double numerator = 8.0 * length - 4.0 * sf + 28 + (crc ? 16 : 0);
+    double denominator = 4.0 * (sf - (lowDataRateOptimize ? 2 : 0));
+    double payloadSymbols = 8 + std::max(std::ceil(numerator / denominator) * cr, 0.0);
+
+    return (uint32_t) std::lround(((preambleLength + 4.25) + payloadSymbols) * symbolTime * 1000000);
+}
+
+double VirtualChannel::getSnrLimit(uint8_t sf) {
+    // SX126x/SX127x datasheets: -7.5 dB at SF7 down to -20 dB at SF12
+    return -7.5 - 2.5 * (std::clamp<int>(sf, 7, 12) - 7);
+}
+
+double VirtualChannel::getNoiseFloor(float bw) {
+    return -174 + 10 * std::log10(bw * 1000.0) + channelModel.noiseFigure;
+}
+
+const ChannelStats& VirtualChannel::getStats() {
+    return channelStats;
+}
+
+} // namespace sim
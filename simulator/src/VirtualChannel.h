@@ -0,0 +1,137 @@
+/**
+ * @file VirtualChannel.h
+ * @brief Shared LoRa channel of the simulation: time on air, path loss and collisions between the virtual radios
+ */
+
+#ifndef SIM_VIRTUAL_CHANNEL_H
+#define SIM_VIRTUAL_CHANNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sim {
+
+class VirtualRadio;
+
+/**
+ * @brief Propagation model. The path loss is log-distance, by default the LoRa measurements of Petäjäjärvi et al.
+ * at 868 MHz, PL(d) = 127.41 + 20.8 log10(d / 1000 m)
+ *
+ */
+struct ChannelModel {
+    // Reference distance in meters and loss at it in dB
+    double referenceDistance = 1000;
+    double referenceLoss = 127.41;
+    double exponent = 2.08;
+    // Standard deviation in dB of the log-normal shadowing, fixed and symmetric for every link
+    double shadowingSigma = 0;
+    // Standard deviation in dB of the fading of every packet at every receiver
+    double fadingSigma = 0;
+    // Noise figure of the receivers in dB
+    double noiseFigure = 6;
+    // A locked packet survives the overlapping packets of the same channel at least captureThreshold dB weaker
+    double captureThreshold = 6;
+    uint64_t seed = 1;
+};
+
+struct ChannelStats {
+    // Frames started and finished
+    uint64_t transmissions = 0;
+    // Frames aborted by their sender before the end
+    uint64_t abortedTransmissions = 0;
+    // Frames received without error, by every receiver
+    uint64_t receptions = 0;
+    // Frames received with a CRC error, corrupted by an overlapping frame
+    uint64_t collisions = 0;
+    // Frames not received because the receiver was transmitting or not listening on the channel
+    uint64_t missed = 0;
+    // Sum of the time on air of the frames in us
+    uint64_t airtime = 0;
+};
+
+/**
+ * @brief Frame on the air
+ *
+ */
+struct Transmission {
+    VirtualRadio* sender;
+    uint64_t start;
+    uint64_t end;
+    float freq;
+    float bw;
+    uint8_t sf;
+    uint8_t syncWord;
+    uint16_t preambleLength;
+    std::vector<uint8_t> data;
+    // Received power in dBm at every radio, by radio index
+    std::vector<double> rxPower;
+    bool aborted = false;
+};
+
+class VirtualChannel {
+public:
+    static void setModel(const ChannelModel& model);
+
+    static const ChannelModel& getModel();
+
+    /**
+     * @brief Add a radio to the channel
+     *
+     * @return size_t Index of the radio
+     */
+    static size_t addRadio(VirtualRadio* radio);
+
+    /**
+     * @brief Put a frame on the air, the receivers listening on its channel lock on it if it is strong enough.
+     * The transmit done interrupt of the sender and the receive done interrupts fire at the end
+     *
+     */
+    static std::shared_ptr<Transmission> startTransmission(VirtualRadio* sender, const uint8_t* data, size_t length);
+
+    /**
+     * @brief Stop a frame before its end, the receivers locked on it lose it
+     *
+     */
+    static void abortTransmission(const std::shared_ptr<Transmission>& transmission);
+
+    /**
+     * @brief If a frame on the channel of the radio is received over the sensitivity, the channel activity detection
+     *
+     */
+    static bool isActivityDetected(VirtualRadio* radio);
+
+    /**
+     * @brief Time on air in us of a frame, with the explicit header
+     *
+     */
+    static uint32_t getTimeOnAir(size_t length, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength, bool crc);
+
+    /**
+     * @brief Minimum SNR in dB to demodulate a spreading factor
+     *
+     */
+    static double getSnrLimit(uint8_t sf);
+
+    /**
+     * @brief Noise floor in dBm of a bandwidth in kHz
+     *
+     */
+    static double getNoiseFloor(float bw);
+
+    static const ChannelStats& getStats();
+
+private:
+    static void endTransmission(const std::shared_ptr<Transmission>& transmission);
+
+    static double getRxPower(const VirtualRadio* sender, const VirtualRadio* receiver);
+
+    static bool isSameChannel(const Transmission& transmission, const VirtualRadio* radio);
+
+    static bool isSameChannel(const Transmission& a, const Transmission& b);
+};
+
+} // namespace sim
+
+#endif // SIM_VIRTUAL_CHANNEL_H
@@ -0,0 +1,259 @@
+/**
+ * @file VirtualRadio.cpp
+ * @brief LM_Module of the host build, a LoRa radio on the VirtualChannel
+ */
+
+#include "VirtualRadio.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "modules/LM_Virtual.h"
+
+#include "Scheduler.h"
+
+namespace sim {
+
+VirtualRadio::VirtualRadio(int node) : node(node) {}
+
+int16_t VirtualRadio::begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord,
+    int8_t power, int16_t preambleLength) {
+
+    stopActivity();
+    mode = MODE_STANDBY;
+
+    this->freq = freq;
+    this->bw = bw;
+    this->sf = sf;
+    this->cr = cr;
+    this->syncWord = syncWord;
+    this->power = power;
+    this->preambleLength = preambleLength;
+
+    if (!registered) {
+        index = VirtualChannel::addRadio(this);
+        registered = true;
+    }
+
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::receive(uint8_t*, size_t) {
+    // The blocking receive is not used by LoRaMesher
+    return RADIOLIB_ERR_UNKNOWN;
+}
+
+int16_t VirtualRadio::startReceive() {
+    stopActivity();
+    mode = MODE_RX;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::startReceiveDutyCycle(uint16_t senderPreambleLength) {
+    stopActivity();
+    mode = MODE_SNIFF;
+    sniffPreambleLength = senderPreambleLength;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::scanChannel() {
+    stopActivity();
+    mode = MODE_SCAN;
+
+    // The channel activity detection takes two symbols, a frame on the air during them is detected
+    bool detected = VirtualChannel::isActivityDetected(this);
+
+    uint64_t symbolTime = ((uint64_t) 1000000 << sf) / (uint64_t) (bw * 1000);
+    if (Scheduler::current() != nullptr)
+        Scheduler::block(2 * symbolTime);
+
+    detected = detected || VirtualChannel::isActivityDetected(this);
+    mode = MODE_STANDBY;
+
+    return detected ? RADIOLIB_LORA_DETECTED : RADIOLIB_CHANNEL_FREE;
+}
+
+int16_t VirtualRadio::startChannelScan() {
+    // Only the blocking scan is used by LoRaMesher
+    return RADIOLIB_ERR_UNKNOWN;
+}
+
+int16_t VirtualRadio::standby() {
+    stopActivity();
+    mode = MODE_STANDBY;
+    return RADIOLIB_ERR_NONE;
+}
+
+void VirtualRadio::reset() {
+    stopActivity();
+    mode = MODE_STANDBY;
+    action = nullptr;
+}
+
+int16_t VirtualRadio::setCRC(bool crc) {
+    this->crc = crc;
+    return RADIOLIB_ERR_NONE;
+}
+
+size_t VirtualRadio::getPacketLength() {
+    return rxLength;
+}
+
+float VirtualRadio::getRSSI() {
+    return rxRssi;
+}
+
+float VirtualRadio::getSNR() {
+    return rxSnr;
+}
+
+int16_t VirtualRadio::readData(uint8_t* buffer, size_t numBytes) {
+    memcpy(buffer, rxBuffer, std::min(numBytes, rxLength));
+    return rxCrcError ? RADIOLIB_ERR_CRC_MISMATCH : RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::transmit(uint8_t* buffer, size_t length) {
+    int16_t res = startTransmit(buffer, length);
+    if (res != RADIOLIB_ERR_NONE)
+        return res;
+
+    if (Scheduler::current() != nullptr)
+        Scheduler::block(getTimeOnAir(length));
+
+    return finishTransmit();
+}
+
+int16_t VirtualRadio::startTransmit(uint8_t* buffer, size_t length) {
+    if (length > UINT8_MAX)
+        return RADIOLIB_ERR_PACKET_TOO_LONG;
+
+    stopActivity();
+    mode = MODE_TX;
+    transmission = VirtualChannel::startTransmission(this, buffer, length);
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::finishTransmit() {
+    stopActivity();
+    mode = MODE_STANDBY;
+    return RADIOLIB_ERR_NONE;
+}
+
+uint32_t VirtualRadio::getTimeOnAir(size_t length) {
+    return VirtualChannel::getTimeOnAir(length, sf, bw, cr, preambleLength, crc);
+}
+
+void VirtualRadio::setDioActionForReceiving(void (*action)()) {
+    this->action = action;
+}
+
+void VirtualRadio::setDioActionForReceivingTimeout(void (*)()) {
+    // The receive is continuous, it has no timeout
+}
+
+void VirtualRadio::setDioActionForScanning(void (*)()) {
+    // The scan is blocking
+}
+
+void VirtualRadio::setDioActionForScanningTimeout(void (*)()) {
+    // The scan is blocking
+}
+
+void VirtualRadio::setDioActionForTransmitting(void (*action)()) {
+    this->action = action;
+}
+
+void VirtualRadio::clearDioActions() {
+    action = nullptr;
+}
+
+int16_t VirtualRadio::setFrequency(float freq) {
+    // The frame being received is lost, the radio keeps its mode
+    dropLock();
+    this->freq = freq;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setBandwidth(float bw) {
+    dropLock();
+    this->bw = bw;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setSpreadingFactor(uint8_t sf) {
+    dropLock();
+    this->sf = sf;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setCodingRate(uint8_t cr) {
+    this->cr = cr;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setSyncWord(uint8_t syncWord) {
+    this->syncWord = syncWord;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setOutputPower(int8_t power) {
+    this->power = power;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setPreambleLength(int16_t preambleLength) {
+    this->preambleLength = preambleLength;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setGain(uint8_t) {
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t VirtualRadio::setOutputPower(int8_t power, int8_t) {
+    return setOutputPower(power);
+}
+
+void VirtualRadio::lockOn(const std::shared_ptr<Transmission>& transmission, double rssi, bool corrupted) {
+    lock = transmission;
+    lockRssi = rssi;
+    lockCorrupted = corrupted;
+}
+
+bool VirtualRadio::receiveLock() {
+    rxLength = lock->data.size();
+    memcpy(rxBuffer, lock->data.data(), rxLength);
+    rxRssi = (float) lockRssi;
+    rxSnr = (float) (lockRssi - VirtualChannel::getNoiseFloor(bw));
+    rxCrcError = lockCorrupted;
+
+    // Continuous receive, the radio keeps listening
+    lock.reset();
+    return !rxCrcError;
+}
+
+void VirtualRadio::transmitDone() {
+    transmission.reset();
+    mode = MODE_STANDBY;
+    fireAction();
+}
+
+void VirtualRadio::fireAction() {
+    if (action != nullptr)
+        action();
+}
+
+void VirtualRadio::stopActivity() {
+    dropLock();
+
+    if (transmission != nullptr) {
+        VirtualChannel::abortTransmission(transmission);
+        transmission.reset();
+    }
+}
+
+} // namespace sim
+
+LM_Module* LM_CreateVirtualModule(uint8_t) {
+    return new sim::VirtualRadio(sim::Scheduler::currentNode());
+}
@@ -0,0 +1,165 @@
+/**
+ * @file VirtualRadio.h
+ * @brief LM_Module of the host build, a LoRa radio on the VirtualChannel
+ */
+
+#ifndef SIM_VIRTUAL_RADIO_H
+#define SIM_VIRTUAL_RADIO_H
+
+#include <memory>
+
+#include "modules/LM_Module.h"
+
+#include "VirtualChannel.h"
+
+namespace sim {
+
+/**
+ * @brief Virtual radio of a node. It behaves like an SX126x: one interrupt line for the receive and transmit done,
+ * continuous receive mode and a blocking channel activity detection.
+ *
+ * The interrupts run on the virtual clock of the Scheduler, as interrupts of the node of the radio.
+ */
+class VirtualRadio: public LM_Module {
+public:
+    enum Mode {
+        MODE_STANDBY,
+        MODE_RX,
+        MODE_TX,
+        MODE_SCAN,
+        // Receive duty cycle, only the frames with a preamble of at least sniffPreambleLength symbols are detected
+        MODE_SNIFF
+    };
+
+    explicit VirtualRadio(int node);
+
+    int16_t begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord,
+        int8_t power, int16_t preambleLength) override;
+
+    int16_t receive(uint8_t* data, size_t len) override;
+    int16_t startReceive() override;
+    int16_t startReceiveDutyCycle(uint16_t senderPreambleLength) override;
+    int16_t scanChannel() override;
+    int16_t startChannelScan() override;
+    int16_t standby() override;
+    void reset() override;
+    int16_t setCRC(bool crc) override;
+    size_t getPacketLength() override;
+    float getRSSI() override;
+    float getSNR() override;
+    int16_t readData(uint8_t* buffer, size_t numBytes) override;
+    int16_t transmit(uint8_t* buffer, size_t length) override;
+    int16_t startTransmit(uint8_t* buffer, size_t length) override;
+    int16_t finishTransmit() override;
+    uint32_t getTimeOnAir(size_t length) override;
+
+    void setDioActionForReceiving(void (*action)()) override;
+    void setDioActionForReceivingTimeout(void (*action)()) override;
+    void setDioActionForScanning(void (*action)()) override;
+    void setDioActionForScanningTimeout(void (*action)()) override;
+    void setDioActionForTransmitting(void (*action)()) override;
+    void clearDioActions() override;
+
+    int16_t setFrequency(float freq) override;
+    int16_t setBandwidth(float bw) override;
+    int16_t setSpreadingFactor(uint8_t sf) override;
+    int16_t setCodingRate(uint8_t cr) override;
+    int16_t setSyncWord(uint8_t syncWord) override;
+    int16_t setOutputPower(int8_t power) override;
+    int16_t setPreambleLength(int16_t preambleLength) override;
+    int16_t setGain(uint8_t gain) override;
+    int16_t setOutputPower(int8_t power, int8_t useRfo) override;
+
+    int getNode() const { return node; }
+    size_t getIndex() const { return index; }
+    Mode getMode() const { return mode; }
+    float getFrequency() const { return freq; }
+    float getBandwidth() const { return bw; }
+    uint8_t getSpreadingFactor() const { return sf; }
+    uint8_t getSyncWord() const { return syncWord; }
+    int8_t getOutputPower() const { return power; }
+    uint16_t getPreambleLength() const { return preambleLength; }
+    uint16_t getSniffPreambleLength() const { return sniffPreambleLength; }
+
+    /**
+     * @brief Frame the radio is receiving, nullptr if none
+     *
+     */
+    const std::shared_ptr<Transmission>& getLock() const { return lock; }
+
+    /**
+     * @brief Lock on a frame from its start, it is received at its end if it is not corrupted
+     *
+     */
+    void lockOn(const std::shared_ptr<Transmission>& transmission, double rssi, bool corrupted);
+
+    /**
+     * @brief Mark the locked frame as corrupted by an overlapping frame
+     *
+     */
+    void corruptLock() { lockCorrupted = true; }
+
+    double getLockRssi() const { return lockRssi; }
+
+    void dropLock() { lock.reset(); }
+
+    /**
+     * @brief Receive the locked frame at its end, the interrupt fires after it
+     *
+     * @return true If the frame has been received without errors
+     */
+    bool receiveLock();
+
+    /**
+     * @brief The locked frame has finished, from the channel
+     *
+     */
+    void transmitDone();
+
+    /**
+     * @brief Run the interrupt action, in an interrupt of the node
+     *
+     */
+    void fireAction();
+
+private:
+    int node;
+    size_t index = 0;
+    bool registered = false;
+
+    Mode mode = MODE_STANDBY;
+    float freq = 0;
+    float bw = 125;
+    uint8_t sf = 7;
+    uint8_t cr = 7;
+    uint8_t syncWord = 0x12;
+    int8_t power = 10;
+    uint16_t preambleLength = 8;
+    uint16_t sniffPreambleLength = 0;
+    bool crc = true;
+
+    // Receive and transmit done share the interrupt line
+    void (*action)() = nullptr;
+
+    std::shared_ptr<Transmission> transmission;
+
+    std::shared_ptr<Transmission> lock;
+    double lockRssi = 0;
+    bool lockCorrupted = false;
+
+    uint8_t rxBuffer[256];
+    size_t rxLength = 0;
+    float rxRssi = 0;
+    float rxSnr = 0;
+    bool rxCrcError = false;
+
+    /**
+     * @brief Stop the frame being sent and any reception, before changing the mode
+     *
+     */
+    void stopActivity();
+};
+
+} // namespace sim
+
+#endif // SIM_VIRTUAL_RADIO_H
@@ -0,0 +1,936 @@
+/**
+ * @file main.cpp
+ * @brief Multi node runner of the simulator
+ *
+ * Every node loads its own copy of the node library, so it has its own LoraMesher, services and statics.
+ * The non gateway nodes send a payload to their closest gateway every interval, the gateways record the deliveries.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "esp_log.h"
+
+#include "NodeAgent.h"
+#include "Platform.h"
+#include "Scheduler.h"
+#include "VirtualChannel.h"
+
+#ifndef LM_SIM_NODE_LIBRARY
+#define LM_SIM_NODE_LIBRARY "liblm_sim_node.so"
+#endif
+
+namespace {
+
+struct Options {
+    size_t nodes = 10;
+    size_t gateways = 1;
+    // Side of the square area in meters
+    double area = 2000;
+    // Seconds, the traffic starts after the warmup and the deliveries are waited for the drain
+    double warmup = 600;
+    double duration = 3600;
+    double drain = 60;
+    // Seconds, every node boots at a random time of the spread. The nodes booted at the same time would send in lockstep
+    double bootSpread = 30;
+    // Seconds between the payloads of every node, with a uniform jitter of +-50 %
+    double interval = 300;
+    size_t payload = 20;
+    bool reliable = false;
+    bool stream = false;
+    bool datagram = false;
+    uint8_t fecGroup = 0;
+    // Send to the gateway role address instead of the closest gateway of the source
+    bool anycast = false;
+    bool singleTask = false;
+    // Per hop ACKs of the data packets, LoraMesherConfig::hopAck
+    bool hopAck = false;
+    // Compressed application payloads, LoraMesherConfig::compressPayloads
+    bool compress = false;
+    // Payloads encrypted with the same key in every node, LoraMesherConfig::payloadKey
+    bool encrypt = false;
+    // Non gateway nodes closest to the first gateway that fail at the middle of the traffic
+    size_t fail = 0;
+    // Withdraw the routes of the lost neighbors at once, LoraMesherConfig::triggeredWithdrawal
+    bool triggeredWithdrawal = false;
+    // Alternate next hops per route, LoraMesherConfig::multipath
+    bool multipath = false;
+    // Clusters of a grid of clusters x clusters cells, the address prefix of a node is its cell. 0 without clusters
+    size_t clusters = 0;
+    // Slots of the HELLO period, LoraMesherConfig::helloSlots
+    uint8_t helloSlots = 0;
+    // Airtime budget in per mille, LoraMesherConfig::airtimeLimit. 0 uses the duty cycle delay
+    uint16_t airtimeLimit = 0;
+    // Seconds after which a payload is dropped from the send queue, LM_SendOptions::maxAge. 0 without limit
+    double maxAge = 0;
+    // Every payload replaces the one of the node still in the send queue, LM_SendOptions::replaceKey
+    bool latestOnly = false;
+    // Store and forward spool of every node in KB, LoraMesherConfig::spoolPartition. 0 without spool
+    uint32_t spool = 0;
+    // Seconds the gateways are down from the middle of the traffic, 0 without outage
+    double gatewayOutage = 0;
+    // Time of the network from the gateway with the lowest address, LoraMesherConfig::timeSync
+    bool timeSync = false;
+    // Slots of the TDMA frames, LoraMesherConfig::tdmaSlots, with timeSync. 0 with the random backoff
+    uint8_t tdmaSlots = 0;
+    // Congestion in the HELLOs, LoraMesherConfig::backpressure
+    bool backpressure = false;
+    // Sources paced by LoraMesher::getSendInterval
+    bool rateControl = false;
+    // Seconds between the telemetry records of a node, LoraMesherConfig::telemetryInterval. 0 without telemetry
+    uint16_t telemetry = 0;
+    // Ms the ACKs of the large payloads wait for a data packet to the same next hop, LoraMesherConfig::delayedAck
+    uint16_t delayedAck = 0;
+    // Solicit the neighbors at the boot and with an empty routing table, LoraMesherConfig::neighborSolicitation
+    bool solicit = false;
+    // HELLOs of the neighbors and the gateways only, the other routes discovered on demand, LoraMesherConfig::reactiveRoutes
+    bool reactive = false;
+    // Per mille of the data packets with the per hop trace, LoraMesherConfig::hopTraceSampling. 0 without traces
+    uint16_t hopTrace = 0;
+    // Preamble in symbols of the frames to the nodes other than the gateways, in sniff mode,
+    // LoraMesherConfig::sniffPreambleLength. 0 listening continuously
+    uint16_t sniff = 0;
+    // Lowest power per neighbour for the unicast packets, LoraMesherConfig::adaptiveLinkPower
+    bool linkPower = false;
+    // Process workers of the gateways, sharded by source, LoraMesherConfig::processWorkers. 0 without workers
+    uint8_t processWorkers = 0;
+    // Bytes of the reply of a gateway to every payload delivered, sent back to its origin. 0 without replies
+    size_t reply = 0;
+    // KB of the firmware image offered by the first gateway at the end of the warmup, LoraMesherConfig::otaPartition.
+    // 0 without firmware updates
+    size_t ota = 0;
+    // Maximum drift of the local clocks in ppm, every node has a random drift and offset. 0 with the virtual clock
+    double clockDrift = 0;
+    uint64_t seed = 1;
+    std::string library = LM_SIM_NODE_LIBRARY;
+    std::string csv;
+    sim::ChannelModel channel;
+};
+
+// Payload of the generated traffic, it is padded to the payload size with a sensor reading
+struct __attribute__((packed)) TrafficPayload {
+    uint32_t magic;
+    uint16_t origin;
+    uint32_t sequence;
+    uint64_t sentAt;
+};
+
+constexpr uint32_t TRAFFIC_MAGIC = 0x4C4D5349;
+
+constexpr char TRAFFIC_READING[] = "{\"temperature\":21.37,\"humidity\":48.12,\"pressure\":1013.25,\"battery\":3.91}";
+
+struct Node {
+    int index;
+    uint16_t address;
+    bool gateway;
+    const LmSimNodeApi* api;
+    std::mt19937_64 random;
+    bool fails = false;
+    // Last gateway with a route, the payloads go to it with --spool while there is none
+    uint16_t lastGateway = 0;
+
+    uint32_t generated = 0;
+    uint32_t noRoute = 0;
+    uint32_t notEnqueued = 0;
+    uint32_t slowed = 0;
+    uint32_t delivered = 0;
+    uint32_t received = 0;
+    uint32_t replies = 0;
+    // Simulated time the firmware image was verified, and its chunks received at the last sample
+    uint64_t otaVerifiedAt = 0;
+    uint32_t otaReceived = 0;
+    uint32_t otaChunks = 0;
+};
+
+struct Sent {
+    uint64_t sentAt;
+    bool delivered;
+};
+
+Options options;
+std::vector<Node> nodes;
+std::unordered_map<uint64_t, Sent> sent;
+std::vector<uint64_t> latencies;
+uint64_t duplicates = 0;
+// Cluster prefix of the addresses with --clusters
+uint8_t clusterPrefixLength = 0;
+// Node of the gateway with the lowest address, its clock is the time of the network with --time-sync
+int timeRoot = -1;
+// Samples of the time of the network of the nodes, every TIME_SYNC_SAMPLE_INTERVAL s of the traffic
+uint64_t timeSamples = 0;
+std::vector<uint64_t> timeErrors;
+
+constexpr double TIME_SYNC_SAMPLE_INTERVAL = 60;
+
+// Simulated time the first gateway offered the firmware image with --ota, and seconds between the samples of the nodes
+uint64_t otaOfferedAt = 0;
+
+constexpr double OTA_SAMPLE_INTERVAL = 10;
+
+// Version of the firmware of the nodes with --ota, the first gateway runs the next one
+constexpr uint16_t OTA_VERSION = 1;
+
+uint64_t seconds(double s) {
+    return (uint64_t) (s * 1000000);
+}
+
+uint64_t key(uint16_t origin, uint32_t sequence) {
+    return (uint64_t) origin << 32 | sequence;
+}
+
+void onReceive(void* context, uint16_t, const uint8_t* payload, uint32_t size, uint8_t) {
+    Node* node = static_cast<Node*>(context);
+    node->received++;
+
+    TrafficPayload traffic;
+    if (size < sizeof(traffic))
+        return;
+
+    memcpy(&traffic, payload, sizeof(traffic));
+    if (traffic.magic != TRAFFIC_MAGIC)
+        return;
+
+    // The replies are counted by the received payloads of the sources, the duplicates are answered too
+    if (options.reply != 0 && node->gateway) {
+        std::vector<uint8_t> reply(options.reply, 0);
+        if (node->api->send(traffic.origin, reply.data(), (uint32_t) reply.size(), false, 0))
+            node->replies++;
+    }
+
+    auto it = sent.find(key(traffic.origin, traffic.sequence));
+    if (it == sent.end())
+        return;
+
+    if (it->second.delivered) {
+        duplicates++;
+        return;
+    }
+
+    it->second.delivered = true;
+    node->delivered++;
+    latencies.push_back(sim::Scheduler::now() - traffic.sentAt);
+}
+
+// Error of the time of the network of a node against the clock of the root, an interrupt of the node
+void sampleTime(Node* node) {
+    if (sim::getNode(node->index).failed)
+        return;
+
+    timeSamples++;
+    int64_t time;
+    if (node->api->getSyncedTime(&time))
+        timeErrors.push_back((uint64_t) std::llabs(time - sim::getLocalTime(timeRoot)));
+}
+
+// State of the firmware update of a node, an interrupt of the node
+void sampleOta(Node* node) {
+    if (node->api->getOtaState(&node->otaReceived, &node->otaChunks) == 2 && node->otaVerifiedAt == 0)
+        node->otaVerifiedAt = sim::Scheduler::now();
+}
+
+// The first gateway was flashed with the new firmware, it offers its image after the warmup
+void offerOta(Node* node, uint64_t start) {
+    if (start > sim::Scheduler::now())
+        vTaskDelay(pdMS_TO_TICKS((start - sim::Scheduler::now()) / 1000));
+
+    std::vector<uint8_t> image(options.ota * 1024);
+    for (uint8_t& byte : image)
+        byte = (uint8_t) node->random();
+
+    if (node->api->startOta(image.data(), (uint32_t) image.size()))
+        otaOfferedAt = sim::Scheduler::now();
+    else
+        fprintf(stderr, "Firmware image not offered\n");
+}
+
+void nodeRoutine(void* parameter) {
+    Node* node = static_cast<Node*>(parameter);
+
+    std::uniform_real_distribution<double> boot(0, options.bootSpread);
+    uint64_t bootAt = seconds(boot(node->random));
+    if (bootAt >= 1000)
+        vTaskDelay(pdMS_TO_TICKS(bootAt / 1000));
+
+    node->api->begin(node->gateway, options.singleTask, options.hopAck, options.compress, options.encrypt, options.triggeredWithdrawal, options.multipath, clusterPrefixLength, options.helloSlots, options.airtimeLimit, (uint32_t) (options.maxAge * 1000), options.latestOnly, options.spool * 1024, options.timeSync, options.tdmaSlots, options.backpressure, options.telemetry, options.delayedAck, (options.ota * 1024 + 4095) / 4096 * 4096, node->index == 0 && node->gateway ? OTA_VERSION + 1 : OTA_VERSION, options.solicit, options.reactive, options.hopTrace, node->gateway ? 0 : options.sniff, options.linkPower, node->gateway ? options.processWorkers : 0, onReceive, node);
+
+    uint64_t start = seconds(options.warmup);
+
+    if (node->gateway) {
+        if (options.ota != 0 && node->index == 0)
+            offerOta(node, start);
+
+        if (options.gatewayOutage > 0) {
+            uint64_t outageAt = start + seconds(options.duration / 2);
+            if (outageAt > sim::Scheduler::now())
+                vTaskDelay(pdMS_TO_TICKS((outageAt - sim::Scheduler::now()) / 1000));
+            sim::failNode(node->index);
+            vTaskDelay(pdMS_TO_TICKS(seconds(options.gatewayOutage) / 1000));
+            sim::recoverNode(node->index);
+        }
+
+        vTaskSuspend(NULL);
+    }
+
+    uint64_t end = seconds(options.warmup + options.duration);
+    std::uniform_real_distribution<double> jitter(0.5, 1.5);
+
+    // First payload at a random time of the first interval after the warmup
+    std::uniform_real_distribution<double> phase(0, 1);
+    uint64_t next = start + seconds(options.interval * phase(node->random));
+
+    std::vector<uint8_t> payload(options.payload, 0);
+    for (size_t i = sizeof(TrafficPayload); i < payload.size(); i++)
+        payload[i] = TRAFFIC_READING[(i - sizeof(TrafficPayload)) % (sizeof(TRAFFIC_READING) - 1)];
+
+    for (;;) {
+        uint64_t now = sim::Scheduler::now();
+        if (next > now)
+            vTaskDelay(pdMS_TO_TICKS(std::max<uint64_t>(1, (next - now) / 1000)));
+
+        now = sim::Scheduler::now();
+        if (now >= end)
+            break;
+
+        if (node->fails && now >= start + seconds(options.duration / 2)) {
+            sim::failNode(node->index);
+            break;
+        }
+
+        next = now + seconds(options.interval * jitter(node->random));
+
+        node->generated++;
+        TrafficPayload traffic{TRAFFIC_MAGIC, node->address, node->generated, now};
+        memcpy(payload.data(), &traffic, sizeof(traffic));
+
+        uint16_t gateway = node->api->getGateway();
+        if (gateway != 0)
+            node->lastGateway = gateway;
+        else if (options.spool != 0)
+            gateway = node->lastGateway;
+
+        if (gateway == 0) {
+            node->noRoute++;
+            continue;
+        }
+
+        if (options.rateControl) {
+            uint64_t interval = next - now;
+            uint64_t paced = (uint64_t) node->api->getSendInterval(gateway, (uint32_t) (interval / 1000)) * 1000;
+            if (paced > interval) {
+                next = now + paced;
+                node->slowed++;
+            }
+        }
+
+        sent[key(node->address, node->generated)] = Sent{now, false};
+        bool enqueued;
+        if (options.anycast)
+            enqueued = node->api->sendToGateway(payload.data(), (uint32_t) payload.size());
+        else if (options.datagram)
+            enqueued = node->api->sendDatagram(gateway, payload.data(), (uint32_t) payload.size());
+        else if (options.stream)
+            enqueued = node->api->writeStream(gateway, payload.data(), (uint32_t) payload.size());
+        else
+            enqueued = node->api->send(gateway, payload.data(), (uint32_t) payload.size(), options.reliable, options.fecGroup);
+        if (!enqueued)
+            node->notEnqueued++;
+    }
+
+    vTaskSuspend(NULL);
+}
+
+/**
+ * @brief Load a new copy of the node library. The dynamic loader loads a file only once, every node loads its own temporary copy
+ *
+ */
+const LmSimNodeApi* loadNode(const std::string& library) {
+    int source = open(library.c_str(), O_RDONLY);
+    if (source < 0) {
+        fprintf(stderr, "Node library %s not found\n", library.c_str());
+        return nullptr;
+    }
+
+    char path[] = "/tmp/lm_sim_node_XXXXXX";
+    int copy = mkstemp(path);
+    if (copy < 0) {
+        close(source);
+        fprintf(stderr, "Temporary copy of the node library not created\n");
+        return nullptr;
+    }
+
+    char buffer[1 << 16];
+    ssize_t length;
+    while ((length = read(source, buffer, sizeof(buffer))) > 0) {
+        if (write(copy, buffer, length) != length) {
+            length = -1;
+            break;
+        }
+    }
+
+    fchmod(copy, 0700);
+    close(source);
+    close(copy);
+
+    void* handle = length == 0 ? dlopen(path, RTLD_NOW | RTLD_LOCAL) : nullptr;
+    unlink(path);
+
+    if (handle == nullptr) {
+        fprintf(stderr, "Node library not loaded: %s\n", length == 0 ? dlerror() : "copy failed");
+        return nullptr;
+    }
+
+    auto entry = reinterpret_cast<const LmSimNodeApi* (*)()>(dlsym(handle, LM_SIM_NODE_API_SYMBOL));
+    if (entry == nullptr) {
+        fprintf(stderr, "Node library without %s\n", LM_SIM_NODE_API_SYMBOL);
+        return nullptr;
+    }
+
+    return entry();
+}
+
+void printUsage(const char* name) {
+    printf("Usage: %s [options]\n"
+        "  --nodes N             Number of nodes, gateways included (10)\n"
+        "  --gateways N          Number of gateways (1)\n"
+        "  --area M              Side of the square area in meters (2000)\n"
+        "  --warmup S            Seconds before the traffic starts (600)\n"
+        "  --duration S          Seconds of traffic (3600)\n"
+        "  --drain S             Seconds waited for the last deliveries (60)\n"
+        "  --boot-spread S       Seconds over which the nodes boot (30)\n"
+        "  --interval S          Mean seconds between the payloads of a node (300)\n"
+        "  --payload B           Payload size in bytes (20)\n"
+        "  --reliable            Send the payloads with sendReliablePacket\n"
+        "  --fec K               With --reliable, a parity packet every K packets of a sequence (0)\n"
+        "  --datagram            Send the payloads with sendDatagram, fragmented without ACKs\n"
+        "  --stream              Write the payloads to a stream to the gateway, with a congestion window\n"
+        "  --anycast             Send the payloads with sendToRole(ROLE_GATEWAY), resolved by every hop\n"
+        "  --single-task         Run every LoraMesher in the single task mode\n"
+        "  --hop-ack             Acknowledge every hop of the data packets and resend the lost ones\n"
+        "  --compress            Compress the payloads with the static dictionary LZ codec\n"
+        "  --encrypt             Encrypt the payloads end to end with AES-CCM\n"
+        "  --fail N              Fail the N nodes closest to the first gateway at the middle of the traffic (0)\n"
+        "  --withdraw            Withdraw the routes of the lost neighbors at once with triggered HELLOs\n"
+        "  --multipath           Keep alternate next hops and fail over to them\n"
+        "  --clusters G          Hierarchical routing, clusters of a G x G grid, up to 15 (0)\n"
+        "  --hello-slots N       Send the HELLOs in N slots of the period chosen by address (0)\n"
+        "  --solicit             Solicit the HELLOs of the neighbors at the boot and with an empty routing table\n"
+        "  --reactive            Advertise the neighbors and the gateways only, discover the other routes on demand\n"
+        "  --hop-trace PM        Per hop trace of PM per mille of the data packets, decoded by the gateways (0)\n"
+        "  --sniff N             Nodes other than the gateways in sniff mode, for frames with a N symbols preamble (0)\n"
+        "  --link-power          Send the unicast packets with the lowest power each neighbour reports it needs\n"
+        "  --process-workers N   Gateways process the data packets in N tasks, sharded by source (0)\n"
+        "  --airtime-limit PM    Airtime budget in per mille of every hour, with the traffic class shares (0)\n"
+        "  --max-age S           Drop the payloads that waited S seconds in the send queue (0)\n"
+        "  --latest-only         Replace the payload of a node still in the send queue by its next one\n"
+        "  --spool KB            Store and forward spool of every node for the payloads without a route (0)\n"
+        "  --gateway-outage S    Cut the gateways off for S seconds from the middle of the traffic (0)\n"
+        "  --time-sync           Synchronize the clocks of the nodes with the gateway with the lowest address\n"
+        "  --tdma N              TDMA frames of N slots on the synchronized time, up to 32 (0)\n"
+        "  --backpressure        Advertise the congestion in the HELLOs\n"
+        "  --rate-control        Pace the sources with the congestion of their path and the airtime budget\n"
+        "  --telemetry S         Telemetry of every node in its HELLOs every S seconds, collected by the gateways (0)\n"
+        "  --delayed-ack MS      With --reliable, ACKs wait up to MS ms to ride on a data frame to the same next hop (0)\n"
+        "  --reply B             The gateways answer every payload with B bytes back to its origin (0)\n"
+        "  --ota KB              The first gateway offers a firmware image of KB kilobytes after the warmup (0)\n"
+        "  --clock-drift PPM     Random offset and drift of up to PPM of the clock of every node (0)\n"
+        "  --seed N              Seed of the placement, traffic and channel (1)\n"
+        "  --path-loss DB        Loss at the reference distance (127.41)\n"
+        "  --reference M         Reference distance in meters (1000)\n"
+        "  --exponent N          Path loss exponent (2.08)\n"
+        "  --shadowing DB        Sigma of the log-normal shadowing of every link (0)\n"
+        "  --fading DB           Sigma of the fading of every packet (0)\n"
+        "  --capture DB          Capture threshold (6)\n"
+        "  --log-level N         0 none, 1 error, 2 warning, 3 info, 4 debug, 5 verbose (2)\n"
+        "  --library PATH        Node library (%s)\n"
+        "  --csv PATH            Write the statistics of every node\n",
+        name, LM_SIM_NODE_LIBRARY);
+}
+
+bool parseOptions(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Missing value of %s\n", option.c_str());
+                exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (option == "--nodes") options.nodes = strtoul(value(), nullptr, 10);
+        else if (option == "--gateways") options.gateways = strtoul(value(), nullptr, 10);
+        else if (option == "--area") options.area = atof(value());
+        else if (option == "--warmup") options.warmup = atof(value());
+        else if (option == "--duration") options.duration = atof(value());
+        else if (option == "--drain") options.drain = atof(value());
+        else if (option == "--boot-spread") options.bootSpread = atof(value());
+        else if (option == "--interval") options.interval = atof(value());
+        else if (option == "--payload") options.payload = strtoul(value(), nullptr, 10);
+        else if (option == "--reliable") options.reliable = true;
+        else if (option == "--fec") options.fecGroup = (uint8_t) strtoul(value(), nullptr, 10);
+        else if (option == "--datagram") options.datagram = true;
+        else if (option == "--stream") options.stream = true;
+        else if (option == "--anycast") options.anycast = true;
+        else if (option == "--single-task") options.singleTask = true;
+        else if (option == "--hop-ack") options.hopAck = true;
+        else if (option == "--compress") options.compress = true;
+        else if (option == "--encrypt") options.encrypt = true;
+        else if (option == "--fail") options.fail = strtoul(value(), nullptr, 10);
+        else if (option == "--withdraw") options.triggeredWithdrawal = true;
+        else if (option == "--multipath") options.multipath = true;
+        else if (option == "--clusters") options.clusters = strtoul(value(), nullptr, 10);
+        else if (option == "--airtime-limit") options.airtimeLimit = std::min(strtoul(value(), nullptr, 10), 1000ul);
+        else if (option == "--solicit") options.solicit = true;
+        else if (option == "--reactive") options.reactive = true;
+        else if (option == "--hop-trace") options.hopTrace = std::min(strtoul(value(), nullptr, 10), 1000ul);
+        else if (option == "--sniff") options.sniff = std::min(strtoul(value(), nullptr, 10), 65535ul);
+        else if (option == "--link-power") options.linkPower = true;
+        else if (option == "--process-workers") options.processWorkers = std::min(strtoul(value(), nullptr, 10), 255ul);
+        else if (option == "--hello-slots") options.helloSlots = std::min(strtoul(value(), nullptr, 10), 255ul);
+        else if (option == "--max-age") options.maxAge = atof(value());
+        else if (option == "--latest-only") options.latestOnly = true;
+        else if (option == "--spool") options.spool = strtoul(value(), nullptr, 10);
+        else if (option == "--gateway-outage") options.gatewayOutage = atof(value());
+        else if (option == "--time-sync") options.timeSync = true;
+        else if (option == "--backpressure") options.backpressure = true;
+        else if (option == "--rate-control") options.rateControl = true;
+        else if (option == "--telemetry") options.telemetry = std::min(strtoul(value(), nullptr, 10), 65535ul);
+        else if (option == "--delayed-ack") options.delayedAck = std::min(strtoul(value(), nullptr, 10), 65535ul);
+        else if (option == "--reply") options.reply = std::min(strtoul(value(), nullptr, 10), 200ul);
+        else if (option == "--ota") options.ota = std::min(strtoul(value(), nullptr, 10), 4096ul);
+        else if (option == "--tdma") options.tdmaSlots = std::min(strtoul(value(), nullptr, 10), 32ul);
+        else if (option == "--clock-drift") options.clockDrift = std::max(atof(value()), 0.0);
+        else if (option == "--seed") options.seed = strtoull(value(), nullptr, 10);
+        else if (option == "--path-loss") options.channel.referenceLoss = atof(value());
+        else if (option == "--reference") options.channel.referenceDistance = atof(value());
+        else if (option == "--exponent") options.channel.exponent = atof(value());
+        else if (option == "--shadowing") options.channel.shadowingSigma = atof(value());
+        else if (option == "--fading") options.channel.fadingSigma = atof(value());
+        else if (option == "--capture") options.channel.captureThreshold = atof(value());
+        else if (option == "--log-level") simLogLevel = atoi(value());
+        else if (option == "--library") options.library = value();
+        else if (option == "--csv") options.csv = value();
+        else if (option == "--help") {
+            printUsage(argv[0]);
+            exit(0);
+        }
+        else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.nodes == 0 || options.gateways > options.nodes || options.interval <= 0) {
+        fprintf(stderr, "Invalid nodes, gateways or interval\n");
+        return false;
+    }
+
+    if (options.clusters > 15) {
+        fprintf(stderr, "Invalid clusters\n");
+        return false;
+    }
+
+    // The slots are in the time of the network
+    if (options.tdmaSlots != 0)
+        options.timeSync = true;
+
+    options.payload = std::clamp<size_t>(options.payload, sizeof(TrafficPayload), 200);
+    options.channel.seed = options.seed;
+    return true;
+}
+
+double percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+
+    size_t index = std::min(sorted.size() - 1, (size_t) (p * (sorted.size() - 1) + 0.5));
+    return sorted[index] / 1000.0;
+}
+
+void writeCsv(const std::vector<LmSimNodeStats>& stats) {
+    FILE* file = fopen(options.csv.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "%s not opened\n", options.csv.c_str());
+        return;
+    }
+
+    fprintf(file, "address,gateway,x,y,generated,no_route,not_enqueued,delivered,sent,received_data,forwarded,"
+        "hellos_sent,hellos_received,unreachable,send_queue_dropped,received_queue_dropped,channel_busy,routing_table_size\n");
+
+    for (const Node& node : nodes) {
+        const sim::NodeInfo& info = sim::getNode(node.index);
+        const LmSimNodeStats& s = stats[node.index];
+        fprintf(file, "%04X,%d,%.1f,%.1f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+            node.address, node.gateway, info.x, info.y, node.generated, node.noRoute, node.notEnqueued, node.delivered,
+            s.sentPacketsNum, s.receivedDataPacketsNum, s.forwardedPacketsNum, s.sentHelloPacketsNum, s.receivedHelloPacketsNum,
+            s.destinyUnreachableNum, s.sendQueueDroppedNum, s.receivedQueueDroppedNum, s.channelBusyNum, s.routingTableSize);
+    }
+
+    fclose(file);
+}
+
+void report(double wallSeconds) {
+    std::vector<LmSimNodeStats> stats(nodes.size());
+    for (Node& node : nodes)
+        node.api->getStats(&stats[node.index]);
+
+    uint64_t generated = 0, noRoute = 0, notEnqueued = 0, delivered = 0;
+    uint64_t hellos = 0, forwarded = 0, queueDropped = 0, busy = 0, hopRetransmissions = 0, hopAckLost = 0, datagramsIncomplete = 0, fecRebuilt = 0;
+    uint64_t compressionInput = 0, compressionOutput = 0, authFailed = 0, withdrawn = 0, failovers = 0, reslots = 0;
+    uint64_t tdmaSlotSends = 0, tdmaSlotChanges = 0, framesSent = 0, congestionHellos = 0, slowed = 0, telemetryDropped = 0;
+    uint64_t solicitations = 0, solicitationReplies = 0, routeRequests = 0, routeReplies = 0, routeDiscoveryFailures = 0;
+    uint64_t piggybackedAcks = 0, coalescedAcks = 0, replies = 0, repliesReceived = 0;
+    uint64_t otaServed = 0, otaRequests = 0, otaHashFailures = 0;
+    uint64_t hopTraces = 0, hopTracesTruncated = 0, hopRecords = 0, hopQueueWait = 0, hopDutyCycleWait = 0, hopBackoff = 0, hopTimeOnAir = 0;
+    uint64_t expired = 0, replaced = 0, spoolStored = 0, spoolDrained = 0, spoolDropped = 0, spoolLeft = 0;
+    uint64_t crcErrors = 0, preamblesWithoutPacket = 0, deafTime = 0, busyTx = 0, busyRx = 0, busyCad = 0, busyEstimate = 0;
+    uint32_t minRoutes = UINT32_MAX, maxRoutes = 0, maxMemory = 0, maxMemoryPeak = 0;
+    double sumRoutes = 0, sumMemory = 0;
+
+    for (const Node& node : nodes) {
+        generated += node.generated;
+        noRoute += node.noRoute;
+        notEnqueued += node.notEnqueued;
+        slowed += node.slowed;
+        replies += node.replies;
+        if (!node.gateway)
+            repliesReceived += node.received;
+        delivered += node.delivered;
+
+        const LmSimNodeStats& s = stats[node.index];
+        hellos += s.sentHelloPacketsNum;
+        forwarded += s.forwardedPacketsNum;
+        queueDropped += s.sendQueueDroppedNum + s.receivedQueueDroppedNum;
+        busy += s.channelBusyNum;
+        hopRetransmissions += s.hopRetransmissionsNum;
+        hopAckLost += s.hopAckLostNum;
+        datagramsIncomplete += s.datagramsIncompleteNum;
+        fecRebuilt += s.fecRebuiltNum;
+        compressionInput += s.compressionInputBytes;
+        compressionOutput += s.compressionOutputBytes;
+        authFailed += s.payloadAuthFailedNum;
+        withdrawn += s.neighborsWithdrawnNum;
+        failovers += s.routeFailoversNum;
+        reslots += s.helloReslotsNum;
+        solicitations += s.solicitationsNum;
+        solicitationReplies += s.solicitationRepliesNum;
+        routeRequests += s.routeRequestsNum;
+        routeReplies += s.routeRepliesNum;
+        routeDiscoveryFailures += s.routeDiscoveryFailuresNum;
+        tdmaSlotSends += s.tdmaSlotSendsNum;
+        crcErrors += s.rxCrcErrorsNum;
+        preamblesWithoutPacket += s.preambleWithoutPacketNum;
+        deafTime += s.rxDeafTime;
+        busyTx += s.busyTxTime;
+        busyRx += s.busyRxTime;
+        busyCad += s.busyCadTime;
+        busyEstimate += s.channelBusyPerMille;
+        tdmaSlotChanges += s.tdmaSlotChangesNum;
+        framesSent += s.sentPacketsNum;
+        congestionHellos += s.congestionHellosNum;
+        telemetryDropped += s.telemetryRelayDroppedNum;
+        otaServed += s.otaChunksServedNum;
+        otaRequests += s.otaRequestsNum;
+        otaHashFailures += s.otaHashFailuresNum;
+        hopTraces += s.hopTracesNum;
+        hopTracesTruncated += s.hopTracesTruncatedNum;
+        hopRecords += s.hopRecordsNum;
+        hopQueueWait += s.hopQueueWaitMs;
+        hopDutyCycleWait += s.hopDutyCycleWaitMs;
+        hopBackoff += s.hopBackoffMs;
+        hopTimeOnAir += s.hopTimeOnAirMs;
+        piggybackedAcks += s.piggybackedAcksNum;
+        coalescedAcks += s.coalescedAcksNum;
+        expired += s.sendQueueExpiredNum;
+        replaced += s.sendQueueReplacedNum;
+        spoolStored += s.spoolStoredNum;
+        spoolDrained += s.spoolDrainedNum;
+        spoolDropped += s.spoolDroppedNum;
+        spoolLeft += s.spoolSize;
+        minRoutes = std::min(minRoutes, s.routingTableSize);
+        maxRoutes = std::max(maxRoutes, s.routingTableSize);
+        sumRoutes += s.routingTableSize;
+        maxMemory = std::max(maxMemory, s.memoryBytes);
+        maxMemoryPeak = std::max(maxMemoryPeak, s.memoryPeakBytes);
+        sumMemory += s.memoryBytes;
+    }
+
+    // Freshest record of every node in the tables of the gateways
+    std::unordered_map<uint16_t, uint64_t> telemetryAges;
+    for (const Node& node : nodes) {
+        if (!node.gateway || options.telemetry == 0)
+            continue;
+
+        std::vector<uint16_t> addresses(options.nodes);
+        std::vector<uint32_t> ages(options.nodes);
+        uint32_t length = node.api->getTelemetry(addresses.data(), ages.data(), (uint32_t) options.nodes);
+        for (uint32_t i = 0; i < length; i++) {
+            auto it = telemetryAges.find(addresses[i]);
+            if (it == telemetryAges.end() || ages[i] < it->second)
+                telemetryAges[addresses[i]] = ages[i];
+        }
+    }
+
+    std::vector<uint64_t> telemetryKnown;
+    for (const Node& node : nodes) {
+        auto it = telemetryAges.find(node.address);
+        if (!node.gateway && it != telemetryAges.end())
+            telemetryKnown.push_back(it->second * 1000);
+    }
+
+    // Time per hop of every relay in the traces of all the nodes, the slowest first
+    std::unordered_map<uint16_t, std::pair<uint64_t, uint64_t>> hopTotals;
+    for (const Node& node : nodes) {
+        if (options.hopTrace == 0)
+            break;
+
+        std::vector<uint16_t> addresses(options.nodes);
+        std::vector<uint32_t> hops(options.nodes);
+        std::vector<uint32_t> totals(options.nodes);
+        uint32_t length = node.api->getHopTotals(addresses.data(), hops.data(), totals.data(), (uint32_t) options.nodes);
+        for (uint32_t i = 0; i < length; i++) {
+            hopTotals[addresses[i]].first += hops[i];
+            hopTotals[addresses[i]].second += totals[i];
+        }
+    }
+
+    std::vector<std::pair<double, uint16_t>> slowestRelays;
+    for (const auto& total : hopTotals)
+        slowestRelays.push_back({(double) total.second.second / total.second.first, total.first});
+    std::sort(slowestRelays.rbegin(), slowestRelays.rend());
+
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(timeErrors.begin(), timeErrors.end());
+    std::sort(telemetryKnown.begin(), telemetryKnown.end());
+
+    // Every node but the first gateway receives the image
+    std::vector<uint64_t> otaTimes;
+    double otaProgress = 0;
+    for (const Node& node : nodes) {
+        if (node.index == 0)
+            continue;
+        if (node.otaVerifiedAt != 0)
+            otaTimes.push_back(node.otaVerifiedAt - otaOfferedAt);
+        if (node.otaChunks != 0)
+            otaProgress += (double) node.otaReceived / node.otaChunks;
+    }
+    std::sort(otaTimes.begin(), otaTimes.end());
+    const sim::ChannelStats& channel = sim::VirtualChannel::getStats();
+    double simulated = sim::Scheduler::now() / 1e6;
+
+    printf("Nodes                %zu, %zu gateways, %.0f m area, seed %" PRIu64 "%s%s\n", options.nodes, options.gateways,
+        options.area, options.seed, options.singleTask ? ", single task" : "", options.hopAck ? ", hop ACK" : "");
+    printf("Generated            %" PRIu64 " (%" PRIu64 " without a gateway route, %" PRIu64 " not enqueued)\n",
+        generated, noRoute, notEnqueued);
+    printf("Delivered            %" PRIu64 ", %" PRIu64 " duplicates\n", delivered, duplicates);
+    printf("PDR                  %.2f %%\n", generated > 0 ? 100.0 * delivered / generated : 0.0);
+    printf("Latency ms           p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n", percentile(latencies, 0.5),
+        percentile(latencies, 0.9), percentile(latencies, 0.99), percentile(latencies, 1));
+    printf("Frames               %" PRIu64 " sent, %" PRIu64 " aborted, %" PRIu64 " received, %" PRIu64 " collided, %" PRIu64 " missed\n",
+        channel.transmissions, channel.abortedTransmissions, channel.receptions, channel.collisions, channel.missed);
+    printf("Airtime              %.1f s, %.2f %% channel utilisation per node\n", channel.airtime / 1e6,
+        simulated > 0 ? 100.0 * channel.airtime / 1e6 / simulated / nodes.size() : 0.0);
+    double sensed = simulated > 0 ? 100.0 / 1000 / simulated / nodes.size() : 0.0;
+    printf("Channel sensed       %.2f %% busy per node: own %.2f, received %.2f, detected %.2f. Last estimate %.2f %%\n",
+        (busyTx + busyRx + busyCad) * sensed, busyTx * sensed, busyRx * sensed, busyCad * sensed,
+        busyEstimate / 10.0 / nodes.size());
+    printf("Receive errors       %" PRIu64 " CRC, %" PRIu64 " preambles without frame, %.2f %% deaf per node\n", crcErrors,
+        preamblesWithoutPacket, deafTime * sensed);
+    printf("Mesh                 %" PRIu64 " hellos, %" PRIu64 " forwarded, %" PRIu64 " queue drops, %" PRIu64 " busy channel\n",
+        hellos, forwarded, queueDropped, busy);
+    if (options.hopAck)
+        printf("Hop ACK              %" PRIu64 " retransmissions, %" PRIu64 " lost after the retransmissions\n",
+            hopRetransmissions, hopAckLost);
+    if (options.fecGroup != 0)
+        printf("FEC                  %" PRIu64 " packets rebuilt from the parity\n", fecRebuilt);
+    if (options.compress)
+        printf("Compression          %" PRIu64 " bytes encoded in %" PRIu64 ", %.1f %% saved\n", compressionInput, compressionOutput,
+            compressionInput > 0 ? 100.0 * ((double) compressionInput - compressionOutput) / compressionInput : 0.0);
+    if (options.encrypt)
+        printf("Encryption           %" PRIu64 " payloads dropped with a wrong tag\n", authFailed);
+    if (options.fail > 0 || options.triggeredWithdrawal)
+        printf("Failures             %zu nodes failed, %" PRIu64 " lost neighbors withdrawn\n",
+            std::min(options.fail, nodes.size() - options.gateways), withdrawn);
+    if (options.multipath)
+        printf("Multipath            %" PRIu64 " routes moved to an alternate next hop\n", failovers);
+    if (options.helloSlots != 0)
+        printf("Hello slots          %u slots, %" PRIu64 " moved after lost advertisements\n", options.helloSlots, reslots);
+    if (options.solicit)
+        printf("Solicitation         %" PRIu64 " HELLOs soliciting the neighbors, %" PRIu64 " answers\n", solicitations, solicitationReplies);
+    if (options.reactive)
+        printf("Reactive routes      %" PRIu64 " requests, %" PRIu64 " replies, %" PRIu64 " discoveries failed\n",
+            routeRequests, routeReplies, routeDiscoveryFailures);
+    if (options.hopTrace != 0) {
+        auto perHop = [&](uint64_t sum) { return hopRecords > 0 ? (double) sum / hopRecords : 0.0; };
+        printf("Hop trace            %" PRIu64 " packets (%" PRIu64 " truncated), %" PRIu64 " hops, per hop ms: queue %.0f, "
+            "duty cycle %.0f, backoff %.0f, on air %.0f\n", hopTraces, hopTracesTruncated, hopRecords, perHop(hopQueueWait),
+            perHop(hopDutyCycleWait), perHop(hopBackoff), perHop(hopTimeOnAir));
+        printf("Slowest relays      ");
+        for (size_t i = 0; i < slowestRelays.size() && i < 3; i++)
+            printf(" %04X %.0f ms", slowestRelays[i].second, slowestRelays[i].first);
+        printf("\n");
+    }
+    if (options.maxAge > 0 || options.latestOnly)
+        printf("Stale payloads       %" PRIu64 " expired, %" PRIu64 " replaced by a newer one in the send queue\n", expired, replaced);
+    if (options.spool != 0)
+        printf("Spool                %" PRIu64 " stored, %" PRIu64 " drained, %" PRIu64 " dropped, %" PRIu64 " left\n",
+            spoolStored, spoolDrained, spoolDropped, spoolLeft);
+    if (options.tdmaSlots != 0)
+        printf("TDMA                 %u slots, %.1f %% of the frames sent in a slot of the node, %" PRIu64 " slot changes\n",
+            options.tdmaSlots, framesSent > 0 ? 100.0 * tdmaSlotSends / framesSent : 0.0, tdmaSlotChanges);
+    if (options.backpressure)
+        printf("Backpressure         %" PRIu64 " HELLOs on a congestion change\n", congestionHellos);
+    if (options.rateControl)
+        printf("Rate control         %" PRIu64 " payloads sent after a stretched interval\n", slowed);
+    if (options.reply != 0)
+        printf("Replies              %" PRIu64 " sent, %" PRIu64 " received\n", replies, repliesReceived);
+    if (options.delayedAck != 0)
+        printf("Delayed ACKs         %" PRIu64 " sent in a data frame, %" PRIu64 " replaced by a newer ACK\n", piggybackedAcks, coalescedAcks);
+    if (options.telemetry != 0)
+        printf("Telemetry            %zu of %zu nodes known by a gateway, age s p50 %.0f, max %.0f, %" PRIu64 " records not relayed\n",
+            telemetryKnown.size(), nodes.size() - options.gateways, percentile(telemetryKnown, 0.5) / 1000,
+            percentile(telemetryKnown, 1) / 1000, telemetryDropped);
+    if (options.ota != 0)
+        printf("OTA                  %zu of %zu nodes verified, s p50 %.0f, max %.0f after the offer, %.1f %% of the chunks received, "
+            "%" PRIu64 " chunks served, %" PRIu64 " requests, %" PRIu64 " hash failures\n", otaTimes.size(), nodes.size() - 1,
+            percentile(otaTimes, 0.5) / 1000, percentile(otaTimes, 1) / 1000,
+            nodes.size() > 1 ? 100.0 * otaProgress / (nodes.size() - 1) : 0.0, otaServed, otaRequests, otaHashFailures);
+    if (options.timeSync)
+        printf("Time sync            %.1f %% of the samples synchronized, error us p50 %.0f, p90 %.0f, p99 %.0f, max %.0f\n",
+            timeSamples > 0 ? 100.0 * timeErrors.size() / timeSamples : 0.0, 1000 * percentile(timeErrors, 0.5),
+            1000 * percentile(timeErrors, 0.9), 1000 * percentile(timeErrors, 0.99), 1000 * percentile(timeErrors, 1));
+    if (options.datagram)
+        printf("Datagrams            %" PRIu64 " discarded without all their fragments\n", datagramsIncomplete);
+    printf("Routing table size   min %u, mean %.1f, max %u\n", minRoutes, sumRoutes / nodes.size(), maxRoutes);
+    printf("Memory KB            mean %.1f, max %.1f per node, max %.1f summing the peak of every subsystem\n",
+        sumMemory / nodes.size() / 1024, maxMemory / 1024.0, maxMemoryPeak / 1024.0);
+    printf("Time                 %.0f s simulated in %.1f s, %.0fx real time, %" PRIu64 " context switches\n",
+        simulated, wallSeconds, wallSeconds > 0 ? simulated / wallSeconds : 0.0, sim::Scheduler::getSwitchesNum());
+
+    if (!options.csv.empty())
+        writeCsv(stats);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (!parseOptions(argc, argv))
+        return 2;
+
+    sim::VirtualChannel::setModel(options.channel);
+
+    std::mt19937_64 placement(options.seed);
+    std::uniform_real_distribution<double> position(0, options.area);
+
+    // The cells of the grid are the prefixes of the addresses, the cell addresses end in 1
+    size_t cells = options.clusters * options.clusters;
+    while (cells > 1 && (1u << clusterPrefixLength) < cells)
+        clusterPrefixLength++;
+    if (cells == 1)
+        clusterPrefixLength = 1;
+    std::vector<uint16_t> cellNodes(std::max<size_t>(cells, 1), 0);
+
+    // Offset of up to a minute, like nodes booted at different times, and the drift of the crystal
+    std::mt19937_64 clocks(options.seed * 104729);
+    std::uniform_real_distribution<double> clockOffset(0, 60e6);
+    std::uniform_real_distribution<double> clockDrift(-options.clockDrift * 1e-6, options.clockDrift * 1e-6);
+
+    nodes.reserve(options.nodes);
+    for (size_t i = 0; i < options.nodes; i++) {
+        const LmSimNodeApi* api = loadNode(options.library);
+        if (api == nullptr)
+            return 1;
+
+        uint16_t address = (uint16_t) (0x0100 + i);
+        double x = position(placement);
+        double y = position(placement);
+        if (cells > 0) {
+            size_t column = std::min((size_t) (x / options.area * options.clusters), options.clusters - 1);
+            size_t row = std::min((size_t) (y / options.area * options.clusters), options.clusters - 1);
+            size_t cell = row * options.clusters + column;
+            address = (uint16_t) ((cell << (16 - clusterPrefixLength)) | ++cellNodes[cell]);
+        }
+        int index = sim::addNode(address, x, y);
+        if (options.clockDrift > 0) {
+            int64_t offset = (int64_t) clockOffset(clocks);
+            sim::setClock(index, offset, clockDrift(clocks));
+        }
+
+        nodes.push_back(Node{index, address, i < options.gateways, api, std::mt19937_64(options.seed * 7919 + i)});
+    }
+
+    // The nodes closest to the first gateway are the relays of most routes
+    std::vector<Node*> relays;
+    for (Node& node : nodes) {
+        if (!node.gateway)
+            relays.push_back(&node);
+    }
+    if (options.gateways > 0) {
+        const sim::NodeInfo& gateway = sim::getNode(nodes[0].index);
+        auto distance = [&gateway](const Node* node) {
+            const sim::NodeInfo& info = sim::getNode(node->index);
+            return std::hypot(info.x - gateway.x, info.y - gateway.y);
+        };
+        std::sort(relays.begin(), relays.end(), [&distance](const Node* a, const Node* b) { return distance(a) < distance(b); });
+    }
+    for (size_t i = 0; i < options.fail && i < relays.size(); i++)
+        relays[i]->fails = true;
+
+    for (Node& node : nodes)
+        sim::Scheduler::createTask(nodeRoutine, "Sim node", 4096, &node, 1, node.index);
+
+    for (const Node& node : nodes) {
+        if (node.gateway && (timeRoot < 0 || node.address < sim::getNode(timeRoot).address))
+            timeRoot = node.index;
+    }
+
+    if (options.timeSync && timeRoot >= 0) {
+        for (double t = options.warmup; t <= options.warmup + options.duration; t += TIME_SYNC_SAMPLE_INTERVAL) {
+            for (Node& node : nodes) {
+                if (node.index != timeRoot)
+                    sim::Scheduler::schedule(seconds(t), node.index, [&node]() { sampleTime(&node); });
+            }
+        }
+    }
+
+    if (options.ota != 0 && options.gateways > 0) {
+        for (double t = options.warmup; t <= options.warmup + options.duration + options.drain; t += OTA_SAMPLE_INTERVAL) {
+            for (Node& node : nodes)
+                sim::Scheduler::schedule(seconds(t), node.index, [&node]() { sampleOta(&node); });
+        }
+    }
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    // Run in steps to show the progress
+    uint64_t end = seconds(options.warmup + options.duration + options.drain);
+    uint64_t step = seconds(600);
+    for (uint64_t until = std::min(step, end); ; until = std::min(until + step, end)) {
+        sim::Scheduler::run(until);
+        fprintf(stderr, "\r%.0f / %.0f s", until / 1e6, end / 1e6);
+        if (until == end)
+            break;
+    }
+    fprintf(stderr, "\n");
+
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wallStart;
+    report(wall.count());
+
+    // The node tasks are blocked forever, the libraries are not unloaded
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+}
@@ -20,6 +20,10 @@ size_t getFreeHeap() {
 unsigned long IRAM_ATTR millis() {
     return (unsigned long) (esp_timer_get_time() / 1000ULL);
 }
+
+unsigned long IRAM_ATTR micros() {
+    return (unsigned long) esp_timer_get_time();
+}
 long random(long howsmall, long howbig);
 long random(long howbig) {
     if (howbig == 0) {
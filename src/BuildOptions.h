@@ -39,6 +39,7 @@ using namespace std;
 #define F(string_literal) (string_literal)
 
 unsigned long millis();
+unsigned long micros();
 long random(long howsmall, long howbig);
 
 #endif
@@ -60,6 +61,15 @@ extern const char* LM_VERSION;
 #define LM_POWER 6
 #define LM_DUTY_CYCLE 100
 
+//Airtime budget: LM_AIRTIME_LIMIT per mille of airtime in every LM_AIRTIME_WINDOW ms, 0 disables it.
+//LM_AIRTIME_BURST ms can be sent back to back, LM_AIRTIME_CONTROL_SHARE % of them are reserved for the routing and
+//control classes and LM_AIRTIME_ALARM_SHARE % more for the alarms, see LM_TrafficClass
+#define LM_AIRTIME_LIMIT 0
+#define LM_AIRTIME_WINDOW 3600000
+#define LM_AIRTIME_BURST 2000
+#define LM_AIRTIME_CONTROL_SHARE 20
+#define LM_AIRTIME_ALARM_SHARE 10
+
 //Syncronization Word that identifies the mesh network
 #define LM_SYNC_WORD 19U
 
@@ -69,6 +79,19 @@ extern const char* LM_VERSION;
 // Routing table max size
 #define RTMAXSIZE 256
 
+// Routing table hash index size, 2^RT_INDEX_BITS slots. Keep it at least twice RTMAXSIZE
+#define RT_INDEX_BITS 9
+
+// Neighbour table max size, up to RTMAXSIZE, and its hash index size, 2^LM_NEIGHBOR_INDEX_BITS slots. Keep it at least twice LM_NEIGHBOR_TABLE_SIZE
+#define LM_NEIGHBOR_TABLE_SIZE 64
+#define LM_NEIGHBOR_INDEX_BITS 7
+
+//ETX of the neighbour table: transmissions of the sliding window, up to 32, initial ETX, EWMA alpha and maximum ETX
+#define LM_ETX_WINDOW_SIZE 10
+#define LM_ETX_DEFAULT 1.5f
+#define LM_ETX_ALPHA 0.3f
+#define LM_ETX_MAX 10.0f
+
 //MAX packet size per packet in bytes. It could be changed between 13 and 255 bytes. Recommended 100 or less bytes.
 //If exceed it will be automatically separated through multiple packets 
 //In bytes (226 bytes [UE max allowed with SF7 and 125khz])
@@ -77,7 +100,35 @@ extern const char* LM_VERSION;
 //MAX payload size for reliable and large packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 3 of control packet
 #define LM_MAX_PACKET_SIZE 100
 
+//Packet size fixed at compile time, at most LM_MAX_PACKET_SIZE. 0 takes LoraMesherConfig::max_packet_size at begin, else the
+//size math of every packet folds to constants and max_packet_size is ignored
+#define LM_FIXED_PACKET_SIZE 0
+
+//Number of blocks of every size class of the packet pool. 0 disables the pool
+#define LM_PACKET_POOL_BLOCKS 0
+
+//Place the bulk buffers, reassembly buffers, stored reliable payloads and simulator states, in the PSRAM when the board has it
+#define LM_BULK_BUFFERS_IN_PSRAM 1
+
+//Number of slots of the received packets ring, power of two
+#define LM_RX_RING_SLOTS 8
+
+//Send the packets with the compact header, see CompactHeaderService. All the nodes of the network must use the same value
+#ifndef LM_COMPACT_HEADER
+#define LM_COMPACT_HEADER 0
+#endif
+
+//Maximum number of bytes a packet grows when its compact header is decoded
+#define LM_COMPACT_HEADER_EXPANSION 4
+
+//Extra time in ms, added to twice the time on air, to wait for the transmission done interrupt
+#define LM_TX_DONE_TIMEOUT_MARGIN 100
+
+//Maximum number of data packets to the same next hop sent in one aggregate frame
+#define LM_MAX_AGGREGATED_PACKETS 8
+
 // Packet types
+#define AGGREGATE_P 0b00000001
 #define NEED_ACK_P 0b00000011
 #define DATA_P     0b00000010
 #define HELLO_P    0b00000100
@@ -85,28 +136,412 @@ extern const char* LM_VERSION;
 #define XL_DATA_P  0b00010010
 #define LOST_P     0b00100010
 #define SYNC_P     0b01000010
+//Frame types of the application, see LoraMesher::registerPacketType, are the codes below 0x80 with the bits of AGGREGATE_P,
+//DATA_P and HELLO_P clear. They have the PacketHeader only and go to the neighbors without routes. Types registered at once
+#define LM_CUSTOM_PACKET_TYPES 4
+//Frames of the route discovery, see LoraMesherConfig::reactiveRoutes. They have the PacketHeader only, like the types of the
+//application, with codes above 0x80 so they are not free for it
+#define ROUTE_REQUEST_P 0b10000000
+#define ROUTE_REPLY_P   0b10001000
+//Data packet with the per hop trace at the end of its payload, see LoraMesherConfig::hopTraceSampling. The other bits of a
+//data code flag the control types, so it is DATA_P with bit 7, sent as is with the compact header too
+#define TRACED_DATA_P   0b10000010
+
+// Route packet flags
+#define ROUTE_DELTA_F        0b00000001
+#define ROUTE_REQUEST_FULL_F 0b00000010
+#define ROUTE_COMPACT_F      0b00000100
+#define ROUTE_TIME_SYNC_F    0b00001000
+#define ROUTE_TDMA_F         0b00010000
+#define ROUTE_CONGESTION_F   0b00100000
+#define ROUTE_TELEMETRY_F    0b01000000
+#define ROUTE_SOLICIT_F      0b10000000
+
+// Route packet capabilities of the source, apart from its role so all the role bits stay free for the application
+//The node receives in sniff mode and its HELLOs carry a SniffTrailer
+#define ROUTE_CAP_SNIFF      0b00000001
+//The HELLOs of the node carry a LinkSnrTrailer
+#define ROUTE_CAP_LINK_SNR   0b00000010
 
 // Packet configuration
 #define BROADCAST_ADDR 0xFFFF
+//Destination of the packets to the best node with a role, LM_ROLE_ADDRESS | role, and to all the nodes with a role,
+//LM_MULTICAST_ADDRESS | role. The addresses from LM_MULTICAST_ADDRESS to BROADCAST_ADDR are not given to the nodes
+#define LM_ROLE_ADDRESS 0xFF00
+#define LM_MULTICAST_ADDRESS 0xFE00
+//Maximum next hops of a multicast packet, one copy is sent to every next hop with members behind it
+#define LM_MULTICAST_MAX_BRANCHES 8
+//Maximum hops of a multicast packet, the hops left are sent in the last byte of the payload
+#define LM_MULTICAST_MAX_HOPS 10
+//Destination of the flooded packets, every node delivers and rebroadcasts them once
+#define LM_FLOOD_ADDRESS LM_ROLE_ADDRESS
+//Maximum hops of a flooded packet, the hops left are sent in the last byte of the payload
+#define LM_FLOOD_MAX_HOPS 10
 #define DEFAULT_PRIORITY 20
 #define MAX_PRIORITY 40
 
+//First priority of every traffic class, see LM_TrafficClass. A class has the priorities up to the first one of the
+//next class, the bulk class from 0 and the control class up to MAX_PRIORITY
+#define LM_PRIORITY_ALARM (DEFAULT_PRIORITY + 4)
+#define LM_PRIORITY_ROUTING (DEFAULT_PRIORITY + 8)
+#define LM_PRIORITY_CONTROL (DEFAULT_PRIORITY + 12)
+
+//Flows of the send queue, one per next hop, served with deficit round robin inside the same priority
+#define LM_SEND_FLOWS 8
+//Fixed airtime of a frame, preamble and physical header, in bytes of payload
+#define LM_DRR_FRAME_OVERHEAD 16
+//Deficit round robin quantum, at least the cost of the biggest frame
+#define LM_DRR_QUANTUM (UINT8_MAX + LM_DRR_FRAME_OVERHEAD)
+
+//Default maximum number of packets of the send queue and of the received application queues. 0 for no limit
+#define LM_SEND_QUEUE_CAPACITY 0
+#define LM_RECEIVED_QUEUE_CAPACITY 0
+
+//Packets of a LoraMesher::sendBatch added to the send queue holding it once, longer bursts are added in steps of this size
+#define LM_SEND_BATCH_MAX 16
+
+//Buckets of the log2 latency histograms of the statistics, the last one counts from 2^(LM_HISTOGRAM_BUCKETS - 2) ms
+#define LM_HISTOGRAM_BUCKETS 16
+
 //Definition Times in seconds
 #define HELLO_PACKETS_DELAY 120
 #define DEFAULT_TIMEOUT HELLO_PACKETS_DELAY*5
 #define MIN_TIMEOUT 20
 
+//Maximum time between two full routing advertisements when the delta advertisements are enabled
+#define LM_FULL_HELLO_INTERVAL HELLO_PACKETS_DELAY*2
+
+//Trickle HELLO intervals, in seconds, and consistent HELLOs that suppress a transmission. With a transmission
+//never suppressed twice in a row the longest silence is 2.5 LM_TRICKLE_IMAX, below DEFAULT_TIMEOUT
+#define LM_TRICKLE_IMIN 10
+#define LM_TRICKLE_IMAX HELLO_PACKETS_DELAY
+#define LM_TRICKLE_K 2
+
+//Slotted HELLOs, see LoraMesherConfig::helloSlots. The first HELLO is sent in a slot of LM_HELLO_BOOT_SLOT ms after the
+//boot, the next ones in a slot of LM_HELLO_SLOT_LENGTH ms from the start of the period, at most HELLO_PACKETS_DELAY / helloSlots,
+//or of the second half of the Trickle interval, plus a random jitter of up to LM_HELLO_SLOT_JITTER % of the slot. The slots
+//fill only the start of the period, so the data packets keep a window without HELLOs. The node moves to another slot
+//when LM_HELLO_RESLOT_MISSES advertisements of its neighbors have been lost since its last HELLO
+#define LM_HELLO_BOOT_SLOT 500
+#define LM_HELLO_SLOT_LENGTH 2000
+#define LM_HELLO_SLOT_JITTER 25
+#define LM_HELLO_RESLOT_MISSES 2
+
+//Number of removed routes remembered to be advertised in the next delta advertisement
+#define LM_MAX_WITHDRAWN_ROUTES 8
+
+//Triggered withdrawals, see LoraMesherConfig::triggeredWithdrawal. A neighbor is lost when it has not been heard for
+//LM_NEIGHBOR_TIMEOUT s, above the longest Trickle silence. The triggered HELLO waits a random time up to
+//LM_TRIGGERED_HELLO_DELAY ms, so the neighbors that heard the same withdrawal do not send at the same time
+#define LM_NEIGHBOR_TIMEOUT HELLO_PACKETS_DELAY*3
+#define LM_TRIGGERED_HELLO_DELAY 2000
+
+//Neighbor solicitation, see LoraMesherConfig::neighborSolicitation. A node with an empty routing table solicits again after
+//LM_SOLICIT_INTERVAL s, doubled up to HELLO_PACKETS_DELAY. A neighbor answers after a random delay of up to
+//LM_SOLICIT_REPLY_DELAY ms, once every LM_SOLICIT_HOLDOFF s, so the nodes that boot together get one answer each
+#define LM_SOLICIT_INTERVAL 15
+#define LM_SOLICIT_REPLY_DELAY 3000
+#define LM_SOLICIT_HOLDOFF 30
+
+//Reactive routes, see LoraMesherConfig::reactiveRoutes. Destinations discovered at the same time and packets held until their
+//route is found. A request is flooded again if no reply arrives in LM_DISCOVERY_TIMEOUT ms, LM_DISCOVERY_RETRIES times, then
+//the held packets are dropped. A discovered route lives LM_DISCOVERY_ROUTE_TIMEOUT s without traffic. Requests remembered to
+//relay each one once
+#define LM_DISCOVERY_SLOTS 4
+#define LM_DISCOVERY_HELD_PACKETS 8
+#define LM_DISCOVERY_TIMEOUT 30000
+#define LM_DISCOVERY_RETRIES 2
+#define LM_DISCOVERY_ROUTE_TIMEOUT 300
+#define LM_DISCOVERY_SEEN_REQUESTS 16
+
+//Per hop trace, see LoraMesherConfig::hopTraceSampling. Hops with a record in a traced packet, the next ones are marked as
+//missing, and traces kept by the destination
+#define LM_HOP_TRACE_MAX_HOPS 8
+#define LM_HOP_TRACES 16
+
+//Routing metric of the RoutingTableService, see RoutingMetric.h. The hop count metric is plain distance vector,
+//the other ones select the routes by a cost calculated from the NeighborTableService. All the nodes must use the same metric
+#define LM_METRIC_HOP_COUNT 0
+#define LM_METRIC_ETX 1
+#define LM_METRIC_SNR 2
+#define LM_METRIC_GATEWAY_BIASED 3
+#ifndef LM_ROUTING_METRIC
+#define LM_ROUTING_METRIC LM_METRIC_HOP_COUNT
+#endif
+
+//Fixed point route costs, LM_COST_SCALE is a cost of 1.0. Weights of the hops, the RSSI, the SNR and the ETX - 1 of the next hop,
+//the gateway load bias and the congestion of the next hop above LM_CONGESTION_THRESHOLD. The RSSI and the SNR are normalised
+//between their minimum and maximum
+#define LM_COST_SCALE 1000
+#define LM_COST_W_HOPS 1000
+#define LM_COST_W_RSSI 300
+#define LM_COST_W_SNR 200
+#define LM_COST_W_ETX 400
+#define LM_COST_W_GATEWAY 1000
+#define LM_COST_W_CONGESTION 1000
+#define LM_COST_RSSI_MIN -120
+#define LM_COST_RSSI_MAX -30
+#define LM_COST_SNR_MIN -20
+#define LM_COST_SNR_MAX 10
+
+//Links below LM_COST_WEAK_RSSI dBm or LM_COST_WEAK_SNR dB add LM_COST_WEAK_PENALTY, a good two hops route beats a weak direct link
+#define LM_COST_WEAK_RSSI -125
+#define LM_COST_WEAK_SNR -12
+#define LM_COST_WEAK_PENALTY 1500
+
+//Average load of the gateways, in thousandths of packet per minute, below which there is no gateway load bias
+#define LM_COST_MIN_GATEWAY_LOAD 200
+
+//Default hysteresis in % of the cost routing: a route must be LM_ROUTE_HYSTERESIS % cheaper to replace the current route,
+//LM_LONGER_ROUTE_HYSTERESIS % when it has more hops
+#define LM_ROUTE_HYSTERESIS 15
+#define LM_LONGER_ROUTE_HYSTERESIS 20
+
+//Number of route costs memoised by the RoutingTableService when a cost routing metric is used. Power of two
+#define LM_ROUTE_COST_CACHE_SIZE 32
+
+//Flows assigned to the nodes of a role by RoutingTableService::getNodeByRoleForFlow: maximum nodes considered and
+//advertised gateway load, in packets per minute, that halves the weight of a node
+#define LM_FLOW_MAX_CANDIDATES 8
+#define LM_FLOW_LOAD_REFERENCE 10.0f
+
+//Roles whose best node is cached by RoutingTableService::getRoleRoute, until the routing table or the route costs change
+#define LM_ROLE_ROUTE_CACHE_SIZE 4
+
+//Alternate next hops kept per route with LoraMesherConfig::multipath, at least 1
+#define LM_ROUTE_ALTERNATES 2
+
+//Destinations whose route changed remembered until they are taken to be re-evaluated, more mark all the routes dirty
+#define LM_DIRTY_ROUTES 32
+
+//Change of the link metrics of a neighbour, since the last notified, that marks its routes dirty
+#define LM_ETX_CHANGE_THRESHOLD 0.2f
+#define LM_SNR_CHANGE_THRESHOLD 3
+
+//Timer wheel used by the route and sequence timeouts, LM_TIMER_WHEEL_SLOTS slots of LM_TIMER_RESOLUTION_MS ms
+#define LM_TIMER_WHEEL_SLOTS 64
+#define LM_TIMER_RESOLUTION_MS 1000
+
+//Hash index of the sequences of the Q_WSP and Q_WRP by (source, seq_id), 2^LM_SEQUENCE_INDEX_BITS slots.
+//Each queue keeps up to 2^LM_SEQUENCE_INDEX_BITS - 1 sequences
+#define LM_SEQUENCE_INDEX_BITS 6
+
+//Destinations with their own sequence id counter, the least recently used one is replaced. A new counter starts at a random id
+#define LM_SEQUENCE_COUNTERS 16
+
 //Maximum times that a sequence of packets reach the timeout
 #define MAX_TIMEOUTS 10
 #define MAX_RESEND_PACKET 3
 #define MAX_TRY_BEFORE_SEND 5
 
+//Listen before talk with CAD: default maximum attempts, highest exponent of the contention window and slot added to it in ms
+#define LM_CAD_MAX_ATTEMPTS 6
+#define LM_CAD_MAX_BACKOFF_EXPONENT 5
+#define LM_CAD_BACKOFF_SLOT 10
+
+//Adaptive transmission power per link: SNR samples kept per neighbour, SNR margin above the demodulation floor in dB and lowest power in dBm
+#define LM_ADR_SNR_HISTORY 8
+#define LM_ADR_MARGIN 10
+#define LM_ADR_MIN_POWER 2
+//Neighbours whose SNR a HELLO reports back to them, in turns when there are more, see LinkSnrTrailer
+#define LM_LINK_SNR_REPORTS 4
+
+//Maximum number of channels of the channel plan
+#define LM_MAX_CHANNELS 8
+
+//Packets of a reliable sequence in flight at the same time. 1 is stop and wait, maximum LM_SACK_BITS + 1
+#define LM_RELIABLE_WINDOW_SIZE 1
+//Packets after the last ACK covered by the selective ACK bitmap of an ACK_P
+#define LM_SACK_BITS 32
+
+//Reliable transfers of the application tracked at the same time, see TransferService
+#define LM_MAX_TRANSFERS 8
+
+//Link filter for the desk topologies, see LinkFilterService: links with their own filter and received frames held by their
+//delay at the same time, the frames of a delayed link are processed at once when the delay line is full
+#define LM_LINK_FILTERS 16
+#define LM_LINK_FILTER_DELAYED 8
+
+//Streams open at the same time, see openStream
+#define LM_MAX_STREAMS 4
+//Chunks waiting to be sent in every stream, of LM_STREAM_CHUNK_SIZE bytes, one reliable sequence each
+#define LM_STREAM_CHUNKS 8
+#define LM_STREAM_CHUNK_SIZE 1024
+//Sequences started for a chunk before the stream fails
+#define LM_STREAM_CHUNK_ATTEMPTS 3
+//Congestion window of a new stream, in packets
+#define LM_STREAM_INITIAL_WINDOW 2
+//Time between the attempts to start a chunk when the send queue is full (ms)
+#define LM_STREAM_RETRY_DELAY 1000
+
+//Fragments of a datagram, see sendDatagram, 32 at most, and datagrams reassembled at the same time
+#define LM_MAX_FRAGMENTS 16
+#define LM_FRAGMENT_SLOTS 4
+//Time to receive all the fragments of a datagram after the first one (ms)
+#define LM_FRAGMENT_TIMEOUT 30000
+
+//Truncated CCM tag of the encrypted payloads, see LoraMesherConfig::payloadKey. Even, from 4 to 16 bytes
+#define LM_PAYLOAD_TAG_LENGTH 4
+
+//Duplicate packets cache, 4 * 2^LM_DUPLICATE_CACHE_BITS entries remembered LM_DUPLICATE_TIMEOUT seconds
+#define LM_DUPLICATE_CACHE_BITS 4
+#define LM_DUPLICATE_TIMEOUT 60
+
+//Copies of a flooded packet overheard before its rebroadcast that suppress it, see LoraMesherConfig::floodRedundancy
+#define LM_FLOOD_K 3
+//Seconds a rebroadcast of a flooded packet can wait in the send queue, less than LM_DUPLICATE_TIMEOUT
+#define LM_FLOOD_MAX_WAIT 30
+
+//Store and forward spool, see LoraMesherConfig::spoolPartition. Size in bytes of a segment, a multiple of the flash sector,
+//ms between the drains and packets moved to the send queue every drain, only while it has fewer packets
+#define LM_SPOOL_SEGMENT_SIZE 4096
+#define LM_SPOOL_DRAIN_INTERVAL 1000
+#define LM_SPOOL_DRAIN_BURST 4
+
+//Time synchronization, see LoraMesherConfig::timeSync. Synchronizations kept for the drift regression, offset in us from
+//the estimate that starts the regression again, and ms without a synchronization of the root before the node is not synchronized.
+//LM_TIME_SYNC_TX_DELAY is the us from the stamp of a HELLO until its preamble starts, the SPI transfer of the frame
+#define LM_TIME_SYNC_WINDOW 8
+#define LM_TIME_SYNC_MAX_ERROR 20000
+#define LM_TIME_SYNC_TIMEOUT (HELLO_PACKETS_DELAY*3*1000)
+#define LM_TIME_SYNC_TX_DELAY 0
+
+//TDMA mode, see LoraMesherConfig::tdmaSlots. Maximum slots of a frame, ms of every slot against the synchronization error,
+//neighbors whose slots are kept and ms without a HELLO before they are forgotten. A node owns up to LM_TDMA_MAX_OWN_SLOTS
+//slots, LM_TDMA_HEADROOM percent of its demand: the airtime it sent in the last LM_TDMA_DEMAND_WEIGHT frames on average
+#define LM_TDMA_MAX_SLOTS 32
+#define LM_TDMA_GUARD 20
+#define LM_TDMA_NEIGHBORS 32
+#define LM_TDMA_TIMEOUT (HELLO_PACKETS_DELAY*3*1000)
+#define LM_TDMA_MAX_OWN_SLOTS 4
+#define LM_TDMA_HEADROOM 150
+#define LM_TDMA_DEMAND_WEIGHT 8
+
+//Backpressure, see LoraMesherConfig::backpressure. Send queue length taken as full when the send queue has no capacity,
+//congestion in percent from which a node is congested, and ms that the congestion of a HELLO is valid. A node sends a
+//triggered HELLO when it becomes congested or stops being congested, at most every LM_CONGESTION_HELLO_INTERVAL ms
+#define LM_CONGESTION_QUEUE_LENGTH 16
+#define LM_CONGESTION_THRESHOLD 50
+#define LM_CONGESTION_TIMEOUT (LM_TRICKLE_IMAX*2*1000)
+#define LM_CONGESTION_HELLO_INTERVAL 30000
+
+//Estimate of the channel busy fraction, see LoraMesher::getChannelBusy. Window in ms and smoothing of its EWMA, in windows
+#define LM_CHANNEL_BUSY_WINDOW 10000
+#define LM_CHANNEL_BUSY_SMOOTHING 6
+
+//Sniff mode of the SX126x, see LoraMesherConfig::sniffPreambleLength. Symbols the radio listens every time it wakes, to
+//detect a preamble
+#define LM_SNIFF_MIN_SYMBOLS 8
+
+//Backbone of the secondary radio, see LoraMesherConfig::secondaryPacketType. Bit rate in kbps and preamble length in bits
+//of the FLRC or GFSK modem, and ms after the last HELLO of a neighbour heard on the backbone until its link goes back to LoRa
+#define LM_BACKBONE_BIT_RATE 1300
+#define LM_BACKBONE_PREAMBLE_LENGTH 16
+#define LM_BACKBONE_TIMEOUT (LM_TRICKLE_IMAX*3*1000)
+
+//Source rate control, see LoraMesher::getSendInterval. Most times the interval of a source is stretched, at a congestion
+//of 100 %, and packets per minute of a gateway above which its sources are slowed down by its load over this capacity
+#define LM_RATE_MAX_STRETCH 4
+#define LM_RATE_GATEWAY_CAPACITY 60
+
+//Telemetry, see LoraMesherConfig::telemetryInterval. Nodes kept in the table of a gateway, the least recently heard one is
+//replaced, and records of other nodes waiting in a node to be relayed toward the gateways
+#define LM_TELEMETRY_NODES 64
+#define LM_TELEMETRY_RELAY_SLOTS 4
+
+//Per hop ACK of the unicast data packets, see LoraMesherConfig::hopAck. Packets waiting for the ACK of their next hop,
+//retransmissions and ms waited for the first ACK, plus the backoff window of the next hop and twice the time on air.
+//The wait doubles every retransmission
+#define LM_HOP_ACK_SLOTS 8
+#define LM_HOP_ACK_RETRIES 3
+#define LM_HOP_ACK_TIMEOUT 1000
+
+//ACK and LOST packets of the large payloads waiting for a data packet to the same next hop, see LoraMesherConfig::delayedAck
+#define LM_DELAYED_ACK_SLOTS 4
+
+//Firmware updates over the mesh, see LoraMesherConfig::otaPartition. Bytes of a chunk, a divisor of the flash sector that
+//fits a flooded payload with its 5 bytes of header, the port and the encryption, ms between the chunks flooded by the offering node,
+//between the announces of the image and between the chunks served to a neighbor. A receiver without a new chunk for
+//LM_OTA_REQUEST_TIMEOUT to twice that ms asks its next hop to the offering node for the missing ones, and asks the offering node itself
+//after LM_OTA_UPSTREAM_RETRIES requests without answer. Neighbors served at the same time
+#define LM_OTA_CHUNK_SIZE 64
+#define LM_OTA_CHUNK_INTERVAL 20000
+#define LM_OTA_ANNOUNCE_INTERVAL 300000
+#define LM_OTA_SERVE_INTERVAL 1000
+#define LM_OTA_REQUEST_TIMEOUT 120000
+#define LM_OTA_UPSTREAM_RETRIES 2
+#define LM_OTA_SERVE_SLOTS 4
+
+//Warm restart, see LoraMesherConfig::checkpointPartition. Size in bytes of a checkpoint slot, a multiple of the flash sector,
+//seconds between two checkpoints after a change of the routing table and without changes, so a sector of a partition of
+//n slots is erased at most once every n LM_CHECKPOINT_MIN_INTERVAL s. A restored route lives LM_CHECKPOINT_ROUTE_TIMEOUT s
+//without an advertisement, above the longest Trickle silence and below DEFAULT_TIMEOUT
+#define LM_CHECKPOINT_SLOT_SIZE 4096
+#define LM_CHECKPOINT_MIN_INTERVAL 600
+#define LM_CHECKPOINT_INTERVAL 3600
+#define LM_CHECKPOINT_ROUTE_TIMEOUT HELLO_PACKETS_DELAY*3
+
+//Metrics history, see LoraMesherConfig::metricsInterval. Bytes of the fine and the coarse rings and of a block, the unit
+//overwritten when a ring is full, up to 256. A fine sample of a quiet node takes about 10 bytes, so with a sample every
+//minute the fine ring keeps about 6 h and the coarse one, a sample every LM_METRICS_COARSE_FACTOR fine ones, about a week.
+//Values of the application recorded with every sample and bytes of a reply to a request of another node
+#define LM_METRICS_FINE_BYTES 4096
+#define LM_METRICS_COARSE_BYTES 8192
+#define LM_METRICS_BLOCK_SIZE 256
+#define LM_METRICS_COARSE_FACTOR 15
+#define LM_METRICS_APP_VALUES 4
+#define LM_METRICS_REPLY_SIZE 256
+
+//Default stack size in bytes of the LoRaMesher tasks, see LoraMesher::TaskTopology
+#define LM_TASK_STACK_SIZE 4096
+//Default stack size in bytes of the single task with LoraMesherConfig::singleTask, it runs all the routines
+#define LM_REACTOR_STACK_SIZE 6144
+
+//Ports of the application bound at once to their own queue or callback, see LoraMesher::bindPort
+#define LM_APP_PORTS 8
+
+//Ports of the messages of the library with LoraMesherConfig::applicationPorts, the application cannot bind them or send on
+//them: the firmware updates and the metrics history
+#define LM_PORT_OTA 0xFF
+#define LM_PORT_METRICS 0xFE
+
+//Process workers of LoraMesherConfig::processWorkers at most, and packets waiting for every worker. The Process routine
+//waits for room when the queue of a worker is full
+#define LM_MAX_PROCESS_WORKERS 4
+#define LM_PROCESS_WORKER_QUEUE 16
+
+//States recorded by the SimulatorService ring, the oldest ones are overwritten. Streaming task period in ms, states of every
+//frame batch given to the sink and stack size in bytes
+#define LM_SIMULATOR_RING_SLOTS 128
+#define LM_SIMULATOR_STREAM_PERIOD 100
+#define LM_SIMULATOR_STREAM_BATCH 8
+#define LM_SIMULATOR_STREAM_STACK_SIZE 3072
+
+//Trace of the send and receive paths, see TraceService. Categories compiled, 0 compiles the trace out, and highest level
+//compiled, 1 for the frames on air, 2 with the send queue. Events kept in the ring until they are read
+#define LM_TRACE_TX 0b00000001
+#define LM_TRACE_RX 0b00000010
+#define LM_TRACE_QUEUE 0b00000100
+#define LM_TRACE_CATEGORIES 0
+#define LM_TRACE_LEVEL 2
+#define LM_TRACE_RING_SLOTS 64
+
+//Hooks of the hot paths for external profilers, see LM_HookPoint in services/Hooks.h. 0 compiles them out. With 1 the library
+//includes LM_HOOK_HEADER, a header of the application that defines
+//  static inline void lmHook(LM_HookPoint point, const PacketHeader* header, uint32_t value, uint32_t cycles)
+//with header nullptr at the points without packet and cycles the CPU cycle counter. It is inlined in the tasks and in the
+//receive interrupt, it must not block. For example -DLM_HOOKS=1 -DLM_HOOK_HEADER=\"ProfilerHooks.h\"
+#ifndef LM_HOOKS
+#define LM_HOOKS 0
+#endif
+
 //Role Types
 #define ROLE_DEFAULT 0b00000000
 #define ROLE_GATEWAY 0b00000001
 //Free Role Types from 0b00000010 to 0b10000000
 
-// Define if is testing
-// #define LM_TESTING
+// Define for the host build of the simulator, the radio is a virtual module and FreeRTOS runs on a virtual clock.
+// Set by simulator/CMakeLists.txt, see simulator/README.md
+// #define LM_HOST
 
 #endif
\ No newline at end of file
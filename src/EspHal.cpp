@@ -12,6 +12,7 @@
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 
 #include <esp_private/periph_ctrl.h>
 
@@ -52,7 +53,7 @@ void EspHal::init() {
         .data5_io_num = -1,
         .data6_io_num = -1,
         .data7_io_num = -1,
-        .max_transfer_sz = 0,
+        .max_transfer_sz = DMA_BUFFER_SIZE,
         .flags = 0,
         .isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO, // INTR_CPU_ID_AUTO,
         .intr_flags = 0};
@@ -66,11 +67,24 @@ void EspHal::init() {
     devcfg.flags = SPI_DEVICE_NO_DUMMY;
     std::lock_guard guard(_mutex);
     ESP_ERROR_CHECK_WITHOUT_ABORT(spi_bus_add_device(HOST_ID, &devcfg, &_handle));
+
+    // The driver copies the buffers that are not DMA capable into a temporary allocation on every transaction
+    if (dmaTxBuffer == nullptr)
+        dmaTxBuffer = static_cast<uint8_t*>(heap_caps_malloc(DMA_BUFFER_SIZE, MALLOC_CAP_DMA));
+    if (dmaRxBuffer == nullptr)
+        dmaRxBuffer = static_cast<uint8_t*>(heap_caps_malloc(DMA_BUFFER_SIZE, MALLOC_CAP_DMA));
+    if (dmaTxBuffer == nullptr || dmaRxBuffer == nullptr)
+        ESP_LOGE(LM_TAG, "SPI DMA buffers not allocated, the transfers use the caller buffers");
 }
 
 void EspHal::term() {
     std::lock_guard guard(_mutex);
     spi_bus_remove_device(_handle);
+
+    heap_caps_free(dmaTxBuffer);
+    heap_caps_free(dmaRxBuffer);
+    dmaTxBuffer = nullptr;
+    dmaRxBuffer = nullptr;
 }
 
 // GPIO-related methods (pinMode, digitalWrite etc.) should check
@@ -173,14 +187,53 @@ long EspHal::pulseIn(uint32_t pin, uint32_t state, unsigned long timeout) {
     return (this->micros() - start);
 }
 
+void EspHal::spiBeginTransaction() {
+    // RadioLib drives the chip select itself, the whole transaction is locked so the radios sharing the bus do not interleave
+    _mutex.lock();
+    spi_device_acquire_bus(_handle, portMAX_DELAY);
+}
+
+void EspHal::spiEndTransaction() {
+    spi_device_release_bus(_handle);
+    _mutex.unlock();
+}
+
 void EspHal::spiTransfer(uint8_t* out, size_t len, uint8_t* in) {
-    std::lock_guard guard(_mutex);
     spi_transaction_t SPITransaction;
     memset(&SPITransaction, 0, sizeof(spi_transaction_t));
     SPITransaction.length = len * 8;
-    SPITransaction.tx_buffer = out;
-    SPITransaction.rx_buffer = in;
-    spi_device_transmit(_handle, &SPITransaction);
+
+    // Register accesses fit in the transaction itself, polling them is shorter than the interrupt and the context switch
+    if (len <= sizeof(SPITransaction.tx_data)) {
+        SPITransaction.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+        memcpy(SPITransaction.tx_data, out, len);
+        spi_device_polling_transmit(_handle, &SPITransaction);
+        if (in)
+            memcpy(in, SPITransaction.rx_data, len);
+        return;
+    }
+
+    bool useDmaBuffers = dmaTxBuffer != nullptr && dmaRxBuffer != nullptr && len <= DMA_BUFFER_SIZE;
+    if (useDmaBuffers) {
+        memcpy(dmaTxBuffer, out, len);
+        SPITransaction.tx_buffer = dmaTxBuffer;
+        SPITransaction.rx_buffer = dmaRxBuffer;
+    }
+    else {
+        SPITransaction.tx_buffer = out;
+        SPITransaction.rx_buffer = in;
+    }
+
+    // FIFO transfers are done by DMA, the task blocks until the driver gives the result and the other tasks run meanwhile
+    spi_transaction_t* result = nullptr;
+    if (spi_device_queue_trans(_handle, &SPITransaction, portMAX_DELAY) != ESP_OK ||
+        spi_device_get_trans_result(_handle, &result, portMAX_DELAY) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "SPI transfer of %d bytes failed", (int) len);
+        return;
+    }
+
+    if (useDmaBuffers && in)
+        memcpy(in, dmaRxBuffer, len);
 }
 
 #endif
\ No newline at end of file
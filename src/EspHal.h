@@ -31,11 +31,14 @@ public:
     long pulseIn(uint32_t pin, uint32_t state, unsigned long timeout) override;
 
     void spiBegin() override {}
-    void spiBeginTransaction() override {}
+    void spiBeginTransaction() override;
     void spiTransfer(uint8_t* out, size_t len, uint8_t* in) override;
-    void spiEndTransaction() override {}
+    void spiEndTransaction() override;
     void spiEnd() override {}
 
+    // Largest transfer done from the DMA buffers, a full FIFO of 255 bytes with the command and address bytes
+    static constexpr size_t DMA_BUFFER_SIZE = 264;
+
 private:
     // the HAL can contain any additional private members
     int8_t spiSCK;
@@ -43,6 +46,9 @@ private:
     int8_t spiMOSI;
     spi_device_handle_t _handle;
     std::mutex _mutex;
+    // DMA capable buffers of the FIFO transfers, allocated once at init
+    uint8_t* dmaTxBuffer = nullptr;
+    uint8_t* dmaRxBuffer = nullptr;
 };
 
 #endif
@@ -1,6 +1,6 @@
 #include "LoraMesher.h"
 
-#ifndef ARDUINO
+#if !defined(ARDUINO) && !defined(LM_HOST)
 #include "EspHal.h"
 #endif
 
@@ -13,9 +13,44 @@ void LoraMesher::begin(LoraMesherConfig config) {
     *loraMesherConfig = config;
     initConfiguration();
 
+    // Initialize the packet pool, it cannot be resized later
+    PacketPoolService::init(PacketFactory::getMaxMemoryPacketSize(), config.packetPoolBlocks);
+    PacketPoolService::setBulkInPsram(config.bulkBuffersInPsram);
+
+    // Set the key of the payloads, it cannot be changed later
+    if (config.payloadKey != nullptr && !CryptoService::init(config.payloadKey))
+        ESP_LOGE(LM_TAG, "Payload key not set, the payloads are sent in clear");
+
+    // Open the spool, the packets stored before a reboot are kept
+    if (config.spoolPartition != nullptr && !SpoolService::init(config.spoolPartition))
+        ESP_LOGE(LM_TAG, "Spool not opened, the packets without a route are dropped");
+
+    if (config.otaPartition != nullptr && !config.applicationPorts)
+        ESP_LOGE(LM_TAG, "OTA without applicationPorts, the firmware updates are ignored");
+    else if (config.otaPartition != nullptr && !OtaService::init(config.otaPartition, config.otaVersion))
+        ESP_LOGE(LM_TAG, "OTA partition not opened, the firmware updates are ignored");
+
+    if (config.metricsInterval != 0 && !MetricsHistoryService::init(config.metricsInterval))
+        ESP_LOGE(LM_TAG, "Metrics history not allocated, the metrics are not recorded");
+
+    // Restore the routes and the link metrics of the neighbors before the reboot
+    if (config.checkpointPartition != nullptr) {
+        if (!CheckpointService::init(config.checkpointPartition))
+            ESP_LOGE(LM_TAG, "Checkpoint partition not opened, the routing state is not kept after a reboot");
+        else
+            CheckpointService::restore(restoredTrickleInterval);
+    }
+
+    buildPacketProcessors();
+
     // Initialize the radio
     initializeLoRa();
 
+    if (config.secondaryReceiver) {
+        SecondaryReceivedPackets = new LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>();
+        initializeSecondaryLoRa();
+    }
+
     // Recalculate the max time on air
     recalculateMaxTimeOnAir();
 
@@ -37,13 +72,28 @@ void LoraMesher::standby() {
     //Clear Dio Actions
     clearDioActions();
 
+    if (secondaryRadio) {
+        secondaryRadio->standby();
+        secondaryRadio->clearDioActions();
+        if (SecondaryReceivePacket_TaskHandle)
+            vTaskSuspend(SecondaryReceivePacket_TaskHandle);
+    }
+
     //Suspend all tasks
-    vTaskSuspend(ReceivePacket_TaskHandle);
-    vTaskSuspend(Hello_TaskHandle);
-    vTaskSuspend(ReceiveData_TaskHandle);
-    vTaskSuspend(SendData_TaskHandle);
-    vTaskSuspend(RoutingTableManager_TaskHandle);
-    vTaskSuspend(QueueManager_TaskHandle);
+    if (Reactor_TaskHandle)
+        vTaskSuspend(Reactor_TaskHandle);
+    else if (loraMesherConfig->sniffer)
+        vTaskSuspend(ReceivePacket_TaskHandle);
+    else {
+        vTaskSuspend(ReceivePacket_TaskHandle);
+        vTaskSuspend(Hello_TaskHandle);
+        vTaskSuspend(ReceiveData_TaskHandle);
+        vTaskSuspend(SendData_TaskHandle);
+        vTaskSuspend(RoutingTableManager_TaskHandle);
+        vTaskSuspend(QueueManager_TaskHandle);
+        for (uint8_t i = 0; i < processWorkersLength; i++)
+            vTaskSuspend(processWorkers[i].task);
+    }
 
     //Set previous priority
     vTaskPrioritySet(NULL, prevPriority);
@@ -57,39 +107,90 @@ void LoraMesher::start() {
     vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
 
     // Resume all tasks
-    vTaskResume(ReceivePacket_TaskHandle);
-    vTaskResume(Hello_TaskHandle);
-    vTaskResume(ReceiveData_TaskHandle);
-    vTaskResume(SendData_TaskHandle);
-    vTaskResume(RoutingTableManager_TaskHandle);
-    vTaskResume(QueueManager_TaskHandle);
+    if (Reactor_TaskHandle)
+        vTaskResume(Reactor_TaskHandle);
+    else if (loraMesherConfig->sniffer)
+        vTaskResume(ReceivePacket_TaskHandle);
+    else {
+        vTaskResume(ReceivePacket_TaskHandle);
+        vTaskResume(Hello_TaskHandle);
+        vTaskResume(ReceiveData_TaskHandle);
+        vTaskResume(SendData_TaskHandle);
+        vTaskResume(RoutingTableManager_TaskHandle);
+        vTaskResume(QueueManager_TaskHandle);
+        for (uint8_t i = 0; i < processWorkersLength; i++)
+            vTaskResume(processWorkers[i].task);
+    }
 
     // Start Receiving
     startReceiving();
 
+    if (secondaryRadio) {
+        if (SecondaryReceivePacket_TaskHandle)
+            vTaskResume(SecondaryReceivePacket_TaskHandle);
+        startSecondaryReceiving();
+    }
+
     // Set previous priority
     vTaskPrioritySet(NULL, prevPriority);
 }
 
 LoraMesher::~LoraMesher() {
-    vTaskDelete(ReceivePacket_TaskHandle);
-    vTaskDelete(Hello_TaskHandle);
-    vTaskDelete(ReceiveData_TaskHandle);
-    vTaskDelete(SendData_TaskHandle);
-    vTaskDelete(RoutingTableManager_TaskHandle);
-    vTaskDelete(QueueManager_TaskHandle);
+    if (Reactor_TaskHandle)
+        vTaskDelete(Reactor_TaskHandle);
+    else if (loraMesherConfig->sniffer)
+        vTaskDelete(ReceivePacket_TaskHandle);
+    else {
+        vTaskDelete(ReceivePacket_TaskHandle);
+        vTaskDelete(Hello_TaskHandle);
+        vTaskDelete(ReceiveData_TaskHandle);
+        vTaskDelete(SendData_TaskHandle);
+        vTaskDelete(RoutingTableManager_TaskHandle);
+        vTaskDelete(QueueManager_TaskHandle);
+    }
+    for (uint8_t i = 0; i < processWorkersLength; i++) {
+        vTaskDelete(processWorkers[i].task);
+
+        LM_LinkedList<QueuePacket<Packet<uint8_t>>>* packets = processWorkers[i].packets;
+        while (packets->getLength() > 0)
+            PacketQueueService::deleteQueuePacketAndPacket(packets->Pop());
+        delete packets;
+    }
+    if (SecondaryReceivePacket_TaskHandle)
+        vTaskDelete(SecondaryReceivePacket_TaskHandle);
+
+    RoutingTableService::routeTimers->setNotifyTask(nullptr);
 
     ToSendPackets->Clear();
     delete ToSendPackets;
-    ReceivedPackets->Clear();
     delete ReceivedPackets;
+    delete SecondaryReceivedPackets;
     ReceivedAppPackets->Clear();
     delete ReceivedAppPackets;
+    ReceivedAppPacketViews->Clear();
+    delete ReceivedAppPacketViews;
+    for (PortBinding& binding : portBindings) {
+        if (binding.packets == nullptr)
+            continue;
+
+        binding.packets->Clear();
+        delete binding.packets;
+        binding.views->Clear();
+        delete binding.views;
+    }
+    delete duplicateCache;
+    vSemaphoreDelete(txDoneSemaphore);
 
     clearDioActions();
     radio->reset();
 
     delete radio;
+
+    if (secondaryRadio) {
+        secondaryRadio->clearDioActions();
+        secondaryRadio->reset();
+        delete secondaryRadio;
+    }
 }
 
 void LoraMesher::setConfig(LoraMesherConfig config) {
@@ -97,14 +198,22 @@ void LoraMesher::setConfig(LoraMesherConfig config) {
 
     *loraMesherConfig = config;
     initConfiguration();
-    recalculateMaxTimeOnAir();
 
     restartRadio();
 
+    if (secondaryRadio) {
+        secondaryRadio->reset();
+        initializeSecondaryLoRa();
+    }
+
+    // The time on air table is built with the radio, after it is configured
+    recalculateMaxTimeOnAir();
+
     start();
 }
 
 void LoraMesher::restartRadio() {
+    incStat(stats.radioRestartsNum);
     radio->reset();
     initializeLoRa();
 
@@ -115,6 +224,20 @@ void LoraMesher::initConfiguration() {
     ESP_LOGV(LM_TAG, "Initializing Configuration");
 
     PacketFactory::setMaxPacketSize(loraMesherConfig->max_packet_size);
+    RoutingTableService::setDeltaAdvertisement(loraMesherConfig->deltaHello);
+    RoutingTableService::setCompactAdvertisement(loraMesherConfig->compactHello);
+    RoutingTableService::setTriggeredWithdrawal(loraMesherConfig->triggeredWithdrawal);
+    RoutingTableService::setMultipath(loraMesherConfig->multipath);
+    RoutingTableService::setReactiveRoutes(loraMesherConfig->reactiveRoutes);
+    RouteDiscoveryService::init();
+    HopTraceService::init(loraMesherConfig->hopTraceSampling);
+    SniffService::init(loraMesherConfig->sniffPreambleLength);
+    RoutingTableService::setClusterPrefixLength(loraMesherConfig->clusterPrefixLength);
+
+    if (loraMesherConfig->localAddress != 0)
+        WiFiService::setLocalAddress(loraMesherConfig->localAddress);
+    RoutingTableService::setRouteHysteresis(loraMesherConfig->routeHysteresis, loraMesherConfig->longerRouteHysteresis);
+    TelemetryService::init(loraMesherConfig->telemetryInterval);
 }
 
 void LoraMesher::initializeLoRa() {
@@ -142,82 +265,26 @@ void LoraMesher::initializeLoRa() {
         config.spi = &SPI;
     }
 
-    if (radio == nullptr) {
-        switch (config.module) {
-        case LoraModules::SX1276_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1276 module");
-            radio = new LM_SX1276(config.loraCs, config.loraIrq, config.loraRst, config.spi);
-            break;
-        case LoraModules::SX1262_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1262 module");
-            radio = new LM_SX1262(config.loraCs, config.loraIrq, config.loraRst, config.loraIo1, config.spi);
-            break;
-        case LoraModules::SX1278_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1278 module");
-            radio = new LM_SX1278(config.loraCs, config.loraIrq, config.loraRst, config.loraIo1, config.spi);
-            break;
-        case LoraModules::SX1268_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1268 module");
-            radio = new LM_SX1268(config.loraCs, config.loraIrq, config.loraRst, config.loraIo1, config.spi);
-            break;
-        case LoraModules::SX1280_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1280 module");
-            radio = new LM_SX1280(config.loraCs, config.loraIrq, config.loraRst, config.loraIo1, config.spi);
-            break;
-        case LoraModules::RFM95_MOD:
-            ESP_LOGV(LM_TAG, "Using RFM95 module");
-            radio = new LM_RFM95(config.loraCs, config.loraIrq, config.loraRst, config.spi);
-            break;
-        default:
-            ESP_LOGV(LM_TAG, "Using SX1276 module");
-            radio = new LM_SX1276(config.loraCs, config.loraIrq, config.loraRst, config.spi);
-            break;
-        }
-    }
-
-#else
+#elif !defined(LM_HOST)
     if (config.hal == nullptr)
         config.hal = new EspHal(SPI_SCK, SPI_MISO, SPI_MOSI);
 
     if (config.hal == nullptr)
         ESP_LOGE(LM_TAG, "Could not create SPI HAL");
+#endif
 
-    if (radio == nullptr) {
-        Module* mod = new Module(config.hal, config.loraCs, config.loraIrq, config.loraRst, config.loraIo1);
+    // The bus is kept for the restarts and the secondary receiver
+#ifdef ARDUINO
+    loraMesherConfig->spi = config.spi;
+#else
+    loraMesherConfig->hal = config.hal;
+#endif
 
-        switch (config.module) {
-        case LoraModules::SX1276_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1276 module");
-            radio = new LM_SX1276(mod);
-            break;
-        case LoraModules::SX1262_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1262 module");
-            radio = new LM_SX1262(mod);
-            break;
-        case LoraModules::SX1278_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1278 module");
-            radio = new LM_SX1278(mod);
-            break;
-        case LoraModules::SX1268_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1268 module");
-            radio = new LM_SX1268(mod);
-            break;
-        case LoraModules::SX1280_MOD:
-            ESP_LOGV(LM_TAG, "Using SX1280 module");
-            radio = new LM_SX1280(mod);
-            break;
-        case LoraModules::RFM95_MOD:
-            ESP_LOGV(LM_TAG, "Using RFM95 module");
-            radio = new LM_RFM95(mod);
-            break;
-        default:
-            ESP_LOGV(LM_TAG, "Using SX1276 module");
-            radio = new LM_SX1276(mod);
-            break;
-        }
-    }
+    if (radio == nullptr && config.radioModule != nullptr)
+        radio = config.radioModule;
 
-#endif
+    if (radio == nullptr)
+        radio = createModule(config.module, config.loraCs, config.loraIrq, config.loraRst, config.loraIo1, config);
 
     if (radio == NULL) {
         ESP_LOGE(LM_TAG, "RadioLib not initialized properly");
@@ -225,7 +292,10 @@ void LoraMesher::initializeLoRa() {
 
     // Set up the radio parameters
     ESP_LOGV(LM_TAG, "Initializing radio");
-    int res = radio->begin(config.freq, config.bw, config.sf, config.cr, config.syncWord, config.power, config.preambleLength);
+    homeFrequency = listenFrequency = currentFrequency = getHomeFrequency(getLocalAddress());
+    int res = radio->begin(homeFrequency, config.bw, config.sf, config.cr, config.syncWord, config.power, config.preambleLength);
+    currentTxPower = config.power;
+    currentPreambleLength = config.preambleLength;
     if (res != 0) {
         ESP_LOGE(LM_TAG, "Radio module gave error: %d", res);
     }
@@ -236,11 +306,115 @@ void LoraMesher::initializeLoRa() {
     ESP_LOGI(LM_TAG, "LoRa module initialization DONE");
 }
 
+void LoraMesher::initializeSecondaryLoRa() {
+    LoraMesherConfig config = *loraMesherConfig;
+    if (!config.secondaryReceiver && secondaryRadio == nullptr)
+        return;
+
+    ESP_LOGI(LM_TAG, "Secondary LoRa Module: %d CS: %d IRQ: %d", config.secondaryModule, config.secondaryLoraCs, config.secondaryLoraIrq);
+
+    if (secondaryRadio == nullptr)
+        secondaryRadio = createModule(config.secondaryModule, config.secondaryLoraCs, config.secondaryLoraIrq,
+            config.secondaryLoraRst, config.secondaryLoraIo1, config);
+
+    float freq = config.secondaryFreq != 0 ? config.secondaryFreq : homeFrequency;
+    uint8_t sf = config.secondarySf != 0 ? config.secondarySf : config.sf;
+
+    int res;
+    if (config.secondaryPacketType != LM_PACKET_LORA) {
+        res = secondaryRadio->beginHighRate(config.secondaryPacketType, freq, config.backboneBitRate, config.power,
+            LM_BACKBONE_PREAMBLE_LENGTH);
+        BackboneService::init(res == RADIOLIB_ERR_NONE);
+        if (res == RADIOLIB_ERR_NONE) {
+            ESP_LOGI(LM_TAG, "Backbone on %.1f MHz at %d kbps", freq, config.backboneBitRate);
+        }
+        else {
+            // Only the SX1280 has the high rate modems, the radio stays a LoRa receiver
+            ESP_LOGE(LM_TAG, "Backbone modem %d gave error: %d, the secondary radio receives LoRa", config.secondaryPacketType, res);
+            res = secondaryRadio->begin(freq, config.bw, sf, config.cr, config.syncWord, config.power, config.preambleLength);
+        }
+    }
+    else {
+        res = secondaryRadio->begin(freq, config.bw, sf, config.cr, config.syncWord, config.power, config.preambleLength);
+    }
+
+    if (res != 0) {
+        ESP_LOGE(LM_TAG, "Secondary radio module gave error: %d", res);
+    }
+
+#ifdef LM_ADDCRC_PAYLOAD
+    secondaryRadio->setCRC(true);
+#endif
+    ESP_LOGI(LM_TAG, "Secondary LoRa module initialization DONE");
+}
+
+LM_Module* LoraMesher::createModule(LoraModules module, uint8_t cs, uint8_t irq, uint8_t rst, uint8_t io1, LoraMesherConfig& config) {
+#ifdef ARDUINO
+    switch (module) {
+    case LoraModules::SX1276_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1276 module");
+        return new LM_SX1276(cs, irq, rst, config.spi);
+    case LoraModules::SX1262_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1262 module");
+        return new LM_SX1262(cs, irq, rst, io1, config.spi);
+    case LoraModules::SX1278_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1278 module");
+        return new LM_SX1278(cs, irq, rst, io1, config.spi);
+    case LoraModules::SX1268_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1268 module");
+        return new LM_SX1268(cs, irq, rst, io1, config.spi);
+    case LoraModules::SX1280_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1280 module");
+        return new LM_SX1280(cs, irq, rst, io1, config.spi);
+    case LoraModules::RFM95_MOD:
+        ESP_LOGV(LM_TAG, "Using RFM95 module");
+        return new LM_RFM95(cs, irq, rst, config.spi);
+    default:
+        ESP_LOGV(LM_TAG, "Using SX1276 module");
+        return new LM_SX1276(cs, irq, rst, config.spi);
+    }
+#elif defined(LM_HOST)
+    // The virtual module has no pins nor bus
+    (void) cs;
+    (void) irq;
+    (void) rst;
+    (void) io1;
+    (void) config;
+    ESP_LOGV(LM_TAG, "Using the virtual module of the host build");
+    return LM_CreateVirtualModule(module);
+#else
+    Module* mod = new Module(config.hal, cs, irq, rst, io1);
+
+    switch (module) {
+    case LoraModules::SX1276_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1276 module");
+        return new LM_SX1276(mod);
+    case LoraModules::SX1262_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1262 module");
+        return new LM_SX1262(mod);
+    case LoraModules::SX1278_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1278 module");
+        return new LM_SX1278(mod);
+    case LoraModules::SX1268_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1268 module");
+        return new LM_SX1268(mod);
+    case LoraModules::SX1280_MOD:
+        ESP_LOGV(LM_TAG, "Using SX1280 module");
+        return new LM_SX1280(mod);
+    case LoraModules::RFM95_MOD:
+        ESP_LOGV(LM_TAG, "Using RFM95 module");
+        return new LM_RFM95(mod);
+    default:
+        ESP_LOGV(LM_TAG, "Using SX1276 module");
+        return new LM_SX1276(mod);
+    }
+#endif
+}
+
 void LoraMesher::setDioActionsForScanChannel() {
-    // set the function that will be called
-    // when LoRa preamble is detected
+    // The scan is blocking, RadioLib polls the interrupt pin itself.
+    // Without actions the receive interrupt does not fire when the scan finishes
     clearDioActions();
-    // radio->setDioActionForScanning(onReceive);
 }
 
 void LoraMesher::setDioActionsForReceivePacket() {
@@ -255,9 +429,17 @@ void LoraMesher::clearDioActions() {
 
 //TODO: Retry start receiving if it fails
 int LoraMesher::startReceiving() {
+    if (listenFrequency != currentFrequency) {
+        int resF = radio->setFrequency(listenFrequency);
+        if (resF != RADIOLIB_ERR_NONE)
+            ESP_LOGE(LM_TAG, "Set frequency %.3f gave error: %d", listenFrequency, resF);
+        else
+            currentFrequency = listenFrequency;
+    }
+
     setDioActionsForReceivePacket();
 
-    int res = radio->startReceive();
+    int res = startReceiveMode();
     if (res != 0) {
         ESP_LOGE(LM_TAG, "Starting receiving gave error: %d", res);
         restartRadio();
@@ -266,95 +448,155 @@ int LoraMesher::startReceiving() {
     return res;
 }
 
-void LoraMesher::channelScan() {
-    setDioActionsForScanChannel();
+int LoraMesher::startReceiveMode() {
+    if (!SniffService::isEnabled())
+        return radio->startReceive();
 
-    int res = radio->scanChannel();
+    int res = radio->startReceiveDutyCycle(SniffService::getPreambleLength());
+    if (res == RADIOLIB_ERR_NONE)
+        return res;
 
-    if (res != RADIOLIB_ERR_NONE) {
-        ESP_LOGE(LM_TAG, "Starting new scan failed, code %d", res);
-        channelScan();
-    }
+    // The HELLOs stop advertising it, the neighbours send with the configured preamble again
+    ESP_LOGW(LM_TAG, "Sniff mode not supported by the radio, gave error: %d. Receiving continuously", res);
+    SniffService::init(0);
+    return radio->startReceive();
+}
+
+int LoraMesher::startSecondaryReceiving() {
+    secondaryRadio->clearDioActions();
+    secondaryRadio->setDioActionForReceiving(onSecondaryReceive);
+
+    int res = secondaryRadio->startReceive();
+    if (res != 0)
+        ESP_LOGE(LM_TAG, "Starting receiving in the secondary radio gave error: %d", res);
 
+    return res;
 }
 
-//TODO: Retry start channel scan if it fails
-int LoraMesher::startChannelScan() {
+bool LoraMesher::channelScan() {
     setDioActionsForScanChannel();
 
-    int state = radio->startChannelScan();
-    if (state != RADIOLIB_ERR_NONE) {
-        ESP_LOGE(LM_TAG, "Starting new scan failed, code %d", state);
-        startChannelScan();
+    uint32_t scanStart = millis();
+    int res = radio->scanChannel();
+    incStat(stats.rxDeafTime, millis() - scanStart);
+
+    if (res == RADIOLIB_CHANNEL_FREE)
+        return false;
+
+    // The scan leaves the radio in standby, the packet is not sent now
+    startReceiving();
+
+    if (res == RADIOLIB_PREAMBLE_DETECTED || res == RADIOLIB_LORA_DETECTED) {
+        channelActivityDetected();
+        return true;
     }
 
-    return state;
+    ESP_LOGE(LM_TAG, "Channel scan failed, code %d", res);
+    return false;
 }
 
 void LoraMesher::initializeSchedulers() {
     ESP_LOGV(LM_TAG, "Setting up Schedulers");
-    int res = xTaskCreate(
+    TaskTopology& tasks = loraMesherConfig->taskTopology;
+
+    //A sniffer runs the receiving routines only, in any task topology
+    if (loraMesherConfig->sniffer) {
+        createTask(
+            [](void* o) { static_cast<LoraMesher*>(o)->receivingRoutine(); },
+            "Receiving routine", tasks.receive, &ReceivePacket_TaskHandle);
+        if (secondaryRadio) {
+            createTask(
+                [](void* o) { static_cast<LoraMesher*>(o)->secondaryReceivingRoutine(); },
+                "Secondary receiving routine", tasks.receive, &SecondaryReceivePacket_TaskHandle);
+        }
+
+        vTaskDelay(5000 / portTICK_PERIOD_MS);
+        return;
+    }
+
+    if (loraMesherConfig->singleTask) {
+        createTask(
+            [](void* o) { static_cast<LoraMesher*>(o)->reactorRoutine(); },
+            "LoRaMesher routine", tasks.reactor, &Reactor_TaskHandle);
+
+        RoutingTableService::routeTimers->setNotifyTask(Reactor_TaskHandle, EVENT_ROUTE_TIMER);
+        wspTimers->setNotifyTask(Reactor_TaskHandle, EVENT_QUEUE_TIMER);
+        wrpTimers->setNotifyTask(Reactor_TaskHandle, EVENT_QUEUE_TIMER);
+        hopAckTimers->setNotifyTask(Reactor_TaskHandle, EVENT_QUEUE_TIMER);
+        delayedAckTimers->setNotifyTask(Reactor_TaskHandle, EVENT_QUEUE_TIMER);
+        fragmentTimers->setNotifyTask(Reactor_TaskHandle, EVENT_QUEUE_TIMER);
+
+        vTaskDelay(5000 / portTICK_PERIOD_MS);
+        return;
+    }
+
+    createTask(
         [](void* o) { static_cast<LoraMesher*>(o)->receivingRoutine(); },
-        "Receiving routine",
-        4096,
-        this,
-        6,
-        &ReceivePacket_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Receiving routine creation gave error: %d", res);
+        "Receiving routine", tasks.receive, &ReceivePacket_TaskHandle);
+    if (secondaryRadio) {
+        createTask(
+            [](void* o) { static_cast<LoraMesher*>(o)->secondaryReceivingRoutine(); },
+            "Secondary receiving routine", tasks.receive, &SecondaryReceivePacket_TaskHandle);
     }
-    res = xTaskCreate(
+    createTask(
         [](void* o) { static_cast<LoraMesher*>(o)->sendPackets(); },
-        "Sending routine",
-        4096,
-        this,
-        5,
-        &SendData_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Sending Task creation gave error: %d", res);
-    }
-    res = xTaskCreate(
+        "Sending routine", tasks.send, &SendData_TaskHandle);
+    createTask(
         [](void* o) { static_cast<LoraMesher*>(o)->sendHelloPacket(); },
-        "Hello routine",
-        4096,
-        this,
-        4,
-        &Hello_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Process Task creation gave error: %d", res);
-    }
-    res = xTaskCreate(
+        "Hello routine", tasks.hello, &Hello_TaskHandle);
+    createTask(
         [](void* o) { static_cast<LoraMesher*>(o)->processPackets(); },
-        "Process routine",
-        4096,
-        this,
-        3,
-        &ReceiveData_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Process Task creation gave error: %d", res);
+        "Process routine", tasks.process, &ReceiveData_TaskHandle);
+
+    //The workers are pinned across the cores unless their core is configured
+    uint8_t workers = std::min<uint8_t>(loraMesherConfig->processWorkers, LM_MAX_PROCESS_WORKERS);
+    for (uint8_t i = 0; i < workers; i++) {
+        TaskConfig task = tasks.processWorker;
+        if (task.core == tskNO_AFFINITY)
+            task.core = i % portNUM_PROCESSORS;
+
+        ProcessWorker& worker = processWorkers[i];
+        worker.packets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
+        if (!createTask([](void* o) { static_cast<LoraMesher*>(o)->processWorkerRoutine(); }, "Process worker", task, &worker.task)) {
+            delete worker.packets;
+            worker.packets = nullptr;
+            break;
+        }
+
+        processWorkersLength++;
     }
-    res = xTaskCreate(
+    createTask(
         [](void* o) { static_cast<LoraMesher*>(o)->routingTableManager(); },
-        "Routing Table Manager routine",
-        4096,
-        this,
-        2,
-        &RoutingTableManager_TaskHandle);
-    if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Routing Table Manager Task creation gave error: %d", res);
-    }
-    res = xTaskCreate(
+        "Routing Table Manager routine", tasks.routingTableManager, &RoutingTableManager_TaskHandle);
+    createTask(
         [](void* o) { static_cast<LoraMesher*>(o)->queueManager(); },
-        "Queue Manager routine",
-        4096,
-        this,
-        2,
-        &QueueManager_TaskHandle);
+        "Queue Manager routine", tasks.queueManager, &QueueManager_TaskHandle);
+
+    RoutingTableService::routeTimers->setNotifyTask(RoutingTableManager_TaskHandle);
+    wspTimers->setNotifyTask(QueueManager_TaskHandle);
+    wrpTimers->setNotifyTask(QueueManager_TaskHandle);
+    hopAckTimers->setNotifyTask(QueueManager_TaskHandle);
+    delayedAckTimers->setNotifyTask(QueueManager_TaskHandle);
+    fragmentTimers->setNotifyTask(QueueManager_TaskHandle);
+
+    vTaskDelay(5000 / portTICK_PERIOD_MS);
+}
+
+bool LoraMesher::createTask(TaskFunction_t function, const char* name, const TaskConfig& task, TaskHandle_t* handle) {
+    BaseType_t core = task.core;
+    if (core != tskNO_AFFINITY && (core < 0 || core >= portNUM_PROCESSORS)) {
+        ESP_LOGW(LM_TAG, "%s: core %d does not exist, not pinned", name, (int) core);
+        core = tskNO_AFFINITY;
+    }
+
+    BaseType_t res = xTaskCreatePinnedToCore(function, name, task.stackSize, this, task.priority, handle, core);
     if (res != pdPASS) {
-        ESP_LOGE(LM_TAG, "Queue Manager Task creation gave error: %d", res);
+        ESP_LOGE(LM_TAG, "%s creation gave error: %d", name, (int) res);
+        return false;
     }
 
-    vTaskDelay(5000 / portTICK_PERIOD_MS);
+    ESP_LOGV(LM_TAG, "%s created, core %d, priority %d, stack %d", name, (int) core, (int) task.priority, (int) task.stackSize);
+    return true;
 }
 
 #if defined(ESP8266) || defined(ESP32)
@@ -363,11 +605,58 @@ ICACHE_RAM_ATTR
 void LoraMesher::onReceive(void) {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
-    xHigherPriorityTaskWoken = xTaskNotifyFromISR(
-        LoraMesher::getInstance().ReceivePacket_TaskHandle,
-        0,
-        eSetValueWithoutOverwrite,
-        &xHigherPriorityTaskWoken);
+    LoraMesher& lm = LoraMesher::getInstance();
+    lm.rxTimestamp = micros();
+    LM_HOOK(HOOK_RX_ISR, nullptr, 0);
+
+    if (lm.Reactor_TaskHandle)
+        xTaskNotifyFromISR(lm.Reactor_TaskHandle, EVENT_RX, eSetBits, &xHigherPriorityTaskWoken);
+    else
+        xHigherPriorityTaskWoken = xTaskNotifyFromISR(
+            lm.ReceivePacket_TaskHandle,
+            0,
+            eSetValueWithoutOverwrite,
+            &xHigherPriorityTaskWoken);
+
+    if (xHigherPriorityTaskWoken == pdTRUE)
+        portYIELD_FROM_ISR();
+}
+
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::onSecondaryReceive(void) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    LoraMesher& lm = LoraMesher::getInstance();
+    lm.secondaryRxTimestamp = micros();
+    LM_HOOK(HOOK_RX_ISR, nullptr, 1);
+
+    if (lm.Reactor_TaskHandle)
+        xTaskNotifyFromISR(lm.Reactor_TaskHandle, EVENT_SECONDARY_RX, eSetBits, &xHigherPriorityTaskWoken);
+    else
+        xHigherPriorityTaskWoken = xTaskNotifyFromISR(
+            lm.SecondaryReceivePacket_TaskHandle,
+            0,
+            eSetValueWithoutOverwrite,
+            &xHigherPriorityTaskWoken);
+
+    if (xHigherPriorityTaskWoken == pdTRUE)
+        portYIELD_FROM_ISR();
+}
+
+#if defined(ESP8266) || defined(ESP32)
+ICACHE_RAM_ATTR
+#endif
+void LoraMesher::onTransmitDone(void) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    LoraMesher& lm = LoraMesher::getInstance();
+
+    if (lm.Reactor_TaskHandle)
+        xTaskNotifyFromISR(lm.Reactor_TaskHandle, EVENT_TX_DONE, eSetBits, &xHigherPriorityTaskWoken);
+    else
+        xSemaphoreGiveFromISR(lm.txDoneSemaphore, &xHigherPriorityTaskWoken);
 
     if (xHigherPriorityTaskWoken == pdTRUE)
         portYIELD_FROM_ISR();
@@ -378,9 +667,6 @@ void LoraMesher::receivingRoutine() {
     vTaskSuspend(NULL);
 
     BaseType_t TWres;
-    size_t packetSize;
-    int8_t rssi, snr;
-    int16_t state;
 
     for (;;) {
         TWres = xTaskNotifyWait(
@@ -393,59 +679,177 @@ void LoraMesher::receivingRoutine() {
             ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
             ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
 
-            hasReceivedMessage = true;
+            receiveStep();
+        }
+    }
+}
 
-            packetSize = radio->getPacketLength();
-            if (packetSize == 0)
-                ESP_LOGW(LM_TAG, "Empty packet received");
-            else {
-                Packet<uint8_t>* rx = PacketService::createEmptyPacket(packetSize);
+void LoraMesher::receiveStep() {
+    hasReceivedMessage = true;
 
-                rssi = (int8_t)round(radio->getRSSI());
-                snr = (int8_t)round(radio->getSNR());
+    ReceivedFrame frame;
+    int16_t state = readReceivedPacket(radio, ReceivedPackets, frame);
+    if (state == RADIOLIB_ERR_SPI_WRITE_FAILED) {
+        ESP_LOGW(LM_TAG, "SPI Write failed, restarting radio");
+        restartRadio();
+    }
 
-                ESP_LOGI(LM_TAG, "Receiving LoRa packet: Size: %d bytes RSSI: %d SNR: %d", packetSize, rssi, snr);
+    //The radio listens again before the frame is decoded and published, it is only deaf while it is read
+    startReceiving();
 
-                size_t max_packet_size = PacketFactory::getMaxPacketSize();
-                if (packetSize > max_packet_size) {
-                    ESP_LOGW(LM_TAG, "Received packet with size greater than MAX Packet Size");
-                    packetSize = max_packet_size;
-                }
+    publishReceivedPacket(radio, ReceivedPackets, frame);
+}
 
-                state = radio->readData(reinterpret_cast<uint8_t*>(rx), packetSize);
+void LoraMesher::secondaryReceivingRoutine() {
+    ESP_LOGV(LM_TAG, "Secondary receiving routine started");
+    vTaskSuspend(NULL);
 
-                if (state != RADIOLIB_ERR_NONE) {
-                    ESP_LOGW(LM_TAG, "Reading packet data gave error: %d", state);
-                    if (state == RADIOLIB_ERR_SPI_WRITE_FAILED) {
-                        ESP_LOGW(LM_TAG, "SPI Write failed, restarting radio");
-                        restartRadio();
-                    }
+    BaseType_t TWres;
 
-                    // TODO: Set a count to get the number of CRC errors
-                    deletePacket(rx);
-                }
-                else if (packetSize != rx->packetSize) {
-                    ESP_LOGW(LM_TAG, "Packet size is different from the size read");
-                    deletePacket(rx);
-                }
-                else {
-                    //Create a Packet Queue element containing the Packet
-                    QueuePacket<Packet<uint8_t>>* pq = PacketQueueService::createQueuePacket(rx, 0, 0, rssi, snr);
-
-                    //Add the Packet Queue element created into the ReceivedPackets List
-                    ReceivedPackets->Append(pq);
-
-                    //Notify that a packet needs to be process
-                    TWres = xTaskNotifyFromISR(
-                        ReceiveData_TaskHandle,
-                        0,
-                        eSetValueWithoutOverwrite,
-                        &TWres);
-                }
-            }
+    for (;;) {
+        TWres = xTaskNotifyWait(
+            pdTRUE,
+            pdFALSE,
+            NULL,
+            portMAX_DELAY);
 
-            startReceiving();
-        }
+        if (TWres == pdPASS)
+            secondaryReceiveStep();
+    }
+}
+
+void LoraMesher::secondaryReceiveStep() {
+    xSemaphoreTake(secondaryRadioMutex, portMAX_DELAY);
+
+    ReceivedFrame frame;
+    int16_t state = readReceivedPacket(secondaryRadio, SecondaryReceivedPackets, frame);
+    if (state == RADIOLIB_ERR_SPI_WRITE_FAILED) {
+        ESP_LOGW(LM_TAG, "SPI Write failed, restarting secondary radio");
+        secondaryRadio->reset();
+        initializeSecondaryLoRa();
+    }
+
+    startSecondaryReceiving();
+
+    xSemaphoreGive(secondaryRadioMutex);
+
+    publishReceivedPacket(secondaryRadio, SecondaryReceivedPackets, frame);
+}
+
+int16_t LoraMesher::readReceivedPacket(LM_Module* module, LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring, ReceivedFrame& frame) {
+    size_t packetSize = module->getPacketLength();
+    if (packetSize == 0) {
+        ESP_LOGW(LM_TAG, "Empty packet received");
+        incStat(stats.rxEmptyNum);
+        return RADIOLIB_ERR_NONE;
+    }
+
+    LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>::Slot* slot = ring->acquireWrite();
+    if (slot == nullptr) {
+        ESP_LOGW(LM_TAG, "Received packets ring full, dropping packet");
+        return RADIOLIB_ERR_NONE;
+    }
+
+    frame.rssi = (int8_t)round(module->getRSSI());
+    frame.snr = (int8_t)round(module->getSNR());
+
+    size_t max_packet_size = PacketFactory::getMaxPacketSize();
+    if (packetSize > max_packet_size) {
+        ESP_LOGW(LM_TAG, "Received packet with size greater than MAX Packet Size");
+        packetSize = max_packet_size;
+    }
+
+    if (packetSize > sizeof(slot->data))
+        packetSize = sizeof(slot->data);
+
+    //Taken before the radio receives again, the next interrupt sets it
+    frame.timestamp = module == radio ? rxTimestamp : secondaryRxTimestamp;
+
+#if LM_COMPACT_HEADER
+    // Every receiving routine decodes in its own buffer
+    frame.buffer = module == radio ? rxBuffer : secondaryRxBuffer;
+#else
+    frame.buffer = slot->data;
+#endif
+    frame.state = module->readData(frame.buffer, packetSize);
+    frame.length = packetSize;
+    frame.slot = slot;
+
+    return frame.state;
+}
+
+void LoraMesher::publishReceivedPacket(LM_Module* module, LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring, ReceivedFrame& frame) {
+    if (frame.slot == nullptr)
+        return;
+
+    LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>::Slot* slot = frame.slot;
+    Packet<uint8_t>* rx = reinterpret_cast<Packet<uint8_t>*>(slot->data);
+    uint8_t* buffer = frame.buffer;
+    size_t packetSize = frame.length;
+    int16_t state = frame.state;
+
+    ESP_LOGI(LM_TAG, "Receiving LoRa packet: Size: %d bytes RSSI: %d SNR: %d", packetSize, frame.rssi, frame.snr);
+
+    if (state != RADIOLIB_ERR_NONE)
+        countReceiveError(state);
+
+    //The frame has taken the channel even if it has errors, its header gave its length
+    if (module == radio && (state == RADIOLIB_ERR_NONE || state == RADIOLIB_ERR_CRC_MISMATCH))
+        channelFrameReceived(packetSize);
+
+    //The frame as received on air, before it is decoded
+    if (CaptureService::isCapturing()) {
+        uint8_t flags = (state != RADIOLIB_ERR_NONE ? CaptureService::CAPTURE_CRC_ERROR_F : 0) |
+            (module != radio ? CaptureService::CAPTURE_SECONDARY_F : 0);
+
+        LM_CaptureRadio parameters;
+        float frequency = module == radio ? listenFrequency :
+            loraMesherConfig->secondaryFreq != 0 ? loraMesherConfig->secondaryFreq : homeFrequency;
+        parameters.frequency = (uint32_t) lroundf(frequency * 1000);
+        parameters.bandwidth = (uint16_t) lroundf(loraMesherConfig->bw * 10);
+        parameters.spreadingFactor = module == radio || loraMesherConfig->secondarySf == 0 ?
+            loraMesherConfig->sf : loraMesherConfig->secondarySf;
+        parameters.codingRate = loraMesherConfig->cr;
+
+        CaptureService::capture(buffer, packetSize, frame.rssi, frame.snr, frame.timestamp, flags, parameters);
+    }
+
+    //A sniffer does not process the frames
+    if (loraMesherConfig->sniffer)
+        return;
+
+#if LM_COMPACT_HEADER
+    //The packet size is not sent, it is given by the decoded packet
+    size_t receivedSize = packetSize;
+    if (state == RADIOLIB_ERR_NONE)
+        packetSize = CompactHeaderService::decode(buffer, receivedSize, slot->data, sizeof(slot->data));
+#endif
+
+    if (state != RADIOLIB_ERR_NONE) {
+        ESP_LOGW(LM_TAG, "Reading packet data gave error: %d", state);
+    }
+#if LM_COMPACT_HEADER
+    else if (packetSize == 0) {
+        ESP_LOGW(LM_TAG, "Malformed compact header in a packet of %d bytes", receivedSize);
+        incStat(stats.rxMalformedNum);
+    }
+#endif
+    else if (packetSize != rx->packetSize) {
+        ESP_LOGW(LM_TAG, "Packet size is different from the size read");
+        incStat(stats.rxSizeMismatchNum);
+    }
+    else {
+        //Publish the slot to the processPackets task
+        slot->length = packetSize;
+        slot->rssi = frame.rssi;
+        slot->snr = frame.snr;
+        slot->timestamp = frame.timestamp;
+        LM_HOOK(HOOK_RX_ENQUEUE, rx, module == radio ? 0 : 1);
+        ring->commitWrite();
+
+        //Notify that a packet needs to be process, the single task processes it after reading it
+        if (!Reactor_TaskHandle)
+            xTaskNotifyGive(ReceiveData_TaskHandle);
     }
 }
 
@@ -458,6 +862,11 @@ uint16_t LoraMesher::getLocalAddress() {
 **/
 
 void LoraMesher::waitBeforeSend(uint8_t repeatedDetectPreambles) {
+    if (loraMesherConfig->cadListenBeforeTalk) {
+        listenBeforeTalk();
+        return;
+    }
+
     // TODO: Why did I set this if?
     if (repeatedDetectPreambles > RoutingTableService::routingTableSize())
         return;
@@ -479,663 +888,4799 @@ void LoraMesher::waitBeforeSend(uint8_t repeatedDetectPreambles) {
     }
 }
 
-uint32_t LoraMesher::getMaxPropagationTime() {
-    return maxTimeOnAir;
-}
+bool LoraMesher::listenBeforeTalk() {
+    uint8_t maxAttempts = loraMesherConfig->cadMaxAttempts;
 
-bool LoraMesher::sendPacket(Packet<uint8_t>* p) {
-    waitBeforeSend(1);
+    for (uint8_t attempt = 0; attempt < maxAttempts; attempt++) {
+        hasReceivedMessage = false;
 
-    clearDioActions();
+        uint32_t backoff = getBackoffTime(attempt);
 
-    // Print the packet to be sent
-    printHeaderPacket(p, "send");
+        ESP_LOGV(LM_TAG, "Backoff %d ms, attempt %d", (int)backoff, attempt);
 
-    //Blocking transmit, it is necessary due to deleting the packet after sending it. 
-    int resT = radio->transmit(reinterpret_cast<uint8_t*>(p), p->packetSize);
+        vTaskDelay(backoff / portTICK_PERIOD_MS);
 
-    //Start receiving again after sending a packet
-    startReceiving();
+        // A packet received during the backoff means that the channel is busy, it does not need a scan
+        if (!hasReceivedMessage && !channelScan())
+            return true;
 
-    if (resT != RADIOLIB_ERR_NONE) {
-        ESP_LOGE(LM_TAG, "Transmit gave error: %d", resT);
-        return false;
+        incChannelBusy();
+        ESP_LOGV(LM_TAG, "Channel busy, attempt %d", attempt);
     }
-    return true;
+
+    ESP_LOGW(LM_TAG, "Channel busy after %d attempts, sending anyway", maxAttempts);
+    return false;
 }
 
-void LoraMesher::sendPackets() {
-    ESP_LOGV(LM_TAG, "Send routine started");
-    vTaskSuspend(NULL);
+uint32_t LoraMesher::getBackoffTime(uint8_t attempt) {
+    uint8_t exponent = attempt < LM_CAD_MAX_BACKOFF_EXPONENT ? attempt : LM_CAD_MAX_BACKOFF_EXPONENT;
 
-    int sendCounter = 0;
-    uint8_t sendId = 0;
-    uint8_t resendMessage = 0;
+    // The contention window starts at the time on air of the biggest packet and doubles after every busy channel
+    uint32_t window = (getMaxPropagationTime() + LM_CAD_BACKOFF_SLOT) << exponent;
+    return random(0, window + 1);
+}
 
-#ifdef ARDUINO
-    randomSeed(getLocalAddress());
-#else
-    srand(getLocalAddress());
-#endif
-    const uint8_t dutyCycleEvery = (100 - LM_DUTY_CYCLE) / portTICK_PERIOD_MS;
-
-    for (;;) {
-        /* Wait for the notification of new packet has to be sent and enter blocking */
-        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
-
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+uint32_t LoraMesher::getMaxPropagationTime() {
+    return maxTimeOnAir;
+}
 
-        while (ToSendPackets->getLength() > 0) {
+uint16_t LoraMesher::getTransmissionNextHop(Packet<uint8_t>* p) {
+    if (p->dst == BROADCAST_ADDR)
+        return 0;
 
-            ToSendPackets->setInUse();
+    if (PacketService::isAggregatePacket(p->type))
+        return p->dst;
 
-            ESP_LOGI(LM_TAG, "Size of Send Packets Queue: %d", ToSendPackets->getLength());
+    if (PacketService::isDataPacket(p->type))
+        return PacketService::dataPacket(p)->via;
 
-            QueuePacket<Packet<uint8_t>>* tx = ToSendPackets->Pop();
+    return 0;
+}
 
-            ToSendPackets->releaseInUse();
+float LoraMesher::getHomeFrequency(uint16_t address) {
+    uint8_t channels = loraMesherConfig->channelPlanSize;
+    if (channels == 0)
+        return loraMesherConfig->freq;
 
-            if (tx) {
-                ESP_LOGV(LM_TAG, "Send n. %d", sendCounter);
+    // Mix the address, the consecutive addresses of the same vendor would share the low bits
+    uint32_t hash = ((uint32_t) address * 2654435761u) >> 16;
+    return loraMesherConfig->channelPlan[hash % channels];
+}
 
-                if (tx->packet->src == getLocalAddress())
-                    tx->packet->id = sendId++;
+float LoraMesher::getTransmissionFrequency(QueuePacket<Packet<uint8_t>>* qp) {
+    if (loraMesherConfig->channelPlanSize <= 1)
+        return homeFrequency;
 
-                //If the packet has a data packet and its destination is not broadcast add the via to the packet and forward the packet
-                if (PacketService::isDataPacket(tx->packet->type) && tx->packet->dst != BROADCAST_ADDR) {
-                    uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
+    if (qp->channel != 0)
+        return loraMesherConfig->channelPlan[qp->channel - 1];
 
-                    //Next hop not found
-                    if (nextHop == 0) {
-                        ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X", tx->packet->src, tx->packet->dst);
-                        PacketQueueService::deleteQueuePacketAndPacket(tx);
-                        incDestinyUnreachable();
-                        continue;
-                    }
+    uint16_t nextHop = getTransmissionNextHop(qp->packet);
+    if (nextHop == 0)
+        return homeFrequency;
 
-                    (reinterpret_cast<DataPacket*>(tx->packet))->via = nextHop;
-                }
+    return getHomeFrequency(nextHop);
+}
 
-                recordState(LM_StateType::STATE_TYPE_SENT, tx->packet);
+void LoraMesher::addBroadcastChannelCopies(QueuePacket<Packet<uint8_t>>* qp) {
+    uint8_t channels = loraMesherConfig->channelPlanSize;
+    if (channels <= 1 || qp->channel != 0 || qp->backbone)
+        return;
 
-                //Send packet
-                bool hasSend = sendPacket(tx->packet);
+    qp->channel = 1;
 
-                sendCounter++;
+    for (uint8_t channel = 2; channel <= channels; channel++) {
+        Packet<uint8_t>* copy = PacketService::copyPacket(qp->packet, qp->packet->packetSize);
+        if (copy == nullptr) {
+            ESP_LOGE(LM_TAG, "Not enough memory to send the broadcast on channel %d", channel);
+            return;
+        }
 
-                if (hasSend) {
-                    incSendPackets();
-                    incSentPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(tx->packet));
-                    incSentControlBytes(PacketService::getControlLength(tx->packet));
-                    if (tx->packet->src != getLocalAddress())
-                        incForwardedPackets();
-                }
+        QueuePacket<Packet<uint8_t>>* copyQp = PacketQueueService::createQueuePacket(copy, qp->priority);
+        copyQp->channel = channel;
+        copyQp->deadline = qp->deadline;
+        PacketQueueService::addOrdered(ToSendPackets, copyQp);
+    }
+}
 
-                //TODO: If the packet has not been send, add it to the queue and send it again
-                if (!hasSend && resendMessage < MAX_RESEND_PACKET) {
-                    tx->priority = MAX_PRIORITY;
-                    PacketQueueService::addOrdered(ToSendPackets, tx);
+void LoraMesher::addBackboneHelloCopy(QueuePacket<Packet<uint8_t>>* qp) {
+    // Once, from the HELLO before its copies on the channel plan
+    if (!BackboneService::isEnabled() || qp->backbone || qp->channel != 0)
+        return;
 
-                    resendMessage++;
-                    continue;
-                }
+    Packet<uint8_t>* copy = PacketService::copyPacket(qp->packet, qp->packet->packetSize);
+    if (copy == nullptr) {
+        ESP_LOGE(LM_TAG, "Not enough memory to send the HELLO on the backbone");
+        return;
+    }
 
-                resendMessage = 0;
+    QueuePacket<Packet<uint8_t>>* copyQp = PacketQueueService::createQueuePacket(copy, qp->priority);
+    copyQp->backbone = true;
+    copyQp->deadline = qp->deadline;
+    PacketQueueService::addOrdered(ToSendPackets, copyQp);
+}
 
-                uint32_t timeOnAir = radio->getTimeOnAir(tx->packet->packetSize) / 1000;
+bool LoraMesher::isBackboneFrame(QueuePacket<Packet<uint8_t>>* tx) {
+    return tx->backbone || BackboneService::isLink(getTransmissionNextHop(tx->packet));
+}
 
-                TickType_t delayBetweenSend = timeOnAir * dutyCycleEvery;
+void LoraMesher::sendBackbone(QueuePacket<Packet<uint8_t>>* tx) {
+    Packet<uint8_t>* p = tx->packet;
+    uint16_t nextHop = getTransmissionNextHop(p);
 
-                ESP_LOGV(LM_TAG, "TimeOnAir %d ms, next message in %d ms", (int)timeOnAir, (int)delayBetweenSend);
+    printHeaderPacket(p, "send on the backbone");
+    LM_HOOK(HOOK_TX_START, p, p->packetSize);
 
-                PacketQueueService::deleteQueuePacketAndPacket(tx);
+    xSemaphoreTake(secondaryRadioMutex, portMAX_DELAY);
+    secondaryRadio->clearDioActions();
 
-                vTaskDelay(delayBetweenSend / portTICK_PERIOD_MS);
-            }
-        }
-    }
-}
+    //The trailers of the HELLO copies are not stamped, the receivers only take the backbone link from them
+#if LM_COMPACT_HEADER
+    size_t length = CompactHeaderService::encode(p, backboneTxBuffer, PacketFactory::getMaxPacketSize());
+    int res = length != 0 ? secondaryRadio->transmit(backboneTxBuffer, length) : RADIOLIB_ERR_PACKET_TOO_LONG;
+#else
+    int res = secondaryRadio->transmit(reinterpret_cast<uint8_t*>(p), p->packetSize);
+#endif
 
-void LoraMesher::sendHelloPacket() {
-    ESP_LOGV(LM_TAG, "Send Hello Packet routine started");
+    startSecondaryReceiving();
+    xSemaphoreGive(secondaryRadioMutex);
 
-    vTaskSuspend(NULL);
+    LM_HOOK(HOOK_TX_END, p, res == RADIOLIB_ERR_NONE ? 1 : 0);
 
-    size_t maxNodesPerPacket = (PacketFactory::getMaxPacketSize() - sizeof(RoutePacket)) / sizeof(NetworkNode);
+    if (res == RADIOLIB_ERR_NONE) {
+        incStat(stats.backboneSentNum);
+        countSent(p);
 
-    ESP_LOGV(LM_TAG, "Max routing nodes per packet: %d", maxNodesPerPacket);
+        if (!waitHopAck(tx))
+            PacketQueueService::deleteQueuePacketAndPacket(tx);
+        return;
+    }
 
-    //Wait an initial 2 second
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
+    incStat(stats.backboneFailedNum);
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Creating Routing Packet");
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+    if (tx->backbone) {
+        ESP_LOGW(LM_TAG, "Send of the HELLO on the backbone gave error: %d", res);
+        PacketQueueService::deleteQueuePacketAndPacket(tx);
+        return;
+    }
 
-        incSentHelloPackets();
+    ESP_LOGW(LM_TAG, "Send on the backbone to %X gave error: %d, sending on LoRa", nextHop, res);
+    BackboneService::lost(nextHop);
+    PacketQueueService::addOrdered(ToSendPackets, tx);
+}
 
-        NetworkNode* nodes = RoutingTableService::getAllNetworkNodes();
-        size_t numOfNodes = RoutingTableService::routingTableSize();
+size_t LoraMesher::getMulticastNextHops(Packet<uint8_t>* p, uint16_t* nextHops, uint8_t* hopsLeft) {
+    uint16_t exclude = p->src == getLocalAddress() ? 0 : p->src;
+    return RoutingTableService::getMulticastNextHops(RoleService::getAddressRole(p->dst), exclude,
+        getHopsLeft(p), nextHops, hopsLeft);
+}
 
-        size_t numPackets = (numOfNodes + maxNodesPerPacket - 1) / maxNodesPerPacket;
-        numPackets = (numPackets == 0) ? 1 : numPackets;
+uint8_t& LoraMesher::getHopsLeft(Packet<uint8_t>* p) {
+    return p->payload[p->packetSize - sizeof(Packet<uint8_t>) - 1];
+}
 
-        for (size_t i = 0; i < numPackets; ++i) {
-            size_t startIndex = i * maxNodesPerPacket;
-            size_t endIndex = startIndex + maxNodesPerPacket;
-            if (endIndex > numOfNodes) {
-                endIndex = numOfNodes;
-            }
+bool LoraMesher::addMulticastBranchCopies(QueuePacket<Packet<uint8_t>>* qp) {
+    // A copy, its next hop is already set
+    if (qp->branch != 0)
+        return true;
 
-            size_t nodesInThisPacket = endIndex - startIndex;
+    uint16_t nextHops[LM_MULTICAST_MAX_BRANCHES];
+    uint8_t hopsLeft[LM_MULTICAST_MAX_BRANCHES];
+    size_t branches = getMulticastNextHops(qp->packet, nextHops, hopsLeft);
+    if (branches == 0)
+        return false;
 
-            // Create and send the packet
-            RoutePacket* tx = PacketService::createRoutingPacket(
-                getLocalAddress(), &nodes[startIndex], nodesInThisPacket, RoleService::getRole()
-            );
+    qp->branch = 1;
+    PacketService::dataPacket(qp->packet)->via = nextHops[0];
+    getHopsLeft(qp->packet) = hopsLeft[0];
 
-            setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), DEFAULT_PRIORITY + 4);
+    for (size_t i = 1; i < branches; i++) {
+        Packet<uint8_t>* copy = PacketService::copyPacket(qp->packet, qp->packet->packetSize);
+        if (copy == nullptr) {
+            ESP_LOGE(LM_TAG, "Not enough memory to send the multicast packet to %X", nextHops[i]);
+            break;
         }
 
-        // Delete the nodes array
-        if (numOfNodes > 0)
-            delete[] nodes;
+        PacketService::dataPacket(copy)->via = nextHops[i];
+        getHopsLeft(copy) = hopsLeft[i];
 
-        // Wait for HELLO_PACKETS_DELAY seconds to send the next hello packet
-        vTaskDelay(HELLO_PACKETS_DELAY * 1000 / portTICK_PERIOD_MS);
+        QueuePacket<Packet<uint8_t>>* copyQp = PacketQueueService::createQueuePacket(copy, qp->priority);
+        copyQp->branch = i + 1;
+        copyQp->deadline = qp->deadline;
+        PacketQueueService::addOrdered(ToSendPackets, copyQp);
     }
+
+    return true;
 }
 
-void LoraMesher::processPackets() {
-    ESP_LOGV(LM_TAG, "Process routine started");
-    vTaskSuspend(NULL);
+int8_t LoraMesher::getLinkPower(Packet<uint8_t>* p) {
+    int8_t power = loraMesherConfig->power;
+    if (!loraMesherConfig->adaptiveLinkPower)
+        return power;
+
+    uint16_t nextHop = getTransmissionNextHop(p);
+    if (nextHop == 0)
+        return power;
+
+    // The SNR the neighbour reports for the route packets of the node, sent at the configured power. Until it reports one
+    // the link is considered symmetric
+    int8_t snr;
+    if (!RoutingTableService::getNeighborSentSNR(nextHop, snr) && !RoutingTableService::getNeighborMinSNR(nextHop, snr))
+        return power;
+
+    // Demodulation floor in tenths of dB, -7.5 dB at SF7 and 2.5 dB lower for every spreading factor
+    int16_t floor = -25 * ((int16_t) loraMesherConfig->sf - 4);
+    int16_t reduction = (snr * 10 - floor - LM_ADR_MARGIN * 10) / 10;
+    if (reduction <= 0)
+        return power;
+
+    int8_t minPower = power < LM_ADR_MIN_POWER ? power : LM_ADR_MIN_POWER;
+    return power - reduction < minPower ? minPower : power - reduction;
+}
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+void LoraMesher::setLinkPower(Packet<uint8_t>* p) {
+    int8_t power = getLinkPower(p);
+    if (power == currentTxPower)
+        return;
 
-        /* Wait for the notification of receivingRoutine and enter blocking */
-        ulTaskNotifyTake(pdPASS, portMAX_DELAY);
+    int res = radio->setOutputPower(power);
+    if (res != RADIOLIB_ERR_NONE) {
+        ESP_LOGE(LM_TAG, "Set output power %d gave error: %d", power, res);
+        return;
+    }
 
-        ESP_LOGV(LM_TAG, "Size of Received Packets Queue: %d", ReceivedPackets->getLength());
+    ESP_LOGV(LM_TAG, "Output power %d dBm to %X", power, p->dst);
+    currentTxPower = power;
+}
 
-        while (ReceivedPackets->getLength() > 0) {
-            QueuePacket<Packet<uint8_t>>* rx = ReceivedPackets->Pop();
+void LoraMesher::setLinkPreamble(Packet<uint8_t>* p) {
+    uint16_t preambleLength = SniffService::getLinkPreambleLength(getTransmissionNextHop(p), loraMesherConfig->preambleLength);
+    if (preambleLength == currentPreambleLength)
+        return;
 
-            if (rx) {
-                uint8_t type = rx->packet->type;
+    int res = radio->setPreambleLength(preambleLength);
+    if (res != RADIOLIB_ERR_NONE) {
+        ESP_LOGE(LM_TAG, "Set preamble length %d gave error: %d", preambleLength, res);
+        return;
+    }
 
-#ifdef LM_TESTING
-                if (!shouldProcessPacket(rx->packet)) {
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                    ESP_LOGV(LM_TAG, "TESTING: Packet not for me, deleting it");
-                    continue;
-                }
-#endif
+    ESP_LOGV(LM_TAG, "Preamble of %d symbols to %X", preambleLength, p->dst);
+    currentPreambleLength = preambleLength;
+}
 
-                printHeaderPacket(rx->packet, "received");
+bool LoraMesher::startSendPacket(Packet<uint8_t>* p, float frequency, uint32_t takenAt) {
+    // Listen on the channel of the packet while waiting, the channel is sensed before sending
+    listenFrequency = frequency;
+    if (listenFrequency != currentFrequency)
+        startReceiving();
 
+    // The slots of the node are free within two hops, the channel is not sensed
+    if (waitTdmaSlot(p)) {
+        LM_HOOK(HOOK_BACKOFF_START, p, 0);
+        LM_HOOK(HOOK_BACKOFF_END, p, 0);
+        HopTraceService::endHop(p, millis() - takenAt, 0);
+        return startTransmission(p);
+    }
 
-                recordState(LM_StateType::STATE_TYPE_RECEIVED, rx->packet);
+    uint32_t backoffStart = millis();
+    LM_HOOK(HOOK_BACKOFF_START, p, 0);
+    waitBeforeSend(1);
+    uint32_t backoff = millis() - backoffStart;
+    LM_HOOK(HOOK_BACKOFF_END, p, backoff);
+    recordStat(stats.backoff, backoff);
 
-                incReceivedPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(rx->packet));
-                incReceivedControlBytes(PacketService::getControlLength(rx->packet));
+    HopTraceService::endHop(p, backoffStart - takenAt, backoff);
+    return startTransmission(p);
+}
 
-                if (PacketService::isHelloPacket(type)) {
-                    incRecHelloPackets();
+bool LoraMesher::waitTdmaSlot(Packet<uint8_t>* p) {
+    if (!TdmaService::isEnabled())
+        return false;
 
-                    RoutingTableService::processRoute(reinterpret_cast<RoutePacket*>(rx->packet), rx->snr);
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                }
-                else if (PacketService::isDataPacket(type))
-                    processDataPacket(reinterpret_cast<QueuePacket<DataPacket>*>(rx));
-                else {
-                    ESP_LOGV(LM_TAG, "Packet not identified, deleting it");
-                    incReceivedNotForMe();
-                    PacketQueueService::deleteQueuePacketAndPacket(rx);
-                }
-            }
+    uint32_t timeOnAir = AirtimeService::getTimeOnAirMs(p->packetSize);
+
+    for (;;) {
+        int32_t wait = TdmaService::getTransmitWait(timeOnAir);
+        if (wait < 0)
+            return false;
+
+        if (wait == 0) {
+            incStat(stats.tdmaSlotSendsNum);
+            return true;
         }
+
+        vTaskDelay(wait / portTICK_PERIOD_MS);
     }
 }
 
-void LoraMesher::routingTableManager() {
-    ESP_LOGV(LM_TAG, "Routing Table Manager routine started");
-    vTaskSuspend(NULL);
+void LoraMesher::initTdma() {
+    uint8_t slots = loraMesherConfig->tdmaSlots;
+    if (slots != 0 && !loraMesherConfig->timeSync) {
+        ESP_LOGW(LM_TAG, "TDMA mode without timeSync, the packets are sent with the random backoff");
+        slots = 0;
+    }
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+    TdmaService::init(slots);
+}
 
-        // TODO: If the routing table removes a node, remove the nodes from the Q_WSP and Q_WRP
-        ESP_LOGI(LM_TAG, "Checking routes timeout");
+bool LoraMesher::startTransmission(Packet<uint8_t>* p) {
+    // Other nodes have rebroadcast it during the backoff, completeSend deletes it
+    if (isFloodSuppressed(p)) {
+        ESP_LOGV(LM_TAG, "Rebroadcast of the flooded packet %d from %X suppressed", p->id, p->src);
+        return false;
+    }
 
-        RoutingTableService::routingTableList->setInUse();
+    clearDioActions();
 
-        if (RoutingTableService::routingTableList->moveToStart()) {
-            do {
-                RouteNode* node = RoutingTableService::routingTableList->getCurrent();
+    setLinkPower(p);
+    setLinkPreamble(p);
 
-                if (node->timeout < millis()) {
-                    ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
-                    removeNodeFromQSPandQWP(node->networkNode.address);
+    // Print the packet to be sent
+    printHeaderPacket(p, "send");
+    LM_TRACE(LM_TRACE_TX, 1, TRACE_SEND, p->src, p->dst, p->id, (uint32_t) p->type << 8 | (p->packetSize & 0xFF));
+    LM_HOOK(HOOK_TX_START, p, p->packetSize);
 
-                    delete node;
-                    RoutingTableService::routingTableList->DeleteCurrent();
-                }
+    // Remove a transmission done given after a previous timeout
+    xSemaphoreTake(txDoneSemaphore, 0);
 
-            } while (RoutingTableService::routingTableList->next());
-        }
+    radio->setDioActionForTransmitting(onTransmitDone);
 
-        RoutingTableService::routingTableList->releaseInUse();
+#if LM_COMPACT_HEADER
+    size_t length = CompactHeaderService::encode(p, txBuffer, PacketFactory::getMaxPacketSize());
+    if (length == 0) {
+        ESP_LOGE(LM_TAG, "Packet of %d bytes does not fit with the compact header", p->packetSize);
+        startReceiving();
+        return false;
+    }
 
-        RoutingTableService::printRoutingTable();
+    //The trailers end the payload, they are copied as is after the compact header
+    size_t trailerLength = stampRouteTrailers(p, length);
+    if (trailerLength != 0)
+        memcpy(txBuffer + length - trailerLength, reinterpret_cast<uint8_t*>(p) + p->packetSize - trailerLength, trailerLength);
 
-        // Record the state for the simulation
-        recordState(LM_StateType::STATE_TYPE_MANAGER);
+    //Non blocking transmit, the txBuffer cannot be reused until waitPacketSent returns
+    txStartedAt = millis();
+    int resT = radio->startTransmit(txBuffer, length);
+#else
+    stampRouteTrailers(p, p->packetSize);
+
+    //Non blocking transmit, the packet cannot be deleted until waitPacketSent returns
+    txStartedAt = millis();
+    int resT = radio->startTransmit(reinterpret_cast<uint8_t*>(p), p->packetSize);
+#endif
 
-        // if (q_WRP->getLength() != 0 || q_WSP->getLength() != 0) {
-        //     vTaskDelay(randomDelay * 1000 / portTICK_PERIOD_MS);
-        //     continue;
-        // }
+    if (resT != RADIOLIB_ERR_NONE) {
+        ESP_LOGE(LM_TAG, "Start transmit gave error: %d", resT);
 
-        vTaskDelay(DEFAULT_TIMEOUT * 1000 / portTICK_PERIOD_MS);
+        //Start receiving again after a failed transmission
+        startReceiving();
+        return false;
     }
+    return true;
 }
 
-void LoraMesher::queueManager() {
-    ESP_LOGV(LM_TAG, "Queue Manager routine started");
-    vTaskSuspend(NULL);
+size_t LoraMesher::stampRouteTrailers(Packet<uint8_t>* p, size_t length) {
+    if (!PacketService::isHelloPacket(p->type))
+        return 0;
 
-    for (;;) {
-        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
-        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+    RoutePacket* routePacket = reinterpret_cast<RoutePacket*>(p);
 
-        // Record the state for the simulation
-        recordState(LM_StateType::STATE_TYPE_MANAGER);
+    SniffTrailer* sniff = routePacket->getSniff();
+    if (sniff != nullptr)
+        SniffService::fill(sniff);
 
-        if (q_WSP->getLength() == 0 && q_WRP->getLength() == 0) {
-            ESP_LOGV(LM_TAG, "No packets to send or received");
+    LinkSnrTrailer* linkSnr = routePacket->getLinkSnr();
+    if (linkSnr != nullptr)
+        RoutingTableService::fillLinkSnr(linkSnr);
 
-            // Wait for the notification of send or receive reliable message and enter blocking
-            ulTaskNotifyTake(
-                pdTRUE,
-                portMAX_DELAY);
-            continue;
-        }
+    TdmaTrailer* tdma = routePacket->getTdma();
+    if (tdma != nullptr)
+        TdmaService::fill(tdma);
 
-        managerReceivedQueue();
-        managerSendQueue();
+    CongestionTrailer* congestion = routePacket->getCongestion();
+    if (congestion != nullptr) {
+        uint8_t queue, airtime;
+        getLocalCongestion(queue, airtime);
+        CongestionService::fill(congestion, queue, airtime);
+    }
+
+    // The record of the node when it is due, else one waiting to be relayed
+    TelemetryTrailer* telemetry = routePacket->getTelemetry();
+    if (telemetry != nullptr) {
+        TelemetryRecord own;
+        bool ownDue = TelemetryService::isOwnDue();
+        if (ownDue) {
+            auto clampTelemetry = [](uint32_t value) { return (uint16_t) (value > UINT16_MAX ? UINT16_MAX : value); };
+            own.sent = clampTelemetry(stats.sendPacketsNum);
+            own.forwarded = clampTelemetry(stats.forwardedPacketsNum);
+            own.unreachable = clampTelemetry(stats.sendPacketDestinyUnreachableNum);
+            own.freeHeap = clampTelemetry(getFreeHeap() / 1024);
+            size_t sendQueue = ToSendPackets->getLength();
+            size_t receivedQueue = ReceivedAppPackets->getLength();
+            own.sendQueue = sendQueue > UINT8_MAX ? UINT8_MAX : sendQueue;
+            own.receivedQueue = receivedQueue > UINT8_MAX ? UINT8_MAX : receivedQueue;
+        }
 
-        // TODO: Calculate the min timeout for the queue manager, get the min timeout from the queues
-        vTaskDelay(MIN_TIMEOUT * 1000 / portTICK_PERIOD_MS);
+        TelemetryService::fill(telemetry, getGatewayHops(), ownDue ? &own : nullptr, stats.timeOnAir.sum);
     }
+
+    // The time when the frame ends, when the receivers take their time
+    TimeSyncTrailer* timeSync = routePacket->getTimeSync();
+    if (timeSync != nullptr && !TimeSyncService::stamp(timeSync, AirtimeService::getTimeOnAir(length, currentPreambleLength)))
+        memset(timeSync, 0, sizeof(TimeSyncTrailer));
+
+    return sniff != nullptr || linkSnr != nullptr || tdma != nullptr || congestion != nullptr || telemetry != nullptr || timeSync != nullptr ?
+        routePacket->getTrailerLength() : 0;
 }
 
-void LoraMesher::printHeaderPacket(Packet<uint8_t>* p, String title) {
-    bool isDataPacket = PacketService::isDataPacket(p->type);
-    bool isControlPacket = PacketService::isControlPacket(p->type);
+bool LoraMesher::waitPacketSent(Packet<uint8_t>* p) {
+    uint32_t timeout = getTransmissionTimeout(p);
 
-    ESP_LOGI(LM_TAG, "Packet %s -- Size: %d Src: %X Dst: %X Id: %d Type: %d Via: %X Seq_Id: %d Num: %d",
-        title.c_str(),
-        p->packetSize,
-        p->src,
-        p->dst,
-        p->id,
-        p->type,
-        isDataPacket ? (reinterpret_cast<DataPacket*>(p))->via : 0,
-        isControlPacket ? (reinterpret_cast<ControlPacket*>(p))->seq_id : 0,
-        isControlPacket ? (reinterpret_cast<ControlPacket*>(p))->number : 0);
+    bool done = xSemaphoreTake(txDoneSemaphore, timeout / portTICK_PERIOD_MS) == pdTRUE;
+    if (!done)
+        ESP_LOGE(LM_TAG, "Transmit done not received after %d ms", (int)timeout);
+
+    bool sent = finishTransmission(done);
+    LM_HOOK(HOOK_TX_END, p, sent ? 1 : 0);
+    return sent;
 }
 
-void LoraMesher::sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize) {
-    // Cannot send an empty packet
-    if (payloadSize == 0)
-        return;
-    if (dst == BROADCAST_ADDR) {
-        ESP_LOGW(LM_TAG, "Be aware of sending a reliable packet to the broadcast address");
-        size_t numOfNodes = RoutingTableService::routingTableSize();
-        if (numOfNodes > 0) {
-            NetworkNode* nodes = RoutingTableService::getAllNetworkNodes();
-            for (size_t i = 0; i < numOfNodes; i++) {
-                NetworkNode* node = &nodes[i];
-                sendReliablePacket(node->address, payload, payloadSize);
-            }
-            delete[] nodes;
-        }
-        return;
-    }
-    ESP_LOGV(LM_TAG, "Sending reliable payload with %d bytes to %X", (int)payloadSize, dst);
+uint32_t LoraMesher::getTransmissionTimeout(Packet<uint8_t>* p) {
+    return getFrameTimeOnAirMs(p->packetSize) * 2 + LM_TX_DONE_TIMEOUT_MARGIN;
+}
 
-    // Get the Routing Table node of the destination
-    RouteNode* node = RoutingTableService::findNode(dst);
+bool LoraMesher::finishTransmission(bool done) {
+    int resT = radio->finishTransmit();
 
-    if (node == NULL) {
-        ESP_LOGV(LM_TAG, "Destination not found in the routing table");
-        return;
+    //Start receiving again after sending a packet, on the home channel
+    listenFrequency = homeFrequency;
+    startReceiving();
+    incStat(stats.rxDeafTime, millis() - txStartedAt);
+
+    if (resT != RADIOLIB_ERR_NONE) {
+        ESP_LOGE(LM_TAG, "Finish transmit gave error: %d", resT);
+        return false;
     }
+    return done;
+}
 
-    //Generate a sequence Id for this list of packets
-    uint8_t seq_id = getSequenceId();
+QueuePacket<Packet<uint8_t>>* LoraMesher::popAndPreparePacket(uint8_t& sendId) {
+    while (ToSendPackets->getLength() > 0) {
+        ToSendPackets->setInUse();
 
-    //Get the Type of the packet
-    uint8_t type = NEED_ACK_P | XL_DATA_P;
+        ESP_LOGI(LM_TAG, "Size of Send Packets Queue: %d", ToSendPackets->getLength());
 
-    //Max payload size per packet
-    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
+        QueuePacket<Packet<uint8_t>>* tx = ToSendPackets->Pop();
 
-    //Number of packets
-    uint16_t numOfPackets = payloadSize / maxPayloadSize + (payloadSize % maxPayloadSize > 0);
+        ToSendPackets->releaseInUse();
 
-    //Create a new Linked list to store the QueuePackets and the payload
-    LM_LinkedList<QueuePacket<ControlPacket>>* packetList = new LM_LinkedList<QueuePacket<ControlPacket>>();
+        if (!tx)
+            continue;
 
-    //Add the SYNC configuration packet
-    packetList->Append(getStartSequencePacketQueue(dst, seq_id, numOfPackets));
+        // The duplicates cache may have forgotten it, a late rebroadcast would be received again as a new packet
+        if (tx->packet->dst == LM_FLOOD_ADDRESS && tx->packet->src != getLocalAddress() && tx->enqueuedAt != 0 &&
+            millis() - tx->enqueuedAt > LM_FLOOD_MAX_WAIT * 1000) {
+            ESP_LOGW(LM_TAG, "Rebroadcast of the flooded packet %d from %X expired in the queue", tx->packet->id, tx->packet->src);
+            recordSendQueueWait(tx);
+            incFloodSuppressed();
+            PacketQueueService::deleteQueuePacketAndPacket(tx);
+            continue;
+        }
 
+        if (isExpired(tx)) {
+            ESP_LOGW(LM_TAG, "Packet %d to %X expired in the send queue", tx->packet->id, tx->packet->dst);
+            LM_TRACE(LM_TRACE_QUEUE, 2, TRACE_QUEUE_DROP, tx->packet->src, tx->packet->dst, tx->packet->id, 0);
+            recordSendQueueWait(tx);
+            incSendQueueExpired();
+            PacketQueueService::deleteQueuePacketAndPacket(tx);
+            continue;
+        }
 
-    for (uint16_t i = 1; i <= numOfPackets; i++) {
-        //Get the position of the payload
-        uint8_t* payloadToSend = reinterpret_cast<uint8_t*>((unsigned long)payload + ((i - 1) * maxPayloadSize));
+        uint32_t queueWait = recordSendQueueWait(tx);
+        LM_HOOK(HOOK_SEND_DEQUEUE, tx->packet, queueWait);
 
-        //Get the payload Size in bytes
-        size_t payloadSizeToSend = maxPayloadSize;
-        if (i == numOfPackets)
-            payloadSizeToSend = payloadSize - (maxPayloadSize * (numOfPackets - 1));
+        // The copies of a broadcast on the other channels and of a multicast to the other next hops keep its id, like the retransmissions
+        if (tx->packet->src == getLocalAddress() && tx->channel == 0 && tx->branch == 0 && tx->hopAttempts == 0)
+            tx->packet->id = sendId++;
 
-        ESP_LOGV(LM_TAG, "Payload Size: %d", payloadSizeToSend);
+        if (PacketService::isHelloPacket(tx->packet->type))
+            addBackboneHelloCopy(tx);
 
-        //Create a new packet with the previous payload
-        ControlPacket* cPacket = PacketService::createControlPacket(dst, getLocalAddress(), type, payloadToSend, payloadSizeToSend);
-        cPacket->number = i;
-        cPacket->seq_id = seq_id;
+        if (tx->packet->dst == BROADCAST_ADDR || tx->packet->dst == LM_FLOOD_ADDRESS)
+            addBroadcastChannelCopies(tx);
 
-        //Create a packet queue
-        QueuePacket<ControlPacket>* pq = PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, i);
+        if (PacketService::isDataPacket(tx->packet->type) && RoleService::isMulticastAddress(tx->packet->dst)) {
+            if (!addMulticastBranchCopies(tx)) {
+                ESP_LOGW(LM_TAG, "No next hop to the multicast group %X", tx->packet->dst);
+                PacketQueueService::deleteQueuePacketAndPacket(tx);
+                incDestinyUnreachable();
+                continue;
+            }
 
-        //Append the packet queue in the linked list
-        packetList->Append(pq);
-    }
+            return tx;
+        }
 
-    //Create the pair of configuration
-    listConfiguration* listConfig = new listConfiguration();
-    listConfig->config = new sequencePacketConfig(seq_id, dst, numOfPackets, node);
-    listConfig->list = packetList;
+        //If the packet has a data packet and its destination is not broadcast add the via to the packet and forward the packet
+        //The hop ACKs keep the address of their sender as via
+        if (PacketService::isDataPacket(tx->packet->type) && tx->packet->dst != BROADCAST_ADDR && tx->packet->dst != LM_FLOOD_ADDRESS &&
+            !isHopAckPacket(tx->packet)) {
+            uint16_t nextHop = RoutingTableService::getNextHop(tx->packet->dst);
+
+            //Next hop not found
+            if (nextHop == 0) {
+                // The route is discovered by the queue manager
+                if (loraMesherConfig->reactiveRoutes && RouteDiscoveryService::hold(tx)) {
+                    notifyNewSequenceStarted();
+                    continue;
+                }
 
-    // Set the RTT of the first packet of the sequence
-    listConfig->config->calculatingRTT = millis();
+                ESP_LOGE(LM_TAG, "NextHop Not found from %X, destination %X", tx->packet->src, tx->packet->dst);
+                if (!spoolPacket(tx))
+                    incDestinyUnreachable();
+                PacketQueueService::deleteQueuePacketAndPacket(tx);
+                continue;
+            }
 
-    // Set the timeout of the first packet of the sequence
-    addTimeout(listConfig->config);
+            (reinterpret_cast<DataPacket*>(tx->packet))->via = nextHop;
 
-    //Add dataList pair to the waiting send packets queue
-    q_WSP->setInUse();
-    q_WSP->Append(listConfig);
-    q_WSP->releaseInUse();
+            // The traced packets are sent alone, every hop appends its record
+            if (PacketService::isTracedPacket(tx->packet->type)) {
+                tx->packet = HopTraceService::startHop(tx->packet, queueWait);
+                return tx;
+            }
+
+            if ((loraMesherConfig->aggregateDataPackets || loraMesherConfig->delayedAck != 0) && !loraMesherConfig->hopAck &&
+                PacketService::isOnlyDataPacket(tx->packet->type))
+                return aggregatePackets(tx, nextHop, sendId);
+        }
 
-    //Send the first packet of the sequence (SYNC packet)
-    sendPacketSequence(listConfig, 0);
+        return tx;
+    }
 
-    // Notify the queueManager that a new sequence has been started
-    notifyNewSequenceStarted();
+    return nullptr;
 }
 
-void LoraMesher::processDataPacket(QueuePacket<DataPacket>* pq) {
-    DataPacket* packet = pq->packet;
+void LoraMesher::purgeSendFlow(uint16_t nextHop) {
+    //Packets with another route to their destination, in order, added again once the flow is removed
+    QueuePacket<Packet<uint8_t>>* moved = nullptr;
+    QueuePacket<Packet<uint8_t>>* movedTail = nullptr;
 
-    incReceivedDataPackets();
+    ToSendPackets->setInUse();
 
-    ESP_LOGI(LM_TAG, "Data packet from %X, destination %X, via %X", packet->src, packet->dst, packet->via);
+    size_t removed = ToSendPackets->RemoveFlow(nextHop, [this, &moved, &movedTail](QueuePacket<Packet<uint8_t>>* qp) {
+        if (PacketQueueService::getFlow(qp->packet) != 0) {
+            if (movedTail == nullptr)
+                moved = qp;
+            else
+                movedTail->queueNext = qp;
+            movedTail = qp;
+            return;
+        }
 
-    RoutingTableService::aMessageHasBeenReceivedBy(packet->src);
+        ESP_LOGW(LM_TAG, "Destination %X unreachable, deleting queued packet", qp->packet->dst);
+        if (!spoolPacket(qp))
+            incDestinyUnreachable();
+        PacketQueueService::deleteQueuePacketAndPacket(qp);
+    });
+
+    //Move them to their flow
+    while (moved != nullptr) {
+        QueuePacket<Packet<uint8_t>>* qp = moved;
+        moved = qp->queueNext;
+        ToSendPackets->Add(qp, PacketQueueService::getFlow(qp->packet));
+    }
 
-    if (packet->dst == getLocalAddress()) {
-        ESP_LOGV(LM_TAG, "Data packet from %X for me", packet->src);
-        incDataPacketForMe();
+    ToSendPackets->releaseInUse();
 
-        processDataPacketForMe(pq);
-        return;
+    if (removed > 0)
+        ESP_LOGI(LM_TAG, "Removed %d packets from the flow to %X", (int) removed, nextHop);
+}
 
-    }
-    else if (packet->dst == BROADCAST_ADDR) {
-        ESP_LOGV(LM_TAG, "Data packet from %X BROADCAST", packet->src);
-        incReceivedBroadcast();
-        processDataPacketForMe(pq);
-        return;
+bool LoraMesher::spoolPacket(QueuePacket<Packet<uint8_t>>* qp) {
+    Packet<uint8_t>* p = qp->packet;
+    if (!SpoolService::isEnabled() || !PacketService::isOnlyDataPacket(p->type) || isHopAckPacket(p) || isExpired(qp) ||
+        p->dst == BROADCAST_ADDR || p->dst == LM_FLOOD_ADDRESS || RoleService::isMulticastAddress(p->dst))
+        return false;
 
-    }
-    else if (packet->via == getLocalAddress()) {
-        ESP_LOGV(LM_TAG, "Data Packet from %X for %X. Via is me. Forwarding it", packet->src, packet->dst);
-        incReceivedIAmVia();
-        addToSendOrderedAndNotify(reinterpret_cast<QueuePacket<Packet<uint8_t>>*>(pq));
-        return;
-    }
+    if (!SpoolService::append(p))
+        return false;
 
-    ESP_LOGV(LM_TAG, "Packet not for me, deleting it");
-    incReceivedNotForMe();
-    PacketQueueService::deleteQueuePacketAndPacket(pq);
+    ESP_LOGW(LM_TAG, "Packet %d to %X stored in the spool", p->id, p->dst);
+    incStat(stats.spoolStoredNum);
+
+    // The queue manager drains the spool
+    if (SpoolService::getPendingNum() == 1)
+        notifyNewSequenceStarted();
+
+    return true;
 }
 
-void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket>* pq) {
-    DataPacket* p = pq->packet;
-    ControlPacket* cPacket = reinterpret_cast<ControlPacket*>(p);
+bool LoraMesher::drainSpool() {
+    if (SpoolService::getPendingNum() == 0)
+        return false;
 
-    //By default, delete the packet queue at the finish of this function
-    bool deleteQueuePacket = true;
+    uint32_t now = millis();
+    if (now - lastSpoolDrain < LM_SPOOL_DRAIN_INTERVAL)
+        return true;
 
-    bool needAck = PacketService::isNeedAckPacket(p->type);
+    lastSpoolDrain = now;
 
-    if (PacketService::isOnlyDataPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Data Packet received");
-        //Convert the packet into a user packet
-        AppPacket<uint8_t>* appPacket = PacketService::convertPacket(p);
+    // The spooled packets go out at a limited rate, behind the new traffic
+    for (uint8_t i = 0; i < LM_SPOOL_DRAIN_BURST && ToSendPackets->getLength() < LM_SPOOL_DRAIN_BURST; i++) {
+        Packet<uint8_t>* p = SpoolService::peek();
+        if (p == nullptr)
+            break;
 
-        // Handle validation failure
-        if (appPacket == nullptr) {
-            ESP_LOGE(LM_TAG, "Failed to convert packet, discarding corrupted packet");
-            PacketQueueService::deleteQueuePacketAndPacket(pq);
+        // Oldest first, the packets behind wait for its route too
+        if (RoutingTableService::getNextHop(p->dst) == 0) {
+            deletePacket(p);
+            break;
+        }
+
+        SpoolService::pop();
+        incStat(stats.spoolDrainedNum);
+
+        ESP_LOGI(LM_TAG, "Packet %d to %X drained from the spool", p->id, p->dst);
+        addToSendOrderedAndNotify(PacketQueueService::createQueuePacket(p, DEFAULT_PRIORITY));
+    }
+
+    return SpoolService::getPendingNum() > 0;
+}
+
+uint32_t LoraMesher::discoverRoutes() {
+    RouteDiscoveryMessage request;
+    while (RouteDiscoveryService::nextRequest(getLocalAddress(), request)) {
+        ESP_LOGI(LM_TAG, "Route request %d to %X", request.requestId, request.target);
+        sendRouteDiscovery(ROUTE_REQUEST_P, BROADCAST_ADDR, request);
+        incStat(stats.routeRequestsNum);
+    }
+
+    releaseHeldPackets();
+    return RouteDiscoveryService::getTimeUntilNext();
+}
+
+void LoraMesher::releaseHeldPackets() {
+    bool found;
+    QueuePacket<Packet<uint8_t>>* pq;
+    while ((pq = RouteDiscoveryService::takeResolved(found)) != nullptr) {
+        if (found) {
+            addToSendOrderedAndNotify(pq);
+            continue;
+        }
+
+        ESP_LOGW(LM_TAG, "Held packet %d to %X dropped, route not discovered", pq->packet->id, pq->packet->dst);
+        if (!spoolPacket(pq))
+            incDestinyUnreachable();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+    }
+}
+
+void LoraMesher::sendRouteDiscovery(uint8_t type, uint16_t dst, const RouteDiscoveryMessage& message) {
+    Packet<uint8_t>* packet = PacketService::createCustomPacket(dst, getLocalAddress(), type,
+        reinterpret_cast<const uint8_t*>(&message), sizeof(message));
+    if (packet == nullptr)
+        return;
+
+    setPackedForSend(packet, LM_PRIORITY_ROUTING);
+}
+
+void LoraMesher::processRouteDiscoveryPacket(QueuePacket<Packet<uint8_t>>* rx) {
+    Packet<uint8_t>* p = rx->packet;
+
+    if (PacketService::getPacketPayloadLength(p) != sizeof(RouteDiscoveryMessage)) {
+        processUnknownPacket(rx);
+        return;
+    }
+
+    RouteDiscoveryMessage message;
+    memcpy(&message, p->payload, sizeof(message));
+
+    if (p->type == ROUTE_REQUEST_P)
+        processRouteRequest(p->src, message);
+    else if (p->dst == getLocalAddress())
+        processRouteReply(p->src, message);
+    else
+        incReceivedNotForMe();
+
+    PacketQueueService::deleteQueuePacketAndPacket(rx);
+}
+
+void LoraMesher::processRouteRequest(uint16_t transmitter, RouteDiscoveryMessage& request) {
+    uint16_t localAddress = getLocalAddress();
+    if (request.origin == localAddress || !RouteDiscoveryService::isNewRequest(request))
+        return;
+
+    // The first copy heard leaves the route back to the origin
+    request.hops++;
+    RoutingTableService::addProvisionalRoute(NetworkNode(request.origin, request.hops, ROLE_DEFAULT), transmitter,
+        LM_DISCOVERY_ROUTE_TIMEOUT * 1000);
+    RoutingTableService::publishSnapshot();
+
+    if (request.target == localAddress) {
+        uint16_t nextHop = RoutingTableService::getNextHop(request.origin);
+        if (nextHop == 0)
             return;
+
+        ESP_LOGI(LM_TAG, "Route request %d from %X answered", request.requestId, request.origin);
+
+        RouteDiscoveryMessage reply = request;
+        reply.hops = 0;
+        sendRouteDiscovery(ROUTE_REPLY_P, nextHop, reply);
+        incStat(stats.routeRepliesNum);
+        return;
+    }
+
+    if (request.hops < LM_FLOOD_MAX_HOPS)
+        sendRouteDiscovery(ROUTE_REQUEST_P, BROADCAST_ADDR, request);
+}
+
+void LoraMesher::processRouteReply(uint16_t transmitter, RouteDiscoveryMessage& reply) {
+    reply.hops++;
+    RoutingTableService::addProvisionalRoute(NetworkNode(reply.target, reply.hops, ROLE_DEFAULT), transmitter,
+        LM_DISCOVERY_ROUTE_TIMEOUT * 1000);
+    RoutingTableService::publishSnapshot();
+
+    if (reply.origin == getLocalAddress()) {
+        ESP_LOGI(LM_TAG, "Route to %X discovered via %X, %d hops", reply.target, transmitter, reply.hops);
+        releaseHeldPackets();
+        return;
+    }
+
+    uint16_t nextHop = RoutingTableService::getNextHop(reply.origin);
+    if (nextHop == 0 || reply.hops >= LM_FLOOD_MAX_HOPS)
+        return;
+
+    sendRouteDiscovery(ROUTE_REPLY_P, nextHop, reply);
+}
+
+uint32_t LoraMesher::sendOta() {
+    if (!OtaService::isEnabled())
+        return UINT32_MAX;
+
+    uint16_t upstream = RoutingTableService::getNextHop(OtaService::getOrigin());
+
+    // The update is background traffic, a message goes only when the packets of the application and the relayed ones are sent
+    if (ToSendPackets->getLength() > 0)
+        return std::min(OtaService::getTimeUntilNext(), (uint32_t) LM_OTA_SERVE_INTERVAL);
+
+    uint8_t message[LM_MAX_PACKET_SIZE];
+    uint16_t dst;
+    size_t size = OtaService::next(upstream, message, dst);
+    if (size != 0) {
+        // The messages of the offering node cross every link once, the others go to the neighbors
+        LM_SendOptions options;
+        options.port = LM_PORT_OTA;
+        LM_EnqueueResult result = dst == LM_FLOOD_ADDRESS ? sendFlood(message, size, LM_PORT_OTA) :
+            sendDataPacket(dst, message, size, DEFAULT_PRIORITY, options);
+        if (!isEnqueued(result))
+            ESP_LOGW(LM_TAG, "OTA message of %d bytes to %X not sent", (int) size, dst);
+    }
+
+    return OtaService::getTimeUntilNext();
+}
+
+bool LoraMesher::processOtaMessage(uint16_t src, uint8_t port, const uint8_t* payload, size_t payloadSize) {
+    if (port != LM_PORT_OTA)
+        return false;
+
+    if (!OtaService::isEnabled() || !OtaService::isMessage(payload, payloadSize))
+        return true;
+
+    OtaService::process(src, payload, payloadSize);
+
+    // A request can have chunks to serve
+    notifyNewSequenceStarted();
+    return true;
+}
+
+bool LoraMesher::startOta(uint32_t size) {
+    if (!OtaService::offer(size))
+        return false;
+
+    notifyNewSequenceStarted();
+    return true;
+}
+
+uint32_t LoraMesher::recordMetrics() {
+    uint32_t waitTime = MetricsHistoryService::getTimeUntilNext();
+    if (waitTime != 0)
+        return waitTime;
+
+    LM_MetricsSample sample;
+    sample.freeHeap = getFreeHeap();
+    sample.sendQueue = ToSendPackets->getLength();
+    sample.receivedQueue = ReceivedAppPackets->getLength();
+    sample.routes = routingTableSize();
+    sample.channelBusy = getChannelBusy();
+
+    portENTER_CRITICAL(&statsMux);
+    sample.sent = stats.sendPacketsNum;
+    sample.received = stats.receivedDataPacketsNum;
+    sample.forwarded = stats.forwardedPacketsNum;
+    sample.sendQueueDropped = stats.sendQueueDroppedNum;
+    sample.receivedQueueDropped = stats.receivedQueueDroppedNum;
+    sample.timeOnAir = stats.timeOnAir.sum;
+    portEXIT_CRITICAL(&statsMux);
+
+    MetricsHistoryService::record(sample);
+    return MetricsHistoryService::getTimeUntilNext();
+}
+
+bool LoraMesher::processMetricsMessage(uint16_t src, uint8_t port, const uint8_t* payload, size_t payloadSize) {
+    if (port != LM_PORT_METRICS)
+        return false;
+
+    if (!MetricsHistoryService::isMessage(payload, payloadSize))
+        return true;
+
+    uint8_t reply[LM_METRICS_REPLY_SIZE];
+    size_t size = MetricsHistoryService::process(src, payload, payloadSize, reply);
+    if (size != 0 && !isEnqueued(sendDatagram(src, reply, size, LM_PORT_METRICS)))
+        ESP_LOGW(LM_TAG, "Metrics reply of %d bytes to %X not sent", (int) size, src);
+
+    return true;
+}
+
+LM_EnqueueResult LoraMesher::requestMetrics(uint16_t dst, LM_MetricsTier tier, uint32_t from, uint32_t to) {
+    if (!loraMesherConfig->applicationPorts)
+        return ENQUEUE_INVALID;
+
+    uint8_t message[LM_MAX_PACKET_SIZE];
+    size_t size = MetricsHistoryService::buildRequest(tier, from, to, message);
+
+    LM_SendOptions options;
+    options.port = LM_PORT_METRICS;
+    return sendDataPacket(dst, message, size, DEFAULT_PRIORITY, options);
+}
+
+LM_OtaState LoraMesher::getOtaState(uint32_t* received, uint32_t* chunks) {
+    if (received != nullptr)
+        *received = OtaService::getReceivedChunks();
+    if (chunks != nullptr)
+        *chunks = OtaService::getChunks();
+
+    return OtaService::getState();
+}
+
+size_t LoraMesher::getAggregatedLength(Packet<uint8_t>* p) {
+#if LM_COMPACT_HEADER
+    return 1 + CompactHeaderService::getPacketLength(p);
+#else
+    return 1 + p->packetSize;
+#endif
+}
+
+QueuePacket<Packet<uint8_t>>* LoraMesher::aggregatePackets(QueuePacket<Packet<uint8_t>>* first, uint16_t nextHop, uint8_t& sendId) {
+    QueuePacket<Packet<uint8_t>>* parts[LM_MAX_AGGREGATED_PACKETS];
+    parts[0] = first;
+    size_t numOfParts = 1;
+
+    size_t maxPacketSize = PacketFactory::getMaxPacketSize();
+    size_t aggregateSize = PacketService::getHeaderLength(AGGREGATE_P) + getAggregatedLength(first->packet);
+
+    ToSendPackets->setInUse();
+
+    if (loraMesherConfig->aggregateDataPackets && ToSendPackets->moveToStart()) {
+        do {
+            QueuePacket<Packet<uint8_t>>* candidate = ToSendPackets->getCurrent();
+            Packet<uint8_t>* p = candidate->packet;
+
+            // The expired packets are dropped when they are popped
+            if (!PacketService::isOnlyDataPacket(p->type) || PacketService::isTracedPacket(p->type) || p->dst == BROADCAST_ADDR ||
+                isExpired(candidate))
+                continue;
+
+            size_t length = getAggregatedLength(p);
+
+            // The snapshot does not take the routing table mutex, it is taken before the send queue elsewhere
+            if (aggregateSize + length > maxPacketSize || ToSendPackets->getCurrentFlow() != nextHop ||
+                RoutingTableService::getSnapshotNextHop(p->dst) != nextHop)
+                continue;
+
+            parts[numOfParts++] = candidate;
+            aggregateSize += length;
+        } while (numOfParts < LM_MAX_AGGREGATED_PACKETS && ToSendPackets->next());
+    }
+
+    for (size_t i = 1; i < numOfParts; i++)
+        ToSendPackets->Remove(parts[i]);
+
+    ToSendPackets->releaseInUse();
+
+    size_t numOfDataParts = numOfParts;
+    if (loraMesherConfig->delayedAck != 0)
+        takeDelayedAcks(nextHop, parts, numOfParts, aggregateSize);
+
+    if (numOfParts == 1)
+        return first;
+
+    //The aggregate frame keeps the PacketHeader in memory, like the parts
+    size_t packetSize = sizeof(PacketHeader);
+    for (size_t i = 0; i < numOfParts; i++)
+        packetSize += getAggregatedLength(parts[i]->packet);
+
+    Packet<uint8_t>* aggregate = PacketService::createEmptyPacket(packetSize);
+    if (aggregate == nullptr) {
+        ESP_LOGW(LM_TAG, "Aggregate frame not created, sending the packets alone");
+        for (size_t i = 1; i < numOfParts; i++)
+            PacketQueueService::addOrdered(ToSendPackets, parts[i]);
+        return first;
+    }
+
+    aggregate->dst = nextHop;
+    aggregate->src = getLocalAddress();
+    aggregate->type = AGGREGATE_P;
+    aggregate->id = 0;
+    aggregate->packetSize = packetSize;
+
+    uint8_t priority = 0;
+    uint8_t* current = aggregate->payload;
+
+    for (size_t i = 0; i < numOfParts; i++) {
+        Packet<uint8_t>* p = parts[i]->packet;
+
+        if (i > 0) {
+            recordSendQueueWait(parts[i]);
+
+            if (p->src == getLocalAddress())
+                p->id = sendId++;
+
+            (reinterpret_cast<DataPacket*>(p))->via = nextHop;
         }
 
-        //Add and notify the user of this packet
-        notifyUserReceivedPacket(appPacket);
+        size_t length = getAggregatedLength(p) - 1;
+        *current++ = length;
+
+#if LM_COMPACT_HEADER
+        CompactHeaderService::encode(p, current, length);
+#else
+        memcpy(current, p, length);
+#endif
+        current += length;
+
+        if (parts[i]->priority > priority)
+            priority = parts[i]->priority;
+
+        PacketQueueService::deleteQueuePacketAndPacket(parts[i]);
     }
-    else if (PacketService::isAckPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "ACK Packet received");
-        addAck(p->src, cPacket->seq_id, cPacket->number);
+
+    ESP_LOGI(LM_TAG, "Aggregated %d data packets and %d ACKs to %X in %d bytes", (int) numOfDataParts, (int) (numOfParts - numOfDataParts),
+        nextHop, (int) aggregateSize);
+
+    return PacketQueueService::createQueuePacket(aggregate, priority);
+}
+
+void LoraMesher::sendPackets() {
+    ESP_LOGV(LM_TAG, "Send routine started");
+    vTaskSuspend(NULL);
+
+    int sendCounter = 0;
+    uint8_t sendId = 0;
+    uint8_t resendMessage = 0;
+
+    //Packet being sent, it is deleted after the transmission is done
+    QueuePacket<Packet<uint8_t>>* tx = nullptr;
+    bool hasStarted = false;
+
+#ifdef ARDUINO
+    randomSeed(getLocalAddress());
+#else
+    srand(getLocalAddress());
+#endif
+
+    for (;;) {
+        /* Wait for the notification of new packet has to be sent and enter blocking */
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        while (ToSendPackets->getLength() > 0 || tx != nullptr) {
+            //Prepare the next packet while the previous one is on air
+            QueuePacket<Packet<uint8_t>>* next = popAndPreparePacket(sendId);
+            uint32_t takenAt = millis();
+            notifySendQueueRoom();
+
+            //The backbone does not wait for the packet on air on LoRa
+            if (next && isBackboneFrame(next)) {
+                recordState(LM_StateType::STATE_TYPE_SENT, next->packet);
+                sendBackbone(next);
+                next = nullptr;
+            }
+
+            if (tx) {
+                bool hasSend = hasStarted && waitPacketSent(tx->packet);
+
+                uint32_t delayBetweenSend = completeSend(tx, hasSend, resendMessage);
+                if (delayBetweenSend > 0)
+                    vTaskDelay(delayBetweenSend / portTICK_PERIOD_MS);
+
+                tx = nullptr;
+            }
+
+            if (!next)
+                continue;
+
+            ESP_LOGV(LM_TAG, "Send n. %d", sendCounter);
+
+            recordState(LM_StateType::STATE_TYPE_SENT, next->packet);
+
+            waitAirtimeBudget(next);
+
+            //Start sending the packet, it is finished in the next iteration
+            hasStarted = startSendPacket(next->packet, getTransmissionFrequency(next), takenAt);
+
+            sendCounter++;
+
+            tx = next;
+        }
     }
-    else if (PacketService::isLostPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Lost Packet received");
-        processLostPacket(p->src, cPacket->seq_id, cPacket->number);
+}
+
+uint32_t LoraMesher::completeSend(QueuePacket<Packet<uint8_t>>* tx, bool hasSend, uint8_t& resendMessage) {
+    if (!hasSend && isFloodSuppressed(tx->packet)) {
+        incFloodSuppressed();
+        PacketQueueService::deleteQueuePacketAndPacket(tx);
+        return 0;
     }
-    else if (PacketService::isSyncPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Synchronization Packet received");
-        processSyncPacket(p->src, cPacket->seq_id, cPacket->number);
 
-        needAck = false;
+    if (hasSend)
+        countSent(tx->packet);
+
+    //If the packet has not been send, add it to the queue and send it again
+    if (!hasSend && resendMessage < MAX_RESEND_PACKET) {
+        tx->priority = PacketQueueService::getResendPriority(tx->priority);
+        PacketQueueService::addOrdered(ToSendPackets, tx);
+
+        resendMessage++;
+        return 0;
     }
-    else if (PacketService::isXLPacket(p->type)) {
-        ESP_LOGV(LM_TAG, "Large payload Packet received");
-        processLargePayloadPacket(reinterpret_cast<QueuePacket<ControlPacket>*>(pq));
-        needAck = false;
-        deleteQueuePacket = false;
+
+    resendMessage = 0;
+
+    uint32_t timeOnAir = getFrameTimeOnAirMs(tx->packet->packetSize);
+    if (hasSend) {
+        recordStat(stats.timeOnAir, timeOnAir);
+        addChannelBusy(stats.busyTxTime, timeOnAir);
+        TdmaService::onSent(timeOnAir);
+        checkCongestion();
     }
 
-    //Need ack
-    if (needAck) {
-        //TODO: All packets with this ack will ack?
-        ESP_LOGV(LM_TAG, "Previous packet need an ACK");
-        sendAckPacket(p->src, cPacket->seq_id, cPacket->number);
+    //The airtime budget waits before sending the next packet instead
+    const uint8_t dutyCycleEvery = (100 - LM_DUTY_CYCLE) / portTICK_PERIOD_MS;
+    uint32_t delayBetweenSend = airtimeBudget.isEnabled() ? 0 : timeOnAir * dutyCycleEvery;
+
+    ESP_LOGV(LM_TAG, "TimeOnAir %d ms, next message in %d ms", (int)timeOnAir, (int)delayBetweenSend);
+
+    if (!hasSend || !waitHopAck(tx))
+        PacketQueueService::deleteQueuePacketAndPacket(tx);
+
+    return delayBetweenSend;
+}
+
+void LoraMesher::countSent(Packet<uint8_t>* p) {
+    incSendPackets();
+    incSentPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(p));
+    incSentControlBytes(PacketService::getControlLength(p));
+    if (p->src != getLocalAddress() && !isHopAckPacket(p))
+        incForwardedPackets();
+}
+
+void LoraMesher::sendHelloPacket() {
+    ESP_LOGV(LM_TAG, "Send Hello Packet routine started");
+
+    vTaskSuspend(NULL);
+
+    startHelloStep();
+
+    for (;;) {
+        uint32_t waitTime = helloStep();
+
+        // Sleep until the next HELLO, the next transmission point or the end of the Trickle interval, an inconsistency notifies this task
+        if (waitTime > 0)
+            ulTaskNotifyTake(pdTRUE, waitTime / portTICK_PERIOD_MS + 1);
     }
+}
 
-    if (deleteQueuePacket)
-        //Delete packet queue
-        PacketQueueService::deleteQueuePacketAndPacket(pq);
+void LoraMesher::startHelloStep() {
+    //Wait an initial 2 second, and the slot of the node with helloSlots
+    helloStarted = false;
+    helloSlotSalt = 0;
+    helloSlot = calculateHelloSlot();
+    helloMissedSeen = RoutingTableService::getMissedAdvertisementCount();
+    nextHelloTime = millis() + 2000 + getHelloSlotOffset(LM_HELLO_BOOT_SLOT);
+
+    // The first HELLO solicits the HELLOs of the neighbors
+    solicitPending = loraMesherConfig->neighborSolicitation;
+    solicitInterval = LM_SOLICIT_INTERVAL * 1000;
+
+    // The first period starts where the first HELLO is in its slot
+    uint8_t slots = loraMesherConfig->helloSlots;
+    if (slots != 0)
+        helloPeriodStart = nextHelloTime - helloSlot * getHelloSlotLength();
+
+    portENTER_CRITICAL(&helloTrickleMux);
+    helloTrickle.setSlot(helloSlot, slots);
+    portEXIT_CRITICAL(&helloTrickleMux);
 }
 
-void LoraMesher::notifyUserReceivedPacket(AppPacket<uint8_t>* appPacket) {
-    if (ReceiveAppData_TaskHandle) {
-        ReceivedAppPackets->setInUse();
-        //Add the packet inside the receivedUsers Queue
-        ReceivedAppPackets->Append(appPacket);
+uint8_t LoraMesher::calculateHelloSlot() {
+    uint8_t slots = loraMesherConfig->helloSlots;
+    return slots == 0 ? 0 : LM_Rendezvous::hash(getLocalAddress(), helloSlotSalt) % slots;
+}
 
-        ReceivedAppPackets->releaseInUse();
+uint32_t LoraMesher::getHelloSlotLength() {
+    return std::min((uint32_t) LM_HELLO_SLOT_LENGTH, (uint32_t) HELLO_PACKETS_DELAY * 1000 / loraMesherConfig->helloSlots);
+}
 
-        //Notify the received user task handle
-        xTaskNotify(
-            ReceiveAppData_TaskHandle,
-            0,
-            eSetValueWithOverwrite);
+uint32_t LoraMesher::getHelloSlotOffset(uint32_t slotLength) {
+    if (loraMesherConfig->helloSlots == 0)
+        return 0;
+
+    return helloSlot * slotLength + random(0, slotLength * LM_HELLO_SLOT_JITTER / 100 + 1);
+}
+
+void LoraMesher::updateHelloSlot() {
+    uint8_t slots = loraMesherConfig->helloSlots;
+    uint32_t missed = RoutingTableService::getMissedAdvertisementCount();
+    uint32_t newMissed = missed - helloMissedSeen;
+    helloMissedSeen = missed;
+
+    // The lost advertisements are a sign of HELLOs colliding in the same slot
+    if (slots < 2 || newMissed < LM_HELLO_RESLOT_MISSES)
+        return;
+
+    uint8_t previousSlot = helloSlot;
+    helloSlotSalt++;
+    helloSlot = calculateHelloSlot();
+    if (helloSlot == previousSlot)
+        helloSlot = (helloSlot + 1) % slots;
+
+    ESP_LOGI(LM_TAG, "%d advertisements of the neighbors lost, HELLO slot %d moved to %d", (int) newMissed, previousSlot, helloSlot);
+    incStat(stats.helloReslotsNum);
+
+    portENTER_CRITICAL(&helloTrickleMux);
+    helloTrickle.setSlot(helloSlot, slots);
+    portEXIT_CRITICAL(&helloTrickleMux);
+}
+
+uint32_t LoraMesher::helloStep() {
+    uint32_t triggeredWait = triggeredHelloStep();
+    uint32_t waitTime = std::min(triggeredWait, periodicHelloStep());
+    return std::min(waitTime, solicitationStep());
+}
+
+uint32_t LoraMesher::solicitationStep() {
+    if (!loraMesherConfig->neighborSolicitation || !helloStarted)
+        return UINT32_MAX;
+
+    uint32_t now = millis();
+
+    // A table that becomes empty later is solicited at the next check
+    if (RoutingTableService::routingTableSize() > 0) {
+        solicitInterval = LM_SOLICIT_INTERVAL * 1000;
+        return solicitInterval;
+    }
+
+    uint32_t elapsed = now - lastSolicitation;
+    if (elapsed < solicitInterval)
+        return solicitInterval - elapsed;
+
+    solicitPending = true;
+    sendRoutingPackets(true);
+
+    solicitInterval = std::min(solicitInterval * 2, (uint32_t) HELLO_PACKETS_DELAY * 1000);
+    return solicitInterval;
+}
+
+void LoraMesher::answerSolicitation() {
+    uint32_t now = millis();
+    if (lastSolicitationReply != 0 && now - lastSolicitationReply < LM_SOLICIT_HOLDOFF * 1000)
+        return;
+
+    lastSolicitationReply = now == 0 ? 1 : now;
+
+    uint32_t delay = random(0, LM_SOLICIT_REPLY_DELAY + 1);
+
+    portENTER_CRITICAL(&helloTrickleMux);
+    bool requested = !triggeredHelloPending;
+    if (requested || (int32_t) (triggeredHelloTime - now) > (int32_t) delay)
+        triggeredHelloTime = now + delay;
+    triggeredHelloPending = true;
+    triggeredHelloFull = true;
+    portEXIT_CRITICAL(&helloTrickleMux);
+
+    ESP_LOGI(LM_TAG, "Solicitation answered in %d ms", (int) delay);
+
+    if (Reactor_TaskHandle)
+        xTaskNotify(Reactor_TaskHandle, EVENT_HELLO, eSetBits);
+    else
+        xTaskNotifyGive(Hello_TaskHandle);
+}
+
+uint32_t LoraMesher::periodicHelloStep() {
+    uint32_t now = millis();
+
+    if (!helloStarted || !loraMesherConfig->trickleHello) {
+        if ((int32_t) (nextHelloTime - now) > 0)
+            return nextHelloTime - now;
+
+        helloStarted = true;
+
+        if (!loraMesherConfig->trickleHello) {
+            updateHelloSlot();
+            sendRoutingPackets();
+
+            // Wait for HELLO_PACKETS_DELAY seconds to send the next hello packet
+            uint8_t slots = loraMesherConfig->helloSlots;
+            if (slots == 0) {
+                nextHelloTime = now + HELLO_PACKETS_DELAY * 1000;
+                return HELLO_PACKETS_DELAY * 1000;
+            }
+
+            // Or until the slot of the node in the next period
+            uint32_t offset = getHelloSlotOffset(getHelloSlotLength());
+            helloPeriodStart += HELLO_PACKETS_DELAY * 1000;
+            if ((int32_t) (helloPeriodStart + offset - now) <= 0)
+                helloPeriodStart = now;
+
+            nextHelloTime = helloPeriodStart + offset;
+            return nextHelloTime - now;
+        }
+
+        portENTER_CRITICAL(&helloTrickleMux);
+        helloTrickle.start(loraMesherConfig->trickleIntervalMin * 1000, loraMesherConfig->trickleIntervalMax * 1000,
+            loraMesherConfig->trickleRedundancy, now, restoredTrickleInterval);
+        portEXIT_CRITICAL(&helloTrickleMux);
+    }
+
+    uint32_t waitTime;
+    portENTER_CRITICAL(&helloTrickleMux);
+    bool transmit = helloTrickle.poll(millis(), waitTime);
+    portEXIT_CRITICAL(&helloTrickleMux);
+
+    if (transmit) {
+        updateHelloSlot();
+        sendRoutingPackets();
+    }
+
+    return waitTime;
+}
+
+uint32_t LoraMesher::triggeredHelloStep() {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&helloTrickleMux);
+    bool pending = triggeredHelloPending;
+    int32_t remaining = (int32_t) (triggeredHelloTime - now);
+    bool due = pending && remaining <= 0;
+    bool full = triggeredHelloFull;
+    if (due) {
+        triggeredHelloPending = false;
+        triggeredHelloFull = false;
+    }
+    portEXIT_CRITICAL(&helloTrickleMux);
+
+    // The answer to a solicitation is a full HELLO, without touching the Trickle interval
+    if (due) {
+        if (full)
+            incStat(stats.solicitationRepliesNum);
+        sendRoutingPackets(!full);
+    }
+
+    return pending && !due ? remaining : UINT32_MAX;
+}
+
+void LoraMesher::requestTriggeredHello(bool resetTrickle) {
+    uint32_t now = millis();
+    uint32_t delay = random(0, LM_TRIGGERED_HELLO_DELAY + 1);
+
+    portENTER_CRITICAL(&helloTrickleMux);
+    bool requested = !triggeredHelloPending;
+    if (requested) {
+        triggeredHelloPending = true;
+        triggeredHelloTime = now + delay;
+    }
+    if (resetTrickle && loraMesherConfig->trickleHello && helloStarted)
+        helloTrickle.heardInconsistent(now);
+    portEXIT_CRITICAL(&helloTrickleMux);
+
+    if (!requested)
+        return;
+
+    ESP_LOGI(LM_TAG, "Triggered HELLO in %d ms", (int) delay);
+
+    if (Reactor_TaskHandle)
+        xTaskNotify(Reactor_TaskHandle, EVENT_HELLO, eSetBits);
+    else
+        xTaskNotifyGive(Hello_TaskHandle);
+}
+
+void LoraMesher::getLocalCongestion(uint8_t& queue, uint8_t& airtime) {
+    size_t capacity = loraMesherConfig->sendQueueCapacity != 0 ? loraMesherConfig->sendQueueCapacity : LM_CONGESTION_QUEUE_LENGTH;
+    size_t length = ToSendPackets->getLength();
+    queue = length >= capacity ? 100 : length * 100 / capacity;
+
+    portENTER_CRITICAL(&airtimeBudgetMux);
+    airtime = airtimeBudget.getAvailablePercent(millis());
+    portEXIT_CRITICAL(&airtimeBudgetMux);
+}
+
+uint8_t LoraMesher::getCongestion() {
+    uint8_t queue, airtime;
+    getLocalCongestion(queue, airtime);
+    return CongestionService::getLevel(queue, airtime);
+}
+
+uint8_t LoraMesher::getPathCongestion(uint16_t dst) {
+    uint8_t congestion = getCongestion();
+
+    uint16_t via = RoutingTableService::getSnapshotNextHop(dst);
+    if (via == 0)
+        return congestion;
+
+    // The path advertised by the next hop is the one to its best gateway
+    uint16_t gateway, gatewayVia;
+    bool bestGateway = dst == (LM_ROLE_ADDRESS | ROLE_GATEWAY) ||
+        (RoutingTableService::getRoleRoute(ROLE_GATEWAY, gateway, gatewayVia) && gateway == dst && gatewayVia == via);
+
+    uint8_t next = CongestionService::getNeighborCongestion(via, bestGateway);
+    return next > congestion ? next : congestion;
+}
+
+uint32_t LoraMesher::getSendInterval(uint16_t dst, uint32_t interval) {
+    uint32_t stretch = 100;
+
+    uint8_t congestion = getPathCongestion(dst);
+    if (congestion > LM_CONGESTION_THRESHOLD)
+        stretch += (LM_RATE_MAX_STRETCH - 1) * 100 * (congestion - LM_CONGESTION_THRESHOLD) / (100 - LM_CONGESTION_THRESHOLD);
+
+    // All the sources of a gateway over its capacity are slowed down by the same factor
+    uint8_t load = getGatewayLoad(dst);
+    if (load != 255 && load > LM_RATE_GATEWAY_CAPACITY && (uint32_t) load * 100 / LM_RATE_GATEWAY_CAPACITY > stretch)
+        stretch = (uint32_t) load * 100 / LM_RATE_GATEWAY_CAPACITY;
+
+    if (stretch > LM_RATE_MAX_STRETCH * 100)
+        stretch = LM_RATE_MAX_STRETCH * 100;
+
+    return (uint64_t) interval * stretch / 100;
+}
+
+uint32_t LoraMesher::getNextSendTime(uint16_t dst, uint32_t lastSend, uint32_t interval) {
+    uint32_t next = lastSend + getSendInterval(dst, interval);
+
+    uint32_t now = millis();
+    portENTER_CRITICAL(&airtimeBudgetMux);
+    uint32_t wait = airtimeBudget.getWaitTime(now, maxTimeOnAir, PacketQueueService::getTrafficClass(DEFAULT_PRIORITY));
+    portEXIT_CRITICAL(&airtimeBudgetMux);
+
+    if ((int32_t) (now + wait - next) > 0)
+        next = now + wait;
+
+    return next;
+}
+
+uint8_t LoraMesher::getGatewayLoad(uint16_t dst) {
+    uint16_t address = dst, via;
+    if (RoleService::isRoleAddress(dst) && !RoutingTableService::getRoleRoute(RoleService::getAddressRole(dst), address, via))
+        return 255;
+
+    RoutingTableSnapshot::Entry route;
+    if (!RoutingTableService::getSnapshotRoute(address, route) || (route.networkNode.role & ROLE_GATEWAY) == 0)
+        return 255;
+
+    return route.networkNode.gatewayLoad;
+}
+
+uint8_t LoraMesher::getGatewayHops() {
+    if (RoleService::isGateway())
+        return 0;
+
+    uint16_t gateway, via;
+    RoutingTableSnapshot::Entry route;
+    if (!RoutingTableService::getRoleRoute(ROLE_GATEWAY, gateway, via) || !RoutingTableService::getSnapshotRoute(gateway, route))
+        return UINT8_MAX;
+
+    return route.networkNode.metric;
+}
+
+void LoraMesher::checkCongestion() {
+    if (!loraMesherConfig->backpressure || !helloStarted)
+        return;
+
+    bool congested = getCongestion() >= LM_CONGESTION_THRESHOLD;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&congestionMux);
+    bool changed = congested != congestionAdvertised && now - congestionAdvertisedAt >= LM_CONGESTION_HELLO_INTERVAL;
+    if (changed) {
+        congestionAdvertised = congested;
+        congestionAdvertisedAt = now;
+    }
+    portEXIT_CRITICAL(&congestionMux);
+
+    if (!changed)
+        return;
+
+    // The routing table has not changed, the Trickle interval is kept
+    ESP_LOGI(LM_TAG, "Node %s, advertising it", congested ? "congested" : "not congested anymore");
+    incStat(stats.congestionHellosNum);
+    requestTriggeredHello(false);
+}
+
+void LoraMesher::notifyHelloConsistency(bool consistent) {
+    if (!loraMesherConfig->trickleHello)
+        return;
+
+    bool reset = false;
+    portENTER_CRITICAL(&helloTrickleMux);
+    if (consistent)
+        helloTrickle.heardConsistent();
+    else
+        reset = helloTrickle.heardInconsistent(millis());
+    portEXIT_CRITICAL(&helloTrickleMux);
+
+    if (reset) {
+        ESP_LOGV(LM_TAG, "Routing table changed, Trickle HELLO interval reset");
+        if (Reactor_TaskHandle)
+            xTaskNotify(Reactor_TaskHandle, EVENT_HELLO, eSetBits);
+        else
+            xTaskNotifyGive(Hello_TaskHandle);
+    }
+}
+
+void LoraMesher::sendRoutingPackets(bool triggered) {
+    ESP_LOGV(LM_TAG, "Creating Routing Packet");
+    ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
+    ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+    incSentHelloPackets();
+
+    size_t numOfNodes;
+    uint8_t routeFlags, tableVersion;
+    NetworkNode* nodes = RoutingTableService::getNextAdvertisement(numOfNodes, routeFlags, tableVersion, triggered);
+
+    // The synchronized nodes pass the time of the network on, it is stamped when every packet is sent
+    if (loraMesherConfig->timeSync && TimeSyncService::isSynced())
+        routeFlags |= ROUTE_TIME_SYNC_F;
+
+    // The TDMA slots around the node, filled when every packet is sent
+    if (TdmaService::isEnabled())
+        routeFlags |= ROUTE_TDMA_F;
+
+    // The congestion of the node, filled when every packet is sent
+    if (loraMesherConfig->backpressure)
+        routeFlags |= ROUTE_CONGESTION_F;
+
+    // A telemetry record, of the node or of a node farther from the gateways, filled when the packet is sent
+    if (TelemetryService::hasRecord())
+        routeFlags |= ROUTE_TELEMETRY_F;
+
+    // The neighbors answer with their full routing table
+    if (solicitPending) {
+        routeFlags |= ROUTE_SOLICIT_F | ROUTE_REQUEST_FULL_F;
+        solicitPending = false;
+        lastSolicitation = millis();
+        incStat(stats.solicitationsNum);
+    }
+
+    // The capabilities add the trailers of the node
+    uint8_t capabilities = (SniffService::isEnabled() ? ROUTE_CAP_SNIFF : 0) |
+        (loraMesherConfig->adaptiveLinkPower ? ROUTE_CAP_LINK_SNR : 0);
+
+    // Send as many packets as needed, at least one
+    size_t startIndex = 0;
+    size_t nodesInThisPacket;
+    do {
+        // Create and send the packet
+        RoutePacket* tx = PacketService::createRoutingPacket(
+            getLocalAddress(), &nodes[startIndex], numOfNodes - startIndex, RoleService::getRole(),
+            routeFlags, tableVersion, nodesInThisPacket, capabilities
+        );
+
+        setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(tx), LM_PRIORITY_ROUTING);
+
+        startIndex += nodesInThisPacket;
+    } while (startIndex < numOfNodes && nodesInThisPacket > 0);
+
+    // Delete the nodes array
+    if (numOfNodes > 0)
+        delete[] nodes;
+}
+
+void LoraMesher::processPackets() {
+    ESP_LOGV(LM_TAG, "Process routine started");
+    vTaskSuspend(NULL);
+
+    for (;;) {
+        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        /* Wait for the notification of receivingRoutine, or the next frame delayed by the link filter, and enter blocking */
+        uint32_t waitTime = getDelayedFramesWait();
+        ulTaskNotifyTake(pdPASS, waitTime == UINT32_MAX ? portMAX_DELAY : waitTime / portTICK_PERIOD_MS + 1);
+
+        ESP_LOGV(LM_TAG, "Size of Received Packets Queue: %d", getReceivedRingLength());
+
+        processStep();
+    }
+}
+
+void LoraMesher::processStep() {
+    processDelayedFrames();
+
+    while (getReceivedRingLength() > 0) {
+        LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring = ReceivedPackets->getLength() > 0 ? ReceivedPackets : SecondaryReceivedPackets;
+
+        uint16_t delay;
+        if (filterLink(ring, delay))
+            continue;
+
+        if (dropFrameNotForMe(ring))
+            continue;
+
+        QueuePacket<Packet<uint8_t>>* rx = popReceivedPacket(ring);
+
+        if (!rx)
+            continue;
+
+        bool secondary = ring == SecondaryReceivedPackets;
+        if (delay != 0 && delayFrame(rx, secondary, delay))
+            continue;
+
+        processFrame(rx, secondary);
+    }
+}
+
+void LoraMesher::processFrame(QueuePacket<Packet<uint8_t>>* rx, bool secondary) {
+    //The signal of the backbone is not the one of the LoRa link, and its HELLOs are copies of the LoRa ones
+    if (secondary && BackboneService::isEnabled()) {
+        if (PacketService::isHelloPacket(rx->packet->type)) {
+            if (rx->packet->src != getLocalAddress())
+                BackboneService::heard(rx->packet->src);
+
+            PacketQueueService::deleteQueuePacketAndPacket(rx);
+            return;
+        }
+    }
+    else {
+        refreshTransmitter(rx->packet, (int16_t) rx->rssi, (int8_t) rx->snr);
+    }
+
+    if (dispatchToWorker(rx))
+        return;
+
+    processReceivedPacket(rx);
+}
+
+bool LoraMesher::dispatchToWorker(QueuePacket<Packet<uint8_t>>* rx) {
+    //The rest of the packets write the routes, they are processed by this task only
+    if (processWorkersLength == 0 || packetProcessors[rx->packet->type] != &LoraMesher::processReceivedDataPacket)
+        return false;
+
+    //The packets of a source always go to the same worker, in order
+    ProcessWorker& worker = processWorkers[rx->packet->src % processWorkersLength];
+    while (worker.packets->getLength() >= LM_PROCESS_WORKER_QUEUE)
+        vTaskDelay(1);
+
+    worker.packets->setInUse();
+    worker.packets->Append(rx);
+    worker.packets->releaseInUse();
+
+    xTaskNotifyGive(worker.task);
+    return true;
+}
+
+void LoraMesher::processWorkerRoutine() {
+    ESP_LOGV(LM_TAG, "Process worker started");
+    vTaskSuspend(NULL);
+
+    //The handles are set once every task has been created
+    ProcessWorker* worker = nullptr;
+    for (uint8_t i = 0; i < processWorkersLength; i++) {
+        if (processWorkers[i].task == xTaskGetCurrentTaskHandle())
+            worker = &processWorkers[i];
+    }
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (;;) {
+            worker->packets->setInUse();
+            QueuePacket<Packet<uint8_t>>* rx = worker->packets->getLength() > 0 ? worker->packets->Pop() : nullptr;
+            worker->packets->releaseInUse();
+
+            if (rx == nullptr)
+                break;
+
+            processReceivedPacket(rx);
+        }
+    }
+}
+
+bool LoraMesher::filterLink(LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring, uint16_t& delay) {
+    delay = 0;
+    if (!LinkFilterService::isEnabled())
+        return false;
+
+    LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>::Slot* slot = ring->peekRead();
+    if (slot == nullptr || slot->length < sizeof(PacketHeader))
+        return false;
+
+    Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(slot->data);
+    if (PacketService::isDataPacket(p->type) && slot->length < sizeof(DataPacket))
+        return false;
+
+    // A data packet does not tell who forwarded it, it is taken from the route back to its source
+    uint16_t transmitter = getTransmitter(p);
+    if (transmitter == 0 && PacketService::isDataPacket(p->type))
+        transmitter = RoutingTableService::getNextHop(p->src);
+
+    LM_LinkFilter filter = LinkFilterService::get(transmitter);
+    if (LinkFilterService::drop(filter)) {
+        ESP_LOGV(LM_TAG, "Frame of type %X from %X dropped by the link filter", p->type, transmitter);
+        incStat(stats.linkFilterDroppedNum);
+        ring->releaseRead();
+        return true;
+    }
+
+    int16_t snr = slot->snr + filter.snrOffset;
+    slot->snr = snr < INT8_MIN ? INT8_MIN : snr > INT8_MAX ? INT8_MAX : snr;
+    delay = filter.delay;
+    return false;
+}
+
+bool LoraMesher::delayFrame(QueuePacket<Packet<uint8_t>>* rx, bool secondary, uint16_t delay) {
+    if (delayedFramesLength == LM_LINK_FILTER_DELAYED)
+        return false;
+
+    DelayedFrame& frame = delayedFrames[delayedFramesLength++];
+    frame.packet = rx;
+    frame.secondary = secondary;
+    frame.dueAt = millis() + delay;
+
+    incStat(stats.linkFilterDelayedNum);
+    return true;
+}
+
+void LoraMesher::processDelayedFrames() {
+    uint32_t now = millis();
+
+    for (size_t i = 0; i < delayedFramesLength;) {
+        if ((int32_t) (delayedFrames[i].dueAt - now) > 0) {
+            i++;
+            continue;
+        }
+
+        DelayedFrame frame = delayedFrames[i];
+        memmove(&delayedFrames[i], &delayedFrames[i + 1], (delayedFramesLength - i - 1) * sizeof(DelayedFrame));
+        delayedFramesLength--;
+
+        processFrame(frame.packet, frame.secondary);
+    }
+}
+
+uint32_t LoraMesher::getDelayedFramesWait() {
+    uint32_t now = millis();
+    uint32_t waitTime = UINT32_MAX;
+
+    for (size_t i = 0; i < delayedFramesLength; i++) {
+        int32_t until = (int32_t) (delayedFrames[i].dueAt - now);
+        if (until <= 0)
+            return 0;
+
+        if ((uint32_t) until < waitTime)
+            waitTime = until;
+    }
+
+    return waitTime;
+}
+
+void LoraMesher::refreshTransmitter(Packet<uint8_t>* p, int16_t rssi, int8_t snr) {
+    // Every frame received correctly keeps its transmitter alive, even if it is not for this node
+    uint16_t transmitter = getTransmitter(p);
+    if (transmitter != 0 && transmitter != getLocalAddress())
+        RoutingTableService::neighborHeard(transmitter, rssi, snr);
+}
+
+bool LoraMesher::dropFrameNotForMe(LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring) {
+    if (simulatorService != nullptr)
+        return false;
+
+    LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>::Slot* slot = ring->peekRead();
+    if (slot == nullptr || slot->length < sizeof(DataPacket))
+        return false;
+
+    Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(slot->data);
+    DataPacket* data = reinterpret_cast<DataPacket*>(p);
+    uint16_t localAddress = getLocalAddress();
+
+    // The HELLO, aggregate and control frames, and the data packets this node receives, forwards or counts, are processed.
+    // The duplicates for this node are processed too, they are acknowledged again with hopAck
+    if (!PacketService::isDataPacket(p->type) || data->dst == localAddress || data->via == localAddress ||
+        data->dst == BROADCAST_ADDR || data->dst == LM_FLOOD_ADDRESS)
+        return false;
+
+    if (ring != SecondaryReceivedPackets || !BackboneService::isEnabled())
+        refreshTransmitter(p, slot->rssi, slot->snr);
+
+    incReceivedPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(p));
+    incReceivedControlBytes(PacketService::getControlLength(p));
+
+    // The next hop forwarding a packet of this node, or its hop ACK to another node, acknowledges it
+    if (loraMesherConfig->hopAck && PacketService::isOnlyDataPacket(p->type))
+        processHopAck(data);
+
+    if (!(loraMesherConfig->hopAck && isHopAckPacket(p))) {
+        incReceivedDataPackets();
+        RoutingTableService::aMessageHasBeenReceivedBy(p->src);
+        incReceivedNotForMe();
+    }
+
+    ESP_LOGV(LM_TAG, "Data packet from %X for %X via %X dropped from its header", p->src, p->dst, data->via);
+    incReceivedFiltered();
+
+    ring->releaseRead();
+    return true;
+}
+
+uint16_t LoraMesher::getTransmitter(Packet<uint8_t>* p) {
+    if (PacketService::isHelloPacket(p->type) || PacketService::isAggregatePacket(p->type) || PacketService::isCustomPacket(p->type) ||
+        PacketService::isRouteDiscoveryPacket(p->type))
+        return p->src;
+
+    if (loraMesherConfig->hopAck && isHopAckPacket(p))
+        return (reinterpret_cast<DataPacket*>(p))->via;
+
+    return 0;
+}
+
+void LoraMesher::processReceivedPacket(QueuePacket<Packet<uint8_t>>* rx) {
+    uint8_t type = rx->packet->type;
+
+    LM_HOOK(HOOK_PROCESS_START, rx->packet, rx->packet->packetSize);
+#if LM_HOOKS
+    // The processor deletes the packet
+    PacketHeader header = *rx->packet;
+#endif
+
+    printHeaderPacket(rx->packet, "received");
+    LM_TRACE(LM_TRACE_RX, 1, TRACE_RECEIVE, rx->packet->src, rx->packet->dst, rx->packet->id,
+        (uint32_t) type << 8 | (rx->packet->packetSize & 0xFF));
+
+    //The packets inside the aggregate are recorded and counted when they are processed
+    if (!PacketService::isAggregatePacket(type)) {
+        recordState(LM_StateType::STATE_TYPE_RECEIVED, rx->packet);
+
+        incReceivedPayloadBytes(PacketService::getPacketPayloadLengthWithoutControl(rx->packet));
+        incReceivedControlBytes(PacketService::getControlLength(rx->packet));
+    }
+
+    (this->*packetProcessors[type])(rx);
+
+    LM_HOOK(HOOK_PROCESS_END, &header, header.packetSize);
+}
+
+void LoraMesher::buildPacketProcessors() {
+    for (size_t type = 0; type < 256; type++) {
+        if (PacketService::isAggregatePacket(type))
+            packetProcessors[type] = &LoraMesher::processAggregatePacket;
+        else if (PacketService::isHelloPacket(type))
+            packetProcessors[type] = &LoraMesher::processHelloPacket;
+        else if (PacketService::isDataPacket(type))
+            packetProcessors[type] = &LoraMesher::processReceivedDataPacket;
+        else if (PacketService::isRouteDiscoveryPacket(type))
+            packetProcessors[type] = &LoraMesher::processRouteDiscoveryPacket;
+        else
+            packetProcessors[type] = &LoraMesher::processUnknownPacket;
+    }
+
+    for (const CustomPacketType& custom : customPacketTypes) {
+        if (custom.handler != nullptr)
+            packetProcessors[custom.type] = &LoraMesher::processCustomPacket;
+    }
+}
+
+bool LoraMesher::registerPacketType(uint8_t type, LM_PacketHandler handler, void* context) {
+    if (!PacketService::isCustomPacket(type)) {
+        ESP_LOGE(LM_TAG, "Packet type %X is not free for the application", type);
+        return false;
+    }
+
+    CustomPacketType* slot = nullptr;
+    for (CustomPacketType& custom : customPacketTypes) {
+        if (custom.handler != nullptr && custom.type == type) {
+            slot = &custom;
+            break;
+        }
+
+        if (slot == nullptr && custom.handler == nullptr)
+            slot = &custom;
+    }
+
+    if (slot == nullptr) {
+        if (handler == nullptr)
+            return true;
+
+        ESP_LOGE(LM_TAG, "Packet type %X not registered, %d types already", type, LM_CUSTOM_PACKET_TYPES);
+        return false;
+    }
+
+    slot->type = type;
+    slot->handler = handler;
+    slot->context = context;
+
+    buildPacketProcessors();
+    return true;
+}
+
+LM_EnqueueResult LoraMesher::sendCustomPacket(uint8_t type, uint16_t dst, const uint8_t* payload, uint32_t payloadSize) {
+    if (payloadSize == 0 || !PacketService::isCustomPacket(type) || payloadSize > PacketService::getMaximumPayloadLength(type))
+        return ENQUEUE_INVALID;
+
+    Packet<uint8_t>* packet = PacketService::createCustomPacket(dst, getLocalAddress(), type, payload, payloadSize);
+    return setPackedForSend(packet, DEFAULT_PRIORITY);
+}
+
+void LoraMesher::processHelloPacket(QueuePacket<Packet<uint8_t>>* rx) {
+    incRecHelloPackets();
+
+    processRouteTrailers(reinterpret_cast<RoutePacket*>(rx->packet), rx->receivedAt);
+
+    uint32_t changes = RoutingTableService::getChangeCount();
+    RoutingTableService::processRoute(reinterpret_cast<RoutePacket*>(rx->packet), rx->snr);
+    notifyHelloConsistency(changes == RoutingTableService::getChangeCount());
+
+    if (reinterpret_cast<RoutePacket*>(rx->packet)->routeFlags & ROUTE_SOLICIT_F)
+        answerSolicitation();
+
+    //The routes removed by a withdrawal are withdrawn to the neighbors too
+    if (loraMesherConfig->triggeredWithdrawal && RoutingTableService::hasPendingWithdrawals())
+        requestTriggeredHello();
+
+    PacketQueueService::deleteQueuePacketAndPacket(rx);
+}
+
+void LoraMesher::processReceivedDataPacket(QueuePacket<Packet<uint8_t>>* rx) {
+    processDataPacket(reinterpret_cast<QueuePacket<DataPacket>*>(rx));
+}
+
+void LoraMesher::processCustomPacket(QueuePacket<Packet<uint8_t>>* rx) {
+    Packet<uint8_t>* p = rx->packet;
+
+    if (p->dst == getLocalAddress() || p->dst == BROADCAST_ADDR) {
+        for (const CustomPacketType& custom : customPacketTypes) {
+            if (custom.handler != nullptr && custom.type == p->type) {
+                custom.handler(p->src, p->payload, PacketService::getPacketPayloadLength(p), rx->rssi, rx->snr, custom.context);
+                break;
+            }
+        }
+    }
+    else
+        incReceivedNotForMe();
+
+    PacketQueueService::deleteQueuePacketAndPacket(rx);
+}
+
+void LoraMesher::processUnknownPacket(QueuePacket<Packet<uint8_t>>* rx) {
+    ESP_LOGV(LM_TAG, "Packet not identified, deleting it");
+    incReceivedNotForMe();
+    PacketQueueService::deleteQueuePacketAndPacket(rx);
+}
+
+void LoraMesher::processRouteTrailers(RoutePacket* p, uint32_t receivedAt) {
+    SniffService::process(p->src, p->getSniff());
+
+    LinkSnrTrailer* linkSnr = p->getLinkSnr();
+    if (linkSnr != nullptr && loraMesherConfig->adaptiveLinkPower)
+        RoutingTableService::processLinkSnr(p->src, linkSnr);
+
+    TdmaTrailer* tdma = p->getTdma();
+    if (tdma != nullptr && TdmaService::isEnabled())
+        TdmaService::process(p->src, tdma);
+
+    CongestionTrailer* congestion = p->getCongestion();
+    if (congestion != nullptr)
+        CongestionService::process(p->src, congestion);
+
+    TelemetryTrailer* telemetry = p->getTelemetry();
+    if (telemetry != nullptr && TelemetryService::isEnabled())
+        TelemetryService::process(telemetry, getGatewayHops());
+
+    if (!loraMesherConfig->timeSync)
+        return;
+
+    TimeSyncTrailer* trailer = p->getTimeSync();
+    if (trailer == nullptr)
+        return;
+
+    // The receive interrupt time in the 64 bits local clock
+    int64_t now = esp_timer_get_time();
+    TimeSyncService::process(p->src, trailer, now - (uint32_t) ((uint32_t) now - receivedAt));
+}
+
+void LoraMesher::processAggregatePacket(QueuePacket<Packet<uint8_t>>* rx) {
+    Packet<uint8_t>* aggregate = rx->packet;
+
+    if (aggregate->dst != getLocalAddress()) {
+        ESP_LOGV(LM_TAG, "Aggregate frame not for me, deleting it");
+        incReceivedNotForMe();
+        PacketQueueService::deleteQueuePacketAndPacket(rx);
+        return;
+    }
+
+    uint8_t* current = aggregate->payload;
+    uint8_t* end = reinterpret_cast<uint8_t*>(aggregate) + aggregate->packetSize;
+
+    while (current < end) {
+        size_t length = *current++;
+        if (length == 0 || length > (size_t) (end - current)) {
+            ESP_LOGW(LM_TAG, "Malformed aggregate frame from %X", aggregate->src);
+            break;
+        }
+
+#if LM_COMPACT_HEADER
+        uint8_t decoded[UINT8_MAX];
+        size_t packetSize = CompactHeaderService::decode(current, length, decoded, sizeof(decoded));
+        Packet<uint8_t>* part = packetSize > 0 ? PacketService::copyPacket(decoded, packetSize) : nullptr;
+#else
+        Packet<uint8_t>* part = nullptr;
+        if (length >= sizeof(PacketHeader) && reinterpret_cast<PacketHeader*>(current)->packetSize == length)
+            part = PacketService::copyPacket(current, length);
+#endif
+        current += length;
+
+        //Aggregates are not nested
+        if (part == nullptr || !PacketService::isDataPacket(part->type)) {
+            ESP_LOGW(LM_TAG, "Packet inside an aggregate frame from %X not valid", aggregate->src);
+            if (part)
+                deletePacket(part);
+            continue;
+        }
+
+        QueuePacket<Packet<uint8_t>>* pq = PacketQueueService::createQueuePacket(part, 0, 0, rx->rssi, rx->snr);
+        pq->receivedAt = rx->receivedAt;
+        processReceivedPacket(pq);
+    }
+
+    PacketQueueService::deleteQueuePacketAndPacket(rx);
+}
+
+QueuePacket<Packet<uint8_t>>* LoraMesher::popReceivedPacket(LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring) {
+    LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>::Slot* slot = ring->peekRead();
+    if (slot == nullptr)
+        return nullptr;
+
+    //Copy the slot out of the ring, the packet can be kept by the upper layers
+    Packet<uint8_t>* rx = PacketService::copyPacket(slot->data, slot->length);
+    QueuePacket<Packet<uint8_t>>* pq = nullptr;
+    if (rx) {
+        pq = PacketQueueService::createQueuePacket(rx, 0, 0, slot->rssi, slot->snr);
+        pq->receivedAt = slot->timestamp;
+    }
+
+    ring->releaseRead();
+
+    return pq;
+}
+
+void LoraMesher::routingTableManager() {
+    ESP_LOGV(LM_TAG, "Routing Table Manager routine started");
+    vTaskSuspend(NULL);
+
+    lastRoutingTablePrint = millis();
+
+    for (;;) {
+        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        // Wait until the next route timeout, a route armed before it notifies this task
+        uint32_t waitTime = routingTableStep();
+
+        ulTaskNotifyTake(pdTRUE, waitTime / portTICK_PERIOD_MS + 1);
+    }
+}
+
+size_t LoraMesher::withdrawNeighbor(uint16_t address) {
+    size_t removed = removeNeighborRoutes(address);
+    if (removed == 0)
+        return 0;
+
+    ESP_LOGW(LM_TAG, "Neighbor %X withdrawn with %d routes", address, (int) removed);
+
+    incNeighborsWithdrawn();
+    requestTriggeredHello();
+    return removed;
+}
+
+size_t LoraMesher::removeNeighborRoutes(uint16_t address) {
+    // The routes with an alternate next hop are kept
+    RoutingTableService::failoverNeighbor(address);
+
+    size_t removed = 0;
+
+    RoutingTableService::routingTableList->setInUse();
+
+    for (;;) {
+        RouteNode* route = nullptr;
+        for (RouteNode* node : *RoutingTableService::routingTableList) {
+            if (node->networkNode.address == address || node->via == address) {
+                route = node;
+                break;
+            }
+        }
+
+        if (route == nullptr)
+            break;
+
+        ESP_LOGW(LM_TAG, "Route to %X via %X withdrawn", route->networkNode.address, route->via);
+        removeNodeFromQSPandQWP(route->networkNode.address);
+
+        RoutingTableService::routingTableList->Search(route);
+        RoutingTableService::deleteCurrentNode();
+        removed++;
+    }
+
+    RoutingTableService::routingTableList->releaseInUse();
+
+    if (removed == 0)
+        return 0;
+
+    RoutingTableService::publishSnapshot();
+    purgeSendFlow(address);
+    return removed;
+}
+
+uint32_t LoraMesher::routingTableStep() {
+    //Neighbors lost in this iteration, their flows of the send queue are purged
+    uint16_t lostNeighbors[LM_SEND_FLOWS];
+
+    // TODO: If the routing table removes a node, remove the nodes from the Q_WSP and Q_WRP
+    ESP_LOGV(LM_TAG, "Checking routes timeout");
+
+    size_t numOfLostNeighbors = 0;
+
+    RoutingTableService::routingTableList->setInUse();
+
+    RoutingTableService::routeTimers->expire(millis(), [this, &lostNeighbors, &numOfLostNeighbors](LM_Timer* timer) {
+        RouteNode* node = static_cast<RouteNode*>(timer->context);
+
+        ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
+
+        if (RoutingTableService::moveToAlternate(node))
+            return;
+
+        removeNodeFromQSPandQWP(node->networkNode.address);
+
+        if (node->networkNode.metric == 1 && numOfLostNeighbors < LM_SEND_FLOWS)
+            lostNeighbors[numOfLostNeighbors++] = node->networkNode.address;
+
+        if (RoutingTableService::routingTableList->Search(node))
+            RoutingTableService::deleteCurrentNode();
+    });
+
+    RoutingTableService::routingTableList->releaseInUse();
+
+    RoutingTableService::publishSnapshot();
+
+    for (size_t i = 0; i < numOfLostNeighbors; i++) {
+        //The routes through the lost neighbor are not waited to time out
+        if (loraMesherConfig->triggeredWithdrawal)
+            removeNeighborRoutes(lostNeighbors[i]);
+        else
+            RoutingTableService::failoverNeighbor(lostNeighbors[i]);
+
+        purgeSendFlow(lostNeighbors[i]);
+    }
+
+    if (numOfLostNeighbors > 0) {
+        notifyHelloConsistency(false);
+        if (loraMesherConfig->triggeredWithdrawal)
+            incStat(stats.neighborsWithdrawnNum, numOfLostNeighbors);
+    }
+
+    if (loraMesherConfig->triggeredWithdrawal && RoutingTableService::hasPendingWithdrawals())
+        requestTriggeredHello();
+
+    // Print the routing table and record the state every DEFAULT_TIMEOUT seconds, as before the route timers
+    uint32_t now = millis();
+    if (now - lastRoutingTablePrint >= DEFAULT_TIMEOUT * 1000) {
+        lastRoutingTablePrint = now;
+
+        RoutingTableService::printRoutingTable();
+
+        // Record the state for the simulation
+        recordState(LM_StateType::STATE_TYPE_MANAGER);
+    }
+
+    if (CheckpointService::getTimeUntilDue() == 0) {
+        uint32_t trickleInterval = 0;
+        if (loraMesherConfig->trickleHello && helloStarted) {
+            portENTER_CRITICAL(&helloTrickleMux);
+            trickleInterval = helloTrickle.getInterval();
+            portEXIT_CRITICAL(&helloTrickleMux);
+        }
+
+        CheckpointService::save(trickleInterval);
+    }
+
+    uint32_t waitTime = RoutingTableService::routeTimers->getTimeUntilNext(now);
+    uint32_t untilPrint = DEFAULT_TIMEOUT * 1000 - (now - lastRoutingTablePrint);
+    if (untilPrint < waitTime)
+        waitTime = untilPrint;
+
+    uint32_t untilCheckpoint = CheckpointService::getTimeUntilDue();
+    if (untilCheckpoint < waitTime)
+        waitTime = untilCheckpoint;
+
+    return waitTime;
+}
+
+void LoraMesher::queueManager() {
+    ESP_LOGV(LM_TAG, "Queue Manager routine started");
+    vTaskSuspend(NULL);
+
+    for (;;) {
+        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
+        ESP_LOGV(LM_TAG, "Free heap: %d", getFreeHeap());
+
+        // Wait until the next sequence timeout, a new sequence or an earlier timeout notifies this task
+        uint32_t waitTime = queueManagerStep();
+
+        if (waitTime == UINT32_MAX) {
+            ESP_LOGV(LM_TAG, "No packets to send or received");
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        else
+            ulTaskNotifyTake(pdTRUE, waitTime / portTICK_PERIOD_MS + 1);
+    }
+}
+
+uint32_t LoraMesher::queueManagerStep() {
+    // Record the state for the simulation
+    recordState(LM_StateType::STATE_TYPE_MANAGER);
+
+    managerReceivedQueue();
+    managerSendQueue();
+    managerHopAcks();
+    managerDelayedAcks();
+    managerFragments();
+
+    bool streamsWaiting = sendStreams();
+    bool spoolWaiting = drainSpool();
+    uint32_t otaWaitTime = sendOta();
+    uint32_t metricsWaitTime = recordMetrics();
+    uint32_t discoveryWaitTime = discoverRoutes();
+
+    uint32_t now = millis();
+    uint32_t waitTime = wrpTimers->getTimeUntilNext(now);
+    uint32_t sendWaitTime = wspTimers->getTimeUntilNext(now);
+    if (sendWaitTime < waitTime)
+        waitTime = sendWaitTime;
+    uint32_t hopAckWaitTime = hopAckTimers->getTimeUntilNext(now);
+    if (hopAckWaitTime < waitTime)
+        waitTime = hopAckWaitTime;
+    uint32_t delayedAckWaitTime = delayedAckTimers->getTimeUntilNext(now);
+    if (delayedAckWaitTime < waitTime)
+        waitTime = delayedAckWaitTime;
+    uint32_t fragmentWaitTime = fragmentTimers->getTimeUntilNext(now);
+    if (fragmentWaitTime < waitTime)
+        waitTime = fragmentWaitTime;
+    if (streamsWaiting && LM_STREAM_RETRY_DELAY < waitTime)
+        waitTime = LM_STREAM_RETRY_DELAY;
+    if (spoolWaiting && LM_SPOOL_DRAIN_INTERVAL < waitTime)
+        waitTime = LM_SPOOL_DRAIN_INTERVAL;
+    if (otaWaitTime < waitTime)
+        waitTime = otaWaitTime;
+    if (metricsWaitTime < waitTime)
+        waitTime = metricsWaitTime;
+    if (discoveryWaitTime < waitTime)
+        waitTime = discoveryWaitTime;
+
+    return waitTime;
+}
+
+void LoraMesher::reactorRoutine() {
+    ESP_LOGV(LM_TAG, "Single task routine started");
+    vTaskSuspend(NULL);
+
+#ifdef ARDUINO
+    randomSeed(getLocalAddress());
+#else
+    srand(getLocalAddress());
+#endif
+
+    startHelloStep();
+    lastRoutingTablePrint = millis();
+
+    // Time until a deadline in ms, 0 if it has passed
+    auto untilDue = [](uint32_t deadline, uint32_t now) -> uint32_t {
+        return (int32_t) (deadline - now) > 0 ? deadline - now : 0;
+    };
+
+    // Deadline of each periodic step, its event runs it before
+    uint32_t helloAt = millis();
+    uint32_t routesAt = helloAt;
+    uint32_t queuesAt = helloAt;
+    bool queuesIdle = false;
+
+    uint32_t events = EVENT_SEND;
+
+    for (;;) {
+        // An interrupt given before the transmission started has nothing to read, the radio is sending
+        if ((events & EVENT_RX) && reactorSend.step != SEND_ON_AIR)
+            receiveStep();
+        if (events & EVENT_SECONDARY_RX)
+            secondaryReceiveStep();
+
+        processStep();
+
+        uint32_t now = millis();
+        if ((events & EVENT_HELLO) || untilDue(helloAt, now) == 0)
+            helloAt = now + helloStep();
+        if ((events & EVENT_ROUTE_TIMER) || untilDue(routesAt, now) == 0)
+            routesAt = now + routingTableStep();
+        if ((events & EVENT_QUEUE_TIMER) || (!queuesIdle && untilDue(queuesAt, now) == 0)) {
+            uint32_t queuesWait = queueManagerStep();
+            queuesIdle = queuesWait == UINT32_MAX;
+            queuesAt = now + queuesWait;
+        }
+
+        uint32_t waitTime = sendStep(events);
+
+        now = millis();
+        if (untilDue(helloAt, now) < waitTime)
+            waitTime = untilDue(helloAt, now);
+        if (untilDue(routesAt, now) < waitTime)
+            waitTime = untilDue(routesAt, now);
+        if (!queuesIdle && untilDue(queuesAt, now) < waitTime)
+            waitTime = untilDue(queuesAt, now);
+        if (getDelayedFramesWait() < waitTime)
+            waitTime = getDelayedFramesWait();
+
+        ESP_LOGV(LM_TAG, "Stack space unused after entering the task: %d", uxTaskGetStackHighWaterMark(NULL));
+
+        events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, waitTime == UINT32_MAX ? portMAX_DELAY : waitTime / portTICK_PERIOD_MS + 1);
+    }
+}
+
+uint32_t LoraMesher::sendStep(uint32_t events) {
+    for (;;) {
+        uint32_t now = millis();
+
+        switch (reactorSend.step) {
+            case SEND_IDLE: {
+                if (ToSendPackets->getLength() == 0)
+                    return UINT32_MAX;
+
+                QueuePacket<Packet<uint8_t>>* tx = popAndPreparePacket(reactorSend.sendId);
+                notifySendQueueRoom();
+                if (!tx)
+                    continue;
+
+                recordState(LM_StateType::STATE_TYPE_SENT, tx->packet);
+
+                if (isBackboneFrame(tx)) {
+                    sendBackbone(tx);
+                    continue;
+                }
+
+                reactorSend.packet = tx;
+                reactorSend.takenAt = now;
+                reactorSend.step = SEND_BUDGET;
+                break;
+            }
+            case SEND_BUDGET: {
+                uint32_t wait = takeAirtimeBudget(reactorSend.packet);
+                if (wait > 0)
+                    return wait;
+
+                // Listen on the channel of the packet while waiting, the channel is sensed before sending
+                listenFrequency = getTransmissionFrequency(reactorSend.packet);
+                if (listenFrequency != currentFrequency)
+                    startReceiving();
+
+                reactorSend.step = SEND_SLOT;
+                break;
+            }
+            case SEND_SLOT: {
+                if (TdmaService::isEnabled()) {
+                    int32_t wait = TdmaService::getTransmitWait(AirtimeService::getTimeOnAirMs(reactorSend.packet->packet->packetSize));
+                    if (wait > 0)
+                        return wait;
+
+                    // The slots of the node are free within two hops, the channel is not sensed
+                    if (wait == 0) {
+                        incStat(stats.tdmaSlotSendsNum);
+                        reactorSend.backoffStart = now;
+                        LM_HOOK(HOOK_BACKOFF_START, reactorSend.packet->packet, 0);
+                        reactorSend.step = SEND_TRANSMIT;
+                        break;
+                    }
+                }
+
+                reactorSend.backoffStart = now;
+                LM_HOOK(HOOK_BACKOFF_START, reactorSend.packet->packet, 0);
+                reactorSend.attempt = 0;
+                reactorSend.step = startSendBackoff(now) ? SEND_BACKOFF : SEND_TRANSMIT;
+                break;
+            }
+            case SEND_BACKOFF: {
+                if ((int32_t) (reactorSend.deadline - now) > 0)
+                    return reactorSend.deadline - now;
+
+                if (isChannelFreeAfterBackoff()) {
+                    reactorSend.step = SEND_TRANSMIT;
+                    break;
+                }
+
+                reactorSend.attempt++;
+                reactorSend.step = startSendBackoff(now) ? SEND_BACKOFF : SEND_TRANSMIT;
+                break;
+            }
+            case SEND_TRANSMIT: {
+                recordStat(stats.backoff, now - reactorSend.backoffStart);
+
+                Packet<uint8_t>* p = reactorSend.packet->packet;
+                LM_HOOK(HOOK_BACKOFF_END, p, now - reactorSend.backoffStart);
+                HopTraceService::endHop(p, reactorSend.backoffStart - reactorSend.takenAt, now - reactorSend.backoffStart);
+                if (!startTransmission(p)) {
+                    reactorSend.deadline = now + completeSend(reactorSend.packet, false, reactorSend.resendMessage);
+                    reactorSend.packet = nullptr;
+                    reactorSend.step = SEND_GAP;
+                    break;
+                }
+
+                // A transmission done read before this transmission started is not of it
+                events &= ~EVENT_TX_DONE;
+
+                reactorSend.deadline = now + getTransmissionTimeout(p);
+                reactorSend.step = SEND_ON_AIR;
+                break;
+            }
+            case SEND_ON_AIR: {
+                bool done = (events & EVENT_TX_DONE) != 0;
+                if (!done && (int32_t) (reactorSend.deadline - now) > 0)
+                    return reactorSend.deadline - now;
+
+                if (!done)
+                    ESP_LOGE(LM_TAG, "Transmit done not received after %d ms", (int)getTransmissionTimeout(reactorSend.packet->packet));
+
+                events &= ~EVENT_TX_DONE;
+
+                bool hasSend = finishTransmission(done);
+                LM_HOOK(HOOK_TX_END, reactorSend.packet->packet, hasSend ? 1 : 0);
+                reactorSend.deadline = now + completeSend(reactorSend.packet, hasSend, reactorSend.resendMessage);
+                reactorSend.packet = nullptr;
+                reactorSend.step = SEND_GAP;
+                break;
+            }
+            case SEND_GAP: {
+                if ((int32_t) (reactorSend.deadline - now) > 0)
+                    return reactorSend.deadline - now;
+
+                reactorSend.step = SEND_IDLE;
+                break;
+            }
+        }
+    }
+}
+
+bool LoraMesher::startSendBackoff(uint32_t now) {
+    uint8_t attempt = reactorSend.attempt;
+    uint32_t backoff;
+
+    if (loraMesherConfig->cadListenBeforeTalk) {
+        if (attempt >= loraMesherConfig->cadMaxAttempts) {
+            ESP_LOGW(LM_TAG, "Channel busy after %d attempts, sending anyway", attempt);
+            return false;
+        }
+
+        backoff = getBackoffTime(attempt);
+    }
+    else {
+        // The limit of waitBeforeSend, it starts with one repeated detected preamble
+        if ((size_t) attempt + 1 > RoutingTableService::routingTableSize())
+            return false;
+
+        backoff = getPropagationTimeWithRandom(attempt + 1);
+    }
+
+    ESP_LOGV(LM_TAG, "Backoff %d ms, attempt %d", (int)backoff, attempt);
+
+    hasReceivedMessage = false;
+    reactorSend.deadline = now + backoff;
+    return true;
+}
+
+bool LoraMesher::isChannelFreeAfterBackoff() {
+    if (loraMesherConfig->cadListenBeforeTalk) {
+        // A packet received during the backoff means that the channel is busy, it does not need a scan
+        if (!hasReceivedMessage && !channelScan())
+            return true;
+
+        incChannelBusy();
+        ESP_LOGV(LM_TAG, "Channel busy, attempt %d", reactorSend.attempt);
+        return false;
+    }
+
+    if (!hasReceivedMessage)
+        return true;
+
+    startReceiving();
+    ESP_LOGV(LM_TAG, "Preamble detected while waiting %d", reactorSend.attempt + 1);
+    return false;
+}
+
+void LoraMesher::printHeaderPacket(Packet<uint8_t>* p, const char* title) {
+    bool isDataPacket = PacketService::isDataPacket(p->type);
+    bool isControlPacket = PacketService::isControlPacket(p->type);
+
+    ESP_LOGI(LM_TAG, "Packet %s -- Size: %d Src: %X Dst: %X Id: %d Type: %d Via: %X Seq_Id: %d Num: %d",
+        title,
+        p->packetSize,
+        p->src,
+        p->dst,
+        p->id,
+        p->type,
+        isDataPacket ? (reinterpret_cast<DataPacket*>(p))->via : 0,
+        isControlPacket ? (reinterpret_cast<ControlPacket*>(p))->seq_id : 0,
+        isControlPacket ? (reinterpret_cast<ControlPacket*>(p))->number : 0);
+}
+
+uint8_t* LoraMesher::encodePayload(const uint8_t* payload, uint32_t& payloadSize, uint8_t port) {
+    //The port goes first, it is compressed and encrypted with the payload
+    uint8_t* ported = nullptr;
+    if (loraMesherConfig->applicationPorts) {
+        ported = static_cast<uint8_t*>(PacketPoolService::allocateBulk(payloadSize + 1));
+        if (ported == nullptr) {
+            ESP_LOGE(LM_TAG, "Payload of %d bytes with its port not allocated", (int) payloadSize);
+            return nullptr;
+        }
+
+        ported[0] = port;
+        memcpy(ported + 1, payload, payloadSize);
+        payload = ported;
+        payloadSize++;
+    }
+
+    //The counter and the tag are added after the compressed payload
+    size_t maxLength = CompressionService::getMaxEncodedLength(payloadSize);
+    uint8_t* encoded = static_cast<uint8_t*>(PacketPoolService::allocateBulk(maxLength + CryptoService::OVERHEAD));
+    if (encoded == nullptr) {
+        ESP_LOGE(LM_TAG, "Encoded payload of %d bytes not allocated", (int) payloadSize);
+        PacketPoolService::release(ported);
+        return nullptr;
+    }
+
+    size_t encodedSize = payloadSize;
+    if (loraMesherConfig->compressPayloads) {
+        encodedSize = CompressionService::encode(payload, payloadSize, encoded, maxLength);
+        incCompressionBytes(payloadSize, encodedSize);
+    }
+    else
+        memcpy(encoded, payload, payloadSize);
+
+    PacketPoolService::release(ported);
+
+    if (CryptoService::isEnabled()) {
+        if (!CryptoService::encrypt(getLocalAddress(), encoded, encodedSize)) {
+            PacketPoolService::release(encoded);
+            return nullptr;
+        }
+        encodedSize += CryptoService::OVERHEAD;
+    }
+
+    ESP_LOGV(LM_TAG, "Payload of %d bytes encoded in %d bytes", (int) payloadSize, (int) encodedSize);
+
+    payloadSize = encodedSize;
+    return encoded;
+}
+
+bool LoraMesher::decryptPayload(uint16_t src, uint8_t* payload, size_t& payloadSize) {
+    size_t decryptedSize = CryptoService::decrypt(src, payload, payloadSize);
+    if (decryptedSize == 0) {
+        ESP_LOGW(LM_TAG, "Payload from %X dropped, wrong tag", src);
+        incPayloadAuthFailed();
+        return false;
+    }
+
+    payloadSize = decryptedSize;
+    return true;
+}
+
+AppPacket<uint8_t>* LoraMesher::decodeAppPacket(AppPacket<uint8_t>* appPacket) {
+    size_t decodedSize = CompressionService::getDecodedLength(appPacket->payload, appPacket->payloadSize);
+    if (decodedSize == 0) {
+        ESP_LOGE(LM_TAG, "Malformed encoded payload from %X, size: %d", appPacket->src, (int) appPacket->payloadSize);
+        deletePacket(appPacket);
+        return nullptr;
+    }
+
+    //A raw payload is only moved over the codec byte
+    if (appPacket->payload[0] == CompressionService::CODEC_RAW) {
+        memmove(appPacket->payload, appPacket->payload + 1, decodedSize);
+        appPacket->payloadSize = decodedSize;
+        return appPacket;
+    }
+
+    AppPacket<uint8_t>* decoded = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocateBulk(sizeof(AppPacket<uint8_t>) + decodedSize));
+    if (decoded == nullptr) {
+        ESP_LOGE(LM_TAG, "Decoded payload of %d bytes from %X not allocated", (int) decodedSize, appPacket->src);
+        deletePacket(appPacket);
+        return nullptr;
+    }
+
+    //Same metadata, with the decoded payload
+    memcpy(decoded, appPacket, sizeof(AppPacket<uint8_t>));
+    decoded->payloadSize = CompressionService::decode(appPacket->payload, appPacket->payloadSize, decoded->payload, decodedSize);
+    deletePacket(appPacket);
+
+    if (decoded->payloadSize == 0) {
+        ESP_LOGE(LM_TAG, "Malformed compressed payload from %X", decoded->src);
+        deletePacket(decoded);
+        return nullptr;
+    }
+
+    return decoded;
+}
+
+LM_EnqueueResult LoraMesher::sendMulticast(uint8_t role, const uint8_t* payload, uint32_t payloadSize) {
+    if (role == ROLE_DEFAULT || payloadSize == 0)
+        return ENQUEUE_INVALID;
+
+    uint8_t* encoded = nullptr;
+    if (isPayloadEncoded()) {
+        encoded = encodePayload(payload, payloadSize);
+        if (encoded == nullptr)
+            return ENQUEUE_INVALID;
+        payload = encoded;
+    }
+
+    if (payloadSize >= PacketService::getMaximumPayloadLength(DATA_P)) {
+        PacketPoolService::release(encoded);
+        return ENQUEUE_INVALID;
+    }
+
+    uint16_t nextHops[LM_MULTICAST_MAX_BRANCHES];
+    uint8_t hopsLeft[LM_MULTICAST_MAX_BRANCHES];
+    if (RoutingTableService::getMulticastNextHops(role, 0, LM_MULTICAST_MAX_HOPS, nextHops, hopsLeft) == 0) {
+        PacketPoolService::release(encoded);
+        return ENQUEUE_NO_ROUTE;
+    }
+
+    ESP_LOGV(LM_TAG, "Sending multicast payload with %d bytes to role %X", (int) payloadSize, role);
+
+    // The hops left are sent after the payload
+    uint8_t multicastPayload[LM_MAX_PACKET_SIZE];
+    memcpy(multicastPayload, payload, payloadSize);
+    multicastPayload[payloadSize] = LM_MULTICAST_MAX_HOPS;
+    PacketPoolService::release(encoded);
+
+    DataPacket* dPacket = PacketService::createDataPacket(RoleService::getMulticastAddress(role), getLocalAddress(), DATA_P, multicastPayload, payloadSize + 1);
+    return setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), DEFAULT_PRIORITY);
+}
+
+LM_EnqueueResult LoraMesher::sendFlood(const uint8_t* payload, uint32_t payloadSize, uint8_t port) {
+    if (payloadSize == 0)
+        return ENQUEUE_INVALID;
+
+    uint8_t* encoded = nullptr;
+    if (isPayloadEncoded()) {
+        encoded = encodePayload(payload, payloadSize, port);
+        if (encoded == nullptr)
+            return ENQUEUE_INVALID;
+        payload = encoded;
+    }
+
+    if (payloadSize >= PacketService::getMaximumPayloadLength(DATA_P)) {
+        PacketPoolService::release(encoded);
+        return ENQUEUE_INVALID;
+    }
+
+    ESP_LOGV(LM_TAG, "Flooding payload with %d bytes", (int) payloadSize);
+
+    // The hops left are sent after the payload
+    uint8_t floodPayload[LM_MAX_PACKET_SIZE];
+    memcpy(floodPayload, payload, payloadSize);
+    floodPayload[payloadSize] = LM_FLOOD_MAX_HOPS;
+    PacketPoolService::release(encoded);
+
+    DataPacket* dPacket = PacketService::createDataPacket(LM_FLOOD_ADDRESS, getLocalAddress(), DATA_P, floodPayload, payloadSize + 1);
+    return setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), DEFAULT_PRIORITY);
+}
+
+LM_EnqueueResult LoraMesher::sendDatagram(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, uint8_t port) {
+    // The fragments are joined only by their destination
+    if (payloadSize == 0 || dst >= LM_MULTICAST_ADDRESS)
+        return ENQUEUE_INVALID;
+
+    uint8_t* encoded = nullptr;
+    if (isPayloadEncoded()) {
+        encoded = encodePayload(payload, payloadSize, port);
+        if (encoded == nullptr)
+            return ENQUEUE_INVALID;
+        payload = encoded;
+    }
+
+    LM_EnqueueResult result = sendFragments(dst, payload, payloadSize);
+    PacketPoolService::release(encoded);
+    return result;
+}
+
+LM_EnqueueResult LoraMesher::sendFragments(uint16_t dst, const uint8_t* payload, uint32_t payloadSize) {
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(XL_DATA_P);
+    uint32_t count = (payloadSize + maxPayloadSize - 1) / maxPayloadSize;
+
+    if (count > LM_MAX_FRAGMENTS)
+        return ENQUEUE_INVALID;
+
+    uint8_t id = datagramId++;
+
+    ESP_LOGV(LM_TAG, "Sending datagram %d with %d bytes in %d fragments to %X", id, (int) payloadSize, (int) count, dst);
+
+    for (uint32_t i = 0; i < count; i++) {
+        size_t fragmentSize = i + 1 == count ? payloadSize - i * maxPayloadSize : maxPayloadSize;
+
+        ControlPacket* cPacket = PacketService::createControlPacket(dst, getLocalAddress(), XL_DATA_P,
+            const_cast<uint8_t*>(payload + i * maxPayloadSize), fragmentSize);
+        if (cPacket == nullptr)
+            return ENQUEUE_INVALID;
+
+        cPacket->seq_id = id;
+        cPacket->number = getFragmentNumber(i, count);
+
+        // The destination discards the datagram without the rest of the fragments
+        LM_EnqueueResult result = setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY);
+        if (!isEnqueued(result))
+            return result;
+    }
+
+    return ENQUEUE_OK;
+}
+
+void LoraMesher::processFragmentPacket(QueuePacket<ControlPacket>* pq) {
+    ControlPacket* cPacket = pq->packet;
+    uint8_t index = cPacket->number >> 8;
+    uint8_t count = cPacket->number & 0xFF;
+
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(XL_DATA_P);
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
+
+    //All the fragments except the last one are full
+    if (count == 0 || count > LM_MAX_FRAGMENTS || index >= count || payloadSize == 0 || payloadSize > maxPayloadSize ||
+        (index + 1 != count && payloadSize != maxPayloadSize)) {
+        ESP_LOGE(LM_TAG, "Wrong fragment %d of %d of the datagram %d from %X, size: %d", index, count, cPacket->seq_id, cPacket->src, payloadSize);
+        return;
+    }
+
+    auto findSlot = [this, cPacket, count]() -> FragmentSlot* {
+        for (size_t i = 0; i < LM_FRAGMENT_SLOTS; i++) {
+            FragmentSlot* slot = &fragmentSlots[i];
+            if (slot->appPacket != nullptr && slot->src == cPacket->src && slot->id == cPacket->seq_id && slot->count == count)
+                return slot;
+        }
+        return nullptr;
+    };
+
+    portENTER_CRITICAL(&fragmentMux);
+    bool found = findSlot() != nullptr;
+    portEXIT_CRITICAL(&fragmentMux);
+
+    //The reassembly buffer of a new datagram is allocated outside of the critical section
+    AppPacket<uint8_t>* buffer = nullptr;
+    if (!found) {
+        buffer = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocateBulk(sizeof(AppPacket<uint8_t>) + count * maxPayloadSize));
+        if (buffer == nullptr) {
+            ESP_LOGE(LM_TAG, "Datagram %d from %X not allocated", cPacket->seq_id, cPacket->src);
+            return;
+        }
+    }
+
+    uint32_t deadline = millis() + LM_FRAGMENT_TIMEOUT;
+    FragmentSlot* armed = nullptr;
+    AppPacket<uint8_t>* complete = nullptr;
+
+    portENTER_CRITICAL(&fragmentMux);
+    FragmentSlot* slot = findSlot();
+    for (size_t i = 0; slot == nullptr && buffer != nullptr && i < LM_FRAGMENT_SLOTS; i++) {
+        if (fragmentSlots[i].appPacket != nullptr)
+            continue;
+
+        slot = &fragmentSlots[i];
+        slot->appPacket = buffer;
+        slot->appPacket->payloadSize = 0;
+        slot->src = cPacket->src;
+        slot->id = cPacket->seq_id;
+        slot->count = count;
+        slot->received = 0;
+        slot->deadline = deadline;
+        buffer = nullptr;
+        armed = slot;
+    }
+
+    if (slot != nullptr && (slot->received & (1u << index)) == 0) {
+        memcpy(slot->appPacket->payload + index * maxPayloadSize, cPacket->payload, payloadSize);
+        slot->received |= 1u << index;
+        slot->appPacket->payloadSize += payloadSize;
+
+        if (slot->received == (uint32_t) ((1ull << count) - 1)) {
+            complete = slot->appPacket;
+            slot->appPacket = nullptr;
+        }
+    }
+    portEXIT_CRITICAL(&fragmentMux);
+
+    //Another fragment of the same datagram took a slot meanwhile
+    if (buffer != nullptr)
+        PacketPoolService::release(buffer);
+
+    if (slot == nullptr) {
+        ESP_LOGW(LM_TAG, "No free fragment slot, datagram %d from %X discarded", cPacket->seq_id, cPacket->src);
+        incDatagramsIncomplete();
+        return;
+    }
+
+    // The timer of a completed slot is left armed, it finds the slot free or reused with a later deadline
+    if (armed != nullptr && complete == nullptr)
+        fragmentTimers->arm(&armed->timer, deadline);
+
+    if (complete == nullptr)
+        return;
+
+    ESP_LOGV(LM_TAG, "Datagram %d from %X received, %d bytes", cPacket->seq_id, cPacket->src, (int) complete->payloadSize);
+
+    complete->src = cPacket->src;
+    complete->dst = getLocalAddress();
+    setAppPacketMetadata(complete, pq);
+
+    notifyUserReceivedPacket(complete);
+}
+
+void LoraMesher::managerFragments() {
+    fragmentTimers->expire(millis(), [this](LM_Timer* timer) {
+        FragmentSlot* slot = static_cast<FragmentSlot*>(timer->context);
+        AppPacket<uint8_t>* incomplete = nullptr;
+        uint16_t src = 0;
+        uint8_t id = 0;
+
+        // A slot completed and reused meanwhile has a later deadline
+        portENTER_CRITICAL(&fragmentMux);
+        if (slot->appPacket != nullptr && (int32_t) (millis() - slot->deadline) >= 0) {
+            incomplete = slot->appPacket;
+            src = slot->src;
+            id = slot->id;
+            slot->appPacket = nullptr;
+        }
+        portEXIT_CRITICAL(&fragmentMux);
+
+        if (incomplete == nullptr)
+            return;
+
+        ESP_LOGW(LM_TAG, "Datagram %d from %X discarded without all its fragments", id, src);
+        incDatagramsIncomplete();
+        PacketPoolService::release(incomplete);
+    });
+}
+
+LM_EnqueueResult LoraMesher::sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize, uint8_t fecGroup) {
+    // Cannot send an empty packet
+    if (payloadSize == 0 || fecGroup > LM_SACK_BITS)
+        return ENQUEUE_INVALID;
+    if (dst == BROADCAST_ADDR) {
+        ESP_LOGW(LM_TAG, "Be aware of sending a reliable packet to the broadcast address");
+        LM_EnqueueResult result = ENQUEUE_OK;
+        RoutingTableView view;
+        for (size_t i = 0; i < view.size(); i++) {
+            LM_EnqueueResult nodeResult = sendReliablePacket(view[i].networkNode.address, payload, payloadSize, fecGroup);
+            if (!isEnqueued(nodeResult))
+                result = nodeResult;
+        }
+
+        return result;
+    }
+    ESP_LOGV(LM_TAG, "Sending reliable payload with %d bytes to %X", (int)payloadSize, dst);
+
+    // Get the Routing Table node of the destination
+    RouteNode* node = RoutingTableService::findRoute(dst);
+
+    if (node == NULL) {
+        ESP_LOGV(LM_TAG, "Destination not found in the routing table");
+        return ENQUEUE_NO_ROUTE;
+    }
+
+    return startSequence(dst, node, payload, payloadSize, nullptr, fecGroup);
+}
+
+LM_EnqueueResult LoraMesher::sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize, uint8_t fecGroup,
+    LM_TransferHandle& handle, const LM_TransferOptions& options) {
+    handle = 0;
+
+    if (payloadSize == 0 || fecGroup > LM_SACK_BITS || dst == BROADCAST_ADDR)
+        return ENQUEUE_INVALID;
+
+    RouteNode* node = RoutingTableService::findRoute(dst);
+    if (node == NULL) {
+        ESP_LOGV(LM_TAG, "Destination not found in the routing table");
+        return ENQUEUE_NO_ROUTE;
+    }
+
+    LM_TransferHandle transfer = TransferService::start(dst, options);
+    if (transfer == 0)
+        ESP_LOGW(LM_TAG, "Too many transfers pending, reliable payload to %X not tracked", dst);
+
+    LM_EnqueueResult result = startSequence(dst, node, payload, payloadSize, nullptr, fecGroup, transfer);
+    if (!isEnqueued(result)) {
+        TransferService::cancel(transfer);
+        return result;
+    }
+
+    handle = transfer;
+    return result;
+}
+
+LM_EnqueueResult LoraMesher::sendReliableStream(uint16_t dst, uint32_t totalLength, LM_ReadChunk readChunk, void* context,
+    uint8_t fecGroup, LM_TransferHandle& handle, const LM_TransferOptions& options) {
+    handle = 0;
+
+    if (totalLength == 0 || readChunk == nullptr || fecGroup > LM_SACK_BITS || dst == BROADCAST_ADDR)
+        return ENQUEUE_INVALID;
+
+    //The packets would be encoded one by one, the destination decodes the whole payload
+    if (isPayloadEncoded()) {
+        ESP_LOGW(LM_TAG, "A reliable stream cannot be sent with encoded payloads");
+        return ENQUEUE_INVALID;
+    }
+
+    //The packets are numbered with 16 bits
+    if (totalLength > (uint32_t) UINT16_MAX * PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P))
+        return ENQUEUE_INVALID;
+
+    RouteNode* node = RoutingTableService::findRoute(dst);
+    if (node == NULL) {
+        ESP_LOGV(LM_TAG, "Destination not found in the routing table");
+        return ENQUEUE_NO_ROUTE;
+    }
+
+    //The application releases the source when the transfer ends, it must be tracked
+    LM_TransferHandle transfer = TransferService::start(dst, options);
+    if (transfer == 0) {
+        ESP_LOGW(LM_TAG, "Too many transfers pending, reliable stream to %X not started", dst);
+        return ENQUEUE_INVALID;
+    }
+
+    ESP_LOGV(LM_TAG, "Sending reliable stream with %d bytes to %X", (int) totalLength, dst);
+
+    LM_EnqueueResult result = startSequence(dst, node, nullptr, totalLength, nullptr, fecGroup, transfer, readChunk, context);
+    if (!isEnqueued(result)) {
+        TransferService::cancel(transfer);
+        return result;
+    }
+
+    handle = transfer;
+    return result;
+}
+
+LM_EnqueueResult LoraMesher::startSequence(uint16_t dst, RouteNode* node, uint8_t* payload, uint32_t payloadSize, StreamConfig* stream,
+    uint8_t fecGroup, LM_TransferHandle transfer, LM_ReadChunk readChunk, void* readContext) {
+    //Generate a sequence Id for this list of packets
+    uint16_t seq_id;
+    if (!getSequenceId(dst, seq_id)) {
+        ESP_LOGW(LM_TAG, "Too many reliable sequences to %X", dst);
+        return ENQUEUE_QUEUE_FULL;
+    }
+
+    //The packets copy the encoded payload, it is released once they are created
+    uint8_t* encoded = nullptr;
+    if (readChunk == nullptr && isPayloadEncoded()) {
+        encoded = encodePayload(payload, payloadSize);
+        if (encoded == nullptr)
+            return ENQUEUE_INVALID;
+        payload = encoded;
+    }
+
+    //Get the Type of the packet
+    uint8_t type = NEED_ACK_P | XL_DATA_P;
+
+    //Max payload size per packet
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
+
+    //Number of packets
+    uint16_t numOfPackets = payloadSize / maxPayloadSize + (payloadSize % maxPayloadSize > 0);
+
+    //Create a new Linked list to store the QueuePackets and the payload
+    LM_LinkedList<QueuePacket<ControlPacket>>* packetList = new LM_LinkedList<QueuePacket<ControlPacket>>();
+
+    //Add the SYNC configuration packet
+    uint8_t lastSize = payloadSize - (maxPayloadSize * (numOfPackets - 1));
+    packetList->Append(getStartSequencePacketQueue(dst, seq_id, numOfPackets, fecGroup, lastSize));
+
+
+    //With a source the packets are read when they are sent
+    uint16_t storedPackets = readChunk == nullptr ? numOfPackets : 0;
+
+    for (uint16_t i = 1; i <= storedPackets; i++) {
+        //Get the position of the payload
+        uint8_t* payloadToSend = reinterpret_cast<uint8_t*>((unsigned long)payload + ((i - 1) * maxPayloadSize));
+
+        //Get the payload Size in bytes
+        size_t payloadSizeToSend = maxPayloadSize;
+        if (i == numOfPackets)
+            payloadSizeToSend = payloadSize - (maxPayloadSize * (numOfPackets - 1));
+
+        ESP_LOGV(LM_TAG, "Payload Size: %d", payloadSizeToSend);
+
+        //Create a new packet with the previous payload
+        //It is copied every time it is sent, the stored one is a bulk buffer
+        ControlPacket* cPacket = PacketService::createControlPacket(dst, getLocalAddress(), type, payloadToSend, payloadSizeToSend, true);
+        cPacket->number = i;
+        cPacket->seq_id = seq_id;
+
+        //Create a packet queue
+        QueuePacket<ControlPacket>* pq = PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, i);
+
+        //Append the packet queue in the linked list
+        packetList->Append(pq);
+    }
+
+    //The parity packets are numbered after the last packet, every one the XOR of its group padded with zeros
+    uint16_t groups = fecGroup == 0 || readChunk != nullptr ? 0 : (numOfPackets + fecGroup - 1) / fecGroup;
+    for (uint16_t group = 0; group < groups; group++) {
+        uint8_t parity[LM_MAX_PACKET_SIZE] = {0};
+
+        for (uint32_t offset = (uint32_t) group * fecGroup * maxPayloadSize;
+            offset < payloadSize && offset < (uint32_t) (group + 1) * fecGroup * maxPayloadSize; offset++)
+            parity[offset % maxPayloadSize] ^= payload[offset];
+
+        ControlPacket* cPacket = PacketService::createControlPacket(dst, getLocalAddress(), type, parity, maxPayloadSize, true);
+        cPacket->number = numOfPackets + 1 + group;
+        cPacket->seq_id = seq_id;
+
+        packetList->Append(PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY + 1, cPacket->number));
+    }
+
+    PacketPoolService::release(encoded);
+
+    //Create the pair of configuration
+    listConfiguration* listConfig = new listConfiguration();
+    listConfig->config = new sequencePacketConfig(seq_id, dst, numOfPackets, node, wspTimers, listConfig);
+    listConfig->list = packetList;
+    listConfig->stream = stream;
+    listConfig->fecGroup = fecGroup;
+    listConfig->transfer = transfer;
+    listConfig->readChunk = readChunk;
+    listConfig->readContext = readContext;
+    listConfig->payloadSize = payloadSize;
+    listConfig->memoryBytes = sizeof(listConfiguration) + sizeof(sequencePacketConfig) + sizeof(*packetList);
+    MemoryService::add(MEMORY_SEQUENCES, listConfig->memoryBytes);
+
+    // Set the RTT of the first packet of the sequence
+    listConfig->config->calculatingRTT = millis();
+
+    // Set the timeout of the first packet of the sequence
+    addTimeout(listConfig->config);
+
+    //Add dataList pair to the waiting send packets queue
+    if (!appendSequence(q_WSP, listConfig)) {
+        listConfig->stream = nullptr;
+        listConfig->transfer = 0;
+        clearLinkedList(listConfig);
+        return ENQUEUE_INVALID;
+    }
+
+    //Send the first packet of the sequence (SYNC packet). The sequence is not started if the send queue is full
+    LM_EnqueueResult result = sendPacketSequence(listConfig, 0);
+    if (!isEnqueued(result)) {
+        ESP_LOGW(LM_TAG, "Reliable sequence to %X not started, SYNC packet not queued", dst);
+        // The stream keeps the chunk and starts it again later, the transfer is not started
+        listConfig->stream = nullptr;
+        listConfig->transfer = 0;
+        findAndClearLinkedList(q_WSP, listConfig);
+        return result;
+    }
+
+    // Notify the queueManager that a new sequence has been started
+    notifyNewSequenceStarted();
+
+    return result;
+}
+
+uint8_t LoraMesher::openStream(uint16_t dst) {
+    if (dst == BROADCAST_ADDR || dst == 0)
+        return 0;
+
+    uint8_t id = 0;
+
+    portENTER_CRITICAL(&streamsMux);
+    for (uint8_t i = 0; i < LM_MAX_STREAMS; i++) {
+        StreamConfig* stream = &streams[i];
+        if (stream->destination != 0)
+            continue;
+
+        stream->destination = dst;
+        stream->closing = false;
+        stream->sending = false;
+        stream->firstChunk = 0;
+        stream->chunkCount = 0;
+        stream->chunkAttempts = 0;
+        stream->congestionWindow = LM_STREAM_INITIAL_WINDOW;
+        stream->slowStartThreshold = LM_SACK_BITS + 1;
+        stream->lastDecrease = 0;
+        id = i + 1;
+        break;
+    }
+    portEXIT_CRITICAL(&streamsMux);
+
+    if (id == 0)
+        ESP_LOGW(LM_TAG, "Too many streams, not opening a stream to %X", dst);
+
+    return id;
+}
+
+LM_EnqueueResult LoraMesher::writeStream(uint8_t streamId, const uint8_t* payload, uint32_t payloadSize) {
+    StreamConfig* stream = getStream(streamId);
+    if (stream == nullptr || payloadSize == 0)
+        return ENQUEUE_INVALID;
+
+    uint32_t chunks = (payloadSize + LM_STREAM_CHUNK_SIZE - 1) / LM_STREAM_CHUNK_SIZE;
+    if (chunks > LM_STREAM_CHUNKS)
+        return ENQUEUE_INVALID;
+
+    portENTER_CRITICAL(&streamsMux);
+    bool open = stream->destination != 0 && !stream->closing;
+    uint8_t freeChunks = LM_STREAM_CHUNKS - stream->chunkCount;
+    portEXIT_CRITICAL(&streamsMux);
+
+    if (!open)
+        return ENQUEUE_INVALID;
+    if (chunks > freeChunks)
+        return ENQUEUE_QUEUE_FULL;
+
+    // Copy the payload outside of the critical section
+    uint8_t* buffers[LM_STREAM_CHUNKS];
+    uint16_t sizes[LM_STREAM_CHUNKS];
+    for (uint32_t i = 0; i < chunks; i++) {
+        sizes[i] = i + 1 == chunks ? payloadSize - i * LM_STREAM_CHUNK_SIZE : LM_STREAM_CHUNK_SIZE;
+        buffers[i] = static_cast<uint8_t*>(PacketPoolService::allocateBulk(sizes[i]));
+        if (buffers[i] == nullptr) {
+            ESP_LOGE(LM_TAG, "Stream chunk of %d bytes not allocated", sizes[i]);
+            for (uint32_t j = 0; j < i; j++)
+                PacketPoolService::release(buffers[j]);
+            return ENQUEUE_INVALID;
+        }
+
+        memcpy(buffers[i], payload + i * LM_STREAM_CHUNK_SIZE, sizes[i]);
+    }
+
+    portENTER_CRITICAL(&streamsMux);
+    // The stream can fail while copying
+    bool written = stream->destination != 0 && !stream->closing && chunks <= (uint32_t) (LM_STREAM_CHUNKS - stream->chunkCount);
+    if (written) {
+        for (uint32_t i = 0; i < chunks; i++) {
+            uint8_t position = (stream->firstChunk + stream->chunkCount) % LM_STREAM_CHUNKS;
+            stream->chunks[position] = buffers[i];
+            stream->chunkSizes[position] = sizes[i];
+            stream->chunkCount++;
+        }
+    }
+    portEXIT_CRITICAL(&streamsMux);
+
+    if (!written) {
+        for (uint32_t i = 0; i < chunks; i++)
+            PacketPoolService::release(buffers[i]);
+        return ENQUEUE_INVALID;
+    }
+
+    sendStreams();
+
+    return ENQUEUE_OK;
+}
+
+void LoraMesher::closeStream(uint8_t streamId) {
+    StreamConfig* stream = getStream(streamId);
+    if (stream == nullptr)
+        return;
+
+    portENTER_CRITICAL(&streamsMux);
+    if (stream->destination != 0) {
+        // The slot is freed by endStreamSequence after the last chunk
+        if (stream->sending || stream->chunkCount > 0)
+            stream->closing = true;
+        else
+            stream->destination = 0;
+    }
+    portEXIT_CRITICAL(&streamsMux);
+}
+
+bool LoraMesher::isStreamOpen(uint8_t streamId) {
+    StreamConfig* stream = getStream(streamId);
+    if (stream == nullptr)
+        return false;
+
+    portENTER_CRITICAL(&streamsMux);
+    bool open = stream->destination != 0 && !stream->closing;
+    portEXIT_CRITICAL(&streamsMux);
+
+    return open;
+}
+
+uint8_t LoraMesher::getStreamWindow(uint8_t streamId) {
+    StreamConfig* stream = getStream(streamId);
+    if (stream == nullptr)
+        return 0;
+
+    portENTER_CRITICAL(&streamsMux);
+    uint8_t window = stream->destination != 0 && !stream->closing ? (uint8_t) stream->congestionWindow : 0;
+    portEXIT_CRITICAL(&streamsMux);
+
+    return window;
+}
+
+bool LoraMesher::sendStreams() {
+    bool waiting = false;
+
+    for (uint8_t i = 0; i < LM_MAX_STREAMS; i++) {
+        StreamConfig* stream = &streams[i];
+
+        portENTER_CRITICAL(&streamsMux);
+        bool start = stream->destination != 0 && !stream->sending && stream->chunkCount > 0;
+        uint16_t dst = stream->destination;
+        uint8_t* chunk = nullptr;
+        uint16_t chunkSize = 0;
+        // Only one task starts the head chunk
+        if (start) {
+            stream->sending = true;
+            chunk = stream->chunks[stream->firstChunk];
+            chunkSize = stream->chunkSizes[stream->firstChunk];
+        }
+        portEXIT_CRITICAL(&streamsMux);
+
+        if (!start)
+            continue;
+
+        RouteNode* node = RoutingTableService::findRoute(dst);
+        LM_EnqueueResult result = node == NULL ? ENQUEUE_NO_ROUTE : startSequence(dst, node, chunk, chunkSize, stream);
+        if (isEnqueued(result))
+            continue;
+
+        ESP_LOGV(LM_TAG, "Stream chunk to %X not started, trying again later", dst);
+
+        portENTER_CRITICAL(&streamsMux);
+        stream->sending = false;
+        portEXIT_CRITICAL(&streamsMux);
+
+        waiting = true;
+    }
+
+    return waiting;
+}
+
+void LoraMesher::endStreamSequence(StreamConfig* stream, bool delivered) {
+    uint8_t* released[LM_STREAM_CHUNKS];
+    uint8_t releasedNum = 0;
+
+    portENTER_CRITICAL(&streamsMux);
+    stream->sending = false;
+
+    // The queue manager starts it again
+    if (!delivered && ++stream->chunkAttempts < LM_STREAM_CHUNK_ATTEMPTS) {
+        portEXIT_CRITICAL(&streamsMux);
+        return;
+    }
+
+    stream->chunkAttempts = 0;
+
+    // A chunk not delivered breaks the order of the stream, the rest are dropped
+    while (stream->chunkCount > 0 && (!delivered || releasedNum == 0)) {
+        released[releasedNum++] = stream->chunks[stream->firstChunk];
+        stream->firstChunk = (stream->firstChunk + 1) % LM_STREAM_CHUNKS;
+        stream->chunkCount--;
+    }
+
+    if (!delivered || (stream->closing && stream->chunkCount == 0))
+        stream->destination = 0;
+    portEXIT_CRITICAL(&streamsMux);
+
+    if (!delivered)
+        ESP_LOGW(LM_TAG, "Stream chunk not delivered, closing the stream and dropping %d chunks", releasedNum);
+
+    for (uint8_t i = 0; i < releasedNum; i++)
+        PacketPoolService::release(released[i]);
+}
+
+void LoraMesher::processDataPacket(QueuePacket<DataPacket>* pq) {
+    DataPacket* packet = pq->packet;
+
+    if (loraMesherConfig->hopAck && PacketService::isOnlyDataPacket(packet->type)) {
+        processHopAck(packet);
+
+        if (isHopAckPacket(reinterpret_cast<Packet<uint8_t>*>(packet))) {
+            PacketQueueService::deleteQueuePacketAndPacket(pq);
+            return;
+        }
+    }
+
+    incReceivedDataPackets();
+
+    ESP_LOGI(LM_TAG, "Data packet from %X, destination %X, via %X", packet->src, packet->dst, packet->via);
+
+    RoutingTableService::aMessageHasBeenReceivedBy(packet->src);
+
+    if (loraMesherConfig->hopAck && (packet->via == getLocalAddress() || packet->dst == getLocalAddress()) &&
+        needsHopAck(reinterpret_cast<Packet<uint8_t>*>(packet)) && acknowledgeHop(pq))
+        return;
+
+    if (packet->dst == getLocalAddress()) {
+        ESP_LOGV(LM_TAG, "Data packet from %X for me", packet->src);
+        incDataPacketForMe();
+
+        processDataPacketForMe(pq);
+        return;
+
+    }
+    else if (RoleService::isRoleAddress(packet->dst) && packet->via == getLocalAddress() &&
+        RoleService::isRole(RoleService::getAddressRole(packet->dst))) {
+        ESP_LOGV(LM_TAG, "Data packet from %X for my role %X", packet->src, RoleService::getAddressRole(packet->dst));
+        incDataPacketForMe();
+
+        processDataPacketForMe(pq);
+        return;
+    }
+    else if (packet->dst == BROADCAST_ADDR) {
+        ESP_LOGV(LM_TAG, "Data packet from %X BROADCAST", packet->src);
+        incReceivedBroadcast();
+        processDataPacketForMe(pq);
+        return;
+
+    }
+    else if (RoleService::isMulticastAddress(packet->dst) && packet->via == getLocalAddress()) {
+        processMulticastPacket(pq);
+        return;
+    }
+    else if (packet->dst == LM_FLOOD_ADDRESS) {
+        processFloodPacket(pq);
+        return;
+    }
+    else if (packet->via == getLocalAddress()) {
+        ESP_LOGV(LM_TAG, "Data Packet from %X for %X. Via is me. Forwarding it", packet->src, packet->dst);
+        incReceivedIAmVia();
+
+        // The ACKs and lost packets keep their class in every hop, the data is forwarded as bulk
+        if (PacketService::isAckPacket(packet->type) || PacketService::isLostPacket(packet->type))
+            pq->priority = LM_PRIORITY_CONTROL;
+        addToSendOrderedAndNotify(reinterpret_cast<QueuePacket<Packet<uint8_t>>*>(pq));
+        return;
+    }
+
+    ESP_LOGV(LM_TAG, "Packet not for me, deleting it");
+    incReceivedNotForMe();
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
+
+void LoraMesher::processMulticastPacket(QueuePacket<DataPacket>* pq) {
+    DataPacket* packet = pq->packet;
+    Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(packet);
+
+    if (packet->packetSize <= sizeof(DataPacket) || packet->src == getLocalAddress()) {
+        ESP_LOGV(LM_TAG, "Multicast packet without the hops left or sent by me");
+        incReceivedNotForMe();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    // The copies only differ in the next hop and the hops left, they are not checked
+    packet->via = 0;
+    packet->packetSize--;
+    bool duplicate = isDuplicatePacket(p);
+    packet->packetSize++;
+
+    if (duplicate) {
+        ESP_LOGV(LM_TAG, "Multicast packet %d from %X already received", packet->id, packet->src);
+        incReceivedNotForMe();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    bool member = RoleService::isRole(RoleService::getAddressRole(packet->dst));
+
+    uint16_t nextHops[LM_MULTICAST_MAX_BRANCHES];
+    uint8_t hopsLeft[LM_MULTICAST_MAX_BRANCHES];
+    bool forward = getMulticastNextHops(p, nextHops, hopsLeft) > 0;
+
+    ESP_LOGV(LM_TAG, "Multicast packet from %X for %X, member %d, forwarding %d", packet->src, packet->dst, member, forward);
+
+    QueuePacket<DataPacket>* deliverPq = member ? pq : nullptr;
+
+    if (forward) {
+        incReceivedIAmVia();
+
+        if (member) {
+            // The received packet is forwarded, the member gets a copy
+            DataPacket* copy = reinterpret_cast<DataPacket*>(PacketService::copyPacket(packet, packet->packetSize));
+            deliverPq = copy != nullptr ? PacketQueueService::createQueuePacket(copy, pq->priority) : nullptr;
+
+            if (deliverPq != nullptr) {
+                deliverPq->rssi = pq->rssi;
+                deliverPq->snr = pq->snr;
+                deliverPq->receivedAt = pq->receivedAt;
+            }
+            else
+                ESP_LOGE(LM_TAG, "Not enough memory to receive the multicast packet");
+        }
+
+        addToSendOrderedAndNotify(reinterpret_cast<QueuePacket<Packet<uint8_t>>*>(pq));
+    }
+
+    if (deliverPq != nullptr) {
+        // The hops left are not given to the user
+        deliverPq->packet->packetSize--;
+        incDataPacketForMe();
+        processDataPacketForMe(deliverPq);
+    }
+    else if (!forward && !member) {
+        incReceivedNotForMe();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+    }
+}
+
+void LoraMesher::processFloodPacket(QueuePacket<DataPacket>* pq) {
+    DataPacket* packet = pq->packet;
+    Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(packet);
+
+    if (packet->packetSize <= sizeof(DataPacket) || packet->src == getLocalAddress()) {
+        ESP_LOGV(LM_TAG, "Flooded packet without the hops left or sent by me");
+        incReceivedNotForMe();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    // The rebroadcasts only differ in the hops left, they are not checked
+    packet->packetSize--;
+    bool duplicate = isDuplicatePacket(p);
+    packet->packetSize++;
+
+    if (duplicate) {
+        ESP_LOGV(LM_TAG, "Flooded packet %d from %X already received", packet->id, packet->src);
+        incReceivedNotForMe();
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+        return;
+    }
+
+    incReceivedBroadcast();
+
+    uint8_t& hopsLeft = getHopsLeft(p);
+    QueuePacket<DataPacket>* deliverPq = pq;
+
+    if (hopsLeft > 1) {
+        // The received packet is rebroadcast, the user gets a copy
+        DataPacket* copy = reinterpret_cast<DataPacket*>(PacketService::copyPacket(packet, packet->packetSize));
+        deliverPq = copy != nullptr ? PacketQueueService::createQueuePacket(copy, pq->priority) : nullptr;
+
+        if (deliverPq != nullptr) {
+            deliverPq->rssi = pq->rssi;
+            deliverPq->snr = pq->snr;
+            deliverPq->receivedAt = pq->receivedAt;
+        }
+        else
+            ESP_LOGE(LM_TAG, "Not enough memory to receive the flooded packet");
+
+        hopsLeft--;
+        addToSendOrderedAndNotify(reinterpret_cast<QueuePacket<Packet<uint8_t>>*>(pq));
+    }
+
+    if (deliverPq != nullptr) {
+        // The hops left are not given to the user
+        deliverPq->packet->packetSize--;
+        processDataPacketForMe(deliverPq);
+    }
+}
+
+bool LoraMesher::isFloodSuppressed(Packet<uint8_t>* p) {
+    uint8_t redundancy = loraMesherConfig->floodRedundancy;
+    if (redundancy == 0 || p->dst != LM_FLOOD_ADDRESS || p->src == getLocalAddress() || p->packetSize <= sizeof(DataPacket))
+        return false;
+
+    // The copies are cached without the hops left
+    p->packetSize--;
+    uint8_t copies = getDuplicateCopies(p);
+    p->packetSize++;
+
+    return copies >= redundancy;
+}
+
+bool LoraMesher::needsHopAck(Packet<uint8_t>* p) {
+    return PacketService::isOnlyDataPacket(p->type) && !isHopAckPacket(p) && p->dst != BROADCAST_ADDR &&
+        p->dst != LM_FLOOD_ADDRESS && !RoleService::isMulticastAddress(p->dst);
+}
+
+bool LoraMesher::waitHopAck(QueuePacket<Packet<uint8_t>>* tx) {
+    Packet<uint8_t>* p = tx->packet;
+    if (!loraMesherConfig->hopAck || !needsHopAck(p))
+        return false;
+
+    // The next hop forwards it after its random backoff, up to the window of getPropagationTimeWithRandom
+    uint32_t backoff = getMaxPropagationTime() * 3 + (1 + routingTableSize()) * 100;
+    uint32_t timeout = (LM_HOP_ACK_TIMEOUT + backoff + AirtimeService::getTimeOnAirMs(p->packetSize) * 2) << tx->hopAttempts;
+    uint32_t deadline = millis() + timeout;
+
+    HopAckSlot* slot = nullptr;
+
+    portENTER_CRITICAL(&hopAckMux);
+    for (size_t i = 0; i < LM_HOP_ACK_SLOTS; i++) {
+        if (hopAckSlots[i].packet != nullptr)
+            continue;
+
+        slot = &hopAckSlots[i];
+        slot->packet = tx;
+        slot->dst = p->dst;
+        slot->src = p->src;
+        slot->via = (reinterpret_cast<DataPacket*>(p))->via;
+        slot->id = p->id;
+        slot->deadline = deadline;
+        break;
+    }
+    portEXIT_CRITICAL(&hopAckMux);
+
+    if (slot == nullptr) {
+        ESP_LOGW(LM_TAG, "No free hop ACK slot, packet %d from %X not acknowledged", p->id, p->src);
+        return false;
+    }
+
+    hopAckTimers->arm(&slot->timer, deadline);
+    return true;
+}
+
+void LoraMesher::processHopAck(DataPacket* p) {
+    bool hopAck = isHopAckPacket(reinterpret_cast<Packet<uint8_t>*>(p));
+    QueuePacket<Packet<uint8_t>>* acknowledged = nullptr;
+
+    portENTER_CRITICAL(&hopAckMux);
+    for (size_t i = 0; i < LM_HOP_ACK_SLOTS; i++) {
+        HopAckSlot& slot = hopAckSlots[i];
+        if (slot.packet == nullptr || slot.src != p->src || slot.dst != p->dst || slot.id != p->id)
+            continue;
+
+        // Forwarded by the next hop, or acknowledged by it. The retransmissions of the previous hop have this node as via
+        if (hopAck ? p->via != slot.via : p->via == slot.via || p->via == getLocalAddress())
+            continue;
+
+        acknowledged = slot.packet;
+        slot.packet = nullptr;
+        break;
+    }
+    portEXIT_CRITICAL(&hopAckMux);
+
+    // The timer of the slot is left armed, it finds the slot free or reused with a later deadline
+    if (acknowledged == nullptr)
+        return;
+
+    ESP_LOGV(LM_TAG, "Packet %d from %X acknowledged by %X%s", p->id, p->src, (reinterpret_cast<DataPacket*>(acknowledged->packet))->via,
+        hopAck ? "" : " forwarding it");
+    PacketQueueService::deleteQueuePacketAndPacket(acknowledged);
+}
+
+bool LoraMesher::acknowledgeHop(QueuePacket<DataPacket>* pq) {
+    DataPacket* packet = pq->packet;
+    Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(packet);
+
+    // The destination also overhears the packet sent to the previous hops, and a previous hop that changed its route sends
+    // its retransmissions with another via
+    // A packet sent by this node that comes back is in a routing loop, it would be sent again with a new id
+    uint16_t via = packet->via;
+    packet->via = 0;
+    bool duplicate = packet->src == getLocalAddress() || isDuplicatePacket(p);
+    packet->via = via;
+
+    bool destination = packet->dst == getLocalAddress() ||
+        (RoleService::isRoleAddress(packet->dst) && RoleService::isRole(RoleService::getAddressRole(packet->dst)));
+
+    // A forwarder acknowledges the first reception by forwarding the packet, unless other packets are queued before it
+    if (via == getLocalAddress() && (duplicate || destination || ToSendPackets->getLength() > 0)) {
+        DataPacket* ack = PacketService::createDataPacket(packet->dst, packet->src, DATA_P, nullptr, 0);
+        if (ack != nullptr) {
+            ack->id = packet->id;
+            ack->via = getLocalAddress();
+
+            // The hop ACKs of the retransmissions are equal, they do not go through the duplicates check of setPackedForSend
+            addToSendOrderedAndNotify(PacketQueueService::createQueuePacket(reinterpret_cast<Packet<uint8_t>*>(ack), MAX_PRIORITY));
+        }
+    }
+
+    if (!duplicate)
+        return false;
+
+    ESP_LOGV(LM_TAG, "Data packet %d from %X already received", packet->id, packet->src);
+    incReceivedNotForMe();
+    PacketQueueService::deleteQueuePacketAndPacket(pq);
+    return true;
+}
+
+void LoraMesher::managerHopAcks() {
+    hopAckTimers->expire(millis(), [this](LM_Timer* timer) {
+        HopAckSlot* slot = static_cast<HopAckSlot*>(timer->context);
+        QueuePacket<Packet<uint8_t>>* tx = nullptr;
+        uint16_t via = slot->via;
+
+        // A slot acknowledged and reused meanwhile has a later deadline
+        portENTER_CRITICAL(&hopAckMux);
+        if (slot->packet != nullptr && (int32_t) (millis() - slot->deadline) >= 0) {
+            tx = slot->packet;
+            via = slot->via;
+            slot->packet = nullptr;
+        }
+        portEXIT_CRITICAL(&hopAckMux);
+
+        if (tx == nullptr)
+            return;
+
+        if (tx->hopAttempts >= loraMesherConfig->hopAckRetries) {
+            //The next hop is taken as failed, its routes move to their alternate next hops
+            uint16_t nextHop = 0;
+            if (loraMesherConfig->multipath) {
+                if (RoutingTableService::failoverNeighbor(via) > 0)
+                    purgeSendFlow(via);
+                nextHop = RoutingTableService::getNextHop(tx->packet->dst);
+            }
+
+            //The other routes through it are not waited to time out
+            if (loraMesherConfig->triggeredWithdrawal)
+                withdrawNeighbor(via);
+
+            if (nextHop != 0 && nextHop != via) {
+                ESP_LOGI(LM_TAG, "Packet %d from %X not acknowledged by %X, sending it through %X", tx->packet->id, tx->packet->src,
+                    via, nextHop);
+                tx->hopAttempts = 0;
+                tx->priority = PacketQueueService::getResendPriority(tx->priority);
+                addToSendOrderedAndNotify(tx);
+                return;
+            }
+
+            ESP_LOGW(LM_TAG, "Packet %d from %X not acknowledged by %X after %d retransmissions", tx->packet->id, tx->packet->src,
+                via, tx->hopAttempts);
+            incHopAckLost();
+            PacketQueueService::deleteQueuePacketAndPacket(tx);
+            return;
+        }
+
+        ESP_LOGI(LM_TAG, "Packet %d from %X not acknowledged by %X, resending it", tx->packet->id, tx->packet->src, via);
+        tx->hopAttempts++;
+        tx->priority = PacketQueueService::getResendPriority(tx->priority);
+        incHopRetransmissions();
+        addToSendOrderedAndNotify(tx);
+    });
+}
+
+void LoraMesher::processDataPacketForMe(QueuePacket<DataPacket>* pq) {
+    DataPacket* p = pq->packet;
+    ControlPacket* cPacket = reinterpret_cast<ControlPacket*>(p);
+
+    //By default, delete the packet queue at the finish of this function
+    bool deleteQueuePacket = true;
+
+    bool needAck = PacketService::isNeedAckPacket(p->type);
+
+    // The application gets the payload without the trace
+    if (PacketService::isTracedPacket(p->type))
+        HopTraceService::receive(reinterpret_cast<Packet<uint8_t>*>(p));
+
+    if (PacketService::isOnlyDataPacket(p->type) && loraMesherConfig->zeroCopyReceive && !loraMesherConfig->compressPayloads) {
+        ESP_LOGV(LM_TAG, "Data Packet received, zero copy");
+        if (p->packetSize < sizeof(DataPacket)) {
+            ESP_LOGE(LM_TAG, "Invalid packet size %d < header size %d, packet corrupted", p->packetSize, sizeof(DataPacket));
+            PacketQueueService::deleteQueuePacketAndPacket(pq);
+            return;
+        }
+
+        //The received buffer is given to the user, only the packet queue is deleted
+        notifyUserReceivedPacket(reinterpret_cast<AppPacketView<uint8_t>*>(p));
+        delete pq;
+        return;
+    }
+    else if (PacketService::isOnlyDataPacket(p->type)) {
+        ESP_LOGV(LM_TAG, "Data Packet received");
+        //Convert the packet into a user packet
+        AppPacket<uint8_t>* appPacket = PacketService::convertPacket(p);
+
+        // Handle validation failure
+        if (appPacket == nullptr) {
+            ESP_LOGE(LM_TAG, "Failed to convert packet, discarding corrupted packet");
+            PacketQueueService::deleteQueuePacketAndPacket(pq);
+            return;
+        }
+
+        setAppPacketMetadata(appPacket, pq);
+
+        //Add and notify the user of this packet
+        notifyUserReceivedPacket(appPacket);
+    }
+    else if (PacketService::isAckPacket(p->type)) {
+        ESP_LOGV(LM_TAG, "ACK Packet received");
+        //The selective ACK bitmap is optional
+        uint32_t sack = 0;
+        if (PacketService::getPacketPayloadLength(cPacket) >= sizeof(sack))
+            memcpy(&sack, cPacket->payload, sizeof(sack));
+
+        addAck(p->src, cPacket->seq_id, cPacket->number, sack);
+    }
+    else if (PacketService::isLostPacket(p->type)) {
+        ESP_LOGV(LM_TAG, "Lost Packet received");
+        processLostPacket(p->src, cPacket->seq_id, cPacket->number);
+    }
+    else if (PacketService::isSyncPacket(p->type)) {
+        ESP_LOGV(LM_TAG, "Synchronization Packet received");
+        //The FEC group and the size of the last packet are optional
+        uint8_t fec[2] = {0, 0};
+        if (PacketService::getPacketPayloadLength(cPacket) >= sizeof(fec))
+            memcpy(fec, cPacket->payload, sizeof(fec));
+
+        processSyncPacket(p->src, cPacket->seq_id, cPacket->number, fec[0], fec[1]);
+
+        needAck = false;
+    }
+    else if (PacketService::isFragmentPacket(p->type)) {
+        ESP_LOGV(LM_TAG, "Fragment Packet received");
+        processFragmentPacket(reinterpret_cast<QueuePacket<ControlPacket>*>(pq));
+    }
+    else if (PacketService::isXLPacket(p->type)) {
+        ESP_LOGV(LM_TAG, "Large payload Packet received");
+        processLargePayloadPacket(reinterpret_cast<QueuePacket<ControlPacket>*>(pq));
+        needAck = false;
+    }
+
+    //Need ack
+    if (needAck) {
+        //TODO: All packets with this ack will ack?
+        ESP_LOGV(LM_TAG, "Previous packet need an ACK");
+        sendAckPacket(p->src, cPacket->seq_id, cPacket->number);
+    }
+
+    if (deleteQueuePacket)
+        //Delete packet queue
+        PacketQueueService::deleteQueuePacketAndPacket(pq);
+}
+
+void LoraMesher::notifyUserReceivedPacket(AppPacket<uint8_t>* appPacket) {
+    //Every payload is delivered decrypted and decoded
+    if (CryptoService::isEnabled()) {
+        size_t payloadSize = appPacket->payloadSize;
+        if (!decryptPayload(appPacket->src, appPacket->payload, payloadSize)) {
+            deletePacket(appPacket);
+            return;
+        }
+        appPacket->payloadSize = payloadSize;
+    }
+
+    if (loraMesherConfig->compressPayloads) {
+        appPacket = decodeAppPacket(appPacket);
+        if (appPacket == nullptr)
+            return;
+    }
+
+    appPacket->port = 0;
+    if (loraMesherConfig->applicationPorts) {
+        size_t payloadSize = appPacket->payloadSize;
+        if (!takePort(appPacket->payload, payloadSize, appPacket->port)) {
+            deletePacket(appPacket);
+            return;
+        }
+        appPacket->payloadSize = payloadSize;
+    }
+
+    if (processOtaMessage(appPacket->src, appPacket->port, appPacket->payload, appPacket->payloadSize)) {
+        deletePacket(appPacket);
+        return;
+    }
+
+    if (processMetricsMessage(appPacket->src, appPacket->port, appPacket->payload, appPacket->payloadSize)) {
+        deletePacket(appPacket);
+        return;
+    }
+
+    //A bound port has its own callback or queue and task
+    PortBinding binding;
+    LM_ReceiveCallback callback = receiveCallback;
+    void* callbackContext = receiveCallbackContext;
+    LM_IntrusiveList<AppPacket<uint8_t>>* queue = ReceivedAppPackets;
+    TaskHandle_t task = ReceiveAppData_TaskHandle;
+
+    portENTER_CRITICAL(&portsMux);
+    PortBinding* bound = loraMesherConfig->applicationPorts ? findPortBinding(appPacket->port) : nullptr;
+    if (bound != nullptr && bound->bound)
+        binding = *bound;
+    portEXIT_CRITICAL(&portsMux);
+
+    if (binding.bound) {
+        callback = binding.callback;
+        callbackContext = binding.context;
+        queue = binding.packets;
+        task = binding.task;
+    }
+
+    if (callback != nullptr) {
+        LM_ReceiveMetadata metadata;
+        getReceiveMetadata(appPacket, metadata);
+        callback(appPacket->payload, metadata, callbackContext);
+        deletePacket(appPacket);
+    }
+    else if (task) {
+        //Add the packet inside the receivedUsers Queue
+        AppPacket<uint8_t>* dropped = appendReceivedBounded(queue, appPacket);
+        if (dropped != nullptr)
+            deletePacket(dropped);
+
+        if (dropped == appPacket)
+            return;
+
+        //Notify the received user task handle
+        xTaskNotify(
+            task,
+            0,
+            eSetValueWithOverwrite);
+
+    }
+    else
+        deletePacket(appPacket);
+}
+
+void LoraMesher::notifyUserReceivedPacket(AppPacketView<uint8_t>* view) {
+    //Decrypted in the received buffer, the counter and the tag are left out of the payload size
+    if (CryptoService::isEnabled()) {
+        size_t payloadSize = view->getPayloadSize();
+        if (!decryptPayload(view->src, view->payload, payloadSize)) {
+            deletePacket(view);
+            return;
+        }
+        view->packetSize -= CryptoService::OVERHEAD;
+    }
+
+    //The view keeps no port, the one of a bound port is known by its queue
+    uint8_t port = 0;
+    if (loraMesherConfig->applicationPorts) {
+        size_t payloadSize = view->getPayloadSize();
+        if (!takePort(view->payload, payloadSize, port)) {
+            deletePacket(view);
+            return;
+        }
+        view->packetSize--;
+    }
+
+    if (processOtaMessage(view->src, port, view->payload, view->getPayloadSize())) {
+        deletePacket(view);
+        return;
+    }
+
+    if (processMetricsMessage(view->src, port, view->payload, view->getPayloadSize())) {
+        deletePacket(view);
+        return;
+    }
+
+    PortBinding binding;
+    LM_ReceiveCallback callback = receiveCallback;
+    void* callbackContext = receiveCallbackContext;
+    LM_LinkedList<AppPacketView<uint8_t>>* queue = ReceivedAppPacketViews;
+    TaskHandle_t task = ReceiveAppData_TaskHandle;
+
+    portENTER_CRITICAL(&portsMux);
+    PortBinding* bound = loraMesherConfig->applicationPorts ? findPortBinding(port) : nullptr;
+    if (bound != nullptr && bound->bound)
+        binding = *bound;
+    portEXIT_CRITICAL(&portsMux);
+
+    if (binding.bound) {
+        callback = binding.callback;
+        callbackContext = binding.context;
+        queue = binding.views;
+        task = binding.task;
+    }
+
+    if (callback != nullptr) {
+        LM_ReceiveMetadata metadata;
+        getReceiveMetadata(view, metadata);
+        metadata.port = port;
+        callback(view->payload, metadata, callbackContext);
+        deletePacket(view);
+    }
+    else if (task) {
+        //Add the packet view inside the received views Queue
+        AppPacketView<uint8_t>* dropped = appendReceivedBounded(queue, view);
+        if (dropped != nullptr)
+            deletePacket(dropped);
+
+        if (dropped == view)
+            return;
+
+        //Notify the received user task handle
+        xTaskNotify(
+            task,
+            0,
+            eSetValueWithOverwrite);
+
+    }
+    else
+        deletePacket(view);
+}
+
+bool LoraMesher::takePort(uint8_t* payload, size_t& payloadSize, uint8_t& port) {
+    if (payloadSize == 0) {
+        ESP_LOGW(LM_TAG, "Payload without its port dropped");
+        return false;
+    }
+
+    port = payload[0];
+    payloadSize--;
+    memmove(payload, payload + 1, payloadSize);
+    return true;
+}
+
+bool LoraMesher::bindPort(uint8_t port, TaskHandle_t task, LM_ReceiveCallback callback, void* context) {
+    if (isLibraryPort(port))
+        return false;
+
+    //The queues are allocated out of the critical section, they are freed if the port is not bound
+    LM_IntrusiveList<AppPacket<uint8_t>>* packets = new LM_IntrusiveList<AppPacket<uint8_t>>();
+    LM_LinkedList<AppPacketView<uint8_t>>* views = new LM_LinkedList<AppPacketView<uint8_t>>();
+
+    portENTER_CRITICAL(&portsMux);
+
+    PortBinding* slot = findPortBinding(port);
+    if (slot == nullptr) {
+        for (PortBinding& binding : portBindings) {
+            if (binding.packets == nullptr) {
+                slot = &binding;
+                break;
+            }
+
+            //An unbound port with its queues empty is reused
+            if (slot == nullptr && !binding.bound && binding.packets->getLength() == 0 && binding.views->getLength() == 0)
+                slot = &binding;
+        }
+    }
+
+    if (slot != nullptr) {
+        if (slot->packets == nullptr) {
+            slot->packets = packets;
+            slot->views = views;
+            packets = nullptr;
+            views = nullptr;
+        }
+
+        slot->port = port;
+        slot->task = task;
+        slot->callback = callback;
+        slot->context = context;
+        slot->bound = true;
+    }
+
+    portEXIT_CRITICAL(&portsMux);
+
+    delete packets;
+    delete views;
+
+    if (slot == nullptr)
+        ESP_LOGE(LM_TAG, "Port %d not bound, %d ports already", port, LM_APP_PORTS);
+
+    return slot != nullptr;
+}
+
+void LoraMesher::unbindPort(uint8_t port) {
+    portENTER_CRITICAL(&portsMux);
+    PortBinding* slot = findPortBinding(port);
+    if (slot != nullptr)
+        slot->bound = false;
+    portEXIT_CRITICAL(&portsMux);
+
+    if (slot == nullptr)
+        return;
+
+    while (AppPacket<uint8_t>* appPacket = getNextAppPacket<uint8_t>(port))
+        deletePacket(appPacket);
+
+    while (AppPacketView<uint8_t>* view = getNextAppPacketView<uint8_t>(port))
+        deletePacket(view);
+}
+
+size_t LoraMesher::getReceivedQueueSize(uint8_t port) {
+    PortBinding* slot = findPortBinding(port);
+    return slot != nullptr ? slot->packets->getLength() + slot->views->getLength() : 0;
+}
+
+LoraMesher::PortBinding* LoraMesher::findPortBinding(uint8_t port) {
+    for (PortBinding& binding : portBindings) {
+        if (binding.packets != nullptr && binding.port == port)
+            return &binding;
+    }
+
+    return nullptr;
+}
+
+void LoraMesher::getReceiveMetadata(AppPacket<uint8_t>* appPacket, LM_ReceiveMetadata& metadata) {
+    metadata = LM_ReceiveMetadata();
+    metadata.dst = appPacket->dst;
+    metadata.src = appPacket->src;
+    metadata.payloadSize = appPacket->payloadSize;
+    metadata.copiedSize = appPacket->payloadSize;
+    metadata.rssi = appPacket->rssi;
+    metadata.snr = appPacket->snr;
+    metadata.hopCount = appPacket->hopCount;
+    metadata.previousHop = appPacket->previousHop;
+    metadata.rxTimestamp = appPacket->rxTimestamp;
+    metadata.port = appPacket->port;
+}
+
+void LoraMesher::getReceiveMetadata(AppPacketView<uint8_t>* view, LM_ReceiveMetadata& metadata) {
+    metadata = LM_ReceiveMetadata();
+    metadata.dst = view->dst;
+    metadata.src = view->src;
+    metadata.payloadSize = view->getPayloadSize();
+    metadata.copiedSize = metadata.payloadSize;
+}
+
+uint32_t LoraMesher::getPropagationTimeWithRandom(uint8_t multiplayer) {
+    // TODO: Use the RTT or other congestion metrics to calculate the time, timeouts...
+    uint32_t time = getMaxPropagationTime();
+    uint32_t randomTime = random(time, time * 3 + (multiplayer + routingTableSize()) * 100);
+    return randomTime;
+}
+
+void LoraMesher::recalculateMaxTimeOnAir() {
+    AirtimeService::build(radio, loraMesherConfig->sf, loraMesherConfig->bw, loraMesherConfig->cr, loraMesherConfig->preambleLength);
+    maxTimeOnAir = AirtimeService::getTimeOnAirMs(PacketFactory::getMaxPacketSize());
+    ESP_LOGV(LM_TAG, "Max Time on Air changed %d ms", (int)maxTimeOnAir);
+
+    configureAirtimeBudget();
+
+    // The TDMA slots fit the longest packet
+    initTdma();
+}
+
+void LoraMesher::configureAirtimeBudget() {
+    // Every class leaves the shares of the classes above it, the routing and control classes share theirs
+    uint8_t controlShare = std::min(loraMesherConfig->controlAirtimeShare, (uint8_t) 99);
+    uint8_t alarmShare = std::min(loraMesherConfig->alarmAirtimeShare, (uint8_t) (99 - controlShare));
+    uint8_t shares[TRAFFIC_CLASS_NUM] = {};
+    shares[TRAFFIC_CLASS_BULK] = controlShare + alarmShare;
+    shares[TRAFFIC_CLASS_ALARM] = controlShare;
+
+    uint32_t burst = loraMesherConfig->airtimeBurst;
+    uint32_t minBurst = maxTimeOnAir * 100 / (100 - shares[TRAFFIC_CLASS_BULK]) + 1;
+    if (burst < minBurst)
+        burst = minBurst;
+
+    portENTER_CRITICAL(&airtimeBudgetMux);
+    airtimeBudget.configure(loraMesherConfig->airtimeLimit, loraMesherConfig->airtimeWindow, burst, shares, TRAFFIC_CLASS_NUM, millis());
+    portEXIT_CRITICAL(&airtimeBudgetMux);
+}
+
+void LoraMesher::waitAirtimeBudget(QueuePacket<Packet<uint8_t>>* tx) {
+    for (;;) {
+        uint32_t wait = takeAirtimeBudget(tx);
+        if (wait == 0)
+            return;
+
+        ESP_LOGV(LM_TAG, "Airtime budget exhausted, next packet in %d ms", (int)wait);
+        vTaskDelay((wait + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+    }
+}
+
+uint32_t LoraMesher::takeAirtimeBudget(QueuePacket<Packet<uint8_t>>* tx) {
+    uint32_t airtime = getFrameTimeOnAirMs(tx->packet->packetSize);
+    LM_TrafficClass trafficClass = PacketQueueService::getTrafficClass(tx->priority);
+
+    portENTER_CRITICAL(&airtimeBudgetMux);
+    uint32_t wait = airtimeBudget.getWaitTime(millis(), airtime, trafficClass);
+    if (wait == 0)
+        airtimeBudget.consume(millis(), airtime);
+    portEXIT_CRITICAL(&airtimeBudgetMux);
+
+    return wait;
+}
+
+void LoraMesher::recordState(LM_StateType type, Packet<uint8_t>* packet) {
+    if (simulatorService == nullptr)
+        return;
+
+    simulatorService->addState(getReceivedRingLength(), getSendQueueSize(),
+        getReceivedQueueSize(), routingTableSize(), q_WRP->getLength(), q_WSP->getLength(),
+        type, packet);
+}
+
+/**
+ *  End Region Packet Service
+**/
+
+
+/**
+ *  Region Routing Table
+**/
+
+size_t LoraMesher::routingTableSize() {
+    return RoutingTableService::routingTableSize();
+}
+
+LM_LinkedList<RouteNode>* LoraMesher::routingTableListCopy() {
+    LM_LinkedList<RouteNode>* copy = new LM_LinkedList<RouteNode>();
+
+    RoutingTableService::routingTableList->setInUseShared();
+
+    for (RouteNode* node : *RoutingTableService::routingTableList)
+        copy->Append(node);
+
+    RoutingTableService::routingTableList->releaseInUseShared();
+
+    return copy;
+}
+
+/**
+ *  End Region Routing Table
+**/
+
+
+/**
+ *  Region PacketQueue
+**/
+
+size_t LoraMesher::getReceivedQueueSize() {
+    return ReceivedAppPackets->getLength();
+}
+
+bool LoraMesher::receiveInto(void* buffer, size_t capacity, LM_ReceiveMetadata& metadata, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;) {
+        if (tryReceive(buffer, capacity, metadata))
+            return true;
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout)
+            return false;
+
+        // A packet queued after tryReceive leaves the notification pending, it is not lost
+        ulTaskNotifyTake(pdTRUE, timeout == portMAX_DELAY ? portMAX_DELAY : timeout - elapsed);
+    }
+}
+
+bool LoraMesher::tryReceive(void* buffer, size_t capacity, LM_ReceiveMetadata& metadata) {
+    AppPacketView<uint8_t>* view = getReceivedViewQueueSize() > 0 ? getNextAppPacketView<uint8_t>() : nullptr;
+    if (view != nullptr) {
+        getReceiveMetadata(view, metadata);
+        if (metadata.copiedSize > capacity)
+            metadata.copiedSize = capacity;
+        memcpy(buffer, view->payload, metadata.copiedSize);
+
+        deletePacket(view);
+        return true;
+    }
+
+    AppPacket<uint8_t>* packet = getNextAppPacket<uint8_t>();
+    if (packet == nullptr) {
+        metadata = LM_ReceiveMetadata();
+        return false;
+    }
+
+    getReceiveMetadata(packet, metadata);
+    if (metadata.copiedSize > capacity)
+        metadata.copiedSize = capacity;
+    memcpy(buffer, packet->payload, metadata.copiedSize);
+
+    deletePacket(packet);
+    return true;
+}
+
+size_t LoraMesher::getSendQueueSize() {
+    return ToSendPackets->getLength();
+}
+
+LM_EnqueueResult LoraMesher::addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp) {
+    if (loraMesherConfig->sniffer) {
+        PacketQueueService::deleteQueuePacketAndPacket(qp);
+        return ENQUEUE_INVALID;
+    }
+
+    qp->enqueuedAt = millis();
+
+    // The packet can be sent and deleted by the other tasks as soon as it is added
+    PacketHeader header = *qp->packet;
+
+    QueuePacket<Packet<uint8_t>>* dropped;
+    LM_EnqueueResult result = PacketQueueService::addOrdered(ToSendPackets, qp,
+        loraMesherConfig->sendQueueCapacity, loraMesherConfig->sendQueueDropPolicy, dropped);
+
+    if (dropped != nullptr)
+        dropFromSendQueue(dropped);
+
+    if (!isEnqueued(result))
+        return result;
+
+    checkCongestion();
+
+    LM_TRACE(LM_TRACE_QUEUE, 2, TRACE_ENQUEUE, header.src, header.dst, header.id, ToSendPackets->getLength());
+    LM_HOOK(HOOK_SEND_ENQUEUE, &header, ToSendPackets->getLength());
+    ESP_LOGI(LM_TAG, "Added packet to Q_SP, notifying sender task");
+
+    notifySender();
+
+    return result;
+}
+
+size_t LoraMesher::sendBatch(const LM_SendBatchEntry* entries, size_t count, LM_EnqueueResult* results) {
+    QueuePacket<Packet<uint8_t>>* qps[LM_SEND_BATCH_MAX];
+    PacketHeader headers[LM_SEND_BATCH_MAX];
+    size_t indexes[LM_SEND_BATCH_MAX];
+    LM_EnqueueResult added[LM_SEND_BATCH_MAX];
+    QueuePacket<Packet<uint8_t>>* dropped[LM_SEND_BATCH_MAX];
+
+    size_t enqueued = 0;
+
+    for (size_t start = 0; start < count; start += LM_SEND_BATCH_MAX) {
+        size_t end = count - start > LM_SEND_BATCH_MAX ? start + LM_SEND_BATCH_MAX : count;
+        size_t num = 0;
+
+        for (size_t i = start; i < end; i++) {
+            LM_EnqueueResult result = ENQUEUE_OK;
+            QueuePacket<Packet<uint8_t>>* qp = createBatchPacket(entries[i], result);
+            if (qp == nullptr) {
+                if (results != nullptr)
+                    results[i] = result;
+                continue;
+            }
+
+            // The packets can be sent and deleted by the other tasks as soon as they are added
+            headers[num] = *qp->packet;
+            qps[num] = qp;
+            indexes[num++] = i;
+        }
+
+        if (num == 0)
+            continue;
+
+        PacketQueueService::addOrdered(ToSendPackets, qps, num, loraMesherConfig->sendQueueCapacity,
+            loraMesherConfig->sendQueueDropPolicy, added, dropped);
+
+        for (size_t j = 0; j < num; j++) {
+            if (dropped[j] != nullptr)
+                dropFromSendQueue(dropped[j]);
+
+            if (results != nullptr)
+                results[indexes[j]] = added[j];
+
+            if (!isEnqueued(added[j]))
+                continue;
+
+            enqueued++;
+            LM_TRACE(LM_TRACE_QUEUE, 2, TRACE_ENQUEUE, headers[j].src, headers[j].dst, headers[j].id, ToSendPackets->getLength());
+            LM_HOOK(HOOK_SEND_ENQUEUE, &headers[j], ToSendPackets->getLength());
+        }
+    }
+
+    if (enqueued == 0)
+        return 0;
+
+    checkCongestion();
+
+    ESP_LOGI(LM_TAG, "Added %d packets to Q_SP, notifying sender task", enqueued);
+
+    notifySender();
+
+    return enqueued;
+}
+
+QueuePacket<Packet<uint8_t>>* LoraMesher::createBatchPacket(const LM_SendBatchEntry& entry, LM_EnqueueResult& result) {
+    result = ENQUEUE_INVALID;
+
+    if (loraMesherConfig->sniffer || entry.payloadSize == 0 || isLibraryPort(entry.port))
+        return nullptr;
+
+    const uint8_t* payload = entry.payload;
+    uint32_t payloadSize = entry.payloadSize;
+
+    uint8_t* encoded = nullptr;
+    if (isPayloadEncoded()) {
+        encoded = encodePayload(payload, payloadSize, entry.port);
+        if (encoded == nullptr)
+            return nullptr;
+        payload = encoded;
+    }
+
+    Packet<uint8_t>* dPacket = reinterpret_cast<Packet<uint8_t>*>(PacketService::createDataPacket(entry.dst, getLocalAddress(), DATA_P, payload, payloadSize));
+    PacketPoolService::release(encoded);
+
+    if (dPacket == nullptr)
+        return nullptr;
+
+    if (entry.dst != BROADCAST_ADDR && entry.dst != LM_FLOOD_ADDRESS && !RoleService::isMulticastAddress(entry.dst))
+        dPacket = HopTraceService::sample(dPacket);
+
+    // The own packets are not checked for duplicates, see isDuplicatePacket
+    QueuePacket<Packet<uint8_t>>* qp = PacketQueueService::createQueuePacket(dPacket, entry.priority);
+    qp->enqueuedAt = millis();
+
+    result = ENQUEUE_OK;
+    return qp;
+}
+
+void LoraMesher::dropFromSendQueue(QueuePacket<Packet<uint8_t>>* dropped) {
+    ESP_LOGW(LM_TAG, "Send queue full, packet to %X dropped", dropped->packet->dst);
+    LM_TRACE(LM_TRACE_QUEUE, 2, TRACE_QUEUE_DROP, dropped->packet->src, dropped->packet->dst, dropped->packet->id, 1);
+    sendQueueWasFull = true;
+    incSendQueueDropped();
+    PacketQueueService::deleteQueuePacketAndPacket(dropped);
+}
+
+void LoraMesher::notifySender() {
+    //Notify the sendData task handle
+    if (Reactor_TaskHandle)
+        xTaskNotify(Reactor_TaskHandle, EVENT_SEND, eSetBits);
+    else
+        xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
+}
+
+void LoraMesher::setSendOptions(QueuePacket<Packet<uint8_t>>* qp, const LM_SendOptions& options) {
+    uint32_t deadline = options.deadline;
+    if (options.maxAge != 0) {
+        uint32_t ageDeadline = millis() + options.maxAge;
+        if (deadline == 0 || (int32_t) (ageDeadline - deadline) < 0)
+            deadline = ageDeadline;
+    }
+
+    // 0 means without deadline, a deadline that wraps to 0 is moved 1 ms
+    if (deadline == 0 && (options.deadline != 0 || options.maxAge != 0))
+        deadline = 1;
+
+    qp->deadline = deadline;
+    qp->replaceKey = options.replaceKey;
+
+    if (options.replaceKey == 0)
+        return;
+
+    uint16_t localAddress = getLocalAddress();
+    uint16_t dst = qp->packet->dst;
+
+    ToSendPackets->setInUse();
+    size_t replaced = ToSendPackets->RemoveMatching(
+        [&](QueuePacket<Packet<uint8_t>>* queued) {
+            return queued->replaceKey == options.replaceKey && queued->packet->src == localAddress && queued->packet->dst == dst;
+        },
+        [&](QueuePacket<Packet<uint8_t>>* removed) {
+            recordSendQueueWait(removed);
+            PacketQueueService::deleteQueuePacketAndPacket(removed);
+        });
+    ToSendPackets->releaseInUse();
+
+    if (replaced > 0) {
+        ESP_LOGI(LM_TAG, "%d readings with key %d to %X replaced in the send queue", replaced, options.replaceKey, dst);
+        incSendQueueReplaced(replaced);
+    }
+}
+
+uint32_t LoraMesher::recordSendQueueWait(QueuePacket<Packet<uint8_t>>* qp) {
+    if (qp->enqueuedAt == 0)
+        return 0;
+
+    uint32_t wait = millis() - qp->enqueuedAt;
+    recordStat(stats.sendQueueWait, wait);
+    qp->enqueuedAt = 0;
+    return wait;
+}
+
+void LoraMesher::addChannelBusy(uint32_t& counter, uint32_t busyMs) {
+    portENTER_CRITICAL(&statsMux);
+    counter += busyMs;
+    channelBusy.add(millis(), busyMs);
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void LoraMesher::countReceiveError(int16_t state) {
+    switch (state) {
+        case RADIOLIB_ERR_CRC_MISMATCH:
+            incStat(stats.rxCrcErrorsNum);
+            break;
+        case RADIOLIB_ERR_LORA_HEADER_DAMAGED:
+            incStat(stats.rxHeaderErrorsNum);
+            break;
+        // Counted in the restarts of the radio
+        case RADIOLIB_ERR_SPI_WRITE_FAILED:
+            break;
+        default:
+            incStat(stats.rxReadErrorsNum);
+            break;
+    }
+}
+
+void LoraMesher::channelActivityDetected() {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&statsMux);
+    checkPreambleWithoutPacket(now);
+    // A detection during the same frame is not counted again
+    if (preambleDetectedAt == 0)
+        preambleDetectedAt = now;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void LoraMesher::channelFrameReceived(size_t length) {
+    uint32_t now = millis();
+    uint32_t timeOnAir = AirtimeService::getTimeOnAirMs(length);
+
+    portENTER_CRITICAL(&statsMux);
+    preambleDetectedAt = 0;
+    stats.busyRxTime += timeOnAir;
+    channelBusy.add(now, timeOnAir);
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void LoraMesher::checkPreambleWithoutPacket(uint32_t now) {
+    if (preambleDetectedAt == 0 || now - preambleDetectedAt <= maxTimeOnAir)
+        return;
+
+    // Detected at a random point of a frame of unknown length
+    uint32_t busy = maxTimeOnAir / 2;
+    stats.preambleWithoutPacketNum++;
+    stats.busyCadTime += busy;
+    channelBusy.add(now, busy);
+    preambleDetectedAt = 0;
+}
+
+uint16_t LoraMesher::getChannelBusy() {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&statsMux);
+    checkPreambleWithoutPacket(now);
+    uint16_t busy = channelBusy.getPerMille(now);
+    portEXIT_CRITICAL(&statsMux);
+
+    return busy;
+}
+
+void LoraMesher::getStats(LM_Stats& out) {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&statsMux);
+    checkPreambleWithoutPacket(now);
+    out = stats;
+    out.channelBusyPerMille = channelBusy.getPerMille(now);
+    portEXIT_CRITICAL(&statsMux);
+
+    out.receivedOverflowNum = getReceivedOverflowNum();
+    out.packetPoolHighWater = PacketPoolService::getHighWater();
+    out.packetPoolExhaustedNum = PacketPoolService::getExhaustedNum();
+    out.routeFailoversNum = RoutingTableService::getFailoverCount();
+    out.spoolDroppedNum = SpoolService::getDroppedNum();
+    out.spoolSize = SpoolService::getPendingNum();
+    out.tdmaSlotChangesNum = TdmaService::getSlotChangesNum();
+    out.telemetryRelayDroppedNum = TelemetryService::getRelayDroppedNum();
+    out.otaChunksServedNum = OtaService::getServedNum();
+    out.otaRequestsNum = OtaService::getRequestsNum();
+    out.otaHashFailuresNum = OtaService::getHashFailuresNum();
+    out.routeDiscoveryFailuresNum = RouteDiscoveryService::getFailedNum();
+    out.hopTracesNum = HopTraceService::getReceivedNum();
+    out.sendQueueSize = ToSendPackets->getLength();
+}
+
+LM_MemoryStats LoraMesher::getMemoryStats() {
+    LM_MemoryStats out;
+    for (uint8_t tag = 0; tag < MEMORY_TAGS; tag++)
+        out.usage[tag] = MemoryService::getUsage(static_cast<LM_MemoryTag>(tag));
+
+    out.freeHeap = getFreeHeap();
+    return out;
+}
+
+void LoraMesher::notifySendQueueRoom() {
+    if (!sendQueueWasFull || ToSendPackets->getLength() > loraMesherConfig->sendQueueCapacity / 2)
+        return;
+
+    sendQueueWasFull = false;
+
+    if (SendQueueRoom_TaskHandle)
+        xTaskNotify(SendQueueRoom_TaskHandle, 0, eSetValueWithOverwrite);
+}
+
+void LoraMesher::notifyNewSequenceStarted() {
+    //Notify the queue manager task handle
+    if (Reactor_TaskHandle)
+        xTaskNotify(Reactor_TaskHandle, EVENT_QUEUE_TIMER, eSetBits);
+    else
+        xTaskNotify(QueueManager_TaskHandle, 0, eSetValueWithOverwrite);
+}
+
+/**
+ *  End Region PacketQueue
+**/
+
+
+/**
+ * Large and Reliable payloads
+ */
+
+QueuePacket<ControlPacket>* LoraMesher::getStartSequencePacketQueue(uint16_t destination, uint16_t seq_id, uint16_t num_packets, uint8_t fecGroup,
+    uint8_t lastSize) {
+    uint8_t type = SYNC_P | NEED_ACK_P | XL_DATA_P;
+
+    //Create the packet, with the FEC group as payload if there is any
+    ControlPacket* cPacket;
+    if (fecGroup == 0)
+        cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, num_packets);
+    else {
+        uint8_t fec[2] = {fecGroup, lastSize};
+        cPacket = PacketService::createControlPacket(destination, getLocalAddress(), type, fec, sizeof(fec));
+        cPacket->seq_id = seq_id;
+        cPacket->number = num_packets;
+    }
+
+    //Create a packet queue
+    return PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY, 0);
+}
+
+void LoraMesher::sendAckPacket(uint16_t destination, uint16_t seq_id, uint16_t seq_num, uint32_t sack) {
+    uint8_t type = ACK_P;
+
+    //Create the packet, with the selective ACK bitmap as payload if there is any
+    ControlPacket* cPacket;
+    if (sack == 0)
+        cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+    else {
+        cPacket = PacketService::createControlPacket(destination, getLocalAddress(), type, reinterpret_cast<uint8_t*>(&sack), sizeof(sack));
+        cPacket->seq_id = seq_id;
+        cPacket->number = seq_num;
+    }
+
+    sendAckOrDelay(cPacket, LM_PRIORITY_CONTROL + 1);
+}
+
+void LoraMesher::sendLostPacket(uint16_t destination, uint16_t seq_id, uint16_t seq_num) {
+    uint8_t type = LOST_P;
+
+    //Create the packet
+    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+
+    sendAckOrDelay(cPacket, LM_PRIORITY_CONTROL);
+}
+
+void LoraMesher::sendAckOrDelay(ControlPacket* cPacket, uint8_t priority) {
+    if (cPacket == nullptr)
+        return;
+
+    // The aggregate frames are not acknowledged per hop
+    if (loraMesherConfig->delayedAck != 0 && !loraMesherConfig->hopAck && delayAck(cPacket, priority))
+        return;
+
+    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), priority);
+}
+
+bool LoraMesher::delayAck(ControlPacket* cPacket, uint8_t priority) {
+    Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(cPacket);
+    if (isDuplicatePacket(p)) {
+        deletePacket(p);
+        return true;
+    }
+
+    QueuePacket<Packet<uint8_t>>* qp = PacketQueueService::createQueuePacket(p, priority);
+    uint32_t deadline = millis() + loraMesherConfig->delayedAck;
+
+    DelayedAckSlot* slot = nullptr;
+    QueuePacket<Packet<uint8_t>>* replaced = nullptr;
+
+    portENTER_CRITICAL(&delayedAckMux);
+    for (size_t i = 0; i < LM_DELAYED_ACK_SLOTS; i++) {
+        DelayedAckSlot& candidate = delayedAckSlots[i];
+        if (candidate.packet == nullptr) {
+            if (slot == nullptr)
+                slot = &candidate;
+            continue;
+        }
+
+        // The ACKs are cumulative, the newer one replaces the waiting one and keeps its deadline. The LOST of another packet does not
+        ControlPacket* waiting = reinterpret_cast<ControlPacket*>(candidate.packet->packet);
+        if (waiting->dst == cPacket->dst && waiting->type == cPacket->type && waiting->seq_id == cPacket->seq_id &&
+            (PacketService::isAckPacket(cPacket->type) || waiting->number == cPacket->number)) {
+            slot = &candidate;
+            replaced = candidate.packet;
+            break;
+        }
+    }
+
+    if (slot != nullptr) {
+        slot->packet = qp;
+        if (replaced == nullptr)
+            slot->deadline = deadline;
+    }
+    portEXIT_CRITICAL(&delayedAckMux);
+
+    if (slot == nullptr) {
+        delete qp;
+        return false;
+    }
+
+    if (replaced != nullptr) {
+        ESP_LOGV(LM_TAG, "Delayed ACK of the sequence %d to %X replaced", cPacket->seq_id, cPacket->dst);
+        incStat(stats.coalescedAcksNum);
+        PacketQueueService::deleteQueuePacketAndPacket(replaced);
+        return true;
+    }
+
+    delayedAckTimers->arm(&slot->timer, deadline);
+    return true;
+}
+
+void LoraMesher::takeDelayedAcks(uint16_t nextHop, QueuePacket<Packet<uint8_t>>** parts, size_t& numOfParts, size_t& aggregateSize) {
+    size_t maxPacketSize = PacketFactory::getMaxPacketSize();
+
+    for (size_t i = 0; i < LM_DELAYED_ACK_SLOTS && numOfParts < LM_MAX_AGGREGATED_PACKETS; i++) {
+        DelayedAckSlot& slot = delayedAckSlots[i];
+
+        // The next hop is looked up outside of the mux, the slot is checked again when it is taken
+        portENTER_CRITICAL(&delayedAckMux);
+        QueuePacket<Packet<uint8_t>>* qp = slot.packet;
+        uint16_t dst = qp != nullptr ? qp->packet->dst : 0;
+        portEXIT_CRITICAL(&delayedAckMux);
+
+        if (qp == nullptr || RoutingTableService::getNextHop(dst) != nextHop)
+            continue;
+
+        portENTER_CRITICAL(&delayedAckMux);
+        size_t length = slot.packet != nullptr ? getAggregatedLength(slot.packet->packet) : 0;
+        qp = length != 0 && aggregateSize + length <= maxPacketSize ? slot.packet : nullptr;
+        if (qp != nullptr)
+            slot.packet = nullptr;
+        portEXIT_CRITICAL(&delayedAckMux);
+
+        if (qp == nullptr)
+            continue;
+
+        delayedAckTimers->cancel(&slot.timer);
+        parts[numOfParts++] = qp;
+        aggregateSize += length;
+        incStat(stats.piggybackedAcksNum);
+    }
+}
+
+bool LoraMesher::hasQueuedDataPacket(uint16_t nextHop) {
+    bool found = false;
+
+    ToSendPackets->setInUse();
+    if (ToSendPackets->moveToStart()) {
+        do {
+            Packet<uint8_t>* p = ToSendPackets->getCurrent()->packet;
+            found = PacketService::isOnlyDataPacket(p->type) && ToSendPackets->getCurrentFlow() == nextHop;
+        } while (!found && ToSendPackets->next());
+    }
+    ToSendPackets->releaseInUse();
+
+    return found;
+}
+
+void LoraMesher::managerDelayedAcks() {
+    delayedAckTimers->expire(millis(), [this](LM_Timer* timer) {
+        DelayedAckSlot* slot = static_cast<DelayedAckSlot*>(timer->context);
+        QueuePacket<Packet<uint8_t>>* qp = nullptr;
+
+        // A slot taken and reused meanwhile has a later deadline
+        portENTER_CRITICAL(&delayedAckMux);
+        if (slot->packet != nullptr && (int32_t) (millis() - slot->deadline) >= 0) {
+            qp = slot->packet;
+            slot->packet = nullptr;
+        }
+        portEXIT_CRITICAL(&delayedAckMux);
+
+        if (qp == nullptr)
+            return;
+
+        // A data packet to the same next hop waits in the send queue, it takes the ACK when it is sent
+        uint16_t nextHop = RoutingTableService::getNextHop(qp->packet->dst);
+        if (nextHop != 0 && hasQueuedDataPacket(nextHop)) {
+            portENTER_CRITICAL(&delayedAckMux);
+            bool free = slot->packet == nullptr;
+            if (free) {
+                slot->packet = qp;
+                slot->deadline = millis() + loraMesherConfig->delayedAck;
+            }
+            portEXIT_CRITICAL(&delayedAckMux);
+
+            if (free) {
+                delayedAckTimers->arm(&slot->timer, slot->deadline);
+                return;
+            }
+        }
+
+        ESP_LOGV(LM_TAG, "Delayed ACK of the sequence %d to %X sent alone", (reinterpret_cast<ControlPacket*>(qp->packet))->seq_id,
+            qp->packet->dst);
+        addToSendOrderedAndNotify(qp);
+    });
+}
+
+LM_EnqueueResult LoraMesher::sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num) {
+    // Check if the sequence number requested is valid
+    if (lstConfig->config->lastAck > seq_num) {
+        ESP_LOGE(LM_TAG, "Trying to send packet sequence previously acknowledged Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
+        return ENQUEUE_INVALID;
+    }
 
+    //The packets of a source are read again every time they are sent
+    if (lstConfig->readChunk != nullptr && seq_num != 0) {
+        Packet<uint8_t>* p = readSequencePacket(lstConfig, seq_num);
+        if (p == nullptr)
+            return ENQUEUE_INVALID;
+
+        return setPackedForSend(p, DEFAULT_PRIORITY);
     }
-    else
-        deletePacket(appPacket);
-}
 
-uint32_t LoraMesher::getPropagationTimeWithRandom(uint8_t multiplayer) {
-    // TODO: Use the RTT or other congestion metrics to calculate the time, timeouts...
-    uint32_t time = getMaxPropagationTime();
-    uint32_t randomTime = random(time, time * 3 + (multiplayer + routingTableSize()) * 100);
-    return randomTime;
-}
+    //Get the packet queue with the sequence number
+    QueuePacket<ControlPacket>* pq = PacketQueueService::findPacketQueue(lstConfig->list, seq_num);
 
-void LoraMesher::recalculateMaxTimeOnAir() {
-    maxTimeOnAir = radio->getTimeOnAir(PacketFactory::getMaxPacketSize()) / 1000;
-    ESP_LOGV(LM_TAG, "Max Time on Air changed %d ms", (int)maxTimeOnAir);
-}
+    if (pq == nullptr) {
+        ESP_LOGE(LM_TAG, "NOT FOUND the packet queue with Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
+        return ENQUEUE_INVALID;
+    }
 
-void LoraMesher::recordState(LM_StateType type, Packet<uint8_t>* packet) {
-    if (simulatorService == nullptr)
-        return;
+    //Create the packet
+    Packet<uint8_t>* p = PacketService::copyPacket(pq->packet, pq->packet->getPacketLength());
 
-    simulatorService->addState(ReceivedPackets->getLength(), getSendQueueSize(),
-        getReceivedQueueSize(), routingTableSize(), q_WRP->getLength(), q_WSP->getLength(),
-        type, packet);
+    //Add the packet to the send queue
+    return setPackedForSend(p, DEFAULT_PRIORITY);
 }
 
-#ifdef LM_TESTING
-bool LoraMesher::canReceivePacket(uint16_t source) {
-	return true;
-}
-#endif
+Packet<uint8_t>* LoraMesher::readSequencePacket(listConfiguration* lstConfig, uint16_t seq_num) {
+    sequencePacketConfig* config = lstConfig->config;
+    uint8_t fecGroup = lstConfig->fecGroup;
+    uint16_t groups = fecGroup == 0 ? 0 : (config->number + fecGroup - 1) / fecGroup;
+    if (seq_num == 0 || seq_num > config->number + groups)
+        return nullptr;
 
-#ifdef LM_TESTING
-bool LoraMesher::isDataPacketAndLocal(DataPacket* packet, uint16_t localAddress) {
-    return PacketService::isDataPacket(packet->type) && packet->via == localAddress;
-}
+    uint8_t type = NEED_ACK_P | XL_DATA_P;
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(type);
 
-bool LoraMesher::shouldProcessPacket(Packet<uint8_t>* packet) {
-    return isDataPacketAndLocal(reinterpret_cast<DataPacket*>(packet), getLocalAddress()) || canReceivePacket(packet->src);
-}
-#endif
+    //A parity packet is full, the XOR of the packets of its group padded with zeros
+    bool parity = seq_num > config->number;
+    uint32_t offset = (uint32_t) (seq_num - 1) * maxPayloadSize;
+    size_t payloadSize = parity ? maxPayloadSize : std::min<uint32_t>(maxPayloadSize, lstConfig->payloadSize - offset);
 
-/**
- *  End Region Packet Service
-**/
+    ControlPacket* cPacket = PacketService::createControlPacket(config->source, getLocalAddress(), type, nullptr, payloadSize);
+    if (cPacket == nullptr)
+        return nullptr;
 
+    cPacket->number = seq_num;
+    cPacket->seq_id = config->seq_id;
 
-/**
- *  Region Routing Table
-**/
+    bool read = true;
+    if (!parity)
+        read = lstConfig->readChunk(offset, cPacket->payload, payloadSize, lstConfig->readContext);
+    else {
+        memset(cPacket->payload, 0, payloadSize);
+
+        uint8_t chunk[LM_MAX_PACKET_SIZE];
+        uint16_t first = (seq_num - config->number - 1) * fecGroup + 1;
+        uint16_t last = std::min<uint16_t>(first + fecGroup - 1, config->number);
+        for (uint16_t number = first; number <= last && read; number++) {
+            offset = (uint32_t) (number - 1) * maxPayloadSize;
+            size_t chunkSize = std::min<uint32_t>(maxPayloadSize, lstConfig->payloadSize - offset);
+            read = lstConfig->readChunk(offset, chunk, chunkSize, lstConfig->readContext);
+
+            for (size_t i = 0; i < chunkSize && read; i++)
+                cPacket->payload[i] ^= chunk[i];
+        }
+    }
 
-size_t LoraMesher::routingTableSize() {
-    return RoutingTableService::routingTableSize();
+    if (!read) {
+        ESP_LOGE(LM_TAG, "Source of the sequence Seq_id: %d failed reading Num: %d", config->seq_id, seq_num);
+        PacketPoolService::release(cPacket);
+        return nullptr;
+    }
+
+    return reinterpret_cast<Packet<uint8_t>*>(cPacket);
 }
 
-/**
- *  End Region Routing Table
-**/
+void LoraMesher::sendSequenceWindow(listConfiguration* listConfig) {
+    sequencePacketConfig* config = listConfig->config;
+    uint32_t windowEnd = (uint32_t) config->lastAck + getSequenceWindow(listConfig);
 
+    while (config->sentNumber < config->number && config->sentNumber < windowEnd) {
+        config->sentNumber++;
 
-/**
- *  Region PacketQueue
-**/
+        //Time one packet at a time
+        if (!config->measuringRTT) {
+            config->rttNumber = config->sentNumber;
+            config->calculatingRTT = millis();
+            config->measuringRTT = true;
+        }
 
-size_t LoraMesher::getReceivedQueueSize() {
-    return ReceivedAppPackets->getLength();
-}
+        sendPacketSequence(listConfig, config->sentNumber);
 
-size_t LoraMesher::getSendQueueSize() {
-    return ToSendPackets->getLength();
+        //The parity packet follows the last packet of its group
+        uint8_t fecGroup = listConfig->fecGroup;
+        if (fecGroup != 0 && (config->sentNumber % fecGroup == 0 || config->sentNumber == config->number))
+            sendPacketSequence(listConfig, config->number + 1 + (config->sentNumber - 1) / fecGroup);
+    }
 }
 
-void LoraMesher::addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp) {
-    PacketQueueService::addOrdered(ToSendPackets, qp);
-    ESP_LOGI(LM_TAG, "Added packet to Q_SP, notifying sender task");
+uint32_t LoraMesher::getSelectiveAck(listConfiguration* listConfig) {
+    sequencePacketConfig* config = listConfig->config;
+    uint32_t sack = 0;
 
-    //Notify the sendData task handle
-    xTaskNotify(SendData_TaskHandle, 0, eSetValueWithOverwrite);
-}
+    for (uint8_t i = 0; i < LM_SACK_BITS; i++) {
+        uint32_t number = (uint32_t) config->lastAck + 2 + i;
+        if (number > config->number)
+            break;
 
-void LoraMesher::notifyNewSequenceStarted() {
-    //Notify the sendData task handle
-    xTaskNotify(QueueManager_TaskHandle, 0, eSetValueWithOverwrite);
+        if ((listConfig->receivedBitmap[(number - 1) / 8] & (1 << ((number - 1) % 8))) != 0)
+            sack |= (uint32_t) 1 << i;
+    }
+
+    return sack;
 }
 
-/**
- *  End Region PacketQueue
-**/
+uint8_t LoraMesher::getSequenceWindow(listConfiguration* listConfig) {
+    StreamConfig* stream = listConfig->stream;
+    if (stream == nullptr)
+        return std::max(getReliableWindowSize(), listConfig->fecGroup);
 
+    portENTER_CRITICAL(&streamsMux);
+    uint8_t window = (uint8_t) stream->congestionWindow;
+    portEXIT_CRITICAL(&streamsMux);
 
-/**
- * Large and Reliable payloads
- */
+    return window;
+}
 
-QueuePacket<ControlPacket>* LoraMesher::getStartSequencePacketQueue(uint16_t destination, uint8_t seq_id, uint16_t num_packets) {
-    uint8_t type = SYNC_P | NEED_ACK_P | XL_DATA_P;
+bool LoraMesher::isWindowedSequence(listConfiguration* listConfig) {
+    return listConfig->stream != nullptr || listConfig->fecGroup != 0 || getReliableWindowSize() > 1;
+}
 
-    //Create the packet
-    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, num_packets);
+void LoraMesher::growStreamWindow(listConfiguration* listConfig, bool queueing) {
+    StreamConfig* stream = listConfig->stream;
+    if (stream == nullptr || queueing)
+        return;
 
-    //Create a packet queue
-    return PacketQueueService::createQueuePacket(cPacket, DEFAULT_PRIORITY, 0);
-}
+    portENTER_CRITICAL(&streamsMux);
 
-void LoraMesher::sendAckPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num) {
-    uint8_t type = ACK_P;
+    // Slow start below the threshold, one packet every window after it
+    if (stream->congestionWindow < stream->slowStartThreshold)
+        stream->congestionWindow += 1;
+    else
+        stream->congestionWindow += 1 / stream->congestionWindow;
 
-    //Create the packet
-    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+    if (stream->congestionWindow > LM_SACK_BITS + 1)
+        stream->congestionWindow = LM_SACK_BITS + 1;
 
-    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 3);
+    portEXIT_CRITICAL(&streamsMux);
 }
 
-void LoraMesher::sendLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num) {
-    uint8_t type = LOST_P;
+void LoraMesher::shrinkStreamWindow(listConfiguration* listConfig, bool timeout) {
+    StreamConfig* stream = listConfig->stream;
+    if (stream == nullptr)
+        return;
 
-    //Create the packet
-    ControlPacket* cPacket = PacketService::createEmptyControlPacket(destination, getLocalAddress(), type, seq_id, seq_num);
+    // The losses of the same window are signalled during one RTT, they decrease it once
+    RouteNode* node = listConfig->config->node;
+    uint32_t srtt = node == nullptr ? 0 : node->SRTT;
+    uint32_t now = millis();
 
-    setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(cPacket), DEFAULT_PRIORITY + 2);
-}
+    portENTER_CRITICAL(&streamsMux);
 
-bool LoraMesher::sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num) {
-    // Check if the sequence number requested is valid
-    if (lstConfig->config->lastAck > seq_num) {
-        ESP_LOGE(LM_TAG, "Trying to send packet sequence previously acknowledged Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
-        return false;
+    if (timeout || now - stream->lastDecrease >= srtt) {
+        stream->slowStartThreshold = std::max(stream->congestionWindow / 2, 1.0f);
+        stream->congestionWindow = timeout ? 1 : stream->slowStartThreshold;
+        stream->lastDecrease = now;
     }
 
-    //Get the packet queue with the sequence number
-    QueuePacket<ControlPacket>* pq = PacketQueueService::findPacketQueue(lstConfig->list, seq_num);
+    portEXIT_CRITICAL(&streamsMux);
+}
 
-    if (pq == nullptr) {
-        ESP_LOGE(LM_TAG, "NOT FOUND the packet queue with Seq_id: %d, Num: %d", lstConfig->config->seq_id, seq_num);
+bool LoraMesher::isRTTAboveVariance(sequencePacketConfig* config) {
+    RouteNode* node = config->node;
+    if (node == nullptr || node->SRTT == 0 || config->calculatingRTT == 0)
         return false;
-    }
 
-    //Create the packet
-    Packet<uint8_t>* p = PacketService::copyPacket(pq->packet, pq->packet->getPacketLength());
+    return millis() - config->calculatingRTT > node->SRTT + 2 * node->RTTVAR;
+}
 
-    //Add the packet to the send queue
-    setPackedForSend(p, DEFAULT_PRIORITY);
+uint8_t LoraMesher::getReliableWindowSize() {
+    uint8_t window = loraMesherConfig->reliableWindowSize;
+    if (window == 0)
+        return 1;
 
-    return true;
+    return std::min(window, (uint8_t) (LM_SACK_BITS + 1));
 }
 
-void LoraMesher::addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num) {
+void LoraMesher::addAck(uint16_t source, uint16_t seq_id, uint16_t seq_num, uint32_t sack) {
     listConfiguration* config = findSequenceList(q_WSP, seq_id, source);
     if (config == nullptr) {
         ESP_LOGE(LM_TAG, "NOT FOUND the sequence packet config in add ack with Seq_id: %d, Source: %d", seq_id, source);
@@ -1146,7 +5691,13 @@ void LoraMesher::addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num) {
     //Delete this sequence
     if (config->config->number == seq_num) {
         ESP_LOGI(LM_TAG, "All the packets has been arrived to the seq_Id: %d", seq_id);
+        bool stream = config->stream != nullptr;
+        config->config->lastAck = seq_num;
         findAndClearLinkedList(q_WSP, config);
+
+        //Start the next chunk of the stream
+        if (stream)
+            sendStreams();
         return;
     }
 
@@ -1158,6 +5709,47 @@ void LoraMesher::addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num) {
     //Set has been received some ACK
     config->config->firstAckReceived = 1;
 
+    if (isWindowedSequence(config)) {
+        sequencePacketConfig* seqConfig = config->config;
+        bool advanced = seq_num > seqConfig->lastAck || seqConfig->sentNumber == 0;
+
+        seqConfig->lastAck = seq_num;
+
+        // Karn's algorithm, only the packets not retransmitted are timed
+        bool queueing = false;
+        if (seqConfig->measuringRTT && seq_num >= seqConfig->rttNumber) {
+            queueing = isRTTAboveVariance(seqConfig);
+            actualizeRTT(seqConfig);
+            seqConfig->measuringRTT = false;
+        }
+
+        if (advanced) {
+            resetTimeout(seqConfig);
+            growStreamWindow(config, queueing);
+        }
+
+        //The parity of the group of the missing one can rebuild it, unless the packets after the group have been received
+        bool rebuildable = false;
+        if (config->fecGroup != 0) {
+            uint32_t groupEnd = ((uint32_t) seq_num / config->fecGroup + 1) * config->fecGroup;
+            rebuildable = groupEnd < seqConfig->number && (groupEnd - seq_num - 1 >= 32 || (sack >> (groupEnd - seq_num - 1)) == 0);
+        }
+
+        //Packets after the next one have been received, retransmit the missing one once
+        if (sack != 0 && !rebuildable && seq_num + 1 <= seqConfig->sentNumber && seqConfig->retransmitNumber != seq_num + 1) {
+            ESP_LOGV(LM_TAG, "Selective ACK %X, retransmitting Seq_id: %d, Num: %d", (unsigned int)sack, seq_id, seq_num + 1);
+            seqConfig->retransmitNumber = seq_num + 1;
+            if (seqConfig->rttNumber == seq_num + 1)
+                seqConfig->measuringRTT = false;
+
+            shrinkStreamWindow(config, false);
+            sendPacketSequence(config, seq_num + 1);
+        }
+
+        sendSequenceWindow(config);
+        return;
+    }
+
     // TODO: Check for repeated ACKs and packets.
 
     //Add the last ack to the config packet
@@ -1181,102 +5773,140 @@ bool LoraMesher::processLargePayloadPacket(QueuePacket<ControlPacket>* pq) {
     listConfiguration* configList = findSequenceList(q_WRP, cPacket->seq_id, cPacket->src);
     if (configList == nullptr) {
         ESP_LOGE(LM_TAG, "NOT FOUND the sequence packet config in Process Large Payload with Seq_id: %d, Source: %d", cPacket->seq_id, cPacket->src);
-        PacketQueueService::deleteQueuePacketAndPacket(pq);
         return false;
     }
 
-    if (configList->config->lastAck + 1 != cPacket->number) {
-        ESP_LOGE(LM_TAG, "Sequence number received in bad order in seq_Id: %d, received: %d expected: %d", cPacket->seq_id, cPacket->number, configList->config->lastAck + 1);
-        sendLostPacket(cPacket->src, cPacket->seq_id, configList->config->lastAck + 1);
+    sequencePacketConfig* config = configList->config;
+    uint16_t number = cPacket->number;
 
-        PacketQueueService::deleteQueuePacketAndPacket(pq);
+    uint8_t fecGroup = configList->fecGroup;
+    uint16_t groups = fecGroup == 0 ? 0 : (config->number + fecGroup - 1) / fecGroup;
+    bool parity = number > config->number && number <= config->number + groups;
+
+    if (number == 0 || (number > config->number && !parity)) {
+        ESP_LOGE(LM_TAG, "Sequence number out of range in seq_Id: %d, received: %d of %d", cPacket->seq_id, number, config->number);
         return false;
     }
 
-    configList->config->lastAck++;
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    size_t payloadSize = PacketService::getPacketPayloadLength(cPacket);
 
-    configList->list->setInUse();
-    configList->list->Append(pq);
-    configList->list->releaseInUse();
+    //All the packets except the last one are full
+    if (payloadSize > maxPayloadSize || ((parity || number != config->number) && payloadSize != maxPayloadSize)) {
+        ESP_LOGE(LM_TAG, "Wrong payload size in seq_Id: %d, Num: %d, size: %d", cPacket->seq_id, number, payloadSize);
+        return false;
+    }
 
-    //Send ACK
-    sendAckPacket(cPacket->src, cPacket->seq_id, cPacket->number);
+    uint16_t group = parity ? number - config->number - 1 : (number - 1) / std::max<uint8_t>(fecGroup, 1);
+    uint8_t bit = parity ? 1 << (group % 8) : 1 << ((number - 1) % 8);
+    uint8_t* bitmapByte = parity ? &configList->fecParityBitmap[group / 8] : &configList->receivedBitmap[(number - 1) / 8];
 
-    // Recalculate the RTT
-    actualizeRTT(configList->config);
+    if ((*bitmapByte & bit) == 0) {
+        //Copy the payload straight to its offset
+        if (!parity) {
+            memcpy(configList->appPacket->payload + (number - 1) * maxPayloadSize, cPacket->payload, payloadSize);
+            configList->receivedPayloadSize += payloadSize;
+        }
 
-    // Reset the timeouts
-    resetTimeout(configList->config);
+        *bitmapByte |= bit;
 
-    //All packets has been arrived, join them and send to the user
-    if (configList->config->lastAck == configList->config->number) {
-        joinPacketsAndNotifyUser(configList);
-        return true;
+        //Every packet received is added to the XOR of its group
+        if (fecGroup != 0) {
+            uint8_t* groupParity = configList->fecParity + group * maxPayloadSize;
+            for (size_t i = 0; i < payloadSize; i++)
+                groupParity[i] ^= cPacket->payload[i];
+        }
     }
+    else
+        ESP_LOGW(LM_TAG, "Repeated packet in seq_Id: %d, Num: %d", cPacket->seq_id, number);
 
-    return true;
-}
+    //A parity packet is not acknowledged, unless it rebuilds a packet
+    bool rebuilt = fecGroup != 0 && rebuildFecGroup(configList, group);
+    if (parity && !rebuilt)
+        return true;
 
-void LoraMesher::joinPacketsAndNotifyUser(listConfiguration* listConfig) {
-    ESP_LOGV(LM_TAG, "Joining packets seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
+    //Advance the last ack over the consecutive packets received
+    uint16_t previousAck = config->lastAck;
+    while (config->lastAck < config->number &&
+        (configList->receivedBitmap[config->lastAck / 8] & (1 << (config->lastAck % 8))) != 0)
+        config->lastAck++;
 
-    LM_LinkedList<QueuePacket<ControlPacket>>* list = listConfig->list;
+    if (config->lastAck == previousAck && number != config->lastAck + 1) {
+        ESP_LOGW(LM_TAG, "Sequence number received in bad order in seq_Id: %d, received: %d expected: %d", cPacket->seq_id, number, config->lastAck + 1);
 
-    list->setInUse();
-    if (!list->moveToStart()) {
-        list->releaseInUse();
-        return;
+        //Repeat the last ACK, the selective ACK tells the sender which one is missing
+        sendAckPacket(cPacket->src, cPacket->seq_id, config->lastAck, getSelectiveAck(configList));
+
+        return true;
     }
 
-    //TODO: getPacketPayloadLength could be done when adding the packets inside the list
-    size_t payloadSize = 0;
-    size_t number = 1;
+    //Send ACK
+    sendAckPacket(cPacket->src, cPacket->seq_id, config->lastAck, getSelectiveAck(configList));
 
-    do {
-        ControlPacket* currentP = reinterpret_cast<ControlPacket*>(list->getCurrent()->packet);
+    // Recalculate the RTT
+    actualizeRTT(config);
 
-        if (number != (currentP->number))
-            //TODO: ORDER THE PACKETS if they are not ordered?
-            ESP_LOGE(LM_TAG, "Wrong packet order");
+    // Reset the timeouts
+    resetTimeout(config);
 
-        number++;
-        payloadSize += PacketService::getPacketPayloadLength(currentP);
-    } while (list->next());
+    //All packets has been arrived, send them to the user
+    if (config->lastAck == config->number)
+        joinPacketsAndNotifyUser(configList, pq);
 
-    //Move to start again
-    list->moveToStart();
+    return true;
+}
 
-    ControlPacket* currentP = list->getCurrent()->packet;
+bool LoraMesher::rebuildFecGroup(listConfiguration* listConfig, uint16_t group) {
+    if ((listConfig->fecParityBitmap[group / 8] & (1 << (group % 8))) == 0)
+        return false;
 
-    uint32_t appPacketLength = sizeof(AppPacket<uint8_t>);
+    sequencePacketConfig* config = listConfig->config;
+    uint16_t first = group * listConfig->fecGroup + 1;
+    uint16_t last = std::min<uint16_t>(first + listConfig->fecGroup - 1, config->number);
 
-    //Packet length = size of the packet + size of the payload
-    uint32_t packetLength = appPacketLength + payloadSize;
+    //Only one packet of the group can be lost
+    uint16_t missing = 0;
+    for (uint16_t number = first; number <= last; number++) {
+        if ((listConfig->receivedBitmap[(number - 1) / 8] & (1 << ((number - 1) % 8))) != 0)
+            continue;
 
-    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(pvPortMalloc(packetLength));
+        if (missing != 0)
+            return false;
 
-    ESP_LOGV(LM_TAG, "Large Packet Packet length: %d Payload Size: %d", (int)packetLength, payloadSize);
+        missing = number;
+    }
 
-    if (p) {
-        //Copy the payload into the packet
-        unsigned long actualPayloadSizeDst = appPacketLength;
+    if (missing == 0)
+        return false;
 
-        do {
-            currentP = list->getCurrent()->packet;
+    //The XOR of the parity and the rest of the packets is the packet lost
+    size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+    size_t payloadSize = missing == config->number ? listConfig->fecLastSize : maxPayloadSize;
 
-            size_t actualPayloadSizeSrc = PacketService::getPacketPayloadLength(currentP);
+    memcpy(listConfig->appPacket->payload + (missing - 1) * maxPayloadSize, listConfig->fecParity + group * maxPayloadSize, payloadSize);
+    listConfig->receivedBitmap[(missing - 1) / 8] |= 1 << ((missing - 1) % 8);
+    listConfig->receivedPayloadSize += payloadSize;
 
-            memcpy(reinterpret_cast<void*>((unsigned long)p + (actualPayloadSizeDst)), currentP->payload, actualPayloadSizeSrc);
-            actualPayloadSizeDst += actualPayloadSizeSrc;
-        } while (list->next());
-    }
+    ESP_LOGV(LM_TAG, "Packet rebuilt from the parity in seq_Id: %d, Num: %d", config->seq_id, missing);
+    incFecRebuilt();
+
+    return true;
+}
 
-    list->releaseInUse();
+void LoraMesher::joinPacketsAndNotifyUser(listConfiguration* listConfig, QueuePacket<ControlPacket>* last) {
+    ESP_LOGV(LM_TAG, "Joining packets seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
+
+    //Take the reassembly buffer, it is not deleted with the sequence
+    AppPacket<uint8_t>* p = listConfig->appPacket;
+    listConfig->appPacket = nullptr;
 
     //Set values to the AppPacket
-    p->payloadSize = payloadSize;
+    p->payloadSize = listConfig->receivedPayloadSize;
     p->src = listConfig->config->source;
     p->dst = getLocalAddress();
+    setAppPacketMetadata(p, last);
+
+    ESP_LOGV(LM_TAG, "Large Packet Payload Size: %d", (int)p->payloadSize);
 
     //TODO: When finished, clear everything? Or maintain the config until timeout?
     findAndClearLinkedList(q_WRP, listConfig);
@@ -1284,31 +5914,60 @@ void LoraMesher::joinPacketsAndNotifyUser(listConfiguration* listConfig) {
     notifyUserReceivedPacket(p);
 }
 
-void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num) {
+void LoraMesher::processSyncPacket(uint16_t source, uint16_t seq_id, uint16_t seq_num, uint8_t fecGroup, uint8_t lastSize) {
     //Check for repeated sequence lists
     listConfiguration* listConfig = findSequenceList(q_WRP, seq_id, source);
 
     if (listConfig == nullptr) {
+        if (seq_num == 0) {
+            ESP_LOGW(LM_TAG, "Synchronization packet without packets");
+            return;
+        }
+
         // Get the Routing Table node of the destination
-        RouteNode* node = RoutingTableService::findNode(source);
+        RouteNode* node = RoutingTableService::findRoute(source);
 
         if (node == nullptr) {
             ESP_LOGW(LM_TAG, "Node not found in the routing table");
             return;
         }
 
+        //Allocate the reassembly buffer for all the packets of the sequence
+        size_t maxPayloadSize = PacketService::getMaximumPayloadLength(NEED_ACK_P | XL_DATA_P);
+        uint32_t packetLength = sizeof(AppPacket<uint8_t>) + (uint32_t) seq_num * maxPayloadSize;
+
+        AppPacket<uint8_t>* appPacket = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocateBulk(packetLength));
+        if (appPacket == nullptr) {
+            ESP_LOGE(LM_TAG, "Large payload of %d bytes not allocated, Seq_id: %d", (int)packetLength, seq_id);
+            return;
+        }
+
         //Create the pair of configuration
         listConfig = new listConfiguration();
-        listConfig->config = new sequencePacketConfig(seq_id, source, seq_num, node);
-        listConfig->list = new LM_LinkedList<QueuePacket<ControlPacket>>();
+        listConfig->config = new sequencePacketConfig(seq_id, source, seq_num, node, wrpTimers, listConfig);
+        listConfig->appPacket = appPacket;
+        listConfig->receivedBitmap = new uint8_t[(seq_num + 7) / 8]();
+
+        if (fecGroup != 0 && fecGroup <= LM_SACK_BITS && lastSize != 0 && lastSize <= maxPayloadSize) {
+            uint16_t groups = (seq_num + fecGroup - 1) / fecGroup;
+            listConfig->fecGroup = fecGroup;
+            listConfig->fecLastSize = lastSize;
+            listConfig->fecParity = new uint8_t[groups * maxPayloadSize]();
+            listConfig->fecParityBitmap = new uint8_t[(groups + 7) / 8]();
+            listConfig->memoryBytes += groups * maxPayloadSize + (groups + 7) / 8;
+        }
+
+        listConfig->memoryBytes += sizeof(listConfiguration) + sizeof(sequencePacketConfig) + (seq_num + 7) / 8;
+        MemoryService::add(MEMORY_SEQUENCES, listConfig->memoryBytes);
 
         // Starting to calculate RTT
         actualizeRTT(listConfig->config);
 
         //Add list configuration to the waiting received packets queue
-        q_WRP->setInUse();
-        q_WRP->Append(listConfig);
-        q_WRP->releaseInUse();
+        if (!appendSequence(q_WRP, listConfig)) {
+            clearLinkedList(listConfig);
+            return;
+        }
 
         // Reset the timeout
         addTimeout(listConfig->config);
@@ -1322,7 +5981,7 @@ void LoraMesher::processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq
     }
 }
 
-void LoraMesher::processLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num) {
+void LoraMesher::processLostPacket(uint16_t destination, uint16_t seq_id, uint16_t seq_num) {
     //Find the list config
     listConfiguration* listConfig = findSequenceList(q_WSP, seq_id, destination);
 
@@ -1342,16 +6001,29 @@ void LoraMesher::processLostPacket(uint16_t destination, uint8_t seq_id, uint16_
     // If the first sync is received but the first ack is not, then the receiver will send a first lost packet.
     listConfig->config->firstAckReceived = 1;
 
+    if (isWindowedSequence(listConfig)) {
+        sequencePacketConfig* seqConfig = listConfig->config;
+
+        //All the packets before the lost one have been received
+        if (seq_num > 0 && seq_num - 1 > seqConfig->lastAck)
+            seqConfig->lastAck = seq_num - 1;
+
+        if (seqConfig->measuringRTT && seqConfig->rttNumber == seq_num)
+            seqConfig->measuringRTT = false;
+
+        shrinkStreamWindow(listConfig, false);
+    }
+
     //Send the packet sequence that has been lost
-    if (sendPacketSequence(listConfig, seq_num)) {
+    if (isEnqueued(sendPacketSequence(listConfig, seq_num))) {
         listConfig->config->numberOfTimeouts++;
         //Reset the timeout of this sequence packets inside the q_WSP
         recalculateTimeoutAfterTimeout(listConfig->config);
     }
 }
 
-void LoraMesher::addTimeout(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source) {
-    listConfiguration* config = findSequenceList(q_WSP, seq_id, source);
+void LoraMesher::addTimeout(LM_LinkedList<listConfiguration>* queue, uint16_t seq_id, uint16_t source) {
+    listConfiguration* config = findSequenceList(queue, seq_id, source);
     if (config == nullptr) {
         ESP_LOGE(LM_TAG, "NOT FOUND the sequence packet config in add timeout with Seq_id: %d, Source: %d", seq_id, source);
         return;
@@ -1402,22 +6074,37 @@ void LoraMesher::actualizeRTT(sequencePacketConfig* config) {
 }
 
 void LoraMesher::clearLinkedList(listConfiguration* listConfig) {
-    LM_LinkedList<QueuePacket<ControlPacket>>* list = listConfig->list;
-    list->setInUse();
     ESP_LOGI(LM_TAG, "Clearing list configuration Seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
 
-    size_t listSize = list->getLength();
+    LM_LinkedList<QueuePacket<ControlPacket>>* list = listConfig->list;
+    if (list != nullptr) {
+        list->setInUse();
+
+        size_t listSize = list->getLength();
 
-    ESP_LOGV(LM_TAG, "List size: %d", listSize);
+        ESP_LOGV(LM_TAG, "List size: %d", listSize);
 
-    for (int i = 0; i < listSize; i++) {
-        QueuePacket<ControlPacket>* current = list->getCurrent();
-        PacketQueueService::deleteQueuePacketAndPacket(current);
-        list->DeleteCurrent();
+        for (size_t i = 0; i < listSize; i++) {
+            QueuePacket<ControlPacket>* current = list->getCurrent();
+            PacketQueueService::deleteQueuePacketAndPacket(current);
+            list->DeleteCurrent();
+        }
+
+        delete list;
     }
 
-    delete list;
+    if (listConfig->stream != nullptr)
+        endStreamSequence(listConfig->stream, listConfig->config->lastAck == listConfig->config->number);
+
+    if (listConfig->transfer != 0)
+        TransferService::complete(listConfig->transfer, listConfig->config->lastAck == listConfig->config->number);
+
+    PacketPoolService::release(listConfig->appPacket);
+    delete[] listConfig->receivedBitmap;
+    delete[] listConfig->fecParity;
+    delete[] listConfig->fecParityBitmap;
     delete listConfig->config;
+    MemoryService::remove(MEMORY_SEQUENCES, listConfig->memoryBytes);
     delete listConfig;
 }
 
@@ -1427,45 +6114,74 @@ void LoraMesher::findAndClearLinkedList(LM_LinkedList<listConfiguration>* queue,
     if (!queue->Search(listConfig)) {
         ESP_LOGE(LM_TAG, "Not found list config");
         queue->releaseInUse();
+        return;
     }
 
-    clearLinkedList(listConfig);
-
-    queue->DeleteCurrent();
+    deleteCurrentSequence(queue);
 
     queue->releaseInUse();
 }
 
-LoraMesher::listConfiguration* LoraMesher::findSequenceList(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source) {
+bool LoraMesher::appendSequence(LM_LinkedList<listConfiguration>* queue, listConfiguration* listConfig) {
     queue->setInUse();
 
-    if (queue->moveToStart()) {
-        do {
-            listConfiguration* current = queue->getCurrent();
-
-            if (current->config->seq_id == seq_id && current->config->source == source) {
-                queue->releaseInUse();
-                return current;
-            }
-
-        } while (queue->next());
+    if (!getSequenceIndex(queue)->insert(getSequenceKey(listConfig->config->source, listConfig->config->seq_id), listConfig)) {
+        queue->releaseInUse();
+        ESP_LOGE(LM_TAG, "Too many sequences, not adding Seq_Id: %d Src: %X", listConfig->config->seq_id, listConfig->config->source);
+        return false;
     }
 
+    queue->Append(listConfig);
+
     queue->releaseInUse();
+    return true;
+}
 
-    return nullptr;
+void LoraMesher::deleteCurrentSequence(LM_LinkedList<listConfiguration>* queue) {
+    listConfiguration* current = queue->getCurrent();
+
+    SequenceIndex* index = getSequenceIndex(queue);
+    uint32_t key = getSequenceKey(current->config->source, current->config->seq_id);
+
+    // A newer sequence with the same key can replace it inside the index
+    if (index->find(key) == current)
+        index->remove(key);
+
+    clearLinkedList(current);
+    queue->DeleteCurrent();
+}
+
+LoraMesher::listConfiguration* LoraMesher::findSequenceList(LM_LinkedList<listConfiguration>* queue, uint16_t seq_id, uint16_t source) {
+    queue->setInUse();
 
+    listConfiguration* listConfig = getSequenceIndex(queue)->find(getSequenceKey(source, seq_id));
+
+    queue->releaseInUse();
+
+    return listConfig;
 }
 
 void LoraMesher::managerReceivedQueue() {
-    managerTimeouts(q_WRP, QueueType::WRP);
+    managerTimeouts(q_WRP, wrpTimers, QueueType::WRP);
 }
 
 void LoraMesher::managerSendQueue() {
-    managerTimeouts(q_WSP, QueueType::WSP);
+    managerTimeouts(q_WSP, wspTimers, QueueType::WSP);
+}
+
+void LoraMesher::managerTimeouts(LM_LinkedList<listConfiguration>* queue, LM_TimerWheel* timers, QueueType type) {
+    ESP_LOGV(LM_TAG, "Checking %s timeouts. Open connections %d", type == QueueType::WRP ? "Waiting Received Queue" : "Waiting Send Queue", queue->getLength());
+
+    queue->setInUse();
+
+    timers->expire(millis(), [this, queue, type](LM_Timer* timer) {
+        processSequenceTimeout(queue, static_cast<listConfiguration*>(timer->context), type);
+    });
+
+    queue->releaseInUse();
 }
 
-void LoraMesher::managerTimeouts(LM_LinkedList<listConfiguration>* queue, QueueType type) {
+void LoraMesher::processSequenceTimeout(LM_LinkedList<listConfiguration>* queue, listConfiguration* current, QueueType type) {
     String queueName;
     if (type == QueueType::WRP) {
         queueName = F("Waiting Received Queue");
@@ -1474,58 +6190,47 @@ void LoraMesher::managerTimeouts(LM_LinkedList<listConfiguration>* queue, QueueT
         queueName = F("Waiting Send Queue");
     }
 
-    ESP_LOGV(LM_TAG, "Checking %s timeouts. Open connections %d", queueName.c_str(), queue->getLength());
+    // The sequence is added to the queue after its first timeout is set
+    if (!queue->Search(current)) {
+        ESP_LOGW(LM_TAG, "%s timeout of a sequence not inside the queue", queueName.c_str());
+        return;
+    }
 
-    queue->setInUse();
+    // Get Config packet
+    sequencePacketConfig* configPacket = current->config;
 
-    if (queue->moveToStart()) {
-        do {
-            listConfiguration* current = queue->getCurrent();
-
-            // Get Config packet
-            sequencePacketConfig* configPacket = current->config;
-
-            // If Config packet has reached timeout
-            if (configPacket->timeout < millis()) {
-                // Increment number of timeouts
-                configPacket->numberOfTimeouts++;
-
-                // Description of the timeout:
-                // The number of the packet would be the following: 
-                // If it is a sender it starts from 0 to n + 1 packets, that includes the sync packet: If num = 0, it is that the sync packet has been lost, if num > 0, it is that the packet num - 1 has been lost
-                // For the the receiver it starts from 0 to n packets
-                ESP_LOGW(LM_TAG, "%s timeout reached, Src: %X, Seq_Id: %d, Num: %d, N.TimeOuts %d",
-                    queueName.c_str(), configPacket->source, configPacket->seq_id, configPacket->lastAck + configPacket->firstAckReceived, configPacket->numberOfTimeouts);
-
-                // If number of timeouts is greater than Max timeouts, erase it
-                if (configPacket->numberOfTimeouts >= MAX_TIMEOUTS) {
-                    ESP_LOGE(LM_TAG, "%s, MAX TIMEOUTS reached, erasing Id: %d", queueName.c_str(), configPacket->seq_id);
-                    clearLinkedList(current);
-                    queue->DeleteCurrent();
-                    continue;
-                }
+    // Increment number of timeouts
+    configPacket->numberOfTimeouts++;
 
-                // Recalculate the timeout
-                recalculateTimeoutAfterTimeout(configPacket);
+    // Description of the timeout:
+    // The number of the packet would be the following: 
+    // If it is a sender it starts from 0 to n + 1 packets, that includes the sync packet: If num = 0, it is that the sync packet has been lost, if num > 0, it is that the packet num - 1 has been lost
+    // For the the receiver it starts from 0 to n packets
+    ESP_LOGW(LM_TAG, "%s timeout reached, Src: %X, Seq_Id: %d, Num: %d, N.TimeOuts %d",
+        queueName.c_str(), configPacket->source, configPacket->seq_id, configPacket->lastAck + configPacket->firstAckReceived, configPacket->numberOfTimeouts);
 
-                if (type == QueueType::WRP) {
-                    // Send Last ACK + 1 (Request this packet)
-                    sendLostPacket(configPacket->source, configPacket->seq_id, configPacket->lastAck + 1);
-                }
-                else {
-                    // Repeat the configPacket ACK
-                    if (configPacket->firstAckReceived == 0)
-                        // Send the first packet of the sequence (SYNC packet)
-                        sendPacketSequence(current, 0);
-                }
-            }
+    // If number of timeouts is greater than Max timeouts, erase it
+    if (configPacket->numberOfTimeouts >= MAX_TIMEOUTS) {
+        ESP_LOGE(LM_TAG, "%s, MAX TIMEOUTS reached, erasing Id: %d", queueName.c_str(), configPacket->seq_id);
+        deleteCurrentSequence(queue);
+        return;
+    }
 
-            vTaskDelay(1);
+    // Recalculate the timeout
+    recalculateTimeoutAfterTimeout(configPacket);
 
-        } while (queue->next());
+    if (type == QueueType::WRP) {
+        // Send Last ACK + 1 (Request this packet)
+        sendLostPacket(configPacket->source, configPacket->seq_id, configPacket->lastAck + 1);
     }
+    else {
+        shrinkStreamWindow(current, true);
 
-    queue->releaseInUse();
+        // Repeat the configPacket ACK
+        if (configPacket->firstAckReceived == 0)
+            // Send the first packet of the sequence (SYNC packet)
+            sendPacketSequence(current, 0);
+    }
 }
 
 unsigned long LoraMesher::getMaximumTimeout(sequencePacketConfig* configPacket) {
@@ -1603,6 +6308,7 @@ void LoraMesher::addTimeout(sequencePacketConfig* configPacket) {
 
     configPacket->timeout = millis() + timeout;
     configPacket->previousTimeout = timeout;
+    configPacket->timers->arm(&configPacket->timer, configPacket->timeout);
 
     ESP_LOGV(LM_TAG, "Timeout set to %u s for addr %X", (unsigned int)(timeout / 1000), configPacket->source);
 }
@@ -1648,21 +6354,58 @@ void LoraMesher::recalculateTimeoutAfterTimeout(sequencePacketConfig* configPack
 
     configPacket->timeout = millis() + timeout;
     configPacket->previousTimeout = timeout;
+    configPacket->timers->arm(&configPacket->timer, configPacket->timeout);
 
     ESP_LOGV(LM_TAG, "Timeout recalculated to %u s (after %d timeouts) for addr %X",
         (unsigned int)(timeout / 1000), configPacket->numberOfTimeouts, configPacket->source);
 }
 
-uint8_t LoraMesher::getSequenceId() {
-    if (sequence_id == 255) {
-        sequence_id = 0;
-        return 255;
+bool LoraMesher::getSequenceId(uint16_t dst, uint16_t& seqId) {
+    q_WSP->setInUse();
+
+    if (loraMesherConfig->maxSequencesPerDestination != 0) {
+        uint16_t inFlight = 0;
+        if (q_WSP->moveToStart()) {
+            do {
+                if (q_WSP->getCurrent()->config->source == dst)
+                    inFlight++;
+            } while (q_WSP->next());
+        }
+
+        if (inFlight >= loraMesherConfig->maxSequencesPerDestination) {
+            q_WSP->releaseInUse();
+            return false;
+        }
+    }
+
+    //The counter of the destination, or the least recently used one
+    SequenceCounter* counter = &sequenceCounters[0];
+    for (SequenceCounter& candidate : sequenceCounters) {
+        if (candidate.address == dst) {
+            counter = &candidate;
+            break;
+        }
+
+        if (counter->address != 0 && (candidate.address == 0 || (int32_t) (candidate.usedAt - counter->usedAt) < 0))
+            counter = &candidate;
+    }
+
+    //A new counter does not start where the destination may still remember an old sequence
+    if (counter->address != dst) {
+        counter->address = dst;
+        counter->next = random(0, UINT16_MAX + 1);
     }
 
-    uint8_t seqId = sequence_id;
-    sequence_id++;
+    counter->usedAt = millis();
+
+    bool found = false;
+    for (uint32_t i = 0; i <= UINT16_MAX && !found; i++) {
+        seqId = counter->next++;
+        found = wspIndex->find(getSequenceKey(dst, seqId)) == nullptr;
+    }
 
-    return seqId;
+    q_WSP->releaseInUse();
+    return found;
 }
 
 /**
@@ -1671,24 +6414,21 @@ uint8_t LoraMesher::getSequenceId() {
 
 
 bool LoraMesher::isDuplicatePacket(Packet<uint8_t>* p) {
-    ToSendPackets->setInUse();
-
-    if (ToSendPackets->moveToStart()) {
-        do {
-            Packet<uint8_t>* current = ToSendPackets->getCurrent()->packet;
+    if (p->src == getLocalAddress())
+        return false;
 
-            if (current->src == p->src && current->dst == p->dst && current->type == p->type &&
-                memcmp(current->payload, p->payload, p->packetSize - sizeof(Packet<uint8_t>)) == 0) {
-                ToSendPackets->releaseInUse();
-                return true;
-            }
+    // The records of the trace change with every retransmission
+    size_t payloadLength = p->packetSize > sizeof(Packet<uint8_t>) ? p->packetSize - sizeof(Packet<uint8_t>) - HopTraceService::getTraceLength(p) : 0;
+    uint32_t payloadHash = LM_DuplicateCache<LM_DUPLICATE_CACHE_BITS>::hashPayload(p->payload, payloadLength);
 
-        } while (ToSendPackets->next());
-    }
+    return duplicateCache->checkAndAdd(p->src, p->id, p->type, payloadHash);
+}
 
-    ToSendPackets->releaseInUse();
+uint8_t LoraMesher::getDuplicateCopies(Packet<uint8_t>* p) {
+    size_t payloadLength = p->packetSize > sizeof(Packet<uint8_t>) ? p->packetSize - sizeof(Packet<uint8_t>) - HopTraceService::getTraceLength(p) : 0;
+    uint32_t payloadHash = LM_DuplicateCache<LM_DUPLICATE_CACHE_BITS>::hashPayload(p->payload, payloadLength);
 
-    return false;
+    return duplicateCache->getCopies(p->src, p->id, p->type, payloadHash);
 }
 
 void LoraMesher::removeNodeFromQSPandQWP(uint16_t address) {
@@ -1698,8 +6438,7 @@ void LoraMesher::removeNodeFromQSPandQWP(uint16_t address) {
             listConfiguration* current = q_WRP->getCurrent();
             if (current != nullptr && current->config->source == address) {
                 ESP_LOGI(LM_TAG, "Clearing node info from address %X", address);
-                clearLinkedList(current);
-                q_WRP->DeleteCurrent();
+                deleteCurrentSequence(q_WRP);
                 continue;
             }
         } while (q_WRP->next());
@@ -1713,8 +6452,7 @@ void LoraMesher::removeNodeFromQSPandQWP(uint16_t address) {
             listConfiguration* current = q_WSP->getCurrent();
             if (current != nullptr && current->config->source == address) {
                 ESP_LOGI(LM_TAG, "Clearing node info from address %X", address);
-                clearLinkedList(current);
-                q_WSP->DeleteCurrent();
+                deleteCurrentSequence(q_WSP);
                 continue;
             }
         } while (q_WSP->next());
@@ -11,18 +11,92 @@
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/IntrusiveList.hpp"
+
+#include "utilities/PriorityQueue.hpp"
+
+#include "utilities/DuplicateCache.hpp"
+
+#include "utilities/PacketRing.hpp"
+
+#include "utilities/AddressIndex.hpp"
+
+#include "utilities/TimerWheel.hpp"
+
+#include "utilities/AirtimeBudget.hpp"
+#include "utilities/ChannelBusy.hpp"
+
+#include "utilities/Trickle.hpp"
+
+#include "utilities/Rendezvous.hpp"
+
 #include "services/PacketService.h"
 
+#include "services/CompactHeaderService.h"
+
 #include "services/RoutingTableService.h"
 
+#include "services/NeighborTableService.h"
+
 #include "services/PacketQueueService.h"
 
+#include "services/PacketPoolService.h"
+
+#include "services/AirtimeService.h"
+
 #include "services/WiFiService.h"
 
 #include "services/RoleService.h"
 
 #include "services/SimulatorService.h"
 
+#include "services/CaptureService.h"
+
+#include "services/CompressionService.h"
+
+#include "services/CryptoService.h"
+#include "services/SpoolService.h"
+#include "services/TimeSyncService.h"
+#include "services/TdmaService.h"
+#include "services/CongestionService.h"
+#include "services/TelemetryService.h"
+#include "services/OtaService.h"
+#include "services/TraceService.h"
+#include "services/Hooks.h"
+#include "services/MemoryService.h"
+#include "services/CheckpointService.h"
+#include "services/RouteDiscoveryService.h"
+#include "services/HopTraceService.h"
+#include "services/LinkFilterService.h"
+#include "services/SniffService.h"
+#include "services/BackboneService.h"
+#include "services/TransferService.h"
+#include "services/MetricsHistoryService.h"
+
+#include "entities/stats/LM_Stats.h"
+
+/**
+ * @brief Handler of a frame type of the application, see LoraMesher::registerPacketType. It runs in the task that processes
+ * the received packets, it should return quickly
+ *
+ */
+typedef void (*LM_PacketHandler)(uint16_t src, const uint8_t* payload, size_t payloadSize, int8_t rssi, int8_t snr, void* context);
+
+/**
+ * @brief Inline receiver of the application packets, see LoraMesher::setReceiveCallback. The payload is valid only during
+ * the call, the whole payload is given, metadata.copiedSize is metadata.payloadSize
+ *
+ */
+typedef void (*LM_ReceiveCallback)(const uint8_t* payload, const LM_ReceiveMetadata& metadata, void* context);
+
+/**
+ * @brief Source of the payload of LoraMesher::sendReliableStream. It copies length bytes from the offset into the buffer,
+ * the same bytes every time, since the packets are read again when they are retransmitted. It runs in the tasks of
+ * LoraMesher, it should return quickly
+ *
+ */
+typedef bool (*LM_ReadChunk)(uint32_t offset, uint8_t* buffer, size_t length, void* context);
+
 /**
  * @brief LoRaMesher Library
  *
@@ -49,6 +123,60 @@ public:
         RFM95_MOD,
     };
 
+    /**
+     * @brief Core, priority and stack size of a LoRaMesher task
+     *
+     */
+    struct TaskConfig {
+        BaseType_t core; // Core the task is pinned to, tskNO_AFFINITY to let the scheduler choose
+        UBaseType_t priority;
+        uint32_t stackSize; // Stack size in bytes
+    };
+
+    /**
+     * @brief Cores, priorities and stack sizes of the LoRaMesher tasks. The secondary receiving routine uses receive
+     *
+     */
+    struct TaskTopology {
+        TaskConfig receive = {tskNO_AFFINITY, 6, LM_TASK_STACK_SIZE};
+        TaskConfig send = {tskNO_AFFINITY, 5, LM_TASK_STACK_SIZE};
+        TaskConfig hello = {tskNO_AFFINITY, 4, LM_TASK_STACK_SIZE};
+        TaskConfig process = {tskNO_AFFINITY, 3, LM_TASK_STACK_SIZE};
+        TaskConfig routingTableManager = {tskNO_AFFINITY, 2, LM_TASK_STACK_SIZE};
+        TaskConfig queueManager = {tskNO_AFFINITY, 2, LM_TASK_STACK_SIZE};
+        // The only task with singleTask, it runs the routines of all the others
+        TaskConfig reactor = {tskNO_AFFINITY, 6, LM_REACTOR_STACK_SIZE};
+        // Every one of the processWorkers. Not pinned, the worker n is pinned to the core n % portNUM_PROCESSORS
+        TaskConfig processWorker = {tskNO_AFFINITY, 3, LM_TASK_STACK_SIZE};
+
+        /**
+         * @brief Preset with no task pinned, the default
+         *
+         */
+        static TaskTopology unpinned() {
+            return TaskTopology();
+        }
+
+        /**
+         * @brief Preset with the radio tasks (receive and send) pinned to radioCore and the others to the other core.
+         * In the ESP32 the Arduino loop and the WiFi run in core 1 and core 0, choose the core the application leaves free
+         *
+         * @param radioCore Core of the radio tasks, 0 or 1
+         */
+        static TaskTopology radioOnCore(BaseType_t radioCore = 1) {
+            TaskTopology topology;
+            BaseType_t otherCore = radioCore == 0 ? 1 : 0;
+            topology.receive.core = radioCore;
+            topology.send.core = radioCore;
+            topology.reactor.core = radioCore;
+            topology.hello.core = otherCore;
+            topology.process.core = otherCore;
+            topology.routingTableManager.core = otherCore;
+            topology.queueManager.core = otherCore;
+            return topology;
+        }
+    };
+
     /**
      * @brief LoRaMesher configuration
      *
@@ -77,6 +205,214 @@ public:
         // MAX payload size for reliable and large packets = LM_MAX_PACKET_SIZE - 7 bytes of header - 2 bytes of via - 3 of control packet.
         // Having different max_packet_size in the same network will cause problems.
         size_t max_packet_size = LM_MAX_PACKET_SIZE;
+        // Number of blocks of every size class of the packet pool, allocated once at begin(). 0 disables the pool and uses the heap.
+        size_t packetPoolBlocks = LM_PACKET_POOL_BLOCKS;
+        // Allocate the bulk buffers in the PSRAM, if the board has it: the large payload reassembly buffers, the packets of the
+        // reliable payloads waiting for their ACK and the simulator states. The packets of the radio path stay in the internal RAM.
+        bool bulkBuffersInPsram = LM_BULK_BUFFERS_IN_PSRAM;
+        // Deliver single frame data packets as AppPacketView, the received buffer itself, instead of copying them into an AppPacket.
+        // They are taken with getNextAppPacketView. Large payloads are still delivered with getNextAppPacket.
+        bool zeroCopyReceive = false;
+        // Compress the application payloads, see CompressionService. Every payload carries a codec byte, so all the nodes of the
+        // network must use the same value. The single frame data packets are delivered as AppPacket, without zeroCopyReceive.
+        bool compressPayloads = false;
+        // Every application payload carries a port byte first, see LM_SendOptions::port and bindPort. All the nodes of the
+        // network must use the same value. The port is removed before the payload is delivered
+        bool applicationPorts = false;
+        // Key of CryptoService::KEY_LENGTH bytes to encrypt and authenticate the application payloads end to end with AES-CCM,
+        // nullptr to send them in clear. All the nodes of the network must use the same key, it cannot be changed after begin.
+        // The payloads with a wrong tag are dropped. The zero copy views are decrypted in place.
+        const uint8_t* payloadKey = nullptr;
+        // Packets of a reliable sequence sent without waiting for their ACK. 1 is stop and wait.
+        // The selective ACKs are always sent by the receiver, every node can use a different window.
+        uint8_t reliableWindowSize = LM_RELIABLE_WINDOW_SIZE;
+        // Reliable sequences sent to one destination at the same time, the next one is refused with ENQUEUE_QUEUE_FULL.
+        // 0 limits them only by the 65536 sequence ids of every destination and the Q_WSP index, see LM_SEQUENCE_INDEX_BITS
+        uint8_t maxSequencesPerDestination = 0;
+        // Advertise only the routes changed since the previous HELLO, with a full HELLO every LM_FULL_HELLO_INTERVAL s.
+        // The nodes without it enabled understand the delta HELLOs.
+        bool deltaHello = false;
+        // Encode the HELLO routes with the compact encoding, about 2 or 3 bytes per route instead of 5.
+        // The nodes without it enabled understand the compact HELLOs.
+        bool compactHello = false;
+        // Send the data packets queued to the same next hop in one aggregate frame, up to the max packet size.
+        // The nodes without it enabled understand the aggregate frames.
+        bool aggregateDataPackets = false;
+        // Ms the ACK and LOST packets of the large payloads wait for a data packet of this node or forwarded by it to the same
+        // next hop, they are sent with it in an aggregate frame instead of a frame of their own. A newer ACK of the sequence
+        // replaces the waiting one. Keep it well below the timeout of the sender. 0 sends them at once, not used with hopAck.
+        // The nodes without it enabled understand the aggregate frames
+        uint16_t delayedAck = 0;
+        // Maximum number of packets waiting to be sent, 0 for no limit. When the radio is duty cycle limited the queue stops growing.
+        size_t sendQueueCapacity = LM_SEND_QUEUE_CAPACITY;
+        // Packet dropped when the send queue is full. With DROP_POLICY_PRIORITY the routing and ACK packets displace the data packets.
+        LM_DropPolicy sendQueueDropPolicy = DROP_POLICY_PRIORITY;
+        // Maximum number of received packets waiting for the application, 0 for no limit. DROP_POLICY_PRIORITY drops the oldest one.
+        size_t receivedQueueCapacity = LM_RECEIVED_QUEUE_CAPACITY;
+        // Packet dropped when the received application queue is full
+        LM_DropPolicy receivedQueueDropPolicy = DROP_POLICY_TAIL;
+        // Before sending, wait a random backoff and scan the channel with CAD, doubling the backoff window while it is busy.
+        // Disabled, the random delay only checks if a packet has been received meanwhile.
+        bool cadListenBeforeTalk = false;
+        // Maximum number of backoffs and scans with cadListenBeforeTalk, the packet is sent after them even if the channel is busy
+        uint8_t cadMaxAttempts = LM_CAD_MAX_ATTEMPTS;
+        // Send the unicast packets to a neighbour with the lowest power that keeps LM_ADR_MARGIN dB over the demodulation floor
+        // of the spreading factor. The SNR is the one the neighbour reports for the route packets of the node in its HELLOs, a
+        // LinkSnrTrailer, or the SNR history of its route packets until it reports one. The route packets and broadcasts use the
+        // configured power. All the nodes must be configured with the same power.
+        bool adaptiveLinkPower = false;
+        // Frequencies in MHz of the channel plan, the first channelPlanSize are used. With more than one channel every node
+        // listens on its home channel, derived from its address, and the unicast packets are sent on the home channel of the next hop.
+        // The broadcasts, HELLO packets included, are sent once on every channel. All the nodes must use the same channel plan
+        float channelPlan[LM_MAX_CHANNELS] = {};
+        uint8_t channelPlanSize = 0;
+        // Second radio module that only receives, so the node is not deaf while the first one sends. It shares the SPI bus
+        // and the routing state, the packets of both radios are processed by the same task. It is set at begin.
+        bool secondaryReceiver = false;
+        LoraModules secondaryModule = LoraModules::SX1262_MOD;
+        uint8_t secondaryLoraCs = 0; // Secondary LoRa chip select pin
+        uint8_t secondaryLoraIrq = 0; // Secondary LoRa IRQ pin
+        uint8_t secondaryLoraRst = 0; // Secondary LoRa reset pin
+        uint8_t secondaryLoraIo1 = 0; // Secondary LoRa DIO1 pin
+        // Frequency and spreading factor of the secondary receiver, 0 to use the ones of the first radio.
+        // With the same frequency and spreading factor both radios receive the same packets, use another channel or spreading factor
+        float secondaryFreq = 0;
+        uint8_t secondarySf = 0;
+        // Modem of the secondary radio. LM_PACKET_FLRC or LM_PACKET_GFSK make an SX1280 on secondaryFreq, in the 2.4 GHz band,
+        // a backbone between the fixed relays at backboneBitRate kbps: it sends a copy of every HELLO and the unicast packets
+        // to the neighbours whose HELLOs it has heard, without backoff nor duty cycle, see BackboneService. The other packets,
+        // and the sensors without backbone, stay on the first radio. A frame that fails on the backbone is sent on LoRa
+        LM_PacketType secondaryPacketType = LM_PACKET_LORA;
+        uint16_t backboneBitRate = LM_BACKBONE_BIT_RATE;
+        // Sniffer: the radios only receive, continuously, and the node neither sends nor routes. Only the receiving routines
+        // run, every frame goes to the capture, see startCapture with CAPTURE_FORMAT_PCAP, and is dropped. The sends of the
+        // application are refused
+        bool sniffer = false;
+        // Airtime budget of the regulatory duty cycle, in per mille of every airtimeWindow ms. 0 disables it and
+        // LM_DUTY_CYCLE is used. The packets are sent back to back while there is budget, airtimeBurst ms at most,
+        // and controlAirtimeShare % of the burst is reserved for the routing and control classes, the HELLO, ACK, lost and
+        // hop ACK packets, and alarmAirtimeShare % more for the alarms, see LM_TrafficClass. The bulk data cannot take them
+        uint16_t airtimeLimit = LM_AIRTIME_LIMIT;
+        uint32_t airtimeWindow = LM_AIRTIME_WINDOW;
+        uint32_t airtimeBurst = LM_AIRTIME_BURST;
+        uint8_t controlAirtimeShare = LM_AIRTIME_CONTROL_SHARE;
+        uint8_t alarmAirtimeShare = LM_AIRTIME_ALARM_SHARE;
+        // Schedule the HELLO packets with a Trickle timer instead of every HELLO_PACKETS_DELAY s. The interval doubles
+        // from trickleIntervalMin to trickleIntervalMax s while the routing table is stable, a HELLO is suppressed when
+        // trickleRedundancy HELLOs that did not change the table have been heard, and a change starts again from the minimum
+        bool trickleHello = false;
+        uint32_t trickleIntervalMin = LM_TRICKLE_IMIN;
+        uint32_t trickleIntervalMax = LM_TRICKLE_IMAX;
+        uint8_t trickleRedundancy = LM_TRICKLE_K;
+        // Slotted HELLOs. The start of the HELLO period, or the second half of the Trickle interval, is divided into helloSlots
+        // slots and the node sends its HELLOs in the slot given by a hash of its address, plus a small random jitter, so the
+        // nodes that boot together do not send their HELLOs at the same time. When the advertisements of the neighbors are being lost
+        // the node moves to another slot, see LM_HELLO_RESLOT_MISSES. 0 sends them at a random time
+        uint8_t helloSlots = 0;
+        // Hysteresis in % of the cost routing, LM_ROUTING_METRIC other than LM_METRIC_HOP_COUNT. A route must be routeHysteresis %
+        // cheaper than the current route to replace it, longerRouteHysteresis % when it has more hops
+        uint8_t routeHysteresis = LM_ROUTE_HYSTERESIS;
+        uint8_t longerRouteHysteresis = LM_LONGER_ROUTE_HYSTERESIS;
+        // Rebroadcast of the flooded packets, see sendFlood. A rebroadcast is suppressed when floodRedundancy copies of the
+        // packet have been overheard since it was received, including the random backoff before sending it. 0 always rebroadcasts
+        uint8_t floodRedundancy = LM_FLOOD_K;
+        // Per hop reliability of the unicast data packets. The sender keeps every data packet sent until it overhears its next
+        // hop forwarding it, or the header only hop ACK that the destination, and a next hop with other packets queued, send back.
+        // It resends it up to hopAckRetries times, doubling the wait every time. The data packets are not aggregated. It needs a single channel to overhear the next hop.
+        // All the nodes of the network must use the same value
+        bool hopAck = false;
+        uint8_t hopAckRetries = LM_HOP_ACK_RETRIES;
+        // Withdraw the routes of a lost neighbor at once instead of waiting for every route to time out. A neighbor is lost when
+        // it has not been heard for LM_NEIGHBOR_TIMEOUT s or, with hopAck, when a packet is not acknowledged after all the
+        // retransmissions. Its routes are advertised as unreachable in a triggered delta HELLO, and the neighbors that remove a
+        // route because of it do the same. The nodes without it enabled understand the triggered HELLOs
+        bool triggeredWithdrawal = false;
+        // Solicit the neighbors in the first HELLO and, while the routing table is empty, in a HELLO every LM_SOLICIT_INTERVAL s
+        // doubled up to HELLO_PACKETS_DELAY. The neighbors answer with a full HELLO after a random delay, without resetting
+        // their Trickle interval, so a new node has its routes in seconds instead of after the next HELLOs of the neighbors.
+        // The nodes without it enabled answer the solicitations too
+        bool neighborSolicitation = false;
+        // Hybrid reactive routing: the HELLOs advertise the neighbors and the nodes with a role only, so their size does not
+        // grow with the network. A packet to another destination is held while its route is discovered with a flooded request
+        // answered by the destination, see RouteDiscoveryService, and the route is kept LM_DISCOVERY_ROUTE_TIMEOUT s without
+        // traffic. All the nodes of the network must use the same value, the nodes without it relay and answer the requests
+        bool reactiveRoutes = false;
+        // Per mille of the unicast data packets of the node that carry the per hop trace, 0 disables it. Every node that sends a
+        // traced packet appends its queue wait, duty cycle wait, backoff and time on air, 10 bytes per hop, and the destination
+        // keeps the breakdown of the newest LM_HOP_TRACES packets, see getHopTraces and HopTraceService
+        uint16_t hopTraceSampling = 0;
+        // Preamble length in symbols of the frames to this node, 0 listens continuously. Above it, the radio receives in the
+        // hardware duty cycle of the SX126x, sleeping between short listens for a preamble, for battery relays. The HELLOs
+        // advertise it, the neighbours send the unicasts to the node and the broadcasts with this preamble, see SniffService.
+        // The other modules fall back to listening continuously
+        uint16_t sniffPreambleLength = 0;
+        // Keep up to LM_ROUTE_ALTERNATES alternate next hops per route, the other neighbors that advertise the destination
+        // with a metric not higher than the one of the route, so they are loop free. When the next hop fails, its route
+        // times out or it withdraws the route, or with hopAck a packet is not acknowledged, the route moves to the best
+        // alternate at once and the packet goes on through it. With a cost routing metric a worse link moves it too
+        bool multipath = false;
+        // Address of the node, 0 takes it from the last two bytes of the MAC
+        uint16_t localAddress = 0;
+        // Hierarchical routing. The first clusterPrefixLength bits of an address, up to 8, are its cluster, and the address
+        // of the cluster has the other bits 0, it is not given to any node. A node keeps the routes to the nodes of its
+        // cluster, to its neighbors and to the nodes with a role, and one route to every other cluster, so the routing
+        // table and the HELLOs grow with the clusters instead of with the nodes. The addresses must be given by location,
+        // see localAddress, and every cluster connected inside. All the nodes of the network must use the same value
+        uint8_t clusterPrefixLength = 0;
+        // Label of a data partition for the store and forward spool, nullptr without it. The data packets without a route to
+        // their destination, a gateway in maintenance for example, are stored in the flash instead of dropped, oldest first,
+        // and moved back to the send queue when the route appears, LM_SPOOL_DRAIN_BURST every LM_SPOOL_DRAIN_INTERVAL ms.
+        // They are kept after a reboot. When the partition is full the oldest segment is dropped, see SpoolService.
+        // A packet is only stored once its route is gone, timed out after DEFAULT_TIMEOUT s or withdrawn, so an outage
+        // shorter than the route timeout is not covered: the packets sent meanwhile are lost, or dropped after the
+        // retransmissions with hopAck
+        const char* spoolPartition = nullptr;
+        // Synchronize the clock of the node with the clock of the gateway with the lowest address, see TimeSyncService.
+        // The HELLOs of the synchronized nodes carry the time of the network, corrected by the time on air of every hop,
+        // and the drift of the local clock is estimated from the last LM_TIME_SYNC_WINDOW synchronizations.
+        // The nodes without it enabled understand the HELLOs with the time, see getSyncedTime
+        bool timeSync = false;
+        // TDMA mode with timeSync, frames of tdmaSlots slots, up to LM_TDMA_MAX_SLOTS. 0 sends with the random backoff.
+        // Every node takes the slots of its demand that are free within two hops and announces them in its HELLOs,
+        // it sends without backoff in them. Slot 0 is the contention slot of the nodes without slots, see TdmaService
+        uint8_t tdmaSlots = 0;
+        // Advertise the congestion of the node in its HELLOs, the fill of the send queue, of sendQueueCapacity or of
+        // LM_CONGESTION_QUEUE_LENGTH packets, and the airtime budget left. The cost routing metrics avoid the congested next
+        // hops, and the sources can send less while their path is congested, see getPathCongestion and CongestionService
+        bool backpressure = false;
+        // Seconds between two telemetry records of the node in its HELLOs, 0 disables it. A record has the counters, the free
+        // heap, the queues, the duty cycle used and the uptime, and goes up to the gateways in the HELLOs of the nodes on the way.
+        // The gateways keep the newest record of LM_TELEMETRY_NODES nodes, see getTelemetry and TelemetryService
+        uint16_t telemetryInterval = 0;
+        // Label of the app partition of the firmware updates over the mesh, nullptr without them: the next update partition
+        // of the node, or the running one in the node that offers its own image with startOta. The nodes receive the images
+        // newer than otaVersion, keep their chunks in the partition and serve them to the neighbors that miss them.
+        // The application boots the image when getOtaState is OTA_VERIFIED, see OtaService. The messages go on LM_PORT_OTA,
+        // the updates need applicationPorts
+        const char* otaPartition = nullptr;
+        // Version of the running firmware, see otaPartition
+        uint16_t otaVersion = 0;
+        // Seconds between two samples of the metrics history of the node, 0 disables it. A sample has the counters, the free
+        // heap, the queues, the routes, the channel busy and LM_METRICS_APP_VALUES values of the application, delta coded in
+        // two rings of fixed size allocated by begin, a fine one and a coarse one. The history is read with getMetrics and
+        // requested from other nodes with requestMetrics on LM_PORT_METRICS with applicationPorts, see MetricsHistoryService
+        uint16_t metricsInterval = 0;
+        // Label of a data partition for the checkpoints of the warm restart, nullptr without them. The routing table, the
+        // link metrics of the neighbors and the Trickle interval of the HELLOs are written LM_CHECKPOINT_MIN_INTERVAL s after
+        // a change of the routing table and every LM_CHECKPOINT_INTERVAL s. After a reboot the routes are restored as
+        // provisional routes, so the node forwards data before it hears the first HELLOs, see CheckpointService
+        const char* checkpointPartition = nullptr;
+        // Cores, priorities and stack sizes of the tasks, see TaskTopology::radioOnCore
+        TaskTopology taskTopology;
+        // Run all the routines as non blocking steps of one task, taskTopology.reactor, instead of one task each.
+        // It saves the stacks of the other tasks in the nodes short of RAM
+        bool singleTask = false;
+        // Tasks that process the data packets received, up to LM_MAX_PROCESS_WORKERS. The packets are sharded by source, so
+        // the packets of one source keep their order. The HELLOs and the route discoveries stay in the Process routine, the
+        // only writer of the routes. 0 processes every packet in the Process routine. Ignored with singleTask
+        uint8_t processWorkers = 0;
+        // Radio used instead of creating the configured module, for example a LM_ReplayModule. LoRaMesher deletes it
+        LM_Module* radioModule = nullptr;
 #ifdef ARDUINO
         // Custom SPI pins
         SPIClass* spi = nullptr;
@@ -196,28 +532,32 @@ public:
      *
      * @param freq Frequency to be set in MHz
      */
-    void setFrequency(float freq) { radio->setFrequency(freq); recalculateMaxTimeOnAir(); }
+    void setFrequency(float freq) {
+        radio->setFrequency(freq);
+        loraMesherConfig->freq = freq;
+        homeFrequency = listenFrequency = currentFrequency = freq;
+    }
 
     /**
      * @brief Sets LoRa bandwidth. Allowed values are 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250 and 500 kHz.
      *
      * @param bw LoRa bandwidth to be set in kHz.
      */
-    void setBandwidth(float bw) { radio->setBandwidth(bw); recalculateMaxTimeOnAir(); }
+    void setBandwidth(float bw) { radio->setBandwidth(bw); loraMesherConfig->bw = bw; recalculateMaxTimeOnAir(); }
 
     /**
      * @brief Sets LoRa spreading factor. Allowed values range from 6 to 12.
      *
      * @param sf LoRa spreading factor to be set.
      */
-    void setSpreadingFactor(uint8_t sf) { radio->setSpreadingFactor(sf); recalculateMaxTimeOnAir(); }
+    void setSpreadingFactor(uint8_t sf) { radio->setSpreadingFactor(sf); loraMesherConfig->sf = sf; recalculateMaxTimeOnAir(); }
 
     /**
      * @brief Sets LoRa coding rate denominator. Allowed values range from 5 to 8.
      *
      * @param cr LoRa coding rate denominator to be set.
      */
-    void setCodingRate(uint8_t cr) { radio->setCodingRate(cr); recalculateMaxTimeOnAir(); }
+    void setCodingRate(uint8_t cr) { radio->setCodingRate(cr); loraMesherConfig->cr = cr; recalculateMaxTimeOnAir(); }
 
     /**
      * @brief Sets transmission output power. Allowed values range from -3 to 15 dBm (RFO pin) or +2 to +17 dBm (PA_BOOST pin).
@@ -226,7 +566,11 @@ public:
      * @param power Transmission output power in dBm.
      * @param useRfo Whether to use the RFO (true) or the PA_BOOST (false) pin for the RF output. Defaults to PA_BOOST.
      */
-    void setOutputPower(int8_t power, bool useRfo = false) { radio->setOutputPower(power, useRfo); }
+    void setOutputPower(int8_t power, bool useRfo = false) {
+        radio->setOutputPower(power, useRfo);
+        loraMesherConfig->power = power;
+        currentTxPower = power;
+    }
 
     /**
      * @brief Set the Receive App Data Task Handle, every time a received packet for this node is detected, this task will be notified.
@@ -235,11 +579,119 @@ public:
      */
     void setReceiveAppDataTaskHandle(TaskHandle_t ReceiveAppDataTaskHandle) { ReceiveAppData_TaskHandle = ReceiveAppDataTaskHandle; }
 
+    /**
+     * @brief Set a callback that gets the packets for the application inline, instead of the received packets queue and the
+     * task of setReceiveAppDataTaskHandle. It runs in the task that processes the received packets, the reactor in
+     * singleTask, so while it runs no frame is processed, routed nor sent by the node: it must return in a few ms, must not
+     * block nor wait for the LoraMesher and must not send from it. The slow consumers keep the queue and the task.
+     * With LoraMesherConfig::processWorkers it runs in the workers, at the same time for packets of different sources
+     *
+     * @param callback Callback, nullptr to go back to the queue
+     * @param context Passed to the callback
+     */
+    void setReceiveCallback(LM_ReceiveCallback callback, void* context = nullptr) {
+        receiveCallbackContext = context;
+        receiveCallback = callback;
+    }
+
+    /**
+     * @brief Give the payloads of a port of the application to their own queue and task, with applicationPorts. The task
+     * is notified like the one of setReceiveAppDataTaskHandle and takes them with getNextAppPacket(port), or
+     * getNextAppPacketView(port) with zeroCopyReceive. The payloads of the ports not bound go to the received packets
+     * queue or the receive callback
+     *
+     * @param port Port
+     * @param task Task notified, it can run at its own priority
+     * @return true If it has been bound, false if LM_APP_PORTS ports are bound already
+     */
+    bool bindPort(uint8_t port, TaskHandle_t task) { return bindPort(port, task, nullptr, nullptr); }
+
+    /**
+     * @brief Give the payloads of a port of the application to a callback, with applicationPorts. It runs like the one of
+     * setReceiveCallback, only for this port
+     *
+     * @param port Port
+     * @param callback Callback
+     * @param context Passed to the callback
+     * @return true If it has been bound, false if LM_APP_PORTS ports are bound already
+     */
+    bool bindPort(uint8_t port, LM_ReceiveCallback callback, void* context = nullptr) { return bindPort(port, nullptr, callback, context); }
+
+    /**
+     * @brief Give the payloads of a port back to the received packets queue, the ones still queued for the port are deleted
+     *
+     * @param port Port
+     */
+    void unbindPort(uint8_t port);
+
+    /**
+     * @brief Get the number of packets waiting in the queue of a port bound to a task
+     *
+     * @param port Port
+     * @return size_t Packets and packet views queued, 0 if the port is not bound to a task
+     */
+    size_t getReceivedQueueSize(uint8_t port);
+
+    /**
+      * @brief Get the next application packet of a port bound to a task, see bindPort
+      *
+      * @tparam T Type to be converted
+      * @param port Port
+      * @return AppPacket<T>* nullptr if there is none
+      */
+    template<typename T>
+    AppPacket<T>* getNextAppPacket(uint8_t port) {
+        PortBinding* binding = findPortBinding(port);
+        if (binding == nullptr || binding->packets == nullptr)
+            return nullptr;
+
+        binding->packets->setInUse();
+        AppPacket<T>* appPacket = reinterpret_cast<AppPacket<T>*>(binding->packets->Pop());
+        binding->packets->releaseInUse();
+        return appPacket;
+    }
+
+    /**
+      * @brief Get the next application packet view of a port bound to a task, only used with zeroCopyReceive
+      *
+      * @tparam T Type to be converted
+      * @param port Port
+      * @return AppPacketView<T>* nullptr if there is none
+      */
+    template<typename T>
+    AppPacketView<T>* getNextAppPacketView(uint8_t port) {
+        PortBinding* binding = findPortBinding(port);
+        if (binding == nullptr || binding->views == nullptr || binding->views->getLength() == 0)
+            return nullptr;
+
+        binding->views->setInUse();
+        AppPacketView<T>* view = reinterpret_cast<AppPacketView<T>*>(binding->views->Pop());
+        binding->views->releaseInUse();
+        return view;
+    }
+
+    /**
+     * @brief Set the Send Queue Room Task Handle. When the send queue has been full, this task will be notified
+     * once it drops to half of the sendQueueCapacity, so it can send again. It is only used with a sendQueueCapacity.
+     *
+     * @param SendQueueRoomTaskHandle Task handle which will be notified when the send queue has room, nullptr to disable it
+     */
+    void setSendQueueRoomTaskHandle(TaskHandle_t SendQueueRoomTaskHandle) { SendQueueRoom_TaskHandle = SendQueueRoomTaskHandle; }
+
     /**
      * @brief A copy of the routing table list. Delete it after using the list.
      *
      */
-    LM_LinkedList<RouteNode>* routingTableListCopy() { return new LM_LinkedList<RouteNode>(*RoutingTableService::routingTableList); }
+    LM_LinkedList<RouteNode>* routingTableListCopy();
+
+    /**
+     * @brief Withdraw a failed neighbor. Its route and all the routes through it are removed and advertised as unreachable
+     * in a triggered HELLO, and the Trickle interval is reset. The neighbor is added again when it is heard
+     *
+     * @param address Address of the neighbor
+     * @return size_t Number of routes removed
+     */
+    size_t withdrawNeighbor(uint16_t address);
 
     /**
      * @brief Send a Packet
@@ -249,21 +701,45 @@ public:
      * @param dst Destination address
      * @param payload Payload to send
      * @param payloadSize Payload size to be send in Bytes
+     * @param options Deadline and replace key of the packet, a stale reading is dropped from the send queue instead of sent
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
      */
-    void sendPacket(uint16_t dst, const uint8_t* payload, uint32_t payloadSize) {
-        //Cannot send an empty packet
-        if (payloadSize == 0)
-            return;
+    LM_EnqueueResult sendPacket(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, const LM_SendOptions& options = LM_SendOptions()) {
+        if (isLibraryPort(options.port))
+            return ENQUEUE_INVALID;
 
-        ESP_LOGV(LM_TAG, "Creating a packet for send with %d bytes", payloadSize);
+        return sendDataPacket(dst, payload, payloadSize, DEFAULT_PRIORITY, options);
+    }
 
-        //Create a data packet with the payload
-        DataPacket* dPacket = PacketService::createDataPacket(dst, getLocalAddress(), DATA_P, payload, payloadSize);
+    /**
+     * @brief Send a real time alarm, like sendPacket but in the alarm traffic class. It is sent before the bulk data of
+     * this node and the bulk data cannot take its share of the airtime budget, see LoraMesherConfig::alarmAirtimeShare.
+     * The relays forward it as bulk data, the packet does not carry its class
+     *
+     * @param dst Destination address
+     * @param payload Payload to send
+     * @param payloadSize Payload size to be send in Bytes
+     * @param options Deadline and replace key of the packet, see sendPacket
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
+     */
+    LM_EnqueueResult sendAlarm(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, const LM_SendOptions& options = LM_SendOptions()) {
+        if (isLibraryPort(options.port))
+            return ENQUEUE_INVALID;
 
-        //Create the packet and set it to the send queue
-        setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), DEFAULT_PRIORITY);
+        return sendDataPacket(dst, payload, payloadSize, LM_PRIORITY_ALARM, options);
     }
 
+    /**
+     * @brief Send a burst of packets like sendPacket, without options. The send queue is held once for every
+     * LM_SEND_BATCH_MAX packets and the sender is notified once, the packets keep their order inside the same priority
+     *
+     * @param entries Packets to send
+     * @param count Number of packets
+     * @param results Output result of every packet, see isEnqueued. nullptr to ignore them
+     * @return size_t Number of packets added to the send queue
+     */
+    size_t sendBatch(const LM_SendBatchEntry* entries, size_t count, LM_EnqueueResult* results = nullptr);
+
     /**
      * @brief Create a Packet And Send it
      *
@@ -271,34 +747,153 @@ public:
      * @param dst Destination
      * @param payload Payload of type T
      * @param payloadSize Length of the payload in T
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
      */
     template <typename T>
-    void createPacketAndSend(uint16_t dst, T* payload, uint8_t payloadSize) {
+    LM_EnqueueResult createPacketAndSend(uint16_t dst, T* payload, uint8_t payloadSize) {
         //Cannot send an empty packet
         if (payloadSize == 0)
-            return;
+            return ENQUEUE_INVALID;
 
         //Get the size of the payload in bytes
         size_t payloadSizeInBytes = payloadSize * sizeof(T);
 
-        ESP_LOGV(LM_TAG, "Creating a packet for send with %d bytes", payloadSizeInBytes);
+        //The data packet is created by sendPacket
+        return sendPacket(dst, reinterpret_cast<const uint8_t*>(payload), payloadSizeInBytes);
+    }
 
-        //Create a data packet with the payload
-        DataPacket* dPacket = PacketService::createDataPacket(dst, getLocalAddress(), DATA_P, reinterpret_cast<uint8_t*>(payload), payloadSizeInBytes);
+    /**
+     * @brief Send a Packet to the best node with a role, for example the nearest gateway.
+     * The destination is the role address, so every hop sends it to the next hop of its own best node with the role,
+     * and the relays route around the overloaded or lost nodes. It will not wait for an ACK.
+     *
+     * @param role Role of the destination, not ROLE_DEFAULT
+     * @param payload Payload to send
+     * @param payloadSize Payload size to be send in Bytes
+     * @param options Deadline and replace key of the packet, see sendPacket
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
+     */
+    LM_EnqueueResult sendToRole(uint8_t role, const uint8_t* payload, uint32_t payloadSize, const LM_SendOptions& options = LM_SendOptions()) {
+        if (role == ROLE_DEFAULT)
+            return ENQUEUE_INVALID;
 
-        //Create the packet and set it to the send queue
-        setPackedForSend(reinterpret_cast<Packet<uint8_t>*>(dPacket), DEFAULT_PRIORITY);
+        return sendPacket(RoleService::getRoleAddress(role), payload, payloadSize, options);
     }
 
+    /**
+     * @brief Send a Packet to all the nodes with a role, the members of its multicast group.
+     * The membership is the role advertised in the HELLO packets, see addRole. Every hop sends one copy to every next hop
+     * with members behind it, so the airtime grows with the tree instead of the number of members. It will not wait for an ACK.
+     *
+     * @param role Role of the destinations, not ROLE_DEFAULT
+     * @param payload Payload to send
+     * @param payloadSize Payload size to be send in Bytes, up to the payload of one packet minus the byte of the hops left
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued. ENQUEUE_NO_ROUTE without members
+     */
+    LM_EnqueueResult sendMulticast(uint8_t role, const uint8_t* payload, uint32_t payloadSize);
+
+    /**
+     * @brief Flood a Packet to all the nodes of the network, without routes. Every node delivers it and rebroadcasts it once,
+     * unless it overhears LoraMesherConfig::floodRedundancy copies before its turn, so the airtime grows with the area
+     * covered instead of the density. It will not wait for an ACK.
+     *
+     * @param payload Payload to send
+     * @param payloadSize Payload size to be send in Bytes, up to the payload of one packet minus the byte of the hops left
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
+     */
+    LM_EnqueueResult sendFlood(const uint8_t* payload, uint32_t payloadSize) { return sendFlood(payload, payloadSize, 0); }
+
+    /**
+     * @brief Register a frame type of the application, its frames go to the handler instead of the received packets queue.
+     * Call it before begin, or while the radio is in standby
+     *
+     * @param type Type code, see LM_CUSTOM_PACKET_TYPES
+     * @param handler Handler of the received frames, nullptr removes the type
+     * @param context Passed to the handler
+     * @return true If the type has been registered or removed
+     */
+    bool registerPacketType(uint8_t type, LM_PacketHandler handler, void* context = nullptr);
+
+    /**
+     * @brief Send a frame of a type of the application to a neighbor or to all of them, without routes. It will not wait
+     * for an ACK.
+     *
+     * @param type Type registered with registerPacketType
+     * @param dst Address of a neighbor or BROADCAST_ADDR
+     * @param payload Payload to send
+     * @param payloadSize Payload size to be send in Bytes, up to the payload of one packet
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
+     */
+    LM_EnqueueResult sendCustomPacket(uint8_t type, uint16_t dst, const uint8_t* payload, uint32_t payloadSize);
+
     /**
      * @brief Send the payload reliable.
      * It will wait for an ACK back from the destination to send the next packet.
+     * With fecGroup a parity packet, the XOR of the packets, is sent after every fecGroup packets. The destination rebuilds
+     * one packet lost of every group without asking for it, the sequence is sent with a window of fecGroup packets at least
      *
      * @param dst destination address
      * @param payload payload to send
      * @param payloadSize payload size to be send in Bytes
+     * @param fecGroup Packets protected by every parity packet, up to LM_SACK_BITS. 0 without parity packets
+     * @return LM_EnqueueResult If the sequence has been started, see isEnqueued. For the broadcast address the last failure, if any
      */
-    void sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize);
+    LM_EnqueueResult sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize, uint8_t fecGroup = 0);
+
+    /**
+     * @brief Send the payload reliable to one destination and track its completion, like sendReliablePacket
+     *
+     * @param dst Destination address, not the broadcast address
+     * @param payload payload to send
+     * @param payloadSize payload size to be send in Bytes
+     * @param fecGroup Packets protected by every parity packet, see sendReliablePacket
+     * @param handle Output handle of the transfer, see getTransfer and waitTransfer. 0 if the sequence has not been started,
+     * or if LM_MAX_TRANSFERS transfers are pending: it is sent without tracking then
+     * @param options Callback and task notified when it is delivered or fails
+     * @return LM_EnqueueResult If the sequence has been started, see isEnqueued
+     */
+    LM_EnqueueResult sendReliablePacket(uint16_t dst, uint8_t* payload, uint32_t payloadSize, uint8_t fecGroup,
+        LM_TransferHandle& handle, const LM_TransferOptions& options = LM_TransferOptions());
+
+    /**
+     * @brief Send a payload reliable to one destination reading it from a source, like sendReliablePacket. Every packet
+     * is read with readChunk when it is sent or retransmitted, the payload is never held whole in memory: it can be sent
+     * from a file. The destination still joins it in memory. The payload is not compressed nor encrypted
+     *
+     * @param dst Destination address, not the broadcast address
+     * @param totalLength Payload size in Bytes
+     * @param readChunk Source of the payload, called until the transfer ends
+     * @param context Context of readChunk, it must be valid until the transfer ends
+     * @param fecGroup Packets protected by every parity packet, see sendReliablePacket. Every group is read again to
+     * build its parity packet
+     * @param handle Output handle of the transfer, 0 if the sequence has not been started. The source can be released
+     * when it ends, see options
+     * @param options Callback and task notified when it is delivered or fails
+     * @return LM_EnqueueResult If the sequence has been started, see isEnqueued. ENQUEUE_INVALID if LM_MAX_TRANSFERS
+     * transfers are pending or the payloads are encoded, see LoraMesherConfig::compressPayloads and applicationPorts
+     */
+    LM_EnqueueResult sendReliableStream(uint16_t dst, uint32_t totalLength, LM_ReadChunk readChunk, void* context,
+        uint8_t fecGroup, LM_TransferHandle& handle, const LM_TransferOptions& options = LM_TransferOptions());
+
+    /**
+     * @brief Get the status and the completion time of a reliable transfer
+     *
+     * @param handle Transfer
+     * @param info Output status
+     * @return true If the handle is tracked, it is kept until LM_MAX_TRANSFERS newer transfers reuse its slot
+     */
+    bool getTransfer(LM_TransferHandle handle, LM_TransferInfo& info) { return TransferService::getInfo(handle, info); }
+
+    /**
+     * @brief Wait until a reliable transfer is delivered or fails, it uses the task notifications of the calling task
+     *
+     * @param handle Transfer
+     * @param timeout Ticks to wait
+     * @return LM_TransferStatus TRANSFER_PENDING if it has not ended before the timeout
+     */
+    LM_TransferStatus waitTransfer(LM_TransferHandle handle, TickType_t timeout = portMAX_DELAY) {
+        return TransferService::wait(handle, timeout);
+    }
 
     /**
      * @brief Send the payload reliable. It will wait for an ack of the destination.
@@ -307,12 +902,73 @@ public:
      * @param dst Destination
      * @param payload Payload of type T
      * @param payloadSize Length of the payload in T
+     * @param fecGroup Packets protected by every parity packet, see sendReliablePacket
+     * @return LM_EnqueueResult If the sequence has been started, see isEnqueued
      */
     template <typename T>
-    void sendReliable(uint16_t dst, T* payload, uint32_t payloadSize) {
-        sendReliablePacket(dst, reinterpret_cast<uint8_t*>(payload), sizeof(T) * payloadSize);
+    LM_EnqueueResult sendReliable(uint16_t dst, T* payload, uint32_t payloadSize, uint8_t fecGroup = 0) {
+        return sendReliablePacket(dst, reinterpret_cast<uint8_t*>(payload), sizeof(T) * payloadSize, fecGroup);
+    }
+
+    /**
+     * @brief Send a payload larger than one packet without ACKs. It is split in up to LM_MAX_FRAGMENTS fragments that are
+     * forwarded like any other packet, the destination joins them and discards the datagram if one is lost
+     *
+     * @param dst Destination address
+     * @param payload Payload to send
+     * @param payloadSize Payload size to be send in Bytes
+     * @return LM_EnqueueResult If all the fragments have been added to the send queue, see isEnqueued
+     */
+    LM_EnqueueResult sendDatagram(uint16_t dst, const uint8_t* payload, uint32_t payloadSize) {
+        return sendDatagram(dst, payload, payloadSize, 0);
     }
 
+    /**
+     * @brief Open a reliable stream to a destination. The data written is sent in chunks of LM_STREAM_CHUNK_SIZE bytes,
+     * one reliable sequence each, in order. The packets in flight are limited by a congestion window that grows with
+     * every ACK and halves with every loss, so a stream adapts to the load of the route instead of a fixed window
+     *
+     * @param dst Destination address, not the broadcast address
+     * @return uint8_t Id of the stream, 0 if LM_MAX_STREAMS streams are open
+     */
+    uint8_t openStream(uint16_t dst);
+
+    /**
+     * @brief Write to a stream, the payload is copied. Every chunk is received as one AppPacket, twice if the last ACK of
+     * its sequence is lost and it is sent again
+     *
+     * @param stream Id of the stream
+     * @param payload Payload to send
+     * @param payloadSize Payload size in Bytes
+     * @return LM_EnqueueResult ENQUEUE_QUEUE_FULL if the chunks waiting do not leave room for the whole payload, nothing is written.
+     * ENQUEUE_INVALID if the stream is not open
+     */
+    LM_EnqueueResult writeStream(uint8_t stream, const uint8_t* payload, uint32_t payloadSize);
+
+    /**
+     * @brief Close a stream, the chunks written are still sent. The id is not valid anymore
+     *
+     * @param stream Id of the stream
+     */
+    void closeStream(uint8_t stream);
+
+    /**
+     * @brief Check if a stream is open. A stream is closed when a chunk cannot be delivered after LM_STREAM_CHUNK_ATTEMPTS
+     * sequences, dropping the chunks waiting
+     *
+     * @param stream Id of the stream
+     * @return true If it is open
+     */
+    bool isStreamOpen(uint8_t stream);
+
+    /**
+     * @brief Get the congestion window of a stream
+     *
+     * @param stream Id of the stream
+     * @return uint8_t Packets in flight allowed, 0 if the stream is not open
+     */
+    uint8_t getStreamWindow(uint8_t stream);
+
     /**
      * @brief Returns the number of packets inside the received packets queue
      *
@@ -328,7 +984,7 @@ public:
     size_t getSendQueueSize();
 
     /**
-      * @brief Get the Next Application Packet
+      * @brief Get the Next Application Packet, with the RSSI, SNR, receive timestamp and hops of its reception
       *
       * @tparam T Type to be converted
       * @return AppPacket<T>*
@@ -349,694 +1005,3277 @@ public:
      */
     template <typename T>
     static void deletePacket(AppPacket<T>* p) {
-        vPortFree(p);
+        PacketPoolService::release(p);
     }
 
     /**
-     * @brief Returns the routing table size
+     * @brief Returns the number of packets inside the received packet views queue, only used with zeroCopyReceive
      *
-     * @return size_t Routing Table Size
+     * @return size_t Received Views Queue Size
      */
-    size_t routingTableSize();
+    size_t getReceivedViewQueueSize() { return ReceivedAppPacketViews->getLength(); }
 
+    /**
+      * @brief Get the Next Application Packet View, only used with zeroCopyReceive
+      *
+      * @tparam T Type to be converted
+      * @return AppPacketView<T>*
+      */
+    template<typename T>
+    AppPacketView<T>* getNextAppPacketView() {
+        ReceivedAppPacketViews->setInUse();
+        AppPacketView<T>* view = reinterpret_cast<AppPacketView<T>*>(ReceivedAppPacketViews->Pop());
+        ReceivedAppPacketViews->releaseInUse();
+        return view;
+    }
 
     /**
-     * @brief Get the Local Address
+     * @brief Delete the packet view and the received buffer from memory
      *
-     * @return uint16_t Address
+     * @tparam T Type of packet
+     * @param p Packet view to delete
      */
-    uint16_t getLocalAddress();
+    template <typename T>
+    static void deletePacket(AppPacketView<T>* p) {
+        PacketPoolService::release(p);
+    }
 
     /**
-     * @brief Get the Received Data Packets Num
+     * @brief Copy the payload of the next received packet into a buffer of the caller and release the packet at once,
+     * without the AppPacket or the view held by the application. The views of zeroCopyReceive go first. To wait, it must
+     * run in the task of setReceiveAppDataTaskHandle, it is notified with every packet received
      *
-     * @return uint32_t
+     * @param buffer Buffer of the caller
+     * @param capacity Size of the buffer, the rest of a longer payload is dropped, see LM_ReceiveMetadata::isTruncated
+     * @param metadata Output fields of the packet
+     * @param timeout Ticks to wait for a packet
+     * @return true If a packet has been received
      */
-    uint32_t getReceivedDataPacketsNum() { return receivedDataPacketsNum; }
+    bool receiveInto(void* buffer, size_t capacity, LM_ReceiveMetadata& metadata, TickType_t timeout = portMAX_DELAY);
 
     /**
-     * @brief Get the Send Packets Num
+     * @brief receiveInto without waiting
      *
-     * @return uint32_t
+     * @return true If a packet was queued
      */
-    uint32_t getSendPacketsNum() { return sendPacketsNum; }
+    bool tryReceive(void* buffer, size_t capacity, LM_ReceiveMetadata& metadata);
 
     /**
-     * @brief Get the Received Hello Packets Num
+     * @brief Returns the routing table size
      *
-     * @return uint32_t
+     * @return size_t Routing Table Size
      */
-    uint32_t getReceivedHelloPacketsNum() { return receivedHelloPacketsNum; }
+    size_t routingTableSize();
+
 
     /**
-     * @brief Get the Sent Hello Packets Num
+     * @brief Get the Local Address
      *
-     * @return uint32_t
+     * @return uint16_t Address
      */
-    uint32_t getSentHelloPacketsNum() { return sentHelloPacketsNum; }
+    uint16_t getLocalAddress();
 
     /**
-     * @brief Get the Received Broadcast Packets Num
+     * @brief Get the time of the network, the clock of the root gateway, see LoraMesherConfig::timeSync
      *
-     * @return uint32_t
+     * @param time Time in us
+     * @return true If the node is synchronized
      */
-    uint32_t getReceivedBroadcastPacketsNum() { return receivedBroadcastPacketsNum; }
+    bool getSyncedTime(int64_t& time) { return TimeSyncService::toSyncedTime(esp_timer_get_time(), time); }
 
     /**
-     * @brief Get the Received Broadcast Packets Num
+     * @brief Congestion of this node, the highest of the fill of the send queue and of the airtime budget used,
+     * see LoraMesherConfig::backpressure
      *
-     * @return uint32_t
+     * @return uint8_t Congestion in percent
      */
-    uint32_t getForwardedPacketsNum() { return forwardedPacketsNum; }
+    uint8_t getCongestion();
 
     /**
-     * @brief Get the Data Packets For Me Num
+     * @brief Congestion on the way to a destination: of this node and of its next hop, and of the whole path that the next
+     * hops advertise when it is the best gateway. A source can send less while it is at least LM_CONGESTION_THRESHOLD
      *
-     * @return uint32_t
+     * @param dst Destination, an address or a role address
+     * @return uint8_t Congestion in percent, the one of this node if the others are not known
      */
-    uint32_t getDataPacketsForMeNum() { return dataPacketForMeNum; }
+    uint8_t getPathCongestion(uint16_t dst);
 
     /**
-     * @brief Get the Received I Am Via Num
+     * @brief Returns if the way to a destination is congested, see getPathCongestion
      *
-     * @return uint32_t
+     * @param dst Destination, an address or a role address
      */
-    uint32_t getReceivedIAmViaNum() { return receivedIAmViaNum; }
+    bool isCongested(uint16_t dst) { return getPathCongestion(dst) >= LM_CONGESTION_THRESHOLD; }
 
     /**
-     * @brief Get the Destiny Unreachable Num
+     * @brief Interval of a source paced by the state of the mesh. The nominal interval is stretched with the congestion of the
+     * path above LM_CONGESTION_THRESHOLD, the send queue and the airtime budget of this node included, up to LM_RATE_MAX_STRETCH
+     * times at 100 %, and with the load of a gateway over LM_RATE_GATEWAY_CAPACITY. The readings of the deferred payloads
+     * can be batched in the next one
      *
-     * @return uint32_t
+     * @param dst Destination, an address or a role address
+     * @param interval Nominal ms between two payloads
+     * @return uint32_t Interval in ms
      */
-    uint32_t getDestinyUnreachableNum() { return sendPacketDestinyUnreachableNum; }
+    uint32_t getSendInterval(uint16_t dst, uint32_t interval);
 
     /**
-     * @brief Get the Received Not For Me
+     * @brief Time when a source can send its next payload, the paced interval after the last one and not before the airtime
+     * budget fits a packet of the max size. The app tasks query it before sending, see getSendInterval
      *
-     * @return uint32_t
+     * @param dst Destination, an address or a role address
+     * @param lastSend millis() of the last payload
+     * @param interval Nominal ms between two payloads
+     * @return uint32_t millis() of the next payload
      */
-    uint32_t getReceivedNotForMe() { return receivedPacketNotForMeNum; }
+    uint32_t getNextSendTime(uint16_t dst, uint32_t lastSend, uint32_t interval);
 
     /**
-     * @brief Get the payload received bytes
+     * @brief Get the telemetry of a node collected by this gateway, see LoraMesherConfig::telemetryInterval
      *
-     * @return uint32_t
+     * @param address Address of the node
+     * @param telemetry Telemetry of the node
+     * @return true If the gateway has a record of the node
      */
-    uint32_t getReceivedPayloadBytes() { return receivedPayloadBytes; }
+    bool getTelemetry(uint16_t address, LM_Telemetry& telemetry) { return TelemetryService::getNode(address, telemetry); }
 
     /**
-     * @brief Get the control received bytes
+     * @brief Get the telemetry of the nodes collected by this gateway, see LoraMesherConfig::telemetryInterval
      *
-     * @return uint32_t
+     * @param telemetry Output telemetry of the nodes
+     * @param max Maximum number of nodes, LM_TELEMETRY_NODES to get all of them
+     * @return size_t Number of nodes
      */
-    uint32_t getReceivedControlBytes() { return receivedControlBytes; }
+    size_t getTelemetry(LM_Telemetry* telemetry, size_t max) { return TelemetryService::getNodes(telemetry, max); }
 
     /**
-     * @brief Get the payload sent bytes
+     * @brief Set a value of the application recorded in the metrics history, for example a reading of a monitor of the
+     * firmware, see LoraMesherConfig::metricsInterval
      *
-     * @return uint32_t
+     * @param index Index of the value, below LM_METRICS_APP_VALUES
+     * @param value Value, kept until it is set again
      */
-    uint32_t getSentPayloadBytes() { return sentPayloadBytes; }
+    void setMetricValue(uint8_t index, uint32_t value) { MetricsHistoryService::setAppValue(index, value); }
 
     /**
-     * @brief Get the control sent bytes
+     * @brief Get the metrics history of this node in a range of time, the oldest sample first, see
+     * LoraMesherConfig::metricsInterval
      *
-     * @return uint32_t
+     * @param tier Resolution of the samples
+     * @param from Seconds since the boot of the first sample
+     * @param to Seconds since the boot of the last sample
+     * @param samples Output samples
+     * @param max Maximum number of samples
+     * @return size_t Number of samples
      */
-    uint32_t getSentControlBytes() { return sentControlBytes; }
+    size_t getMetrics(LM_MetricsTier tier, uint32_t from, uint32_t to, LM_MetricsSample* samples, size_t max) {
+        return MetricsHistoryService::get(tier, from, to, samples, max);
+    }
 
     /**
-     * @brief Checks if the node is a gateway
+     * @brief Request the metrics history of another node in a range of time. The node answers with the samples that fit
+     * in LM_METRICS_REPLY_SIZE bytes, given to the callback of setMetricsCallback
      *
+     * @param dst Address of the node
+     * @param tier Resolution of the samples
+     * @param from Seconds since the boot of the node of the first sample
+     * @param to Seconds since the boot of the node of the last sample
+     * @return LM_EnqueueResult If the request has been added to the send queue, see isEnqueued. ENQUEUE_INVALID without
+     * LoraMesherConfig::applicationPorts, the requests and the replies go on LM_PORT_METRICS
      */
-    static bool isGatewayRole() { return RoleService::isGateway(); };
+    LM_EnqueueResult requestMetrics(uint16_t dst, LM_MetricsTier tier, uint32_t from = 0, uint32_t to = UINT32_MAX);
 
     /**
-     * @brief Defines that the node is a gateway
+     * @brief Set the callback of the replies to requestMetrics
      *
      */
-    static void addGatewayRole() { RoleService::setRole(ROLE_GATEWAY); };
+    void setMetricsCallback(LM_MetricsCallback callback, void* context = nullptr) { MetricsHistoryService::setCallback(callback, context); }
 
     /**
-     * @brief Defines that the node is not a gateway
+     * @brief Get the per hop breakdown of the traced packets received by this node, see LoraMesherConfig::hopTraceSampling
      *
+     * @param traces Output traces, newest first
+     * @param max Maximum number of traces, LM_HOP_TRACES to get all of them
+     * @return size_t Number of traces
      */
-    static void removeGatewayRole() { RoleService::removeRole(ROLE_GATEWAY); };
+    size_t getHopTraces(LM_HopTrace* traces, size_t max) { return HopTraceService::getTraces(traces, max); }
 
     /**
-     * @brief Defines any type of Role
+     * @brief Set the filter of the frames received from a transmitter, to emulate a topology on a desk, see LinkFilterService
      *
-     * @param role Role to be defined
+     * @param transmitter Address, 0 for the transmitters without their own filter
+     * @param filter Drop per mille, delay and SNR offset of the link
+     * @return true If it is set, false if LM_LINK_FILTERS transmitters have a filter already
      */
-    static void addRole(uint8_t role) { RoleService::setRole(role); };
+    bool setLinkFilter(uint16_t transmitter, const LM_LinkFilter& filter) { return LinkFilterService::set(transmitter, filter); }
 
     /**
-     * @brief Get the Nearest Gateway object
+     * @brief Remove the filter of a transmitter, it uses the default one again
      *
-     * @return RouteNode*
+     * @param transmitter Address, 0 resets the default filter
      */
-    static RouteNode* getClosestGateway() { return RoutingTableService::getBestNodeByRole(ROLE_GATEWAY); };
+    void removeLinkFilter(uint16_t transmitter) { LinkFilterService::remove(transmitter); }
 
     /**
-     * @brief Get the Best Node With Role
+     * @brief Remove every link filter
      *
-     * @param role Role to be searched
-     * @return RouteNode* Route Node
      */
-    static RouteNode* getBestNodeWithRole(uint8_t role) { return RoutingTableService::getBestNodeByRole(role); };
+    void clearLinkFilters() { LinkFilterService::clear(); }
 
     /**
-     * @brief Set the Simulator Service object
+     * @brief Apply a line of the link matrix, read from serial or received from another node, see LinkFilterService
      *
-     * @param service Simulator Service
+     * @param line Null terminated line, "<transmitter>><receiver> [drop PM] [delay MS] [snr DB]" or "clear"
+     * @return true If the line is valid, even if it is for another receiver
      */
-    void setSimulatorService(SimulatorService* service) { simulatorService = service; }
+    bool configureLinkFilter(const char* line) { return LinkFilterService::configure(line, getLocalAddress()); }
 
     /**
-     * @brief Remove the Simulator Service object
+     * @brief Offer the firmware image at the start of the partition of the updates to the network, see
+     * LoraMesherConfig::otaPartition. The nodes with an older otaVersion receive it
      *
+     * @param size Size of the image in bytes
+     * @return true If the image is offered
      */
-    void removeSimulatorService() { simulatorService = nullptr; }
-
-#ifndef LM_GOD_MODE
-private:
-#endif
+    bool startOta(uint32_t size);
 
     /**
-     * @brief Construct a new LoraMesher object
+     * @brief Get the state of the firmware update, see LoraMesherConfig::otaPartition
      *
+     * @param received Chunks of the image received, if it is not nullptr
+     * @param chunks Chunks of the image, if it is not nullptr
+     * @return LM_OtaState
      */
-    LoraMesher();
+    LM_OtaState getOtaState(uint32_t* received = nullptr, uint32_t* chunks = nullptr);
 
     /**
-     * @brief Configuration of the LoRaMesher
+     * @brief Get the time of the network at a time of the local clock, the rxTimestamp of an AppPacket for example
      *
+     * @param localTime Time of the local clock in us, esp_timer_get_time
+     * @param time Time of the network in us
+     * @return true If the node is synchronized
      */
-    LoraMesherConfig* loraMesherConfig = new LoraMesherConfig();
+    bool toSyncedTime(int64_t localTime, int64_t& time) { return TimeSyncService::toSyncedTime(localTime, time); }
 
-    LM_LinkedList<AppPacket<uint8_t>>* ReceivedAppPackets = new LM_LinkedList<AppPacket<uint8_t>>();
+    /**
+     * @brief Get the hops from the root gateway of the time of the network
+     *
+     * @return uint8_t Level, 0 for the root, UINT8_MAX if the node is not synchronized
+     */
+    uint8_t getTimeSyncLevel() { return TimeSyncService::getLevel(); }
+
+    /**
+     * @brief Get the Received Data Packets Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedDataPacketsNum() { return stats.receivedDataPacketsNum; }
+
+    /**
+     * @brief Get the Send Packets Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getSendPacketsNum() { return stats.sendPacketsNum; }
+
+    /**
+     * @brief Get the Received Hello Packets Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedHelloPacketsNum() { return stats.receivedHelloPacketsNum; }
+
+    /**
+     * @brief Get the Sent Hello Packets Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getSentHelloPacketsNum() { return stats.sentHelloPacketsNum; }
+
+    /**
+     * @brief Get the Received Broadcast Packets Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedBroadcastPacketsNum() { return stats.receivedBroadcastPacketsNum; }
+
+    /**
+     * @brief Get the Received Broadcast Packets Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getForwardedPacketsNum() { return stats.forwardedPacketsNum; }
+
+    /**
+     * @brief Get the Data Packets For Me Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getDataPacketsForMeNum() { return stats.dataPacketForMeNum; }
+
+    /**
+     * @brief Get the Received I Am Via Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedIAmViaNum() { return stats.receivedIAmViaNum; }
+
+    /**
+     * @brief Get the Destiny Unreachable Num
+     *
+     * @return uint32_t
+     */
+    uint32_t getDestinyUnreachableNum() { return stats.sendPacketDestinyUnreachableNum; }
+
+    /**
+     * @brief Get the Received Not For Me
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedNotForMe() { return stats.receivedPacketNotForMeNum; }
+
+    /**
+     * @brief Get the number of packets not for me dropped from their header, without copying them out of the received ring
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedFilteredNum() { return stats.receivedFilteredNum; }
+
+    /**
+     * @brief Get the number of received packets dropped because the receive ring was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedOverflowNum() {
+        return ReceivedPackets->getOverflows() + (SecondaryReceivedPackets ? SecondaryReceivedPackets->getOverflows() : 0);
+    }
+
+    /**
+     * @brief Get the number of packets dropped because the send queue was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getSendQueueDroppedNum() { return stats.sendQueueDroppedNum; }
+
+    /**
+     * @brief Get the number of packets dropped from the send queue because their deadline passed, see LM_SendOptions
+     *
+     * @return uint32_t
+     */
+    uint32_t getSendQueueExpiredNum() { return stats.sendQueueExpiredNum; }
+
+    /**
+     * @brief Get the number of packets removed from the send queue by a newer reading with the same key, see LM_SendOptions
+     *
+     * @return uint32_t
+     */
+    uint32_t getSendQueueReplacedNum() { return stats.sendQueueReplacedNum; }
+
+    /**
+     * @brief Get the number of packets without a route stored in the spool, see LoraMesherConfig::spoolPartition
+     *
+     * @return uint32_t
+     */
+    uint32_t getSpoolStoredNum() { return stats.spoolStoredNum; }
+
+    /**
+     * @brief Get the number of packets moved from the spool back to the send queue
+     *
+     * @return uint32_t
+     */
+    uint32_t getSpoolDrainedNum() { return stats.spoolDrainedNum; }
+
+    /**
+     * @brief Get the number of packets waiting in the spool
+     *
+     * @return uint32_t
+     */
+    uint32_t getSpoolSize() { return SpoolService::getPendingNum(); }
+
+    /**
+     * @brief Get the number of received packets dropped because the received application queue was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedQueueDroppedNum() { return stats.receivedQueueDroppedNum; }
+
+    /**
+     * @brief Get the number of times the channel was busy before sending, with cadListenBeforeTalk
+     *
+     * @return uint32_t
+     */
+    uint32_t getChannelBusyNum() { return stats.channelBusyNum; }
+
+    /**
+     * @brief Get the number of rebroadcasts of flooded packets suppressed because enough copies were overheard
+     *
+     * @return uint32_t
+     */
+    uint32_t getFloodSuppressedNum() { return stats.floodSuppressedNum; }
+
+    /**
+     * @brief Get the number of data packets resent because their next hop did not acknowledge them, see LoraMesherConfig::hopAck
+     *
+     * @return uint32_t
+     */
+    uint32_t getHopRetransmissionsNum() { return stats.hopRetransmissionsNum; }
+
+    /**
+     * @brief Get the number of neighbors withdrawn, see withdrawNeighbor and LoraMesherConfig::triggeredWithdrawal
+     *
+     * @return uint32_t
+     */
+    uint32_t getNeighborsWithdrawnNum() { return stats.neighborsWithdrawnNum; }
+
+    /**
+     * @brief Get the number of routes moved to an alternate next hop, see LoraMesherConfig::multipath
+     *
+     * @return uint32_t
+     */
+    uint32_t getRouteFailoversNum() { return RoutingTableService::getFailoverCount(); }
+
+    /**
+     * @brief Get the number of times the HELLO slot has been moved, see LoraMesherConfig::helloSlots
+     *
+     * @return uint32_t
+     */
+    uint32_t getHelloReslotsNum() { return stats.helloReslotsNum; }
+
+    /**
+     * @brief Get the number of HELLOs sent soliciting the neighbors, see LoraMesherConfig::neighborSolicitation
+     *
+     * @return uint32_t
+     */
+    uint32_t getSolicitationsNum() { return stats.solicitationsNum; }
+
+    /**
+     * @brief Get the number of HELLOs sent answering a solicitation of a neighbor
+     *
+     * @return uint32_t
+     */
+    uint32_t getSolicitationRepliesNum() { return stats.solicitationRepliesNum; }
+
+    /**
+     * @brief Get the number of route requests flooded by the node, see LoraMesherConfig::reactiveRoutes
+     *
+     * @return uint32_t
+     */
+    uint32_t getRouteRequestsNum() { return stats.routeRequestsNum; }
+
+    /**
+     * @brief Get the number of route replies sent by the node as the destination of a request
+     *
+     * @return uint32_t
+     */
+    uint32_t getRouteRepliesNum() { return stats.routeRepliesNum; }
+
+    /**
+     * @brief Get the number of route discoveries failed without a reply, their held packets are dropped
+     *
+     * @return uint32_t
+     */
+    uint32_t getRouteDiscoveryFailuresNum() { return RouteDiscoveryService::getFailedNum(); }
+
+    /**
+     * @brief Get the number of traced packets received by this node, see LoraMesherConfig::hopTraceSampling
+     *
+     * @return uint32_t
+     */
+    uint32_t getHopTracesNum() { return HopTraceService::getReceivedNum(); }
+
+    /**
+     * @brief Get the number of packets sent in a TDMA slot of the node, see LoraMesherConfig::tdmaSlots
+     *
+     * @return uint32_t
+     */
+    uint32_t getTdmaSlotSendsNum() { return stats.tdmaSlotSendsNum; }
+
+    /**
+     * @brief Get the estimate of the fraction of time the channel is busy, as sensed by the node: its frames, the frames
+     * it receives and the activity detected by its scans without a frame. EWMA of windows of LM_CHANNEL_BUSY_WINDOW ms,
+     * the sources are in LM_Stats
+     *
+     * @return uint16_t Per mille
+     */
+    uint16_t getChannelBusy();
+
+    /**
+     * @brief Get the number of packets sent on the backbone, see LoraMesherConfig::secondaryPacketType
+     *
+     * @return uint32_t
+     */
+    uint32_t getBackboneSentNum() { return stats.backboneSentNum; }
+
+    /**
+     * @brief Get the number of packets that failed on the backbone, the unicast ones are sent on LoRa then
+     *
+     * @return uint32_t
+     */
+    uint32_t getBackboneFailedNum() { return stats.backboneFailedNum; }
+
+    /**
+     * @brief If the packets to a neighbour go on the backbone, see LoraMesherConfig::secondaryPacketType
+     *
+     * @param address Address of the neighbour
+     */
+    bool isBackboneLink(uint16_t address) { return BackboneService::isLink(address); }
+
+    /**
+     * @brief Get the number of TDMA slots taken and left by the node
+     *
+     * @return uint32_t
+     */
+    uint32_t getTdmaSlotChangesNum() { return TdmaService::getSlotChangesNum(); }
+
+    /**
+     * @brief Get the number of HELLOs triggered by a change of the congestion of the node, see LoraMesherConfig::backpressure
+     *
+     * @return uint32_t
+     */
+    uint32_t getCongestionHellosNum() { return stats.congestionHellosNum; }
+
+    /**
+     * @brief Get the number of telemetry records not relayed toward the gateways because the relay slots were full
+     *
+     * @return uint32_t
+     */
+    uint32_t getTelemetryRelayDroppedNum() { return TelemetryService::getRelayDroppedNum(); }
+
+    /**
+     * @brief Get the number of chunks of a firmware image served to the neighbors, see LoraMesherConfig::otaPartition
+     *
+     * @return uint32_t
+     */
+    uint32_t getOtaChunksServedNum() { return OtaService::getServedNum(); }
+
+    /**
+     * @brief Get the number of requests of missing chunks of a firmware image sent, see LoraMesherConfig::otaPartition
+     *
+     * @return uint32_t
+     */
+    uint32_t getOtaRequestsNum() { return OtaService::getRequestsNum(); }
+
+    /**
+     * @brief Get the number of firmware images received whose hash did not match, see LoraMesherConfig::otaPartition
+     *
+     * @return uint32_t
+     */
+    uint32_t getOtaHashFailuresNum() { return OtaService::getHashFailuresNum(); }
+
+    /**
+     * @brief Get the number of ACK and LOST packets sent in the aggregate frame of a data packet, see LoraMesherConfig::delayedAck
+     *
+     * @return uint32_t
+     */
+    uint32_t getPiggybackedAcksNum() { return stats.piggybackedAcksNum; }
+
+    /**
+     * @brief Get the number of delayed ACKs replaced by a newer ACK of the same sequence, see LoraMesherConfig::delayedAck
+     *
+     * @return uint32_t
+     */
+    uint32_t getCoalescedAcksNum() { return stats.coalescedAcksNum; }
+
+    /**
+     * @brief Get the number of data packets not acknowledged by their next hop after all the retransmissions
+     *
+     * @return uint32_t
+     */
+    uint32_t getHopAckLostNum() { return stats.hopAckLostNum; }
+
+    /**
+     * @brief Get the number of datagrams received without all their fragments before LM_FRAGMENT_TIMEOUT
+     *
+     * @return uint32_t
+     */
+    uint32_t getDatagramsIncompleteNum() { return stats.datagramsIncompleteNum; }
+
+    /**
+     * @brief Get the number of packets of the reliable sequences received rebuilt from their parity packet
+     *
+     * @return uint32_t
+     */
+    uint32_t getFecRebuiltNum() { return stats.fecRebuiltNum; }
+
+    /**
+     * @brief Get the bytes of the application payloads given to the compression, with compressPayloads
+     *
+     * @return uint32_t
+     */
+    uint32_t getCompressionInputBytes() { return stats.compressionInputBytes; }
+
+    /**
+     * @brief Get the bytes of the encoded application payloads, with compressPayloads.
+     * The bytes saved are getCompressionInputBytes() - getCompressionOutputBytes()
+     *
+     * @return uint32_t
+     */
+    uint32_t getCompressionOutputBytes() { return stats.compressionOutputBytes; }
+
+    /**
+     * @brief Get the number of received payloads dropped because their tag was wrong, with a payloadKey
+     *
+     * @return uint32_t
+     */
+    uint32_t getPayloadAuthFailedNum() { return stats.payloadAuthFailedNum; }
+
+    /**
+     * @brief Get the airtime that can be sent back to back now, with the airtimeLimit
+     *
+     * @return uint32_t Airtime in ms
+     */
+    uint32_t getAvailableAirtime() {
+        portENTER_CRITICAL(&airtimeBudgetMux);
+        uint32_t available = airtimeBudget.getAvailableMs();
+        portEXIT_CRITICAL(&airtimeBudgetMux);
+        return available;
+    }
+
+    /**
+     * @brief Get the payload received bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedPayloadBytes() { return stats.receivedPayloadBytes; }
+
+    /**
+     * @brief Get the control received bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceivedControlBytes() { return stats.receivedControlBytes; }
+
+    /**
+     * @brief Get the payload sent bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getSentPayloadBytes() { return stats.sentPayloadBytes; }
+
+    /**
+     * @brief Get the control sent bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getSentControlBytes() { return stats.sentControlBytes; }
+
+    /**
+     * @brief Get the sum of the high water marks of the packet pool size classes
+     *
+     * @return uint32_t
+     */
+    uint32_t getPacketPoolHighWater() { return PacketPoolService::getHighWater(); }
+
+    /**
+     * @brief Get the number of allocations that did not fit in the packet pool
+     *
+     * @return uint32_t
+     */
+    uint32_t getPacketPoolExhaustedNum() { return PacketPoolService::getExhaustedNum(); }
+
+    /**
+     * @brief Get the number of bulk buffers allocated in the PSRAM
+     *
+     * @return uint32_t
+     */
+    uint32_t getPsramAllocationsNum() { return PacketPoolService::getPsramAllocationsNum(); }
+
+    /**
+     * @brief Get the time on air of a frame with the active LoRa configuration, from the precomputed table
+     *
+     * @param length Length of the frame in bytes
+     * @return uint32_t Time on air in ms
+     */
+    static uint32_t getTimeOnAirMs(size_t length) { return AirtimeService::getTimeOnAirMs(length); }
+
+    /**
+     * @brief Get a snapshot of all the statistics. The counters and the send queue wait, backoff and time on air
+     * histograms are copied at the same time, so they are consistent with each other.
+     * The getters of every counter read the same values, one at a time.
+     *
+     * @param out Output statistics
+     */
+    void getStats(LM_Stats& out);
+
+    /**
+     * @brief Get the current and peak memory of every subsystem, see LM_MemoryTag, and the free heap
+     *
+     * @return LM_MemoryStats
+     */
+    LM_MemoryStats getMemoryStats();
+
+    /**
+     * @brief Checks if the node is a gateway
+     *
+     */
+    static bool isGatewayRole() { return RoleService::isGateway(); };
+
+    /**
+     * @brief Defines that the node is a gateway
+     *
+     */
+    static void addGatewayRole() { RoleService::setRole(ROLE_GATEWAY); };
+
+    /**
+     * @brief Defines that the node is not a gateway
+     *
+     */
+    static void removeGatewayRole() { RoleService::removeRole(ROLE_GATEWAY); };
+
+    /**
+     * @brief Defines any type of Role
+     *
+     * @param role Role to be defined
+     */
+    static void addRole(uint8_t role) { RoleService::setRole(role); };
+
+    /**
+     * @brief Get the Nearest Gateway object
+     *
+     * @return RouteNode*
+     */
+    static RouteNode* getClosestGateway() { return RoutingTableService::getBestNodeByRole(ROLE_GATEWAY); };
+
+    /**
+     * @brief Get the Best Node With Role
+     *
+     * @param role Role to be searched
+     * @return RouteNode* Route Node
+     */
+    static RouteNode* getBestNodeWithRole(uint8_t role) { return RoutingTableService::getBestNodeByRole(role); };
+
+    /**
+     * @brief Get the gateway of a flow. The flows are spread over the gateways by weighted rendezvous hashing of
+     * the flow key, weighted by the route cost and the advertised gateway load. See RoutingTableService::getNodeByRoleForFlow
+     *
+     * @param flowKey Key of the flow, for example the local address
+     * @return RouteNode* Route Node or nullptr if there is no gateway
+     */
+    static RouteNode* getGatewayForFlow(uint16_t flowKey) { return RoutingTableService::getNodeByRoleForFlow(flowKey, ROLE_GATEWAY); };
+
+    /**
+     * @brief Set the Simulator Service object
+     *
+     * @param service Simulator Service
+     */
+    void setSimulatorService(SimulatorService* service) { simulatorService = service; }
+
+    /**
+     * @brief Remove the Simulator Service object
+     *
+     */
+    void removeSimulatorService() { simulatorService = nullptr; }
+
+    /**
+     * @brief Capture the raw frames received by the radios, with their RSSI, SNR and receive interrupt timestamp,
+     * in the compact binary records of the CaptureService, replayed with the LM_ReplayModule, or in a pcap stream for
+     * Wireshark with the frequency and the modulation of the receiver too
+     *
+     * @param sink Sink of the records, called from the receiving routines
+     * @param format CAPTURE_FORMAT_RECORDS or CAPTURE_FORMAT_PCAP
+     */
+    void startCapture(LM_CaptureSink sink, LM_CaptureFormat format = CAPTURE_FORMAT_RECORDS) {
+        CaptureService::startCapture(sink, format);
+    }
+
+    /**
+     * @brief Stop capturing the received frames
+     *
+     */
+    void stopCapture() { CaptureService::stopCapture(); }
+
+#ifndef LM_GOD_MODE
+private:
+#endif
+
+    /**
+     * @brief Construct a new LoraMesher object
+     *
+     */
+    LoraMesher();
+
+    /**
+     * @brief Configuration of the LoRaMesher
+     *
+     */
+    LoraMesherConfig* loraMesherConfig = new LoraMesherConfig();
+
+    LM_IntrusiveList<AppPacket<uint8_t>>* ReceivedAppPackets = new LM_IntrusiveList<AppPacket<uint8_t>>();
+
+    LM_LinkedList<AppPacketView<uint8_t>>* ReceivedAppPacketViews = new LM_LinkedList<AppPacketView<uint8_t>>();
+
+    /**
+     * @brief Received packets hand-off between the receivingRoutine (producer) and processPackets (consumer)
+     *
+     */
+    LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ReceivedPackets = new LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>();
+
+    /**
+     * @brief Received packets of the secondary receiver, every ring has a single producer. nullptr without secondary receiver
+     *
+     */
+    LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* SecondaryReceivedPackets = nullptr;
+
+    /**
+     * @brief Number of received packets waiting in the rings
+     *
+     * @return size_t
+     */
+    size_t getReceivedRingLength() {
+        return ReceivedPackets->getLength() + (SecondaryReceivedPackets ? SecondaryReceivedPackets->getLength() : 0);
+    }
+
+    LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* ToSendPackets = new LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>();
+
+    /**
+     * @brief RadioLib module
+     *
+     */
+    LM_Module* radio = nullptr;
+
+    /**
+     * @brief RadioLib module of the secondary receiver, nullptr without it
+     *
+     */
+    LM_Module* secondaryRadio = nullptr;
+
+    /**
+     * @brief Hello task handle. It will send a hello packet every HELLO_PACKETS_DELAY s
+     *
+     */
+    TaskHandle_t Hello_TaskHandle = nullptr;
+
+    /**
+     * @brief Receive packets task handle. Every time a LoRa packet is detected it will create a packet,
+     *  store it into the received packets queue and notify the receive data task handle
+     *
+     */
+    TaskHandle_t ReceivePacket_TaskHandle = nullptr;
+
+    /**
+     * @brief Receive packets task handle of the secondary receiver
+     *
+     */
+    TaskHandle_t SecondaryReceivePacket_TaskHandle = nullptr;
+
+    /**
+     * @brief Receive Data task handle. It will process all the packets inside the received packets queue.
+     * It will be notified by the ReceivePacket_TaskHandle
+     *
+     */
+    TaskHandle_t ReceiveData_TaskHandle = nullptr;
+
+    /**
+     * @brief Send data task handle. Every SEND_PACKETS_DELAY s it will get the packet from send packets queue,
+     * add the via if it is necessary and send it.
+     *
+     */
+    TaskHandle_t SendData_TaskHandle = nullptr;
+
+    /**
+     * @brief Receive App data task handle. Every time that a packet is received and is for this node, this task will be notified.
+     * This task is implemented by the user.
+     *
+     */
+    TaskHandle_t ReceiveAppData_TaskHandle = nullptr;
+
+    /**
+     * @brief Inline receiver of the application packets, see setReceiveCallback
+     *
+     */
+    LM_ReceiveCallback receiveCallback = nullptr;
+    void* receiveCallbackContext = nullptr;
+
+    /**
+     * @brief Port of the application bound to its own task or callback, see bindPort. The queues of a slot are kept once
+     * allocated, so a packet can be appended while the port is unbound
+     *
+     */
+    struct PortBinding {
+        bool bound = false;
+        uint8_t port = 0;
+        TaskHandle_t task = nullptr;
+        LM_ReceiveCallback callback = nullptr;
+        void* context = nullptr;
+        LM_IntrusiveList<AppPacket<uint8_t>>* packets = nullptr;
+        LM_LinkedList<AppPacketView<uint8_t>>* views = nullptr;
+    };
+
+    PortBinding portBindings[LM_APP_PORTS];
+    portMUX_TYPE portsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief Send queue room task handle. It is notified when the send queue had been full and it has room again.
+     * This task is implemented by the user.
+     *
+     */
+    TaskHandle_t SendQueueRoom_TaskHandle = nullptr;
+
+    /**
+     * @brief Queue manager task handle. This task manages the queues inside LoRaMesher, checking for timeouts and resending messages.
+     *
+     */
+    TaskHandle_t QueueManager_TaskHandle = nullptr;
+
+    /**
+     * @brief Routing table manager task handle. This manages the routing table, checking for timeouts and removing nodes.
+     *
+     */
+    TaskHandle_t RoutingTableManager_TaskHandle = nullptr;
+
+    /**
+     * @brief Process workers, see LoraMesherConfig::processWorkers. Every one is notified when a packet is added to its list
+     *
+     */
+    struct ProcessWorker {
+        TaskHandle_t task = nullptr;
+        LM_LinkedList<QueuePacket<Packet<uint8_t>>>* packets = nullptr;
+    };
+
+    ProcessWorker processWorkers[LM_MAX_PROCESS_WORKERS];
+    uint8_t processWorkersLength = 0;
+
+    /**
+     * @brief Task handle of the singleTask mode, the only LoRaMesher task. nullptr with one task per routine
+     *
+     */
+    TaskHandle_t Reactor_TaskHandle = nullptr;
+
+    /**
+     * @brief Events of the singleTask mode, bits of the notification value of the Reactor_TaskHandle
+     *
+     */
+    enum ReactorEvent : uint32_t {
+        EVENT_RX = 1 << 0,
+        EVENT_SECONDARY_RX = 1 << 1,
+        EVENT_TX_DONE = 1 << 2,
+        EVENT_SEND = 1 << 3,
+        EVENT_HELLO = 1 << 4,
+        EVENT_ROUTE_TIMER = 1 << 5,
+        EVENT_QUEUE_TIMER = 1 << 6,
+    };
+
+    /**
+     * @brief Steps of the transmission of a packet in the singleTask mode
+     *
+     */
+    enum SendStep : uint8_t {
+        SEND_IDLE, // No packet
+        SEND_BUDGET, // Waiting for the airtime budget
+        SEND_SLOT, // Waiting for a TDMA slot of the node
+        SEND_BACKOFF, // Waiting before sending, listening to the channel
+        SEND_TRANSMIT, // Start the transmission
+        SEND_ON_AIR, // Waiting for the transmission done
+        SEND_GAP, // Duty cycle delay before the next packet
+    };
+
+    /**
+     * @brief Packet being sent in the singleTask mode and the state of its transmission
+     *
+     */
+    struct ReactorSendState {
+        SendStep step = SEND_IDLE;
+        QueuePacket<Packet<uint8_t>>* packet = nullptr;
+        uint32_t deadline = 0; // millis() when the step ends
+        uint32_t takenAt = 0; // millis() when the packet was taken from the send queue
+        uint32_t backoffStart = 0;
+        uint8_t attempt = 0; // Backoff attempt
+        uint8_t resendMessage = 0;
+        uint8_t sendId = 0;
+    } reactorSend;
+
+    void initConfiguration();
+
+    static void onReceive(void);
+
+    static void onSecondaryReceive(void);
+
+    static void onTransmitDone(void);
+
+    /**
+     * @brief Given by onTransmitDone when the radio has finished sending the packet
+     *
+     */
+    SemaphoreHandle_t txDoneSemaphore = xSemaphoreCreateBinary();
+
+#if LM_COMPACT_HEADER
+    /**
+     * @brief Packet being sent, encoded with the compact header
+     *
+     */
+    uint8_t txBuffer[UINT8_MAX];
+
+    /**
+     * @brief Packet received, encoded with the compact header
+     *
+     */
+    uint8_t rxBuffer[UINT8_MAX];
+
+    /**
+     * @brief Packet received by the secondary receiver, encoded with the compact header
+     *
+     */
+    uint8_t secondaryRxBuffer[UINT8_MAX];
+
+    /**
+     * @brief Packet being sent on the backbone, encoded with the compact header
+     *
+     */
+    uint8_t backboneTxBuffer[UINT8_MAX];
+#endif
+
+    /**
+     * @brief Taken to use the secondary radio, by its receiving routine and the sends on the backbone
+     *
+     */
+    SemaphoreHandle_t secondaryRadioMutex = xSemaphoreCreateMutex();
+
+    /**
+     * @brief micros() when the receive interrupt of each radio fired, read by its receiving routine
+     *
+     */
+    volatile uint32_t rxTimestamp = 0;
+    volatile uint32_t secondaryRxTimestamp = 0;
+
+    void setDioActionsForScanChannel();
+
+    void setDioActionsForReceivePacket();
+
+    void clearDioActions();
+
+    int startReceiving();
+
+    /**
+     * @brief Put the radio in receive, in sniff mode if it is enabled. A radio without it disables the sniff mode
+     *
+     * @return int RadioLib status
+     */
+    int startReceiveMode();
+
+    /**
+     * @brief Scan the channel activity with CAD, blocking. The radio is set back to receive if the packet cannot be sent now
+     *
+     * @return true If a LoRa preamble has been detected
+     * @return false If the channel is free or the scan failed
+     */
+    bool channelScan();
+
+    void receivingRoutine();
+
+    void secondaryReceivingRoutine();
+
+    /**
+     * @brief Read the packet received by the radio and start receiving again
+     *
+     */
+    void receiveStep();
+
+    /**
+     * @brief Read the packet received by the secondary radio and start receiving again
+     *
+     */
+    void secondaryReceiveStep();
+
+    /**
+     * @brief Routine of the singleTask mode. It waits for the events of all the routines and runs their steps
+     *
+     */
+    void reactorRoutine();
+
+    /**
+     * @brief Advance the transmission of the send queue without blocking, the singleTask version of sendPackets.
+     * The only blocking part is the CAD with cadListenBeforeTalk, a few symbols
+     *
+     * @param events Events received, EVENT_TX_DONE finishes the transmission
+     * @return uint32_t ms until the next step, UINT32_MAX if there is nothing to send
+     */
+    uint32_t sendStep(uint32_t events);
+
+    /**
+     * @brief Start the backoff of reactorSend.attempt, like waitBeforeSend and listenBeforeTalk
+     *
+     * @param now millis()
+     * @return true If it has to wait until reactorSend.deadline
+     * @return false If the packet has to be sent now
+     */
+    bool startSendBackoff(uint32_t now);
+
+    /**
+     * @brief If the channel is free after a backoff, with cadListenBeforeTalk it is scanned
+     *
+     */
+    bool isChannelFreeAfterBackoff();
+
+    /**
+     * @brief Frame read from a radio, kept until it is published to the ring of the radio
+     *
+     */
+    struct ReceivedFrame {
+        // Slot of the ring, nullptr if there is nothing to publish
+        LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>::Slot* slot = nullptr;
+        // Frame as received on air, in the slot or in the compact header buffer of the radio
+        uint8_t* buffer = nullptr;
+        size_t length = 0;
+        int16_t state = RADIOLIB_ERR_NONE;
+        int8_t rssi = 0;
+        int8_t snr = 0;
+        uint32_t timestamp = 0;
+    };
+
+    /**
+     * @brief Read the packet received by a radio into a slot of its ring. Only the SPI transfers of the frame, the radio
+     * can receive again before it is published
+     *
+     * @param module Radio that received the packet
+     * @param ring Ring of the radio
+     * @param frame Frame read
+     * @return int16_t RadioLib state of the read
+     */
+    int16_t readReceivedPacket(LM_Module* module, LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring, ReceivedFrame& frame);
+
+    /**
+     * @brief Count, capture and decode a frame read by readReceivedPacket, then publish it to the ring and notify
+     * processPackets
+     *
+     * @param module Radio that received the packet
+     * @param ring Ring of the radio
+     * @param frame Frame read
+     */
+    void publishReceivedPacket(LM_Module* module, LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring, ReceivedFrame& frame);
+
+    void initializeLoRa();
+
+    /**
+     * @brief Create and configure the secondary receiver, if it is enabled
+     *
+     */
+    void initializeSecondaryLoRa();
+
+    int startSecondaryReceiving();
+
+    /**
+     * @brief If a packet taken from the send queue goes on the backbone: a HELLO copy, or a unicast packet to a backbone link
+     *
+     */
+    bool isBackboneFrame(QueuePacket<Packet<uint8_t>>* tx);
+
+    /**
+     * @brief Send a packet on the backbone, blocking until it is sent. It is deleted, or waits for its hop ACK. A unicast
+     * packet that fails goes back to the send queue, to be sent on LoRa
+     *
+     */
+    void sendBackbone(QueuePacket<Packet<uint8_t>>* tx);
+
+    /**
+     * @brief Add the copy of a HELLO to be sent on the backbone, if it is enabled
+     *
+     * @param qp HELLO taken from the send queue
+     */
+    void addBackboneHelloCopy(QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief Count a packet sent
+     *
+     */
+    void countSent(Packet<uint8_t>* p);
+
+    /**
+     * @brief Create a RadioLib module on the SPI bus of the configuration
+     *
+     * @param module Type of the module
+     * @param cs Chip select pin
+     * @param irq IRQ pin
+     * @param rst Reset pin
+     * @param io1 DIO1 pin
+     * @param config Configuration with the SPI bus
+     * @return LM_Module* The module
+     */
+    LM_Module* createModule(LoraModules module, uint8_t cs, uint8_t irq, uint8_t rst, uint8_t io1, LoraMesherConfig& config);
+
+    void initializeSchedulers();
+
+    /**
+     * @brief Create a task with the core, priority and stack of the config. A core that does not exist in this chip
+     * is replaced by tskNO_AFFINITY
+     *
+     * @param function Function of the task
+     * @param name Name of the task
+     * @param task Core, priority and stack size
+     * @param handle Handle of the created task
+     * @return true If the task has been created
+     */
+    bool createTask(TaskFunction_t function, const char* name, const TaskConfig& task, TaskHandle_t* handle);
+
+    void sendHelloPacket();
+
+    /**
+     * @brief The first HELLO is sent 2 seconds after it
+     *
+     */
+    void startHelloStep();
+
+    /**
+     * @brief Send the HELLO packets when they are due, periodically or with the Trickle timer, and the triggered HELLOs
+     *
+     * @return uint32_t ms until the next HELLO or Trickle event
+     */
+    uint32_t helloStep();
+
+    /**
+     * @brief Send the periodic or Trickle HELLO packets when they are due
+     *
+     * @return uint32_t ms until the next HELLO or Trickle event
+     */
+    uint32_t periodicHelloStep();
+
+    /**
+     * @brief Send the triggered HELLO when it is due
+     *
+     * @return uint32_t ms until the triggered HELLO, UINT32_MAX if there is none
+     */
+    uint32_t triggeredHelloStep();
+
+    /**
+     * @brief If the Trickle timer has been started, millis() of the next HELLO without trickleHello
+     *
+     */
+    bool helloStarted = false;
+    uint32_t nextHelloTime = 0;
+
+    /**
+     * @brief Slot of the HELLOs with helloSlots, the salt of its hash, millis() of the start of the current HELLO period
+     * and the missed advertisements already seen when the last HELLO was sent
+     *
+     */
+    uint8_t helloSlot = 0;
+    uint8_t helloSlotSalt = 0;
+    uint32_t helloPeriodStart = 0;
+    uint32_t helloMissedSeen = 0;
+
+    /**
+     * @brief Length of a slot of the periodic HELLOs in ms, with helloSlots
+     *
+     */
+    uint32_t getHelloSlotLength();
+
+    /**
+     * @brief Offset of the HELLO from the start of the period, the start of the slot plus the jitter
+     *
+     * @param slotLength Length of a slot in ms
+     * @return uint32_t Offset in ms, 0 without helloSlots
+     */
+    uint32_t getHelloSlotOffset(uint32_t slotLength);
+
+    /**
+     * @brief Move to another HELLO slot if LM_HELLO_RESLOT_MISSES advertisements of the neighbors have been lost since the last HELLO
+     *
+     */
+    void updateHelloSlot();
+
+    /**
+     * @brief Slot of the node for the current salt
+     *
+     */
+    uint8_t calculateHelloSlot();
+
+    /**
+     * @brief Create and queue the routing packets of one HELLO
+     *
+     */
+    void sendRoutingPackets(bool triggered = false);
+
+    /**
+     * @brief Send a triggered HELLO with the withdrawn routes after a random delay of up to LM_TRIGGERED_HELLO_DELAY ms
+     * and reset the Trickle interval. The requests made before it is sent are joined
+     *
+     * @param resetTrickle If the Trickle interval is reset, the routing table has changed
+     */
+    void requestTriggeredHello(bool resetTrickle = true);
+
+    /**
+     * @brief Fill of the send queue and airtime budget left, in percent
+     *
+     */
+    void getLocalCongestion(uint8_t& queue, uint8_t& airtime);
+
+    /**
+     * @brief Load of a gateway in packets per minute, 255 if the destination is not a gateway or it does not advertise it
+     *
+     * @param dst Destination, an address or a role address
+     */
+    uint8_t getGatewayLoad(uint16_t dst);
+
+    /**
+     * @brief Hops of this node to its best gateway for the telemetry, 0 for a gateway and UINT8_MAX without a route
+     *
+     */
+    uint8_t getGatewayHops();
+
+    /**
+     * @brief Send a triggered HELLO when the node becomes congested or stops being congested, see LoraMesherConfig::backpressure
+     *
+     */
+    void checkCongestion();
+
+    /**
+     * @brief If the last congestion advertised by checkCongestion was congested and millis() when it was, protected by the
+     * congestionMux
+     *
+     */
+    bool congestionAdvertised = false;
+    uint32_t congestionAdvertisedAt = 0;
+    portMUX_TYPE congestionMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief If a triggered HELLO is waiting and millis() when it is sent, protected by the helloTrickleMux
+     *
+     */
+    bool triggeredHelloPending = false;
+    uint32_t triggeredHelloTime = 0;
+
+    /**
+     * @brief If the triggered HELLO answers a solicitation, a full HELLO instead of a delta, protected by the helloTrickleMux
+     *
+     */
+    bool triggeredHelloFull = false;
+
+    /**
+     * @brief If the next HELLO solicits the neighbors, millis() of the last solicitation and the wait until the next one while
+     * the routing table is empty, see LoraMesherConfig::neighborSolicitation
+     *
+     */
+    bool solicitPending = false;
+    uint32_t lastSolicitation = 0;
+    uint32_t solicitInterval = 0;
+
+    /**
+     * @brief millis() of the last answer to a solicitation, 0 if there is none
+     *
+     */
+    uint32_t lastSolicitationReply = 0;
+
+    /**
+     * @brief Solicit the neighbors again while the routing table is empty
+     *
+     * @return uint32_t ms until the next check, UINT32_MAX without neighborSolicitation
+     */
+    uint32_t solicitationStep();
+
+    /**
+     * @brief Answer the solicitation of a neighbor with a full HELLO after a random delay of up to LM_SOLICIT_REPLY_DELAY ms,
+     * unless the node has answered one in the last LM_SOLICIT_HOLDOFF s. The Trickle interval is not reset
+     *
+     */
+    void answerSolicitation();
+
+    /**
+     * @brief Remove the routes to a neighbor and through it
+     *
+     * @param address Address of the neighbor
+     * @return size_t Number of routes removed
+     */
+    size_t removeNeighborRoutes(uint16_t address);
+
+    /**
+     * @brief Trickle timer of the HELLO packets, with trickleHello
+     *
+     */
+    LM_Trickle helloTrickle;
+    portMUX_TYPE helloTrickleMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief Trickle interval in ms restored from the checkpoint, the first interval instead of Imin. 0 without it
+     *
+     */
+    uint32_t restoredTrickleInterval = 0;
+
+    /**
+     * @brief Give the Trickle timer a HELLO or a route timeout. An inconsistency notifies the Hello task
+     *
+     * @param consistent If the routing table has not changed
+     */
+    void notifyHelloConsistency(bool consistent);
+
+    void routingTableManager();
+
+    /**
+     * @brief Remove the routes timed out and print the routing table every DEFAULT_TIMEOUT seconds
+     *
+     * @return uint32_t ms until the next route timeout or print
+     */
+    uint32_t routingTableStep();
+
+    /**
+     * @brief millis() of the last routing table print
+     *
+     */
+    uint32_t lastRoutingTablePrint = 0;
+
+    void queueManager();
+
+    /**
+     * @brief Manage the timeouts of the received and sent sequences
+     *
+     * @return uint32_t ms until the next sequence timeout, UINT32_MAX if there is none
+     */
+    uint32_t queueManagerStep();
+
+    /**
+     * @brief Region Monitoring variables
+     *
+     */
+
+    /**
+     * @brief Counters and histograms, updated from every task inside the statsMux critical section
+     *
+     */
+    LM_Stats stats;
+
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief Estimator of the busy fraction of the channel, inside the statsMux critical section
+     *
+     */
+    LM_ChannelBusy channelBusy;
+
+    /**
+     * @brief millis() of the channel activity detected by the last busy scan without a frame received after it, 0 if none.
+     * Inside the statsMux critical section
+     *
+     */
+    uint32_t preambleDetectedAt = 0;
+
+    /**
+     * @brief millis() when the current transmission started, for the deaf time of the first radio
+     *
+     */
+    uint32_t txStartedAt = 0;
+
+    /**
+     * @brief Add busy time of the channel of the first radio
+     *
+     * @param counter Counter of the source in the stats
+     * @param busyMs Busy time in ms
+     */
+    void addChannelBusy(uint32_t& counter, uint32_t busyMs);
+
+    /**
+     * @brief Count a receive error of a radio by its RadioLib status
+     *
+     */
+    void countReceiveError(int16_t state);
+
+    /**
+     * @brief Channel activity has been detected by a scan
+     *
+     */
+    void channelActivityDetected();
+
+    /**
+     * @brief A frame has been received by the first radio, the channel activity detected before it was this frame
+     *
+     * @param length Length of the frame on air
+     */
+    void channelFrameReceived(size_t length);
+
+    /**
+     * @brief Count the channel activity detected without a frame received in the longest time on air after it, inside the
+     * statsMux critical section
+     *
+     */
+    void checkPreambleWithoutPacket(uint32_t now);
+
+    void incStat(uint32_t& counter, uint32_t value = 1) {
+        portENTER_CRITICAL(&statsMux);
+        counter += value;
+        portEXIT_CRITICAL(&statsMux);
+    }
+
+    void recordStat(LM_Histogram& histogram, uint32_t value) {
+        portENTER_CRITICAL(&statsMux);
+        histogram.record(value);
+        portEXIT_CRITICAL(&statsMux);
+    }
+
+    void incReceivedDataPackets() { incStat(stats.receivedDataPacketsNum); }
+
+    void incSendPackets() { incStat(stats.sendPacketsNum); }
+
+    void incRecHelloPackets() { incStat(stats.receivedHelloPacketsNum); }
+
+    void incSentHelloPackets() { incStat(stats.sentHelloPacketsNum); }
+
+    void incReceivedBroadcast() { incStat(stats.receivedBroadcastPacketsNum); }
+
+    void incForwardedPackets() { incStat(stats.forwardedPacketsNum); }
+
+    void incDataPacketForMe() { incStat(stats.dataPacketForMeNum); }
+
+    void incReceivedIAmVia() { incStat(stats.receivedIAmViaNum); }
+
+    void incDestinyUnreachable() { incStat(stats.sendPacketDestinyUnreachableNum); }
+
+    void incReceivedNotForMe() { incStat(stats.receivedPacketNotForMeNum); }
+
+    void incReceivedFiltered() { incStat(stats.receivedFilteredNum); }
+
+    void incReceivedPayloadBytes(uint32_t numBytes) { incStat(stats.receivedPayloadBytes, numBytes); }
+
+    void incReceivedControlBytes(uint32_t numBytes) { incStat(stats.receivedControlBytes, numBytes); }
+
+    void incSentPayloadBytes(uint32_t numBytes) { incStat(stats.sentPayloadBytes, numBytes); }
+
+    void incSentControlBytes(uint32_t numBytes) { incStat(stats.sentControlBytes, numBytes); }
+
+    void incSendQueueDropped() { incStat(stats.sendQueueDroppedNum); }
+
+    void incSendQueueExpired() { incStat(stats.sendQueueExpiredNum); }
+
+    void incSendQueueReplaced(uint32_t num) { incStat(stats.sendQueueReplacedNum, num); }
+
+    void incReceivedQueueDropped() { incStat(stats.receivedQueueDroppedNum); }
+
+    void incChannelBusy() { incStat(stats.channelBusyNum); }
+
+    void incFloodSuppressed() { incStat(stats.floodSuppressedNum); }
+
+    void incHopRetransmissions() { incStat(stats.hopRetransmissionsNum); }
+
+    void incHopAckLost() { incStat(stats.hopAckLostNum); }
+
+    void incNeighborsWithdrawn() { incStat(stats.neighborsWithdrawnNum); }
+
+    void incDatagramsIncomplete() { incStat(stats.datagramsIncompleteNum); }
+
+    void incFecRebuilt() { incStat(stats.fecRebuiltNum); }
+
+    void incPayloadAuthFailed() { incStat(stats.payloadAuthFailedNum); }
+
+    void incCompressionBytes(uint32_t inputBytes, uint32_t outputBytes) {
+        portENTER_CRITICAL(&statsMux);
+        stats.compressionInputBytes += inputBytes;
+        stats.compressionOutputBytes += outputBytes;
+        portEXIT_CRITICAL(&statsMux);
+    }
+
+    /**
+     * @brief Function that process the packets inside Received Packets
+     * Task executed every time that a packet arrive.
+     *
+     */
+    void processPackets();
+
+    /**
+     * @brief Process all the packets of the received packets rings, and the frames delayed by the link filter when they are due
+     *
+     */
+    void processStep();
+
+    /**
+     * @brief Process a packet copied out of a received packets ring
+     *
+     * @param rx Packet
+     * @param secondary If it has been received by the secondary radio
+     */
+    void processFrame(QueuePacket<Packet<uint8_t>>* rx, bool secondary);
+
+    /**
+     * @brief Give a data packet to the process worker of its source, see LoraMesherConfig::processWorkers
+     *
+     * @param rx Packet
+     * @return true If a worker processes it
+     */
+    bool dispatchToWorker(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Routine of a process worker, it processes the packets of its list
+     *
+     */
+    void processWorkerRoutine();
+
+    /**
+     * @brief Apply the link filter of its transmitter to the oldest frame of a received packets ring, see LinkFilterService.
+     * A dropped frame is released, else the SNR offset is added to its slot
+     *
+     * @param ring Received packets ring
+     * @param delay Output ms the frame waits before it is processed
+     * @return true If the frame has been dropped
+     */
+    bool filterLink(LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring, uint16_t& delay);
+
+    /**
+     * @brief Frame held by the delay of its link, processed by processStep when it is due
+     *
+     */
+    struct DelayedFrame {
+        QueuePacket<Packet<uint8_t>>* packet;
+        uint32_t dueAt;
+        bool secondary;
+    };
+
+    /**
+     * @brief Frames delayed by the link filter, oldest first. Only used by the task that processes the received packets
+     *
+     */
+    DelayedFrame delayedFrames[LM_LINK_FILTER_DELAYED] = {};
+    size_t delayedFramesLength = 0;
+
+    /**
+     * @brief Hold a frame by the delay of its link
+     *
+     * @param rx Packet
+     * @param secondary If it has been received by the secondary radio
+     * @param delay Ms
+     * @return true If it is held, false if the delay line is full and it has to be processed now
+     */
+    bool delayFrame(QueuePacket<Packet<uint8_t>>* rx, bool secondary, uint16_t delay);
+
+    /**
+     * @brief Process the delayed frames that are due
+     *
+     */
+    void processDelayedFrames();
+
+    /**
+     * @brief Get the ms until the next delayed frame is due
+     *
+     * @return uint32_t 0 if one is due, UINT32_MAX without delayed frames
+     */
+    uint32_t getDelayedFramesWait();
+
+    /**
+     * @brief Transmitter of a received frame, when the frame tells it: the source of a HELLO, an aggregate frame or a frame
+     * of the application and the via of a hop ACK. The data packets keep their source and the via is the next hop, so a data packet
+     * does not tell who forwarded it
+     *
+     * @param p Received frame
+     * @return uint16_t Address of the transmitter, 0 if unknown
+     */
+    uint16_t getTransmitter(Packet<uint8_t>* p);
+
+    /**
+     * @brief Keep the transmitter of a received frame alive, see getTransmitter
+     *
+     * @param p Received frame
+     * @param rssi RSSI of the frame
+     * @param snr SNR of the frame
+     */
+    void refreshTransmitter(Packet<uint8_t>* p, int16_t rssi, int8_t snr);
+
+    /**
+     * @brief Drop the oldest frame of a received packets ring if its header shows it is a data packet for another node.
+     * It is handled in the slot, without copying it out of the ring or processing it as a packet. The frames are kept
+     * while the simulator service records every frame
+     *
+     * @param ring Received packets ring
+     * @return true If the frame has been dropped
+     */
+    bool dropFrameNotForMe(LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring);
+
+    /**
+     * @brief Copy the oldest packet of a received packets ring into a new queue packet and release the slot
+     *
+     * @param ring Received packets ring
+     * @return QueuePacket<Packet<uint8_t>>* The queue packet or nullptr if empty or not allocated
+     */
+    QueuePacket<Packet<uint8_t>>* popReceivedPacket(LM_PacketRing<LM_RX_RING_SLOTS, UINT8_MAX>* ring);
+
+    /**
+     * @brief Delete the packet from memory
+     *
+     * @tparam T Type of packet
+     * @param p Packet to delete
+     */
+    template <typename T>
+    static void deletePacket(Packet<T>* p) {
+        PacketPoolService::release(p);
+    }
+
+    /**
+     * @brief Create a data packet with the payload and add it to the send queue
+     *
+     * @param dst Destination address
+     * @param payload Payload to send
+     * @param payloadSize Payload size to be send in Bytes
+     * @param priority Priority in the send queue, it gives the traffic class
+     * @param options Deadline and replace key of the packet
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
+     */
+    LM_EnqueueResult sendDataPacket(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, uint8_t priority, const LM_SendOptions& options) {
+        //Cannot send an empty packet
+        if (payloadSize == 0)
+            return ENQUEUE_INVALID;
+
+        ESP_LOGV(LM_TAG, "Creating a packet for send with %d bytes", payloadSize);
+
+        uint8_t* encoded = nullptr;
+        if (isPayloadEncoded()) {
+            encoded = encodePayload(payload, payloadSize, options.port);
+            if (encoded == nullptr)
+                return ENQUEUE_INVALID;
+            payload = encoded;
+        }
+
+        //Create a data packet with the payload
+        Packet<uint8_t>* dPacket = reinterpret_cast<Packet<uint8_t>*>(PacketService::createDataPacket(dst, getLocalAddress(), DATA_P, payload, payloadSize));
+        PacketPoolService::release(encoded);
+
+        if (dst != BROADCAST_ADDR && dst != LM_FLOOD_ADDRESS && !RoleService::isMulticastAddress(dst))
+            dPacket = HopTraceService::sample(dPacket);
+
+        //Create the packet and set it to the send queue
+        return setPackedForSend(dPacket, priority, &options);
+    }
+
+    /**
+     * @brief Create the queue packet of an entry of sendBatch, not yet in the send queue
+     *
+     * @param entry Packet to send
+     * @param result Output ENQUEUE_INVALID if it is not created
+     * @return QueuePacket<Packet<uint8_t>>* The queue packet or nullptr
+     */
+    QueuePacket<Packet<uint8_t>>* createBatchPacket(const LM_SendBatchEntry& entry, LM_EnqueueResult& result);
+
+    /**
+     * @brief Delete a packet dropped by the capacity of the send queue and count it
+     *
+     */
+    void dropFromSendQueue(QueuePacket<Packet<uint8_t>>* dropped);
+
+    /**
+     * @brief Notify the sender task, or the reactor, of the packets added to the send queue
+     *
+     */
+    void notifySender();
+
+    /**
+     * @brief Sets the packet in a Fifo with priority and will send the packet when needed.
+     * It takes the ownership of the packet, it is deleted if it is not added to the send queue.
+     *
+     * @param p packet<uint8_t>*
+     * @param priority Priority set DEFAULT_PRIORITY by default, a higher one is sent first, see LM_TrafficClass
+     * @param options Deadline and replace key of the packet, nullptr without them
+     * @return LM_EnqueueResult If the packet has been added to the send queue, see isEnqueued
+     */
+    LM_EnqueueResult setPackedForSend(Packet<uint8_t>* p, uint8_t priority, const LM_SendOptions* options = nullptr) {
+        if (!p) {
+            ESP_LOGE(LM_TAG, "setPackedForSend: Packet is null, cannot be sent");
+            return ENQUEUE_INVALID;
+        }
+
+        // Check for duplicate packet before adding to send queue
+        if (isDuplicatePacket(p)) {
+            ESP_LOGW(LM_TAG, "setPackedForSend: Duplicate packet detected, not adding to send queue");
+            deletePacket(p);
+            return ENQUEUE_DUPLICATE;
+        }
+
+        ESP_LOGI(LM_TAG, "Adding packet to Q_SP");
+        QueuePacket<Packet<uint8_t>>* send = PacketQueueService::createQueuePacket(p, priority);
+        ESP_LOGI(LM_TAG, "Created packet to Q_SP");
+
+        if (options != nullptr)
+            setSendOptions(send, *options);
+
+        return addToSendOrderedAndNotify(send);
+    }
+
+    /**
+     * @brief Set the deadline and the replace key of a local packet, and remove the older readings with the same key
+     *
+     * @param qp Queue packet not yet in the send queue
+     * @param options Options of the packet
+     */
+    void setSendOptions(QueuePacket<Packet<uint8_t>>* qp, const LM_SendOptions& options);
+
+    /**
+     * @brief Check if the deadline of a queued packet has passed
+     *
+     * @param qp Queue packet
+     * @return true If it should not be sent anymore
+     */
+    bool isExpired(QueuePacket<Packet<uint8_t>>* qp) {
+        return qp->deadline != 0 && (int32_t) (millis() - qp->deadline) > 0;
+    }
+
+    /**
+     * @brief Check if the packet is a duplicate of a packet queued or forwarded recently.
+     * Only packets from other nodes are checked, the local ones get their id when sent.
+     * @param p Packet to check
+     * @return true if the packet is a duplicate
+     * @return false if the packet is not a duplicate
+     */
+    bool isDuplicatePacket(Packet<uint8_t>* p);
+
+    /**
+     * @brief Get the copies of a packet received after the first one, see isDuplicatePacket
+     *
+     * @param p Packet
+     * @return uint8_t Copies, 0 if it has not been received or it has expired
+     */
+    uint8_t getDuplicateCopies(Packet<uint8_t>* p);
+
+    /**
+     * @brief Recently seen packets, used by isDuplicatePacket
+     *
+     */
+    LM_DuplicateCache<LM_DUPLICATE_CACHE_BITS>* duplicateCache = new LM_DuplicateCache<LM_DUPLICATE_CACHE_BITS>(LM_DUPLICATE_TIMEOUT * 1000);
+
+    /**
+     * @brief Add the Queue packet into the ToSendPackets and notify the SendData Task Handle.
+     * The send queue capacity and drop policy are applied, the packet dropped is deleted
+     *
+     * @param qp
+     * @return LM_EnqueueResult If the packet has been added
+     */
+    LM_EnqueueResult addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief Record the time the packet waited in the send queue, only the first time it is taken
+     *
+     * @param qp Queue packet taken from the send queue
+     * @return uint32_t Ms it has waited, 0 if it was recorded before
+     */
+    uint32_t recordSendQueueWait(QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief The send queue has been full since the room task was notified
+     *
+     */
+    bool sendQueueWasFull = false;
+
+    /**
+     * @brief Notify the send queue room task if the send queue was full and it has dropped to half of its capacity
+     *
+     */
+    void notifySendQueueRoom();
+
+    /**
+     * @brief Append a received packet to an application queue, applying the received queue capacity and drop policy
+     *
+     * @tparam Q Type of the queue, LM_LinkedList or LM_IntrusiveList
+     * @tparam T Type of the element
+     * @param queue Application queue
+     * @param element Element to be appended
+     * @return T* Element dropped, the new one or the oldest one, nullptr if none
+     */
+    template <typename Q, typename T>
+    T* appendReceivedBounded(Q* queue, T* element) {
+        size_t capacity = loraMesherConfig->receivedQueueCapacity;
+        T* dropped = nullptr;
+
+        queue->setInUse();
+
+        if (capacity > 0 && queue->getLength() >= capacity) {
+            if (loraMesherConfig->receivedQueueDropPolicy == DROP_POLICY_TAIL)
+                dropped = element;
+            else
+                dropped = queue->Pop();
+        }
+
+        if (dropped != element)
+            queue->Append(element);
+
+        queue->releaseInUse();
+
+        if (dropped != nullptr) {
+            ESP_LOGW(LM_TAG, "Received application queue full, packet dropped");
+            incReceivedQueueDropped();
+        }
+
+        return dropped;
+    }
+
+    /**
+     * @brief Notify the QueueManager_TaskHandle that a new sequence has been started
+     *
+     */
+    void notifyNewSequenceStarted();
+
+    /**
+     * @brief Process the data packet
+     *
+     * @param pq packet queue to be processed as data packet
+     */
+    void processDataPacket(QueuePacket<DataPacket>* pq);
+
+    /**
+     * @brief Process a received packet, it is deleted or kept by the upper layers
+     *
+     * @param rx Received packet
+     */
+    void processReceivedPacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Processing of the received packets of a type
+     *
+     */
+    typedef void (LoraMesher::*PacketProcessor)(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Processor of every packet type, built at begin and by registerPacketType, so a received packet is dispatched
+     * with one indexed call
+     *
+     */
+    PacketProcessor packetProcessors[256];
+
+    /**
+     * @brief Frame type of the application, see registerPacketType
+     *
+     */
+    struct CustomPacketType {
+        uint8_t type;
+        LM_PacketHandler handler;
+        void* context;
+    };
+
+    CustomPacketType customPacketTypes[LM_CUSTOM_PACKET_TYPES] = {};
+
+    /**
+     * @brief Build packetProcessors from the types of the library and the registered ones
+     *
+     */
+    void buildPacketProcessors();
+
+    /**
+     * @brief Process a received HELLO, it updates the routing table
+     *
+     * @param rx Received HELLO
+     */
+    void processHelloPacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Process a received data packet, see processDataPacket
+     *
+     * @param rx Received data packet
+     */
+    void processReceivedDataPacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Give a received frame of a type of the application to its handler
+     *
+     * @param rx Received frame
+     */
+    void processCustomPacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Delete a received packet of a type without processor
+     *
+     * @param rx Received packet
+     */
+    void processUnknownPacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Process a received request or reply of the route discovery, see RouteDiscoveryService
+     *
+     * @param rx Received frame
+     */
+    void processRouteDiscoveryPacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Relay a new route request, or answer it if the node is its target. It leaves the route to its origin
+     *
+     * @param transmitter Neighbor that sent the request
+     * @param request Request received
+     */
+    void processRouteRequest(uint16_t transmitter, RouteDiscoveryMessage& request);
+
+    /**
+     * @brief Forward a route reply to its origin, or release the held packets if the node is the origin. It leaves the
+     * route to its target
+     *
+     * @param transmitter Neighbor that sent the reply
+     * @param reply Reply received
+     */
+    void processRouteReply(uint16_t transmitter, RouteDiscoveryMessage& reply);
+
+    /**
+     * @brief Send a request or a reply of the route discovery
+     *
+     * @param type ROUTE_REQUEST_P or ROUTE_REPLY_P
+     * @param dst BROADCAST_ADDR for a request, the next hop to the origin for a reply
+     * @param message Message
+     */
+    void sendRouteDiscovery(uint8_t type, uint16_t dst, const RouteDiscoveryMessage& message);
+
+    /**
+     * @brief Split an aggregate frame and process every packet inside it as if it had been received alone
+     *
+     * @param rx Received aggregate frame
+     */
+    void processAggregatePacket(QueuePacket<Packet<uint8_t>>* rx);
+
+    /**
+     * @brief Take the time of the network, the TDMA slots, the congestion and the telemetry of a received HELLO,
+     * see LoraMesherConfig::timeSync, tdmaSlots, backpressure and telemetryInterval
+     *
+     * @param p HELLO
+     * @param receivedAt micros() of the receive interrupt
+     */
+    void processRouteTrailers(RoutePacket* p, uint32_t receivedAt);
+
+    /**
+     * @brief Process the data packet that destination is this node
+     *
+     * @param pq packet queue to be processed as data packet
+     */
+    void processDataPacketForMe(QueuePacket<DataPacket>* pq);
+
+    /**
+     * @brief If the application payloads are encoded, with compressPayloads or a payloadKey
+     *
+     */
+    bool isPayloadEncoded() {
+        return loraMesherConfig->compressPayloads || CryptoService::isEnabled() || loraMesherConfig->applicationPorts;
+    }
+
+    /**
+     * @brief Encode an application payload, after its port with applicationPorts, compressed with compressPayloads, see
+     * CompressionService, and then encrypted in place with a payloadKey, see CryptoService
+     *
+     * @param payload Payload
+     * @param payloadSize Payload size, set to the size of the encoded payload
+     * @param port Port of the application, only with applicationPorts
+     * @return uint8_t* Encoded payload, release it with PacketPoolService::release. nullptr if it could not be encoded
+     */
+    uint8_t* encodePayload(const uint8_t* payload, uint32_t& payloadSize, uint8_t port = 0);
+
+    /**
+     * @brief Bind a port to a task or a callback, see bindPort
+     *
+     * @return true If it has been bound
+     */
+    bool bindPort(uint8_t port, TaskHandle_t task, LM_ReceiveCallback callback, void* context);
+
+    /**
+     * @brief Find the slot of a port bound or unbound, the slots are never freed
+     *
+     * @param port Port
+     * @return PortBinding* nullptr if the port has never been bound
+     */
+    PortBinding* findPortBinding(uint8_t port);
+
+    /**
+     * @brief Take the port of a delivered payload, moving the payload over the port byte
+     *
+     * @param payload Payload
+     * @param payloadSize Payload size, the port byte is taken out
+     * @param port Output port
+     * @return true If the payload has a port
+     */
+    static bool takePort(uint8_t* payload, size_t& payloadSize, uint8_t& port);
+
+    /**
+     * @brief Returns if a port carries the messages of the library, see LM_PORT_OTA
+     *
+     */
+    static bool isLibraryPort(uint8_t port) { return port == LM_PORT_OTA || port == LM_PORT_METRICS; }
+
+    /**
+     * @brief Flood a payload on a port, see sendFlood
+     *
+     */
+    LM_EnqueueResult sendFlood(const uint8_t* payload, uint32_t payloadSize, uint8_t port);
+
+    /**
+     * @brief Send a datagram on a port, see sendDatagram
+     *
+     */
+    LM_EnqueueResult sendDatagram(uint16_t dst, const uint8_t* payload, uint32_t payloadSize, uint8_t port);
+
+    /**
+     * @brief Decrypt in place the payload of a received app packet with a payloadKey, see CryptoService
+     *
+     * @param src Source address
+     * @param payload Payload, with the counter and the tag
+     * @param payloadSize Payload size, set to the size of the decrypted payload
+     * @return true If the tag was right
+     */
+    bool decryptPayload(uint16_t src, uint8_t* payload, size_t& payloadSize);
+
+    /**
+     * @brief Decode the payload of a received app packet with compressPayloads, see CompressionService
+     *
+     * @param appPacket App packet, deleted if the payload is decoded into a new one or it is malformed
+     * @return AppPacket<uint8_t>* App packet with the decoded payload or nullptr if it is malformed
+     */
+    AppPacket<uint8_t>* decodeAppPacket(AppPacket<uint8_t>* appPacket);
+
+    /**
+     * @brief Notifies the ReceivedUserData_TaskHandle that a packet has been arrived
+     *
+     * @param appPq App packet
+     */
+    void notifyUserReceivedPacket(AppPacket<uint8_t>* appPq);
+
+    /**
+     * @brief Notifies the ReceivedUserData_TaskHandle that a packet view has been arrived
+     *
+     * @param view App packet view, the received data packet
+     */
+    void notifyUserReceivedPacket(AppPacketView<uint8_t>* view);
+
+    /**
+     * @brief Get the fields of a received packet for the application
+     *
+     */
+    static void getReceiveMetadata(AppPacket<uint8_t>* appPacket, LM_ReceiveMetadata& metadata);
+    static void getReceiveMetadata(AppPacketView<uint8_t>* view, LM_ReceiveMetadata& metadata);
+
+    /**
+     * @brief Start sending a packet through Lora, it does not wait until the packet is sent.
+     * The packet cannot be deleted until waitPacketSent returns
+     *
+     * @param p Packet to send
+     * @param frequency Frequency to send it, the radio waits before sending it tuned to it
+     * @param takenAt millis() when it was taken from the send queue, for its hop record if it is traced
+     * @return true the transmission has started
+     * @return false the transmission has not started
+     */
+    bool startSendPacket(Packet<uint8_t>* p, float frequency, uint32_t takenAt);
+
+    /**
+     * @brief Wait until the packet started by startSendPacket is sent and start receiving again
+     *
+     * @param p Packet being sent
+     * @return true has been send correctly
+     * @return false has not been send
+     */
+    bool waitPacketSent(Packet<uint8_t>* p);
+
+    /**
+     * @brief Start the transmission of a packet, after waiting before sending
+     *
+     * @param p Packet to send
+     * @return true the transmission has started
+     */
+    bool startTransmission(Packet<uint8_t>* p);
+
+    /**
+     * @brief Fill the TDMA slots and the congestion and stamp the time of the network in a HELLO with ROUTE_TDMA_F,
+     * ROUTE_CONGESTION_F or ROUTE_TIME_SYNC_F just before sending it
+     *
+     * @param p Packet to send
+     * @param length Length of the frame on air
+     * @return size_t Length of the trailers at the end of the packet, 0 if it does not have them
+     */
+    size_t stampRouteTrailers(Packet<uint8_t>* p, size_t length);
+
+    /**
+     * @brief Wait for a TDMA slot of the node to send a packet, see LoraMesherConfig::tdmaSlots
+     *
+     * @param p Packet to send
+     * @return true If it is sent now in a slot of the node, without backoff
+     */
+    bool waitTdmaSlot(Packet<uint8_t>* p);
+
+    /**
+     * @brief Finish the transmission and start receiving again on the home channel
+     *
+     * @param done If the transmission done has been received
+     * @return true has been send correctly
+     */
+    bool finishTransmission(bool done);
+
+    /**
+     * @brief Time to wait for the transmission done of a packet, twice its time on air and a margin
+     *
+     */
+    uint32_t getTransmissionTimeout(Packet<uint8_t>* p);
+
+    /**
+     * @brief Account a finished transmission. A packet not sent is queued again until MAX_RESEND_PACKET,
+     * otherwise it is deleted
+     *
+     * @param tx Packet
+     * @param hasSend If it has been sent
+     * @param resendMessage Times the packet has been queued again, reset when it is deleted
+     * @return uint32_t ms to wait before the next packet, for the duty cycle
+     */
+    uint32_t completeSend(QueuePacket<Packet<uint8_t>>* tx, bool hasSend, uint8_t& resendMessage);
+
+    /**
+     * @brief Pop the next packet to be sent and prepare it: set the id and the next hop
+     *
+     * @param sendId Id of the next packet originated by this node, incremented when used
+     * @return QueuePacket<Packet<uint8_t>>* Packet prepared or nullptr if there is no packet to be sent
+     */
+    QueuePacket<Packet<uint8_t>>* popAndPreparePacket(uint8_t& sendId);
+
+    /**
+     * @brief Move the data packets of the send queue with the same next hop into an aggregate frame with the given packet,
+     * with aggregateDataPackets, and the delayed ACKs to the same next hop, see LoraMesherConfig::delayedAck.
+     * The parts are prepared like the packet, the aggregate has the highest priority of them
+     *
+     * @param first Data packet already prepared and popped from the send queue
+     * @param nextHop Next hop of the packet
+     * @param sendId Id of the next packet originated by this node, incremented when used
+     * @return QueuePacket<Packet<uint8_t>>* The aggregate frame or the first packet if there is nothing to aggregate
+     */
+    QueuePacket<Packet<uint8_t>>* aggregatePackets(QueuePacket<Packet<uint8_t>>* first, uint16_t nextHop, uint8_t& sendId);
+
+    /**
+     * @brief Bytes used by a packet inside an aggregate frame, with its length byte
+     *
+     * @param p Packet
+     * @return size_t Length in bytes
+     */
+    static size_t getAggregatedLength(Packet<uint8_t>* p);
+
+    /**
+     * @brief Remove the packets of the send queue flow of a lost next hop.
+     * The packets with another route are moved to its flow, the others are deleted
+     *
+     * @param nextHop Next hop lost
+     */
+    void purgeSendFlow(uint16_t nextHop);
+
+    /**
+     * @brief Proccess that sends the data inside the FIFO
+     *
+     */
+    void sendPackets();
+
+    /**
+     * @brief Send a packet to start the sequence of the packets
+     *
+     * @param destination destination address
+     * @param seq_id Sequence Id
+     * @param num_packets Number of packets of the sequence
+     */
+    void sendStartSequencePackets(uint16_t destination, uint16_t seq_id, uint16_t num_packets);
+
+
+    /**
+     * @brief Get the Start Sequence Packet Queue object
+     *
+     * @param destination destination address
+     * @param seq_id Sequence Id
+     * @param num_packets Number of packets of the sequence
+     * @param fecGroup Packets protected by every parity packet, 0 without them
+     * @param lastSize Payload size of the last packet, sent with the fecGroup
+     * @return QueuePacket<ControlPacket>*
+     */
+    QueuePacket<ControlPacket>* getStartSequencePacketQueue(uint16_t destination, uint16_t seq_id, uint16_t num_packets, uint8_t fecGroup,
+        uint8_t lastSize);
+
+    /**
+     * @brief Sends an ACK packet to the destination
+     *
+     * @param destination destination address
+     * @param seq_id Id of the sequence
+     * @param seq_num Number of the ack
+     * @param sack Selective ACK bitmap, bit i set if the packet seq_num + 2 + i has been received. If 0 the ACK has no payload
+     */
+    void sendAckPacket(uint16_t destination, uint16_t seq_id, uint16_t seq_num, uint32_t sack = 0);
+
+    /**
+     * @brief Get the reliable window size of the configuration, between 1 and LM_SACK_BITS + 1
+     *
+     * @return uint8_t
+     */
+    uint8_t getReliableWindowSize();
+
+    /**
+     * @brief Send a lost packet
+     *
+     * @param destination destination address
+     * @param seq_id Id of the sequence
+     * @param seq_num Number of the lost packet
+     */
+    void sendLostPacket(uint16_t destination, uint16_t seq_id, uint16_t seq_num);
+
+    /**
+     * @brief Send an ACK or LOST packet, or keep it in a delayed ACK slot until a data packet to the same next hop takes it,
+     * see LoraMesherConfig::delayedAck
+     *
+     * @param cPacket ACK or LOST packet
+     * @param priority Priority in the send queue
+     */
+    void sendAckOrDelay(ControlPacket* cPacket, uint8_t priority);
+
+    /**
+     * @brief Keep an ACK or LOST packet in a delayed ACK slot, in the slot of the same ACK of the sequence if there is one
+     *
+     * @param cPacket ACK or LOST packet
+     * @param priority Priority in the send queue
+     * @return true If it has been kept, false if there is no free slot
+     */
+    bool delayAck(ControlPacket* cPacket, uint8_t priority);
+
+    /**
+     * @brief Take the delayed ACKs to a next hop that fit in an aggregate frame
+     *
+     * @param nextHop Next hop of the aggregate frame
+     * @param parts Parts of the aggregate, the ACKs are appended
+     * @param numOfParts Number of parts, updated
+     * @param aggregateSize Length of the aggregate frame, updated
+     */
+    void takeDelayedAcks(uint16_t nextHop, QueuePacket<Packet<uint8_t>>** parts, size_t& numOfParts, size_t& aggregateSize);
+
+    /**
+     * @brief Returns if a data packet to a next hop waits in the send queue
+     *
+     */
+    bool hasQueuedDataPacket(uint16_t nextHop);
+
+    /**
+     * @brief Send the delayed ACKs whose wait has passed in a frame of their own, unless a data packet to the same next hop
+     * waits in the send queue to take them
+     *
+     */
+    void managerDelayedAcks();
+
+    /**
+     * @brief Prints the header of the packet without the payload
+     *
+     * @param p packet to be printed
+     * @param title Title to print the header
+     */
+    void printHeaderPacket(Packet<uint8_t>* p, const char* title);
+
+    /**
+     * @brief Process a large payload packet, the payload is copied to its offset of the reassembly buffer.
+     * Packets received out of order are kept, the ACK is sent for the last consecutive packet received.
+     *
+     * @param pq PacketQueue packet queue to be processed, it is not kept
+     * @return true if processed correctly
+     * @return false if not processed correctly
+     */
+    bool processLargePayloadPacket(QueuePacket<ControlPacket>* pq);
+
+    /**
+     * @brief Process a received synchronization packet
+     *
+     * @param source Source Id
+     * @param seq_id Sequence Id
+     * @param seq_num Sequence number
+     * @param fecGroup Packets protected by every parity packet, 0 without them
+     * @param lastSize Payload size of the last packet, with the fecGroup
+     */
+    void processSyncPacket(uint16_t source, uint16_t seq_id, uint16_t seq_num, uint8_t fecGroup, uint8_t lastSize);
+
+
+    /**
+     * @brief Add the ack number to the respectively sequence and reset the timeout numbers
+     *
+     * @param source Source of the packet
+     * @param seq_id Sequence id of the packet
+     * @param seq_num Sequence number that has been Acknowledged
+     * @param sack Selective ACK bitmap received with the ACK
+     */
+    void addAck(uint16_t source, uint16_t seq_id, uint16_t seq_num, uint32_t sack = 0);
+
+    /**
+     * @brief Next sequence id to a destination, see getSequenceId
+     *
+     */
+    struct SequenceCounter {
+        uint16_t address = 0; //Destination, 0 if the slot is free
+        uint16_t next = 0;
+        uint32_t usedAt = 0;
+    };
+
+    /**
+     * @brief Sequence id counters of the last destinations, guarded by the Q_WSP mutex
+     *
+     */
+    SequenceCounter sequenceCounters[LM_SEQUENCE_COUNTERS];
+
+    /**
+     * @brief Get the Sequence Id for a new packet sequence to a destination. The ids of the sequences to the destination
+     * still inside the Q_WSP are skipped
+     *
+     * @param dst Destination
+     * @param seqId Output sequence id
+     * @return true If there is a free id and the destination is below maxSequencesPerDestination
+     */
+    bool getSequenceId(uint16_t dst, uint16_t& seqId);
+
+    /**
+     * @brief Manage all the packets inside the Q_WSP, checking for timeouts and erasing them if lost connection
+     *
+     */
+    void managerSendQueue();
+
+    /**
+     * @brief Manage all the packets inside the Q_WRP, checking for timeouts and erasing them if lost connection
+     *
+     */
+    void managerReceivedQueue();
+
+    /**
+     * @brief Used to set the configuration of the sequence of packets of the lists of packets
+     *
+     */
+    struct sequencePacketConfig {
+        //Identification is Sequence Id and Source address
+        uint16_t seq_id; //Sequence Id
+        uint16_t source; //Source Address
+
+        uint16_t number{ 0 }; //Number of packets of the sequence
+        uint8_t firstAckReceived{ 0 }; //If this value is set to 0, there has not been received any ack.
+        uint16_t lastAck{ 0 }; //Last ack received/send. 0 to n ACKs where n is the number of packets. 
+        unsigned long timeout{ 0 }; //Timeout of the sequence
+        unsigned long previousTimeout{ 0 }; //Previous timeout of the sequence
+        uint8_t numberOfTimeouts{ 0 }; //Number of timeouts that has been occurred
+        unsigned long calculatingRTT{ 0 }; // Calculating RTT
+        RouteNode* node; //Node of the routing table sequence
+        uint16_t sentNumber{ 0 }; //Highest packet number sent, windowed mode
+        uint16_t rttNumber{ 0 }; //Packet number timed by calculatingRTT, windowed mode
+        bool measuringRTT{ true }; //If calculatingRTT is timing the rttNumber, windowed mode
+        uint16_t retransmitNumber{ 0 }; //Last packet number retransmitted by a selective ACK, windowed mode
+        LM_TimerWheel* timers; //Timer wheel of the queue of the sequence
+        LM_Timer timer; //Timer of the timeout, the context is the listConfiguration
+
+        sequencePacketConfig(uint16_t seq_id, uint16_t source, uint16_t number, RouteNode* node, LM_TimerWheel* timers, void* context) :
+            seq_id(seq_id), source(source), number(number), node(node), timers(timers), timer(context) {};
+    };
+
+    /**
+     * @brief Stream opened by openStream. The chunk at the head is the one in flight
+     *
+     */
+    struct StreamConfig {
+        uint16_t destination = 0; //Destination, 0 if the slot is free
+        bool closing = false; //Closed by the application, the slot is freed when the chunks have been sent
+        bool sending = false; //The head chunk has a sequence in the Q_WSP
+        uint8_t* chunks[LM_STREAM_CHUNKS]; //Ring of the chunks waiting, bulk buffers
+        uint16_t chunkSizes[LM_STREAM_CHUNKS];
+        uint8_t firstChunk = 0;
+        uint8_t chunkCount = 0;
+        uint8_t chunkAttempts = 0; //Sequences of the head chunk not delivered
+        float congestionWindow = LM_STREAM_INITIAL_WINDOW; //Packets in flight allowed
+        float slowStartThreshold = LM_SACK_BITS + 1; //Below it the window grows one packet every ACK
+        uint32_t lastDecrease = 0; //millis() of the last decrease of the window
+    };
+
+    StreamConfig streams[LM_MAX_STREAMS];
+
+    /**
+     * @brief Guards the streams. The Q_WSP is never taken while it is held
+     *
+     */
+    portMUX_TYPE streamsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    /**
+     * @brief Get the stream of an id
+     *
+     * @param stream Id of the stream
+     * @return StreamConfig* nullptr if it is not a valid id
+     */
+    StreamConfig* getStream(uint8_t stream) {
+        return stream == 0 || stream > LM_MAX_STREAMS ? nullptr : &streams[stream - 1];
+    }
+
+    /**
+     * @brief Start a sequence with the head chunk of every stream without one in flight
+     *
+     * @return true If some chunk could not be started and has to be tried again
+     */
+    bool sendStreams();
+
+    /**
+     * @brief Store a packet without a route in the spool, see LoraMesherConfig::spoolPartition. Only the unicast data packets
+     * are stored
+     *
+     * @param qp Queue packet, it is not deleted
+     * @return true If it has been stored
+     */
+    bool spoolPacket(QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief Move the oldest packets of the spool to the send queue while their destination has a route
+     *
+     * @return true If packets are left in the spool
+     */
+    bool drainSpool();
+
+    /**
+     * @brief Flood the route requests that are due and move the held packets whose discovery finished to the send queue,
+     * see LoraMesherConfig::reactiveRoutes
+     *
+     * @return uint32_t Ms until the next request can be due, UINT32_MAX if there is none
+     */
+    uint32_t discoverRoutes();
+
+    /**
+     * @brief Move the held packets whose destination has a route to the send queue, and drop the ones whose discovery failed
+     *
+     */
+    void releaseHeldPackets();
+
+    /**
+     * @brief millis() of the last drain of the spool
+     *
+     */
+    uint32_t lastSpoolDrain = 0;
+
+    /**
+     * @brief Send the messages of the firmware update that are due, see LoraMesherConfig::otaPartition
+     *
+     * @return uint32_t Ms until the next one can be due, UINT32_MAX if there is none
+     */
+    uint32_t sendOta();
+
+    /**
+     * @brief Take a received message of the firmware update out of the application payloads, by its port
+     *
+     * @param src Address of the node that sent it
+     * @param port Port of the payload, LM_PORT_OTA for the update
+     * @param payload Payload, decrypted and decoded
+     * @param payloadSize Size of the payload
+     * @return true If it was a message of the update, processed when it is well formed
+     */
+    bool processOtaMessage(uint16_t src, uint8_t port, const uint8_t* payload, size_t payloadSize);
+
+    /**
+     * @brief Record the sample of the metrics history when it is due, see LoraMesherConfig::metricsInterval
+     *
+     * @return uint32_t Ms until the next sample, UINT32_MAX without the history
+     */
+    uint32_t recordMetrics();
+
+    /**
+     * @brief Take a received message of the metrics history out of the application payloads by its port, a request is
+     * answered
+     *
+     * @param src Address of the node that sent it
+     * @param port Port of the payload, LM_PORT_METRICS for the history
+     * @param payload Payload, decrypted and decoded
+     * @param payloadSize Size of the payload
+     * @return true If it was a message of the history, processed when it is well formed
+     */
+    bool processMetricsMessage(uint16_t src, uint8_t port, const uint8_t* payload, size_t payloadSize);
+
+    /**
+     * @brief Called when the sequence of the head chunk of a stream is deleted. The chunk is released if it has been
+     * delivered, otherwise it is started again up to LM_STREAM_CHUNK_ATTEMPTS times before all the chunks are dropped
+     * and the stream closed
+     *
+     * @param stream Stream of the sequence
+     * @param delivered If all the packets have been acknowledged
+     */
+    void endStreamSequence(StreamConfig* stream, bool delivered);
+
+    /**
+     * @brief Check if the packet being timed has taken longer than SRTT + 2 * RTTVAR, before updating them
+     *
+     * @param config Sequence
+     * @return true If the RTT sample is above the variance
+     */
+    bool isRTTAboveVariance(sequencePacketConfig* config);
+
+    /**
+     * @brief List configuration
+     *
+     */
+    struct listConfiguration {
+        sequencePacketConfig* config;
+        LM_LinkedList<QueuePacket<ControlPacket>>* list = nullptr; //Packets to be sent, only in the Q_WSP
+        AppPacket<uint8_t>* appPacket = nullptr; //Reassembly buffer allocated at the SYNC_P, only in the Q_WRP
+        uint8_t* receivedBitmap = nullptr; //Bit n - 1 set if the packet n has been received, only in the Q_WRP
+        uint32_t receivedPayloadSize = 0; //Payload bytes received, only in the Q_WRP
+        StreamConfig* stream = nullptr; //Stream of the chunk sent, only in the Q_WSP
+        uint8_t fecGroup = 0; //Packets protected by every parity packet, numbered after the last packet. 0 without them
+        uint8_t fecLastSize = 0; //Payload size of the last packet, only in the Q_WRP
+        uint8_t* fecParity = nullptr; //XOR of the parity and the packets received of every group, only in the Q_WRP
+        uint8_t* fecParityBitmap = nullptr; //Bit g set if the parity of the group g has been received, only in the Q_WRP
+        uint32_t memoryBytes = 0; //Bytes of the configuration, the list and the bitmaps, see MEMORY_SEQUENCES
+        LM_TransferHandle transfer = 0; //Transfer of the application completed when it ends, only in the Q_WSP
+        LM_ReadChunk readChunk = nullptr; //Source of the packets, the list has only the SYNC packet, only in the Q_WSP
+        void* readContext = nullptr; //Context of the readChunk
+        uint32_t payloadSize = 0; //Payload size of the readChunk
+    };
+
+    /**
+     * @brief Grow the congestion window of the stream of a sequence after an ACK that advances it
+     *
+     * @param listConfig Sequence
+     * @param queueing If the RTT sample shows the packets queueing on the route, the window is kept
+     */
+    void growStreamWindow(listConfiguration* listConfig, bool queueing);
+
+    /**
+     * @brief Shrink the congestion window of the stream of a sequence after a loss, halved once every SRTT
+     *
+     * @param listConfig Sequence
+     * @param timeout If it is a timeout, the window is set to one packet
+     */
+    void shrinkStreamWindow(listConfiguration* listConfig, bool timeout);
+
+    /**
+     * @brief Get the window of a sequence, the congestion window of its stream or the reliable window size
+     *
+     * @param listConfig Sequence
+     * @return uint8_t
+     */
+    uint8_t getSequenceWindow(listConfiguration* listConfig);
+
+    /**
+     * @brief Check if a sequence is sent with a window and selective ACKs instead of stop and wait
+     *
+     * @param listConfig Sequence
+     * @return true If it is windowed
+     */
+    bool isWindowedSequence(listConfiguration* listConfig);
+
+    /**
+     * @brief Rebuild the packet lost of a group from the XOR of the parity packet and the packets received
+     *
+     * @param listConfig Sequence of the Q_WRP
+     * @param group Group of fecGroup packets
+     * @return true If a packet has been rebuilt
+     */
+    bool rebuildFecGroup(listConfiguration* listConfig, uint16_t group);
+
+    enum QueueType {
+        WRP,
+        WSP
+    };
+
+    /**
+     * @brief Expire the timeouts of the sequences of the queue
+     *
+     * @param queue Q_WRP or Q_WSP
+     * @param timers Timer wheel of the queue
+     * @param type Type of the queue
+     */
+    void managerTimeouts(LM_LinkedList<listConfiguration>* queue, LM_TimerWheel* timers, QueueType type);
+
+    /**
+     * @brief Process the timeout of a sequence, the queue is taken
+     *
+     * @param queue Q_WRP or Q_WSP
+     * @param current List configuration of the sequence
+     * @param type Type of the queue
+     */
+    void processSequenceTimeout(LM_LinkedList<listConfiguration>* queue, listConfiguration* current, QueueType type);
+
+    /**
+     * @brief Actualize the RTT field
+     *
+     * @param config configuration to be actualized
+     */
+    void actualizeRTT(sequencePacketConfig* config);
+
+    /**
+     * @brief Send a packet of the sequence_id and sequence_num
+     *
+     * @param destination Destination to send the packet
+     * @param seq_id sequence_id of the packet
+     * @param seq_num number of the packet inside the sequence id
+     * @return true If has been send
+     * @return false If not
+     */
+    void processLostPacket(uint16_t destination, uint16_t seq_id, uint16_t seq_num);
+
+    /**
+     * @brief Send a packet of the sequence of the specific list configuration and sequence_num
+     *
+     * @param lstConfig List configuration
+     * @param seq_num number of the packet inside the sequence id
+     * @return LM_EnqueueResult If the packet has been added to the send queue, ENQUEUE_INVALID if the packet is not valid
+     */
+    LM_EnqueueResult sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num);
+
+    /**
+     * @brief Read a packet of a sequence from its source, see sendReliableStream. A parity packet reads its whole group
+     *
+     * @param lstConfig List configuration with a readChunk
+     * @param seq_num Number of the packet, not the SYNC packet
+     * @return Packet<uint8_t>* nullptr if it is out of range, it is not allocated or the source fails
+     */
+    Packet<uint8_t>* readSequencePacket(listConfiguration* lstConfig, uint16_t seq_num);
+
+    /**
+     * @brief Start a reliable sequence with the payload to a destination with a route
+     *
+     * @param dst Destination
+     * @param node Routing table node of the destination
+     * @param payload Payload, copied into the packets
+     * @param payloadSize Payload size in Bytes
+     * @param stream Stream of the payload, nullptr for sendReliablePacket
+     * @param fecGroup Packets protected by every parity packet, 0 without them
+     * @param transfer Transfer completed when the sequence ends, 0 without it
+     * @param readChunk Source of the packets, read when they are sent, instead of the payload. nullptr for the payload
+     * @param readContext Context of the readChunk
+     * @return LM_EnqueueResult If the sequence has been started, see isEnqueued
+     */
+    LM_EnqueueResult startSequence(uint16_t dst, RouteNode* node, uint8_t* payload, uint32_t payloadSize, StreamConfig* stream,
+        uint8_t fecGroup = 0, LM_TransferHandle transfer = 0, LM_ReadChunk readChunk = nullptr, void* readContext = nullptr);
+
+    /**
+     * @brief Get the Selective ACK bitmap of a received sequence
+     *
+     * @param listConfig list configuration inside the Q_WRP
+     * @return uint32_t bit i set if the packet lastAck + 2 + i has been received
+     */
+    uint32_t getSelectiveAck(listConfiguration* listConfig);
+
+    /**
+     * @brief Send the packets of the sequence that fit inside the window and have not been sent yet
+     *
+     * @param listConfig list configuration inside the Q_WSP
+     */
+    void sendSequenceWindow(listConfiguration* listConfig);
+
+    /**
+     * @brief Give the reassembly buffer of the list configuration to the user and clear the sequence
+     *
+     * @param listConfig list configuration with all the packets received
+     * @param last Last packet of the sequence, its reception metadata is given to the user
+     */
+    void joinPacketsAndNotifyUser(listConfiguration* listConfig, QueuePacket<ControlPacket>* last);
+
+    /**
+     * @brief Set the reception metadata of an app packet, the hops from the lock free routing table snapshot
+     *
+     * @param appPacket App packet, with the source set
+     * @param pq Queue packet of the last frame received
+     */
+    template <typename T>
+    void setAppPacketMetadata(AppPacket<uint8_t>* appPacket, QueuePacket<T>* pq) {
+        appPacket->rssi = (int8_t) pq->rssi;
+        appPacket->snr = (int8_t) pq->snr;
+        appPacket->rxTimestamp = pq->receivedAt;
+
+        RoutingTableSnapshot::Entry route;
+        if (RoutingTableService::getSnapshotRoute(appPacket->src, route)) {
+            appPacket->hopCount = route.networkNode.metric;
+            appPacket->previousHop = route.via;
+        }
+        else {
+            appPacket->hopCount = 0;
+            appPacket->previousHop = 0;
+        }
+    }
+
+    /**
+     * @brief If executed it will reset the number of timeouts to 0 and reset the timeout
+     *
+     * @param queue queue to be found the sequence
+     * @param seq_id sequence id
+     * @param source source address
+     */
+    void addTimeout(LM_LinkedList<listConfiguration>* queue, uint16_t seq_id, uint16_t source);
+
+    /**
+     * @brief If executed it will reset the number of timeouts to 0 and reset the timeout
+     *
+     * @param configPacket configuration packet to be modified
+     */
+    void resetTimeout(sequencePacketConfig* configPacket);
+
+    /**
+     * @brief Get the Maximum Timeout object
+     *
+     * @param configPacket configuration packet to be calculated
+     * @return unsigned long maximum timeout
+     */
+    unsigned long getMaximumTimeout(sequencePacketConfig* configPacket);
+
+    /**
+     * @brief Calculate the timeout of the sequence
+     *
+     * @param configPacket configuration packet to be calculated
+     * @return unsigned long timeout
+     */
+    unsigned long calculateTimeout(sequencePacketConfig* configPacket);
 
-    LM_LinkedList<QueuePacket<Packet<uint8_t>>>* ReceivedPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
+    /**
+     * @brief Adds the micros() + default timeout to the config packet
+     *
+     * @param configPacket config packet to be modified
+     */
+    void addTimeout(sequencePacketConfig* configPacket);
+
+    /**
+     * @brief Recalculate the timeout after a timeout
+     *
+     * @param configPacket config packet to be modified
+     */
+    void recalculateTimeoutAfterTimeout(sequencePacketConfig* configPacket);
+
+    /**
+     * @brief Clear the Linked List deleting all the elements inside
+     *
+     * @param list List to be cleared
+     */
+    void clearLinkedList(listConfiguration* listConfig);
+
+    /**
+     * @brief Find the listConfig element inside the queue and delete the element from the list
+     *
+     * @param queue Queue where to find and delete the element
+     * @param listConfig Element that needs to be found in the queue
+     */
+    void findAndClearLinkedList(LM_LinkedList<listConfiguration>* queue, listConfiguration* listConfig);
+
+    /**
+     * @brief With a sequence id and a linkedList, it will find the first sequence inside a queue that have the sequence id
+     *
+     * @param queue Queue to find the sequence id
+     * @param seq_id Sequence id to find
+     * @param source Source of the list
+     * @return listConfiguration*
+     */
+    listConfiguration* findSequenceList(LM_LinkedList<listConfiguration>* queue, uint16_t seq_id, uint16_t source);
+
+    /**
+     * @brief Index of the sequences of a queue by (source, seq_id)
+     *
+     */
+    typedef LM_AddressIndex<listConfiguration, LM_SEQUENCE_INDEX_BITS, uint32_t> SequenceIndex;
+
+    /**
+     * @brief Get the key of a sequence inside the SequenceIndex
+     *
+     * @param source Source of the list
+     * @param seq_id Sequence id
+     * @return uint32_t Key
+     */
+    static uint32_t getSequenceKey(uint16_t source, uint16_t seq_id) { return ((uint32_t) source << 16) | seq_id; }
+
+    /**
+     * @brief Get the SequenceIndex of the Q_WSP or the Q_WRP
+     *
+     * @param queue Q_WSP or Q_WRP
+     * @return SequenceIndex*
+     */
+    SequenceIndex* getSequenceIndex(LM_LinkedList<listConfiguration>* queue) { return queue == q_WSP ? wspIndex : wrpIndex; }
+
+    /**
+     * @brief Add the sequence to the queue and its index
+     *
+     * @param queue Q_WSP or Q_WRP
+     * @param listConfig List configuration of the sequence
+     * @return true If added
+     * @return false If the index is full, the sequence is not added
+     */
+    bool appendSequence(LM_LinkedList<listConfiguration>* queue, listConfiguration* listConfig);
+
+    /**
+     * @brief Delete the current sequence of the queue, from the queue and its index. The queue must be in use
+     *
+     * @param queue Q_WSP or Q_WRP
+     */
+    void deleteCurrentSequence(LM_LinkedList<listConfiguration>* queue);
 
-    LM_LinkedList<QueuePacket<Packet<uint8_t>>>* ToSendPackets = new LM_LinkedList<QueuePacket<Packet<uint8_t>>>();
+    /**
+     * @brief Queue Waiting Sending Packets (Q_WSP)
+     * List pairs (sequencePacketConfig defines the configuration of the following packets, id and number of packets,
+     * then there is another linked list with all the packets of the sequence)
+     *
+     */
+    LM_LinkedList<listConfiguration>* q_WSP = new LM_LinkedList<listConfiguration>();
 
     /**
-     * @brief RadioLib module
+     * @brief Queue Waiting Received Packet (Q_WRP)
      *
      */
-    LM_Module* radio = nullptr;
+    LM_LinkedList<listConfiguration>* q_WRP = new LM_LinkedList<listConfiguration>();
 
     /**
-     * @brief Hello task handle. It will send a hello packet every HELLO_PACKETS_DELAY s
+     * @brief Timers of the sequences inside the Q_WSP, expired with the Q_WSP taken
      *
      */
-    TaskHandle_t Hello_TaskHandle = nullptr;
+    LM_TimerWheel* wspTimers = new LM_TimerWheel();
 
     /**
-     * @brief Receive packets task handle. Every time a LoRa packet is detected it will create a packet,
-     *  store it into the received packets queue and notify the receive data task handle
+     * @brief Index of the Q_WSP by (destination, seq_id), guarded by the Q_WSP mutex
      *
      */
-    TaskHandle_t ReceivePacket_TaskHandle = nullptr;
+    SequenceIndex* wspIndex = new SequenceIndex();
 
     /**
-     * @brief Receive Data task handle. It will process all the packets inside the received packets queue.
-     * It will be notified by the ReceivePacket_TaskHandle
+     * @brief Index of the Q_WRP by (source, seq_id), guarded by the Q_WRP mutex
      *
      */
-    TaskHandle_t ReceiveData_TaskHandle = nullptr;
+    SequenceIndex* wrpIndex = new SequenceIndex();
 
     /**
-     * @brief Send data task handle. Every SEND_PACKETS_DELAY s it will get the packet from send packets queue,
-     * add the via if it is necessary and send it.
+     * @brief Timers of the sequences inside the Q_WRP, expired with the Q_WRP taken
      *
      */
-    TaskHandle_t SendData_TaskHandle = nullptr;
+    LM_TimerWheel* wrpTimers = new LM_TimerWheel();
 
     /**
-     * @brief Receive App data task handle. Every time that a packet is received and is for this node, this task will be notified.
-     * This task is implemented by the user.
+     * @brief Max time on air for a given configuration in ms
      *
      */
-    TaskHandle_t ReceiveAppData_TaskHandle = nullptr;
+    uint32_t maxTimeOnAir = 0;
 
     /**
-     * @brief Queue manager task handle. This task manages the queues inside LoRaMesher, checking for timeouts and resending messages.
+     * @brief Airtime budget of the send task, configured with the time on air. It is reconfigured from other tasks
      *
      */
-    TaskHandle_t QueueManager_TaskHandle = nullptr;
+    LM_AirtimeBudget airtimeBudget;
+    portMUX_TYPE airtimeBudgetMux = portMUX_INITIALIZER_UNLOCKED;
 
     /**
-     * @brief Routing table manager task handle. This manages the routing table, checking for timeouts and removing nodes.
+     * @brief Configure the airtime budget, the burst holds at least one packet of the max size over the control share
      *
      */
-    TaskHandle_t RoutingTableManager_TaskHandle = nullptr;
-
-    void initConfiguration();
-
-    static void onReceive(void);
-
-    void setDioActionsForScanChannel();
-
-    void setDioActionsForReceivePacket();
-
-    void clearDioActions();
-
-    int startReceiving();
+    void configureAirtimeBudget();
 
     /**
-     * @brief Scan activity channel
+     * @brief Start the TDMA slots of LoraMesherConfig::tdmaSlots, only with timeSync
      *
      */
-    void channelScan();
-
-    int startChannelScan();
-
-    void receivingRoutine();
-
-    void initializeLoRa();
-
-    void initializeSchedulers();
-
-    void sendHelloPacket();
-
-    void routingTableManager();
-
-    void queueManager();
+    void initTdma();
 
     /**
-     * @brief Region Monitoring variables
+     * @brief Wait until the airtime budget has the time on air of the packet and take it
      *
+     * @param tx Packet to be sent, its class is given by its priority
      */
-
-    uint32_t receivedDataPacketsNum = 0;
-    void incReceivedDataPackets() { receivedDataPacketsNum++; }
-
-    uint32_t sendPacketsNum = 0;
-    void incSendPackets() { sendPacketsNum++; }
-
-    uint32_t receivedHelloPacketsNum = 0;
-    void incRecHelloPackets() { receivedHelloPacketsNum++; }
-
-    uint32_t sentHelloPacketsNum = 0;
-    void incSentHelloPackets() { sentHelloPacketsNum++; }
-
-    uint32_t receivedBroadcastPacketsNum = 0;
-    void incReceivedBroadcast() { receivedBroadcastPacketsNum++; }
-
-    uint32_t forwardedPacketsNum = 0;
-    void incForwardedPackets() { forwardedPacketsNum++; }
-
-    uint32_t dataPacketForMeNum = 0;
-    void incDataPacketForMe() { dataPacketForMeNum++; }
-
-    uint32_t receivedIAmViaNum = 0;
-    void incReceivedIAmVia() { receivedIAmViaNum++; }
-
-    uint32_t sendPacketDestinyUnreachableNum = 0;
-    void incDestinyUnreachable() { sendPacketDestinyUnreachableNum++; }
-
-    uint32_t receivedPacketNotForMeNum = 0;
-    void incReceivedNotForMe() { receivedPacketNotForMeNum++; }
-
-    uint32_t receivedPayloadBytes = 0;
-    void incReceivedPayloadBytes(uint32_t numBytes) { receivedPayloadBytes += numBytes; }
-
-    uint32_t receivedControlBytes = 0;
-    void incReceivedControlBytes(uint32_t numBytes) { receivedControlBytes += numBytes; }
-
-    uint32_t sentPayloadBytes = 0;
-    void incSentPayloadBytes(uint32_t numBytes) { sentPayloadBytes += numBytes; }
-
-    uint32_t sentControlBytes = 0;
-    void incSentControlBytes(uint32_t numBytes) { sentControlBytes += numBytes; }
+    void waitAirtimeBudget(QueuePacket<Packet<uint8_t>>* tx);
 
     /**
-     * @brief Function that process the packets inside Received Packets
-     * Task executed every time that a packet arrive.
+     * @brief Take the time on air of the packet from the airtime budget if it has it
      *
+     * @param tx Packet to be sent, its class is given by its priority
+     * @return uint32_t 0 if it has been taken, otherwise ms until the budget has it
      */
-    void processPackets();
+    uint32_t takeAirtimeBudget(QueuePacket<Packet<uint8_t>>* tx);
 
     /**
-     * @brief Delete the packet from memory
+     * @brief Wait before sending function
      *
-     * @tparam T Type of packet
-     * @param p Packet to delete
+     * @param repeatedDetectPreambles Number of repeated detected preambles
      */
-    template <typename T>
-    static void deletePacket(Packet<T>* p) {
-        vPortFree(p);
-    }
+    void waitBeforeSend(uint8_t repeatedDetectPreambles);
 
     /**
-     * @brief Sets the packet in a Fifo with priority and will send the packet when needed.
+     * @brief Carrier sense before sending. A random backoff in a binary exponential contention window,
+     * followed by a CAD, until the channel is free or cadMaxAttempts are done
      *
-     * @param p packet<uint8_t>*
-     * @param priority Priority set DEFAULT_PRIORITY by default. 0 most priority
+     * @return true If the channel is free
+     * @return false If the channel has been busy in all the attempts
      */
-    void setPackedForSend(Packet<uint8_t>* p, uint8_t priority) {
-        if (!p) {
-            ESP_LOGE(LM_TAG, "setPackedForSend: Packet is null, cannot be sent");
-            return;
-        }
-
-        // Check for duplicate packet before adding to send queue
-        if (isDuplicatePacket(p)) {
-            ESP_LOGW(LM_TAG, "setPackedForSend: Duplicate packet detected, not adding to send queue");
-            return;
-        }
-
-        ESP_LOGI(LM_TAG, "Adding packet to Q_SP");
-        QueuePacket<Packet<uint8_t>>* send = PacketQueueService::createQueuePacket(p, priority);
-        ESP_LOGI(LM_TAG, "Created packet to Q_SP");
-        addToSendOrderedAndNotify(send);
-    }
+    bool listenBeforeTalk();
 
     /**
-     * @brief Check if the packet is a duplicate
-     * @param p Packet to check
-     * @return true if the packet is a duplicate
-     * @return false if the packet is not a duplicate
+     * @brief Output power the radio is configured with
+     *
      */
-    bool isDuplicatePacket(Packet<uint8_t>* p);
+    int8_t currentTxPower = LM_POWER;
 
     /**
-     * @brief Add the Queue packet into the ToSendPackets and notify the SendData Task Handle
+     * @brief Get the power to send a packet, reduced for the unicast packets to a neighbour with adaptiveLinkPower
      *
-     * @param qp
+     * @param p Packet to be sent
+     * @return int8_t Power in dBm
      */
-    void addToSendOrderedAndNotify(QueuePacket<Packet<uint8_t>>* qp);
+    int8_t getLinkPower(Packet<uint8_t>* p);
 
     /**
-     * @brief Notify the QueueManager_TaskHandle that a new sequence has been started
+     * @brief Set the radio output power for the packet, if it is different from the current one
      *
+     * @param p Packet to be sent
      */
-    void notifyNewSequenceStarted();
+    void setLinkPower(Packet<uint8_t>* p);
 
     /**
-     * @brief Process the data packet
+     * @brief Preamble length the radio is configured with
      *
-     * @param pq packet queue to be processed as data packet
      */
-    void processDataPacket(QueuePacket<DataPacket>* pq);
+    uint16_t currentPreambleLength = LM_PREAMBLE_LENGTH;
 
     /**
-     * @brief Process the data packet that destination is this node
+     * @brief Set the radio preamble length for the packet, longer if the receivers are sniffing
      *
-     * @param pq packet queue to be processed as data packet
+     * @param p Packet to be sent
      */
-    void processDataPacketForMe(QueuePacket<DataPacket>* pq);
+    void setLinkPreamble(Packet<uint8_t>* p);
 
     /**
-     * @brief Notifies the ReceivedUserData_TaskHandle that a packet has been arrived
+     * @brief Time on air of a frame with the current preamble length
      *
-     * @param appPq App packet
+     * @param length Length of the frame in bytes
+     * @return uint32_t Time in ms
      */
-    void notifyUserReceivedPacket(AppPacket<uint8_t>* appPq);
+    uint32_t getFrameTimeOnAirMs(size_t length) { return AirtimeService::getTimeOnAir(length, currentPreambleLength) / 1000; }
 
     /**
-     * @brief Send a packet through Lora
+     * @brief Frequency this node listens on when it is not sending, its home channel with a channel plan
      *
-     * @param p Packet to send
-     * @return true has been send correctly
-     * @return false has not been send
      */
-    bool sendPacket(Packet<uint8_t>* p);
+    float homeFrequency = LM_BAND;
 
     /**
-     * @brief Proccess that sends the data inside the FIFO
+     * @brief Frequency startReceiving tunes the radio to. The frequency of the next packet while it waits to be sent
      *
      */
-    void sendPackets();
+    float listenFrequency = LM_BAND;
 
     /**
-     * @brief Send a packet to start the sequence of the packets
+     * @brief Frequency the radio is tuned to
      *
-     * @param destination destination address
-     * @param seq_id Sequence Id
-     * @param num_packets Number of packets of the sequence
      */
-    void sendStartSequencePackets(uint16_t destination, uint8_t seq_id, uint16_t num_packets);
-
+    float currentFrequency = LM_BAND;
 
     /**
-     * @brief Get the Start Sequence Packet Queue object
+     * @brief Neighbour that receives a unicast packet
      *
-     * @param destination destination address
-     * @param seq_id Sequence Id
-     * @param num_packets Number of packets of the sequence
-     * @return QueuePacket<ControlPacket>*
+     * @param p Packet to be sent
+     * @return uint16_t Address of the next hop, 0 for the broadcasts and the packets without a next hop
      */
-    QueuePacket<ControlPacket>* getStartSequencePacketQueue(uint16_t destination, uint8_t seq_id, uint16_t num_packets);
+    uint16_t getTransmissionNextHop(Packet<uint8_t>* p);
 
     /**
-     * @brief Sends an ACK packet to the destination
+     * @brief Home channel frequency of a node in the channel plan
      *
-     * @param destination destination address
-     * @param seq_id Id of the sequence
-     * @param seq_num Number of the ack
+     * @param address Address of the node
+     * @return float Frequency in MHz, the configured frequency without a channel plan
      */
-    void sendAckPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num);
+    float getHomeFrequency(uint16_t address);
 
     /**
-     * @brief Send a lost packet
+     * @brief Frequency to send a packet, the home channel of the next hop or the channel of the broadcast copy
      *
-     * @param destination destination address
-     * @param seq_id Id of the sequence
-     * @param seq_num Number of the lost packet
+     * @param qp Queue packet to be sent
+     * @return float Frequency in MHz
      */
-    void sendLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num);
+    float getTransmissionFrequency(QueuePacket<Packet<uint8_t>>* qp);
 
     /**
-     * @brief Prints the header of the packet without the payload
+     * @brief Add to the send queue a copy of the broadcast for every other channel of the channel plan
      *
-     * @param p packet to be printed
-     * @param title Title to print the header
+     * @param qp Broadcast queue packet, it is sent on the first channel
      */
-    void printHeaderPacket(Packet<uint8_t>* p, String title);
+    void addBroadcastChannelCopies(QueuePacket<Packet<uint8_t>>* qp);
 
     /**
-     * @brief Process a large payload packet
+     * @brief Set the next hop of a multicast packet and add to the send queue a copy for every other next hop with
+     * members of the group behind it
      *
-     * @param pq PacketQueue packet queue to be processed
-     * @return true if processed correctly
-     * @return false if not processed correctly
+     * @param qp Multicast queue packet, it is sent to the first next hop
+     * @return true If there is at least one next hop
      */
-    bool processLargePayloadPacket(QueuePacket<ControlPacket>* pq);
+    bool addMulticastBranchCopies(QueuePacket<Packet<uint8_t>>* qp);
 
     /**
-     * @brief Process a received synchronization packet
+     * @brief Get the next hops of a multicast packet, the same packet is not sent back through its source
      *
-     * @param source Source Id
-     * @param seq_id Sequence Id
-     * @param seq_num Sequence number
+     * @param p Multicast packet
+     * @param nextHops Output next hops, LM_MULTICAST_MAX_BRANCHES at most
+     * @param hopsLeft Output hops left of the copy to every next hop
+     * @return size_t Number of next hops
      */
-    void processSyncPacket(uint16_t source, uint8_t seq_id, uint16_t seq_num);
+    size_t getMulticastNextHops(Packet<uint8_t>* p, uint16_t* nextHops, uint8_t* hopsLeft);
 
     /**
-     * @brief Add the ack number to the respectively sequence and reset the timeout numbers
+     * @brief Hops left of a multicast or flooded packet, the last byte of the payload. Every multicast copy gets the hops
+     * from its next hop to the farthest member behind it, so they decrease every hop and the copies cannot loop
      *
-     * @param source Source of the packet
-     * @param seq_id Sequence id of the packet
-     * @param seq_num Sequence number that has been Acknowledged
+     * @param p Multicast or flooded packet
+     * @return uint8_t& Hops left
      */
-    void addAck(uint16_t source, uint8_t seq_id, uint16_t seq_num);
+    uint8_t& getHopsLeft(Packet<uint8_t>* p);
 
     /**
-     * @brief Sequence Id, used to get the id of the packet sequence
+     * @brief Deliver and forward a multicast packet received as next hop, once. The branches can join again
      *
+     * @param pq Multicast packet
      */
-    uint8_t sequence_id = 0;
+    void processMulticastPacket(QueuePacket<DataPacket>* pq);
 
     /**
-     * @brief Get the Sequence Id for the packet sequence
+     * @brief Deliver a flooded packet once and queue its rebroadcast
      *
-     * @return uint8_t
+     * @param pq Flooded packet
      */
-    uint8_t getSequenceId();
+    void processFloodPacket(QueuePacket<DataPacket>* pq);
 
     /**
-     * @brief Manage all the packets inside the Q_WSP, checking for timeouts and erasing them if lost connection
+     * @brief Check if the rebroadcast of a flooded packet has to be suppressed, called after the backoff before sending it.
+     * The copies overheard since it was received are counted by the duplicates cache
      *
+     * @param p Packet to send
+     * @return true If floodRedundancy copies have been overheard
      */
-    void managerSendQueue();
+    bool isFloodSuppressed(Packet<uint8_t>* p);
 
     /**
-     * @brief Manage all the packets inside the Q_WRP, checking for timeouts and erasing them if lost connection
+     * @brief Data packet sent waiting for the ACK of its next hop, see LoraMesherConfig::hopAck
      *
      */
-    void managerReceivedQueue();
+    struct HopAckSlot {
+        QueuePacket<Packet<uint8_t>>* packet = nullptr; //Packet sent, nullptr if the slot is free
+        uint16_t dst = 0;
+        uint16_t src = 0;
+        uint16_t via = 0; //Next hop the packet was sent to
+        uint8_t id = 0;
+        uint32_t deadline = 0; //millis() when it is resent
+        LM_Timer timer; //Timer of the deadline, the context is the slot
+
+        HopAckSlot() : timer(this) {};
+    };
+
+    HopAckSlot hopAckSlots[LM_HOP_ACK_SLOTS];
 
     /**
-     * @brief Used to set the configuration of the sequence of packets of the lists of packets
+     * @brief Guards the packets of the hopAckSlots, the task that takes a packet out of its slot owns it
      *
      */
-    struct sequencePacketConfig {
-        //Identification is Sequence Id and Source address
-        uint8_t seq_id; //Sequence Id
-        uint16_t source; //Source Address
-
-        uint16_t number{ 0 }; //Number of packets of the sequence
-        uint8_t firstAckReceived{ 0 }; //If this value is set to 0, there has not been received any ack.
-        uint16_t lastAck{ 0 }; //Last ack received/send. 0 to n ACKs where n is the number of packets. 
-        unsigned long timeout{ 0 }; //Timeout of the sequence
-        unsigned long previousTimeout{ 0 }; //Previous timeout of the sequence
-        uint8_t numberOfTimeouts{ 0 }; //Number of timeouts that has been occurred
-        unsigned long calculatingRTT{ 0 }; // Calculating RTT
-        RouteNode* node; //Node of the routing table sequence
+    portMUX_TYPE hopAckMux = portMUX_INITIALIZER_UNLOCKED;
 
-        sequencePacketConfig(uint8_t seq_id, uint16_t source, uint16_t number, RouteNode* node) : seq_id(seq_id), source(source), number(number), node(node) {};
-    };
+    /**
+     * @brief Timers of the hopAckSlots, expired by the queue manager
+     *
+     */
+    LM_TimerWheel* hopAckTimers = new LM_TimerWheel();
 
     /**
-     * @brief List configuration
+     * @brief ACK or LOST packet waiting for a data packet to the same next hop, see LoraMesherConfig::delayedAck
      *
      */
-    struct listConfiguration {
-        sequencePacketConfig* config;
-        LM_LinkedList<QueuePacket<ControlPacket>>* list;
-    };
+    struct DelayedAckSlot {
+        QueuePacket<Packet<uint8_t>>* packet = nullptr; //Packet waiting, nullptr if the slot is free
+        uint32_t deadline = 0; //millis() when it is sent alone
+        LM_Timer timer; //Timer of the deadline, the context is the slot
 
-    enum QueueType {
-        WRP,
-        WSP
+        DelayedAckSlot() : timer(this) {};
     };
 
-    void managerTimeouts(LM_LinkedList<listConfiguration>* queue, QueueType type);
+    DelayedAckSlot delayedAckSlots[LM_DELAYED_ACK_SLOTS];
 
     /**
-     * @brief Actualize the RTT field
+     * @brief Guards the packets of the delayedAckSlots, the task that takes a packet out of its slot owns it
      *
-     * @param config configuration to be actualized
      */
-    void actualizeRTT(sequencePacketConfig* config);
+    portMUX_TYPE delayedAckMux = portMUX_INITIALIZER_UNLOCKED;
 
     /**
-     * @brief Send a packet of the sequence_id and sequence_num
+     * @brief Timers of the delayedAckSlots, expired by the queue manager
      *
-     * @param destination Destination to send the packet
-     * @param seq_id sequence_id of the packet
-     * @param seq_num number of the packet inside the sequence id
-     * @return true If has been send
-     * @return false If not
      */
-    void processLostPacket(uint16_t destination, uint8_t seq_id, uint16_t seq_num);
+    LM_TimerWheel* delayedAckTimers = new LM_TimerWheel();
 
     /**
-     * @brief Send a packet of the sequence of the specific list configuration and sequence_num
+     * @brief Datagram being joined from its fragments
      *
-     * @param lstConfig List configuration
-     * @param seq_num number of the packet inside the sequence id
-     * @return true If has been send
-     * @return false If not
      */
-    bool sendPacketSequence(listConfiguration* lstConfig, uint16_t seq_num);
+    struct FragmentSlot {
+        AppPacket<uint8_t>* appPacket = nullptr; //Reassembly buffer, nullptr if the slot is free
+        uint16_t src = 0;
+        uint8_t id = 0; //Datagram id, the seq_id of the fragments
+        uint8_t count = 0;
+        uint32_t received = 0; //Bit n set if the fragment n has been received
+        uint32_t deadline = 0; //millis() when it is discarded
+        LM_Timer timer; //Timer of the deadline, the context is the slot
+
+        FragmentSlot() : timer(this) {};
+    };
+
+    FragmentSlot fragmentSlots[LM_FRAGMENT_SLOTS];
 
     /**
-     * @brief Join all the packets inside the list configuration and notify the user
+     * @brief Guards the fragmentSlots
      *
-     * @param listConfig list configuration to join
      */
-    void joinPacketsAndNotifyUser(listConfiguration* listConfig);
+    portMUX_TYPE fragmentMux = portMUX_INITIALIZER_UNLOCKED;
 
     /**
-     * @brief If executed it will reset the number of timeouts to 0 and reset the timeout
+     * @brief Timers of the fragmentSlots, expired by the queue manager
      *
-     * @param queue queue to be found the sequence
-     * @param seq_id sequence id
-     * @param source source address
      */
-    void addTimeout(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source);
+    LM_TimerWheel* fragmentTimers = new LM_TimerWheel();
 
     /**
-     * @brief If executed it will reset the number of timeouts to 0 and reset the timeout
+     * @brief Datagram id of the next datagram sent
      *
-     * @param configPacket configuration packet to be modified
      */
-    void resetTimeout(sequencePacketConfig* configPacket);
+    uint8_t datagramId = 0;
 
     /**
-     * @brief Get the Maximum Timeout object
+     * @brief Number of a fragment, the index in the high byte and the count of fragments in the low byte
      *
-     * @param configPacket configuration packet to be calculated
-     * @return unsigned long maximum timeout
      */
-    unsigned long getMaximumTimeout(sequencePacketConfig* configPacket);
+    static uint16_t getFragmentNumber(uint8_t index, uint8_t count) { return (uint16_t) (index << 8) | count; }
 
     /**
-     * @brief Calculate the timeout of the sequence
+     * @brief Split the payload of a datagram in fragments and add them to the send queue
      *
-     * @param configPacket configuration packet to be calculated
-     * @return unsigned long timeout
+     * @param dst Destination address
+     * @param payload Payload, encoded with compressPayloads
+     * @param payloadSize Payload size in bytes
+     * @return LM_EnqueueResult If all the fragments have been added to the send queue, see isEnqueued
      */
-    unsigned long calculateTimeout(sequencePacketConfig* configPacket);
+    LM_EnqueueResult sendFragments(uint16_t dst, const uint8_t* payload, uint32_t payloadSize);
 
     /**
-     * @brief Adds the micros() + default timeout to the config packet
+     * @brief Copy a fragment to the reassembly buffer of its datagram and deliver it when all the fragments are received
      *
-     * @param configPacket config packet to be modified
+     * @param pq Fragment received, it is not kept
      */
-    void addTimeout(sequencePacketConfig* configPacket);
+    void processFragmentPacket(QueuePacket<ControlPacket>* pq);
 
     /**
-     * @brief Recalculate the timeout after a timeout
+     * @brief Discard the datagrams not completed before their deadline
      *
-     * @param configPacket config packet to be modified
      */
-    void recalculateTimeoutAfterTimeout(sequencePacketConfig* configPacket);
+    void managerFragments();
 
     /**
-     * @brief Clear the Linked List deleting all the elements inside
+     * @brief Check if a data packet is a hop ACK, the header of the acknowledged packet without payload
      *
-     * @param list List to be cleared
+     * @param p Packet
+     * @return true If it is a hop ACK
      */
-    void clearLinkedList(listConfiguration* listConfig);
+    bool isHopAckPacket(Packet<uint8_t>* p) {
+        return PacketService::isOnlyDataPacket(p->type) && p->packetSize == sizeof(DataPacket);
+    }
 
     /**
-     * @brief Find the listConfig element inside the queue and delete the element from the list
+     * @brief Check if a data packet is sent to one next hop and acknowledged by it with hopAck
      *
-     * @param queue Queue where to find and delete the element
-     * @param listConfig Element that needs to be found in the queue
+     * @param p Packet
+     * @return true If the next hop acknowledges it
      */
-    void findAndClearLinkedList(LM_LinkedList<listConfiguration>* queue, listConfiguration* listConfig);
+    bool needsHopAck(Packet<uint8_t>* p);
 
     /**
-     * @brief With a sequence id and a linkedList, it will find the first sequence inside a queue that have the sequence id
+     * @brief Keep a sent data packet in a free slot until its next hop acknowledges it or the timeout resends it
      *
-     * @param queue Queue to find the sequence id
-     * @param seq_id Sequence id to find
-     * @param source Source of the list
-     * @return listConfiguration*
+     * @param tx Packet sent
+     * @return true If it has been kept, false if it has to be deleted
      */
-    listConfiguration* findSequenceList(LM_LinkedList<listConfiguration>* queue, uint8_t seq_id, uint16_t source);
+    bool waitHopAck(QueuePacket<Packet<uint8_t>>* tx);
 
     /**
-     * @brief Queue Waiting Sending Packets (Q_WSP)
-     * List pairs (sequencePacketConfig defines the configuration of the following packets, id and number of packets,
-     * then there is another linked list with all the packets of the sequence)
+     * @brief Release the packet waiting for an ACK that a received data packet acknowledges. The next hop acknowledges
+     * it by forwarding it to another via, or by the hop ACK of the destination, with its own address as via
      *
+     * @param p Data packet received
      */
-    LM_LinkedList<listConfiguration>* q_WSP = new LM_LinkedList<listConfiguration>();
+    void processHopAck(DataPacket* p);
 
     /**
-     * @brief Queue Waiting Received Packet (Q_WRP)
+     * @brief Send the hop ACK of a data packet received as next hop, when it is the destination, the packet is a retransmission
+     * of a packet already received or other packets are queued before its forward. The duplicates are deleted
      *
+     * @param pq Data packet received as next hop or as destination
+     * @return true If it was a duplicate, it has been deleted
      */
-    LM_LinkedList<listConfiguration>* q_WRP = new LM_LinkedList<listConfiguration>();
+    bool acknowledgeHop(QueuePacket<DataPacket>* pq);
 
     /**
-     * @brief Max time on air for a given configuration in ms
+     * @brief Resend the packets whose ACK timeout has been reached, or delete them after hopAckRetries retransmissions
      *
      */
-    uint32_t maxTimeOnAir = 0;
+    void managerHopAcks();
 
     /**
-     * @brief Wait before sending function
+     * @brief Get a random backoff time of the contention window of the attempt
      *
-     * @param repeatedDetectPreambles Number of repeated detected preambles
+     * @param attempt Number of the attempt, starting at 0
+     * @return uint32_t Backoff time in ms
      */
-    void waitBeforeSend(uint8_t repeatedDetectPreambles);
+    uint32_t getBackoffTime(uint8_t attempt);
 
     /**
      * @brief Max propagation time for a given configuration in ms
@@ -1053,7 +4292,8 @@ private:
     uint32_t getPropagationTimeWithRandom(uint8_t multiplayer);
 
     /**
-     * @brief Max Time on air for a given configuration, Used for time slots
+     * @brief Rebuild the time on air table of the AirtimeService and the max time on air, used for time slots.
+     * Called every time the spreading factor, bandwidth or coding rate change
      *
      */
     void recalculateMaxTimeOnAir();
@@ -1088,36 +4328,6 @@ private:
      */
     void removeNodeFromQSPandQWP(uint16_t address);
 
-#ifdef LM_TESTING
-    /**
-     * @brief Returns if the packet can be received. Only for testing
-     *
-     * @param source The source of the packet
-     * @return true The packet can be received
-     * @return false The packet will be dropped
-     */
-    bool canReceivePacket(uint16_t source);
-
-    /**
-     * @brief Returns if is a data packet and the via is the local address. Only for testing
-     *
-     * @param packet Packet to be checked
-     * @param localAddress Local address
-     * @return true Is a data packet and the via is the local address
-     */
-    bool isDataPacketAndLocal(DataPacket* packet, uint16_t localAddress);
-
-    /**
-     * @brief Returns if the packet should be processed. Only for testing
-     *
-     * @param packet Packet to be checked
-     * @return true
-     * @return false
-     */
-    bool shouldProcessPacket(Packet<uint8_t>* packet);
-
-#endif
-
 
 public:
 
@@ -1143,7 +4353,7 @@ public:
      * @return true
      * @return false
      */
-    bool hasActiveConnections() { return hasActiveReceivedConnections() || hasActiveSentConnections() || ToSendPackets->getLength() > 0 || ReceivedPackets->getLength() > 0; };
+    bool hasActiveConnections() { return hasActiveReceivedConnections() || hasActiveSentConnections() || ToSendPackets->getLength() > 0 || getReceivedRingLength() > 0; };
 
     /**
      * @brief Returns the number of packets inside the waiting send packets queue
@@ -3,6 +3,8 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
 /**
  * @brief Application packet, it is used to send the packet to the application layer
  *
@@ -29,6 +31,49 @@ public:
      */
     uint32_t payloadSize = 0;
 
+    /**
+     * @brief RSSI in dBm of the frame received from the previous hop
+     *
+     */
+    int8_t rssi = 0;
+
+    /**
+     * @brief SNR in dB of the frame received from the previous hop
+     *
+     */
+    int8_t snr = 0;
+
+    /**
+     * @brief Number of hops to the source in the routing table, 0 if the source is not in it
+     *
+     */
+    uint8_t hopCount = 0;
+
+    /**
+     * @brief Next hop to the source in the routing table, the neighbour the packet is expected from. 0 if the source is not in it
+     *
+     */
+    uint16_t previousHop = 0;
+
+    /**
+     * @brief micros() when the receive interrupt of the frame fired, of the last frame for large payloads
+     *
+     */
+    uint32_t rxTimestamp = 0;
+
+    /**
+     * @brief Port of the application with LoraMesherConfig::applicationPorts, 0 without them
+     *
+     */
+    uint8_t port = 0;
+
+    /**
+     * @brief Links of the received application packets queue, a LM_IntrusiveList
+     *
+     */
+    AppPacket<T>* listPrev = nullptr;
+    AppPacket<T>* listNext = nullptr;
+
     /**
      * @brief Payload Array
      *
@@ -51,8 +96,29 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting app packet");
-        vPortFree(p);
+        PacketPoolService::release(p);
     }
 };
 
-#endif
\ No newline at end of file
+/**
+ * @brief Fields of a packet received with LoraMesher::receiveInto, the ones of AppPacket. The packets of the zeroCopyReceive
+ * views have no reception fields, they are 0
+ *
+ */
+struct LM_ReceiveMetadata {
+    uint16_t dst = 0;
+    uint16_t src = 0;
+    // Bytes of the payload received, and copied to the buffer of the caller. Less are copied if it does not fit
+    uint32_t payloadSize = 0;
+    uint32_t copiedSize = 0;
+    int8_t rssi = 0;
+    int8_t snr = 0;
+    uint8_t hopCount = 0;
+    uint16_t previousHop = 0;
+    uint32_t rxTimestamp = 0;
+    uint8_t port = 0;
+
+    bool isTruncated() const { return copiedSize < payloadSize; }
+};
+
+#endif
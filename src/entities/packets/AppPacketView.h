@@ -0,0 +1,53 @@
+#ifndef _LORAMESHER_APP_PACKET_VIEW_H
+#define _LORAMESHER_APP_PACKET_VIEW_H
+
+#include "RouteDataPacket.h"
+
+#include "BuildOptions.h"
+
+#include "services/PacketPoolService.h"
+
+/**
+ * @brief Zero copy view of a received data packet, it is the received buffer itself.
+ * It gives the header fields of the packet and the payload without copying it into an AppPacket.
+ * The payload starts at byte 9 of the buffer, it is not aligned. If T needs alignment copy it with memcpy.
+ *
+ * @tparam T Payload type
+ */
+#pragma pack(1)
+template <class T>
+class AppPacketView final: public RouteDataPacket {
+public:
+    /**
+     * @brief Payload Array
+     *
+     */
+    T payload[];
+
+    /**
+     * @brief Get the payload size in bytes
+     *
+     * @return size_t
+     */
+    size_t getPayloadSize() { return this->packetSize - sizeof(RouteDataPacket); }
+
+    /**
+     * @brief Get the payload length in number of T
+     *
+     * @return size_t size in number of T
+     */
+    size_t getPayloadLength() { return getPayloadSize() / sizeof(T); }
+
+    /**
+     * @brief Delete function for AppPacketViews
+     *
+     * @param p AppPacketView to be deleted
+     */
+    void operator delete(void* p) {
+        ESP_LOGV(LM_TAG, "Deleting app packet view");
+        PacketPoolService::release(p);
+    }
+};
+#pragma pack()
+
+#endif
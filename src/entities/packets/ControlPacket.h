@@ -5,10 +5,12 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
 #pragma pack(1)
 class ControlPacket final: public RouteDataPacket {
 public:
-    uint8_t seq_id = 0;
+    uint16_t seq_id = 0;
     uint16_t number = 0;
     uint8_t payload[];
 
@@ -28,7 +30,7 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting Control packet");
-        vPortFree(p);
+        PacketPoolService::release(p);
     }
 };
 #pragma pack()
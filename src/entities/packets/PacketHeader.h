@@ -3,6 +3,8 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
 #pragma pack(1)
 class PacketHeader {
 public:
@@ -13,6 +15,15 @@ public:
     uint8_t id;
     uint8_t packetSize = 0;
 
+    /**
+     * @brief New function for Packets, the packets created with new are released like the others
+     *
+     * @param size Size of the packet
+     */
+    void* operator new(size_t size) {
+        return PacketPoolService::allocate(size);
+    }
+
     /**
      * @brief Delete function for Packets
      *
@@ -20,7 +31,7 @@ public:
      */
     void operator delete(void* p) {
         ESP_LOGV(LM_TAG, "Deleting Header packet");
-        vPortFree(p);
+        PacketPoolService::release(p);
     }
 
 };
@@ -3,6 +3,8 @@
 
 #include "BuildOptions.h"
 
+#include "services/PacketPoolService.h"
+
 template <typename T>
 class QueuePacket {
 public:
@@ -10,7 +12,46 @@ public:
     uint8_t priority = 0;
     float rssi = 0;
     float snr = 0;
+    // millis() when it was added to the send queue, 0 once the wait has been recorded
+    uint32_t enqueuedAt = 0;
+    // Channel of the channel plan of a broadcast copy, starting at 1. 0 until the copies of the other channels are created
+    uint8_t channel = 0;
+    // Next hop of a multicast copy, starting at 1. 0 until the copies to the other next hops are created
+    uint8_t branch = 0;
+    // Copy of a HELLO sent on the backbone, see LoraMesherConfig::secondaryPacketType
+    bool backbone = false;
+    // Retransmissions of a packet not acknowledged by its next hop, see LoraMesherConfig::hopAck
+    uint8_t hopAttempts = 0;
+    // millis() after which it is not sent anymore, 0 without deadline, see LM_SendOptions
+    uint32_t deadline = 0;
+    // Key of the application reading, a newer reading with the same key and destination replaces it. 0 without key
+    uint16_t replaceKey = 0;
+    // micros() when the receive interrupt of the frame fired, 0 for the packets not received
+    uint32_t receivedAt = 0;
     T* packet;
+    // Links of the send queue, a LM_PriorityQueue
+    QueuePacket<T>* queueNext = nullptr;
+    uint32_t queueOrder = 0;
+    uint8_t queueFlow = 0;
+    uint16_t queueKey = 0;
+
+    /**
+     * @brief New function for Queue Packets, allocated from the packet pool
+     *
+     * @param size Size of the queue packet
+     */
+    void* operator new(size_t size) {
+        return PacketPoolService::allocate(size);
+    }
+
+    /**
+     * @brief Delete function for Queue Packets
+     *
+     * @param p Queue packet to be deleted
+     */
+    void operator delete(void* p) {
+        PacketPoolService::release(p);
+    }
 };
 
 #endif
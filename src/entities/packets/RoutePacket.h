@@ -5,6 +5,115 @@
 #include "entities/routingTable/NetworkNode.h"
 
 #pragma pack(1)
+/**
+ * @brief Time of the network at the end of a HELLO, after its network nodes when it has ROUTE_TIME_SYNC_F, see TimeSyncService
+ *
+ */
+struct TimeSyncTrailer {
+    // Gateway of the clock, 0 if the HELLO has not been stamped
+    uint16_t root;
+    // Synchronization round of the root
+    uint8_t sequence;
+    // Hops from the root
+    uint8_t level;
+    // Time of the root when the frame ends, ms and us of the ms
+    uint32_t timeMs;
+    uint16_t timeUs;
+};
+
+/**
+ * @brief Congestion of the source of a HELLO in percent, after its TdmaTrailer when it has ROUTE_CONGESTION_F,
+ * see LoraMesherConfig::backpressure
+ *
+ */
+struct CongestionTrailer {
+    // Fill of the send queue
+    uint8_t queue;
+    // Airtime budget left, 100 without a budget
+    uint8_t airtime;
+    // Highest congestion from the source to its best gateway, the source included
+    uint8_t path;
+};
+
+/**
+ * @brief Health of a node, see LoraMesherConfig::telemetryInterval. The counters wrap
+ *
+ */
+struct TelemetryRecord {
+    // Node of the record, 0 if the trailer is empty
+    uint16_t address;
+    // Records of the node, a newer one replaces the older
+    uint8_t sequence;
+    // Seconds since the boot
+    uint32_t uptime;
+    // Packets sent, forwarded and without a route to their destination
+    uint16_t sent;
+    uint16_t forwarded;
+    uint16_t unreachable;
+    // Free heap in KB
+    uint16_t freeHeap;
+    // Packets of the send queue and of the received queue
+    uint8_t sendQueue;
+    uint8_t receivedQueue;
+    // Airtime since the previous record, in hundredths of percent
+    uint16_t dutyCycle;
+};
+
+/**
+ * @brief Telemetry record carried by a HELLO, after its CongestionTrailer when it has ROUTE_TELEMETRY_F, see TelemetryService
+ *
+ */
+struct TelemetryTrailer {
+    // Hops from the source of the HELLO to its best gateway, the records go to the nodes closer to a gateway
+    uint8_t gatewayHops;
+    // Record of the source or of a node behind it
+    TelemetryRecord record;
+};
+
+/**
+ * @brief Sniff mode of the source of a HELLO, right after its network nodes when it has ROUTE_CAP_SNIFF,
+ * see LoraMesherConfig::sniffPreambleLength
+ *
+ */
+struct SniffTrailer {
+    // Preamble length in symbols of the frames to the source
+    uint16_t preambleLength;
+};
+
+/**
+ * @brief SNR at which the source of a HELLO receives the route packets of a neighbour
+ *
+ */
+struct LinkSnrReport {
+    // Neighbour, 0 if the report is empty
+    uint16_t address;
+    // Lowest SNR in dB of its last route packets
+    int8_t snr;
+};
+
+/**
+ * @brief SNR of some neighbours of the source of a HELLO, after its SniffTrailer when it has ROUTE_CAP_LINK_SNR,
+ * see LoraMesherConfig::adaptiveLinkPower
+ *
+ */
+struct LinkSnrTrailer {
+    LinkSnrReport reports[LM_LINK_SNR_REPORTS];
+};
+
+/**
+ * @brief TDMA slots around the source of a HELLO, after its network nodes when it has ROUTE_TDMA_F, see TdmaService.
+ * Bit n is the slot n of the frame
+ *
+ */
+struct TdmaTrailer {
+    // Slots of the source
+    uint32_t own;
+    // Slots of the neighbors of the source, the two hop neighbors of the receivers
+    uint32_t used;
+    // Slots owned by more than one node around the source, their owners move
+    uint32_t conflicts;
+};
+
 class RoutePacket final: public PacketHeader {
 public:
 
@@ -21,7 +130,30 @@ public:
     uint8_t gatewayLoad = 255;
 
     /**
-     * @brief Network nodes
+     * @brief Route flags, ROUTE_DELTA_F if only the changed nodes are inside the packet
+     * and ROUTE_REQUEST_FULL_F to ask the neighbors for a full advertisement.
+     * ROUTE_COMPACT_F if the network nodes are encoded with the LM_CompactNodeCodec,
+     * ROUTE_TDMA_F if a TdmaTrailer follows them, ROUTE_CONGESTION_F if a CongestionTrailer follows, ROUTE_TELEMETRY_F if
+     * a TelemetryTrailer follows and ROUTE_TIME_SYNC_F if a TimeSyncTrailer ends the packet. A SniffTrailer goes before them
+     * when the capabilities have ROUTE_CAP_SNIFF, then a LinkSnrTrailer when they have ROUTE_CAP_LINK_SNR
+     *
+     */
+    uint8_t routeFlags = 0;
+
+    /**
+     * @brief Version of the routing table of the source, the same for all the packets of an advertisement
+     *
+     */
+    uint8_t tableVersion = 0;
+
+    /**
+     * @brief Capabilities of the source, ROUTE_CAP_SNIFF and ROUTE_CAP_LINK_SNR
+     *
+     */
+    uint8_t capabilities = 0;
+
+    /**
+     * @brief Network nodes. In a delta advertisement a node with metric 0 is a removed route
      *
      */
     NetworkNode networkNodes[];
@@ -29,9 +161,113 @@ public:
     /**
      * @brief Get the Number of Network Nodes
      *
-     * @return size_t Number of Network Nodes inside the packet
+     * @return size_t Number of Network Nodes inside the packet, only for packets without ROUTE_COMPACT_F
+     */
+    size_t getNetworkNodesSize() { return getNetworkNodesLength() / sizeof(NetworkNode); }
+
+    /**
+     * @brief Get the size in bytes of the network nodes
+     *
+     * @return size_t
+     */
+    size_t getNetworkNodesLength() { return this->packetSize - sizeof(RoutePacket) - getTrailerLength(); }
+
+    /**
+     * @brief Get the size in bytes after the network nodes
+     *
+     * @return size_t
+     */
+    size_t getTrailerLength() { return getTrailerLength(routeFlags, capabilities); }
+
+    /**
+     * @brief Get the size in bytes of the trailers of the route flags
+     *
+     * @param routeFlags Route flags
+     * @param capabilities Capabilities, with ROUTE_CAP_SNIFF the SniffTrailer is added and with ROUTE_CAP_LINK_SNR the
+     * LinkSnrTrailer
+     * @return size_t
+     */
+    static size_t getTrailerLength(uint8_t routeFlags, uint8_t capabilities = 0) {
+        return ((capabilities & ROUTE_CAP_SNIFF) ? sizeof(SniffTrailer) : 0) +
+            ((capabilities & ROUTE_CAP_LINK_SNR) ? sizeof(LinkSnrTrailer) : 0) +
+            ((routeFlags & ROUTE_TDMA_F) ? sizeof(TdmaTrailer) : 0) + ((routeFlags & ROUTE_CONGESTION_F) ? sizeof(CongestionTrailer) : 0) +
+            ((routeFlags & ROUTE_TELEMETRY_F) ? sizeof(TelemetryTrailer) : 0) + ((routeFlags & ROUTE_TIME_SYNC_F) ? sizeof(TimeSyncTrailer) : 0);
+    }
+
+    /**
+     * @brief Get the sniff trailer
+     *
+     * @return SniffTrailer* Trailer or nullptr if the packet does not have it
      */
-    size_t getNetworkNodesSize() { return (this->packetSize - sizeof(RoutePacket)) / sizeof(NetworkNode); }
+    SniffTrailer* getSniff() {
+        if ((capabilities & ROUTE_CAP_SNIFF) == 0 || this->packetSize < sizeof(RoutePacket) + getTrailerLength())
+            return nullptr;
+
+        return reinterpret_cast<SniffTrailer*>(reinterpret_cast<uint8_t*>(this) + this->packetSize - getTrailerLength());
+    }
+
+    /**
+     * @brief Get the link SNR trailer
+     *
+     * @return LinkSnrTrailer* Trailer or nullptr if the packet does not have it
+     */
+    LinkSnrTrailer* getLinkSnr() {
+        if ((capabilities & ROUTE_CAP_LINK_SNR) == 0 || this->packetSize < sizeof(RoutePacket) + getTrailerLength())
+            return nullptr;
+
+        size_t before = (capabilities & ROUTE_CAP_SNIFF) ? sizeof(SniffTrailer) : 0;
+        return reinterpret_cast<LinkSnrTrailer*>(reinterpret_cast<uint8_t*>(this) + this->packetSize - getTrailerLength() + before);
+    }
+
+    /**
+     * @brief Get the TDMA trailer
+     *
+     * @return TdmaTrailer* Trailer or nullptr if the packet does not have it
+     */
+    TdmaTrailer* getTdma() {
+        if ((routeFlags & ROUTE_TDMA_F) == 0 || this->packetSize < sizeof(RoutePacket) + getTrailerLength())
+            return nullptr;
+
+        return reinterpret_cast<TdmaTrailer*>(reinterpret_cast<uint8_t*>(this) + this->packetSize - getTrailerLength());
+    }
+
+    /**
+     * @brief Get the congestion trailer
+     *
+     * @return CongestionTrailer* Trailer or nullptr if the packet does not have it
+     */
+    CongestionTrailer* getCongestion() {
+        if ((routeFlags & ROUTE_CONGESTION_F) == 0 || this->packetSize < sizeof(RoutePacket) + getTrailerLength())
+            return nullptr;
+
+        size_t after = getTrailerLength(routeFlags & (ROUTE_TELEMETRY_F | ROUTE_TIME_SYNC_F));
+        return reinterpret_cast<CongestionTrailer*>(reinterpret_cast<uint8_t*>(this) + this->packetSize - after - sizeof(CongestionTrailer));
+    }
+
+    /**
+     * @brief Get the telemetry trailer
+     *
+     * @return TelemetryTrailer* Trailer or nullptr if the packet does not have it
+     */
+    TelemetryTrailer* getTelemetry() {
+        if ((routeFlags & ROUTE_TELEMETRY_F) == 0 || this->packetSize < sizeof(RoutePacket) + getTrailerLength())
+            return nullptr;
+
+        size_t after = getTrailerLength(routeFlags & ROUTE_TIME_SYNC_F);
+        return reinterpret_cast<TelemetryTrailer*>(reinterpret_cast<uint8_t*>(this) + this->packetSize - after - sizeof(TelemetryTrailer));
+    }
+
+    /**
+     * @brief Get the time synchronization trailer
+     *
+     * @return TimeSyncTrailer* Trailer or nullptr if the packet does not have it
+     */
+    TimeSyncTrailer* getTimeSync() {
+        if ((routeFlags & ROUTE_TIME_SYNC_F) == 0 || this->packetSize < sizeof(RoutePacket) + sizeof(TimeSyncTrailer))
+            return nullptr;
+
+        return reinterpret_cast<TimeSyncTrailer*>(reinterpret_cast<uint8_t*>(this) + this->packetSize - sizeof(TimeSyncTrailer));
+    }
 };
 
 #pragma pack()
@@ -0,0 +1,308 @@
+#ifndef _LORAMESHER_NEIGHBOR_ENTRY_H
+#define _LORAMESHER_NEIGHBOR_ENTRY_H
+
+#include "BuildOptions.h"
+
+static_assert(LM_ETX_WINDOW_SIZE > 0 && LM_ETX_WINDOW_SIZE <= 32, "The ETX window is a 32 bits bitmap");
+
+/**
+ * @brief Entry of the NeighborTableService. It keeps in one record the link quality of a neighbour and the cost
+ * history of the route to the address.
+ *
+ */
+class NeighborEntry {
+public:
+    /**
+     * @brief Address of the node
+     *
+     */
+    uint16_t address = 0;
+
+    /**
+     * @brief EWMA of the RSSI in dBm
+     *
+     */
+    int16_t rssi = -120;
+
+    /**
+     * @brief EWMA of the SNR in dB
+     *
+     */
+    int8_t snr = -20;
+
+    /**
+     * @brief If rssi and snr have a measure
+     *
+     */
+    bool hasSignal = false;
+
+    /**
+     * @brief Expected transmission count, EWMA of the delivery ratio of the ETX window
+     *
+     */
+    float etx = LM_ETX_DEFAULT;
+
+    /**
+     * @brief Results of the last LM_ETX_WINDOW_SIZE transmissions, one bit each, 1 is a success
+     *
+     */
+    uint32_t etxWindow = 0;
+
+    /**
+     * @brief Number of results in the etxWindow
+     *
+     */
+    uint8_t etxWindowFilled = 0;
+
+    /**
+     * @brief Position of the next result in the etxWindow
+     *
+     */
+    uint8_t etxWindowIndex = 0;
+
+    /**
+     * @brief If lastSeqNum has been received
+     *
+     */
+    bool seqInitialized = false;
+
+    /**
+     * @brief Missed HELLOs since lastHeard
+     *
+     */
+    uint8_t missedHellos = 0;
+
+    /**
+     * @brief The neighbour has been detected as failed
+     *
+     */
+    bool failureFlagged = false;
+
+    /**
+     * @brief Last sequence number received, used to detect the lost packets
+     *
+     */
+    uint32_t lastSeqNum = 0;
+
+    uint32_t totalTxAttempts = 0;
+    uint32_t totalTxSuccess = 0;
+    uint32_t totalTxFailures = 0;
+
+    /**
+     * @brief millis() of the last link metrics update, 0 if never updated
+     *
+     */
+    uint32_t lastUpdate = 0;
+
+    /**
+     * @brief millis() of the last packet heard from the neighbour, 0 if never heard
+     *
+     */
+    uint32_t lastHeard = 0;
+
+    /**
+     * @brief millis() of the last use of the entry, the least recently used entry is replaced when the table is full
+     *
+     */
+    uint32_t lastUsed = 0;
+
+    /**
+     * @brief Congestion of the neighbour and of its path to its best gateway in percent, from its last CongestionTrailer
+     *
+     */
+    uint8_t congestion = 0;
+    uint8_t pathCongestion = 0;
+
+    /**
+     * @brief millis() of the congestion, 0 if never received
+     *
+     */
+    uint32_t congestionUpdate = 0;
+
+    /**
+     * @brief Preamble length in symbols of the frames to the neighbour, it receives in sniff mode. 0 if it listens continuously
+     *
+     */
+    uint16_t sniffPreambleLength = 0;
+
+    /**
+     * @brief millis() of the last HELLO heard from the neighbour on the backbone, 0 if never heard. The unicast packets go
+     * to it on the backbone, see BackboneService
+     *
+     */
+    uint32_t backboneHeard = 0;
+
+    /**
+     * @brief ETX and SNR of the last change notified by NeighborTableService::linkUpdated
+     *
+     */
+    float notifiedEtx = LM_ETX_DEFAULT;
+    int8_t notifiedSnr = -20;
+
+    /**
+     * @brief Next hop of the route to the address when routeCost was calculated
+     *
+     */
+    uint16_t routeVia = 0;
+
+    /**
+     * @brief Last cost of the route to the address
+     *
+     */
+    float routeCost = 0;
+
+    /**
+     * @brief millis() of the routeCost, 0 if there is no cost history
+     *
+     */
+    uint32_t routeCostUpdate = 0;
+
+    /**
+     * @brief Add a measure to the RSSI and SNR EWMA, with alpha 0.3
+     *
+     * @param rssi_ RSSI in dBm
+     * @param snr_ SNR in dB
+     */
+    void updateSignal(int16_t rssi_, int8_t snr_) {
+        if (!hasSignal) {
+            rssi = rssi_;
+            snr = snr_;
+            hasSignal = true;
+        }
+        else {
+            rssi = (int16_t) ((7 * (int32_t) rssi + 3 * (int32_t) rssi_) / 10);
+            snr = (int8_t) ((7 * (int16_t) snr + 3 * (int16_t) snr_) / 10);
+        }
+
+        lastUpdate = millis();
+    }
+
+    /**
+     * @brief Add a transmission result to the ETX window and update the ETX
+     *
+     * @param success If the packet has been received
+     */
+    void addTransmission(bool success) {
+        uint32_t bit = (uint32_t) 1 << etxWindowIndex;
+        etxWindow = success ? etxWindow | bit : etxWindow & ~bit;
+        etxWindowIndex = (etxWindowIndex + 1) % LM_ETX_WINDOW_SIZE;
+        if (etxWindowFilled < LM_ETX_WINDOW_SIZE)
+            etxWindowFilled++;
+
+        totalTxAttempts++;
+        if (success)
+            totalTxSuccess++;
+
+        float instantETX = getInstantETX();
+
+        // Bootstrap with the instant value until the window has some results
+        if (etxWindowFilled >= 3)
+            etx = LM_ETX_ALPHA * instantETX + (1.0f - LM_ETX_ALPHA) * etx;
+        else
+            etx = instantETX;
+
+        if (etx < 1.0f)
+            etx = 1.0f;
+        if (etx > LM_ETX_MAX)
+            etx = LM_ETX_MAX;
+    }
+
+    /**
+     * @brief Add a received sequence number, the gap since the last one are recorded as lost transmissions
+     *
+     * @param seqNum Sequence number
+     * @return uint32_t Number of packets lost before this one
+     */
+    uint32_t addSequence(uint32_t seqNum) {
+        uint32_t lost = 0;
+
+        // Out of order packets and restarted senders are not penalised
+        if (seqInitialized && seqNum > lastSeqNum + 1) {
+            lost = seqNum - lastSeqNum - 1;
+            for (uint32_t i = 0; i < lost && i < LM_ETX_WINDOW_SIZE; i++) {
+                addTransmission(false);
+                totalTxFailures++;
+            }
+        }
+
+        addTransmission(true);
+        lastSeqNum = seqNum;
+        seqInitialized = true;
+        return lost;
+    }
+
+    /**
+     * @brief Number of successes in the ETX window
+     *
+     */
+    uint8_t getWindowSuccess() const {
+        return __builtin_popcount(etxWindow & getWindowMask());
+    }
+
+    /**
+     * @brief ETX of the results of the window, without smoothing
+     *
+     */
+    float getInstantETX() const {
+        if (etxWindowFilled == 0)
+            return LM_ETX_DEFAULT;
+
+        float deliveryRatio = (float) getWindowSuccess() / etxWindowFilled;
+        return deliveryRatio > 0.01f ? 1.0f / deliveryRatio : 100.0f;
+    }
+
+    /**
+     * @brief If the ETX or the SNR moved more than LM_ETX_CHANGE_THRESHOLD or LM_SNR_CHANGE_THRESHOLD since the last
+     * notified change. If so, the current values become the notified ones
+     *
+     */
+    bool takeLinkChange() {
+        float etxChange = etx - notifiedEtx;
+        int16_t snrChange = (int16_t) snr - notifiedSnr;
+
+        if (etxChange <= LM_ETX_CHANGE_THRESHOLD && etxChange >= -LM_ETX_CHANGE_THRESHOLD &&
+            snrChange < LM_SNR_CHANGE_THRESHOLD && snrChange > -LM_SNR_CHANGE_THRESHOLD)
+            return false;
+
+        notifiedEtx = etx;
+        notifiedSnr = snr;
+        return true;
+    }
+
+    /**
+     * @brief If the congestion has been received in the last LM_CONGESTION_TIMEOUT ms
+     *
+     */
+    bool hasCongestion() const {
+        return congestionUpdate != 0 && millis() - congestionUpdate <= LM_CONGESTION_TIMEOUT;
+    }
+
+    /**
+     * @brief A packet has been heard from the neighbour, it is alive
+     *
+     */
+    void heard() {
+        lastHeard = millis();
+        missedHellos = 0;
+        failureFlagged = false;
+    }
+
+    /**
+     * @brief Remember the cost of the route to the address
+     *
+     * @param via Next hop of the route
+     * @param cost Cost of the route
+     */
+    void setRouteCost(uint16_t via, float cost) {
+        routeVia = via;
+        routeCost = cost;
+        routeCostUpdate = millis();
+    }
+
+private:
+    uint32_t getWindowMask() const {
+        return etxWindowFilled >= 32 ? UINT32_MAX : ((uint32_t) 1 << etxWindowFilled) - 1;
+    }
+};
+
+#endif
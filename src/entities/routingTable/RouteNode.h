@@ -3,6 +3,19 @@
 
 #include "NetworkNode.h"
 
+#include "utilities/TimerWheel.hpp"
+
+/**
+ * @brief Alternate next hop of a route, see LoraMesherConfig::multipath
+ *
+ */
+struct RouteAlternate {
+    uint16_t via;
+    uint8_t metric;
+    // millis() of the last advertisement of the route by the via
+    uint32_t heard;
+};
+
 /**
  * @brief Route Node
  *
@@ -21,12 +34,30 @@ public:
      */
     uint32_t timeout = 0;
 
+    /**
+     * @brief Timer of the timeout, armed in the route timers of the RoutingTableService
+     *
+     */
+    LM_Timer timer{ this };
+
     /**
      * @brief Next hop to send the message
      *
      */
     uint16_t via = 0;
 
+    /**
+     * @brief Alternate next hops, advertised by other neighbors with a metric not higher than the one of the route
+     *
+     */
+    RouteAlternate alternates[LM_ROUTE_ALTERNATES];
+
+    /**
+     * @brief Number of alternates
+     *
+     */
+    uint8_t alternatesLength = 0;
+
     /**
      * @brief SNR from received packets. Only available nodes at 1 hop.
      *
@@ -34,11 +65,35 @@ public:
     int8_t receivedSNR = 0;
 
     /**
-     * @brief SNR from sent packets. Only available nodes at 1 hop.
+     * @brief SNR from sent packets, reported by the node in its LinkSnrTrailer. Only available nodes at 1 hop.
      *
      */
     int8_t sentSNR = 0;
 
+    /**
+     * @brief If the node has reported the sentSNR
+     *
+     */
+    bool hasSentSNR = false;
+
+    /**
+     * @brief SNR of the last LM_ADR_SNR_HISTORY route packets received. Only available nodes at 1 hop.
+     *
+     */
+    int8_t snrHistory[LM_ADR_SNR_HISTORY] = {};
+
+    /**
+     * @brief Number of SNR in the snrHistory
+     *
+     */
+    uint8_t snrHistoryLength = 0;
+
+    /**
+     * @brief Position of the next SNR in the snrHistory
+     *
+     */
+    uint8_t snrHistoryIndex = 0;
+
     /**
      * @brief SRTT, smoothed round-trip time (RFC 6298)
      *
@@ -51,6 +106,31 @@ public:
      */
     unsigned long RTTVAR = 0;
 
+    /**
+     * @brief Version of the local routing table when this node changed
+     *
+     */
+    uint8_t changedVersion = 0;
+
+    /**
+     * @brief Last routing table version advertised by this node. Only available nodes at 1 hop.
+     *
+     */
+    uint8_t helloVersion = 0;
+
+    /**
+     * @brief If helloVersion has been received
+     *
+     */
+    bool hasHelloVersion = false;
+
+    /**
+     * @brief Links of the routing table list, a LM_IntrusiveList
+     *
+     */
+    RouteNode* listPrev = nullptr;
+    RouteNode* listNext = nullptr;
+
     /**
      * @brief Construct a new Route Node object
      *
@@ -62,6 +142,36 @@ public:
         : networkNode(address_, metric_, role_, gatewayLoad_), via(via_) {};
 
     RouteNode(const NetworkNode& node_, uint16_t via_) : networkNode(node_), via(via_) {};
+
+    /**
+     * @brief Add a received SNR to the history, replacing the oldest one
+     *
+     * @param snr SNR in dB
+     */
+    void addSNR(int8_t snr) {
+        snrHistory[snrHistoryIndex] = snr;
+        snrHistoryIndex = (snrHistoryIndex + 1) % LM_ADR_SNR_HISTORY;
+        if (snrHistoryLength < LM_ADR_SNR_HISTORY)
+            snrHistoryLength++;
+    }
+
+    /**
+     * @brief Lowest SNR of the history
+     *
+     * @return int8_t SNR in dB, 0 if the history is empty
+     */
+    int8_t getMinSNR() const {
+        if (snrHistoryLength == 0)
+            return 0;
+
+        int8_t minSNR = INT8_MAX;
+        for (uint8_t i = 0; i < snrHistoryLength; i++) {
+            if (snrHistory[i] < minSNR)
+                minSNR = snrHistory[i];
+        }
+
+        return minSNR;
+    }
 };
 
 #endif
@@ -0,0 +1,60 @@
+#ifndef _LORAMESHER_ROUTING_TABLE_SNAPSHOT_H
+#define _LORAMESHER_ROUTING_TABLE_SNAPSHOT_H
+
+#include "NetworkNode.h"
+
+/**
+ * @brief Immutable copy of the routing table, published by the RoutingTableService every time the table changes.
+ * It is shared by all the readers and deleted when the last reference is released.
+ *
+ */
+class RoutingTableSnapshot {
+public:
+    /**
+     * @brief Route of the snapshot
+     *
+     */
+    struct Entry {
+        NetworkNode networkNode;
+        uint16_t via = 0;
+    };
+
+    /**
+     * @brief Version of the snapshot, incremented every time a snapshot is published
+     *
+     */
+    uint32_t version = 0;
+
+    /**
+     * @brief Number of routes
+     *
+     */
+    size_t size = 0;
+
+    /**
+     * @brief Number of routes that fit in the entries
+     *
+     */
+    size_t capacity = 0;
+
+    /**
+     * @brief Number of references, guarded by the snapshot lock of the RoutingTableService.
+     * The first one is held by the RoutingTableService while it is the latest snapshot
+     *
+     */
+    uint32_t references = 1;
+
+    /**
+     * @brief Routes
+     *
+     */
+    Entry* entries = nullptr;
+
+    RoutingTableSnapshot(size_t capacity_) : capacity(capacity_), entries(new Entry[capacity_]) {};
+
+    ~RoutingTableSnapshot() {
+        delete[] entries;
+    }
+};
+
+#endif
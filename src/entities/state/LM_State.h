@@ -3,27 +3,32 @@
 #include "entities/packets/ControlPacket.h"
 
 #pragma pack(1)
-enum LM_StateType {
+enum LM_StateType : uint8_t {
     STATE_TYPE_RECEIVED,
     STATE_TYPE_SENT,
     STATE_TYPE_MANAGER
 };
 
+/**
+ * @brief Compact state record of the SimulatorService ring, it is also the payload of the streamed frames
+ *
+ */
 class LM_State {
 public:
-    size_t id = 0;
+    uint32_t id = 0;
+    // millis() when it was recorded
+    uint32_t timestamp = 0;
     LM_StateType type = STATE_TYPE_RECEIVED;
 
-    size_t receivedQueueSize = 0;
-    size_t sentQueueSize = 0;
-    size_t receivedUserQueueSize = 0;
-    size_t q_WRPSize = 0;
-    size_t q_WSPSize = 0;
-    size_t routingTableSize = 0;
-    size_t secondsSinceStart = 0;
-    size_t freeMemoryAllocation = 0;
+    uint16_t receivedQueueSize = 0;
+    uint16_t sentQueueSize = 0;
+    uint16_t receivedUserQueueSize = 0;
+    uint16_t q_WRPSize = 0;
+    uint16_t q_WSPSize = 0;
+    uint16_t routingTableSize = 0;
+    uint32_t freeMemoryAllocation = 0;
     // TODO: Clone all the routing table?
 
     ControlPacket packetHeader;
 };
-#pragma pack()
\ No newline at end of file
+#pragma pack()
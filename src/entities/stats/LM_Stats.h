@@ -0,0 +1,181 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Histogram of durations in ms with log2 buckets.
+ * The bucket 0 counts 0 ms, the bucket i counts from 2^(i-1) to 2^i - 1 ms and the last bucket counts all the longer ones.
+ *
+ */
+class LM_Histogram {
+public:
+    uint32_t buckets[LM_HISTOGRAM_BUCKETS] = {};
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    uint32_t max = 0;
+
+    /**
+     * @brief Add a duration to the histogram
+     *
+     * @param value Duration in ms
+     */
+    void record(uint32_t value) {
+        buckets[getBucket(value)]++;
+        count++;
+        sum += value;
+        if (value > max)
+            max = value;
+    }
+
+    /**
+     * @brief Get the bucket of a duration
+     *
+     * @param value Duration in ms
+     * @return uint8_t Bucket
+     */
+    static uint8_t getBucket(uint32_t value) {
+        if (value == 0)
+            return 0;
+
+        uint8_t bucket = 32 - __builtin_clz(value);
+        return bucket < LM_HISTOGRAM_BUCKETS ? bucket : LM_HISTOGRAM_BUCKETS - 1;
+    }
+
+    /**
+     * @brief Get the shortest duration counted by a bucket
+     *
+     * @param bucket Bucket
+     * @return uint32_t Duration in ms
+     */
+    static uint32_t getBucketLowerBound(uint8_t bucket) {
+        return bucket == 0 ? 0 : ((uint32_t) 1) << (bucket - 1);
+    }
+
+    /**
+     * @brief Mean of the durations
+     *
+     * @return uint32_t Mean in ms, 0 if empty
+     */
+    uint32_t getMean() const {
+        return count == 0 ? 0 : sum / count;
+    }
+
+    /**
+     * @brief Upper bound of the percentile, the lower bound of the next bucket. The maximum for the last bucket
+     *
+     * @param percent Percentile, from 0 to 100
+     * @return uint32_t Duration in ms, 0 if empty
+     */
+    uint32_t getPercentile(uint8_t percent) const {
+        if (count == 0)
+            return 0;
+
+        uint64_t target = ((uint64_t) count * percent + 99) / 100;
+        uint32_t accumulated = 0;
+
+        for (uint8_t i = 0; i < LM_HISTOGRAM_BUCKETS - 1; i++) {
+            accumulated += buckets[i];
+            if (accumulated >= target && accumulated > 0)
+                return getBucketLowerBound(i + 1) < max ? getBucketLowerBound(i + 1) : max;
+        }
+
+        return max;
+    }
+};
+
+/**
+ * @brief Snapshot of the LoRaMesher statistics, see LoraMesher::getStats.
+ * The counters and histograms are taken at the same time, the packet pool and received ring values are read after them.
+ *
+ */
+struct LM_Stats {
+    uint32_t receivedDataPacketsNum = 0;
+    uint32_t sendPacketsNum = 0;
+    uint32_t receivedHelloPacketsNum = 0;
+    uint32_t sentHelloPacketsNum = 0;
+    uint32_t receivedBroadcastPacketsNum = 0;
+    uint32_t forwardedPacketsNum = 0;
+    uint32_t dataPacketForMeNum = 0;
+    uint32_t receivedIAmViaNum = 0;
+    uint32_t sendPacketDestinyUnreachableNum = 0;
+    uint32_t receivedPacketNotForMeNum = 0;
+    // Packets not for me dropped from their header in the received packets ring, counted in receivedPacketNotForMeNum too
+    uint32_t receivedFilteredNum = 0;
+    // Frames dropped and frames delayed by the link filter, see LinkFilterService
+    uint32_t linkFilterDroppedNum = 0;
+    uint32_t linkFilterDelayedNum = 0;
+    uint32_t sendQueueDroppedNum = 0;
+    uint32_t sendQueueExpiredNum = 0;
+    uint32_t sendQueueReplacedNum = 0;
+    uint32_t spoolStoredNum = 0;
+    uint32_t spoolDrainedNum = 0;
+    uint32_t receivedQueueDroppedNum = 0;
+    uint32_t channelBusyNum = 0;
+    // Frames lost by the radios: CRC error, damaged header, other read error, receive interrupt without a frame, length
+    // different from the header and compact header not decoded. Restarts of the first radio after an SPI failure
+    uint32_t rxCrcErrorsNum = 0;
+    uint32_t rxHeaderErrorsNum = 0;
+    uint32_t rxReadErrorsNum = 0;
+    uint32_t rxEmptyNum = 0;
+    uint32_t rxSizeMismatchNum = 0;
+    uint32_t rxMalformedNum = 0;
+    uint32_t radioRestartsNum = 0;
+    // Channel activity detected by a scan without a frame received in the longest time on air after it
+    uint32_t preambleWithoutPacketNum = 0;
+    // ms the first radio has not been receiving: from the start of every transmission until it receives again, and the scans
+    uint32_t rxDeafTime = 0;
+    // Busy time in ms of the channel of the first radio by source: the frames of the node, the frames received, with errors
+    // too, and the activity detected without a frame, half the longest time on air each
+    uint32_t busyTxTime = 0;
+    uint32_t busyRxTime = 0;
+    uint32_t busyCadTime = 0;
+    // Estimate of the busy fraction of the channel in per mille, see LoraMesher::getChannelBusy
+    uint16_t channelBusyPerMille = 0;
+    uint32_t floodSuppressedNum = 0;
+    uint32_t hopRetransmissionsNum = 0;
+    uint32_t hopAckLostNum = 0;
+    uint32_t neighborsWithdrawnNum = 0;
+    uint32_t helloReslotsNum = 0;
+    uint32_t tdmaSlotSendsNum = 0;
+    uint32_t tdmaSlotChangesNum = 0;
+    uint32_t backboneSentNum = 0;
+    uint32_t backboneFailedNum = 0;
+    uint32_t congestionHellosNum = 0;
+    uint32_t solicitationsNum = 0;
+    uint32_t solicitationRepliesNum = 0;
+    uint32_t routeRequestsNum = 0;
+    uint32_t routeRepliesNum = 0;
+    uint32_t piggybackedAcksNum = 0;
+    uint32_t coalescedAcksNum = 0;
+    uint32_t datagramsIncompleteNum = 0;
+    uint32_t fecRebuiltNum = 0;
+    uint32_t compressionInputBytes = 0;
+    uint32_t compressionOutputBytes = 0;
+    uint32_t payloadAuthFailedNum = 0;
+
+    uint32_t receivedPayloadBytes = 0;
+    uint32_t receivedControlBytes = 0;
+    uint32_t sentPayloadBytes = 0;
+    uint32_t sentControlBytes = 0;
+
+    // Time from the packet added to the send queue until it is taken to be sent. The resent packets are not counted again
+    LM_Histogram sendQueueWait;
+    // Random delay of waitBeforeSend before every transmission, including the retries after a detected preamble or a busy channel
+    LM_Histogram backoff;
+    // Time on air of the sent packets
+    LM_Histogram timeOnAir;
+
+    uint32_t receivedOverflowNum = 0;
+    uint32_t packetPoolHighWater = 0;
+    uint32_t packetPoolExhaustedNum = 0;
+    uint32_t routeFailoversNum = 0;
+    uint32_t spoolDroppedNum = 0;
+    uint32_t spoolSize = 0;
+    uint32_t telemetryRelayDroppedNum = 0;
+    uint32_t otaChunksServedNum = 0;
+    uint32_t otaRequestsNum = 0;
+    uint32_t otaHashFailuresNum = 0;
+    uint32_t routeDiscoveryFailuresNum = 0;
+    uint32_t hopTracesNum = 0;
+    size_t sendQueueSize = 0;
+};
@@ -4,6 +4,16 @@
 
 #include "BuildOptions.h"
 
+/**
+ * @brief Modem of a radio. FLRC and GFSK are the high rate modems of the SX1280, for the backbone links
+ *
+ */
+enum LM_PacketType : uint8_t {
+    LM_PACKET_LORA = 0,
+    LM_PACKET_FLRC = 1,
+    LM_PACKET_GFSK = 2,
+};
+
 class LM_Module {
 public:
     virtual ~LM_Module() {}
@@ -22,12 +32,15 @@ public:
     virtual float getSNR() = 0;
     virtual int16_t readData(uint8_t* buffer, size_t numBytes) = 0;
     virtual int16_t transmit(uint8_t* buffer, size_t length) = 0;
+    virtual int16_t startTransmit(uint8_t* buffer, size_t length) = 0;
+    virtual int16_t finishTransmit() = 0;
     virtual uint32_t getTimeOnAir(size_t length) = 0;
 
     virtual void setDioActionForReceiving(void (*action)()) = 0;
     virtual void setDioActionForReceivingTimeout(void (*action)()) = 0;
     virtual void setDioActionForScanning(void (*action)()) = 0;
     virtual void setDioActionForScanningTimeout(void (*action)()) = 0;
+    virtual void setDioActionForTransmitting(void (*action)()) = 0;
     virtual void clearDioActions() = 0;
 
     virtual int16_t setFrequency(float freq) = 0;
@@ -39,4 +52,21 @@ public:
     virtual int16_t setPreambleLength(int16_t preambleLength) = 0;
     virtual int16_t setGain(uint8_t gain) = 0;
     virtual int16_t setOutputPower(int8_t power, int8_t useRfo) = 0;
+
+    // Receive with the hardware duty cycle, sleeping between short listens sized to detect the frames with a preamble of
+    // senderPreambleLength symbols. Only the SX126x modules have it
+    virtual int16_t startReceiveDutyCycle(uint16_t senderPreambleLength) {
+        (void) senderPreambleLength;
+        return RADIOLIB_ERR_UNKNOWN;
+    }
+
+    // Begin with the FLRC or GFSK modem instead of LoRa, bitRate in kbps and preambleLength in bits. Only the SX1280 has them
+    virtual int16_t beginHighRate(LM_PacketType type, float freq, uint16_t bitRate, int8_t power, uint16_t preambleLength) {
+        (void) type;
+        (void) freq;
+        (void) bitRate;
+        (void) power;
+        (void) preambleLength;
+        return RADIOLIB_ERR_UNKNOWN;
+    }
 };
\ No newline at end of file
@@ -2,6 +2,14 @@
 
 #include "LM_Module.h"
 
+// Replay of a capture of the received frames
+#include "LM_Replay.h"
+
+#ifdef LM_HOST
+// Host build, the radio is simulated
+#include "LM_Virtual.h"
+#else
+
 // SX1278_MOD
 #include "LM_SX1278.h"
 
@@ -18,4 +26,5 @@
 #include "LM_SX1280.h"
 
 // RFM95_MOD
-#include "LM_RFM95.h"
\ No newline at end of file
+#include "LM_RFM95.h"
+#endif
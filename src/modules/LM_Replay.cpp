@@ -0,0 +1,245 @@
+#include "LM_Replay.h"
+
+#include <esp_timer.h>
+
+#include "services/AirtimeService.h"
+
+// Time in ms a frame waits to be read before it is counted as missed
+static const uint32_t REPLAY_READ_TIMEOUT = 1000;
+
+LM_ReplayModule::LM_ReplayModule(const uint8_t* capture, size_t length, float speed):
+    capture(capture), captureLength(length), speed(speed > 0 ? speed : 0) {}
+
+LM_ReplayModule::~LM_ReplayModule() {
+    if (replayTask != nullptr)
+        vTaskDelete(replayTask);
+}
+
+int16_t LM_ReplayModule::begin(float, float bw, uint8_t sf, uint8_t cr, uint8_t, int8_t, int16_t preambleLength) {
+    receiving = false;
+    this->bw = bw;
+    this->sf = sf;
+    this->cr = cr;
+    this->preambleLength = preambleLength;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::receive(uint8_t*, size_t) {
+    // The blocking receive is not used by LoRaMesher
+    return RADIOLIB_ERR_UNKNOWN;
+}
+
+int16_t LM_ReplayModule::startReceive() {
+    receiving = true;
+
+    // The replay starts the first time LoRaMesher receives
+    if (replayTask == nullptr && !finished) {
+        if (xTaskCreate(replayRoutine, "LM Replay", LM_TASK_STACK_SIZE, this, configMAX_PRIORITIES - 1, &replayTask) != pdPASS) {
+            ESP_LOGE(LM_TAG, "Replay task not created");
+            replayTask = nullptr;
+        }
+    }
+
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::scanChannel() {
+    // The frames of the capture are not on air
+    receiving = false;
+    return RADIOLIB_CHANNEL_FREE;
+}
+
+int16_t LM_ReplayModule::startChannelScan() {
+    // Only the blocking scan is used by LoRaMesher
+    return RADIOLIB_ERR_UNKNOWN;
+}
+
+int16_t LM_ReplayModule::standby() {
+    receiving = false;
+    return RADIOLIB_ERR_NONE;
+}
+
+void LM_ReplayModule::reset() {
+    receiving = false;
+    action = nullptr;
+}
+
+int16_t LM_ReplayModule::setCRC(bool crc) {
+    this->crc = crc;
+    return RADIOLIB_ERR_NONE;
+}
+
+size_t LM_ReplayModule::getPacketLength() {
+    return frame.length;
+}
+
+float LM_ReplayModule::getRSSI() {
+    return frame.rssi;
+}
+
+float LM_ReplayModule::getSNR() {
+    return frame.snr;
+}
+
+int16_t LM_ReplayModule::readData(uint8_t* buffer, size_t numBytes) {
+    memcpy(buffer, frame.data, numBytes < frame.length ? numBytes : frame.length);
+    replayedFrames++;
+
+    // The replay task waits for the read before the next frame
+    if (replayTask != nullptr)
+        xTaskNotifyGive(replayTask);
+
+    return (frame.flags & CaptureService::CAPTURE_CRC_ERROR_F) ? RADIOLIB_ERR_CRC_MISMATCH : RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::transmit(uint8_t*, size_t) {
+    receiving = false;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::startTransmit(uint8_t*, size_t) {
+    receiving = false;
+
+    // The frame is discarded, it is sent at once
+    void (*transmitted)() = action;
+    if (transmitted != nullptr)
+        transmitted();
+
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::finishTransmit() {
+    return RADIOLIB_ERR_NONE;
+}
+
+uint32_t LM_ReplayModule::getTimeOnAir(size_t length) {
+    return AirtimeService::calculate(length, sf, bw, cr, preambleLength, crc, AirtimeService::isLowDataRateOptimized(sf, bw));
+}
+
+void LM_ReplayModule::setDioActionForReceiving(void (*action)()) {
+    this->action = action;
+}
+
+void LM_ReplayModule::setDioActionForReceivingTimeout(void (*)()) {
+    // The receive is continuous, it has no timeout
+}
+
+void LM_ReplayModule::setDioActionForScanning(void (*)()) {
+    // The scan is blocking
+}
+
+void LM_ReplayModule::setDioActionForScanningTimeout(void (*)()) {
+    // The scan is blocking
+}
+
+void LM_ReplayModule::setDioActionForTransmitting(void (*action)()) {
+    this->action = action;
+}
+
+void LM_ReplayModule::clearDioActions() {
+    action = nullptr;
+}
+
+int16_t LM_ReplayModule::setFrequency(float) {
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setBandwidth(float bw) {
+    this->bw = bw;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setSpreadingFactor(uint8_t sf) {
+    this->sf = sf;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setCodingRate(uint8_t cr) {
+    this->cr = cr;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setSyncWord(uint8_t) {
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setOutputPower(int8_t) {
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setPreambleLength(int16_t preambleLength) {
+    this->preambleLength = preambleLength;
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setGain(uint8_t) {
+    return RADIOLIB_ERR_NONE;
+}
+
+int16_t LM_ReplayModule::setOutputPower(int8_t power, int8_t) {
+    return setOutputPower(power);
+}
+
+void LM_ReplayModule::replayRoutine(void* parameter) {
+    LM_ReplayModule* module = static_cast<LM_ReplayModule*>(parameter);
+    module->replay();
+
+    module->replayTask = nullptr;
+    vTaskDelete(NULL);
+}
+
+void LM_ReplayModule::replay() {
+    ESP_LOGI(LM_TAG, "Replay of %u bytes of capture started, speed %.2f", (unsigned) captureLength, speed);
+
+    int64_t start = esp_timer_get_time();
+
+    // Time of the frames since the first one, the timestamps are micros() and can wrap
+    uint64_t captureTime = 0;
+    uint32_t previousTimestamp = 0;
+    bool first = true;
+
+    size_t offset = 0;
+    while (offset < captureLength) {
+        LM_CapturedFrame next;
+        size_t recordLength = CaptureService::decode(&capture[offset], captureLength - offset, next);
+        if (recordLength == 0) {
+            // Not a record, resynchronize on the next byte
+            offset++;
+            continue;
+        }
+
+        offset += recordLength;
+
+        if (!first)
+            captureTime += (uint32_t) (next.timestamp - previousTimestamp);
+
+        previousTimestamp = next.timestamp;
+        first = false;
+
+        if (speed > 0) {
+            // With the resolution of the tick
+            int64_t wait = start + (int64_t) (captureTime / speed) - esp_timer_get_time();
+            if (wait > 0)
+                vTaskDelay(wait / 1000 / portTICK_PERIOD_MS);
+        }
+
+        void (*received)() = action;
+        if (!receiving || received == nullptr) {
+            missedFrames++;
+            continue;
+        }
+
+        frame = next;
+
+        // The action runs in this task, as the receive interrupt would
+        ulTaskNotifyTake(pdTRUE, 0);
+        received();
+
+        if (ulTaskNotifyTake(pdTRUE, REPLAY_READ_TIMEOUT / portTICK_PERIOD_MS) == 0)
+            missedFrames++;
+    }
+
+    finished = true;
+
+    ESP_LOGI(LM_TAG, "Replay finished, %u frames replayed, %u missed", (unsigned) replayedFrames, (unsigned) missedFrames);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <RadioLib.h>
+
+#include "LM_Module.h"
+
+#include "services/CaptureService.h"
+
+/**
+ * @brief Radio module that receives the frames of a capture of the CaptureService, at the original speed or accelerated.
+ * The frames are given to LoRaMesher by the receiving routine, as if they were received again, so a traffic burst is reproduced
+ * with the same RSSI, SNR and spacing. The frames sent are discarded, and a frame due while the radio is not receiving is
+ * missed, like on air.
+ *
+ * It is set with LoraMesherConfig::radioModule, the capture is not copied and must outlive the module.
+ */
+class LM_ReplayModule: public LM_Module {
+public:
+    /**
+     * @brief Create the module of a capture
+     *
+     * @param capture Records of the capture, the invalid bytes between them are skipped
+     * @param length Length in bytes
+     * @param speed Speed of the replay, 1 is the original speed, 10 ten times faster and 0 as fast as the frames are read
+     */
+    LM_ReplayModule(const uint8_t* capture, size_t length, float speed = 1);
+
+    ~LM_ReplayModule();
+
+    int16_t begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t syncWord,
+        int8_t power, int16_t preambleLength) override;
+
+    int16_t receive(uint8_t* data, size_t len) override;
+    int16_t startReceive() override;
+    int16_t scanChannel() override;
+    int16_t startChannelScan() override;
+    int16_t standby() override;
+    void reset() override;
+    int16_t setCRC(bool crc) override;
+    size_t getPacketLength() override;
+    float getRSSI() override;
+    float getSNR() override;
+    int16_t readData(uint8_t* buffer, size_t numBytes) override;
+    int16_t transmit(uint8_t* buffer, size_t length) override;
+    int16_t startTransmit(uint8_t* buffer, size_t length) override;
+    int16_t finishTransmit() override;
+    uint32_t getTimeOnAir(size_t length) override;
+
+    void setDioActionForReceiving(void (*action)()) override;
+    void setDioActionForReceivingTimeout(void (*action)()) override;
+    void setDioActionForScanning(void (*action)()) override;
+    void setDioActionForScanningTimeout(void (*action)()) override;
+    void setDioActionForTransmitting(void (*action)()) override;
+    void clearDioActions() override;
+
+    int16_t setFrequency(float freq) override;
+    int16_t setBandwidth(float bw) override;
+    int16_t setSpreadingFactor(uint8_t sf) override;
+    int16_t setCodingRate(uint8_t cr) override;
+    int16_t setSyncWord(uint8_t syncWord) override;
+    int16_t setOutputPower(int8_t power) override;
+    int16_t setPreambleLength(int16_t preambleLength) override;
+    int16_t setGain(uint8_t gain) override;
+    int16_t setOutputPower(int8_t power, int8_t useRfo) override;
+
+    /**
+     * @brief Get the number of frames read by LoRaMesher
+     *
+     * @return uint32_t
+     */
+    uint32_t getReplayedFramesNum() { return replayedFrames; }
+
+    /**
+     * @brief Get the number of frames missed, the radio was not receiving or the frame was not read
+     *
+     * @return uint32_t
+     */
+    uint32_t getMissedFramesNum() { return missedFrames; }
+
+    /**
+     * @brief Check if all the frames of the capture have been replayed
+     *
+     * @return true If the replay has finished
+     */
+    bool isFinished() { return finished; }
+
+private:
+    const uint8_t* capture;
+    size_t captureLength;
+    float speed;
+
+    float bw = 125;
+    uint8_t sf = 7;
+    uint8_t cr = 7;
+    uint16_t preambleLength = 8;
+    bool crc = true;
+
+    volatile bool receiving = false;
+    void (* volatile action)() = nullptr;
+
+    // Frame being received
+    LM_CapturedFrame frame = {};
+
+    uint32_t replayedFrames = 0;
+    uint32_t missedFrames = 0;
+    volatile bool finished = false;
+
+    TaskHandle_t replayTask = nullptr;
+
+    /**
+     * @brief Routine of the replay task, it fires the receive action at the time of every frame and waits for its read
+     *
+     * @param parameter The LM_ReplayModule
+     */
+    static void replayRoutine(void* parameter);
+
+    void replay();
+};
@@ -65,6 +65,14 @@ int16_t LM_SX1268::transmit(uint8_t* buffer, size_t length) {
     return module->transmit(buffer, length);
 }
 
+int16_t LM_SX1268::startTransmit(uint8_t* buffer, size_t length) {
+    return module->startTransmit(buffer, length);
+}
+
+int16_t LM_SX1268::finishTransmit() {
+    return module->finishTransmit();
+}
+
 uint32_t LM_SX1268::getTimeOnAir(size_t length) {
     return module->getTimeOnAir(length);
 }
@@ -85,6 +93,10 @@ void LM_SX1268::setDioActionForScanningTimeout(void(*action)()) {
     return;
 }
 
+void LM_SX1268::setDioActionForTransmitting(void (*action)()) {
+    module->setDio1Action(action);
+}
+
 void LM_SX1268::clearDioActions() {
     module->clearDio1Action();
 }
@@ -123,4 +135,8 @@ int16_t LM_SX1268::setGain(uint8_t gain) {
 
 int16_t LM_SX1268::setOutputPower(int8_t power, int8_t useRfo) {
     return module->setOutputPower(power);
+}
+
+int16_t LM_SX1268::startReceiveDutyCycle(uint16_t senderPreambleLength) {
+    return module->startReceiveDutyCycleAuto(senderPreambleLength, LM_SNIFF_MIN_SYMBOLS);
 }
\ No newline at end of file
@@ -62,6 +62,14 @@ int16_t LM_SX1280::transmit(uint8_t* buffer, size_t length) {
     return module->transmit(buffer, length);
 }
 
+int16_t LM_SX1280::startTransmit(uint8_t* buffer, size_t length) {
+    return module->startTransmit(buffer, length);
+}
+
+int16_t LM_SX1280::finishTransmit() {
+    return module->finishTransmit();
+}
+
 uint32_t LM_SX1280::getTimeOnAir(size_t length) {
     return module->getTimeOnAir(length);
 }
@@ -84,6 +92,10 @@ void LM_SX1280::setDioActionForScanningTimeout(void(*action)()) {
     // module->setDio0Action(action, RISING);
 }
 
+void LM_SX1280::setDioActionForTransmitting(void (*action)()) {
+    module->setPacketSentAction(action);
+}
+
 void LM_SX1280::clearDioActions() {
     module->clearDio1Action();
 }
@@ -123,4 +135,16 @@ int16_t LM_SX1280::setGain(uint8_t gain) {
 
 int16_t LM_SX1280::setOutputPower(int8_t power, int8_t useRfo) {
     return module->setOutputPower(power);
+}
+
+int16_t LM_SX1280::beginHighRate(LM_PacketType type, float freq, uint16_t bitRate, int8_t power, uint16_t preambleLength) {
+    switch (type) {
+        case LM_PACKET_FLRC:
+            return module->beginFLRC(freq, bitRate, RADIOLIB_SX128X_FLRC_CR_3_4, power, preambleLength);
+        case LM_PACKET_GFSK:
+            // Modulation index of 1, the deviation of the RadioLib defaults
+            return module->beginGFSK(freq, bitRate, bitRate / 2.0f, power, preambleLength);
+        default:
+            return RADIOLIB_ERR_UNKNOWN;
+    }
 }
\ No newline at end of file
@@ -33,12 +33,15 @@ public:
     float getSNR() override;
     int16_t readData(uint8_t* buffer, size_t numBytes) override;
     int16_t transmit(uint8_t* buffer, size_t length) override;
+    int16_t startTransmit(uint8_t* buffer, size_t length) override;
+    int16_t finishTransmit() override;
     uint32_t getTimeOnAir(size_t length) override;
 
     void setDioActionForReceiving(void (*action)()) override;
     void setDioActionForReceivingTimeout(void (*action)()) override;
     void setDioActionForScanning(void (*action)()) override;
     void setDioActionForScanningTimeout(void (*action)()) override;
+    void setDioActionForTransmitting(void (*action)()) override;
     void clearDioActions() override;
 
     int16_t setFrequency(float freq) override;
@@ -51,6 +54,8 @@ public:
     int16_t setGain(uint8_t gain) override;
     int16_t setOutputPower(int8_t power, int8_t useRfo) override;
 
+    int16_t beginHighRate(LM_PacketType type, float freq, uint16_t bitRate, int8_t power, uint16_t preambleLength) override;
+
 private:
 
     /**
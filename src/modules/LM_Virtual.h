@@ -0,0 +1,12 @@
+#pragma once
+
+#include "LM_Module.h"
+
+/**
+ * @brief Create the virtual module of the host build, LM_HOST. It is implemented by the simulator, on its simulated channel,
+ * for the node of the calling task
+ *
+ * @param module LoraModules of the configuration, every module is simulated the same way
+ * @return LM_Module* The virtual module
+ */
+LM_Module* LM_CreateVirtualModule(uint8_t module);
@@ -0,0 +1,100 @@
+#include "AirtimeService.h"
+
+#include "modules/LM_Module.h"
+
+// One entry per frame length, up to the largest LoRa frame
+static constexpr size_t TABLE_LENGTH = UINT8_MAX + 1;
+
+static uint32_t getBandwidthHz(float bw) {
+    return (uint32_t) (bw * 1000 + 0.5f);
+}
+
+static bool hasPayloadCrc() {
+#ifdef LM_ADDCRC_PAYLOAD
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AirtimeService::build(LM_Module* radio, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength) {
+    if (timeOnAirTable == nullptr)
+        timeOnAirTable = new uint32_t[TABLE_LENGTH];
+
+    for (size_t length = 0; length < TABLE_LENGTH; length++)
+        timeOnAirTable[length] = radio->getTimeOnAir(length);
+
+    activeConfiguration->sf = sf;
+    activeConfiguration->bwHz = getBandwidthHz(bw);
+    activeConfiguration->cr = cr;
+    activeConfiguration->preambleLength = preambleLength;
+    activeConfiguration->crc = hasPayloadCrc();
+
+    ESP_LOGV(LM_TAG, "Time on air table built, SF%d BW%d CR4/%d, %d us for 255 bytes",
+        sf, (int) activeConfiguration->bwHz, cr, (int) timeOnAirTable[UINT8_MAX]);
+}
+
+uint32_t AirtimeService::getTimeOnAir(size_t length) {
+    if (timeOnAirTable == nullptr || length >= TABLE_LENGTH) {
+        AirtimeConfiguration* config = activeConfiguration;
+        float bw = config->bwHz / 1000.0f;
+        return calculate(length, config->sf, bw, config->cr, config->preambleLength, config->crc, isLowDataRateOptimized(config->sf, bw));
+    }
+
+    return timeOnAirTable[length];
+}
+
+uint32_t AirtimeService::getTimeOnAir(size_t length, uint16_t preambleLength) {
+    AirtimeConfiguration* config = activeConfiguration;
+    uint32_t timeOnAir = getTimeOnAir(length);
+    if (preambleLength == config->preambleLength || config->bwHz == 0)
+        return timeOnAir;
+
+    // Every symbol of the preamble more or less
+    int64_t symbols = (int64_t) preambleLength - config->preambleLength;
+    return (uint32_t) ((int64_t) timeOnAir + (symbols << config->sf) * 1000000 / config->bwHz);
+}
+
+uint32_t AirtimeService::getTimeOnAir(size_t length, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength,
+    bool crc, bool lowDataRateOptimize) {
+    AirtimeConfiguration* config = activeConfiguration;
+
+    if (timeOnAirTable != nullptr && length < TABLE_LENGTH && config->sf == sf && config->bwHz == getBandwidthHz(bw) &&
+        config->cr == cr && config->preambleLength == preambleLength && config->crc == crc &&
+        isLowDataRateOptimized(sf, bw) == lowDataRateOptimize)
+        return timeOnAirTable[length];
+
+    return calculate(length, sf, bw, cr, preambleLength, crc, lowDataRateOptimize);
+}
+
+uint32_t AirtimeService::calculate(size_t length, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength,
+    bool crc, bool lowDataRateOptimize) {
+    uint32_t bwHz = getBandwidthHz(bw);
+    if (bwHz == 0 || sf < 6)
+        return 0;
+
+    // Payload symbols: 8 + max(ceil((8 PL - 4 SF + 28 + 16 CRC) / (4 (SF - 2 DE))) CR, 0)
+    int32_t numerator = 8 * (int32_t) length - 4 * sf + 28 + (crc ? 16 : 0);
+    int32_t denominator = 4 * (sf - (lowDataRateOptimize ? 2 : 0));
+    int32_t payloadSymbols = 8;
+    if (numerator > 0)
+        payloadSymbols += (numerator + denominator - 1) / denominator * cr;
+
+    // Quarters of symbol, the preamble has 4.25 symbols more than its length
+    uint64_t quarterSymbols = (uint64_t) preambleLength * 4 + 17 + (uint64_t) payloadSymbols * 4;
+
+    return (quarterSymbols << sf) * 1000000 / (4 * (uint64_t) bwHz);
+}
+
+bool AirtimeService::isLowDataRateOptimized(uint8_t sf, float bw) {
+    uint32_t bwHz = getBandwidthHz(bw);
+    if (bwHz == 0)
+        return false;
+
+    // Symbol length in us
+    return (((uint64_t) 1 << sf) * 1000000) / bwHz > 16000;
+}
+
+uint32_t* AirtimeService::timeOnAirTable = nullptr;
+
+AirtimeService::AirtimeConfiguration* AirtimeService::activeConfiguration = new AirtimeService::AirtimeConfiguration();
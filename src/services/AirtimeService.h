@@ -0,0 +1,112 @@
+#ifndef _LORAMESHER_AIRTIME_SERVICE_H
+#define _LORAMESHER_AIRTIME_SERVICE_H
+
+#include "BuildOptions.h"
+
+class LM_Module;
+
+/**
+ * @brief Time on air of the LoRa frames, precomputed for every length from 0 to 255 bytes.
+ * The table is built with the radio module when the LoRa configuration changes, the lookups are O(1) and integer only.
+ * Other configurations are calculated with the Semtech formula, AN1200.13, in integer arithmetic.
+ *
+ */
+class AirtimeService {
+public:
+    /**
+     * @brief Build the table of the active configuration
+     *
+     * @param radio Radio module, configured with the parameters
+     * @param sf Spreading factor
+     * @param bw Bandwidth in kHz
+     * @param cr Coding rate denominator, 5 to 8
+     * @param preambleLength Preamble length in symbols
+     */
+    static void build(LM_Module* radio, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength);
+
+    /**
+     * @brief Time on air of a frame with the active configuration
+     *
+     * @param length Length of the frame in bytes
+     * @return uint32_t Time in us
+     */
+    static uint32_t getTimeOnAir(size_t length);
+
+    /**
+     * @brief Time on air of a frame with the active configuration
+     *
+     * @param length Length of the frame in bytes
+     * @return uint32_t Time in ms
+     */
+    static uint32_t getTimeOnAirMs(size_t length) { return getTimeOnAir(length) / 1000; }
+
+    /**
+     * @brief Time on air of a frame with the active configuration and another preamble length
+     *
+     * @param length Length of the frame in bytes
+     * @param preambleLength Preamble length in symbols
+     * @return uint32_t Time in us
+     */
+    static uint32_t getTimeOnAir(size_t length, uint16_t preambleLength);
+
+    /**
+     * @brief Time on air of a frame with a configuration. The table is used if it is the active configuration
+     *
+     * @param length Length of the frame in bytes
+     * @param sf Spreading factor
+     * @param bw Bandwidth in kHz
+     * @param cr Coding rate denominator, 5 to 8
+     * @param preambleLength Preamble length in symbols
+     * @param crc Payload CRC enabled
+     * @param lowDataRateOptimize Low data rate optimization enabled
+     * @return uint32_t Time in us
+     */
+    static uint32_t getTimeOnAir(size_t length, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength,
+        bool crc, bool lowDataRateOptimize);
+
+    /**
+     * @brief Calculate the time on air with the Semtech formula, explicit header
+     *
+     * @param length Length of the frame in bytes
+     * @param sf Spreading factor
+     * @param bw Bandwidth in kHz
+     * @param cr Coding rate denominator, 5 to 8
+     * @param preambleLength Preamble length in symbols
+     * @param crc Payload CRC enabled
+     * @param lowDataRateOptimize Low data rate optimization enabled
+     * @return uint32_t Time in us
+     */
+    static uint32_t calculate(size_t length, uint8_t sf, float bw, uint8_t cr, uint16_t preambleLength,
+        bool crc, bool lowDataRateOptimize);
+
+    /**
+     * @brief Low data rate optimization used by the radio, enabled when the symbol is longer than 16 ms
+     *
+     * @param sf Spreading factor
+     * @param bw Bandwidth in kHz
+     */
+    static bool isLowDataRateOptimized(uint8_t sf, float bw);
+
+private:
+    /**
+     * @brief Active configuration of the table
+     *
+     */
+    struct AirtimeConfiguration {
+        uint8_t sf = 0;
+        uint32_t bwHz = 0;
+        uint8_t cr = 0;
+        uint16_t preambleLength = 0;
+        bool crc = false;
+    };
+
+    /**
+     * @brief Time on air in us, one entry per length. nullptr until it is built
+     *
+     */
+    static uint32_t* timeOnAirTable;
+
+    static AirtimeConfiguration* activeConfiguration;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "BackboneService.h"
+
+#include "NeighborTableService.h"
+
+void BackboneService::heard(uint16_t address) {
+    NeighborTableService::setInUse();
+
+    NeighborEntry* entry = NeighborTableService::getOrCreate(address);
+    if (entry != nullptr) {
+        if (!isAlive(entry->backboneHeard))
+            ESP_LOGI(LM_TAG, "Backbone link to %X", address);
+
+        entry->backboneHeard = millis();
+    }
+
+    NeighborTableService::releaseInUse();
+}
+
+void BackboneService::lost(uint16_t address) {
+    NeighborTableService::setInUse();
+
+    NeighborEntry* entry = NeighborTableService::find(address);
+    if (entry != nullptr && entry->backboneHeard != 0) {
+        ESP_LOGW(LM_TAG, "Backbone link to %X lost", address);
+        entry->backboneHeard = 0;
+    }
+
+    NeighborTableService::releaseInUse();
+}
+
+bool BackboneService::isLink(uint16_t address) {
+    if (!enabled || address == 0)
+        return false;
+
+    NeighborTableService::setInUse();
+
+    NeighborEntry* entry = NeighborTableService::find(address);
+    bool link = entry != nullptr && isAlive(entry->backboneHeard);
+
+    NeighborTableService::releaseInUse();
+    return link;
+}
+
+size_t BackboneService::getLinksNum() {
+    if (!enabled)
+        return 0;
+
+    size_t links = 0;
+
+    NeighborTableService::setInUse();
+
+    for (size_t i = 0; i < NeighborTableService::size(); i++) {
+        if (isAlive(NeighborTableService::getEntry(i)->backboneHeard))
+            links++;
+    }
+
+    NeighborTableService::releaseInUse();
+    return links;
+}
+
+bool BackboneService::enabled = false;
@@ -0,0 +1,57 @@
+#ifndef _LORAMESHER_BACKBONE_SERVICE_H
+#define _LORAMESHER_BACKBONE_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Backbone links of the node, see LoraMesherConfig::secondaryPacketType. The secondary radio sends a copy of every
+ * HELLO on the FLRC or GFSK modem, and a neighbour heard on it is a backbone link for LM_BACKBONE_TIMEOUT ms, kept in its
+ * NeighborEntry. The routes are still learned from the LoRa HELLOs, the backbone only carries the unicast frames to the
+ * next hops that are backbone links.
+ *
+ */
+class BackboneService {
+public:
+
+    /**
+     * @brief Enable the backbone, once the secondary radio has started its high rate modem
+     *
+     */
+    static void init(bool enabled) { BackboneService::enabled = enabled; }
+
+    static bool isEnabled() { return enabled; }
+
+    /**
+     * @brief A HELLO of a neighbour has been received on the backbone
+     *
+     */
+    static void heard(uint16_t address);
+
+    /**
+     * @brief A frame to a neighbour has not been sent on the backbone, its link goes back to LoRa until its next HELLO on it
+     *
+     */
+    static void lost(uint16_t address);
+
+    /**
+     * @brief If the frames to a neighbour go on the backbone
+     *
+     * @param address Next hop, 0 for the broadcasts
+     */
+    static bool isLink(uint16_t address);
+
+    /**
+     * @brief Get the number of neighbours that are backbone links
+     *
+     * @return size_t
+     */
+    static size_t getLinksNum();
+
+private:
+
+    static bool enabled;
+
+    static bool isAlive(uint32_t heard) { return heard != 0 && millis() - heard <= LM_BACKBONE_TIMEOUT; }
+};
+
+#endif
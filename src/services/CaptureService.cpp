@@ -0,0 +1,153 @@
+#include "CaptureService.h"
+
+#include <string.h>
+
+#include "utilities/Crc16.hpp"
+
+LM_CaptureSink volatile CaptureService::captureSink = nullptr;
+LM_CaptureFormat CaptureService::format = CAPTURE_FORMAT_RECORDS;
+uint32_t CaptureService::capturedFrames = 0;
+uint32_t CaptureService::lastTimestamp = 0;
+uint32_t CaptureService::timestampWraps = 0;
+portMUX_TYPE CaptureService::mux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint8_t* putLe16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+static inline uint8_t* putLe32(uint8_t* out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+    return out + 4;
+}
+
+void CaptureService::startCapture(LM_CaptureSink sink, LM_CaptureFormat captureFormat) {
+    capturedFrames = 0;
+    format = captureFormat;
+
+    if (format == CAPTURE_FORMAT_PCAP) {
+        lastTimestamp = micros();
+        timestampWraps = 0;
+
+        // Microsecond timestamps, pcap version 2.4, UTC, frames up to the radio header and a full LoRa payload
+        uint8_t header[24];
+        uint8_t* current = putLe32(header, 0xA1B2C3D4);
+        current = putLe16(current, 2);
+        current = putLe16(current, 4);
+        current = putLe32(current, 0);
+        current = putLe32(current, 0);
+        current = putLe32(current, PCAP_RADIO_HEADER_LENGTH + UINT8_MAX);
+        putLe32(current, PCAP_LINKTYPE);
+        sink(header, sizeof(header));
+    }
+
+    captureSink = sink;
+
+    ESP_LOGI(LM_TAG, "Capture of the received frames started%s", format == CAPTURE_FORMAT_PCAP ? ", pcap" : "");
+}
+
+void CaptureService::stopCapture() {
+    captureSink = nullptr;
+
+    ESP_LOGI(LM_TAG, "Capture of the received frames stopped, %u frames", (unsigned) capturedFrames);
+}
+
+void CaptureService::capture(const uint8_t* frame, size_t length, int8_t rssi, int8_t snr, uint32_t timestamp, uint8_t flags,
+    const LM_CaptureRadio& radio) {
+    LM_CaptureSink sink = captureSink;
+    if (sink == nullptr)
+        return;
+
+    if (length > UINT8_MAX)
+        length = UINT8_MAX;
+
+    if (format == CAPTURE_FORMAT_PCAP) {
+        capturePcap(sink, frame, length, rssi, snr, timestamp, flags, radio);
+        return;
+    }
+
+    // In the stack, both receiving routines can capture at the same time
+    uint8_t record[RECORD_OVERHEAD + UINT8_MAX];
+    record[0] = 0xC5;
+    record[1] = 0x5C;
+    record[2] = CAPTURE_VERSION;
+    record[3] = flags;
+    record[4] = (uint8_t) length;
+    record[5] = timestamp & 0xFF;
+    record[6] = (timestamp >> 8) & 0xFF;
+    record[7] = (timestamp >> 16) & 0xFF;
+    record[8] = (timestamp >> 24) & 0xFF;
+    record[9] = (uint8_t) rssi;
+    record[10] = (uint8_t) snr;
+    memcpy(&record[11], frame, length);
+
+    uint16_t crc = LM_Crc16(&record[2], 9 + length);
+    record[11 + length] = crc >> 8;
+    record[12 + length] = crc & 0xFF;
+
+    capturedFrames++;
+    sink(record, RECORD_OVERHEAD + length);
+}
+
+void CaptureService::capturePcap(LM_CaptureSink sink, const uint8_t* frame, size_t length, int8_t rssi, int8_t snr,
+    uint32_t timestamp, uint8_t flags, const LM_CaptureRadio& radio) {
+    // micros() wraps every 71 minutes, the timestamps of the pcap records keep growing. Both receiving routines capture,
+    // a timestamp slightly older than the last one is not a wrap
+    portENTER_CRITICAL(&mux);
+    if (timestamp < lastTimestamp && lastTimestamp - timestamp > UINT32_MAX / 2)
+        timestampWraps++;
+    uint32_t wraps = timestampWraps;
+    if ((int32_t) (timestamp - lastTimestamp) > 0)
+        lastTimestamp = timestamp;
+    else if (timestamp > lastTimestamp && wraps > 0)
+        wraps--;
+    uint64_t extended = ((uint64_t) wraps << 32) | timestamp;
+    portEXIT_CRITICAL(&mux);
+
+    uint32_t captured = PCAP_RADIO_HEADER_LENGTH + length;
+
+    uint8_t record[16 + PCAP_RADIO_HEADER_LENGTH + UINT8_MAX];
+    uint8_t* current = putLe32(record, (uint32_t) (extended / 1000000));
+    current = putLe32(current, (uint32_t) (extended % 1000000));
+    current = putLe32(current, captured);
+    current = putLe32(current, captured);
+
+    *current++ = CAPTURE_VERSION;
+    *current++ = flags;
+    *current++ = (uint8_t) rssi;
+    *current++ = (uint8_t) snr;
+    current = putLe32(current, radio.frequency);
+    current = putLe16(current, radio.bandwidth);
+    *current++ = radio.spreadingFactor;
+    *current++ = radio.codingRate;
+    memcpy(current, frame, length);
+
+    capturedFrames++;
+    sink(record, 16 + captured);
+}
+
+size_t CaptureService::decode(const uint8_t* data, size_t length, LM_CapturedFrame& frame) {
+    if (length < RECORD_OVERHEAD || data[0] != 0xC5 || data[1] != 0x5C || data[2] != CAPTURE_VERSION)
+        return 0;
+
+    size_t frameLength = data[4];
+    if (length < RECORD_OVERHEAD + frameLength)
+        return 0;
+
+    uint16_t crc = ((uint16_t) data[11 + frameLength] << 8) | data[12 + frameLength];
+    if (crc != LM_Crc16(&data[2], 9 + frameLength))
+        return 0;
+
+    frame.flags = data[3];
+    frame.length = (uint8_t) frameLength;
+    frame.timestamp = (uint32_t) data[5] | ((uint32_t) data[6] << 8) | ((uint32_t) data[7] << 16) | ((uint32_t) data[8] << 24);
+    frame.rssi = (int8_t) data[9];
+    frame.snr = (int8_t) data[10];
+    frame.data = &data[11];
+
+    return RECORD_OVERHEAD + frameLength;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Sink of the captured frames, it writes the records to the serial port, a file...
+ * It is called from the receiving task, so it should only copy the record to a buffer
+ *
+ * @param data Record
+ * @param length Length in bytes
+ */
+typedef void (*LM_CaptureSink)(const uint8_t* data, size_t length);
+
+/**
+ * @brief Format of the capture
+ *
+ */
+enum LM_CaptureFormat : uint8_t {
+    // Compact binary records, they can be replayed, see CaptureService
+    CAPTURE_FORMAT_RECORDS = 0,
+    // pcap stream with the LoraMesher radio header, for Wireshark, see CaptureService
+    CAPTURE_FORMAT_PCAP = 1,
+};
+
+/**
+ * @brief Radio parameters of a captured frame, written in the pcap radio header
+ *
+ */
+struct LM_CaptureRadio {
+    // Frequency in kHz
+    uint32_t frequency;
+    // Bandwidth in units of 100 Hz
+    uint16_t bandwidth;
+    uint8_t spreadingFactor;
+    // Coding rate denominator, 5 to 8
+    uint8_t codingRate;
+};
+
+/**
+ * @brief Frame decoded from a capture record
+ *
+ */
+struct LM_CapturedFrame {
+    // micros() when the receive interrupt fired
+    uint32_t timestamp;
+    int8_t rssi;
+    int8_t snr;
+    // CAPTURE_CRC_ERROR_F, CAPTURE_SECONDARY_F
+    uint8_t flags;
+    uint8_t length;
+    // Frame as received on air, it points inside the record
+    const uint8_t* data;
+};
+
+/**
+ * @brief Captures the raw frames received by the radios, before they are decoded, in a compact binary log.
+ * Every frame is one record:
+ * | 0xC5 | 0x5C | version | flags | length | timestamp, little endian | rssi | snr | frame, length bytes | CRC-16/CCITT-FALSE, big endian |
+ * The CRC covers from the version to the end of the frame, so the records can be extracted from a serial log mixed with text.
+ *
+ * A capture is replayed with the LM_ReplayModule, the frames go through the receiving path as if they were received again.
+ *
+ * With CAPTURE_FORMAT_PCAP the sink receives a pcap stream instead: the global header of LINKTYPE_USER0 (147) when the
+ * capture starts, then every frame in a pcap record, stamped with the micros() of its receive interrupt since the boot,
+ * after a radio header of PCAP_RADIO_HEADER_LENGTH bytes:
+ * | version | flags | rssi | snr | frequency in kHz, little endian (4) | bandwidth in 100 Hz, little endian (2) | sf | cr |
+ * utilities/wireshark/loramesher.lua dissects the radio header and the LoraMesher packets.
+ */
+class CaptureService {
+public:
+    /**
+     * @brief Start capturing the received frames
+     *
+     * @param sink Sink of the records
+     * @param format Format of the records, the pcap global header is given to the sink before returning
+     */
+    static void startCapture(LM_CaptureSink sink, LM_CaptureFormat format = CAPTURE_FORMAT_RECORDS);
+
+    /**
+     * @brief Stop capturing, the record being written is finished
+     *
+     */
+    static void stopCapture();
+
+    /**
+     * @brief Check if the frames are being captured
+     *
+     * @return true If there is a sink
+     */
+    static bool isCapturing() { return captureSink != nullptr; }
+
+    /**
+     * @brief Capture a received frame. Called by the receiving routines
+     *
+     * @param frame Frame as received on air
+     * @param length Length in bytes
+     * @param rssi RSSI
+     * @param snr SNR
+     * @param timestamp micros() when the receive interrupt fired
+     * @param flags CAPTURE_CRC_ERROR_F, CAPTURE_SECONDARY_F
+     * @param radio Radio parameters of the receiver, in the pcap records only
+     */
+    static void capture(const uint8_t* frame, size_t length, int8_t rssi, int8_t snr, uint32_t timestamp, uint8_t flags,
+        const LM_CaptureRadio& radio);
+
+    /**
+     * @brief Decode the record at the start of a buffer
+     *
+     * @param data Buffer
+     * @param length Length of the buffer in bytes
+     * @param frame Decoded frame, it points inside the buffer
+     * @return size_t Length of the record, 0 if there is no valid record at the start of the buffer
+     */
+    static size_t decode(const uint8_t* data, size_t length, LM_CapturedFrame& frame);
+
+    /**
+     * @brief Get the number of frames captured
+     *
+     * @return uint32_t
+     */
+    static uint32_t getCapturedFramesNum() { return capturedFrames; }
+
+    /**
+     * @brief Version of the records
+     *
+     */
+    static const uint8_t CAPTURE_VERSION = 1;
+
+    /**
+     * @brief Size in bytes of a record without the frame
+     *
+     */
+    static const size_t RECORD_OVERHEAD = 13;
+
+    /**
+     * @brief Link type of the pcap stream, LINKTYPE_USER0
+     *
+     */
+    static const uint32_t PCAP_LINKTYPE = 147;
+
+    /**
+     * @brief Size in bytes of the radio header before the frame in a pcap record
+     *
+     */
+    static const size_t PCAP_RADIO_HEADER_LENGTH = 12;
+
+    /**
+     * @brief The frame had a CRC error
+     *
+     */
+    static const uint8_t CAPTURE_CRC_ERROR_F = 0b00000001;
+
+    /**
+     * @brief The frame was received by the secondary receiver
+     *
+     */
+    static const uint8_t CAPTURE_SECONDARY_F = 0b00000010;
+
+private:
+    static LM_CaptureSink volatile captureSink;
+
+    static LM_CaptureFormat format;
+
+    static uint32_t capturedFrames;
+
+    /**
+     * @brief Last timestamp of the pcap records and wraps of micros() before it, protected by the mux
+     *
+     */
+    static uint32_t lastTimestamp;
+
+    static uint32_t timestampWraps;
+
+    static portMUX_TYPE mux;
+
+    /**
+     * @brief Write a frame as a pcap record
+     *
+     */
+    static void capturePcap(LM_CaptureSink sink, const uint8_t* frame, size_t length, int8_t rssi, int8_t snr,
+        uint32_t timestamp, uint8_t flags, const LM_CaptureRadio& radio);
+};
@@ -0,0 +1,283 @@
+#include "CheckpointService.h"
+
+#include "RoutingTableService.h"
+#include "NeighborTableService.h"
+
+#include "utilities/Crc16.hpp"
+
+static constexpr uint32_t CHECKPOINT_MAGIC = 0x50434D4C; // "LMCP"
+
+// Records read or written at a time, on the stack
+static constexpr size_t RECORDS_BATCH = 16;
+
+#pragma pack(1)
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    uint16_t routes;
+    uint16_t neighbors;
+    uint32_t trickleInterval;
+    uint16_t crc;
+    uint16_t reserved;
+};
+
+struct CheckpointRoute {
+    NetworkNode node;
+    uint16_t via;
+};
+
+struct CheckpointNeighbor {
+    uint16_t address;
+    int16_t rssi;
+    int8_t snr;
+    float etx;
+    uint32_t etxWindow;
+    uint8_t etxWindowFilled;
+    uint8_t etxWindowIndex;
+};
+#pragma pack()
+
+static_assert(sizeof(CheckpointHeader) + RTMAXSIZE * sizeof(CheckpointRoute) + LM_NEIGHBOR_TABLE_SIZE * sizeof(CheckpointNeighbor)
+    <= LM_CHECKPOINT_SLOT_SIZE, "A checkpoint of a full routing and neighbour table does not fit in LM_CHECKPOINT_SLOT_SIZE");
+
+static inline uint32_t getAddress(uint32_t slot, uint32_t offset) {
+    return slot * LM_CHECKPOINT_SLOT_SIZE + offset;
+}
+
+static inline uint32_t getRecordsLength(const CheckpointHeader& header) {
+    return header.routes * sizeof(CheckpointRoute) + header.neighbors * sizeof(CheckpointNeighbor);
+}
+
+/**
+ * @brief Read the header of a slot and check that its records match its CRC
+ *
+ */
+static bool readValid(const esp_partition_t* partition, uint32_t slot, CheckpointHeader& header) {
+    if (esp_partition_read(partition, getAddress(slot, 0), &header, sizeof(header)) != ESP_OK ||
+        header.magic != CHECKPOINT_MAGIC || sizeof(header) + getRecordsLength(header) > LM_CHECKPOINT_SLOT_SIZE)
+        return false;
+
+    uint8_t block[64];
+    uint16_t crc = 0xFFFF;
+    uint32_t length = getRecordsLength(header);
+    for (uint32_t offset = 0; offset < length; offset += sizeof(block)) {
+        uint32_t size = length - offset < sizeof(block) ? length - offset : sizeof(block);
+        if (esp_partition_read(partition, getAddress(slot, sizeof(header) + offset), block, size) != ESP_OK)
+            return false;
+
+        crc = LM_Crc16(block, size, crc);
+    }
+
+    return crc == header.crc;
+}
+
+bool CheckpointService::init(const char* label) {
+    if (partition != nullptr) {
+        ESP_LOGW(LM_TAG, "Checkpoints already initialized");
+        return true;
+    }
+
+    const esp_partition_t* found = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (found == nullptr) {
+        ESP_LOGE(LM_TAG, "Checkpoint partition %s not found", label);
+        return false;
+    }
+
+    slots = found->size / LM_CHECKPOINT_SLOT_SIZE;
+    if (slots < 2) {
+        ESP_LOGE(LM_TAG, "Checkpoint partition %s too small, %d bytes", label, (int) found->size);
+        return false;
+    }
+
+    partition = found;
+
+    // The first checkpoint goes to the first slot
+    sequence = 0;
+    newestSlot = slots - 1;
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        CheckpointHeader header;
+        if (!readValid(partition, slot, header))
+            continue;
+
+        if (sequence == 0 || (int32_t) (header.sequence - sequence) > 0) {
+            sequence = header.sequence;
+            newestSlot = slot;
+        }
+    }
+
+    lastSave = millis();
+    savedChanges = RoutingTableService::getChangeCount();
+
+    ESP_LOGI(LM_TAG, "Checkpoints of %d slots open, newest %d", (int) slots, (int) sequence);
+    return true;
+}
+
+bool CheckpointService::restore(uint32_t& trickleInterval) {
+    trickleInterval = 0;
+
+    CheckpointHeader header;
+    if (sequence == 0 || !readValid(partition, newestSlot, header))
+        return false;
+
+    uint32_t offset = sizeof(header);
+    size_t restoredRoutes = 0;
+
+    CheckpointRoute routes[RECORDS_BATCH];
+    for (size_t i = 0; i < header.routes; i += RECORDS_BATCH) {
+        size_t length = header.routes - i < RECORDS_BATCH ? header.routes - i : RECORDS_BATCH;
+        if (esp_partition_read(partition, getAddress(newestSlot, offset), routes, length * sizeof(CheckpointRoute)) != ESP_OK)
+            return false;
+        offset += length * sizeof(CheckpointRoute);
+
+        for (size_t j = 0; j < length; j++) {
+            if (RoutingTableService::addProvisionalRoute(routes[j].node, routes[j].via, LM_CHECKPOINT_ROUTE_TIMEOUT * 1000))
+                restoredRoutes++;
+        }
+    }
+
+    RoutingTableService::publishSnapshot();
+
+    CheckpointNeighbor neighbors[RECORDS_BATCH];
+    for (size_t i = 0; i < header.neighbors; i += RECORDS_BATCH) {
+        size_t length = header.neighbors - i < RECORDS_BATCH ? header.neighbors - i : RECORDS_BATCH;
+        if (esp_partition_read(partition, getAddress(newestSlot, offset), neighbors, length * sizeof(CheckpointNeighbor)) != ESP_OK)
+            return false;
+        offset += length * sizeof(CheckpointNeighbor);
+
+        NeighborTableService::setInUse();
+        for (size_t j = 0; j < length; j++) {
+            NeighborEntry* entry = NeighborTableService::getOrCreate(neighbors[j].address);
+            entry->rssi = neighbors[j].rssi;
+            entry->snr = neighbors[j].snr;
+            entry->hasSignal = true;
+            entry->etx = neighbors[j].etx;
+            entry->etxWindow = neighbors[j].etxWindow;
+            entry->etxWindowFilled = neighbors[j].etxWindowFilled < LM_ETX_WINDOW_SIZE ? neighbors[j].etxWindowFilled : LM_ETX_WINDOW_SIZE;
+            entry->etxWindowIndex = neighbors[j].etxWindowIndex % LM_ETX_WINDOW_SIZE;
+            entry->notifiedEtx = entry->etx;
+            entry->notifiedSnr = entry->snr;
+            entry->lastUpdate = millis();
+        }
+        NeighborTableService::releaseInUse();
+    }
+
+    RoutingTableService::invalidateRouteCosts();
+
+    trickleInterval = header.trickleInterval;
+
+    // The restored routes are not a change to checkpoint again
+    savedChanges = RoutingTableService::getChangeCount();
+
+    ESP_LOGI(LM_TAG, "Checkpoint %d restored, %d routes and %d neighbors", (int) sequence, (int) restoredRoutes, (int) header.neighbors);
+    return true;
+}
+
+bool CheckpointService::save(uint32_t trickleInterval) {
+    uint32_t slot = (newestSlot + 1) % slots;
+    uint32_t changes = RoutingTableService::getChangeCount();
+
+    lastSave = millis();
+
+    if (esp_partition_erase_range(partition, getAddress(slot, 0), LM_CHECKPOINT_SLOT_SIZE) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "Checkpoint slot %d not erased", (int) slot);
+        return false;
+    }
+
+    CheckpointHeader header;
+    header.magic = CHECKPOINT_MAGIC;
+    header.sequence = sequence + 1 == 0 ? 1 : sequence + 1;
+    header.routes = 0;
+    header.neighbors = 0;
+    header.trickleInterval = trickleInterval;
+    header.crc = 0xFFFF;
+    header.reserved = 0xFFFF;
+
+    uint32_t offset = sizeof(header);
+
+    {
+        RoutingTableView view;
+
+        CheckpointRoute routes[RECORDS_BATCH];
+        for (size_t i = 0; i < view.size(); i += RECORDS_BATCH) {
+            size_t length = view.size() - i < RECORDS_BATCH ? view.size() - i : RECORDS_BATCH;
+            for (size_t j = 0; j < length; j++) {
+                routes[j].node = view[i + j].networkNode;
+                routes[j].via = view[i + j].via;
+            }
+
+            uint32_t size = length * sizeof(CheckpointRoute);
+            if (esp_partition_write(partition, getAddress(slot, offset), routes, size) != ESP_OK)
+                return false;
+
+            header.crc = LM_Crc16(reinterpret_cast<uint8_t*>(routes), size, header.crc);
+            header.routes += length;
+            offset += size;
+        }
+    }
+
+    // The neighbors are copied a batch at a time, the table is not locked while the flash is written
+    CheckpointNeighbor neighbors[RECORDS_BATCH];
+    for (size_t i = 0;; i += RECORDS_BATCH) {
+        NeighborTableService::setInUse();
+        size_t size = NeighborTableService::size();
+        size_t length = i >= size ? 0 : size - i < RECORDS_BATCH ? size - i : RECORDS_BATCH;
+        for (size_t j = 0; j < length; j++) {
+            const NeighborEntry* entry = NeighborTableService::getEntry(i + j);
+            neighbors[j].address = entry->address;
+            neighbors[j].rssi = entry->rssi;
+            neighbors[j].snr = entry->snr;
+            neighbors[j].etx = entry->etx;
+            neighbors[j].etxWindow = entry->etxWindow;
+            neighbors[j].etxWindowFilled = entry->etxWindowFilled;
+            neighbors[j].etxWindowIndex = entry->etxWindowIndex;
+        }
+        NeighborTableService::releaseInUse();
+
+        if (length == 0)
+            break;
+
+        uint32_t bytes = length * sizeof(CheckpointNeighbor);
+        if (esp_partition_write(partition, getAddress(slot, offset), neighbors, bytes) != ESP_OK)
+            return false;
+
+        header.crc = LM_Crc16(reinterpret_cast<uint8_t*>(neighbors), bytes, header.crc);
+        header.neighbors += length;
+        offset += bytes;
+    }
+
+    if (esp_partition_write(partition, getAddress(slot, 0), &header, sizeof(header)) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "Checkpoint header not written");
+        return false;
+    }
+
+    newestSlot = slot;
+    sequence = header.sequence;
+    savedChanges = changes;
+    saved++;
+
+    ESP_LOGI(LM_TAG, "Checkpoint %d written, %d routes and %d neighbors", (int) sequence, (int) header.routes, (int) header.neighbors);
+    return true;
+}
+
+uint32_t CheckpointService::getTimeUntilDue() {
+    if (partition == nullptr)
+        return UINT32_MAX;
+
+    uint32_t elapsed = millis() - lastSave;
+    bool changed = RoutingTableService::getChangeCount() != savedChanges;
+    uint32_t interval = changed ? LM_CHECKPOINT_MIN_INTERVAL * 1000 : LM_CHECKPOINT_INTERVAL * 1000;
+    if (elapsed >= interval)
+        return 0;
+
+    // A change made in the meantime is found at the next check
+    uint32_t untilDue = interval - elapsed;
+    return changed || untilDue < LM_CHECKPOINT_MIN_INTERVAL * 1000 ? untilDue : LM_CHECKPOINT_MIN_INTERVAL * 1000;
+}
+
+const esp_partition_t* CheckpointService::partition = nullptr;
+uint32_t CheckpointService::slots = 0;
+uint32_t CheckpointService::newestSlot = 0;
+uint32_t CheckpointService::sequence = 0;
+uint32_t CheckpointService::lastSave = 0;
+uint32_t CheckpointService::savedChanges = 0;
+uint32_t CheckpointService::saved = 0;
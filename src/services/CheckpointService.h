@@ -0,0 +1,99 @@
+#ifndef _LORAMESHER_CHECKPOINT_SERVICE_H
+#define _LORAMESHER_CHECKPOINT_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include <esp_partition.h>
+
+/**
+ * @brief Checkpoints of the routing state in a flash data partition for a warm restart, see
+ * LoraMesherConfig::checkpointPartition. The partition is a ring of LM_CHECKPOINT_SLOT_SIZE slots, every checkpoint
+ * erases and writes the next one:
+ *
+ *   Header: magic (4), sequence (4), routes (2), neighbors (2), Trickle interval of the HELLOs (4), CRC-16 of the records (2),
+ *   reserved (2)
+ *   Route: network node (5), via (2)
+ *   Neighbor: address (2), RSSI (2), SNR (1), ETX (4), ETX window (4), results in the window (1), next result (1)
+ *
+ * The header is written after the records, so a checkpoint cut by a reset is not found. After a reboot the newest
+ * checkpoint gives the routes, provisional until the neighbors advertise them again, and the link metrics of the
+ * neighbors, so the node routes data before it hears the first HELLOs. The times of the entries are not kept, the clock
+ * starts again with the boot.
+ *
+ */
+class CheckpointService {
+public:
+
+    /**
+     * @brief Open the partition of the checkpoints and find the newest one
+     *
+     * @param label Label of the partition, at least two slots
+     * @return true If the partition is open
+     */
+    static bool init(const char* label);
+
+    /**
+     * @brief Returns if the partition is open
+     *
+     */
+    static bool isEnabled() { return partition != nullptr; }
+
+    /**
+     * @brief Restore the newest checkpoint. The routes expire after LM_CHECKPOINT_ROUTE_TIMEOUT s unless they are
+     * advertised again, call it before the node starts
+     *
+     * @param trickleInterval Output Trickle interval of the HELLOs in ms, 0 if it was not running
+     * @return true If a checkpoint has been restored
+     */
+    static bool restore(uint32_t& trickleInterval);
+
+    /**
+     * @brief Write a checkpoint of the routing table and of the link metrics of the neighbors in the next slot
+     *
+     * @param trickleInterval Trickle interval of the HELLOs in ms, 0 if it is not running
+     * @return true If it has been written
+     */
+    static bool save(uint32_t trickleInterval);
+
+    /**
+     * @brief Ms until the next checkpoint is due: LM_CHECKPOINT_MIN_INTERVAL s after the last one if the routing table
+     * has changed since, else LM_CHECKPOINT_INTERVAL s after it. Without changes it is checked again every
+     * LM_CHECKPOINT_MIN_INTERVAL s
+     *
+     * @return uint32_t 0 if it is due, UINT32_MAX without the partition
+     */
+    static uint32_t getTimeUntilDue();
+
+    /**
+     * @brief Get the number of checkpoints written since the boot
+     *
+     * @return uint32_t
+     */
+    static uint32_t getSavedNum() { return saved; }
+
+private:
+
+    static const esp_partition_t* partition;
+
+    static uint32_t slots;
+
+    /**
+     * @brief Slot and sequence of the newest checkpoint, sequence 0 if there is none
+     *
+     */
+    static uint32_t newestSlot;
+
+    static uint32_t sequence;
+
+    /**
+     * @brief millis() of the last checkpoint and RoutingTableService::getChangeCount then
+     *
+     */
+    static uint32_t lastSave;
+
+    static uint32_t savedChanges;
+
+    static uint32_t saved;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "CompactHeaderService.h"
+
+#include "PacketService.h"
+
+// Largest difference between the header in memory and the compact header on air
+static_assert(sizeof(ControlPacket) - (sizeof(uint16_t) * 3 + 1 + 1 + 1) == LM_COMPACT_HEADER_EXPANSION,
+    "LM_COMPACT_HEADER_EXPANSION does not match the compact header");
+
+// The type byte is sent as is, the route discovery frames must not take the fields of the data or the route packets
+static_assert(((ROUTE_REQUEST_P | ROUTE_REPLY_P) & (DATA_P | HELLO_P)) == 0,
+    "The route discovery codes must have the PacketHeader only");
+
+// Address fields, type byte
+static constexpr size_t COMPACT_BASE_LENGTH = sizeof(uint16_t) * 2 + 1;
+
+// Maximum length of a varint of 16 bits
+static constexpr size_t MAX_VARINT_LENGTH = 3;
+
+static size_t getVarintLength(uint16_t value) {
+    if (value < 0x80)
+        return 1;
+    if (value < 0x4000)
+        return 2;
+    return 3;
+}
+
+static void writeVarint(uint8_t*& current, uint16_t value) {
+    while (value >= 0x80) {
+        *current++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *current++ = value;
+}
+
+static bool readVarint(const uint8_t*& current, const uint8_t* end, uint16_t& value) {
+    value = 0;
+    for (uint8_t shift = 0;; shift += 7) {
+        if (current >= end || shift > 14)
+            return false;
+
+        uint8_t byte = *current++;
+        value |= (uint16_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+}
+
+bool CompactHeaderService::hasId(uint8_t type) {
+    return PacketService::isOnlyDataPacket(type);
+}
+
+size_t CompactHeaderService::getMemoryHeaderLength(uint8_t type) {
+    if (PacketService::isControlPacket(type))
+        return sizeof(ControlPacket);
+
+    if (PacketService::isDataPacket(type))
+        return sizeof(DataPacket);
+
+    return sizeof(PacketHeader);
+}
+
+size_t CompactHeaderService::getHeaderLength(uint8_t type) {
+    size_t length = COMPACT_BASE_LENGTH + (hasId(type) ? 1 : 0);
+
+    if (PacketService::isDataPacket(type))
+        length += sizeof(uint16_t);
+
+    if (PacketService::isControlPacket(type))
+        length += MAX_VARINT_LENGTH * 2;
+
+    return length;
+}
+
+size_t CompactHeaderService::getHeaderLength(Packet<uint8_t>* p) {
+    size_t length = COMPACT_BASE_LENGTH + (hasId(p->type) ? 1 : 0);
+
+    if (PacketService::isDataPacket(p->type))
+        length += sizeof(uint16_t);
+
+    if (PacketService::isControlPacket(p->type))
+        length += getVarintLength(PacketService::controlPacket(p)->seq_id) + getVarintLength(PacketService::controlPacket(p)->number);
+
+    return length;
+}
+
+size_t CompactHeaderService::getPacketLength(Packet<uint8_t>* p) {
+    size_t memoryHeaderLength = getMemoryHeaderLength(p->type);
+    if (p->packetSize < memoryHeaderLength)
+        return p->packetSize;
+
+    return p->packetSize - memoryHeaderLength + getHeaderLength(p);
+}
+
+size_t CompactHeaderService::encode(Packet<uint8_t>* p, uint8_t* out, size_t maxLength) {
+    size_t memoryHeaderLength = getMemoryHeaderLength(p->type);
+    if (p->packetSize < memoryHeaderLength || getPacketLength(p) > maxLength)
+        return 0;
+
+    uint8_t* current = out;
+    memcpy(current, &p->dst, sizeof(uint16_t));
+    current += sizeof(uint16_t);
+    memcpy(current, &p->src, sizeof(uint16_t));
+    current += sizeof(uint16_t);
+
+    *current++ = p->type;
+    if (hasId(p->type))
+        *current++ = p->id;
+
+    if (PacketService::isDataPacket(p->type)) {
+        uint16_t via = PacketService::dataPacket(p)->via;
+        memcpy(current, &via, sizeof(uint16_t));
+        current += sizeof(uint16_t);
+    }
+
+    if (PacketService::isControlPacket(p->type)) {
+        ControlPacket* control = PacketService::controlPacket(p);
+        writeVarint(current, control->seq_id);
+        writeVarint(current, control->number);
+    }
+
+    size_t payloadLength = p->packetSize - memoryHeaderLength;
+    memcpy(current, reinterpret_cast<uint8_t*>(p) + memoryHeaderLength, payloadLength);
+    current += payloadLength;
+
+    return current - out;
+}
+
+size_t CompactHeaderService::decode(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength) {
+    if (length < COMPACT_BASE_LENGTH)
+        return 0;
+
+    const uint8_t* current = in;
+    const uint8_t* end = in + length;
+
+    Packet<uint8_t>* p = reinterpret_cast<Packet<uint8_t>*>(out);
+
+    memcpy(&p->dst, current, sizeof(uint16_t));
+    current += sizeof(uint16_t);
+    memcpy(&p->src, current, sizeof(uint16_t));
+    current += sizeof(uint16_t);
+
+    p->type = *current++;
+    p->id = 0;
+
+    size_t memoryHeaderLength = getMemoryHeaderLength(p->type);
+    if (memoryHeaderLength > maxLength)
+        return 0;
+
+    if (hasId(p->type)) {
+        if (current >= end)
+            return 0;
+        p->id = *current++;
+    }
+
+    if (PacketService::isDataPacket(p->type)) {
+        if (end - current < (ptrdiff_t) sizeof(uint16_t))
+            return 0;
+
+        uint16_t via;
+        memcpy(&via, current, sizeof(uint16_t));
+        current += sizeof(uint16_t);
+        PacketService::dataPacket(p)->via = via;
+    }
+
+    if (PacketService::isControlPacket(p->type)) {
+        uint16_t seqId, number;
+        if (!readVarint(current, end, seqId) || !readVarint(current, end, number))
+            return 0;
+
+        ControlPacket* control = PacketService::controlPacket(p);
+        control->seq_id = seqId;
+        control->number = number;
+    }
+
+    size_t payloadLength = end - current;
+    size_t packetSize = memoryHeaderLength + payloadLength;
+    if (packetSize > maxLength || packetSize > UINT8_MAX)
+        return 0;
+
+    memcpy(out + memoryHeaderLength, current, payloadLength);
+    p->packetSize = packetSize;
+
+    return packetSize;
+}
@@ -0,0 +1,79 @@
+#ifndef _LORAMESHER_COMPACT_HEADER_SERVICE_H
+#define _LORAMESHER_COMPACT_HEADER_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/Packet.h"
+
+/**
+ * @brief Compact header used on air when LM_COMPACT_HEADER is enabled.
+ * The packets keep the PacketHeader layout in memory, they are encoded before sending them and decoded when received:
+ *
+ *   dst (2), src (2)
+ *   type (1)
+ *   id (1), only for the data packets with an id, DATA_P and TRACED_DATA_P, used to detect the duplicated packets
+ *   via (2), for data packets
+ *   seq_id and number as varints (1 to 3 each), for control packets
+ *   payload
+ *
+ * The packetSize is not sent, it is the length of the received frame plus the removed bytes. The fields sent depend only on
+ * the type, so the type byte is sent as is and every code is free for the packet types.
+ */
+class CompactHeaderService {
+public:
+    /**
+     * @brief Maximum length of the compact header of a packet type
+     *
+     * @param type Type of the packet
+     * @return size_t Length in bytes, with the largest varint
+     */
+    static size_t getHeaderLength(uint8_t type);
+
+    /**
+     * @brief Length of the compact header of a packet
+     *
+     * @param p Packet
+     * @return size_t Length in bytes
+     */
+    static size_t getHeaderLength(Packet<uint8_t>* p);
+
+    /**
+     * @brief Length of the packet on air
+     *
+     * @param p Packet
+     * @return size_t Length in bytes
+     */
+    static size_t getPacketLength(Packet<uint8_t>* p);
+
+    /**
+     * @brief Encode a packet with the compact header
+     *
+     * @param p Packet to be encoded
+     * @param out Output buffer
+     * @param maxLength Size of the output buffer
+     * @return size_t Length of the encoded packet or 0 if it does not fit
+     */
+    static size_t encode(Packet<uint8_t>* p, uint8_t* out, size_t maxLength);
+
+    /**
+     * @brief Decode a received frame into a packet with the PacketHeader layout
+     *
+     * @param in Received frame
+     * @param length Length of the received frame
+     * @param out Output packet buffer
+     * @param maxLength Size of the output packet buffer
+     * @return size_t Size of the decoded packet or 0 if the frame is malformed or does not fit
+     */
+    static size_t decode(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength);
+
+private:
+    /**
+     * @brief Size of the header of the type in memory
+     *
+     */
+    static size_t getMemoryHeaderLength(uint8_t type);
+
+    static bool hasId(uint8_t type);
+};
+
+#endif
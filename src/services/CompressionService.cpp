@@ -0,0 +1,184 @@
+#include "CompressionService.h"
+
+// Usual words of the sensor and JSON payloads, the most frequent ones at the end, closer to the payload
+static const char DICTIONARY[] =
+    "\"error\":\"status\":\"value\":\"node\":\"id\":\"type\":\"time\":\"timestamp\":\"lat\":\"lon\":\"alt\":"
+    "\"rssi\":\"snr\":\"voltage\":\"current\":\"battery\":\"pressure\":\"humidity\":\"temperature\":"
+    "true,false,null,0.00,0000,\"},{\"\":\"\",\"\":";
+
+static constexpr size_t DICTIONARY_LENGTH = sizeof(DICTIONARY) - 1;
+
+static constexpr size_t MIN_MATCH = 3;
+static constexpr size_t MAX_MATCH = MIN_MATCH + 0x0F;
+static constexpr size_t MAX_OFFSET = 0x800;
+static constexpr size_t MAX_LITERALS = 0x80;
+
+// Largest varint of 32 bits
+static constexpr size_t MAX_VARINT_LENGTH = 5;
+
+/**
+ * @brief Byte of the dictionary followed by the data
+ *
+ */
+static inline uint8_t getWindowByte(const uint8_t* data, size_t position) {
+    return position < DICTIONARY_LENGTH ? (uint8_t) DICTIONARY[position] : data[position - DICTIONARY_LENGTH];
+}
+
+size_t CompressionService::encode(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength) {
+    // The compressed payload is only used if it is shorter than the raw one
+    size_t rawLength = getMaxEncodedLength(length);
+
+    if (maxLength > 1 + MAX_VARINT_LENGTH && rawLength > 1 + MAX_VARINT_LENGTH) {
+        size_t headerLength = 0;
+        out[headerLength++] = CODEC_LZ;
+
+        uint32_t value = length;
+        while (value >= 0x80) {
+            out[headerLength++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        out[headerLength++] = value;
+
+        size_t tokensLength = compress(in, length, out + headerLength, std::min(maxLength, rawLength - 1) - headerLength);
+        if (tokensLength > 0)
+            return headerLength + tokensLength;
+    }
+
+    if (rawLength > maxLength)
+        return 0;
+
+    out[0] = CODEC_RAW;
+    memcpy(out + 1, in, length);
+    return rawLength;
+}
+
+size_t CompressionService::compress(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength) {
+    size_t outLength = 0;
+    size_t literalStart = 0;
+    size_t position = 0;
+
+    auto flushLiterals = [&]() -> bool {
+        while (literalStart < position) {
+            size_t literals = std::min(position - literalStart, MAX_LITERALS);
+            if (outLength + 1 + literals > maxLength)
+                return false;
+
+            out[outLength++] = literals - 1;
+            memcpy(out + outLength, in + literalStart, literals);
+            outLength += literals;
+            literalStart += literals;
+        }
+        return true;
+    };
+
+    while (position < length) {
+        size_t current = DICTIONARY_LENGTH + position;
+        size_t maxMatch = std::min(MAX_MATCH, length - position);
+        size_t bestLength = 0;
+        size_t bestOffset = 0;
+
+        // Longest match of the window, the closest one if they are equal
+        for (size_t offset = 1; maxMatch >= MIN_MATCH && offset <= MAX_OFFSET && offset <= current; offset++) {
+            size_t start = current - offset;
+            size_t matchLength = 0;
+            while (matchLength < maxMatch && getWindowByte(in, start + matchLength) == in[position + matchLength])
+                matchLength++;
+
+            if (matchLength > bestLength) {
+                bestLength = matchLength;
+                bestOffset = offset;
+                if (matchLength == maxMatch)
+                    break;
+            }
+        }
+
+        if (bestLength < MIN_MATCH) {
+            position++;
+            continue;
+        }
+
+        if (!flushLiterals() || outLength + 2 > maxLength)
+            return 0;
+
+        out[outLength++] = 0x80 | ((bestLength - MIN_MATCH) << 3) | ((bestOffset - 1) >> 8);
+        out[outLength++] = (bestOffset - 1) & 0xFF;
+
+        position += bestLength;
+        literalStart = position;
+    }
+
+    if (!flushLiterals())
+        return 0;
+
+    return outLength;
+}
+
+size_t CompressionService::getDecodedLength(const uint8_t* in, size_t length) {
+    if (length == 0)
+        return 0;
+
+    if (in[0] == CODEC_RAW)
+        return length - 1;
+
+    if (in[0] != CODEC_LZ)
+        return 0;
+
+    uint32_t value = 0;
+    for (size_t i = 1; i < length && i <= MAX_VARINT_LENGTH; i++) {
+        value |= (uint32_t) (in[i] & 0x7F) << (7 * (i - 1));
+        if ((in[i] & 0x80) == 0)
+            return value;
+    }
+
+    return 0;
+}
+
+size_t CompressionService::decode(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength) {
+    size_t decodedLength = getDecodedLength(in, length);
+    if (decodedLength == 0 || decodedLength > maxLength)
+        return 0;
+
+    if (in[0] == CODEC_RAW) {
+        memcpy(out, in + 1, decodedLength);
+        return decodedLength;
+    }
+
+    // Skip the varint
+    size_t i = 1;
+    while (in[i] & 0x80)
+        i++;
+    i++;
+
+    size_t outLength = 0;
+    while (i < length) {
+        uint8_t token = in[i++];
+
+        if ((token & 0x80) == 0) {
+            size_t literals = token + 1;
+            if (i + literals > length || outLength + literals > decodedLength)
+                return 0;
+
+            memcpy(out + outLength, in + i, literals);
+            i += literals;
+            outLength += literals;
+            continue;
+        }
+
+        if (i >= length)
+            return 0;
+
+        size_t matchLength = ((token >> 3) & 0x0F) + MIN_MATCH;
+        size_t offset = (((size_t) (token & 0x07) << 8) | in[i++]) + 1;
+        size_t current = DICTIONARY_LENGTH + outLength;
+        if (offset > current || outLength + matchLength > decodedLength)
+            return 0;
+
+        // The copy can overlap the bytes it writes
+        for (size_t j = 0; j < matchLength; j++) {
+            out[outLength] = getWindowByte(out, current - offset + j);
+            outLength++;
+        }
+    }
+
+    return outLength == decodedLength ? decodedLength : 0;
+}
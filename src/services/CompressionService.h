@@ -0,0 +1,70 @@
+#ifndef _LORAMESHER_COMPRESSION_SERVICE_H
+#define _LORAMESHER_COMPRESSION_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Compression of the application payloads, see LoraMesherConfig::compressPayloads.
+ * An encoded payload starts with the codec byte:
+ *
+ *   CODEC_RAW (1), payload
+ *   CODEC_LZ (1), length of the payload as a varint (1 to 5), tokens
+ *
+ * The LZ tokens are a literal run, 0LLLLLLL and L + 1 bytes, or a match, 1LLLLOOO OOOOOOOO of L + 3 bytes copied from
+ * O + 1 bytes before. The matches can start inside a static dictionary of the usual words of the sensor and JSON payloads,
+ * placed before the payload, so the short payloads are compressed too.
+ */
+class CompressionService {
+public:
+    static constexpr uint8_t CODEC_RAW = 0;
+    static constexpr uint8_t CODEC_LZ = 1;
+
+    /**
+     * @brief Largest length of an encoded payload
+     *
+     * @param length Length of the payload
+     * @return size_t Length in bytes
+     */
+    static size_t getMaxEncodedLength(size_t length) { return 1 + length; }
+
+    /**
+     * @brief Encode a payload, compressed if it gets shorter
+     *
+     * @param in Payload
+     * @param length Length of the payload
+     * @param out Output buffer
+     * @param maxLength Size of the output buffer
+     * @return size_t Length of the encoded payload or 0 if it does not fit
+     */
+    static size_t encode(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength);
+
+    /**
+     * @brief Length of the payload of an encoded payload
+     *
+     * @param in Encoded payload
+     * @param length Length of the encoded payload
+     * @return size_t Length in bytes or 0 if it is malformed
+     */
+    static size_t getDecodedLength(const uint8_t* in, size_t length);
+
+    /**
+     * @brief Decode an encoded payload
+     *
+     * @param in Encoded payload
+     * @param length Length of the encoded payload
+     * @param out Output buffer, it cannot overlap the input
+     * @param maxLength Size of the output buffer
+     * @return size_t Length of the payload or 0 if it is malformed or it does not fit
+     */
+    static size_t decode(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength);
+
+private:
+    /**
+     * @brief Compress the payload with the LZ tokens
+     *
+     * @return size_t Length of the tokens or 0 if they do not fit
+     */
+    static size_t compress(const uint8_t* in, size_t length, uint8_t* out, size_t maxLength);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "CongestionService.h"
+
+#include "NeighborTableService.h"
+#include "RoleService.h"
+#include "RoutingTableService.h"
+
+void CongestionService::fill(CongestionTrailer* trailer, uint8_t queue, uint8_t airtime) {
+    uint8_t level = getLevel(queue, airtime);
+
+    // The congestion of the path is the one of the next hop to the best gateway, a gateway ends the path
+    uint16_t gateway, via;
+    if (!RoleService::isGateway() && RoutingTableService::getRoleRoute(ROLE_GATEWAY, gateway, via)) {
+        uint8_t next = getNeighborCongestion(via, true);
+        if (next > level)
+            level = next;
+    }
+
+    trailer->queue = queue;
+    trailer->airtime = airtime;
+    trailer->path = level;
+}
+
+void CongestionService::process(uint16_t src, const CongestionTrailer* trailer) {
+    NeighborTableService::setInUse();
+    NeighborEntry* entry = NeighborTableService::getOrCreate(src);
+    uint8_t previous = entry->hasCongestion() ? entry->congestion : 0;
+    uint8_t level = getLevel(trailer->queue, trailer->airtime);
+    entry->congestion = level;
+    entry->pathCongestion = trailer->path;
+    entry->congestionUpdate = millis();
+    NeighborTableService::releaseInUse();
+
+    // The costs through it use its congestion
+    if (level != previous) {
+        ESP_LOGV(LM_TAG, "Congestion of %X %d %%, path %d %%", src, level, trailer->path);
+        RoutingTableService::invalidateLinkCost(src);
+    }
+}
+
+uint8_t CongestionService::getNeighborCongestion(uint16_t address, bool path) {
+    uint8_t congestion = 0;
+
+    NeighborTableService::setInUse();
+    NeighborEntry* entry = NeighborTableService::find(address);
+    if (entry != nullptr && entry->hasCongestion())
+        congestion = path ? entry->pathCongestion : entry->congestion;
+    NeighborTableService::releaseInUse();
+
+    return congestion;
+}
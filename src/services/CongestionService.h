@@ -0,0 +1,57 @@
+#ifndef _LORAMESHER_CONGESTION_SERVICE_H
+#define _LORAMESHER_CONGESTION_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/RoutePacket.h"
+
+/**
+ * @brief Congestion of the neighbors, see LoraMesherConfig::backpressure. The HELLOs carry a CongestionTrailer with the fill
+ * of the send queue and the airtime budget left of their source, and the highest congestion on the way from the source to
+ * its best gateway, so the congestion next to a gateway goes up to the sources through the next hops. It is kept in the
+ * NeighborEntry of the source for LM_CONGESTION_TIMEOUT ms.
+ *
+ */
+class CongestionService {
+public:
+
+    /**
+     * @brief Congestion of a node, the highest of the fill of the send queue and of the airtime budget used
+     *
+     * @param queue Fill of the send queue in percent
+     * @param airtime Airtime budget left in percent
+     * @return uint8_t Congestion in percent
+     */
+    static uint8_t getLevel(uint8_t queue, uint8_t airtime) {
+        uint8_t used = airtime < 100 ? 100 - airtime : 0;
+        return queue > used ? queue : used;
+    }
+
+    /**
+     * @brief Fill the trailer of a HELLO just before sending it
+     *
+     * @param trailer Trailer
+     * @param queue Fill of the send queue in percent
+     * @param airtime Airtime budget left in percent
+     */
+    static void fill(CongestionTrailer* trailer, uint8_t queue, uint8_t airtime);
+
+    /**
+     * @brief Process the trailer of a received HELLO
+     *
+     * @param src Address of the neighbor
+     * @param trailer Trailer
+     */
+    static void process(uint16_t src, const CongestionTrailer* trailer);
+
+    /**
+     * @brief Congestion of a neighbor
+     *
+     * @param address Address of the neighbor
+     * @param path The congestion of the path of the neighbor to its best gateway instead of its own
+     * @return uint8_t Congestion in percent, 0 if it is not known
+     */
+    static uint8_t getNeighborCongestion(uint16_t address, bool path);
+};
+
+#endif
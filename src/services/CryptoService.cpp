@@ -0,0 +1,79 @@
+#include "CryptoService.h"
+
+#include <esp_random.h>
+
+bool CryptoService::enabled = false;
+mbedtls_ccm_context CryptoService::context;
+SemaphoreHandle_t CryptoService::mutex = nullptr;
+uint32_t CryptoService::counter = 0;
+
+bool CryptoService::init(const uint8_t* key) {
+    if (enabled || key == nullptr)
+        return enabled;
+
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == nullptr) {
+        ESP_LOGE(LM_TAG, "Payload encryption mutex not created");
+        return false;
+    }
+
+    mbedtls_ccm_init(&context);
+    if (mbedtls_ccm_setkey(&context, MBEDTLS_CIPHER_ID_AES, key, KEY_LENGTH * 8) != 0) {
+        ESP_LOGE(LM_TAG, "Payload encryption key not set");
+        mbedtls_ccm_free(&context);
+        vSemaphoreDelete(mutex);
+        mutex = nullptr;
+        return false;
+    }
+
+    // A new random counter after every boot, so the nonces of the previous boots are unlikely to be used again
+    counter = esp_random();
+    enabled = true;
+    return true;
+}
+
+bool CryptoService::encrypt(uint16_t src, uint8_t* payload, size_t length) {
+    if (!enabled)
+        return false;
+
+    uint8_t* counterBytes = payload + length;
+    uint8_t nonce[NONCE_LENGTH];
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t value = counter++;
+    memcpy(counterBytes, &value, COUNTER_LENGTH);
+    getNonce(src, counterBytes, nonce);
+
+    int result = mbedtls_ccm_encrypt_and_tag(&context, length, nonce, NONCE_LENGTH, nullptr, 0, payload, payload,
+        counterBytes + COUNTER_LENGTH, LM_PAYLOAD_TAG_LENGTH);
+    xSemaphoreGive(mutex);
+
+    if (result != 0)
+        ESP_LOGE(LM_TAG, "Payload not encrypted: %d", result);
+
+    return result == 0;
+}
+
+size_t CryptoService::decrypt(uint16_t src, uint8_t* payload, size_t length) {
+    if (!enabled || length <= OVERHEAD)
+        return 0;
+
+    size_t payloadLength = length - OVERHEAD;
+    uint8_t* counterBytes = payload + payloadLength;
+    uint8_t nonce[NONCE_LENGTH];
+    getNonce(src, counterBytes, nonce);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    int result = mbedtls_ccm_auth_decrypt(&context, payloadLength, nonce, NONCE_LENGTH, nullptr, 0, payload, payload,
+        counterBytes + COUNTER_LENGTH, LM_PAYLOAD_TAG_LENGTH);
+    xSemaphoreGive(mutex);
+
+    return result == 0 ? payloadLength : 0;
+}
+
+void CryptoService::getNonce(uint16_t src, const uint8_t* counterBytes, uint8_t* nonce) {
+    nonce[0] = src >> 8;
+    nonce[1] = src & 0xFF;
+    memcpy(nonce + 2, counterBytes, COUNTER_LENGTH);
+    nonce[NONCE_LENGTH - 1] = 0;
+}
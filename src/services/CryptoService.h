@@ -0,0 +1,75 @@
+#ifndef _LORAMESHER_CRYPTO_SERVICE_H
+#define _LORAMESHER_CRYPTO_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include <mbedtls/ccm.h>
+
+/**
+ * @brief End to end AES-128-CCM of the application payloads, see LoraMesherConfig::payloadKey.
+ * The ESP32 mbedtls runs the AES on the hardware peripheral. The payload is encrypted and decrypted in its own buffer,
+ * followed by the counter and the truncated tag:
+ *
+ *   ciphertext, counter (4), tag (LM_PAYLOAD_TAG_LENGTH)
+ *
+ * The nonce is the source address and the counter, so the packet headers stay in clear for the forwarders.
+ * The counter starts at a random value at every boot. There is no replay protection.
+ */
+class CryptoService {
+public:
+    static constexpr size_t KEY_LENGTH = 16;
+    static constexpr size_t COUNTER_LENGTH = 4;
+
+    // Bytes added after the payload
+    static constexpr size_t OVERHEAD = COUNTER_LENGTH + LM_PAYLOAD_TAG_LENGTH;
+
+    /**
+     * @brief Set the key of the network, it cannot be changed later
+     *
+     * @param key Key of KEY_LENGTH bytes, nullptr to leave the payloads in clear
+     * @return true If the payloads will be encrypted
+     */
+    static bool init(const uint8_t* key);
+
+    /**
+     * @brief If the payloads are encrypted
+     *
+     */
+    static bool isEnabled() { return enabled; }
+
+    /**
+     * @brief Encrypt a payload in place and add the counter and the tag after it
+     *
+     * @param src Source address of the payload
+     * @param payload Payload, with OVERHEAD bytes of room after it
+     * @param length Length of the payload
+     * @return true If it has been encrypted
+     */
+    static bool encrypt(uint16_t src, uint8_t* payload, size_t length);
+
+    /**
+     * @brief Authenticate and decrypt a payload in place
+     *
+     * @param src Source address of the payload
+     * @param payload Encrypted payload, with the counter and the tag
+     * @param length Length of the encrypted payload, with the counter and the tag
+     * @return size_t Length of the decrypted payload, 0 if it is too short or the tag is wrong
+     */
+    static size_t decrypt(uint16_t src, uint8_t* payload, size_t length);
+
+private:
+    static constexpr size_t NONCE_LENGTH = 7;
+
+    static bool enabled;
+    static mbedtls_ccm_context context;
+    static SemaphoreHandle_t mutex;
+    static uint32_t counter;
+
+    /**
+     * @brief Nonce of a payload, the source address, the counter and a zero byte
+     *
+     */
+    static void getNonce(uint16_t src, const uint8_t* counterBytes, uint8_t* nonce);
+};
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+#include "entities/packets/PacketHeader.h"
+
+/**
+ * @brief Points of the hot paths where the hooks fire, and the value given to the hook
+ *
+ */
+enum LM_HookPoint : uint8_t {
+    // Receive interrupt, without header: 0 for the first radio, 1 for the secondary receiver
+    HOOK_RX_ISR = 0,
+    // A frame read from the radio is added to the received ring: 0 for the first radio, 1 for the secondary receiver
+    HOOK_RX_ENQUEUE = 1,
+    // Processing of a received packet, the end with a copy of its header: packet size
+    HOOK_PROCESS_START = 2,
+    HOOK_PROCESS_END = 3,
+    // A packet is added to the send queue: length of the queue
+    HOOK_SEND_ENQUEUE = 4,
+    // A packet is taken from the send queue to be sent: ms it has waited in it
+    HOOK_SEND_DEQUEUE = 5,
+    // Backoff before a transmission, not fired in a TDMA slot of the node: 0, and the ms of the backoff at the end
+    HOOK_BACKOFF_START = 6,
+    HOOK_BACKOFF_END = 7,
+    // A frame starts on air: packet size. It ends: 1 if it has been sent, 0 if the transmit done did not arrive
+    HOOK_TX_START = 8,
+    HOOK_TX_END = 9,
+    // A route has been added, changed or removed, without header: address of its destination
+    HOOK_ROUTE_UPDATE = 10,
+};
+
+#if LM_HOOKS
+
+#ifndef LM_HOOK_HEADER
+#error "LM_HOOKS needs LM_HOOK_HEADER, the header of the application with the lmHook function"
+#endif
+
+#include LM_HOOK_HEADER
+
+#ifdef ARDUINO
+#define LM_HOOK_CYCLES() ((uint32_t) ESP.getCycleCount())
+#else
+#include <esp_cpu.h>
+#define LM_HOOK_CYCLES() ((uint32_t) esp_cpu_get_cycle_count())
+#endif
+
+/**
+ * @brief Fire a hook with the CPU cycle counter, see LM_HOOKS. Without LM_HOOKS the hooks are compiled out and their
+ * arguments are not evaluated
+ *
+ */
+#define LM_HOOK(point, header, value) lmHook(point, header, value, LM_HOOK_CYCLES())
+
+#else
+
+#define LM_HOOK(point, header, value) do {} while (0)
+
+#endif
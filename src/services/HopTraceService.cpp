@@ -0,0 +1,164 @@
+#include "HopTraceService.h"
+
+#include "PacketService.h"
+#include "PacketFactory.h"
+#include "AirtimeService.h"
+#include "WiFiService.h"
+
+// Every bit of a data code but bit 7 makes it a control type, see PacketService::isAckPacket for example
+static_assert((TRACED_DATA_P & ~0x80) == DATA_P, "TRACED_DATA_P must be DATA_P with bit 7 only");
+
+// Bit of the last byte of the trace set when some hops have no record
+static constexpr uint8_t TRACE_TRUNCATED = 0x80;
+
+static inline uint16_t addSaturated(uint16_t value, uint32_t add) {
+    uint32_t sum = value + add;
+    return sum > UINT16_MAX ? UINT16_MAX : sum;
+}
+
+/**
+ * @brief Copy a packet to a new one with length bytes more at the end, the packet is released
+ *
+ * @return Packet<uint8_t>* nullptr if it does not fit or it is not allocated, the packet is kept then
+ */
+static Packet<uint8_t>* grow(Packet<uint8_t>* p, size_t length) {
+    if (p->packetSize + length > PacketFactory::getMaxPacketSize())
+        return nullptr;
+
+    Packet<uint8_t>* grown = static_cast<Packet<uint8_t>*>(PacketPoolService::allocate(p->packetSize + length));
+    if (grown == nullptr)
+        return nullptr;
+
+    memcpy(reinterpret_cast<uint8_t*>(grown), reinterpret_cast<uint8_t*>(p), p->packetSize);
+    grown->packetSize += length;
+    PacketPoolService::release(p);
+
+    return grown;
+}
+
+static inline uint8_t& getCount(Packet<uint8_t>* p) {
+    return reinterpret_cast<uint8_t*>(p)[p->packetSize - 1];
+}
+
+void HopTraceService::init(uint16_t sampling) {
+    HopTraceService::sampling = sampling > 1000 ? 1000 : sampling;
+}
+
+Packet<uint8_t>* HopTraceService::sample(Packet<uint8_t>* p) {
+    if (sampling == 0 || p == nullptr || p->type != DATA_P || (uint32_t) random(0, 1000) >= sampling)
+        return p;
+
+    Packet<uint8_t>* traced = grow(p, 1);
+    if (traced == nullptr)
+        return p;
+
+    traced->type = TRACED_DATA_P;
+    getCount(traced) = 0;
+
+    return traced;
+}
+
+size_t HopTraceService::getTraceLength(Packet<uint8_t>* p) {
+    if (!PacketService::isTracedPacket(p->type) || p->packetSize <= sizeof(DataPacket))
+        return 0;
+
+    size_t length = (getCount(p) & ~TRACE_TRUNCATED) * sizeof(LM_HopRecord) + 1;
+    return length > p->packetSize - sizeof(DataPacket) ? 0 : length;
+}
+
+Packet<uint8_t>* HopTraceService::startHop(Packet<uint8_t>* p, uint32_t queueWait) {
+    if (getTraceLength(p) == 0)
+        return p;
+
+    LM_HopRecord* own = getOwnRecord(p);
+    if (own != nullptr) {
+        own->queueWait = addSaturated(own->queueWait, queueWait);
+        return p;
+    }
+
+    uint8_t count = getCount(p);
+    Packet<uint8_t>* grown = (count & ~TRACE_TRUNCATED) < LM_HOP_TRACE_MAX_HOPS ? grow(p, sizeof(LM_HopRecord)) : nullptr;
+    if (grown == nullptr) {
+        getCount(p) = count | TRACE_TRUNCATED;
+        return p;
+    }
+
+    // The count moves to the end, the record takes its place
+    LM_HopRecord record = {};
+    record.address = WiFiService::getLocalAddress();
+    record.queueWait = addSaturated(0, queueWait);
+
+    uint8_t* end = reinterpret_cast<uint8_t*>(grown) + grown->packetSize;
+    memcpy(end - sizeof(LM_HopRecord) - 1, &record, sizeof(LM_HopRecord));
+    end[-1] = count + 1;
+
+    return grown;
+}
+
+void HopTraceService::endHop(Packet<uint8_t>* p, uint32_t dutyCycleWait, uint32_t backoff) {
+    LM_HopRecord* own = getOwnRecord(p);
+    if (own == nullptr)
+        return;
+
+    own->dutyCycleWait = addSaturated(own->dutyCycleWait, dutyCycleWait);
+    own->backoff = addSaturated(own->backoff, backoff);
+    own->timeOnAir = addSaturated(own->timeOnAir, AirtimeService::getTimeOnAirMs(p->packetSize));
+}
+
+void HopTraceService::receive(Packet<uint8_t>* p) {
+    size_t length = getTraceLength(p);
+    if (length == 0) {
+        p->type = DATA_P;
+        return;
+    }
+
+    uint8_t count = getCount(p);
+    uint8_t* records = reinterpret_cast<uint8_t*>(p) + p->packetSize - length;
+
+    portENTER_CRITICAL(&mux);
+
+    // The newest trace first
+    memmove(&traces[1], &traces[0], sizeof(LM_HopTrace) * (LM_HOP_TRACES - 1));
+
+    LM_HopTrace& trace = traces[0];
+    trace.src = p->src;
+    trace.id = p->id;
+    trace.hops = count & ~TRACE_TRUNCATED;
+    trace.truncated = (count & TRACE_TRUNCATED) != 0;
+    trace.receivedAt = millis();
+    memcpy(trace.records, records, trace.hops * sizeof(LM_HopRecord));
+
+    received++;
+
+    portEXIT_CRITICAL(&mux);
+
+    p->packetSize -= length;
+    p->type = DATA_P;
+}
+
+size_t HopTraceService::getTraces(LM_HopTrace* out, size_t max) {
+    portENTER_CRITICAL(&mux);
+
+    size_t length = received < LM_HOP_TRACES ? received : LM_HOP_TRACES;
+    if (length > max)
+        length = max;
+
+    memcpy(out, traces, length * sizeof(LM_HopTrace));
+
+    portEXIT_CRITICAL(&mux);
+    return length;
+}
+
+LM_HopRecord* HopTraceService::getOwnRecord(Packet<uint8_t>* p) {
+    size_t length = getTraceLength(p);
+    if (length <= 1)
+        return nullptr;
+
+    LM_HopRecord* last = reinterpret_cast<LM_HopRecord*>(reinterpret_cast<uint8_t*>(p) + p->packetSize - 1 - sizeof(LM_HopRecord));
+    return last->address == WiFiService::getLocalAddress() ? last : nullptr;
+}
+
+portMUX_TYPE HopTraceService::mux = portMUX_INITIALIZER_UNLOCKED;
+uint16_t HopTraceService::sampling = 0;
+LM_HopTrace HopTraceService::traces[LM_HOP_TRACES] = {};
+uint32_t HopTraceService::received = 0;
@@ -0,0 +1,140 @@
+#ifndef _LORAMESHER_HOP_TRACE_SERVICE_H
+#define _LORAMESHER_HOP_TRACE_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/Packet.h"
+
+#pragma pack(1)
+/**
+ * @brief Record of one hop of a traced packet, the times in ms saturate at UINT16_MAX. A node that sends the packet again,
+ * a retransmission without hop ACK for example, adds the times of every attempt to its record
+ *
+ */
+struct LM_HopRecord {
+    uint16_t address;
+    // In the send queue
+    uint16_t queueWait;
+    // From the send queue to the backoff: the frame on air before it, the gap of the duty cycle, the airtime budget and the
+    // TDMA slot
+    uint16_t dutyCycleWait;
+    // Random backoff or listen before talk
+    uint16_t backoff;
+    uint16_t timeOnAir;
+};
+#pragma pack()
+
+/**
+ * @brief Per hop breakdown of a traced packet received by the node
+ *
+ */
+struct LM_HopTrace {
+    uint16_t src;
+    uint8_t id;
+    // Records in records, from the source to the last forwarder
+    uint8_t hops;
+    // Some hops have no record, the packet had no room for it
+    bool truncated;
+    // millis() when the node received it
+    uint32_t receivedAt;
+    LM_HopRecord records[LM_HOP_TRACE_MAX_HOPS];
+};
+
+/**
+ * @brief In band per hop latency of a sample of the data packets, see LoraMesherConfig::hopTraceSampling. A traced packet
+ * has the type TRACED_DATA_P and its payload ends with the trace:
+ *
+ *   Payload of the application | records (10 each) | records (1), with the bit 7 set if some hops have no record
+ *
+ * Every node that sends it appends its record when it takes it from the send queue and fills it just before the
+ * transmission. The destination removes the trace before the payload goes to the application and keeps the newest
+ * LM_HOP_TRACES traces, see LoraMesher::getHopTraces. The nodes without it enabled forward the traced packets too.
+ *
+ */
+class HopTraceService {
+public:
+
+    /**
+     * @brief Set the sampling of the packets of the node
+     *
+     * @param sampling Per mille of the data packets traced, 0 disables it
+     */
+    static void init(uint16_t sampling);
+
+    static bool isEnabled() { return sampling != 0; }
+
+    /**
+     * @brief Trace the data packet of the node if it is in the sample
+     *
+     * @param p Unicast data packet, released if it is traced
+     * @return Packet<uint8_t>* The packet, a new one with the empty trace if it is traced
+     */
+    static Packet<uint8_t>* sample(Packet<uint8_t>* p);
+
+    /**
+     * @brief Get the length of the trace at the end of the payload
+     *
+     * @return size_t 0 if the packet is not traced
+     */
+    static size_t getTraceLength(Packet<uint8_t>* p);
+
+    /**
+     * @brief Append the record of the node to a traced packet taken from the send queue, or add to it if it has one already
+     *
+     * @param p Traced packet, released if it grows
+     * @param queueWait Ms it has waited in the send queue
+     * @return Packet<uint8_t>* The packet, a new one if it has grown
+     */
+    static Packet<uint8_t>* startHop(Packet<uint8_t>* p, uint32_t queueWait);
+
+    /**
+     * @brief Fill the record of the node just before the transmission of a traced packet
+     *
+     * @param p Traced packet
+     * @param dutyCycleWait Ms since it was taken from the send queue until the backoff started
+     * @param backoff Ms of the backoff
+     */
+    static void endHop(Packet<uint8_t>* p, uint32_t dutyCycleWait, uint32_t backoff);
+
+    /**
+     * @brief Keep the trace of a traced packet for this node and remove it, the packet becomes a DATA_P
+     *
+     * @param p Traced packet
+     */
+    static void receive(Packet<uint8_t>* p);
+
+    /**
+     * @brief Copy the traces received, newest first
+     *
+     * @param traces Output traces
+     * @param max Maximum number of traces to copy
+     * @return size_t Number of traces copied
+     */
+    static size_t getTraces(LM_HopTrace* traces, size_t max);
+
+    /**
+     * @brief Get the number of traced packets received since the boot
+     *
+     * @return uint32_t
+     */
+    static uint32_t getReceivedNum() { return received; }
+
+private:
+
+    static portMUX_TYPE mux;
+
+    static uint16_t sampling;
+
+    static LM_HopTrace traces[LM_HOP_TRACES];
+
+    static uint32_t received;
+
+    /**
+     * @brief Get the last record of a traced packet if it is the one of the node
+     *
+     * @return LM_HopRecord* nullptr if the node has no record
+     */
+    static LM_HopRecord* getOwnRecord(Packet<uint8_t>* p);
+};
+
+#endif
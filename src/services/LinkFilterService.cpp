@@ -0,0 +1,171 @@
+#include "LinkFilterService.h"
+
+static inline bool isFiltering(const LM_LinkFilter& filter) {
+    return filter.dropPerMille != 0 || filter.delay != 0 || filter.snrOffset != 0;
+}
+
+/**
+ * @brief Parse an address of a line of the link matrix
+ *
+ * @param text Text after the spaces, moved after the address
+ * @param address Output address, 0 for *
+ * @return true If it is * or a hex address
+ */
+static bool parseAddress(const char*& text, uint16_t& address) {
+    if (*text == '*') {
+        text++;
+        address = 0;
+        return true;
+    }
+
+    char* end;
+    unsigned long value = strtoul(text, &end, 16);
+    if (end == text || value == 0 || value > UINT16_MAX)
+        return false;
+
+    text = end;
+    address = value;
+    return true;
+}
+
+static inline const char* skipSpaces(const char* text) {
+    while (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n')
+        text++;
+    return text;
+}
+
+bool LinkFilterService::set(uint16_t transmitter, const LM_LinkFilter& filter) {
+    portENTER_CRITICAL(&mux);
+
+    if (transmitter == 0) {
+        defaultFilter = filter;
+        updateEnabled();
+        portEXIT_CRITICAL(&mux);
+        return true;
+    }
+
+    Link* link = nullptr;
+    for (size_t i = 0; i < linksLength; i++) {
+        if (links[i].transmitter == transmitter) {
+            link = &links[i];
+            break;
+        }
+    }
+
+    if (link == nullptr && linksLength < LM_LINK_FILTERS) {
+        link = &links[linksLength++];
+        link->transmitter = transmitter;
+    }
+
+    if (link != nullptr) {
+        link->filter = filter;
+        updateEnabled();
+    }
+
+    portEXIT_CRITICAL(&mux);
+    return link != nullptr;
+}
+
+void LinkFilterService::remove(uint16_t transmitter) {
+    portENTER_CRITICAL(&mux);
+
+    if (transmitter == 0)
+        defaultFilter = LM_LinkFilter();
+
+    for (size_t i = 0; transmitter != 0 && i < linksLength; i++) {
+        if (links[i].transmitter == transmitter) {
+            links[i] = links[--linksLength];
+            break;
+        }
+    }
+
+    updateEnabled();
+
+    portEXIT_CRITICAL(&mux);
+}
+
+void LinkFilterService::clear() {
+    portENTER_CRITICAL(&mux);
+
+    linksLength = 0;
+    defaultFilter = LM_LinkFilter();
+    enabled = false;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+bool LinkFilterService::configure(const char* line, uint16_t localAddress) {
+    const char* text = skipSpaces(line);
+    if (strncmp(text, "clear", 5) == 0 && *skipSpaces(text + 5) == '\0') {
+        clear();
+        return true;
+    }
+
+    uint16_t transmitter, receiver;
+    if (!parseAddress(text, transmitter) || *text++ != '>' || !parseAddress(text, receiver))
+        return false;
+
+    LM_LinkFilter filter;
+    for (text = skipSpaces(text); *text != '\0'; text = skipSpaces(text)) {
+        const char* key = text;
+        while (*text != '\0' && *text != ' ' && *text != '\t')
+            text++;
+        size_t keyLength = text - key;
+
+        char* end;
+        long value = strtol(skipSpaces(text), &end, 10);
+        if (end == skipSpaces(text))
+            return false;
+        text = end;
+
+        if (keyLength == 4 && strncmp(key, "drop", 4) == 0 && value >= 0 && value <= 1000)
+            filter.dropPerMille = value;
+        else if (keyLength == 5 && strncmp(key, "delay", 5) == 0 && value >= 0 && value <= UINT16_MAX)
+            filter.delay = value;
+        else if (keyLength == 3 && strncmp(key, "snr", 3) == 0 && value >= INT8_MIN && value <= INT8_MAX)
+            filter.snrOffset = value;
+        else
+            return false;
+    }
+
+    if (receiver != 0 && receiver != localAddress)
+        return true;
+
+    ESP_LOGI(LM_TAG, "Link filter from %X: drop %d, delay %d ms, SNR %d dB", transmitter, filter.dropPerMille, filter.delay,
+        filter.snrOffset);
+
+    return set(transmitter, filter);
+}
+
+LM_LinkFilter LinkFilterService::get(uint16_t transmitter) {
+    portENTER_CRITICAL(&mux);
+
+    LM_LinkFilter filter = defaultFilter;
+    for (size_t i = 0; transmitter != 0 && i < linksLength; i++) {
+        if (links[i].transmitter == transmitter) {
+            filter = links[i].filter;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&mux);
+    return filter;
+}
+
+bool LinkFilterService::drop(const LM_LinkFilter& filter) {
+    return filter.dropPerMille != 0 && (filter.dropPerMille >= 1000 || (uint32_t) random(0, 1000) < filter.dropPerMille);
+}
+
+void LinkFilterService::updateEnabled() {
+    bool filtering = isFiltering(defaultFilter);
+    for (size_t i = 0; !filtering && i < linksLength; i++)
+        filtering = isFiltering(links[i].filter);
+
+    enabled = filtering;
+}
+
+portMUX_TYPE LinkFilterService::mux = portMUX_INITIALIZER_UNLOCKED;
+LinkFilterService::Link LinkFilterService::links[LM_LINK_FILTERS] = {};
+size_t LinkFilterService::linksLength = 0;
+LM_LinkFilter LinkFilterService::defaultFilter = LM_LinkFilter();
+bool LinkFilterService::enabled = false;
@@ -0,0 +1,115 @@
+#ifndef _LORAMESHER_LINK_FILTER_SERVICE_H
+#define _LORAMESHER_LINK_FILTER_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Filter of the frames received from a transmitter. The default one lets every frame through
+ *
+ */
+struct LM_LinkFilter {
+    // Per mille of the frames dropped, 1000 cuts the link
+    uint16_t dropPerMille = 0;
+    // Ms the frames wait before they are processed
+    uint16_t delay = 0;
+    // dB added to the SNR of the frames
+    int8_t snrOffset = 0;
+};
+
+/**
+ * @brief Link matrix that emulates a multi hop topology with the nodes in range of each other, on a desk. Every frame
+ * received goes through the filter of its transmitter: the source of the HELLOs and of the other frames sent once, the node
+ * that acknowledges with a hop ACK, and for the data packets the next hop of the route back to their source. The transmitters
+ * without their own filter use the default one, see set with address 0.
+ *
+ * The matrix is changed at runtime, from the API or with the lines of configure. The same lines can go to every board, over
+ * serial or in a packet of the application, each node keeps the links it receives:
+ *
+ *   <transmitter>><receiver> [drop PM] [delay MS] [snr DB]   addresses in hex, * for every node
+ *   clear                                                    removes every filter
+ *
+ * For example "*>* drop 1000" cuts all the links, then "A1B2>C3D4" and "C3D4>A1B2" open one in both directions.
+ *
+ */
+class LinkFilterService {
+public:
+
+    /**
+     * @brief Set the filter of a transmitter, or the default filter
+     *
+     * @param transmitter Address, 0 for the transmitters without their own filter
+     * @param filter Filter
+     * @return true If it is set, false if LM_LINK_FILTERS transmitters have a filter already
+     */
+    static bool set(uint16_t transmitter, const LM_LinkFilter& filter);
+
+    /**
+     * @brief Remove the filter of a transmitter, it uses the default one again
+     *
+     * @param transmitter Address, 0 resets the default filter
+     */
+    static void remove(uint16_t transmitter);
+
+    /**
+     * @brief Remove every filter, the frames are received as they are
+     *
+     */
+    static void clear();
+
+    /**
+     * @brief Apply a line of the link matrix, see LinkFilterService
+     *
+     * @param line Null terminated line
+     * @param localAddress Address of the node, the links to other receivers are ignored
+     * @return true If the line is valid, even if it is not for this node
+     */
+    static bool configure(const char* line, uint16_t localAddress);
+
+    /**
+     * @brief If a filter is set
+     *
+     */
+    static bool isEnabled() { return enabled; }
+
+    /**
+     * @brief Get the filter of a transmitter
+     *
+     * @param transmitter Address, 0 if it is unknown
+     * @return LM_LinkFilter Its filter, the default one if it has none
+     */
+    static LM_LinkFilter get(uint16_t transmitter);
+
+    /**
+     * @brief Draw if a frame of a link is dropped
+     *
+     * @param filter Filter of the link
+     * @return true If it is dropped
+     */
+    static bool drop(const LM_LinkFilter& filter);
+
+private:
+
+    struct Link {
+        uint16_t transmitter;
+        LM_LinkFilter filter;
+    };
+
+    static portMUX_TYPE mux;
+
+    static Link links[LM_LINK_FILTERS];
+
+    static size_t linksLength;
+
+    static LM_LinkFilter defaultFilter;
+
+    // Some filter has a drop, a delay or an offset
+    static bool enabled;
+
+    /**
+     * @brief Update enabled, protected by the mux
+     *
+     */
+    static void updateEnabled();
+};
+
+#endif
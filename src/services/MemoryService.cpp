@@ -0,0 +1,37 @@
+#include "MemoryService.h"
+
+void MemoryService::add(LM_MemoryTag tag, size_t bytes) {
+    portENTER_CRITICAL(&mux);
+
+    LM_MemoryUsage& tagUsage = usage[tag];
+    tagUsage.bytes += bytes;
+    tagUsage.count++;
+    if (tagUsage.bytes > tagUsage.peakBytes)
+        tagUsage.peakBytes = tagUsage.bytes;
+    if (tagUsage.count > tagUsage.peakCount)
+        tagUsage.peakCount = tagUsage.count;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+void MemoryService::remove(LM_MemoryTag tag, size_t bytes) {
+    portENTER_CRITICAL(&mux);
+
+    LM_MemoryUsage& tagUsage = usage[tag];
+    tagUsage.bytes = tagUsage.bytes > bytes ? tagUsage.bytes - bytes : 0;
+    if (tagUsage.count > 0)
+        tagUsage.count--;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+LM_MemoryUsage MemoryService::getUsage(LM_MemoryTag tag) {
+    portENTER_CRITICAL(&mux);
+    LM_MemoryUsage tagUsage = usage[tag];
+    portEXIT_CRITICAL(&mux);
+
+    return tagUsage;
+}
+
+portMUX_TYPE MemoryService::mux = portMUX_INITIALIZER_UNLOCKED;
+LM_MemoryUsage MemoryService::usage[MEMORY_TAGS];
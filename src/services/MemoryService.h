@@ -0,0 +1,84 @@
+#ifndef _LORAMESHER_MEMORY_SERVICE_H
+#define _LORAMESHER_MEMORY_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Subsystems whose memory is accounted, see MemoryService
+ *
+ */
+enum LM_MemoryTag : uint8_t {
+    // Packets and queue packets of the send, receive and application queues and of the sequences, PacketPoolService
+    MEMORY_PACKETS = 0,
+    // Entries of the routing table
+    MEMORY_ROUTING = 1,
+    // Nodes of the LM_LinkedList
+    MEMORY_LISTS = 2,
+    // Configuration and bitmaps of the reliable sequences of the Q_WRP and Q_WSP
+    MEMORY_SEQUENCES = 3,
+    // States ring of the SimulatorService
+    MEMORY_SIMULATOR = 4,
+    MEMORY_TAGS = 5,
+};
+
+/**
+ * @brief Memory of a subsystem
+ *
+ */
+struct LM_MemoryUsage {
+    uint32_t bytes = 0;
+    uint32_t peakBytes = 0;
+    uint32_t count = 0;
+    uint32_t peakCount = 0;
+};
+
+/**
+ * @brief Memory of the subsystems, see LoraMesher::getMemoryStats
+ *
+ */
+struct LM_MemoryStats {
+    LM_MemoryUsage usage[MEMORY_TAGS];
+    uint32_t freeHeap = 0;
+};
+
+/**
+ * @brief Accounting of the allocations of every subsystem, the current and peak bytes and number of allocations. The
+ * subsystems account their allocations when they make them and when they free them, with the size the heap gives to the
+ * allocation when they do not know it.
+ *
+ */
+class MemoryService {
+public:
+
+    /**
+     * @brief Account an allocation
+     *
+     * @param tag Subsystem
+     * @param bytes Size in bytes
+     */
+    static void add(LM_MemoryTag tag, size_t bytes);
+
+    /**
+     * @brief Account a free of an allocation accounted with add
+     *
+     * @param tag Subsystem
+     * @param bytes Size in bytes, the same given to add
+     */
+    static void remove(LM_MemoryTag tag, size_t bytes);
+
+    /**
+     * @brief Get the memory of a subsystem
+     *
+     * @param tag Subsystem
+     * @return LM_MemoryUsage
+     */
+    static LM_MemoryUsage getUsage(LM_MemoryTag tag);
+
+private:
+
+    static portMUX_TYPE mux;
+
+    static LM_MemoryUsage usage[MEMORY_TAGS];
+};
+
+#endif
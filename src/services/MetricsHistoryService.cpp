@@ -0,0 +1,396 @@
+#include "MetricsHistoryService.h"
+
+#include <new>
+
+static constexpr uint8_t KIND_REQUEST = 1;
+static constexpr uint8_t KIND_REPLY = 2;
+
+#pragma pack(1)
+struct MetricsHeader {
+    uint8_t kind;
+    uint8_t tier;
+};
+
+struct MetricsRequest {
+    MetricsHeader header;
+    uint32_t from;
+    uint32_t to;
+};
+
+struct MetricsReply {
+    MetricsHeader header;
+    uint8_t more;
+    uint32_t interval;
+};
+#pragma pack()
+
+static constexpr size_t FIELDS = sizeof(LM_MetricsSample) / sizeof(uint32_t);
+
+static_assert(sizeof(LM_MetricsSample) == FIELDS * sizeof(uint32_t), "LM_MetricsSample must only have uint32_t fields");
+static_assert(FIELDS <= 32, "LM_METRICS_APP_VALUES does not fit in the mask of a sample");
+static_assert(LM_METRICS_BLOCK_SIZE <= 256, "The samples of a block are counted in one byte");
+static_assert(sizeof(MetricsRequest) <= LM_MAX_PACKET_SIZE, "The request does not fit in a packet");
+
+// Largest varint of 32 bits, and largest sample: the mask and every field
+static constexpr size_t MAX_VARINT_LENGTH = 5;
+static constexpr size_t MAX_SAMPLE_LENGTH = (FIELDS + 1) * MAX_VARINT_LENGTH;
+
+static_assert(LM_METRICS_BLOCK_SIZE > MAX_SAMPLE_LENGTH, "LM_METRICS_BLOCK_SIZE does not fit a keyframe");
+static_assert(LM_METRICS_REPLY_SIZE > sizeof(MetricsReply) + MAX_SAMPLE_LENGTH, "LM_METRICS_REPLY_SIZE does not fit a keyframe");
+
+static size_t writeVarint(uint8_t* out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    return length;
+}
+
+static bool readVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (uint8_t shift = 0; shift < 7 * MAX_VARINT_LENGTH && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Code a sample as the change of every field to the previous one, the time minus the interval
+ *
+ * @param previous Previous sample, zeros with interval 0 for a keyframe
+ * @param sample Sample
+ * @param interval Seconds between two samples
+ * @param out Buffer of MAX_SAMPLE_LENGTH bytes
+ * @return size_t Length of the sample
+ */
+static size_t encodeSample(const LM_MetricsSample& previous, const LM_MetricsSample& sample, uint32_t interval, uint8_t* out) {
+    uint32_t before[FIELDS];
+    uint32_t after[FIELDS];
+    memcpy(before, &previous, sizeof(before));
+    memcpy(after, &sample, sizeof(after));
+    before[0] += interval;
+
+    uint32_t mask = 0;
+    for (size_t i = 0; i < FIELDS; i++) {
+        if (after[i] != before[i])
+            mask |= 1ul << i;
+    }
+
+    size_t length = writeVarint(out, mask);
+    for (size_t i = 0; i < FIELDS; i++) {
+        if ((mask & (1ul << i)) == 0)
+            continue;
+
+        int32_t change = (int32_t) (after[i] - before[i]);
+        length += writeVarint(out + length, ((uint32_t) change << 1) ^ (uint32_t) (change >> 31));
+    }
+
+    return length;
+}
+
+/**
+ * @brief Decode a sample coded by encodeSample
+ *
+ * @param in Position of the sample, moved after it
+ * @param end End of the buffer
+ * @param sample The previous sample, replaced by the decoded one
+ * @param interval Seconds between two samples, 0 for a keyframe
+ * @return true If the sample is complete
+ */
+static bool decodeSample(const uint8_t*& in, const uint8_t* end, LM_MetricsSample& sample, uint32_t interval) {
+    uint32_t fields[FIELDS];
+    memcpy(fields, &sample, sizeof(fields));
+    fields[0] += interval;
+
+    uint32_t mask;
+    if (!readVarint(in, end, mask))
+        return false;
+
+    for (size_t i = 0; i < FIELDS; i++) {
+        if ((mask & (1ul << i)) == 0)
+            continue;
+
+        uint32_t zigzag;
+        if (!readVarint(in, end, zigzag))
+            return false;
+
+        fields[i] += (zigzag >> 1) ^ (0 - (zigzag & 1));
+    }
+
+    memcpy(&sample, fields, sizeof(fields));
+    return true;
+}
+
+bool MetricsHistoryService::init(uint16_t seconds) {
+    if (mutex != nullptr) {
+        ESP_LOGW(LM_TAG, "Metrics history already initialized");
+        return true;
+    }
+
+    if (seconds == 0)
+        return false;
+
+    if (!initTier(tiers[METRICS_FINE], LM_METRICS_FINE_BYTES, seconds) ||
+        !initTier(tiers[METRICS_COARSE], LM_METRICS_COARSE_BYTES, (uint32_t) seconds * LM_METRICS_COARSE_FACTOR)) {
+        delete[] tiers[METRICS_FINE].blocks;
+        tiers[METRICS_FINE].blocks = nullptr;
+        return false;
+    }
+
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL) {
+        for (Tier& tier : tiers) {
+            delete[] tier.blocks;
+            tier.blocks = nullptr;
+        }
+        return false;
+    }
+
+    nextSample = millis();
+    recorded = 0;
+
+    ESP_LOGI(LM_TAG, "Metrics history every %d s, %d and %d bytes", seconds, LM_METRICS_FINE_BYTES, LM_METRICS_COARSE_BYTES);
+    return true;
+}
+
+bool MetricsHistoryService::initTier(Tier& tier, size_t bytes, uint32_t interval) {
+    tier.blockCount = bytes / LM_METRICS_BLOCK_SIZE;
+    if (tier.blockCount == 0)
+        return false;
+
+    tier.blocks = new (std::nothrow) uint8_t[tier.blockCount * LM_METRICS_BLOCK_SIZE];
+    if (tier.blocks == nullptr)
+        return false;
+
+    tier.head = 0;
+    tier.used = 0;
+    tier.headLength = 0;
+    tier.interval = interval;
+    tier.last = LM_MetricsSample();
+    return true;
+}
+
+uint32_t MetricsHistoryService::getTimeUntilNext() {
+    if (!isEnabled())
+        return UINT32_MAX;
+
+    uint32_t now = millis();
+    return (int32_t) (nextSample - now) <= 0 ? 0 : nextSample - now;
+}
+
+void MetricsHistoryService::record(LM_MetricsSample& sample) {
+    if (!isEnabled())
+        return;
+
+    uint32_t now = millis();
+    uint32_t interval = tiers[METRICS_FINE].interval * 1000;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    // The time of the schedule, so the change of the time is the interval and it is not coded. A node late by more than an
+    // interval starts a new schedule
+    sample.time = nextSample / 1000;
+    memcpy(sample.app, appValues, sizeof(appValues));
+
+    nextSample += interval;
+    if ((int32_t) (nextSample - now) <= 0)
+        nextSample = now + interval;
+
+    append(tiers[METRICS_FINE], sample);
+    if (recorded++ % LM_METRICS_COARSE_FACTOR == 0)
+        append(tiers[METRICS_COARSE], sample);
+
+    xSemaphoreGive(mutex);
+}
+
+void MetricsHistoryService::setAppValue(uint8_t index, uint32_t value) {
+    if (!isEnabled() || index >= LM_METRICS_APP_VALUES)
+        return;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    appValues[index] = value;
+    xSemaphoreGive(mutex);
+}
+
+void MetricsHistoryService::append(Tier& tier, const LM_MetricsSample& sample) {
+    uint8_t encoded[MAX_SAMPLE_LENGTH];
+    size_t length = 0;
+
+    uint8_t* block = tier.blocks + tier.head * LM_METRICS_BLOCK_SIZE;
+    if (tier.used > 0 && block[0] < UINT8_MAX)
+        length = encodeSample(tier.last, sample, tier.interval, encoded);
+
+    // A new block with a keyframe, over the oldest one when the ring is full
+    if (length == 0 || tier.headLength + length > LM_METRICS_BLOCK_SIZE) {
+        if (tier.used > 0)
+            tier.head = (tier.head + 1) % tier.blockCount;
+        if (tier.used < tier.blockCount)
+            tier.used++;
+
+        block = tier.blocks + tier.head * LM_METRICS_BLOCK_SIZE;
+        block[0] = 0;
+        tier.headLength = 1;
+        length = encodeSample(LM_MetricsSample(), sample, 0, encoded);
+    }
+
+    memcpy(block + tier.headLength, encoded, length);
+    tier.headLength += length;
+    block[0]++;
+    tier.last = sample;
+}
+
+template <typename F>
+void MetricsHistoryService::scan(const Tier& tier, F visit) {
+    size_t oldest = (tier.head + tier.blockCount + 1 - tier.used) % tier.blockCount;
+
+    for (size_t i = 0; i < tier.used; i++) {
+        const uint8_t* block = tier.blocks + ((oldest + i) % tier.blockCount) * LM_METRICS_BLOCK_SIZE;
+        const uint8_t* in = block + 1;
+        const uint8_t* end = block + LM_METRICS_BLOCK_SIZE;
+
+        LM_MetricsSample sample;
+        for (uint8_t n = 0; n < block[0]; n++) {
+            if (!decodeSample(in, end, sample, n == 0 ? 0 : tier.interval))
+                break;
+
+            if (!visit(sample))
+                return;
+        }
+    }
+}
+
+size_t MetricsHistoryService::get(LM_MetricsTier tier, uint32_t from, uint32_t to, LM_MetricsSample* out, size_t max) {
+    if (!isEnabled() || tier >= METRICS_TIERS)
+        return 0;
+
+    size_t length = 0;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    scan(tiers[tier], [&](const LM_MetricsSample& sample) {
+        if (sample.time > to || length >= max)
+            return false;
+
+        if (sample.time >= from)
+            out[length++] = sample;
+        return true;
+    });
+
+    xSemaphoreGive(mutex);
+    return length;
+}
+
+size_t MetricsHistoryService::buildRequest(LM_MetricsTier tier, uint32_t from, uint32_t to, uint8_t* message) {
+    MetricsRequest* request = reinterpret_cast<MetricsRequest*>(message);
+    request->header.kind = KIND_REQUEST;
+    request->header.tier = tier;
+    request->from = from;
+    request->to = to;
+
+    return sizeof(MetricsRequest);
+}
+
+void MetricsHistoryService::setCallback(LM_MetricsCallback callback, void* context) {
+    MetricsHistoryService::callbackContext = context;
+    MetricsHistoryService::callback = callback;
+}
+
+bool MetricsHistoryService::isMessage(const uint8_t* payload, size_t size) {
+    if (size < sizeof(MetricsHeader))
+        return false;
+
+    uint8_t kind = payload[0];
+    return (kind == KIND_REQUEST && size == sizeof(MetricsRequest)) || (kind == KIND_REPLY && size >= sizeof(MetricsReply));
+}
+
+size_t MetricsHistoryService::process(uint16_t src, const uint8_t* payload, size_t size, uint8_t* reply) {
+    const MetricsHeader* header = reinterpret_cast<const MetricsHeader*>(payload);
+    if (header->tier >= METRICS_TIERS)
+        return 0;
+
+    LM_MetricsTier tier = (LM_MetricsTier) header->tier;
+
+    if (header->kind == KIND_REPLY) {
+        LM_MetricsCallback replyCallback = callback;
+        if (replyCallback == nullptr)
+            return 0;
+
+        MetricsReply replyHeader;
+        memcpy(&replyHeader, payload, sizeof(MetricsReply));
+
+        const uint8_t* in = payload + sizeof(MetricsReply);
+        const uint8_t* end = payload + size;
+
+        LM_MetricsSample sample;
+        for (bool first = true; in < end; first = false) {
+            if (!decodeSample(in, end, sample, first ? 0 : replyHeader.interval)) {
+                ESP_LOGW(LM_TAG, "Malformed metrics reply from %X", src);
+                break;
+            }
+
+            replyCallback(src, tier, &sample, false, callbackContext);
+        }
+
+        replyCallback(src, tier, nullptr, replyHeader.more != 0, callbackContext);
+        return 0;
+    }
+
+    if (!isEnabled())
+        return 0;
+
+    MetricsRequest request;
+    memcpy(&request, payload, sizeof(MetricsRequest));
+
+    MetricsReply* replyHeader = reinterpret_cast<MetricsReply*>(reply);
+    replyHeader->header.kind = KIND_REPLY;
+    replyHeader->header.tier = tier;
+    replyHeader->more = 0;
+
+    size_t length = sizeof(MetricsReply);
+    LM_MetricsSample previous;
+    bool first = true;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    Tier& history = tiers[tier];
+    replyHeader->interval = history.interval;
+
+    scan(history, [&](const LM_MetricsSample& sample) {
+        if (sample.time > request.to)
+            return false;
+        if (sample.time < request.from)
+            return true;
+
+        uint8_t encoded[MAX_SAMPLE_LENGTH];
+        size_t sampleLength = encodeSample(previous, sample, first ? 0 : history.interval, encoded);
+        if (length + sampleLength > LM_METRICS_REPLY_SIZE) {
+            replyHeader->more = 1;
+            return false;
+        }
+
+        memcpy(reply + length, encoded, sampleLength);
+        length += sampleLength;
+        previous = sample;
+        first = false;
+        return true;
+    });
+
+    xSemaphoreGive(mutex);
+
+    ESP_LOGV(LM_TAG, "Metrics reply of %d bytes to %X", (int) length, src);
+    return length;
+}
+
+SemaphoreHandle_t MetricsHistoryService::mutex = nullptr;
+MetricsHistoryService::Tier MetricsHistoryService::tiers[METRICS_TIERS] = {};
+uint32_t MetricsHistoryService::nextSample = 0;
+uint32_t MetricsHistoryService::recorded = 0;
+uint32_t MetricsHistoryService::appValues[LM_METRICS_APP_VALUES] = {};
+LM_MetricsCallback MetricsHistoryService::callback = nullptr;
+void* MetricsHistoryService::callbackContext = nullptr;
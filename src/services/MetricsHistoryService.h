@@ -0,0 +1,195 @@
+#ifndef _LORAMESHER_METRICS_HISTORY_SERVICE_H
+#define _LORAMESHER_METRICS_HISTORY_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include <freertos/semphr.h>
+
+/**
+ * @brief Resolutions of the metrics history
+ *
+ */
+enum LM_MetricsTier : uint8_t {
+    // A sample every LoraMesherConfig::metricsInterval s
+    METRICS_FINE = 0,
+    // One of every LM_METRICS_COARSE_FACTOR fine samples
+    METRICS_COARSE = 1,
+    METRICS_TIERS = 2,
+};
+
+/**
+ * @brief Sample of the metrics history. The counters are cumulative since the boot, so the difference of two samples is
+ * the count between them at any resolution. The other values are the state when the sample is taken
+ *
+ */
+struct LM_MetricsSample {
+    // Seconds since the boot
+    uint32_t time = 0;
+    uint32_t freeHeap = 0;
+    // Packets in the send queue and in the received queue of the application
+    uint32_t sendQueue = 0;
+    uint32_t receivedQueue = 0;
+    uint32_t routes = 0;
+    // Per mille, see LoraMesher::getChannelBusy
+    uint32_t channelBusy = 0;
+    // Counters of LM_Stats: sendPacketsNum, receivedDataPacketsNum, forwardedPacketsNum, sendQueueDroppedNum and
+    // receivedQueueDroppedNum
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    uint32_t forwarded = 0;
+    uint32_t sendQueueDropped = 0;
+    uint32_t receivedQueueDropped = 0;
+    // Time on air of the frames sent in ms
+    uint32_t timeOnAir = 0;
+    // Values of the application, see LoraMesher::setMetricValue
+    uint32_t app[LM_METRICS_APP_VALUES] = {};
+};
+
+/**
+ * @brief Samples of a reply to LoraMesher::requestMetrics. Called for every sample, and once at the end of the reply with
+ * sample nullptr. more is true if the node has more samples in the range than fit in a reply, they are requested again
+ * from the time of the last one plus one. It runs in the task that processes the received packets, it must return quickly
+ *
+ */
+typedef void (*LM_MetricsCallback)(uint16_t src, LM_MetricsTier tier, const LM_MetricsSample* sample, bool more, void* context);
+
+/**
+ * @brief History of the metrics of the node in fixed memory, see LoraMesherConfig::metricsInterval. Every tier is a ring of
+ * LM_METRICS_BLOCK_SIZE byte blocks, the oldest block is overwritten when the ring is full. A block starts with the
+ * number of samples and a keyframe, the first sample, and the next samples are deltas to the previous one:
+ *
+ *   Sample: bit n set if the field n changed (varint), zigzag varint of the change of every field set
+ *
+ * The time is field 0 and its change is taken from the interval of the tier, so a sample of a quiet node is a few bytes.
+ * The history can be requested by other nodes with payloads on the port LM_PORT_METRICS, they are taken out before the
+ * application receives them:
+ *
+ *   Request: kind (1), tier (1), from (4), to (4)
+ *   Reply: kind (1), tier (1), more (1), interval of the tier (4), samples coded as a block, the first one a keyframe
+ *
+ */
+class MetricsHistoryService {
+public:
+
+    /**
+     * @brief Allocate the rings, LM_METRICS_FINE_BYTES and LM_METRICS_COARSE_BYTES bytes
+     *
+     * @param seconds Seconds between two fine samples
+     * @return true If the rings have been allocated
+     */
+    static bool init(uint16_t seconds);
+
+    static bool isEnabled() { return mutex != nullptr; }
+
+    /**
+     * @brief Ms until the next sample is due
+     *
+     * @return uint32_t 0 if it is due, UINT32_MAX if the history is not enabled
+     */
+    static uint32_t getTimeUntilNext();
+
+    /**
+     * @brief Add the due sample to the fine tier, and to the coarse tier every LM_METRICS_COARSE_FACTOR samples. The time
+     * and the values of the application are set by the service
+     *
+     * @param sample Values of the library
+     */
+    static void record(LM_MetricsSample& sample);
+
+    /**
+     * @brief Set a value of the application, recorded with the next samples
+     *
+     * @param index Index of the value, below LM_METRICS_APP_VALUES
+     * @param value Value
+     */
+    static void setAppValue(uint8_t index, uint32_t value);
+
+    /**
+     * @brief Get the samples of a tier in a range of time, the oldest first
+     *
+     * @param tier Tier
+     * @param from Seconds since the boot of the first sample
+     * @param to Seconds since the boot of the last sample
+     * @param out Output samples
+     * @param max Maximum number of samples
+     * @return size_t Number of samples
+     */
+    static size_t get(LM_MetricsTier tier, uint32_t from, uint32_t to, LM_MetricsSample* out, size_t max);
+
+    /**
+     * @brief Build a request of the history of another node
+     *
+     * @param message Buffer of LM_MAX_PACKET_SIZE bytes
+     * @return size_t Size of the request
+     */
+    static size_t buildRequest(LM_MetricsTier tier, uint32_t from, uint32_t to, uint8_t* message);
+
+    /**
+     * @brief Set the callback of the replies to the requests of the node
+     *
+     */
+    static void setCallback(LM_MetricsCallback callback, void* context);
+
+    /**
+     * @brief Returns if a payload of LM_PORT_METRICS is a well formed message of the history
+     *
+     */
+    static bool isMessage(const uint8_t* payload, size_t size);
+
+    /**
+     * @brief Process a received message. A request is answered with the samples that fit in LM_METRICS_REPLY_SIZE bytes,
+     * a reply is given to the callback
+     *
+     * @param src Address of the node that sent it
+     * @param payload Message, see isMessage
+     * @param size Size of the message
+     * @param reply Buffer of LM_METRICS_REPLY_SIZE bytes
+     * @return size_t Size of the reply to send to src, 0 if none
+     */
+    static size_t process(uint16_t src, const uint8_t* payload, size_t size, uint8_t* reply);
+
+private:
+
+    struct Tier {
+        uint8_t* blocks;
+        size_t blockCount;
+        // Block being written, blocks with samples and bytes written in the current block
+        size_t head;
+        size_t used;
+        size_t headLength;
+        // Seconds between two samples
+        uint32_t interval;
+        // Last sample, the base of the next delta
+        LM_MetricsSample last;
+    };
+
+    static SemaphoreHandle_t mutex;
+
+    static Tier tiers[METRICS_TIERS];
+
+    // millis() of the next sample and fine samples recorded
+    static uint32_t nextSample;
+    static uint32_t recorded;
+
+    static uint32_t appValues[LM_METRICS_APP_VALUES];
+
+    static LM_MetricsCallback callback;
+    static void* callbackContext;
+
+    static bool initTier(Tier& tier, size_t bytes, uint32_t interval);
+
+    /**
+     * @brief Add a sample to a tier, protected by the mutex
+     *
+     */
+    static void append(Tier& tier, const LM_MetricsSample& sample);
+
+    /**
+     * @brief Call visit with every sample of a tier, the oldest first, until it returns false. Protected by the mutex
+     *
+     */
+    template <typename F>
+    static void scan(const Tier& tier, F visit);
+};
+
+#endif
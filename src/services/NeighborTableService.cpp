@@ -0,0 +1,105 @@
+#include "NeighborTableService.h"
+
+#include "RoutingTableService.h"
+
+void NeighborTableService::setInUse() {
+    while (xSemaphoreTakeRecursive(mutex, (TickType_t) 10) != pdTRUE) {
+        ESP_LOGW(LM_TAG, "Neighbor table in Use Alert");
+    }
+}
+
+void NeighborTableService::releaseInUse() {
+    xSemaphoreGiveRecursive(mutex);
+}
+
+NeighborEntry* NeighborTableService::find(uint16_t address) {
+    NeighborEntry* entry = index->find(address);
+    if (entry != nullptr)
+        entry->lastUsed = millis();
+
+    return entry;
+}
+
+NeighborEntry* NeighborTableService::getOrCreate(uint16_t address) {
+    NeighborEntry* entry = find(address);
+    if (entry != nullptr)
+        return entry;
+
+    if (length == LM_NEIGHBOR_TABLE_SIZE) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < length; i++) {
+            if ((int32_t) (entries[i].lastUsed - entries[oldest].lastUsed) < 0)
+                oldest = i;
+        }
+
+        uint16_t replaced = entries[oldest].address;
+        ESP_LOGW(LM_TAG, "Neighbor table full, replacing %X with %X", replaced, address);
+
+        removeAt(oldest);
+
+        // The costs through it were calculated with its link metrics
+        RoutingTableService::invalidateLinkCost(replaced);
+    }
+
+    entry = &entries[length++];
+    *entry = NeighborEntry();
+    entry->address = address;
+    entry->lastUsed = millis();
+    index->insert(address, entry);
+
+    return entry;
+}
+
+void NeighborTableService::linkUpdated(uint16_t address) {
+    setInUse();
+    NeighborEntry* entry = index->find(address);
+    bool changed = entry != nullptr && entry->takeLinkChange();
+    releaseInUse();
+
+    RoutingTableService::invalidateLinkCost(address);
+
+    if (changed) {
+        ESP_LOGV(LM_TAG, "Link to %X changed, re-evaluating its routes", address);
+        RoutingTableService::markLinkDirty(address);
+        RoutingTableService::reevaluateAlternates(address);
+    }
+}
+
+bool NeighborTableService::remove(uint16_t address) {
+    NeighborEntry* entry = index->find(address);
+    if (entry == nullptr)
+        return false;
+
+    removeAt(entry - entries);
+    return true;
+}
+
+size_t NeighborTableService::size() {
+    return length;
+}
+
+NeighborEntry* NeighborTableService::getEntry(size_t position) {
+    return &entries[position];
+}
+
+void NeighborTableService::clear() {
+    index->clear();
+    length = 0;
+}
+
+void NeighborTableService::removeAt(size_t position) {
+    index->remove(entries[position].address);
+
+    size_t last = length - 1;
+    if (position != last) {
+        entries[position] = entries[last];
+        index->insert(entries[position].address, &entries[position]);
+    }
+
+    length--;
+}
+
+NeighborEntry NeighborTableService::entries[LM_NEIGHBOR_TABLE_SIZE];
+size_t NeighborTableService::length = 0;
+LM_AddressIndex<NeighborEntry, LM_NEIGHBOR_INDEX_BITS>* NeighborTableService::index = new LM_AddressIndex<NeighborEntry, LM_NEIGHBOR_INDEX_BITS>();
+SemaphoreHandle_t NeighborTableService::mutex = xSemaphoreCreateRecursiveMutex();
@@ -0,0 +1,112 @@
+#ifndef _LORAMESHER_NEIGHBOR_TABLE_SERVICE_H
+#define _LORAMESHER_NEIGHBOR_TABLE_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "utilities/AddressIndex.hpp"
+
+#include "entities/routingTable/NeighborEntry.h"
+
+static_assert(LM_NEIGHBOR_TABLE_SIZE <= RTMAXSIZE, "The neighbour table cannot be bigger than the routing table");
+static_assert(((size_t) 1 << LM_NEIGHBOR_INDEX_BITS) >= 2 * LM_NEIGHBOR_TABLE_SIZE, "The neighbour index needs at least twice LM_NEIGHBOR_TABLE_SIZE slots");
+
+/**
+ * @brief Neighbour table, the link metrics and route cost history of the nodes, indexed by address like the routing table.
+ * The entries are kept contiguous and found in O(1) with a LM_AddressIndex. When it is full the least recently used
+ * entry is replaced.
+ *
+ * The entries can only be used between setInUse and releaseInUse, the lock is recursive.
+ *
+ * Example:
+ *   NeighborTableService::setInUse();
+ *   NeighborEntry* entry = NeighborTableService::getOrCreate(address);
+ *   entry->updateSignal(rssi, snr);
+ *   NeighborTableService::releaseInUse();
+ *   NeighborTableService::linkUpdated(address);
+ */
+class NeighborTableService {
+public:
+    /**
+     * @brief Take the lock of the table, it can be taken again by the same task
+     *
+     */
+    static void setInUse();
+
+    /**
+     * @brief Release the lock taken by setInUse
+     *
+     */
+    static void releaseInUse();
+
+    /**
+     * @brief Find the entry of the address
+     *
+     * @param address Address
+     * @return NeighborEntry* Entry or nullptr if not found
+     */
+    static NeighborEntry* find(uint16_t address);
+
+    /**
+     * @brief Find the entry of the address, or create it replacing the least recently used entry if the table is full
+     *
+     * @param address Address
+     * @return NeighborEntry* Entry, never nullptr
+     */
+    static NeighborEntry* getOrCreate(uint16_t address);
+
+    /**
+     * @brief Call it after updating the link metrics of an entry, with the table not in use: marking the routes dirty
+     * takes the routing table lock, which is never taken while holding the neighbor table.
+     * It invalidates the memoised costs of the routes through it and, if the ETX or the SNR moved more than
+     * LM_ETX_CHANGE_THRESHOLD or LM_SNR_CHANGE_THRESHOLD, marks them dirty in the RoutingTableService
+     *
+     * @param address Address of the entry
+     */
+    static void linkUpdated(uint16_t address);
+
+    /**
+     * @brief Remove the entry of the address. The entries after it can be moved, the pointers and positions are not valid anymore
+     *
+     * @param address Address
+     * @return true If the entry has been removed
+     */
+    static bool remove(uint16_t address);
+
+    /**
+     * @brief Number of entries
+     *
+     * @return size_t
+     */
+    static size_t size();
+
+    /**
+     * @brief Entry at a position, to iterate the table from 0 to size()
+     *
+     * @param position Position
+     * @return NeighborEntry* Entry
+     */
+    static NeighborEntry* getEntry(size_t position);
+
+    /**
+     * @brief Remove all the entries
+     *
+     */
+    static void clear();
+
+private:
+    static NeighborEntry entries[LM_NEIGHBOR_TABLE_SIZE];
+
+    static size_t length;
+
+    static LM_AddressIndex<NeighborEntry, LM_NEIGHBOR_INDEX_BITS>* index;
+
+    static SemaphoreHandle_t mutex;
+
+    /**
+     * @brief Remove the entry at the position, the last entry is moved into it
+     *
+     */
+    static void removeAt(size_t position);
+};
+
+#endif
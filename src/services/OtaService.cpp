@@ -0,0 +1,465 @@
+#include "OtaService.h"
+
+#include <algorithm>
+
+#include <mbedtls/sha256.h>
+
+#include "WiFiService.h"
+
+static constexpr uint8_t KIND_ANNOUNCE = 1;
+static constexpr uint8_t KIND_CHUNK = 2;
+static constexpr uint8_t KIND_REQUEST = 3;
+
+#pragma pack(1)
+struct OtaHeader {
+    uint8_t kind;
+    uint16_t version;
+};
+
+struct OtaAnnounce {
+    OtaHeader header;
+    uint32_t size;
+    uint8_t hash[32];
+};
+
+struct OtaChunk {
+    OtaHeader header;
+    uint16_t index;
+    uint8_t data[LM_OTA_CHUNK_SIZE];
+};
+
+struct OtaRequest {
+    OtaHeader header;
+    uint16_t first;
+    uint32_t missing;
+};
+#pragma pack()
+
+static_assert(sizeof(OtaChunk) < LM_MAX_PACKET_SIZE, "LM_OTA_CHUNK_SIZE does not fit in a packet");
+
+/**
+ * @brief Returns if a version is newer than another, the versions wrap around
+ *
+ */
+static inline bool isNewerVersion(uint16_t version, uint16_t than) {
+    return (int16_t) (version - than) > 0;
+}
+
+static inline uint32_t getWait(uint32_t now, uint32_t last, uint32_t interval) {
+    return now - last >= interval ? 0 : interval - (now - last);
+}
+
+bool OtaService::init(const char* label, uint16_t runningVersion) {
+    if (partition != nullptr) {
+        ESP_LOGW(LM_TAG, "OTA already initialized");
+        return true;
+    }
+
+    const esp_partition_t* found = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (found == nullptr) {
+        ESP_LOGE(LM_TAG, "OTA partition %s not found", label);
+        return false;
+    }
+
+    if (found->erase_size % LM_OTA_CHUNK_SIZE != 0) {
+        ESP_LOGE(LM_TAG, "OTA chunks do not fit the sectors of %d bytes", (int) found->erase_size);
+        return false;
+    }
+
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL) {
+        ESP_LOGE(LM_TAG, "OTA semaphore not created");
+        return false;
+    }
+
+    version = runningVersion;
+    partition = found;
+
+    ESP_LOGI(LM_TAG, "OTA partition %s of %d bytes, running version %d", label, (int) found->size, version);
+    return true;
+}
+
+bool OtaService::offer(uint32_t size) {
+    if (partition == nullptr || size == 0 || size > partition->size ||
+        (size + LM_OTA_CHUNK_SIZE - 1) / LM_OTA_CHUNK_SIZE > UINT16_MAX + 1) {
+        ESP_LOGE(LM_TAG, "OTA image of %d bytes not offered", (int) size);
+        return false;
+    }
+
+    uint8_t hash[32];
+    if (!hashPartition(size, hash))
+        return false;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    vPortFree(bitmap);
+    bitmap = nullptr;
+
+    state = OTA_OFFERING;
+    imageVersion = version;
+    imageSize = size;
+    memcpy(imageHash, hash, sizeof(imageHash));
+    origin = WiFiService::getLocalAddress();
+    chunks = (size + LM_OTA_CHUNK_SIZE - 1) / LM_OTA_CHUNK_SIZE;
+    received = chunks;
+
+    // The announce goes first, the chunks follow it
+    nextFlood = 0;
+    lastFlood = millis();
+    lastAnnounce = 0;
+    memset(serve, 0, sizeof(serve));
+
+    xSemaphoreGive(mutex);
+
+    ESP_LOGI(LM_TAG, "OTA image version %d of %d bytes offered in %d chunks", version, (int) size, (int) chunks);
+    return true;
+}
+
+bool OtaService::isMessage(const uint8_t* payload, size_t size) {
+    if (size < sizeof(OtaHeader))
+        return false;
+
+    uint8_t kind = payload[0];
+    return kind == KIND_ANNOUNCE || kind == KIND_CHUNK || kind == KIND_REQUEST;
+}
+
+void OtaService::process(uint16_t src, const uint8_t* payload, size_t size) {
+    const OtaHeader* header = reinterpret_cast<const OtaHeader*>(payload);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if (header->kind == KIND_ANNOUNCE) {
+        const OtaAnnounce* announce = reinterpret_cast<const OtaAnnounce*>(payload);
+
+        // Only the images newer than the running firmware and than the one received, the offering node keeps its own
+        if (size == sizeof(OtaAnnounce) && state != OTA_OFFERING && isNewerVersion(header->version, version) &&
+            (state == OTA_IDLE || isNewerVersion(header->version, imageVersion)))
+            startReceiving(src, header->version, announce->size, announce->hash);
+    }
+    else if (header->kind == KIND_CHUNK) {
+        const OtaChunk* chunk = reinterpret_cast<const OtaChunk*>(payload);
+        size_t offset = sizeof(OtaHeader) + sizeof(chunk->index);
+
+        if (size > offset && state == OTA_RECEIVING && header->version == imageVersion)
+            writeChunk(chunk->index, chunk->data, size - offset);
+    }
+    else if (header->kind == KIND_REQUEST) {
+        const OtaRequest* request = reinterpret_cast<const OtaRequest*>(payload);
+
+        if (size == sizeof(OtaRequest) && state != OTA_IDLE && header->version == imageVersion)
+            keepRequest(src, request->first, request->missing);
+    }
+
+    xSemaphoreGive(mutex);
+}
+
+size_t OtaService::next(uint16_t upstream, uint8_t* message, uint16_t& dst) {
+    if (state == OTA_IDLE)
+        return 0;
+
+    uint32_t now = millis();
+    size_t size = 0;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if (state == OTA_OFFERING && (lastAnnounce == 0 || now - lastAnnounce >= LM_OTA_ANNOUNCE_INTERVAL)) {
+        OtaAnnounce* announce = reinterpret_cast<OtaAnnounce*>(message);
+        writeHeader(message, KIND_ANNOUNCE);
+        announce->size = imageSize;
+        memcpy(announce->hash, imageHash, sizeof(imageHash));
+
+        size = sizeof(OtaAnnounce);
+        dst = LM_FLOOD_ADDRESS;
+        lastAnnounce = now == 0 ? 1 : now;
+    }
+    else if (state == OTA_OFFERING && nextFlood < chunks && now - lastFlood >= LM_OTA_CHUNK_INTERVAL) {
+        size = readChunk(nextFlood++, message);
+        dst = LM_FLOOD_ADDRESS;
+        lastFlood = now;
+    }
+    else if (now - lastServe >= LM_OTA_SERVE_INTERVAL && (size = takeServed(message)) != 0) {
+        dst = BROADCAST_ADDR;
+        lastServe = now;
+        served++;
+    }
+    else if (state == OTA_RECEIVING && now - lastProgress >= requestTimeout && now - lastRequest >= requestTimeout) {
+        OtaRequest* request = reinterpret_cast<OtaRequest*>(message);
+        writeHeader(message, KIND_REQUEST);
+
+        uint32_t first = 0;
+        while (first < chunks && hasChunk(first))
+            first++;
+
+        request->first = first;
+        request->missing = 0;
+        for (uint32_t i = 0; i < 32 && first + i < chunks; i++) {
+            if (!hasChunk(first + i))
+                request->missing |= 1u << i;
+        }
+
+        // The next hop caches the chunks on the way, the offering node has all of them
+        size = sizeof(OtaRequest);
+        dst = upstream != 0 && unanswered < LM_OTA_UPSTREAM_RETRIES ? upstream : origin;
+        lastRequest = now;
+        requestTimeout = getRequestTimeout();
+        if (unanswered < UINT8_MAX)
+            unanswered++;
+        requests++;
+    }
+
+    xSemaphoreGive(mutex);
+
+    return size;
+}
+
+uint32_t OtaService::getTimeUntilNext() {
+    if (state == OTA_IDLE)
+        return UINT32_MAX;
+
+    uint32_t now = millis();
+    uint32_t wait = UINT32_MAX;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if (state == OTA_OFFERING) {
+        wait = getWait(now, lastAnnounce, LM_OTA_ANNOUNCE_INTERVAL);
+        if (nextFlood < chunks)
+            wait = std::min(wait, getWait(now, lastFlood, LM_OTA_CHUNK_INTERVAL));
+    }
+
+    for (const ServeSlot& slot : serve) {
+        if (slot.address != 0) {
+            wait = std::min(wait, getWait(now, lastServe, LM_OTA_SERVE_INTERVAL));
+            break;
+        }
+    }
+
+    if (state == OTA_RECEIVING) {
+        uint32_t requestWait = std::max(getWait(now, lastProgress, requestTimeout), getWait(now, lastRequest, requestTimeout));
+        wait = std::min(wait, requestWait);
+    }
+
+    xSemaphoreGive(mutex);
+
+    return wait;
+}
+
+bool OtaService::hasChunk(uint32_t index) {
+    if (state == OTA_VERIFIED || state == OTA_OFFERING)
+        return index < chunks;
+
+    return bitmap != nullptr && index < chunks && (bitmap[index / 32] & (1u << (index % 32))) != 0;
+}
+
+void OtaService::startReceiving(uint16_t src, uint16_t announcedVersion, uint32_t size, const uint8_t* hash) {
+    uint32_t imageChunks = (size + LM_OTA_CHUNK_SIZE - 1) / LM_OTA_CHUNK_SIZE;
+    if (size == 0 || size > partition->size || imageChunks > UINT16_MAX + 1) {
+        ESP_LOGW(LM_TAG, "OTA image version %d of %d bytes does not fit the partition", announcedVersion, (int) size);
+        return;
+    }
+
+    uint32_t* newBitmap = static_cast<uint32_t*>(pvPortMalloc((imageChunks + 31) / 32 * sizeof(uint32_t)));
+    if (newBitmap == nullptr) {
+        ESP_LOGE(LM_TAG, "OTA bitmap of %d chunks not allocated", (int) imageChunks);
+        return;
+    }
+
+    memset(newBitmap, 0, (imageChunks + 31) / 32 * sizeof(uint32_t));
+    vPortFree(bitmap);
+    bitmap = newBitmap;
+
+    state = OTA_RECEIVING;
+    imageVersion = announcedVersion;
+    imageSize = size;
+    memcpy(imageHash, hash, sizeof(imageHash));
+    origin = src;
+    chunks = imageChunks;
+    received = 0;
+
+    lastProgress = millis();
+    lastRequest = lastProgress;
+    requestTimeout = getRequestTimeout();
+    unanswered = 0;
+    memset(serve, 0, sizeof(serve));
+
+    ESP_LOGI(LM_TAG, "OTA image version %d of %d bytes announced by %X", imageVersion, (int) size, src);
+}
+
+void OtaService::writeChunk(uint32_t index, const uint8_t* data, size_t size) {
+    if (index >= chunks || size != getChunkSize(index) || hasChunk(index))
+        return;
+
+    // The sector is erased before its first chunk, the chunks arrive in any order
+    uint32_t sectorChunks = partition->erase_size / LM_OTA_CHUNK_SIZE;
+    uint32_t sectorFirst = index - index % sectorChunks;
+    bool erased = false;
+    for (uint32_t i = sectorFirst; i < sectorFirst + sectorChunks && i < chunks; i++) {
+        if (hasChunk(i)) {
+            erased = true;
+            break;
+        }
+    }
+
+    if (!erased && esp_partition_erase_range(partition, sectorFirst * LM_OTA_CHUNK_SIZE, partition->erase_size) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "OTA sector of the chunk %d not erased", (int) index);
+        return;
+    }
+
+    if (esp_partition_write(partition, index * LM_OTA_CHUNK_SIZE, data, size) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "OTA chunk %d not written", (int) index);
+        return;
+    }
+
+    bitmap[index / 32] |= 1u << (index % 32);
+    received++;
+    ESP_LOGV(LM_TAG, "OTA chunk %d written, %d of %d", (int) index, (int) received, (int) chunks);
+    lastProgress = millis();
+    unanswered = 0;
+
+    if (received < chunks)
+        return;
+
+    uint8_t hash[32];
+    if (hashPartition(imageSize, hash) && memcmp(hash, imageHash, sizeof(hash)) == 0) {
+        state = OTA_VERIFIED;
+        vPortFree(bitmap);
+        bitmap = nullptr;
+
+        ESP_LOGI(LM_TAG, "OTA image version %d verified", imageVersion);
+        return;
+    }
+
+    // Fetched again, the sectors are erased again with their first chunk
+    hashFailures++;
+    received = 0;
+    memset(bitmap, 0, (chunks + 31) / 32 * sizeof(uint32_t));
+
+    ESP_LOGE(LM_TAG, "OTA image version %d does not match its hash", imageVersion);
+}
+
+void OtaService::keepRequest(uint16_t src, uint16_t first, uint32_t missing) {
+    // Only the chunks the node has, the others come from its own next hop first
+    for (uint32_t i = 0; i < 32; i++) {
+        if ((missing & (1u << i)) != 0 && !hasChunk(first + i))
+            missing &= ~(1u << i);
+    }
+
+    if (missing == 0)
+        return;
+
+    ServeSlot* slot = nullptr;
+    for (ServeSlot& waiting : serve) {
+        // A new request of the neighbor replaces its old one
+        if (waiting.address == src) {
+            slot = &waiting;
+            break;
+        }
+
+        if (slot == nullptr && waiting.address == 0)
+            slot = &waiting;
+    }
+
+    if (slot == nullptr)
+        return;
+
+    slot->address = src;
+    slot->first = first;
+    slot->missing = missing;
+}
+
+size_t OtaService::takeServed(uint8_t* message) {
+    uint32_t index = UINT32_MAX;
+    for (ServeSlot& slot : serve) {
+        if (slot.address == 0)
+            continue;
+
+        uint32_t i = 0;
+        while ((slot.missing & (1u << i)) == 0)
+            i++;
+
+        index = slot.first + i;
+        break;
+    }
+
+    if (index == UINT32_MAX)
+        return 0;
+
+    // The chunk goes to every neighbor, the others that requested it have it too
+    for (ServeSlot& slot : serve) {
+        if (slot.address != 0 && index >= slot.first && index < slot.first + 32u) {
+            slot.missing &= ~(1u << (index - slot.first));
+            if (slot.missing == 0)
+                slot.address = 0;
+        }
+    }
+
+    return readChunk(index, message);
+}
+
+size_t OtaService::readChunk(uint32_t index, uint8_t* message) {
+    OtaChunk* chunk = reinterpret_cast<OtaChunk*>(message);
+    writeHeader(message, KIND_CHUNK);
+    chunk->index = index;
+
+    size_t size = getChunkSize(index);
+    if (esp_partition_read(partition, index * LM_OTA_CHUNK_SIZE, chunk->data, size) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "OTA chunk %d not read", (int) index);
+        return 0;
+    }
+
+    return sizeof(OtaHeader) + sizeof(chunk->index) + size;
+}
+
+bool OtaService::hashPartition(uint32_t size, uint8_t* hash) {
+    mbedtls_sha256_context context;
+    mbedtls_sha256_init(&context);
+    mbedtls_sha256_starts(&context, 0);
+
+    uint8_t block[256];
+    bool read = true;
+    for (uint32_t offset = 0; offset < size; offset += sizeof(block)) {
+        size_t length = size - offset < sizeof(block) ? size - offset : sizeof(block);
+        if (esp_partition_read(partition, offset, block, length) != ESP_OK) {
+            ESP_LOGE(LM_TAG, "OTA partition not read at %d", (int) offset);
+            read = false;
+            break;
+        }
+
+        mbedtls_sha256_update(&context, block, length);
+    }
+
+    mbedtls_sha256_finish(&context, hash);
+    mbedtls_sha256_free(&context);
+
+    return read;
+}
+
+void OtaService::writeHeader(uint8_t* message, uint8_t kind) {
+    OtaHeader* header = reinterpret_cast<OtaHeader*>(message);
+    header->kind = kind;
+    header->version = imageVersion;
+}
+
+const esp_partition_t* OtaService::partition = nullptr;
+SemaphoreHandle_t OtaService::mutex = nullptr;
+uint16_t OtaService::version = 0;
+LM_OtaState OtaService::state = OTA_IDLE;
+uint16_t OtaService::imageVersion = 0;
+uint32_t OtaService::imageSize = 0;
+uint8_t OtaService::imageHash[32];
+uint16_t OtaService::origin = 0;
+uint32_t OtaService::chunks = 0;
+uint32_t OtaService::received = 0;
+uint32_t* OtaService::bitmap = nullptr;
+uint32_t OtaService::nextFlood = 0;
+uint32_t OtaService::lastFlood = 0;
+uint32_t OtaService::lastAnnounce = 0;
+uint32_t OtaService::lastProgress = 0;
+uint32_t OtaService::lastRequest = 0;
+uint32_t OtaService::requestTimeout = LM_OTA_REQUEST_TIMEOUT;
+uint8_t OtaService::unanswered = 0;
+OtaService::ServeSlot OtaService::serve[LM_OTA_SERVE_SLOTS];
+uint32_t OtaService::lastServe = 0;
+uint32_t OtaService::served = 0;
+uint32_t OtaService::requests = 0;
+uint32_t OtaService::hashFailures = 0;
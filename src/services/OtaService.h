@@ -0,0 +1,282 @@
+#ifndef _LORAMESHER_OTA_SERVICE_H
+#define _LORAMESHER_OTA_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include <freertos/semphr.h>
+#include <esp_partition.h>
+
+/**
+ * @brief State of the firmware update of a node
+ *
+ */
+enum LM_OtaState : uint8_t {
+    // No newer image known
+    OTA_IDLE = 0,
+    // Receiving the chunks of a newer image
+    OTA_RECEIVING = 1,
+    // The image is complete and its hash verified, the application can boot it
+    OTA_VERIFIED = 2,
+    // The node offers the image of its partition to the network
+    OTA_OFFERING = 3,
+};
+
+/**
+ * @brief Firmware updates over the mesh, see LoraMesherConfig::otaPartition. The messages are application payloads on the
+ * port LM_PORT_OTA, they are taken out before the application receives them:
+ *
+ *   Announce: kind (1), version (2), size (4), SHA-256 of the image (32)
+ *   Chunk: kind (1), version (2), index (2), data (up to LM_OTA_CHUNK_SIZE)
+ *   Request: kind (1), version (2), first chunk (2), bit n if the chunk first + n is missing (4)
+ *
+ * The offering node floods the announce and the chunks once, one every LM_OTA_CHUNK_INTERVAL ms, so every chunk crosses
+ * every link about once. The nodes with an older version write the chunks at their offset in the partition and keep a bitmap
+ * of the received ones, erasing a sector before its first chunk. The partition is the cache of the relays too: a node serves
+ * the chunks it has to the neighbors that request them, broadcast so the neighbors that lost the same ones take them too,
+ * and the chunks lost in the flood are repaired hop by hop.
+ * The image is verified with its SHA-256 when the last chunk arrives, and fetched again if it does not match.
+ *
+ */
+class OtaService {
+public:
+
+    /**
+     * @brief Open the partition of the updates
+     *
+     * @param label Label of the partition: the next update partition of a node, the running one of a node that offers its
+     * own image
+     * @param version Version of the running firmware, only the newer images are received
+     * @return true If the partition has been found
+     */
+    static bool init(const char* label, uint16_t version);
+
+    /**
+     * @brief Returns if the partition is open
+     *
+     */
+    static bool isEnabled() { return partition != nullptr; }
+
+    /**
+     * @brief Offer the image written at the start of the partition, with the version of init. It is hashed before
+     *
+     * @param size Size of the image in bytes
+     * @return true If the image is offered
+     */
+    static bool offer(uint32_t size);
+
+    /**
+     * @brief Returns if a payload of LM_PORT_OTA is a well formed message of the updates
+     *
+     */
+    static bool isMessage(const uint8_t* payload, size_t size);
+
+    /**
+     * @brief Process a received message
+     *
+     * @param src Address of the node that sent it
+     * @param payload Message, see isMessage
+     * @param size Size of the message
+     */
+    static void process(uint16_t src, const uint8_t* payload, size_t size);
+
+    /**
+     * @brief Get the next message due
+     *
+     * @param upstream Next hop to the offering node, 0 without a route
+     * @param message Buffer of LM_MAX_PACKET_SIZE bytes
+     * @param dst Destination of the message, LM_FLOOD_ADDRESS to flood it and BROADCAST_ADDR for the neighbors
+     * @return size_t Size of the message, 0 if none is due
+     */
+    static size_t next(uint16_t upstream, uint8_t* message, uint16_t& dst);
+
+    /**
+     * @brief Ms until the next message can be due
+     *
+     * @return uint32_t UINT32_MAX if there is none
+     */
+    static uint32_t getTimeUntilNext();
+
+    /**
+     * @brief Address of the node that offers the image
+     *
+     * @return uint16_t 0 without an image
+     */
+    static uint16_t getOrigin() { return origin; }
+
+    static LM_OtaState getState() { return state; }
+
+    /**
+     * @brief Chunks received of the image
+     *
+     * @return uint32_t
+     */
+    static uint32_t getReceivedChunks() { return received; }
+
+    /**
+     * @brief Chunks of the image
+     *
+     * @return uint32_t
+     */
+    static uint32_t getChunks() { return chunks; }
+
+    /**
+     * @brief Get the number of chunks served to the neighbors
+     *
+     * @return uint32_t
+     */
+    static uint32_t getServedNum() { return served; }
+
+    /**
+     * @brief Get the number of requests of missing chunks sent
+     *
+     * @return uint32_t
+     */
+    static uint32_t getRequestsNum() { return requests; }
+
+    /**
+     * @brief Get the number of complete images whose hash did not match
+     *
+     * @return uint32_t
+     */
+    static uint32_t getHashFailuresNum() { return hashFailures; }
+
+private:
+
+    /**
+     * @brief Chunks requested by a neighbor
+     *
+     */
+    struct ServeSlot {
+        uint16_t address;
+        uint16_t first;
+        uint32_t missing;
+    };
+
+    static const esp_partition_t* partition;
+
+    static SemaphoreHandle_t mutex;
+
+    static uint16_t version;
+
+    static LM_OtaState state;
+
+    /**
+     * @brief Image being received or offered
+     *
+     */
+    static uint16_t imageVersion;
+
+    static uint32_t imageSize;
+
+    static uint8_t imageHash[32];
+
+    static uint16_t origin;
+
+    static uint32_t chunks;
+
+    static uint32_t received;
+
+    /**
+     * @brief Bit n is set if the chunk n is in the partition, allocated while receiving
+     *
+     */
+    static uint32_t* bitmap;
+
+    /**
+     * @brief Next chunk to flood by the offering node and millis() of the last one
+     *
+     */
+    static uint32_t nextFlood;
+
+    static uint32_t lastFlood;
+
+    static uint32_t lastAnnounce;
+
+    /**
+     * @brief millis() of the last new chunk and of the last request, and requests since the last new chunk
+     *
+     */
+    static uint32_t lastProgress;
+
+    static uint32_t lastRequest;
+
+    static uint8_t unanswered;
+
+    /**
+     * @brief Wait before the next request, random so the neighbors that lost the same chunks do not request them together
+     *
+     */
+    static uint32_t requestTimeout;
+
+    static ServeSlot serve[LM_OTA_SERVE_SLOTS];
+
+    static uint32_t lastServe;
+
+    static uint32_t served;
+
+    static uint32_t requests;
+
+    static uint32_t hashFailures;
+
+    static uint32_t getChunkSize(uint32_t index) {
+        uint32_t offset = index * LM_OTA_CHUNK_SIZE;
+        return imageSize - offset < LM_OTA_CHUNK_SIZE ? imageSize - offset : LM_OTA_CHUNK_SIZE;
+    }
+
+    static uint32_t getRequestTimeout() {
+        return LM_OTA_REQUEST_TIMEOUT + random(0, LM_OTA_REQUEST_TIMEOUT);
+    }
+
+    /**
+     * @brief Returns if the node has a chunk of the image, protected by the mutex
+     *
+     */
+    static bool hasChunk(uint32_t index);
+
+    /**
+     * @brief Start receiving an announced image, protected by the mutex
+     *
+     */
+    static void startReceiving(uint16_t src, uint16_t announcedVersion, uint32_t size, const uint8_t* hash);
+
+    /**
+     * @brief Write a received chunk in the partition, protected by the mutex
+     *
+     */
+    static void writeChunk(uint32_t index, const uint8_t* data, size_t size);
+
+    /**
+     * @brief Keep the chunks requested by a neighbor that the node has, protected by the mutex
+     *
+     */
+    static void keepRequest(uint16_t src, uint16_t first, uint32_t missing);
+
+    /**
+     * @brief Build the message of the next chunk requested by the neighbors, protected by the mutex
+     *
+     * @return size_t Size of the message, 0 if no chunk is requested
+     */
+    static size_t takeServed(uint8_t* message);
+
+    /**
+     * @brief Build the message of a chunk read from the partition, protected by the mutex
+     *
+     * @return size_t Size of the message, 0 if it could not be read
+     */
+    static size_t readChunk(uint32_t index, uint8_t* message);
+
+    /**
+     * @brief SHA-256 of the first size bytes of the partition
+     *
+     * @return true If the partition could be read
+     */
+    static bool hashPartition(uint32_t size, uint8_t* hash);
+
+    /**
+     * @brief Fill the header of a message of the image
+     *
+     */
+    static void writeHeader(uint8_t* message, uint8_t kind);
+};
+
+#endif
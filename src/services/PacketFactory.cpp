@@ -1,3 +1,5 @@
 #include "PacketFactory.h"
 
-size_t* PacketFactory::maxPacketSize = nullptr;
\ No newline at end of file
+#if !LM_FIXED_PACKET_SIZE
+size_t PacketFactory::maxPacketSize = 0;
+#endif
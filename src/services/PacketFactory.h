@@ -3,20 +3,43 @@
 
 #include "entities/packets/Packet.h"
 
+static_assert(LM_FIXED_PACKET_SIZE <= LM_MAX_PACKET_SIZE, "LM_FIXED_PACKET_SIZE does not fit the buffers of LM_MAX_PACKET_SIZE");
+
 class PacketFactory {
 public:
 
     static void setMaxPacketSize(size_t setMaxPacketSize) {
-        if (maxPacketSize == nullptr)
-            maxPacketSize = new size_t(setMaxPacketSize);
-        else
-            *maxPacketSize = setMaxPacketSize;
+#if LM_FIXED_PACKET_SIZE
+        if (setMaxPacketSize != LM_FIXED_PACKET_SIZE)
+            ESP_LOGW(LM_TAG, "Max packet size fixed to %d bytes at compile time", LM_FIXED_PACKET_SIZE);
+#else
+        maxPacketSize = setMaxPacketSize;
+#endif
     }
 
-    static size_t getMaxPacketSize() {
-        if (maxPacketSize == nullptr)
-            return 0;
-        return *maxPacketSize;
+    /**
+     * @brief Maximum size of a packet on air
+     *
+     * @return size_t
+     */
+#if LM_FIXED_PACKET_SIZE
+    static constexpr size_t getMaxPacketSize() { return LM_FIXED_PACKET_SIZE; }
+#else
+    static size_t getMaxPacketSize() { return maxPacketSize; }
+#endif
+
+    /**
+     * @brief Maximum size of a packet in memory. With LM_COMPACT_HEADER the header in memory
+     * is bigger than the one sent, so a packet of getMaxPacketSize bytes on air can be bigger in memory
+     *
+     * @return size_t
+     */
+    static size_t getMaxMemoryPacketSize() {
+#if LM_COMPACT_HEADER
+        return getMaxPacketSize() + LM_COMPACT_HEADER_EXPANSION;
+#else
+        return getMaxPacketSize();
+#endif
     }
 
     /**
@@ -25,14 +48,15 @@ public:
      * @tparam T The packet type to create
      * @param payload Pointer to the payload data (can be nullptr if payloadSize is 0)
      * @param payloadSize Size of the payload in bytes
+     * @param bulk Allocate it as a bulk buffer, for packets stored and not sent themselves
      * @return T* Pointer to the newly created packet, or nullptr if allocation failed
      */
     template <typename T>
-    static T* createPacket(const uint8_t* payload, size_t payloadSize) {
+    static T* createPacket(const uint8_t* payload, size_t payloadSize, bool bulk = false) {
         // Calculate the total packet size (header + payload)
         const size_t headerSize = sizeof(T);
         const size_t requestedPacketSize = headerSize + payloadSize;
-        const size_t maxPacketSize = PacketFactory::getMaxPacketSize();
+        const size_t maxPacketSize = PacketFactory::getMaxMemoryPacketSize();
 
         // Determine actual packet size, respecting maximum limits
         size_t actualPacketSize = requestedPacketSize;
@@ -45,7 +69,8 @@ public:
         ESP_LOGV(LM_TAG, "Creating packet with %u bytes", actualPacketSize);
 
         // Allocate memory for the packet
-        T* packet = static_cast<T*>(pvPortMalloc(actualPacketSize));
+        void* memory = bulk ? PacketPoolService::allocateBulk(actualPacketSize) : PacketPoolService::allocate(actualPacketSize);
+        T* packet = static_cast<T*>(memory);
         if (packet == nullptr) {
             ESP_LOGE(LM_TAG, "Failed to allocate packet memory");
             return nullptr;
@@ -76,7 +101,9 @@ public:
     };
 
 private:
-    static size_t* maxPacketSize;
+#if !LM_FIXED_PACKET_SIZE
+    static size_t maxPacketSize;
+#endif
 
 };
 
@@ -0,0 +1,239 @@
+#include "PacketPoolService.h"
+
+#include "entities/packets/Packet.h"
+#include "entities/packets/QueuePacket.h"
+
+#include "MemoryService.h"
+
+// Blocks are aligned to 4 bytes, enough for the free list pointer and the packed packets
+static size_t alignBlockSize(size_t size) {
+    if (size < sizeof(void*))
+        size = sizeof(void*);
+    return (size + 3) & ~((size_t) 3);
+}
+
+bool PacketPoolService::init(size_t maxPacketSize, size_t blocksPerClass) {
+    if (arena != nullptr) {
+        ESP_LOGW(LM_TAG, "Packet pool already initialized");
+        return false;
+    }
+
+    if (blocksPerClass == 0)
+        return false;
+
+    numberOfSizeClasses = 0;
+
+    // Queue packets share the pool to avoid a separate heap allocation for each one
+    addSizeClass(sizeof(QueuePacket<Packet<uint8_t>>), blocksPerClass);
+
+    size_t blockSize = 32;
+    size_t maxBlockSize = alignBlockSize(maxPacketSize);
+    while (blockSize < maxBlockSize && numberOfSizeClasses < LM_POOL_MAX_SIZE_CLASSES - 1) {
+        addSizeClass(blockSize, blocksPerClass);
+        blockSize *= 2;
+    }
+
+    addSizeClass(maxBlockSize, blocksPerClass);
+
+    size_t arenaSize = 0;
+    for (uint8_t i = 0; i < numberOfSizeClasses; i++)
+        arenaSize += sizeClasses[i].blockSize * sizeClasses[i].blocks;
+
+    uint8_t* memory = static_cast<uint8_t*>(pvPortMalloc(arenaSize));
+    if (memory == nullptr) {
+        ESP_LOGE(LM_TAG, "Packet pool of %d bytes not allocated", arenaSize);
+        numberOfSizeClasses = 0;
+        return false;
+    }
+
+    uint8_t* current = memory;
+    for (uint8_t i = 0; i < numberOfSizeClasses; i++) {
+        SizeClass* sc = &sizeClasses[i];
+        sc->start = current;
+        sc->freeList = nullptr;
+
+        // Build the free list backwards, so the first allocation is the first block
+        for (size_t b = sc->blocks; b > 0; b--) {
+            void* block = sc->start + (b - 1) * sc->blockSize;
+            *static_cast<void**>(block) = sc->freeList;
+            sc->freeList = block;
+        }
+
+        current += sc->blockSize * sc->blocks;
+        ESP_LOGI(LM_TAG, "Packet pool class %d: %d blocks of %d bytes", i, sc->blocks, sc->blockSize);
+    }
+
+    arenaEnd = current;
+    arena = memory;
+
+    ESP_LOGI(LM_TAG, "Packet pool initialized with %d bytes", arenaSize);
+    return true;
+}
+
+void PacketPoolService::addSizeClass(size_t blockSize, size_t blocks) {
+    blockSize = alignBlockSize(blockSize);
+
+    // Skip the sizes already covered by the previous class
+    if (numberOfSizeClasses > 0 && sizeClasses[numberOfSizeClasses - 1].blockSize >= blockSize)
+        return;
+
+    SizeClass* sc = &sizeClasses[numberOfSizeClasses++];
+    sc->blockSize = blockSize;
+    sc->blocks = blocks;
+    sc->start = nullptr;
+    sc->freeList = nullptr;
+    sc->inUse = 0;
+    sc->highWater = 0;
+    sc->exhausted = 0;
+}
+
+// The heap gives the size of its blocks, release does not know the size requested
+static void* allocateHeap(size_t size, LM_MemoryTag tag) {
+    void* p = pvPortMalloc(size);
+    if (p != nullptr)
+        MemoryService::add(tag, heap_caps_get_allocated_size(p));
+    return p;
+}
+
+void* PacketPoolService::allocate(size_t size, LM_MemoryTag tag) {
+    if (arena == nullptr)
+        return allocateHeap(size, tag);
+
+    SizeClass* fitting = nullptr;
+
+    portENTER_CRITICAL(&poolMux);
+
+    for (uint8_t i = 0; i < numberOfSizeClasses; i++) {
+        SizeClass* sc = &sizeClasses[i];
+        if (sc->blockSize < size)
+            continue;
+
+        if (fitting == nullptr)
+            fitting = sc;
+
+        // Use a bigger class if the fitting one is empty
+        if (sc->freeList != nullptr) {
+            void* block = sc->freeList;
+            sc->freeList = *static_cast<void**>(block);
+            sc->inUse++;
+            if (sc->inUse > sc->highWater)
+                sc->highWater = sc->inUse;
+
+            portEXIT_CRITICAL(&poolMux);
+            MemoryService::add(tag, sc->blockSize);
+            return block;
+        }
+    }
+
+    if (fitting != nullptr)
+        fitting->exhausted++;
+
+    portEXIT_CRITICAL(&poolMux);
+
+    if (fitting != nullptr)
+        ESP_LOGW(LM_TAG, "Packet pool exhausted for %d bytes, using heap", size);
+
+    return allocateHeap(size, tag);
+}
+
+void PacketPoolService::release(void* p, LM_MemoryTag tag) {
+    if (p == nullptr)
+        return;
+
+    uint8_t* block = static_cast<uint8_t*>(p);
+    if (arena == nullptr || block < arena || block >= arenaEnd) {
+        // Also the bulk buffers in PSRAM, vPortFree frees every heap
+        MemoryService::remove(tag, heap_caps_get_allocated_size(p));
+        vPortFree(p);
+        return;
+    }
+
+    size_t blockSize = 0;
+
+    portENTER_CRITICAL(&poolMux);
+
+    for (uint8_t i = 0; i < numberOfSizeClasses; i++) {
+        SizeClass* sc = &sizeClasses[i];
+        if (block >= sc->start + sc->blockSize * sc->blocks)
+            continue;
+
+        *static_cast<void**>(p) = sc->freeList;
+        sc->freeList = p;
+        sc->inUse--;
+        blockSize = sc->blockSize;
+        break;
+    }
+
+    portEXIT_CRITICAL(&poolMux);
+
+    MemoryService::remove(tag, blockSize);
+}
+
+void* PacketPoolService::allocateBulk(size_t size, LM_MemoryTag tag) {
+    if (bulkInPsram) {
+        void* p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (p != nullptr) {
+            portENTER_CRITICAL(&poolMux);
+            psramAllocations++;
+            portEXIT_CRITICAL(&poolMux);
+            MemoryService::add(tag, heap_caps_get_allocated_size(p));
+            return p;
+        }
+
+        ESP_LOGW(LM_TAG, "Bulk buffer of %d bytes not allocated in PSRAM, using internal RAM", size);
+    }
+
+    return allocate(size, tag);
+}
+
+void PacketPoolService::setBulkInPsram(bool enabled) {
+    bulkInPsram = enabled && heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+
+    if (bulkInPsram)
+        ESP_LOGI(LM_TAG, "Bulk buffers in PSRAM, %d bytes free", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    else if (enabled)
+        ESP_LOGI(LM_TAG, "No PSRAM, bulk buffers in internal RAM");
+}
+
+PacketPoolStats PacketPoolService::getStats(uint8_t sizeClass) {
+    PacketPoolStats stats;
+    if (sizeClass >= numberOfSizeClasses)
+        return stats;
+
+    portENTER_CRITICAL(&poolMux);
+
+    SizeClass* sc = &sizeClasses[sizeClass];
+    stats.blockSize = sc->blockSize;
+    stats.blocks = sc->blocks;
+    stats.inUse = sc->inUse;
+    stats.highWater = sc->highWater;
+    stats.exhausted = sc->exhausted;
+
+    portEXIT_CRITICAL(&poolMux);
+
+    return stats;
+}
+
+size_t PacketPoolService::getHighWater() {
+    size_t highWater = 0;
+    for (uint8_t i = 0; i < numberOfSizeClasses; i++)
+        highWater += sizeClasses[i].highWater;
+
+    return highWater;
+}
+
+uint32_t PacketPoolService::getExhaustedNum() {
+    uint32_t exhausted = 0;
+    for (uint8_t i = 0; i < numberOfSizeClasses; i++)
+        exhausted += sizeClasses[i].exhausted;
+
+    return exhausted;
+}
+
+PacketPoolService::SizeClass PacketPoolService::sizeClasses[LM_POOL_MAX_SIZE_CLASSES];
+uint8_t PacketPoolService::numberOfSizeClasses = 0;
+uint8_t* PacketPoolService::arena = nullptr;
+uint8_t* PacketPoolService::arenaEnd = nullptr;
+portMUX_TYPE PacketPoolService::poolMux = portMUX_INITIALIZER_UNLOCKED;
+bool PacketPoolService::bulkInPsram = false;
+uint32_t PacketPoolService::psramAllocations = 0;
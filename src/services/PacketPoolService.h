@@ -0,0 +1,160 @@
+#ifndef _LORAMESHER_PACKET_POOL_SERVICE_H
+#define _LORAMESHER_PACKET_POOL_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "MemoryService.h"
+
+// Maximum number of size classes of the packet pool
+#define LM_POOL_MAX_SIZE_CLASSES 6
+
+/**
+ * @brief Statistics of one size class of the packet pool
+ *
+ */
+struct PacketPoolStats {
+    size_t blockSize = 0;
+    size_t blocks = 0;
+    size_t inUse = 0;
+    size_t highWater = 0;
+    uint32_t exhausted = 0;
+};
+
+/**
+ * @brief Fixed block pool for packets and queue packets.
+ * The blocks are carved from a single allocation done at init, so forwarding packets does not fragment the heap.
+ * When the pool is not initialized, the request is bigger than every size class or all the blocks are in use,
+ * the memory is allocated with pvPortMalloc. release() knows where every block comes from.
+ *
+ * The bulk buffers, big or stored for a long time and never given to the radio, can be placed in the PSRAM with
+ * allocateBulk. They are released with release() too, the heap frees the PSRAM memory.
+ *
+ */
+class PacketPoolService {
+public:
+
+    /**
+     * @brief Initialize the pool. The size classes are the queue packet size and powers of two up to maxPacketSize.
+     * It can only be initialized once, the blocks cannot be moved while packets are alive.
+     *
+     * @param maxPacketSize Maximum packet size in bytes
+     * @param blocksPerClass Number of blocks of every size class, 0 disables the pool
+     * @return true If the pool has been initialized
+     * @return false If it was already initialized, disabled or there is no memory
+     */
+    static bool init(size_t maxPacketSize, size_t blocksPerClass);
+
+    /**
+     * @brief Allocate a block of memory of at least size bytes
+     *
+     * @param size Size in bytes
+     * @param tag Subsystem the memory is accounted to
+     * @return void* Pointer to the memory or nullptr
+     */
+    static void* allocate(size_t size, LM_MemoryTag tag = MEMORY_PACKETS);
+
+    /**
+     * @brief Release the memory given by allocate, to the pool or to the heap
+     *
+     * @param p Pointer to the memory, can be nullptr
+     * @param tag Subsystem given to allocate
+     */
+    static void release(void* p, LM_MemoryTag tag = MEMORY_PACKETS);
+
+    /**
+     * @brief Allocate a bulk buffer, in the PSRAM when enabled and available, like allocate otherwise.
+     * It must not be used for the packets of the radio path or the DMA buffers
+     *
+     * @param size Size in bytes
+     * @param tag Subsystem the memory is accounted to
+     * @return void* Pointer to the memory or nullptr
+     */
+    static void* allocateBulk(size_t size, LM_MemoryTag tag = MEMORY_PACKETS);
+
+    /**
+     * @brief Enable the PSRAM for the bulk buffers. It is not enabled if the board has no PSRAM
+     *
+     * @param enabled If enabled
+     */
+    static void setBulkInPsram(bool enabled);
+
+    /**
+     * @brief Get the number of bulk buffers allocated in the PSRAM
+     *
+     * @return uint32_t
+     */
+    static uint32_t getPsramAllocationsNum() { return psramAllocations; }
+
+    /**
+     * @brief Returns if the pool has been initialized
+     *
+     * @return true If initialized
+     * @return false If not initialized
+     */
+    static bool isInitialized() { return arena != nullptr; }
+
+    /**
+     * @brief Get the Number Of Size Classes
+     *
+     * @return uint8_t
+     */
+    static uint8_t getNumberOfSizeClasses() { return numberOfSizeClasses; }
+
+    /**
+     * @brief Get the statistics of a size class
+     *
+     * @param sizeClass Index of the size class
+     * @return PacketPoolStats
+     */
+    static PacketPoolStats getStats(uint8_t sizeClass);
+
+    /**
+     * @brief Get the sum of the high water marks of all the size classes
+     *
+     * @return size_t
+     */
+    static size_t getHighWater();
+
+    /**
+     * @brief Get the number of allocations that could not be served by the pool and went to the heap
+     *
+     * @return uint32_t
+     */
+    static uint32_t getExhaustedNum();
+
+private:
+
+    struct SizeClass {
+        size_t blockSize;
+        size_t blocks;
+        uint8_t* start;
+        void* freeList;
+        size_t inUse;
+        size_t highWater;
+        uint32_t exhausted;
+    };
+
+    static SizeClass sizeClasses[LM_POOL_MAX_SIZE_CLASSES];
+
+    static uint8_t numberOfSizeClasses;
+
+    static uint8_t* arena;
+
+    static uint8_t* arenaEnd;
+
+    static portMUX_TYPE poolMux;
+
+    static bool bulkInPsram;
+
+    static uint32_t psramAllocations;
+
+    /**
+     * @brief Add a size class to the pool configuration
+     *
+     * @param blockSize Block size in bytes
+     * @param blocks Number of blocks
+     */
+    static void addSizeClass(size_t blockSize, size_t blocks);
+};
+
+#endif
@@ -1,19 +1,74 @@
 #include "PacketQueueService.h"
 
-void PacketQueueService::addOrdered(LM_LinkedList<QueuePacket<Packet<uint8_t>>>* list, QueuePacket<Packet<uint8_t>>* qp) {
-    list->setInUse();
-    if (list->moveToStart()) {
-        do {
-            QueuePacket<Packet<uint8_t>>* current = list->getCurrent();
-            if (current->priority < qp->priority) {
-                list->addCurrent(qp);
-                list->releaseInUse();
-                return;
-            }
-        } while (list->next());
+#include "RoutingTableService.h"
+
+#include "RoleService.h"
+
+uint16_t PacketQueueService::getFlow(Packet<uint8_t>* p) {
+    if (!PacketService::isDataPacket(p->type) || p->dst == BROADCAST_ADDR || p->dst == LM_FLOOD_ADDRESS ||
+        RoleService::isMulticastAddress(p->dst))
+        return BROADCAST_ADDR;
+
+    // The snapshot does not take the routing table mutex, the callers can be holding other queues
+    return RoutingTableService::getSnapshotNextHop(p->dst);
+}
+
+void PacketQueueService::addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp) {
+    uint16_t flow = getFlow(qp->packet);
+
+    queue->setInUse();
+
+    queue->Add(qp, flow);
+
+    queue->releaseInUse();
+}
+
+LM_EnqueueResult PacketQueueService::addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp,
+    size_t capacity, LM_DropPolicy policy, QueuePacket<Packet<uint8_t>>*& dropped) {
+    queue->setInUse();
+
+    LM_EnqueueResult result = addOrderedInUse(queue, qp, capacity, policy, dropped);
+
+    queue->releaseInUse();
+
+    return result;
+}
+
+void PacketQueueService::addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>** qps, size_t count,
+    size_t capacity, LM_DropPolicy policy, LM_EnqueueResult* results, QueuePacket<Packet<uint8_t>>** dropped) {
+    queue->setInUse();
+
+    for (size_t i = 0; i < count; i++)
+        results[i] = addOrderedInUse(queue, qps[i], capacity, policy, dropped[i]);
+
+    queue->releaseInUse();
+}
+
+LM_EnqueueResult PacketQueueService::addOrderedInUse(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp,
+    size_t capacity, LM_DropPolicy policy, QueuePacket<Packet<uint8_t>>*& dropped) {
+    uint16_t flow = getFlow(qp->packet);
+    LM_EnqueueResult result = ENQUEUE_OK;
+    dropped = nullptr;
+
+    if (capacity > 0 && queue->getLength() >= capacity) {
+        switch (policy) {
+            case DROP_POLICY_OLDEST:
+                dropped = queue->RemoveOldest();
+                break;
+            case DROP_POLICY_PRIORITY:
+                dropped = queue->RemoveLowerPriority(qp->priority);
+                break;
+            default:
+                break;
+        }
+
+        result = dropped != nullptr ? ENQUEUE_OK_DROPPED_OTHER : ENQUEUE_QUEUE_FULL;
     }
 
-    list->Append(qp);
+    if (result == ENQUEUE_QUEUE_FULL)
+        dropped = qp;
+    else
+        queue->Add(qp, flow);
 
-    list->releaseInUse();
-}
\ No newline at end of file
+    return result;
+}
@@ -7,11 +7,141 @@
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/PriorityQueue.hpp"
+
 #include "BuildOptions.h"
 
+/**
+ * @brief What to do when a packet is added to a full queue
+ *
+ */
+enum LM_DropPolicy {
+    // The new packet is not added
+    DROP_POLICY_TAIL,
+    // The packet added first is dropped
+    DROP_POLICY_OLDEST,
+    // The oldest packet of the lowest priority is dropped, if its priority is lower than the new one. The new packet is not added otherwise
+    DROP_POLICY_PRIORITY
+};
+
+/**
+ * @brief Result of adding a packet to a send or receive queue
+ *
+ */
+enum LM_EnqueueResult {
+    // The packet has been added
+    ENQUEUE_OK,
+    // The packet has been added, another packet of the full queue has been dropped
+    ENQUEUE_OK_DROPPED_OTHER,
+    // The queue is full, the packet has been dropped
+    ENQUEUE_QUEUE_FULL,
+    // The packet is a duplicate, it has been dropped
+    ENQUEUE_DUPLICATE,
+    // The packet is empty or could not be created
+    ENQUEUE_INVALID,
+    // The destination is not in the routing table
+    ENQUEUE_NO_ROUTE
+};
+
+/**
+ * @brief Optional delivery constraints of an application packet, see LoraMesher::sendPacket
+ *
+ */
+struct LM_SendOptions {
+    // ms after it is queued that the packet is not sent anymore, 0 without limit
+    uint32_t maxAge = 0;
+    // millis() after which the packet is not sent anymore, 0 without deadline. The earliest of maxAge and deadline is used
+    uint32_t deadline = 0;
+    // Key of the reading, the packets queued to the same destination with the same key are replaced by this one. 0 keeps them
+    uint16_t replaceKey = 0;
+    // Port of the application of the payload with LoraMesherConfig::applicationPorts, see LoraMesher::bindPort. The ports
+    // of the library are refused, see LM_PORT_OTA
+    uint8_t port = 0;
+};
+
+/**
+ * @brief Packet of a burst sent with LoraMesher::sendBatch
+ *
+ */
+struct LM_SendBatchEntry {
+    uint16_t dst;
+    const uint8_t* payload;
+    uint32_t payloadSize;
+    // Priority in the send queue, DEFAULT_PRIORITY for bulk data or LM_PRIORITY_ALARM for alarms
+    uint8_t priority = DEFAULT_PRIORITY;
+    // Port of the application with LoraMesherConfig::applicationPorts
+    uint8_t port = 0;
+};
+
+/**
+ * @brief Traffic classes of the send queue, from the lowest to the highest. The class of a packet is given by its
+ * priority, see LM_PRIORITY_ALARM. A higher class is sent first, and the airtime budget reserves a share of the burst
+ * for the classes above the bulk and the alarm data, see LoraMesherConfig::controlAirtimeShare
+ *
+ */
+static_assert(DEFAULT_PRIORITY + 1 < LM_PRIORITY_ALARM && LM_PRIORITY_ALARM < LM_PRIORITY_ROUTING &&
+    LM_PRIORITY_ROUTING < LM_PRIORITY_CONTROL && LM_PRIORITY_CONTROL < MAX_PRIORITY, "The traffic classes need increasing priorities");
+
+enum LM_TrafficClass {
+    // Application data, the forwarded data packets and the fragments of the large payloads
+    TRAFFIC_CLASS_BULK,
+    // Real time application data, see LoraMesher::sendAlarm
+    TRAFFIC_CLASS_ALARM,
+    // HELLO packets
+    TRAFFIC_CLASS_ROUTING,
+    // ACKs, lost packets and hop ACKs of the reliable transfers, they are never held by a reserved share
+    TRAFFIC_CLASS_CONTROL,
+    TRAFFIC_CLASS_NUM
+};
+
+/**
+ * @brief Returns if the packet has been added by the queue
+ *
+ * @param result Enqueue result
+ */
+inline bool isEnqueued(LM_EnqueueResult result) {
+    return result == ENQUEUE_OK || result == ENQUEUE_OK_DROPPED_OTHER;
+}
+
 class PacketQueueService {
 public:
 
+    /**
+     * @brief Traffic class of a priority
+     *
+     * @param priority Priority of the send queue
+     * @return LM_TrafficClass Class
+     */
+    static LM_TrafficClass getTrafficClass(uint8_t priority) {
+        if (priority >= LM_PRIORITY_CONTROL)
+            return TRAFFIC_CLASS_CONTROL;
+        if (priority >= LM_PRIORITY_ROUTING)
+            return TRAFFIC_CLASS_ROUTING;
+        if (priority >= LM_PRIORITY_ALARM)
+            return TRAFFIC_CLASS_ALARM;
+        return TRAFFIC_CLASS_BULK;
+    }
+
+    /**
+     * @brief Priority of a resent packet, the highest one of its class, so it is sent before the rest of its class
+     * without overtaking the higher classes
+     *
+     * @param priority Priority of the packet
+     * @return uint8_t Priority
+     */
+    static uint8_t getResendPriority(uint8_t priority) {
+        switch (getTrafficClass(priority)) {
+            case TRAFFIC_CLASS_BULK:
+                return LM_PRIORITY_ALARM - 1;
+            case TRAFFIC_CLASS_ALARM:
+                return LM_PRIORITY_ROUTING - 1;
+            case TRAFFIC_CLASS_ROUTING:
+                return LM_PRIORITY_CONTROL - 1;
+            default:
+                return MAX_PRIORITY;
+        }
+    }
+
     /**
      * @brief Create a Queue Packet object
      *
@@ -43,7 +173,7 @@ public:
      * @return QueuePacket<T>* QueueElement inside the list
      */
     template<class T>
-    static QueuePacket<T>* findPacketQueue(LM_LinkedList<QueuePacket<T>>* queue, uint8_t num) {
+    static QueuePacket<T>* findPacketQueue(LM_LinkedList<QueuePacket<T>>* queue, uint16_t num) {
         queue->setInUse();
 
         if (queue->moveToStart()) {
@@ -64,12 +194,49 @@ public:
     }
 
     /**
-     * @brief Add the Queue packet into the list ordered
+     * @brief Add the Queue packet into the queue ordered by priority, in the flow of its next hop
      *
-     * @param list Linked list to add the QueuePacket
+     * @param queue Priority queue to add the QueuePacket
      * @param qp Queue packet to be added
      */
-    static void addOrdered(LM_LinkedList<QueuePacket<Packet<uint8_t>>>* list, QueuePacket<Packet<uint8_t>>* qp);
+    static void addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp);
+
+    /**
+     * @brief Add the Queue packet into the queue ordered by priority, without exceeding the capacity.
+     * When the queue is full the drop policy chooses the packet dropped, it is returned and not deleted
+     *
+     * @param queue Priority queue to add the QueuePacket
+     * @param qp Queue packet to be added
+     * @param capacity Maximum number of packets in the queue, 0 for no limit
+     * @param policy Drop policy when the queue is full
+     * @param dropped Output packet dropped, the new one or one of the queue. nullptr if none
+     * @return LM_EnqueueResult ENQUEUE_OK, ENQUEUE_OK_DROPPED_OTHER or ENQUEUE_QUEUE_FULL
+     */
+    static LM_EnqueueResult addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp,
+        size_t capacity, LM_DropPolicy policy, QueuePacket<Packet<uint8_t>>*& dropped);
+
+    /**
+     * @brief Add several Queue packets like addOrdered with the capacity, in order and holding the queue once
+     *
+     * @param queue Priority queue to add the QueuePackets
+     * @param qps Queue packets to be added
+     * @param count Number of queue packets
+     * @param capacity Maximum number of packets in the queue, 0 for no limit
+     * @param policy Drop policy when the queue is full
+     * @param results Output result of every queue packet
+     * @param dropped Output packet dropped by every queue packet, the new one or one of the queue. nullptr if none
+     */
+    static void addOrdered(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>** qps, size_t count,
+        size_t capacity, LM_DropPolicy policy, LM_EnqueueResult* results, QueuePacket<Packet<uint8_t>>** dropped);
+
+    /**
+     * @brief Get the flow of a packet inside the send queue, the next hop for the unicast data packets.
+     * BROADCAST_ADDR for the other packets and 0 if the destination is not reachable
+     *
+     * @param p Packet
+     * @return uint16_t Flow key
+     */
+    static uint16_t getFlow(Packet<uint8_t>* p);
 
     /**
      * @brief It will delete the packet queue and the packet inside it
@@ -78,7 +245,7 @@ public:
      */
     static void deleteQueuePacketAndPacket(QueuePacket<Packet<uint8_t>>* pq) {
         ESP_LOGI(LM_TAG, "Deleting packet");
-        vPortFree(pq->packet);
+        PacketPoolService::release(pq->packet);
 
         ESP_LOGI(LM_TAG, "Deleting packet queue");
         delete pq;
@@ -95,6 +262,14 @@ public:
         deleteQueuePacketAndPacket(reinterpret_cast<QueuePacket<Packet<uint8_t>>*>(pq));
     }
 
+private:
+
+    /**
+     * @brief addOrdered with the capacity, the queue is in use by the caller
+     *
+     */
+    static LM_EnqueueResult addOrderedInUse(LM_PriorityQueue<QueuePacket<Packet<uint8_t>>>* queue, QueuePacket<Packet<uint8_t>>* qp,
+        size_t capacity, LM_DropPolicy policy, QueuePacket<Packet<uint8_t>>*& dropped);
 };
 
 #endif
@@ -1,13 +1,17 @@
 #include "PacketService.h"
 
+#include "CompactHeaderService.h"
+
+#include "utilities/CompactNodeCodec.hpp"
+
 Packet<uint8_t>* PacketService::createEmptyPacket(size_t packetSize) {
-    size_t maxPacketSize = PacketFactory::getMaxPacketSize();
+    size_t maxPacketSize = PacketFactory::getMaxMemoryPacketSize();
     if (packetSize > maxPacketSize) {
         ESP_LOGI(LM_TAG, "Trying to create a packet greater than %d bytes", maxPacketSize);
         packetSize = maxPacketSize;
     }
 
-    Packet<uint8_t>* p = static_cast<Packet<uint8_t>*>(pvPortMalloc(packetSize));
+    Packet<uint8_t>* p = static_cast<Packet<uint8_t>*>(PacketPoolService::allocate(packetSize));
 
     ESP_LOGI(LM_TAG, "Packet created with %d bytes", packetSize);
 
@@ -32,7 +36,7 @@ AppPacket<uint8_t>* PacketService::convertPacket(DataPacket* p) {
 AppPacket<uint8_t>* PacketService::createAppPacket(uint16_t dst, uint16_t src, uint8_t* payload, uint32_t payloadSize) {
     int packetLength = sizeof(AppPacket<uint8_t>) + payloadSize;
 
-    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(pvPortMalloc(packetLength));
+    AppPacket<uint8_t>* p = static_cast<AppPacket<uint8_t>*>(PacketPoolService::allocate(packetLength));
 
     if (p) {
         //Copy the payload into the packet
@@ -46,6 +50,11 @@ AppPacket<uint8_t>* PacketService::createAppPacket(uint16_t dst, uint16_t src, u
     p->dst = dst;
     p->src = src;
     p->payloadSize = payloadSize;
+    p->rssi = 0;
+    p->snr = 0;
+    p->hopCount = 0;
+    p->previousHop = 0;
+    p->rxTimestamp = 0;
 
     return p;
 }
@@ -55,11 +64,28 @@ bool PacketService::isDataPacket(uint8_t type) {
 }
 
 bool PacketService::isOnlyDataPacket(uint8_t type) {
-    return type == DATA_P;
+    return type == DATA_P || type == TRACED_DATA_P;
 }
 
 bool PacketService::isControlPacket(uint8_t type) {
-    return !(isHelloPacket(type) || isOnlyDataPacket(type));
+    return !(isHelloPacket(type) || isOnlyDataPacket(type) || isAggregatePacket(type) || isCustomPacket(type) ||
+        isRouteDiscoveryPacket(type));
+}
+
+bool PacketService::isAggregatePacket(uint8_t type) {
+    return type == AGGREGATE_P;
+}
+
+bool PacketService::isCustomPacket(uint8_t type) {
+    return type != 0 && type < 0x80 && (type & (AGGREGATE_P | DATA_P | HELLO_P)) == 0;
+}
+
+bool PacketService::isRouteDiscoveryPacket(uint8_t type) {
+    return type == ROUTE_REQUEST_P || type == ROUTE_REPLY_P;
+}
+
+bool PacketService::isTracedPacket(uint8_t type) {
+    return type == TRACED_DATA_P;
 }
 
 bool PacketService::isHelloPacket(uint8_t type) {
@@ -86,30 +112,102 @@ bool PacketService::isXLPacket(uint8_t type) {
     return (type & XL_DATA_P) == XL_DATA_P;
 }
 
+bool PacketService::isFragmentPacket(uint8_t type) {
+    return type == XL_DATA_P;
+}
+
 bool PacketService::isDataControlPacket(uint8_t type) {
-    return (isHelloPacket(type) || isAckPacket(type) || isLostPacket(type) || isLostPacket(type));
+    return (isHelloPacket(type) || isAckPacket(type) || isLostPacket(type) || isLostPacket(type) || isRouteDiscoveryPacket(type));
 }
 
 uint8_t PacketService::getHeaderLength(uint8_t type) {
+#if LM_COMPACT_HEADER
+    if (isControlPacket(type) || isDataPacket(type) || isAggregatePacket(type) || isCustomPacket(type) || isRouteDiscoveryPacket(type))
+        return CompactHeaderService::getHeaderLength(type);
+
+    return 0;
+#else
+    return getMemoryHeaderLength(type);
+#endif
+}
+
+uint8_t PacketService::getMemoryHeaderLength(uint8_t type) {
     if (isControlPacket(type))
         return sizeof(ControlPacket);
 
     if (isDataPacket(type))
         return sizeof(DataPacket);
 
+    if (isAggregatePacket(type) || isCustomPacket(type) || isRouteDiscoveryPacket(type))
+        return sizeof(PacketHeader);
+
     return 0;
 }
 
-RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole) {
+RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole,
+    uint8_t routeFlags, uint8_t tableVersion, uint8_t capabilities) {
     size_t routingSizeInBytes = numOfNodes * sizeof(NetworkNode);
+    size_t trailerLength = RoutePacket::getTrailerLength(routeFlags, capabilities);
 
-    RoutePacket* routePacket = PacketFactory::createPacket<RoutePacket>(reinterpret_cast<uint8_t*>(nodes), routingSizeInBytes);
+    RoutePacket* routePacket = PacketFactory::createPacket<RoutePacket>(nullptr, routingSizeInBytes + trailerLength);
+    memcpy(routePacket->networkNodes, nodes, routingSizeInBytes);
+    // The trailer is stamped when the packet is sent
+    memset(reinterpret_cast<uint8_t*>(routePacket->networkNodes) + routingSizeInBytes, 0, trailerLength);
     routePacket->dst = BROADCAST_ADDR;
     routePacket->src = localAddress;
     routePacket->type = HELLO_P;
-    routePacket->packetSize = routingSizeInBytes + sizeof(RoutePacket);
+    routePacket->packetSize = routingSizeInBytes + trailerLength + sizeof(RoutePacket);
     routePacket->nodeRole = nodeRole;
     routePacket->gatewayLoad = 255;
+    routePacket->routeFlags = routeFlags;
+    routePacket->tableVersion = tableVersion;
+    routePacket->capabilities = capabilities;
+
+    return routePacket;
+}
+
+RoutePacket* PacketService::createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole,
+    uint8_t routeFlags, uint8_t tableVersion, size_t& numOfEncodedNodes, uint8_t capabilities) {
+    size_t trailerLength = RoutePacket::getTrailerLength(routeFlags, capabilities);
+    size_t maxLength = PacketFactory::getMaxPacketSize() - sizeof(RoutePacket) - trailerLength;
+
+    if ((routeFlags & ROUTE_COMPACT_F) == 0) {
+        size_t maxNodes = maxLength / sizeof(NetworkNode);
+        numOfEncodedNodes = numOfNodes < maxNodes ? numOfNodes : maxNodes;
+        return createRoutingPacket(localAddress, nodes, numOfEncodedNodes, nodeRole, routeFlags, tableVersion, capabilities);
+    }
+
+    uint8_t encoded[UINT8_MAX];
+    if (maxLength > sizeof(encoded) - trailerLength)
+        maxLength = sizeof(encoded) - trailerLength;
+
+    size_t length = 0;
+    uint16_t previousAddress = 0;
+    numOfEncodedNodes = 0;
+
+    while (numOfEncodedNodes < numOfNodes) {
+        NetworkNode* node = &nodes[numOfEncodedNodes];
+        size_t nodeLength = LM_CompactNodeCodec::encode(*node, previousAddress, &encoded[length], maxLength - length);
+        if (nodeLength == 0)
+            break;
+
+        length += nodeLength;
+        previousAddress = node->address;
+        numOfEncodedNodes++;
+    }
+
+    memset(&encoded[length], 0, trailerLength);
+
+    RoutePacket* routePacket = PacketFactory::createPacket<RoutePacket>(encoded, length + trailerLength);
+    routePacket->dst = BROADCAST_ADDR;
+    routePacket->src = localAddress;
+    routePacket->type = HELLO_P;
+    routePacket->packetSize = length + trailerLength + sizeof(RoutePacket);
+    routePacket->nodeRole = nodeRole;
+    routePacket->gatewayLoad = 255;
+    routePacket->routeFlags = routeFlags;
+    routePacket->tableVersion = tableVersion;
+    routePacket->capabilities = capabilities;
 
     return routePacket;
 }
@@ -122,8 +220,8 @@ ControlPacket* PacketService::controlPacket(Packet<uint8_t>* p) {
     return reinterpret_cast<ControlPacket*>(p);
 }
 
-ControlPacket* PacketService::createControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t* payload, uint8_t payloadSize) {
-    ControlPacket* packet = PacketFactory::createPacket<ControlPacket>(payload, payloadSize);
+ControlPacket* PacketService::createControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t* payload, uint8_t payloadSize, bool bulk) {
+    ControlPacket* packet = PacketFactory::createPacket<ControlPacket>(payload, payloadSize, bulk);
     packet->dst = dst;
     packet->src = src;
     packet->type = type;
@@ -132,7 +230,7 @@ ControlPacket* PacketService::createControlPacket(uint16_t dst, uint16_t src, ui
     return packet;
 }
 
-ControlPacket* PacketService::createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t seq_id, uint16_t num_packets) {
+ControlPacket* PacketService::createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint16_t seq_id, uint16_t num_packets) {
     ControlPacket* packet = PacketFactory::createPacket<ControlPacket>(nullptr, 0);
     packet->dst = dst;
     packet->src = src;
@@ -154,17 +252,40 @@ DataPacket* PacketService::createDataPacket(uint16_t dst, uint16_t src, uint8_t
     return packet;
 }
 
+Packet<uint8_t>* PacketService::createCustomPacket(uint16_t dst, uint16_t src, uint8_t type, const uint8_t* payload, uint8_t payloadSize) {
+    Packet<uint8_t>* packet = PacketFactory::createPacket<Packet<uint8_t>>(payload, payloadSize);
+    if (packet == nullptr)
+        return nullptr;
+
+    packet->dst = dst;
+    packet->src = src;
+    packet->type = type;
+    packet->packetSize = payloadSize + sizeof(PacketHeader);
+
+    return packet;
+}
+
 size_t PacketService::getPacketPayloadLength(Packet<uint8_t>* p) {
-    return p->packetSize - getHeaderLength(p);
+    return p->packetSize - getMemoryHeaderLength(p->type);
 }
 
 size_t PacketService::getHeaderLength(Packet<uint8_t>* p) {
+#if LM_COMPACT_HEADER
+    if (isControlPacket(p->type) || isDataPacket(p->type) || isAggregatePacket(p->type) || isCustomPacket(p->type) ||
+        isRouteDiscoveryPacket(p->type))
+        return CompactHeaderService::getHeaderLength(p);
+#endif
     return getHeaderLength(p->type);
 }
 
 size_t PacketService::getControlLength(Packet<uint8_t>* p) {
-    if (isDataControlPacket(p->type))
+    if (isDataControlPacket(p->type)) {
+#if LM_COMPACT_HEADER
+        return CompactHeaderService::getPacketLength(p);
+#else
         return p->packetSize;
+#endif
+    }
 
     return getHeaderLength(p);
 }
@@ -181,18 +302,19 @@ size_t PacketService::getPacketPayloadLengthWithoutControl(Packet<uint8_t>* p) {
 
 ControlPacket* PacketService::getPacketHeader(Packet<uint8_t>* p) {
     ControlPacket* ctrlPacket = new ControlPacket();
+    getPacketHeader(p, ctrlPacket);
+    return ctrlPacket;
+}
 
+void PacketService::getPacketHeader(Packet<uint8_t>* p, ControlPacket* header) {
     if (isControlPacket(p->type)) {
-        ControlPacket* srcCtrPacket = (ControlPacket*)p;
-        memcpy(reinterpret_cast<void*>(ctrlPacket), reinterpret_cast<void*>(srcCtrPacket), sizeof(ControlPacket));
-        return ctrlPacket;
+        memcpy(reinterpret_cast<void*>(header), reinterpret_cast<void*>(p), sizeof(ControlPacket));
+        return;
     }
     if (isDataPacket(p->type)) {
-        DataPacket* srcDataPacket = (DataPacket*)p;
-        memcpy(reinterpret_cast<void*>(ctrlPacket), reinterpret_cast<void*>(srcDataPacket), sizeof(DataPacket));
-        return ctrlPacket;
+        memcpy(reinterpret_cast<void*>(header), reinterpret_cast<void*>(p), sizeof(DataPacket));
+        return;
     }
 
-    memcpy(reinterpret_cast<void*>(ctrlPacket), reinterpret_cast<void*>(p), sizeof(PacketHeader));
-    return ctrlPacket;
+    memcpy(reinterpret_cast<void*>(header), reinterpret_cast<void*>(p), sizeof(PacketHeader));
 }
@@ -5,6 +5,7 @@
 #include "entities/packets/ControlPacket.h"
 #include "entities/packets/DataPacket.h"
 #include "entities/packets/AppPacket.h"
+#include "entities/packets/AppPacketView.h"
 #include "entities/packets/RoutePacket.h"
 #include "services/RoleService.h"
 #include "BuildOptions.h"
@@ -37,9 +38,10 @@ public:
      * @param type Type of packet
      * @param payload Pointer to the payload
      * @param payloadSize Payload size
+     * @param bulk Allocate it as a bulk buffer, see PacketPoolService::allocateBulk
      * @return ControlPacket*
      */
-    static ControlPacket* createControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t* payload, uint8_t payloadSize);
+    static ControlPacket* createControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t* payload, uint8_t payloadSize, bool bulk = false);
 
     /**
      * @brief Create a Empty Control Packet
@@ -51,7 +53,7 @@ public:
      * @param num_packets Number of the packet
      * @return ControlPacket*
      */
-    static ControlPacket* createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint8_t seq_id, uint16_t num_packets);
+    static ControlPacket* createEmptyControlPacket(uint16_t dst, uint16_t src, uint8_t type, uint16_t seq_id, uint16_t num_packets);
 
     /**
      * @brief Create a Data Packet
@@ -65,6 +67,18 @@ public:
      */
     static DataPacket* createDataPacket(uint16_t dst, uint16_t src, uint8_t type, const uint8_t* payload,  uint8_t payloadSize);
 
+    /**
+     * @brief Create a packet of a frame type of the application, with the PacketHeader only
+     *
+     * @param dst Destination address
+     * @param src Source address
+     * @param type Type of packet, see isCustomPacket
+     * @param payload Pointer to the payload
+     * @param payloadSize Payload size
+     * @return Packet<uint8_t>*
+     */
+    static Packet<uint8_t>* createCustomPacket(uint16_t dst, uint16_t src, uint8_t type, const uint8_t* payload, uint8_t payloadSize);
+
     /**
      * @brief Create an Empty Packet
      *
@@ -83,7 +97,7 @@ public:
      */
     template<class T>
     static Packet<uint8_t>* copyPacket(T* p, size_t packetLength) {
-        Packet<uint8_t>* cpPacket = static_cast<Packet<uint8_t>*>(pvPortMalloc(packetLength));
+        Packet<uint8_t>* cpPacket = static_cast<Packet<uint8_t>*>(PacketPoolService::allocate(packetLength));
 
         if (cpPacket) {
             memcpy(reinterpret_cast<void*>(cpPacket), reinterpret_cast<void*>(p), packetLength);
@@ -103,9 +117,31 @@ public:
      * @param nodes list of NetworkNodes
      * @param numOfNodes Number of nodes
      * @param nodeRole Role of the node
+     * @param routeFlags Route flags, see RoutingTableService::getNextAdvertisement
+     * @param tableVersion Version of the routing table
+     * @param capabilities Capabilities of the node, ROUTE_CAP_SNIFF and ROUTE_CAP_LINK_SNR add their trailers
      * @return RoutePacket*
      */
-    static RoutePacket* createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole);
+    static RoutePacket* createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole,
+        uint8_t routeFlags = 0, uint8_t tableVersion = 0, uint8_t capabilities = 0);
+
+    /**
+     * @brief Create a Routing Packet object with as many nodes as fit in it.
+     * With ROUTE_COMPACT_F the nodes are encoded with the LM_CompactNodeCodec, they should be sorted by address.
+     * With ROUTE_TDMA_F, ROUTE_CONGESTION_F and ROUTE_TIME_SYNC_F their empty trailers follow them, they are filled when the packet is sent
+     *
+     * @param localAddress localAddress of the node
+     * @param nodes list of NetworkNodes
+     * @param numOfNodes Number of nodes
+     * @param nodeRole Role of the node
+     * @param routeFlags Route flags, see RoutingTableService::getNextAdvertisement
+     * @param tableVersion Version of the routing table
+     * @param numOfEncodedNodes Output number of nodes inside the packet
+     * @param capabilities Capabilities of the node, ROUTE_CAP_SNIFF and ROUTE_CAP_LINK_SNR add their trailers
+     * @return RoutePacket*
+     */
+    static RoutePacket* createRoutingPacket(uint16_t localAddress, NetworkNode* nodes, size_t numOfNodes, uint8_t nodeRole,
+        uint8_t routeFlags, uint8_t tableVersion, size_t& numOfEncodedNodes, uint8_t capabilities = 0);
 
     /**
      * @brief Create a Application Packet
@@ -159,7 +195,7 @@ public:
     static size_t getPacketPayloadLengthWithoutControl(Packet<uint8_t>* p);
 
     /**
-     * @brief Get the Packet Header Length in bytes
+     * @brief Get the Packet Header Length in bytes on air, with LM_COMPACT_HEADER it is the compact header
      *
      * @param p
      * @return size_t
@@ -167,13 +203,21 @@ public:
     static size_t getHeaderLength(Packet<uint8_t>* p);
 
     /**
-     * @brief Get the Header Length
+     * @brief Get the Header Length on air, with LM_COMPACT_HEADER the longest compact header of the type
      *
      * @param type type of the packet
      * @return uin16_t header length
      */
     static uint8_t getHeaderLength(uint8_t type);
 
+    /**
+     * @brief Get the Header Length in memory, the size of the packet class
+     *
+     * @param type type of the packet
+     * @return uint8_t header length
+     */
+    static uint8_t getMemoryHeaderLength(uint8_t type);
+
     /**
      * @brief Get the Control Length in bytes. Used to calculate the Overhead of all the packets.
      * In this function includes the payload of the Routing Packets and other control packets, like sync, acks and lost.
@@ -201,7 +245,7 @@ public:
     static bool isDataPacket(uint8_t type);
 
     /**
-     * @brief Given a type returns if is only a data packet
+     * @brief Given a type returns if is only a data packet, traced or not
      *
      * @param type type of the packet
      * @return true True if needed
@@ -218,6 +262,42 @@ public:
      */
     static bool isControlPacket(uint8_t type);
 
+    /**
+     * @brief Given a type returns if is an aggregate packet, several data packets to the same next hop in one frame
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isAggregatePacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a frame type of the application, see LM_CUSTOM_PACKET_TYPES
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isCustomPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a request or a reply of the route discovery, see RouteDiscoveryService
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isRouteDiscoveryPacket(uint8_t type);
+
+    /**
+     * @brief Given a type returns if is a data packet with the per hop trace, see HopTraceService
+     *
+     * @param type type of the packet
+     * @return true True if needed
+     * @return false If not
+     */
+    static bool isTracedPacket(uint8_t type);
+
     /**
      * @brief Given a type returns if is a hello packet
      *
@@ -272,6 +352,14 @@ public:
      */
     static bool isXLPacket(uint8_t type);
 
+    /**
+     * @brief Given a type returns if is a fragment of a datagram, a XL packet without ACK
+     *
+     * @param type type of the packet
+     * @return true If it is a fragment
+     */
+    static bool isFragmentPacket(uint8_t type);
+
     /**
      * @brief Given a type returns if is a Data Control Packet, It will include HELLO_P, ACKs, LOST_P and SYN_P
      *
@@ -288,6 +376,14 @@ public:
      * @return ControlPacket*
      */
     static ControlPacket* getPacketHeader(Packet<uint8_t>* p);
+
+    /**
+     * @brief Copy the packet headers without the payload, without allocating
+     *
+     * @param p Packet
+     * @param header Headers of the packet, the fields the packet type does not have are not modified
+     */
+    static void getPacketHeader(Packet<uint8_t>* p, ControlPacket* header);
 };
 
 #endif
@@ -43,6 +43,46 @@ public:
      */
     static bool isGateway();
 
+    /**
+     * @brief Get the address of the packets to the best node with a role
+     *
+     * @param role Role, not ROLE_DEFAULT
+     * @return uint16_t LM_ROLE_ADDRESS | role
+     */
+    static uint16_t getRoleAddress(uint8_t role) { return LM_ROLE_ADDRESS | role; }
+
+    /**
+     * @brief Check if an address is the address of a role
+     *
+     * @param address Address
+     * @return true If it is a role address, not the BROADCAST_ADDR
+     */
+    static bool isRoleAddress(uint16_t address) { return address > LM_ROLE_ADDRESS && address < BROADCAST_ADDR; }
+
+    /**
+     * @brief Get the address of the packets to all the nodes with a role, the members of the multicast group
+     *
+     * @param role Role, not ROLE_DEFAULT
+     * @return uint16_t LM_MULTICAST_ADDRESS | role
+     */
+    static uint16_t getMulticastAddress(uint8_t role) { return LM_MULTICAST_ADDRESS | role; }
+
+    /**
+     * @brief Check if an address is the address of a multicast group
+     *
+     * @param address Address
+     * @return true If it is a multicast address
+     */
+    static bool isMulticastAddress(uint16_t address) { return address > LM_MULTICAST_ADDRESS && address < LM_ROLE_ADDRESS; }
+
+    /**
+     * @brief Get the role of a role or multicast address
+     *
+     * @param address Role or multicast address
+     * @return uint8_t Role
+     */
+    static uint8_t getAddressRole(uint16_t address) { return address & 0xFF; }
+
 private:
     /**
      * @brief Node Role
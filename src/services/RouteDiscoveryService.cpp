@@ -0,0 +1,186 @@
+#include "RouteDiscoveryService.h"
+
+#include "RoutingTableService.h"
+
+void RouteDiscoveryService::init() {
+    if (mutex != nullptr)
+        return;
+
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+        ESP_LOGE(LM_TAG, "Route discovery mutex not created");
+}
+
+bool RouteDiscoveryService::hold(QueuePacket<Packet<uint8_t>>* pq) {
+    uint16_t target = pq->packet->dst;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if (heldNum >= LM_DISCOVERY_HELD_PACKETS) {
+        xSemaphoreGive(mutex);
+        return false;
+    }
+
+    Discovery* discovery = findDiscovery(target);
+    if (discovery == nullptr) {
+        discovery = findDiscovery(0);
+        if (discovery == nullptr) {
+            xSemaphoreGive(mutex);
+            return false;
+        }
+
+        discovery->target = target;
+        discovery->attempts = 0;
+        discovery->sentAt = 0;
+        discovery->found = false;
+        discovery->failed = false;
+    }
+
+    held[heldNum].packet = pq;
+    held[heldNum].target = target;
+    heldNum++;
+
+    xSemaphoreGive(mutex);
+
+    ESP_LOGI(LM_TAG, "Packet %d to %X held until its route is discovered", pq->packet->id, target);
+    return true;
+}
+
+bool RouteDiscoveryService::nextRequest(uint16_t localAddress, RouteDiscoveryMessage& request) {
+    uint32_t now = millis();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    for (Discovery& discovery : discoveries) {
+        if (discovery.target == 0 || discovery.found || discovery.failed)
+            continue;
+
+        updateFound(&discovery);
+        if (discovery.found || (discovery.attempts != 0 && now - discovery.sentAt < LM_DISCOVERY_TIMEOUT))
+            continue;
+
+        if (discovery.attempts > LM_DISCOVERY_RETRIES) {
+            ESP_LOGW(LM_TAG, "Route to %X not discovered", discovery.target);
+            discovery.failed = true;
+            failed++;
+            continue;
+        }
+
+        discovery.attempts++;
+        discovery.sentAt = now;
+
+        request.origin = localAddress;
+        request.target = discovery.target;
+        request.requestId = requestId++;
+        request.hops = 0;
+
+        // The own request is not relayed when a neighbor relays it back
+        seen[nextSeen].origin = request.origin;
+        seen[nextSeen].requestId = request.requestId;
+        nextSeen = (nextSeen + 1) % LM_DISCOVERY_SEEN_REQUESTS;
+
+        xSemaphoreGive(mutex);
+        return true;
+    }
+
+    xSemaphoreGive(mutex);
+    return false;
+}
+
+QueuePacket<Packet<uint8_t>>* RouteDiscoveryService::takeResolved(bool& found) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    for (Discovery& discovery : discoveries) {
+        if (discovery.target == 0)
+            continue;
+
+        updateFound(&discovery);
+        if (!discovery.found && !discovery.failed)
+            continue;
+
+        for (size_t i = 0; i < heldNum; i++) {
+            if (held[i].target != discovery.target)
+                continue;
+
+            QueuePacket<Packet<uint8_t>>* pq = held[i].packet;
+            found = discovery.found;
+
+            // The held packets keep their order
+            for (size_t j = i + 1; j < heldNum; j++)
+                held[j - 1] = held[j];
+            heldNum--;
+
+            xSemaphoreGive(mutex);
+            return pq;
+        }
+
+        discovery.target = 0;
+    }
+
+    xSemaphoreGive(mutex);
+    return nullptr;
+}
+
+bool RouteDiscoveryService::isNewRequest(const RouteDiscoveryMessage& request) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    for (const SeenRequest& entry : seen) {
+        if (entry.origin == request.origin && entry.requestId == request.requestId) {
+            xSemaphoreGive(mutex);
+            return false;
+        }
+    }
+
+    seen[nextSeen].origin = request.origin;
+    seen[nextSeen].requestId = request.requestId;
+    nextSeen = (nextSeen + 1) % LM_DISCOVERY_SEEN_REQUESTS;
+
+    xSemaphoreGive(mutex);
+    return true;
+}
+
+uint32_t RouteDiscoveryService::getTimeUntilNext() {
+    if (mutex == nullptr)
+        return UINT32_MAX;
+
+    uint32_t now = millis();
+    uint32_t waitTime = UINT32_MAX;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    for (const Discovery& discovery : discoveries) {
+        if (discovery.target == 0 || discovery.found || discovery.failed)
+            continue;
+
+        uint32_t elapsed = now - discovery.sentAt;
+        uint32_t untilDue = discovery.attempts == 0 || elapsed >= LM_DISCOVERY_TIMEOUT ? 0 : LM_DISCOVERY_TIMEOUT - elapsed;
+        if (untilDue < waitTime)
+            waitTime = untilDue;
+    }
+
+    xSemaphoreGive(mutex);
+    return waitTime;
+}
+
+RouteDiscoveryService::Discovery* RouteDiscoveryService::findDiscovery(uint16_t target) {
+    for (Discovery& discovery : discoveries) {
+        if (discovery.target == target)
+            return &discovery;
+    }
+
+    return nullptr;
+}
+
+void RouteDiscoveryService::updateFound(Discovery* discovery) {
+    if (!discovery->found && !discovery->failed && RoutingTableService::getNextHop(discovery->target) != 0)
+        discovery->found = true;
+}
+
+SemaphoreHandle_t RouteDiscoveryService::mutex = nullptr;
+RouteDiscoveryService::Discovery RouteDiscoveryService::discoveries[LM_DISCOVERY_SLOTS] = {};
+RouteDiscoveryService::HeldPacket RouteDiscoveryService::held[LM_DISCOVERY_HELD_PACKETS] = {};
+size_t RouteDiscoveryService::heldNum = 0;
+RouteDiscoveryService::SeenRequest RouteDiscoveryService::seen[LM_DISCOVERY_SEEN_REQUESTS] = {};
+uint8_t RouteDiscoveryService::nextSeen = 0;
+uint8_t RouteDiscoveryService::requestId = 0;
+uint32_t RouteDiscoveryService::failed = 0;
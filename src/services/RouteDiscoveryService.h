@@ -0,0 +1,155 @@
+#ifndef _LORAMESHER_ROUTE_DISCOVERY_SERVICE_H
+#define _LORAMESHER_ROUTE_DISCOVERY_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include <freertos/semphr.h>
+
+#include "entities/packets/Packet.h"
+#include "entities/packets/QueuePacket.h"
+
+#pragma pack(1)
+/**
+ * @brief Payload of the ROUTE_REQUEST_P and ROUTE_REPLY_P frames
+ *
+ */
+struct RouteDiscoveryMessage {
+    // Node that discovers the route and destination of the route
+    uint16_t origin;
+    uint16_t target;
+    // Id of the request, per origin
+    uint8_t requestId;
+    // Hops crossed by the request from the origin, or by the reply from the target
+    uint8_t hops;
+};
+#pragma pack()
+
+/**
+ * @brief On demand discovery of the routes that the HELLOs do not carry, see LoraMesherConfig::reactiveRoutes:
+ *
+ *   Request, broadcast: origin (2), target (2), request id (1), hops (1)
+ *   Reply, to the next hop to the origin: origin (2), target (2), request id (1), hops (1)
+ *
+ * A packet without a route is held while its destination is discovered. The origin floods a request, every node relays it
+ * once and keeps the route back to the origin through the neighbor it heard it from. The target answers with a reply that
+ * goes back along those routes, and every node on the way keeps the route to the target. The discovered routes are
+ * provisional, they live LM_DISCOVERY_ROUTE_TIMEOUT s unless the traffic refreshes them.
+ *
+ */
+class RouteDiscoveryService {
+public:
+
+    /**
+     * @brief Create the mutex of the discoveries, the requests are relayed and answered without the reactive routes too
+     *
+     */
+    static void init();
+
+    /**
+     * @brief Hold a packet without a route and start the discovery of its destination, if it is not running
+     *
+     * @param pq Packet, owned by the service until takeResolved returns it
+     * @return true If it is held, false if the held packets or the discoveries are full
+     */
+    static bool hold(QueuePacket<Packet<uint8_t>>* pq);
+
+    /**
+     * @brief Get the next request to flood, of a new discovery or of one without a reply in LM_DISCOVERY_TIMEOUT ms.
+     * A discovery is failed after LM_DISCOVERY_RETRIES requests more
+     *
+     * @param localAddress Address of the node, the origin of the request
+     * @param request Output request
+     * @return true If a request is due
+     */
+    static bool nextRequest(uint16_t localAddress, RouteDiscoveryMessage& request);
+
+    /**
+     * @brief Take a held packet whose destination has a route now, or whose discovery has failed
+     *
+     * @param found Output true if the destination has a route
+     * @return QueuePacket<Packet<uint8_t>>* Packet or nullptr if there is none
+     */
+    static QueuePacket<Packet<uint8_t>>* takeResolved(bool& found);
+
+    /**
+     * @brief Returns if a request has not been seen before, and remember it
+     *
+     * @param request Request received
+     */
+    static bool isNewRequest(const RouteDiscoveryMessage& request);
+
+    /**
+     * @brief Ms until the next request or failure is due
+     *
+     * @return uint32_t UINT32_MAX without discoveries
+     */
+    static uint32_t getTimeUntilNext();
+
+    /**
+     * @brief Get the number of packets held in this moment
+     *
+     * @return size_t
+     */
+    static size_t getHeldNum() { return heldNum; }
+
+    /**
+     * @brief Get the number of discoveries failed without a reply
+     *
+     * @return uint32_t
+     */
+    static uint32_t getFailedNum() { return failed; }
+
+private:
+
+    struct Discovery {
+        // 0 if the slot is free
+        uint16_t target;
+        // Requests flooded and millis() of the last one
+        uint8_t attempts;
+        uint32_t sentAt;
+        // The target has a route, or the discovery has failed, the held packets are released
+        bool found;
+        bool failed;
+    };
+
+    struct HeldPacket {
+        QueuePacket<Packet<uint8_t>>* packet;
+        uint16_t target;
+    };
+
+    struct SeenRequest {
+        uint16_t origin;
+        uint8_t requestId;
+    };
+
+    static SemaphoreHandle_t mutex;
+
+    static Discovery discoveries[LM_DISCOVERY_SLOTS];
+
+    static HeldPacket held[LM_DISCOVERY_HELD_PACKETS];
+
+    static size_t heldNum;
+
+    static SeenRequest seen[LM_DISCOVERY_SEEN_REQUESTS];
+
+    static uint8_t nextSeen;
+
+    static uint8_t requestId;
+
+    static uint32_t failed;
+
+    /**
+     * @brief Find the discovery of a target, protected by the mutex
+     *
+     * @return Discovery* nullptr if there is none
+     */
+    static Discovery* findDiscovery(uint16_t target);
+
+    /**
+     * @brief Mark the discovery found if its target has a route now, protected by the mutex
+     *
+     */
+    static void updateFound(Discovery* discovery);
+};
+
+#endif
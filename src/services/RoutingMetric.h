@@ -0,0 +1,218 @@
+#ifndef _LORAMESHER_ROUTING_METRIC_H
+#define _LORAMESHER_ROUTING_METRIC_H
+
+#include "BuildOptions.h"
+
+#include "RoutingTableService.h"
+
+#include "NeighborTableService.h"
+
+/**
+ * @brief Routing metric policies of the RoutingTableService, one is selected at compile time with LM_ROUTING_METRIC.
+ * A policy has COST_ROUTING, false for plain distance vector, and getCost(metric, via, address) that returns a
+ * fixed point cost, LM_COST_SCALE is 1.0, lower is better. The link terms use the NeighborTableService entry of the via,
+ * the congestion term only with LoraMesherConfig::backpressure.
+ * TABLE_DEPENDENT_COSTS is true when the cost of a route depends on the other routes of the routing table too.
+ *
+ */
+class RoutingMetric {
+public:
+    static constexpr bool TABLE_DEPENDENT_COSTS = false;
+
+protected:
+    /**
+     * @brief Link metrics of the next hop, the defaults of NeighborEntry if it is not in the NeighborTableService
+     *
+     */
+    struct Link {
+        int16_t rssi;
+        int8_t snr;
+        float etx;
+        uint8_t congestion;
+    };
+
+    static Link getLink(uint16_t via) {
+        NeighborEntry defaults;
+        Link link = {defaults.rssi, defaults.snr, defaults.etx, 0};
+
+        NeighborTableService::setInUse();
+        NeighborEntry* entry = NeighborTableService::find(via);
+        if (entry != nullptr) {
+            link.rssi = entry->rssi;
+            link.snr = entry->snr;
+            link.etx = entry->etx;
+            if (entry->hasCongestion())
+                link.congestion = entry->congestion;
+        }
+        NeighborTableService::releaseInUse();
+
+        return link;
+    }
+
+    /**
+     * @brief Weight multiplied by how far the value is from the maximum, 0 at the maximum and weight at the minimum
+     *
+     */
+    static RouteCost getLoss(int32_t value, int32_t min, int32_t max, RouteCost weight) {
+        if (value >= max)
+            return 0;
+        if (value <= min)
+            return weight;
+        return weight * (max - value) / (max - min);
+    }
+
+    static RouteCost getHopsCost(uint8_t metric) {
+        return (RouteCost) LM_COST_W_HOPS * metric;
+    }
+
+    static RouteCost getEtxCost(const Link& link) {
+        // ETX - 1 so a perfect link adds no cost
+        return (RouteCost) (LM_COST_W_ETX * (link.etx - 1.0f));
+    }
+
+    static RouteCost getSignalCost(const Link& link) {
+        RouteCost cost = getLoss(link.rssi, LM_COST_RSSI_MIN, LM_COST_RSSI_MAX, LM_COST_W_RSSI) +
+            getLoss(link.snr, LM_COST_SNR_MIN, LM_COST_SNR_MAX, LM_COST_W_SNR);
+
+        if (link.rssi < LM_COST_WEAK_RSSI || link.snr < LM_COST_WEAK_SNR)
+            cost += LM_COST_WEAK_PENALTY;
+
+        return cost;
+    }
+
+    static RouteCost getCongestionCost(const Link& link) {
+        if (link.congestion <= LM_CONGESTION_THRESHOLD)
+            return 0;
+
+        return (RouteCost) LM_COST_W_CONGESTION * (link.congestion - LM_CONGESTION_THRESHOLD) / (100 - LM_CONGESTION_THRESHOLD);
+    }
+
+    /**
+     * @brief Bias of a gateway by its load relative to the average load of the gateways, (load - average) / average.
+     * Positive for the gateways busier than the average. 0 if the address is not a gateway, if less than two gateways
+     * advertise their load or if the average is below LM_COST_MIN_GATEWAY_LOAD
+     *
+     */
+    static RouteCost getGatewayBiasCost(uint16_t address) {
+        bool isGateway = false;
+        bool targetKnown = false;
+        uint32_t targetLoad = 0;
+        uint32_t totalLoad = 0;
+        uint32_t gatewaysWithLoad = 0;
+
+        // Lock free snapshot, it is called on every cost evaluation
+        RoutingTableView view;
+
+        for (const RoutingTableSnapshot::Entry& entry : view) {
+            if ((entry.networkNode.role & ROLE_GATEWAY) == 0)
+                continue;
+
+            bool target = entry.networkNode.address == address;
+            isGateway |= target;
+
+            // 255 is an unknown load
+            uint8_t load = entry.networkNode.gatewayLoad;
+            if (load == 255)
+                continue;
+
+            totalLoad += load;
+            gatewaysWithLoad++;
+
+            if (target) {
+                targetLoad = load;
+                targetKnown = true;
+            }
+        }
+
+        if (!isGateway || !targetKnown || gatewaysWithLoad <= 1 || totalLoad == 0)
+            return 0;
+
+        if ((uint64_t) totalLoad * 1000 < (uint64_t) gatewaysWithLoad * LM_COST_MIN_GATEWAY_LOAD)
+            return 0;
+
+        // (load - total / n) / (total / n) with only one division
+        int64_t difference = (int64_t) targetLoad * gatewaysWithLoad - totalLoad;
+        RouteCost bias = (RouteCost) (LM_COST_W_GATEWAY * difference / (int64_t) totalLoad);
+
+        ESP_LOGD(LM_TAG, "[W5] Gateway %X load=%lu of %lu in %lu gateways, bias=%ld",
+            address, (unsigned long) targetLoad, (unsigned long) totalLoad, (unsigned long) gatewaysWithLoad, (long) bias);
+
+        return bias;
+    }
+};
+
+/**
+ * @brief Hops of the route, the distance vector of LoRaMesher
+ *
+ */
+class HopCountMetric : public RoutingMetric {
+public:
+    static constexpr bool COST_ROUTING = false;
+
+    static RouteCost getCost(uint8_t metric, uint16_t via, uint16_t address) {
+        (void) via;
+        (void) address;
+        return (RouteCost) LM_COST_SCALE * metric;
+    }
+};
+
+/**
+ * @brief Hops, ETX and congestion of the next hop
+ *
+ */
+class EtxMetric : public RoutingMetric {
+public:
+    static constexpr bool COST_ROUTING = true;
+
+    static RouteCost getCost(uint8_t metric, uint16_t via, uint16_t address) {
+        (void) address;
+        Link link = getLink(via);
+        return getHopsCost(metric) + getEtxCost(link) + getCongestionCost(link);
+    }
+};
+
+/**
+ * @brief Hops, RSSI, SNR and congestion of the next hop, with a penalty for the weak links
+ *
+ */
+class SnrMetric : public RoutingMetric {
+public:
+    static constexpr bool COST_ROUTING = true;
+
+    static RouteCost getCost(uint8_t metric, uint16_t via, uint16_t address) {
+        (void) address;
+        Link link = getLink(via);
+        return getHopsCost(metric) + getSignalCost(link) + getCongestionCost(link);
+    }
+};
+
+/**
+ * @brief Hops, RSSI, SNR, ETX and congestion of the next hop, and the load bias when the destination is a gateway
+ *
+ */
+class GatewayBiasedMetric : public RoutingMetric {
+public:
+    static constexpr bool COST_ROUTING = true;
+
+    // The bias uses the load of every gateway of the routing table
+    static constexpr bool TABLE_DEPENDENT_COSTS = true;
+
+    static RouteCost getCost(uint8_t metric, uint16_t via, uint16_t address) {
+        Link link = getLink(via);
+        return getHopsCost(metric) + getSignalCost(link) + getEtxCost(link) + getCongestionCost(link) + getGatewayBiasCost(address);
+    }
+};
+
+#if LM_ROUTING_METRIC == LM_METRIC_HOP_COUNT
+typedef HopCountMetric RoutingMetricPolicy;
+#elif LM_ROUTING_METRIC == LM_METRIC_ETX
+typedef EtxMetric RoutingMetricPolicy;
+#elif LM_ROUTING_METRIC == LM_METRIC_SNR
+typedef SnrMetric RoutingMetricPolicy;
+#elif LM_ROUTING_METRIC == LM_METRIC_GATEWAY_BIASED
+typedef GatewayBiasedMetric RoutingMetricPolicy;
+#else
+#error "Unknown LM_ROUTING_METRIC"
+#endif
+
+#endif
@@ -1,103 +1,374 @@
 #include "RoutingTableService.h"
 
+#include "RoutingMetric.h"
+
+#include "RoleService.h"
+
+#include "Hooks.h"
+
+#include <algorithm>
+
+#include "utilities/CompactNodeCodec.hpp"
+
+#include "utilities/Rendezvous.hpp"
+
 size_t RoutingTableService::routingTableSize() {
     return routingTableList->getLength();
 }
 
 RouteNode* RoutingTableService::findNode(uint16_t address) {
+    routingTableList->setInUseShared();
+
+    RouteNode* node = routingTableIndex->find(address);
+
+    routingTableList->releaseInUseShared();
+    return node;
+}
+
+bool RoutingTableService::removeNode(uint16_t address) {
     routingTableList->setInUse();
 
-    if (routingTableList->moveToStart()) {
-        do {
-            RouteNode* node = routingTableList->getCurrent();
+    RouteNode* node = routingTableIndex->find(address);
+    if (node == nullptr) {
+        routingTableList->releaseInUse();
+        return false;
+    }
 
-            if (node->networkNode.address == address) {
-                routingTableList->releaseInUse();
-                return node;
-            }
+    if (routingTableList->Search(node))
+        deleteCurrentNode();
 
-        } while (routingTableList->next());
+    routingTableList->releaseInUse();
+
+    publishSnapshot();
+    return true;
+}
+
+bool RoutingTableService::addProvisionalRoute(const NetworkNode& node, uint16_t via, uint32_t timeout) {
+    routingTableList->setInUse();
+
+    uint32_t deadline = millis() + timeout;
+
+    // A route through the same next hop lives until the later deadline
+    RouteNode* existing = routingTableIndex->find(node.address);
+    if (existing != nullptr) {
+        bool refreshed = existing->via == via;
+        if (refreshed && (int32_t) (deadline - existing->timeout) > 0) {
+            existing->timeout = deadline;
+            routeTimers->arm(&existing->timer, existing->timeout);
+        }
+
+        routingTableList->releaseInUse();
+        return refreshed;
     }
 
+    if (routingTableList->getLength() >= RTMAXSIZE) {
+        routingTableList->releaseInUse();
+        return false;
+    }
+
+    RouteNode* rNode = new RouteNode(node, via);
+
+    if (!routingTableIndex->insert(node.address, rNode)) {
+        routingTableList->releaseInUse();
+        delete rNode;
+        return false;
+    }
+
+    MemoryService::add(MEMORY_ROUTING, sizeof(RouteNode));
+    routingTableList->Append(rNode);
+
+    rNode->timeout = deadline;
+    routeTimers->arm(&rNode->timer, rNode->timeout);
+    markChanged(rNode);
+
     routingTableList->releaseInUse();
-    return nullptr;
+
+    invalidateRouteCosts();
+    return true;
+}
+
+void RoutingTableService::deleteCurrentNode() {
+    RouteNode* node = routingTableList->getCurrent();
+
+    routingTableIndex->remove(node->networkNode.address);
+    routingTableList->DeleteCurrent();
+    snapshotChanged = true;
+    changeCount++;
+    LM_HOOK(HOOK_ROUTE_UPDATE, nullptr, node->networkNode.address);
+    invalidateRouteCosts();
+    markDirty(node->networkNode.address, true);
+    markRoleChange(node->networkNode.address);
+
+    // Remember it to be advertised in the next delta advertisement
+    withdrawnRoutes[withdrawnRoutesIndex].address = node->networkNode.address;
+    withdrawnRoutes[withdrawnRoutesIndex].version = tableVersion;
+    withdrawnRoutesIndex = (withdrawnRoutesIndex + 1) % LM_MAX_WITHDRAWN_ROUTES;
+
+    delete node;
+    MemoryService::remove(MEMORY_ROUTING, sizeof(RouteNode));
 }
 
 RouteNode* RoutingTableService::getBestNodeByRole(uint8_t role) {
-    // If no custom cost function is registered, fall back to hop-count search
-    if (costCallback == nullptr) {
-        RouteNode* bestNode = nullptr;
+    uint16_t address, via;
+    if (!getRoleRoute(role, address, via))
+        return nullptr;
 
-        routingTableList->setInUse();
+    return findNode(address);
+}
 
-        if (routingTableList->moveToStart()) {
-            do {
-                RouteNode* node = routingTableList->getCurrent();
+bool RoutingTableService::getRoleRoute(uint8_t role, uint16_t& address, uint16_t& via) {
+    RoutingTableView view;
+
+    portENTER_CRITICAL(&routeCostMux);
+    uint32_t epoch = routeCostEpoch;
+    portEXIT_CRITICAL(&routeCostMux);
+
+    portENTER_CRITICAL(&roleRoutesMux);
+    for (size_t i = 0; i < roleRoutesLength; i++) {
+        RoleRoute& cached = roleRoutes[i];
+        if (cached.role == role && cached.version == view.getVersion() && cached.epoch == epoch) {
+            bool found = cached.found;
+            address = cached.address;
+            via = cached.via;
+            portEXIT_CRITICAL(&roleRoutesMux);
+            return found;
+        }
+    }
+    portEXIT_CRITICAL(&roleRoutesMux);
+
+    // The costs are calculated without any lock, the metric can use the routing table
+    RoleRoute route = {role, false, 0, 0, view.getVersion(), epoch, 0};
 
-                if ((node->networkNode.role & role) == role &&
-                    (bestNode == nullptr || node->networkNode.metric < bestNode->networkNode.metric)) {
-                    bestNode = node;
-                }
+    for (const RoutingTableSnapshot::Entry& entry : view) {
+        if ((entry.networkNode.role & role) != role)
+            continue;
 
-            } while (routingTableList->next());
+        RouteCost cost = getRouteCost(entry.networkNode.metric, entry.via, entry.networkNode.address);
+        if (!route.found || cost < route.cost) {
+            route.cost = cost;
+            route.found = true;
+            route.address = entry.networkNode.address;
+            route.via = entry.via;
         }
+    }
 
-        routingTableList->releaseInUse();
-        return bestNode;
+    portENTER_CRITICAL(&roleRoutesMux);
+    size_t slot = roleRoutesLength;
+    for (size_t i = 0; i < roleRoutesLength; i++) {
+        if (roleRoutes[i].role == role) {
+            slot = i;
+            break;
+        }
     }
 
-    // Collect gateway candidates without calling the cost callback while the
-    // routing-table mutex is held (cost callback also inspects the table).
-    struct GatewayCandidate {
-        uint16_t address;
-        uint16_t via;
-        uint8_t metric;
-    };
+    if (slot == LM_ROLE_ROUTE_CACHE_SIZE) {
+        slot = roleRoutesNext;
+        roleRoutesNext = (roleRoutesNext + 1) % LM_ROLE_ROUTE_CACHE_SIZE;
+    }
+    else if (slot == roleRoutesLength)
+        roleRoutesLength++;
 
-    GatewayCandidate candidates[RTMAXSIZE];
-    uint8_t candidateCount = 0;
+    roleRoutes[slot] = route;
+    portEXIT_CRITICAL(&roleRoutesMux);
 
-    routingTableList->setInUse();
-    if (routingTableList->moveToStart()) {
-        do {
-            RouteNode* node = routingTableList->getCurrent();
-            if ((node->networkNode.role & role) != role) {
+    address = route.address;
+    via = route.via;
+    return route.found;
+}
+
+void RoutingTableService::markRoleChange(uint16_t address) {
+    portENTER_CRITICAL(&roleRoutesMux);
+
+    bool found = false;
+    for (size_t i = 0; i < roleChangesLength && !found; i++)
+        found = roleChanges[i] == address;
+
+    if (!found) {
+        if (roleChangesLength < LM_DIRTY_ROUTES)
+            roleChanges[roleChangesLength++] = address;
+        else
+            roleChangesOverflow = true;
+    }
+
+    portEXIT_CRITICAL(&roleRoutesMux);
+}
+
+void RoutingTableService::updateRoleRoutes(RoutingTableSnapshot* snapshot, const uint16_t* changes, size_t length) {
+    portENTER_CRITICAL(&routeCostMux);
+    uint32_t epoch = routeCostEpoch;
+    portEXIT_CRITICAL(&routeCostMux);
+
+    RoleRoute routes[LM_ROLE_ROUTE_CACHE_SIZE];
+    bool updated[LM_ROLE_ROUTE_CACHE_SIZE];
+
+    portENTER_CRITICAL(&roleRoutesMux);
+    size_t routesLength = roleRoutesLength;
+    for (size_t i = 0; i < routesLength; i++) {
+        routes[i] = roleRoutes[i];
+        updated[i] = routes[i].version == snapshot->version - 1 && routes[i].epoch == epoch;
+    }
+    portEXIT_CRITICAL(&roleRoutesMux);
+
+    // The costs are calculated without any lock, the metric can use the routing table
+    for (size_t c = 0; c < length; c++) {
+        const RoutingTableSnapshot::Entry* entry = nullptr;
+        for (size_t e = 0; e < snapshot->size && entry == nullptr; e++) {
+            if (snapshot->entries[e].networkNode.address == changes[c])
+                entry = &snapshot->entries[e];
+        }
+
+        bool costKnown = false;
+        RouteCost cost = 0;
+
+        for (size_t i = 0; i < routesLength; i++) {
+            RoleRoute& route = routes[i];
+            if (!updated[i])
+                continue;
+
+            bool best = route.found && route.address == changes[c];
+            if (entry == nullptr || (entry->networkNode.role & route.role) != route.role) {
+                // The best node is gone, the next one is only known by scanning the snapshot
+                updated[i] = !best;
                 continue;
             }
 
-            if (candidateCount < RTMAXSIZE) {
-                candidates[candidateCount].address = node->networkNode.address;
-                candidates[candidateCount].via = node->via;
-                candidates[candidateCount].metric = node->networkNode.metric;
-                candidateCount++;
+            if (!costKnown) {
+                cost = getRouteCost(entry->networkNode.metric, entry->via, entry->networkNode.address);
+                costKnown = true;
             }
-        } while (routingTableList->next());
+
+            if (best && cost > route.cost)
+                updated[i] = false;
+            else if (!route.found || best || cost < route.cost) {
+                route.found = true;
+                route.address = entry->networkNode.address;
+                route.via = entry->via;
+                route.cost = cost;
+            }
+        }
     }
-    routingTableList->releaseInUse();
 
-    if (candidateCount == 0) {
+    portENTER_CRITICAL(&roleRoutesMux);
+    for (size_t i = 0; i < routesLength; i++) {
+        // Not replaced by a scan of another snapshot meanwhile
+        if (updated[i] && roleRoutes[i].role == routes[i].role && roleRoutes[i].version == routes[i].version) {
+            roleRoutes[i] = routes[i];
+            roleRoutes[i].version = snapshot->version;
+        }
+    }
+    portEXIT_CRITICAL(&roleRoutesMux);
+}
+
+size_t RoutingTableService::getMulticastNextHops(uint8_t role, uint16_t exclude, uint8_t maxHops, uint16_t* nextHops, uint8_t* hopsLeft) {
+    RoutingTableView view;
+    size_t length = 0;
+
+    for (const RoutingTableSnapshot::Entry& route : view) {
+        const NetworkNode& node = route.networkNode;
+        if ((node.role & role) != role || node.address == exclude || route.via == exclude ||
+            node.metric == 0 || node.metric > maxHops)
+            continue;
+
+        size_t i = 0;
+        while (i < length && nextHops[i] != route.via)
+            i++;
+
+        if (i < length) {
+            hopsLeft[i] = std::max<uint8_t>(hopsLeft[i], node.metric - 1);
+            continue;
+        }
+
+        if (length == LM_MULTICAST_MAX_BRANCHES) {
+            ESP_LOGW(LM_TAG, "More than %d next hops to the role %X, the rest are not reached", LM_MULTICAST_MAX_BRANCHES, role);
+            break;
+        }
+
+        nextHops[length] = route.via;
+        hopsLeft[length++] = node.metric - 1;
+    }
+
+    return length;
+}
+
+RouteNode* RoutingTableService::getNodeByRoleForFlow(uint16_t flowKey, uint8_t role) {
+    updateFlowCandidates(role);
+
+    FlowCandidate candidates[LM_FLOW_MAX_CANDIDATES];
+
+    portENTER_CRITICAL(&flowCandidatesMux);
+    size_t length = flowCandidatesLength;
+    memcpy(candidates, flowCandidates, length * sizeof(FlowCandidate));
+    portEXIT_CRITICAL(&flowCandidatesMux);
+
+    if (length == 0)
         return nullptr;
+
+    size_t best = 0;
+    float bestScore = LM_Rendezvous::score(flowKey, candidates[0].address, candidates[0].weight);
+
+    for (size_t i = 1; i < length; i++) {
+        float score = LM_Rendezvous::score(flowKey, candidates[i].address, candidates[i].weight);
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+        }
     }
 
-    float bestCost = 0.0f;
-    bool bestCostValid = false;
-    uint16_t bestAddress = candidates[0].address;
+    ESP_LOGV(LM_TAG, "Flow %X assigned to %X of %d candidates", flowKey, candidates[best].address, length);
+
+    return findNode(candidates[best].address);
+}
+
+void RoutingTableService::updateFlowCandidates(uint8_t role) {
+    RoutingTableView view;
+
+    portENTER_CRITICAL(&routeCostMux);
+    uint32_t epoch = routeCostEpoch;
+    portEXIT_CRITICAL(&routeCostMux);
 
-    for (uint8_t i = 0; i < candidateCount; ++i) {
-        float candidateCost = costCallback(
-            candidates[i].metric,
-            candidates[i].via,
-            candidates[i].address
-        );
+    portENTER_CRITICAL(&flowCandidatesMux);
+    bool upToDate = flowCandidatesValid && flowCandidatesRole == role &&
+        flowCandidatesVersion == view.getVersion() && flowCandidatesEpoch == epoch;
+    portEXIT_CRITICAL(&flowCandidatesMux);
 
-        if (!bestCostValid || candidateCost < bestCost) {
-            bestCost = candidateCost;
-            bestCostValid = true;
-            bestAddress = candidates[i].address;
+    if (upToDate)
+        return;
+
+    FlowCandidate candidates[LM_FLOW_MAX_CANDIDATES];
+    size_t length = 0;
+
+    for (const RoutingTableSnapshot::Entry& route : view) {
+        if ((route.networkNode.role & role) != role)
+            continue;
+
+        if (length == LM_FLOW_MAX_CANDIDATES) {
+            ESP_LOGW(LM_TAG, "More than %d nodes with role %X, the rest are not used by the flows", LM_FLOW_MAX_CANDIDATES, role);
+            break;
         }
+
+        // The costs are calculated without any lock, the metric can use the routing table
+        RouteCost cost = getRouteCost(route.networkNode.metric, route.via, route.networkNode.address);
+        if (cost < LM_COST_SCALE / 10)
+            cost = LM_COST_SCALE / 10;
+
+        // 255 is an unknown load
+        uint8_t load = route.networkNode.gatewayLoad == 255 ? 0 : route.networkNode.gatewayLoad;
+
+        candidates[length].address = route.networkNode.address;
+        candidates[length].weight = (float) LM_COST_SCALE / cost * LM_FLOW_LOAD_REFERENCE / (LM_FLOW_LOAD_REFERENCE + load);
+        length++;
     }
 
-    return findNode(bestAddress);
+    portENTER_CRITICAL(&flowCandidatesMux);
+    memcpy(flowCandidates, candidates, length * sizeof(FlowCandidate));
+    flowCandidatesLength = length;
+    flowCandidatesRole = role;
+    flowCandidatesVersion = view.getVersion();
+    flowCandidatesEpoch = epoch;
+    flowCandidatesValid = true;
+    portEXIT_CRITICAL(&flowCandidatesMux);
+
+    ESP_LOGV(LM_TAG, "Flow candidates of role %X updated, %d candidates", role, length);
 }
 
 bool RoutingTableService::hasAddressRoutingTable(uint16_t address) {
@@ -106,7 +377,16 @@ bool RoutingTableService::hasAddressRoutingTable(uint16_t address) {
 }
 
 uint16_t RoutingTableService::getNextHop(uint16_t dst) {
-    RouteNode* node = findNode(dst);
+    if (RoleService::isRoleAddress(dst)) {
+        uint16_t address, via;
+        if (!getRoleRoute(RoleService::getAddressRole(dst), address, via))
+            return 0;
+
+        // The live route to the best node, the snapshot can be older
+        dst = address;
+    }
+
+    RouteNode* node = findRoute(dst);
 
     if (node == nullptr)
         return 0;
@@ -114,6 +394,37 @@ uint16_t RoutingTableService::getNextHop(uint16_t dst) {
     return node->via;
 }
 
+uint16_t RoutingTableService::getSnapshotNextHop(uint16_t dst) {
+    if (RoleService::isRoleAddress(dst)) {
+        uint16_t address, via;
+        return getRoleRoute(RoleService::getAddressRole(dst), address, via) ? via : 0;
+    }
+
+    RoutingTableSnapshot::Entry route;
+    if (getSnapshotRoute(dst, route))
+        return route.via;
+
+    // A node of another cluster is reached through the route to its cluster
+    uint16_t cluster = getClusterAddress(dst);
+    if (cluster != dst && isOtherCluster(dst) && getSnapshotRoute(cluster, route))
+        return route.via;
+
+    return 0;
+}
+
+bool RoutingTableService::getSnapshotRoute(uint16_t address, RoutingTableSnapshot::Entry& route) {
+    RoutingTableView view;
+
+    for (const RoutingTableSnapshot::Entry& entry : view) {
+        if (entry.networkNode.address == address) {
+            route = entry;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 uint8_t RoutingTableService::getNumberOfHops(uint16_t address) {
     RouteNode* node = findNode(address);
 
@@ -124,26 +435,61 @@ uint8_t RoutingTableService::getNumberOfHops(uint16_t address) {
 }
 
 void RoutingTableService::processRoute(RoutePacket* p, int8_t receivedSNR) {
-    if ((p->packetSize - sizeof(RoutePacket)) % sizeof(NetworkNode) != 0) {
+    bool compact = (p->routeFlags & ROUTE_COMPACT_F) != 0;
+    if (p->packetSize < sizeof(RoutePacket) + p->getTrailerLength() ||
+        (!compact && p->getNetworkNodesLength() % sizeof(NetworkNode) != 0)) {
         ESP_LOGE(LM_TAG, "Invalid route packet size");
         return;
     }
 
-    size_t numNodes = p->getNetworkNodesSize();
-    ESP_LOGI(LM_TAG, "Route packet from %X with size %d", p->src, numNodes);
+    size_t numNodes = compact ? 0 : p->getNetworkNodesSize();
+    bool delta = (p->routeFlags & ROUTE_DELTA_F) != 0;
+    ESP_LOGI(LM_TAG, "Route packet from %X with %d bytes of nodes, %s%s version %d", p->src, p->getNetworkNodesLength(),
+        compact ? "compact " : "", delta ? "delta" : "full", p->tableVersion);
+
+    // The neighbor needs our full routing table
+    if (p->routeFlags & ROUTE_REQUEST_FULL_F)
+        fullAdvertisementPending = true;
+
+    checkAdvertisementVersion(p);
 
     NetworkNode* receivedNode = new NetworkNode(p->src, 1, p->nodeRole, p->gatewayLoad);
     processRoute(p->src, receivedNode);
     delete receivedNode;
 
+    RouteNode* neighbor = findNode(p->src);
+    if (neighbor != nullptr) {
+        neighbor->helloVersion = p->tableVersion;
+        neighbor->hasHelloVersion = true;
+    }
+
     resetReceiveSNRRoutePacket(p->src, receivedSNR);
 
-    for (size_t i = 0; i < numNodes; i++) {
-        NetworkNode* node = &p->networkNodes[i];
-        node->metric++;
-        processRoute(p->src, node);
+    for (size_t i = 0; i < numNodes; i++)
+        processAdvertisedNode(p->src, &p->networkNodes[i], delta);
+
+    if (compact) {
+        const uint8_t* encoded = reinterpret_cast<const uint8_t*>(p->networkNodes);
+        size_t length = p->getNetworkNodesLength();
+        size_t position = 0;
+        uint16_t previousAddress = 0;
+        NetworkNode node;
+
+        while (position < length) {
+            size_t nodeLength = LM_CompactNodeCodec::decode(&encoded[position], length - position, previousAddress, node);
+            if (nodeLength == 0) {
+                ESP_LOGE(LM_TAG, "Truncated compact route packet from %X", p->src);
+                break;
+            }
+
+            position += nodeLength;
+            previousAddress = node.address;
+            processAdvertisedNode(p->src, &node, delta);
+        }
     }
 
+    publishSnapshot();
+
     printRoutingTable();
 
     // Notify callback if registered (for Trickle suppression)
@@ -152,6 +498,371 @@ void RoutingTableService::processRoute(RoutePacket* p, int8_t receivedSNR) {
     }
 }
 
+void RoutingTableService::checkAdvertisementVersion(RoutePacket* p) {
+    RouteNode* neighbor = findNode(p->src);
+    bool known = neighbor != nullptr && neighbor->hasHelloVersion;
+
+    // The packets of the same advertisement have the same version, the next advertisement the next version
+    if (known && (p->tableVersion == neighbor->helloVersion || p->tableVersion == (uint8_t) (neighbor->helloVersion + 1)))
+        return;
+
+    // Lost advertisements of a neighbor, maybe collided with other HELLOs
+    if (known)
+        missedAdvertisementCount++;
+
+    if ((p->routeFlags & ROUTE_DELTA_F) == 0)
+        return;
+
+    ESP_LOGI(LM_TAG, "Missing advertisements from %X, requesting a full advertisement", p->src);
+    fullAdvertisementRequested = true;
+}
+
+void RoutingTableService::withdrawRoute(uint16_t via, uint16_t address) {
+    routingTableList->setInUse();
+
+    RouteNode* rNode = routingTableIndex->find(address);
+    if (rNode != nullptr && rNode->via != via) {
+        for (size_t i = 0; i < rNode->alternatesLength; i++) {
+            if (rNode->alternates[i].via == via) {
+                removeAlternate(rNode, i);
+                break;
+            }
+        }
+    }
+    else if (rNode != nullptr && moveToAlternate(rNode))
+        ESP_LOGI(LM_TAG, "Route to %X removed by %X, moved to %X", address, via, rNode->via);
+    else if (rNode != nullptr && routingTableList->Search(rNode)) {
+        ESP_LOGI(LM_TAG, "Route to %X removed by %X", address, via);
+        deleteCurrentNode();
+    }
+
+    routingTableList->releaseInUse();
+}
+
+void RoutingTableService::updateAlternates(uint16_t address, uint16_t via, uint8_t metric) {
+    routingTableList->setInUse();
+
+    RouteNode* node = routingTableIndex->find(address);
+    if (node != nullptr)
+        updateAlternate(node, via, metric);
+
+    routingTableList->releaseInUse();
+}
+
+void RoutingTableService::updateAlternate(RouteNode* node, uint16_t via, uint8_t metric) {
+    // Loop free, the neighbor is closer to the destination than this node. The alternates not loop free anymore
+    // after a change of the metric of the route are removed
+    for (size_t i = node->alternatesLength; i-- > 0;) {
+        if (node->alternates[i].via == via || node->alternates[i].via == node->via ||
+            node->alternates[i].metric > node->networkNode.metric)
+            removeAlternate(node, i);
+    }
+
+    if (via == node->via || metric > node->networkNode.metric)
+        return;
+
+    size_t position = node->alternatesLength;
+    if (position == LM_ROUTE_ALTERNATES) {
+        // Replace the highest metric, the oldest one if they are equal
+        position = 0;
+        for (size_t i = 1; i < node->alternatesLength; i++) {
+            const RouteAlternate& alternate = node->alternates[i];
+            if (alternate.metric > node->alternates[position].metric ||
+                (alternate.metric == node->alternates[position].metric &&
+                    (int32_t) (alternate.heard - node->alternates[position].heard) < 0))
+                position = i;
+        }
+
+        if (node->alternates[position].metric < metric)
+            return;
+    }
+    else
+        node->alternatesLength++;
+
+    node->alternates[position] = {via, metric, (uint32_t) millis()};
+}
+
+void RoutingTableService::removeAlternate(RouteNode* node, size_t index) {
+    node->alternates[index] = node->alternates[--node->alternatesLength];
+}
+
+int RoutingTableService::getBestAlternate(RouteNode* node) {
+    int best = -1;
+    uint32_t now = millis();
+
+    for (size_t i = 0; i < node->alternatesLength; i++) {
+        const RouteAlternate& alternate = node->alternates[i];
+        if (now - alternate.heard >= DEFAULT_TIMEOUT * 1000)
+            continue;
+
+        if (best < 0 || alternate.metric < node->alternates[best].metric ||
+            (alternate.metric == node->alternates[best].metric && (int32_t) (alternate.heard - node->alternates[best].heard) > 0))
+            best = i;
+    }
+
+    return best;
+}
+
+void RoutingTableService::switchToAlternate(RouteNode* node, size_t index, bool keepPrevious) {
+    RouteAlternate alternate = node->alternates[index];
+    removeAlternate(node, index);
+
+    uint16_t previousVia = node->via;
+    uint8_t previousMetric = node->networkNode.metric;
+
+    node->via = alternate.via;
+    node->networkNode.metric = alternate.metric;
+
+    // Without the previous next hop it only removes the alternates not loop free anymore
+    if (keepPrevious)
+        updateAlternate(node, previousVia, previousMetric);
+    else
+        updateAlternate(node, alternate.via, alternate.metric);
+
+    resetTimeoutRoutingNode(node);
+    markDirty(node->networkNode.address, true);
+    markChanged(node);
+    failoverCount++;
+}
+
+bool RoutingTableService::moveToAlternate(RouteNode* node) {
+    if (!multipath)
+        return false;
+
+    int best = getBestAlternate(node);
+    if (best < 0)
+        return false;
+
+    ESP_LOGI(LM_TAG, "Route to %X moved from %X to the alternate %X", node->networkNode.address, node->via,
+        node->alternates[best].via);
+
+    switchToAlternate(node, best, false);
+    return true;
+}
+
+size_t RoutingTableService::failoverNeighbor(uint16_t neighbor) {
+    if (!multipath)
+        return 0;
+
+    size_t moved = 0;
+
+    routingTableList->setInUse();
+
+    for (RouteNode* node : *routingTableList) {
+        for (size_t i = node->alternatesLength; i-- > 0;) {
+            if (node->alternates[i].via == neighbor)
+                removeAlternate(node, i);
+        }
+
+        if (node->via == neighbor && node->networkNode.address != neighbor && moveToAlternate(node))
+            moved++;
+    }
+
+    routingTableList->releaseInUse();
+
+    if (moved > 0)
+        publishSnapshot();
+
+    return moved;
+}
+
+size_t RoutingTableService::reevaluateAlternates(uint16_t neighbor) {
+    if (!multipath || !RoutingMetricPolicy::COST_ROUTING)
+        return 0;
+
+    struct Candidate {
+        uint16_t address;
+        uint8_t metric;
+        RouteAlternate alternate;
+    };
+
+    Candidate candidates[LM_DIRTY_ROUTES];
+    size_t length = 0;
+
+    routingTableList->setInUseShared();
+
+    for (RouteNode* node : *routingTableList) {
+        for (size_t i = 0; i < node->alternatesLength && node->via == neighbor && length < LM_DIRTY_ROUTES; i++)
+            candidates[length++] = {node->networkNode.address, node->networkNode.metric, node->alternates[i]};
+    }
+
+    routingTableList->releaseInUseShared();
+
+    // The costs are calculated without any lock, the metric can use the routing table
+    size_t moved = 0;
+
+    for (size_t c = 0; c < length; c++) {
+        Candidate& candidate = candidates[c];
+        RouteCost cost = getRouteCost(candidate.metric, neighbor, candidate.address);
+        RouteCost alternateCost = getRouteCost(candidate.alternate.metric, candidate.alternate.via, candidate.address);
+        if (!isCheaper(alternateCost, cost, routeHysteresis))
+            continue;
+
+        routingTableList->setInUse();
+
+        // The route and the alternate can have changed meanwhile
+        RouteNode* node = routingTableIndex->find(candidate.address);
+        for (size_t i = 0; node != nullptr && node->via == neighbor && i < node->alternatesLength; i++) {
+            if (node->alternates[i].via == candidate.alternate.via) {
+                ESP_LOGI(LM_TAG, "Route to %X moved from %X to the alternate %X, cost %ld < %ld", candidate.address, neighbor,
+                    candidate.alternate.via, (long) alternateCost, (long) cost);
+                switchToAlternate(node, i, true);
+                moved++;
+                break;
+            }
+        }
+
+        routingTableList->releaseInUse();
+    }
+
+    if (moved > 0)
+        publishSnapshot();
+
+    return moved;
+}
+
+void RoutingTableService::processAdvertisedNode(uint16_t via, NetworkNode* node, bool delta) {
+    if (clusterMask != 0 && !aggregateClusterRoute(node, delta))
+        return;
+
+    if (delta && node->metric == 0) {
+        withdrawRoute(via, node->address);
+        return;
+    }
+
+    node->metric++;
+    processRoute(via, node);
+}
+
+bool RoutingTableService::aggregateClusterRoute(NetworkNode* node, bool delta) {
+    uint16_t cluster = getClusterAddress(node->address);
+
+    // The nodes of the own cluster have their own routes
+    if (!isOtherCluster(node->address))
+        return node->address != cluster;
+
+    if (node->address == cluster || node->role != ROLE_DEFAULT)
+        return true;
+
+    // The route to the cluster is only withdrawn by its own entry, the other nodes of the cluster can be reachable
+    if (delta && node->metric == 0)
+        return false;
+
+    node->address = cluster;
+    node->gatewayLoad = 255;
+    return true;
+}
+
+void RoutingTableService::setClusterPrefixLength(uint8_t length) {
+    if (length > 8) {
+        ESP_LOGW(LM_TAG, "Cluster prefix of %d bits, using 8", length);
+        length = 8;
+    }
+
+    clusterMask = length == 0 ? 0 : (uint16_t) (0xFFFF << (16 - length));
+}
+
+uint16_t RoutingTableService::getClusterAddress(uint16_t address) {
+    if (clusterMask == 0 || address >= LM_MULTICAST_ADDRESS)
+        return address;
+
+    return address & clusterMask;
+}
+
+bool RoutingTableService::isOtherCluster(uint16_t address) {
+    return clusterMask != 0 && address < LM_MULTICAST_ADDRESS &&
+        getClusterAddress(address) != getClusterAddress(WiFiService::getLocalAddress());
+}
+
+RouteNode* RoutingTableService::findRoute(uint16_t address) {
+    RouteNode* node = findNode(address);
+    if (node != nullptr || clusterMask == 0)
+        return node;
+
+    uint16_t cluster = getClusterAddress(address);
+    if (cluster == address || !isOtherCluster(address))
+        return nullptr;
+
+    return findNode(cluster);
+}
+
+void RoutingTableService::markChanged(RouteNode* node) {
+    node->changedVersion = tableVersion;
+    snapshotChanged = true;
+    changeCount++;
+    LM_HOOK(HOOK_ROUTE_UPDATE, nullptr, node->networkNode.address);
+    markDirty(node->networkNode.address, false);
+    markRoleChange(node->networkNode.address);
+}
+
+void RoutingTableService::markDirty(uint16_t address, bool topologyChanged) {
+    portENTER_CRITICAL(&dirtyRoutesMux);
+
+    if (topologyChanged)
+        topologyChangeCount++;
+
+    bool found = false;
+    for (size_t i = 0; i < dirtyRoutesLength && !found; i++)
+        found = dirtyRoutes[i] == address;
+
+    if (!found) {
+        if (dirtyRoutesLength < LM_DIRTY_ROUTES)
+            dirtyRoutes[dirtyRoutesLength++] = address;
+        else
+            dirtyRoutesOverflow = true;
+    }
+
+    portEXIT_CRITICAL(&dirtyRoutesMux);
+}
+
+void RoutingTableService::markLinkDirty(uint16_t neighbor) {
+    routingTableList->setInUseShared();
+
+    for (RouteNode* node : *routingTableList) {
+        if (node->via == neighbor)
+            markDirty(node->networkNode.address, false);
+    }
+
+    routingTableList->releaseInUseShared();
+}
+
+size_t RoutingTableService::takeDirtyRoutes(uint16_t* addresses, bool& all) {
+    portENTER_CRITICAL(&dirtyRoutesMux);
+
+    size_t length = dirtyRoutesLength;
+    memcpy(addresses, dirtyRoutes, length * sizeof(uint16_t));
+    all = dirtyRoutesOverflow;
+
+    dirtyRoutesLength = 0;
+    dirtyRoutesOverflow = false;
+
+    portEXIT_CRITICAL(&dirtyRoutesMux);
+
+    return length;
+}
+
+uint32_t RoutingTableService::getTopologyChangeCount() {
+    portENTER_CRITICAL(&dirtyRoutesMux);
+    uint32_t count = topologyChangeCount;
+    portEXIT_CRITICAL(&dirtyRoutesMux);
+
+    return count;
+}
+
+void RoutingTableService::setTopologyChangedCallback(TopologyChangedCallback callback) {
+    topologyCallback = callback;
+}
+
+void RoutingTableService::notifyTopologyChanged() {
+    portENTER_CRITICAL(&dirtyRoutesMux);
+    bool changed = notifiedTopologyChangeCount != topologyChangeCount;
+    notifiedTopologyChangeCount = topologyChangeCount;
+    portEXIT_CRITICAL(&dirtyRoutesMux);
+
+    if (changed && topologyCallback != nullptr)
+        topologyCallback();
+}
+
 void RoutingTableService::resetReceiveSNRRoutePacket(uint16_t src, int8_t receivedSNR) {
     RouteNode* rNode = findNode(src);
     if (rNode == nullptr)
@@ -160,6 +871,85 @@ void RoutingTableService::resetReceiveSNRRoutePacket(uint16_t src, int8_t receiv
     ESP_LOGI(LM_TAG, "Reset Receive SNR from %X: %d", src, receivedSNR);
 
     rNode->receivedSNR = receivedSNR;
+    rNode->addSNR(receivedSNR);
+}
+
+bool RoutingTableService::getNeighborMinSNR(uint16_t address, int8_t& snr) {
+    routingTableList->setInUseShared();
+
+    RouteNode* node = routingTableIndex->find(address);
+    bool found = node != nullptr && node->networkNode.metric == 1 && node->snrHistoryLength > 0;
+    if (found)
+        snr = node->getMinSNR();
+
+    routingTableList->releaseInUseShared();
+    return found;
+}
+
+void RoutingTableService::resetSentSNRRoutePacket(uint16_t src, int8_t sentSNR) {
+    routingTableList->setInUse();
+
+    RouteNode* rNode = routingTableIndex->find(src);
+    if (rNode != nullptr && rNode->networkNode.metric == 1) {
+        ESP_LOGI(LM_TAG, "Reset Sent SNR to %X: %d", src, sentSNR);
+        rNode->sentSNR = sentSNR;
+        rNode->hasSentSNR = true;
+    }
+
+    routingTableList->releaseInUse();
+}
+
+bool RoutingTableService::getNeighborSentSNR(uint16_t address, int8_t& snr) {
+    routingTableList->setInUseShared();
+
+    RouteNode* node = routingTableIndex->find(address);
+    bool found = node != nullptr && node->networkNode.metric == 1 && node->hasSentSNR;
+    if (found)
+        snr = node->sentSNR;
+
+    routingTableList->releaseInUseShared();
+    return found;
+}
+
+void RoutingTableService::fillLinkSnr(LinkSnrTrailer* trailer) {
+    memset(trailer, 0, sizeof(LinkSnrTrailer));
+
+    routingTableList->setInUseShared();
+
+    size_t neighbors = 0;
+    for (RouteNode* node : *routingTableList) {
+        if (node->networkNode.metric == 1 && node->snrHistoryLength > 0)
+            neighbors++;
+    }
+
+    // With more neighbours than reports, every HELLO starts where the previous one stopped
+    size_t first = neighbors > LM_LINK_SNR_REPORTS ? linkSnrNext % neighbors : 0;
+    size_t index = 0;
+    for (RouteNode* node : *routingTableList) {
+        if (node->networkNode.metric != 1 || node->snrHistoryLength == 0)
+            continue;
+
+        size_t position = (index++ + neighbors - first) % neighbors;
+        if (position >= LM_LINK_SNR_REPORTS)
+            continue;
+
+        trailer->reports[position].address = node->networkNode.address;
+        trailer->reports[position].snr = node->getMinSNR();
+    }
+
+    routingTableList->releaseInUseShared();
+
+    linkSnrNext = first + LM_LINK_SNR_REPORTS;
+}
+
+void RoutingTableService::processLinkSnr(uint16_t src, LinkSnrTrailer* trailer) {
+    uint16_t localAddress = WiFiService::getLocalAddress();
+    for (const LinkSnrReport& report : trailer->reports) {
+        if (report.address == localAddress) {
+            resetSentSNRRoutePacket(src, report.snr);
+            return;
+        }
+    }
 }
 
 void RoutingTableService::processRoute(uint16_t via, NetworkNode* node) {
@@ -174,29 +964,30 @@ void RoutingTableService::processRoute(uint16_t via, NetworkNode* node) {
 
         //Update the metric and restart timeout if needed
         bool shouldUpdateRoute = false;
+        uint16_t previousVia = rNode->via;
+        uint8_t previousMetric = rNode->networkNode.metric;
 
-        // Use cost-based comparison if callback registered (Protocol 3)
-        if (costCallback != nullptr) {
-            float newCost = costCallback(node->metric, via, node->address);
-            float currentCost = costCallback(rNode->networkNode.metric, rNode->via, node->address);
+        // Use cost-based comparison with a cost routing metric (Protocol 3)
+        if (RoutingMetricPolicy::COST_ROUTING) {
+            RouteCost newCost = getRouteCost(node->metric, via, node->address);
+            RouteCost currentCost = getRouteCost(rNode->networkNode.metric, rNode->via, node->address);
 
-            // Apply hysteresis: new route must be 15% better to switch
-            if (newCost < currentCost * 0.85) {
+            // Apply hysteresis: new route must be routeHysteresis % better to switch
+            if (isCheaper(newCost, currentCost, routeHysteresis)) {
                 shouldUpdateRoute = true;
-                float improvement = ((currentCost - newCost) / currentCost) * 100.0;
-                ESP_LOGI(LM_TAG, "[COST-ROUTING] Better route for %X via %X: cost %.2f < %.2f (-%.1f%%), metric %d→%d",
-                        node->address, via, newCost, currentCost, improvement, rNode->networkNode.metric, node->metric);
+                ESP_LOGI(LM_TAG, "[COST-ROUTING] Better route for %X via %X: cost %ld < %ld (-%ld%%), metric %d→%d",
+                        node->address, via, (long) newCost, (long) currentCost, (long) getImprovement(newCost, currentCost),
+                        rNode->networkNode.metric, node->metric);
             }
             else if (newCost < currentCost) {
                 // Route is better but doesn't meet hysteresis threshold
-                float improvement = ((currentCost - newCost) / currentCost) * 100.0;
-                ESP_LOGD(LM_TAG, "[COST-ROUTING] Route for %X via %X is better (cost %.2f vs %.2f, -%.1f%%) but below 15%% hysteresis threshold",
-                        node->address, via, newCost, currentCost, improvement);
+                ESP_LOGD(LM_TAG, "[COST-ROUTING] Route for %X via %X is better (cost %ld vs %ld, -%ld%%) but below %d%% hysteresis threshold",
+                        node->address, via, (long) newCost, (long) currentCost, (long) getImprovement(newCost, currentCost), routeHysteresis);
             }
             else if (node->metric == rNode->networkNode.metric && via == rNode->via) {
                 // Same path, just reset timeout
-                ESP_LOGV(LM_TAG, "[COST-ROUTING] Refreshing route for %X via %X (cost %.2f, metric %d)",
-                        node->address, via, newCost, node->metric);
+                ESP_LOGV(LM_TAG, "[COST-ROUTING] Refreshing route for %X via %X (cost %ld, metric %d)",
+                        node->address, via, (long) newCost, node->metric);
                 resetTimeoutRoutingNode(rNode);
             }
         }
@@ -213,20 +1004,36 @@ void RoutingTableService::processRoute(uint16_t via, NetworkNode* node) {
 
         // Update route if better path found
         if (shouldUpdateRoute) {
+            if (rNode->via != via)
+                markDirty(node->address, true);
+
             rNode->networkNode.metric = node->metric;
             rNode->via = via;
             resetTimeoutRoutingNode(rNode);
+            markChanged(rNode);
+        }
+
+        if (multipath) {
+            updateAlternates(node->address, via, node->metric);
+
+            // The replaced next hop is still an alternate
+            if (previousVia != via && shouldUpdateRoute)
+                updateAlternates(node->address, previousVia, previousMetric);
         }
 
         // Update gateway load metadata when provided (propagates W5 bias data)
         if (node->gatewayLoad != 255 && node->gatewayLoad != rNode->networkNode.gatewayLoad) {
             rNode->networkNode.gatewayLoad = node->gatewayLoad;
+            markChanged(rNode);
+            invalidateRouteCosts();
         }
 
         // Update the Role only if the node that sent the packet is the next hop
         if (getNextHop(node->address) == via && node->role != rNode->networkNode.role) {
             ESP_LOGI(LM_TAG, "Updating role of %X to %d", node->address, node->role);
             rNode->networkNode.role = node->role;
+            markChanged(rNode);
+            invalidateRouteCosts();
         }
     }
 }
@@ -239,52 +1046,84 @@ void RoutingTableService::addNodeToRoutingTable(NetworkNode* node, uint16_t via)
 
     // PROTOCOL 3 FIX: Allow higher-hop routes if they have better cost
     // This enables choosing 2-hop good-signal paths over 1-hop weak-signal paths
-    if (costCallback != nullptr) {
+    if (RoutingMetricPolicy::COST_ROUTING) {
         // Check if there's an existing route to this destination
         RouteNode* existingRoute = findNode(node->address);
 
         if (existingRoute != nullptr && node->metric > existingRoute->networkNode.metric) {
             // New route has MORE hops - normally rejected by distance-vector
             // BUT in cost-based routing, check if cost is better
-            float newCost = costCallback(node->metric, via, node->address);
-            float existingCost = costCallback(existingRoute->networkNode.metric,
+            RouteCost newCost = getRouteCost(node->metric, via, node->address);
+            RouteCost existingCost = getRouteCost(existingRoute->networkNode.metric,
                                              existingRoute->via,
                                              node->address);
 
-            // If new route has significantly better cost (>20% improvement), use it!
-            if (newCost < existingCost * 0.8) {
+            // If new route has significantly better cost (longerRouteHysteresis % improvement), use it!
+            if (isCheaper(newCost, existingCost, longerRouteHysteresis)) {
                 // Replace existing route with better-quality multi-hop route
-                ESP_LOGI(LM_TAG, "[COST-ROUTING] Replacing %d-hop route with better %d-hop route for %X: cost %.2f → %.2f (-%.1f%%)",
+                ESP_LOGI(LM_TAG, "[COST-ROUTING] Replacing %d-hop route with better %d-hop route for %X: cost %ld → %ld (-%ld%%)",
                         existingRoute->networkNode.metric, node->metric, node->address,
-                        existingCost, newCost, ((existingCost - newCost) / existingCost) * 100.0);
+                        (long) existingCost, (long) newCost, (long) getImprovement(newCost, existingCost));
 
                 // Update existing route instead of adding new one
+                if (existingRoute->via != via)
+                    markDirty(node->address, true);
+
+                uint16_t previousVia = existingRoute->via;
+                uint8_t previousMetric = existingRoute->networkNode.metric;
+
                 existingRoute->networkNode.metric = node->metric;
                 existingRoute->via = via;
                 existingRoute->networkNode.gatewayLoad = node->gatewayLoad;
                 resetTimeoutRoutingNode(existingRoute);
+                markChanged(existingRoute);
+                invalidateRouteCosts();
+
+                // The shorter route is loop free, it stays as an alternate
+                if (multipath && previousVia != via)
+                    updateAlternates(node->address, previousVia, previousMetric);
                 return;
             } else {
                 // New route has higher hops AND worse/similar cost - reject
-                ESP_LOGD(LM_TAG, "[COST-ROUTING] Rejecting %d-hop route (cost %.2f vs existing %d-hop %.2f)",
-                        node->metric, newCost, existingRoute->networkNode.metric, existingCost);
+                ESP_LOGD(LM_TAG, "[COST-ROUTING] Rejecting %d-hop route (cost %ld vs existing %d-hop %ld)",
+                        node->metric, (long) newCost, existingRoute->networkNode.metric, (long) existingCost);
                 return;
             }
         }
     }
     // Fallback: Original hop-count filtering for Protocol 1 & 2
-    else if (calculateMaximumMetricOfRoutingTable() < node->metric) {
+    // The routes of the other clusters are farther than the routes kept of the own cluster
+    // The reactive routes are not bounded by the farthest route kept, the routes of the roles come from the whole network
+    else if (!reactiveRoutes && !isOtherCluster(node->address) && calculateMaximumMetricOfRoutingTable() < node->metric) {
         ESP_LOGW(LM_TAG, "Trying to add a route with a metric higher than the maximum of the routing table, not adding route and deleting it");
         return;
     }
 
     RouteNode* rNode = new RouteNode(*node, via);
+    MemoryService::add(MEMORY_ROUTING, sizeof(RouteNode));
 
     //Reset the timeout of the node
     resetTimeoutRoutingNode(rNode);
+    markDirty(node->address, true);
+    markChanged(rNode);
+
+    // The cost of the routes can depend on the other routes, like the gateway load
+    invalidateRouteCosts();
+
+    // A new neighbor needs our full routing table
+    if (node->metric == 1)
+        fullAdvertisementPending = true;
 
     routingTableList->setInUse();
 
+    if (!routingTableIndex->insert(rNode->networkNode.address, rNode)) {
+        routingTableList->releaseInUse();
+        ESP_LOGE(LM_TAG, "Routing table index full, not adding route");
+        delete rNode;
+        MemoryService::remove(MEMORY_ROUTING, sizeof(RouteNode));
+        return;
+    }
+
     routingTableList->Append(rNode);
 
     routingTableList->releaseInUse();
@@ -292,36 +1131,224 @@ void RoutingTableService::addNodeToRoutingTable(NetworkNode* node, uint16_t via)
     ESP_LOGI(LM_TAG, "New route added: %X via %X metric %d, role %d", node->address, via, node->metric, node->role);
 }
 
-NetworkNode* RoutingTableService::getAllNetworkNodes() {
-    routingTableList->setInUse();
+NetworkNode* RoutingTableService::getAllNetworkNodes(size_t& numOfNodes) {
+    RoutingTableView view;
 
-    int routingSize = routingTableSize();
+    // The list and its size come from the same snapshot
+    numOfNodes = view.size();
 
     // If the routing table is empty return nullptr
-    if (routingSize == 0) {
-        routingTableList->releaseInUse();
+    if (numOfNodes == 0)
         return nullptr;
+
+    NetworkNode* payload = new NetworkNode[numOfNodes];
+
+    for (size_t i = 0; i < numOfNodes; i++)
+        payload[i] = view[i].networkNode;
+
+    return payload;
+}
+
+RoutingTableSnapshot* RoutingTableService::acquireSnapshot() {
+    portENTER_CRITICAL(&snapshotMux);
+
+    RoutingTableSnapshot* snapshot = currentSnapshot;
+    snapshot->references++;
+
+    portEXIT_CRITICAL(&snapshotMux);
+
+    return snapshot;
+}
+
+void RoutingTableService::releaseSnapshot(RoutingTableSnapshot* snapshot) {
+    portENTER_CRITICAL(&snapshotMux);
+
+    bool unused = --snapshot->references == 0;
+
+    // Keep the biggest unused snapshot to be reused by the next publish
+    if (unused && (spareSnapshot == nullptr || spareSnapshot->capacity < snapshot->capacity)) {
+        RoutingTableSnapshot* previousSpare = spareSnapshot;
+        spareSnapshot = snapshot;
+        snapshot = previousSpare;
     }
 
-    NetworkNode* payload = new NetworkNode[routingSize];
+    portEXIT_CRITICAL(&snapshotMux);
+
+    if (unused)
+        delete snapshot;
+}
 
+void RoutingTableService::publishSnapshot() {
+    routingTableList->setInUse();
+
+    if (!snapshotChanged) {
+        routingTableList->releaseInUse();
+        notifyTopologyChanged();
+        return;
+    }
+
+    size_t routingSize = routingTableSize();
+
+    portENTER_CRITICAL(&snapshotMux);
+
+    RoutingTableSnapshot* snapshot = nullptr;
+    if (spareSnapshot != nullptr && spareSnapshot->capacity >= routingSize) {
+        snapshot = spareSnapshot;
+        spareSnapshot = nullptr;
+    }
+
+    portEXIT_CRITICAL(&snapshotMux);
+
+    if (snapshot == nullptr)
+        snapshot = new RoutingTableSnapshot(routingSize);
+
+    // Taken before the copy, the changes recorded after it are applied to the next snapshot
+    uint16_t changes[LM_DIRTY_ROUTES];
+
+    portENTER_CRITICAL(&roleRoutesMux);
+    size_t changesLength = roleChangesOverflow ? 0 : roleChangesLength;
+    bool changesKnown = !roleChangesOverflow;
+    memcpy(changes, roleChanges, changesLength * sizeof(uint16_t));
+    roleChangesLength = 0;
+    roleChangesOverflow = false;
+    portEXIT_CRITICAL(&roleRoutesMux);
+
+    snapshot->size = 0;
     if (routingTableList->moveToStart()) {
-        for (int i = 0; i < routingSize; i++) {
-            RouteNode* currentNode = routingTableList->getCurrent();
-            payload[i] = currentNode->networkNode;
+        do {
+            RouteNode* node = routingTableList->getCurrent();
+            snapshot->entries[snapshot->size].networkNode = node->networkNode;
+            snapshot->entries[snapshot->size].via = node->via;
+            snapshot->size++;
 
-            if (!routingTableList->next())
-                break;
+        } while (routingTableList->next());
+    }
+
+    snapshot->version = ++snapshotVersion;
+    // One reference more, held until the roleRoutes are updated
+    snapshot->references = 2;
+    snapshotChanged = false;
+
+    routingTableList->releaseInUse();
+
+    portENTER_CRITICAL(&snapshotMux);
+
+    RoutingTableSnapshot* previous = currentSnapshot;
+    currentSnapshot = snapshot;
+
+    portEXIT_CRITICAL(&snapshotMux);
+
+    releaseSnapshot(previous);
+
+    // Without the list of changes the roles are scanned again when they are used
+    if (changesKnown)
+        updateRoleRoutes(snapshot, changes, changesLength);
+
+    ESP_LOGV(LM_TAG, "Routing table snapshot %d published with %d routes", snapshot->version, snapshot->size);
+
+    releaseSnapshot(snapshot);
+
+    notifyTopologyChanged();
+}
+
+NetworkNode* RoutingTableService::getNextAdvertisement(size_t& numOfNodes, uint8_t& routeFlags, uint8_t& version, bool triggered) {
+    routingTableList->setInUse();
+
+    bool full = !triggered && (!deltaAdvertisement || fullAdvertisementPending ||
+        millis() - lastFullAdvertisement >= LM_FULL_HELLO_INTERVAL * 1000);
+
+    size_t maxNodes = routingTableSize() + (full ? 0 : LM_MAX_WITHDRAWN_ROUTES);
+    NetworkNode* payload = maxNodes > 0 ? new NetworkNode[maxNodes] : nullptr;
+    numOfNodes = 0;
+
+    if (routingTableList->moveToStart()) {
+        do {
+            RouteNode* node = routingTableList->getCurrent();
+            // The reactive routes advertise the neighbors and the roles only, the other destinations are discovered
+            if (reactiveRoutes && node->networkNode.metric != 1 && node->networkNode.role == ROLE_DEFAULT)
+                continue;
+
+            if (full || node->changedVersion == tableVersion)
+                payload[numOfNodes++] = node->networkNode;
+
+        } while (routingTableList->next());
+    }
+
+    // Removed routes are sent with metric 0, unless they have been added again
+    if (!full) {
+        for (uint8_t i = 0; i < LM_MAX_WITHDRAWN_ROUTES; i++) {
+            WithdrawnRoute* route = &withdrawnRoutes[i];
+            if (route->address != 0 && route->version == tableVersion && routingTableIndex->find(route->address) == nullptr)
+                payload[numOfNodes++] = NetworkNode(route->address, 0, 0);
         }
     }
 
+    if (numOfNodes == 0 && payload != nullptr) {
+        delete[] payload;
+        payload = nullptr;
+    }
+
+    routeFlags = (full ? 0 : ROUTE_DELTA_F) | (fullAdvertisementRequested ? ROUTE_REQUEST_FULL_F : 0);
+
+    // The compact encoding sends the address increments of the sorted nodes
+    if (compactAdvertisement) {
+        routeFlags |= ROUTE_COMPACT_F;
+        std::sort(payload, payload + numOfNodes,
+            [](const NetworkNode& a, const NetworkNode& b) { return a.address < b.address; });
+    }
+    version = tableVersion++;
+
+    if (full) {
+        fullAdvertisementPending = false;
+        lastFullAdvertisement = millis();
+    }
+    fullAdvertisementRequested = false;
+
     routingTableList->releaseInUse();
 
+    ESP_LOGV(LM_TAG, "Advertisement version %d with %d nodes, flags %d", version, numOfNodes, routeFlags);
+
     return payload;
 }
 
+bool RoutingTableService::hasPendingWithdrawals() {
+    routingTableList->setInUseShared();
+
+    bool pending = false;
+    for (uint8_t i = 0; i < LM_MAX_WITHDRAWN_ROUTES && !pending; i++) {
+        WithdrawnRoute* route = &withdrawnRoutes[i];
+        pending = route->address != 0 && route->version == tableVersion && routingTableIndex->find(route->address) == nullptr;
+    }
+
+    routingTableList->releaseInUseShared();
+    return pending;
+}
+
+void RoutingTableService::setTriggeredWithdrawal(bool enabled) {
+    triggeredWithdrawal = enabled;
+}
+
+void RoutingTableService::setMultipath(bool enabled) {
+    multipath = enabled;
+}
+
+void RoutingTableService::setReactiveRoutes(bool enabled) {
+    reactiveRoutes = enabled;
+}
+
+void RoutingTableService::setCompactAdvertisement(bool enabled) {
+    compactAdvertisement = enabled;
+}
+
+void RoutingTableService::setDeltaAdvertisement(bool enabled) {
+    deltaAdvertisement = enabled;
+    fullAdvertisementPending = true;
+}
+
 void RoutingTableService::resetTimeoutRoutingNode(RouteNode* node) {
-    node->timeout = millis() + DEFAULT_TIMEOUT * 1000;
+    uint32_t timeout = triggeredWithdrawal && node->networkNode.metric == 1 ? LM_NEIGHBOR_TIMEOUT : DEFAULT_TIMEOUT;
+    node->timeout = millis() + timeout * 1000;
+    routeTimers->arm(&node->timer, node->timeout);
 }
 
 void RoutingTableService::aMessageHasBeenReceivedBy(uint16_t address) {
@@ -332,28 +1359,36 @@ void RoutingTableService::aMessageHasBeenReceivedBy(uint16_t address) {
     resetTimeoutRoutingNode(rNode);
 }
 
-void RoutingTableService::printRoutingTable() {
-    ESP_LOGI(LM_TAG, "Current routing table:");
+void RoutingTableService::neighborHeard(uint16_t address, int16_t rssi, int8_t snr) {
+    NeighborTableService::setInUse();
+    NeighborEntry* entry = NeighborTableService::getOrCreate(address);
+    entry->updateSignal(rssi, snr);
+    entry->lastHeard = millis();
+    entry->missedHellos = 0;
+    NeighborTableService::releaseInUse();
 
-    routingTableList->setInUse();
+    NeighborTableService::linkUpdated(address);
 
-    if (routingTableList->moveToStart()) {
-        size_t position = 0;
+    // A route through other nodes is not refreshed by hearing the node
+    RouteNode* rNode = findNode(address);
+    if (rNode != nullptr && rNode->via == address)
+        resetTimeoutRoutingNode(rNode);
+}
 
-        do {
-            RouteNode* node = routingTableList->getCurrent();
+void RoutingTableService::printRoutingTable() {
+    ESP_LOGI(LM_TAG, "Current routing table:");
 
-            ESP_LOGI(LM_TAG, "%d - %X via %X metric %d Role %d", position,
-                node->networkNode.address,
-                node->via,
-                node->networkNode.metric,
-                node->networkNode.role);
+    RoutingTableView view;
 
-            position++;
-        } while (routingTableList->next());
-    }
+    for (size_t position = 0; position < view.size(); position++) {
+        const RoutingTableSnapshot::Entry& entry = view[position];
 
-    routingTableList->releaseInUse();
+        ESP_LOGI(LM_TAG, "%d - %X via %X metric %d Role %d", position,
+            entry.networkNode.address,
+            entry.via,
+            entry.networkNode.metric,
+            entry.networkNode.role);
+    }
 }
 
 void RoutingTableService::manageTimeoutRoutingTable() {
@@ -361,54 +1396,160 @@ void RoutingTableService::manageTimeoutRoutingTable() {
 
     routingTableList->setInUse();
 
-    if (routingTableList->moveToStart()) {
-        do {
-            RouteNode* node = routingTableList->getCurrent();
-
-            if (node->timeout < millis()) {
-                ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
+    routeTimers->expire(millis(), [](LM_Timer* timer) {
+        RouteNode* node = static_cast<RouteNode*>(timer->context);
 
-                delete node;
-                routingTableList->DeleteCurrent();
-            }
+        ESP_LOGW(LM_TAG, "Route timeout %X via %X", node->networkNode.address, node->via);
 
-        } while (routingTableList->next());
-    }
+        if (routingTableList->Search(node))
+            deleteCurrentNode();
+    });
 
     routingTableList->releaseInUse();
 
+    publishSnapshot();
+
     printRoutingTable();
 }
 
 uint8_t RoutingTableService::calculateMaximumMetricOfRoutingTable() {
-    routingTableList->setInUse();
+    routingTableList->setInUseShared();
 
     uint8_t maximumMetricOfRoutingTable = 0;
 
-    if (routingTableList->moveToStart()) {
-        do {
-            RouteNode* node = routingTableList->getCurrent();
-
-            if (node->networkNode.metric > maximumMetricOfRoutingTable)
-                maximumMetricOfRoutingTable = node->networkNode.metric;
-
-        } while (routingTableList->next());
+    for (RouteNode* node : *routingTableList) {
+        if (node->networkNode.metric > maximumMetricOfRoutingTable)
+            maximumMetricOfRoutingTable = node->networkNode.metric;
     }
 
-    routingTableList->releaseInUse();
+    routingTableList->releaseInUseShared();
 
     return maximumMetricOfRoutingTable + 1;
 }
 
-LM_LinkedList<RouteNode>* RoutingTableService::routingTableList = new LM_LinkedList<RouteNode>();
-CostCalculationCallback RoutingTableService::costCallback = nullptr;
+LM_IntrusiveList<RouteNode>* RoutingTableService::routingTableList = new LM_IntrusiveList<RouteNode>();
+LM_AddressIndex<RouteNode, RT_INDEX_BITS>* RoutingTableService::routingTableIndex = new LM_AddressIndex<RouteNode, RT_INDEX_BITS>();
+LM_TimerWheel* RoutingTableService::routeTimers = new LM_TimerWheel();
 HelloReceivedCallback RoutingTableService::helloCallback = nullptr;
+TopologyChangedCallback RoutingTableService::topologyCallback = nullptr;
+RoutingTableService::FlowCandidate RoutingTableService::flowCandidates[LM_FLOW_MAX_CANDIDATES] = {};
+size_t RoutingTableService::flowCandidatesLength = 0;
+uint8_t RoutingTableService::flowCandidatesRole = 0;
+uint32_t RoutingTableService::flowCandidatesVersion = 0;
+uint32_t RoutingTableService::flowCandidatesEpoch = 0;
+bool RoutingTableService::flowCandidatesValid = false;
+portMUX_TYPE RoutingTableService::flowCandidatesMux = portMUX_INITIALIZER_UNLOCKED;
+RoutingTableService::RoleRoute RoutingTableService::roleRoutes[LM_ROLE_ROUTE_CACHE_SIZE] = {};
+size_t RoutingTableService::roleRoutesLength = 0;
+size_t RoutingTableService::roleRoutesNext = 0;
+size_t RoutingTableService::linkSnrNext = 0;
+portMUX_TYPE RoutingTableService::roleRoutesMux = portMUX_INITIALIZER_UNLOCKED;
+bool RoutingTableService::multipath = false;
+bool RoutingTableService::reactiveRoutes = false;
+uint16_t RoutingTableService::clusterMask = 0;
+uint32_t RoutingTableService::failoverCount = 0;
+
+uint32_t RoutingTableService::missedAdvertisementCount = 0;
+uint16_t RoutingTableService::roleChanges[LM_DIRTY_ROUTES] = {};
+size_t RoutingTableService::roleChangesLength = 0;
+bool RoutingTableService::roleChangesOverflow = false;
+uint16_t RoutingTableService::dirtyRoutes[LM_DIRTY_ROUTES] = {};
+size_t RoutingTableService::dirtyRoutesLength = 0;
+bool RoutingTableService::dirtyRoutesOverflow = false;
+uint32_t RoutingTableService::topologyChangeCount = 0;
+uint32_t RoutingTableService::notifiedTopologyChangeCount = 0;
+portMUX_TYPE RoutingTableService::dirtyRoutesMux = portMUX_INITIALIZER_UNLOCKED;
+bool RoutingTableService::deltaAdvertisement = false;
+bool RoutingTableService::triggeredWithdrawal = false;
+bool RoutingTableService::compactAdvertisement = false;
+uint8_t RoutingTableService::tableVersion = 0;
+bool RoutingTableService::fullAdvertisementPending = true;
+bool RoutingTableService::fullAdvertisementRequested = false;
+uint32_t RoutingTableService::lastFullAdvertisement = 0;
+RoutingTableService::WithdrawnRoute RoutingTableService::withdrawnRoutes[LM_MAX_WITHDRAWN_ROUTES] = {};
+uint8_t RoutingTableService::withdrawnRoutesIndex = 0;
+RoutingTableSnapshot* RoutingTableService::currentSnapshot = new RoutingTableSnapshot(0);
+RoutingTableSnapshot* RoutingTableService::spareSnapshot = nullptr;
+bool RoutingTableService::snapshotChanged = false;
+uint32_t RoutingTableService::changeCount = 0;
+uint32_t RoutingTableService::snapshotVersion = 0;
+portMUX_TYPE RoutingTableService::snapshotMux = portMUX_INITIALIZER_UNLOCKED;
+RoutingTableService::RouteCostEntry RoutingTableService::routeCostCache[LM_ROUTE_COST_CACHE_SIZE] = {};
+uint32_t RoutingTableService::routeCostEpoch = 0;
+portMUX_TYPE RoutingTableService::routeCostMux = portMUX_INITIALIZER_UNLOCKED;
+
+uint8_t RoutingTableService::routeHysteresis = LM_ROUTE_HYSTERESIS;
+uint8_t RoutingTableService::longerRouteHysteresis = LM_LONGER_ROUTE_HYSTERESIS;
+
+bool RoutingTableService::isCostRouting() {
+    return RoutingMetricPolicy::COST_ROUTING;
+}
 
-void RoutingTableService::setCostCalculationCallback(CostCalculationCallback callback) {
-    costCallback = callback;
-    if (callback != nullptr) {
-        ESP_LOGI(LM_TAG, "Cost-based routing enabled");
+void RoutingTableService::setRouteHysteresis(uint8_t better, uint8_t longer) {
+    routeHysteresis = better < 100 ? better : 99;
+    longerRouteHysteresis = longer < 100 ? longer : 99;
+}
+
+size_t RoutingTableService::getRouteCostSlot(uint8_t metric, uint16_t via, uint16_t address) {
+    uint32_t hash = ((uint32_t) via * 31 + address) * 31 + metric;
+    return (hash ^ (hash >> 7)) & (LM_ROUTE_COST_CACHE_SIZE - 1);
+}
+
+RouteCost RoutingTableService::getRouteCost(uint8_t metric, uint16_t via, uint16_t address) {
+    if (!RoutingMetricPolicy::COST_ROUTING)
+        return RoutingMetricPolicy::getCost(metric, via, address);
+
+    RouteCostEntry& entry = routeCostCache[getRouteCostSlot(metric, via, address)];
+
+    portENTER_CRITICAL(&routeCostMux);
+    bool hit = entry.valid && entry.via == via && entry.address == address && entry.metric == metric;
+    RouteCost cost = entry.cost;
+    uint32_t epoch = routeCostEpoch;
+    portEXIT_CRITICAL(&routeCostMux);
+
+    if (hit)
+        return cost;
+
+    // The metric can use the routing table, it is called without the lock
+    cost = RoutingMetricPolicy::getCost(metric, via, address);
+
+    portENTER_CRITICAL(&routeCostMux);
+    if (epoch == routeCostEpoch) {
+        entry.via = via;
+        entry.address = address;
+        entry.metric = metric;
+        entry.cost = cost;
+        entry.valid = true;
+    }
+    portEXIT_CRITICAL(&routeCostMux);
+
+    return cost;
+}
+
+void RoutingTableService::invalidateLinkCost(uint16_t neighbor) {
+    // The distance vector costs do not use the links
+    if (!RoutingMetricPolicy::COST_ROUTING)
+        return;
+
+    portENTER_CRITICAL(&routeCostMux);
+    for (size_t i = 0; i < LM_ROUTE_COST_CACHE_SIZE; i++) {
+        if (routeCostCache[i].via == neighbor)
+            routeCostCache[i].valid = false;
     }
+    routeCostEpoch++;
+    portEXIT_CRITICAL(&routeCostMux);
+}
+
+void RoutingTableService::invalidateRouteCosts() {
+    // The memoised costs only change with their own route or link
+    if (!RoutingMetricPolicy::TABLE_DEPENDENT_COSTS)
+        return;
+
+    portENTER_CRITICAL(&routeCostMux);
+    for (size_t i = 0; i < LM_ROUTE_COST_CACHE_SIZE; i++)
+        routeCostCache[i].valid = false;
+    routeCostEpoch++;
+    portEXIT_CRITICAL(&routeCostMux);
 }
 
 void RoutingTableService::setHelloReceivedCallback(HelloReceivedCallback callback) {
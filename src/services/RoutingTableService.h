@@ -3,9 +3,16 @@
 
 #include "utilities/LinkedQueue.hpp"
 
+#include "utilities/IntrusiveList.hpp"
+
+#include "utilities/AddressIndex.hpp"
+
+#include "utilities/TimerWheel.hpp"
+
 #include "entities/routingTable/RouteNode.h"
 
 #include "entities/routingTable/NetworkNode.h"
+#include "entities/routingTable/RoutingTableSnapshot.h"
 
 #include "entities/packets/RoutePacket.h"
 
@@ -19,29 +26,40 @@
  * @brief Routing Table Service
  *
  */
-// Cost calculation callback type
-// Parameters: hops, nextHop, destAddr
-// Returns: cost value (lower is better)
-typedef float (*CostCalculationCallback)(uint8_t, uint16_t, uint16_t);
+// Fixed point route cost, LM_COST_SCALE is 1.0, lower is better. See RoutingMetric.h
+typedef int32_t RouteCost;
 
 // HELLO reception callback type (for Trickle suppression)
 // Parameters: srcAddr (address of node that sent HELLO)
 typedef void (*HelloReceivedCallback)(uint16_t);
 
+// Topology change callback type, a route has been added, removed or has changed its next hop.
+// Called without the routing table locked, after the change is published in the snapshot
+typedef void (*TopologyChangedCallback)();
+
 class RoutingTableService {
 public:
 
 	/**
-	 * @brief Routing table List
+	 * @brief Routing table List. The lookups take it shared with setInUseShared and iterate it with its iterators,
+	 * the modifications take it with setInUse
+	 *
+	 */
+	static LM_IntrusiveList<RouteNode>* routingTableList;
+
+	/**
+	 * @brief Hash index of the routing table by address, guarded by the routingTableList lock, find can be used with it shared.
+	 * Every node added or removed from the routingTableList must be added or removed from here.
 	 *
 	 */
-	static LM_LinkedList<RouteNode>* routingTableList;
+	static LM_AddressIndex<RouteNode, RT_INDEX_BITS>* routingTableIndex;
 
 	/**
-	 * @brief Cost calculation callback (optional)
-	 * If set, routing decisions use cost instead of hop-count
+	 * @brief Timers of the route timeouts, every route of the routing table has its timer armed.
+	 * The timers are expired with the routingTableList mutex taken.
+	 *
 	 */
-	static CostCalculationCallback costCallback;
+	static LM_TimerWheel* routeTimers;
 
 	/**
 	 * @brief HELLO reception callback (optional)
@@ -49,6 +67,12 @@ public:
 	 */
 	static HelloReceivedCallback helloCallback;
 
+	/**
+	 * @brief Topology change callback (optional)
+	 *
+	 */
+	static TopologyChangedCallback topologyCallback;
+
 	/**
 	 * @brief Prints the actual routing table in the log
 	 *
@@ -56,11 +80,196 @@ public:
 	static void printRoutingTable();
 
 	/**
-	 * @brief Get the All Network Nodes that are inside the routing table
+	 * @brief Get the All Network Nodes that are inside the routing table.
+	 * It allocates a copy of the latest snapshot, use a RoutingTableView to avoid it.
 	 *
+	 * @param numOfNodes Output number of nodes of the list, the size of the snapshot copied
 	 * @return NetworkNode* All the nodes in a list.
 	 */
-	static NetworkNode* getAllNetworkNodes();
+	static NetworkNode* getAllNetworkNodes(size_t& numOfNodes);
+
+	/**
+	 * @brief Get a reference to the latest routing table snapshot, it never blocks the routing table.
+	 * It must be released with releaseSnapshot, see RoutingTableView.
+	 *
+	 * @return RoutingTableSnapshot* Latest snapshot, never nullptr
+	 */
+	static RoutingTableSnapshot* acquireSnapshot();
+
+	/**
+	 * @brief Release a reference given by acquireSnapshot
+	 *
+	 * @param snapshot Snapshot to be released
+	 */
+	static void releaseSnapshot(RoutingTableSnapshot* snapshot);
+
+	/**
+	 * @brief Publish a new snapshot if the routing table has changed since the last one.
+	 * It must be called without the routingTableList in use, after modifying it with deleteCurrentNode.
+	 *
+	 */
+	static void publishSnapshot();
+
+	/**
+	 * @brief Number of changes of the routing table, a route added, removed or updated increments it
+	 *
+	 * @return uint32_t Counter, compare it before and after processing a packet
+	 */
+	static uint32_t getChangeCount() { return changeCount; }
+
+	/**
+	 * @brief Number of topology changes, a route added, removed or with a new next hop increments it
+	 *
+	 * @return uint32_t Counter
+	 */
+	static uint32_t getTopologyChangeCount();
+
+	/**
+	 * @brief Set the callback called when the topology changes, see TopologyChangedCallback
+	 *
+	 * @param callback Function to call, nullptr to remove it
+	 */
+	static void setTopologyChangedCallback(TopologyChangedCallback callback);
+
+	/**
+	 * @brief Take the destinations whose route changed since the previous call, to re-evaluate only them.
+	 * A route added, removed, with a new next hop, metric, role or gateway load, or through a link marked by markLinkDirty.
+	 * A destination not found in the routing table has been removed
+	 *
+	 * @param addresses Output destinations, at least LM_DIRTY_ROUTES long
+	 * @param all Output true if more than LM_DIRTY_ROUTES changed, then all the routes must be re-evaluated
+	 * @return size_t Number of destinations
+	 */
+	static size_t takeDirtyRoutes(uint16_t* addresses, bool& all);
+
+	/**
+	 * @brief Mark as dirty all the routes through a neighbor, its link metrics have changed
+	 *
+	 * @param neighbor Address of the neighbor
+	 */
+	static void markLinkDirty(uint16_t neighbor);
+
+	/**
+	 * @brief Get the network nodes of the next routing advertisement and increment the table version.
+	 * It is a full advertisement with all the nodes, or when the delta advertisements are enabled,
+	 * only the nodes changed since the previous advertisement. Full advertisements are sent every
+	 * LM_FULL_HELLO_INTERVAL s, when a new neighbor is found and when a neighbor requests it.
+	 * A triggered advertisement is always a delta advertisement, to send the withdrawn routes at once.
+	 *
+	 * @param numOfNodes Output number of nodes, if greater than 0 the nodes must be deleted with delete[]
+	 * @param routeFlags Output route flags of the advertisement
+	 * @param version Output table version of the advertisement
+	 * @param triggered If it is a triggered advertisement, see hasPendingWithdrawals
+	 * @return NetworkNode* Nodes to be advertised or nullptr if there are no nodes
+	 */
+	static NetworkNode* getNextAdvertisement(size_t& numOfNodes, uint8_t& routeFlags, uint8_t& version, bool triggered = false);
+
+	/**
+	 * @brief If there are removed routes not advertised yet
+	 *
+	 */
+	static bool hasPendingWithdrawals();
+
+	/**
+	 * @brief Enable or disable the triggered withdrawals. When enabled the routes of the neighbors expire after
+	 * LM_NEIGHBOR_TIMEOUT s instead of DEFAULT_TIMEOUT s
+	 *
+	 * @param enabled If true the neighbors are lost after LM_NEIGHBOR_TIMEOUT s
+	 */
+	static void setTriggeredWithdrawal(bool enabled);
+
+	/**
+	 * @brief Enable or disable the alternate next hops of the routes, see LoraMesherConfig::multipath
+	 *
+	 * @param enabled If true the routes keep up to LM_ROUTE_ALTERNATES alternate next hops
+	 */
+	static void setMultipath(bool enabled);
+
+	/**
+	 * @brief Enable or disable the reactive routes, see LoraMesherConfig::reactiveRoutes
+	 *
+	 * @param enabled If true the advertisements carry the neighbors and the nodes with a role only
+	 */
+	static void setReactiveRoutes(bool enabled);
+
+	/**
+	 * @brief Set the length of the cluster prefix of the addresses, see LoraMesherConfig::clusterPrefixLength
+	 *
+	 * @param length Bits of the prefix, 0 without clusters, up to 8
+	 */
+	static void setClusterPrefixLength(uint8_t length);
+
+	/**
+	 * @brief Get the address of the cluster of an address, the address with the bits after the cluster prefix 0.
+	 * Without clusters, or for the addresses from LM_MULTICAST_ADDRESS, the address itself
+	 *
+	 * @param address Address
+	 * @return uint16_t Address of the cluster
+	 */
+	static uint16_t getClusterAddress(uint16_t address);
+
+	/**
+	 * @brief Get the route to an address, or to its cluster when it is in another cluster
+	 *
+	 * @param address Address of the destination
+	 * @return RouteNode* pointer to the RouteNode or nullptr
+	 */
+	static RouteNode* findRoute(uint16_t address);
+
+	/**
+	 * @brief Move the routes through a failed neighbor to their best alternate next hop, and forget the alternates
+	 * through it. Nothing without multipath
+	 *
+	 * @param neighbor Address of the failed neighbor
+	 * @return size_t Number of routes moved
+	 */
+	static size_t failoverNeighbor(uint16_t neighbor);
+
+	/**
+	 * @brief Move a route to its best alternate next hop, used when the route times out. The routing table must be in use
+	 *
+	 * @param node Route
+	 * @return true If it has been moved, false without multipath or without an alternate heard in the last DEFAULT_TIMEOUT s
+	 */
+	static bool moveToAlternate(RouteNode* node);
+
+	/**
+	 * @brief Move the routes through a neighbor whose link changed to an alternate next hop cheaper by routeHysteresis %.
+	 * Only with multipath and a cost routing metric, it is called by NeighborTableService::linkUpdated
+	 *
+	 * @param neighbor Address of the neighbor
+	 * @return size_t Number of routes moved
+	 */
+	static size_t reevaluateAlternates(uint16_t neighbor);
+
+	/**
+	 * @brief Number of routes moved to an alternate next hop
+	 *
+	 * @return uint32_t Number of routes
+	 */
+	static uint32_t getFailoverCount() { return failoverCount; }
+
+	/**
+	 * @brief Number of advertisements of the neighbors detected as lost, by a gap in their table versions
+	 *
+	 * @return uint32_t
+	 */
+	static uint32_t getMissedAdvertisementCount() { return missedAdvertisementCount; }
+
+	/**
+	 * @brief Enable or disable the delta advertisements
+	 *
+	 * @param enabled If true only the changed nodes are advertised between full advertisements
+	 */
+	static void setDeltaAdvertisement(bool enabled);
+
+	/**
+	 * @brief Enable or disable the compact encoding of the advertisements.
+	 * When enabled the nodes of the advertisements are sorted by address and flagged with ROUTE_COMPACT_F
+	 *
+	 * @param enabled If true the advertisements use the LM_CompactNodeCodec
+	 */
+	static void setCompactAdvertisement(bool enabled);
 
 	/**
 	 * @brief Find the node that contains the address
@@ -71,13 +280,81 @@ public:
 	static RouteNode* findNode(uint16_t address);
 
 	/**
-	 * @brief Get the best node that contains a role, the nearest
+	 * @brief Remove and delete the node that contains the address
+	 *
+	 * @param address address to be removed
+	 * @return true If the node has been removed
+	 * @return false If the address is not inside the routing table
+	 */
+	static bool removeNode(uint16_t address);
+
+	/**
+	 * @brief Add a provisional route, restored after a reboot, see CheckpointService, or discovered, see RouteDiscoveryService.
+	 * It expires after timeout ms unless an advertisement or a packet of the neighbor refreshes it. A route to the address
+	 * through the same next hop is refreshed, a route through another one is kept. Call publishSnapshot after the last one
+	 *
+	 * @param node Network node of the route
+	 * @param via Next hop
+	 * @param timeout Timeout in ms
+	 * @return true If the route has been added or refreshed, false if the address has another route or the table is full
+	 */
+	static bool addProvisionalRoute(const NetworkNode& node, uint16_t via, uint32_t timeout);
+
+	/**
+	 * @brief Delete the current node of the routingTableList and remove it from the index.
+	 * The routingTableList must be in use by the caller.
+	 *
+	 */
+	static void deleteCurrentNode();
+
+	/**
+	 * @brief Get the best node that contains a role, the cheapest route. It is cached, see getRoleRoute
 	 *
 	 * @param role role to be found
 	 * @return RouteNode* pointer to the RouteNode or nullptr
 	 */
 	static RouteNode* getBestNodeByRole(uint8_t role);
 
+	/**
+	 * @brief Get the route to the best node that contains a role, the cheapest one of the latest snapshot.
+	 * It is cached for LM_ROLE_ROUTE_CACHE_SIZE roles and updated with the changed routes of every published snapshot,
+	 * so the packets to a role address do not scan the routing table. Only a change of the route costs, or a best node
+	 * that gets worse or loses the role, scans it again.
+	 *
+	 * @param role Role to be found
+	 * @param address Address of the best node
+	 * @param via Next hop to the best node
+	 * @return true If there is a node with the role
+	 */
+	static bool getRoleRoute(uint8_t role, uint16_t& address, uint16_t& via);
+
+	/**
+	 * @brief Get the next hops with nodes of a role behind them, from the latest snapshot. A multicast packet to the role
+	 * is sent once to every next hop
+	 *
+	 * @param role Role of the multicast group
+	 * @param exclude Address not reached through, for example the source of the packet. 0 for none
+	 * @param maxHops Only the nodes up to maxHops hops away are reached
+	 * @param nextHops Output next hops, LM_MULTICAST_MAX_BRANCHES at most
+	 * @param hopsLeft Output hops from every next hop to its farthest node of the role, at most maxHops - 1
+	 * @return size_t Number of next hops
+	 */
+	static size_t getMulticastNextHops(uint8_t role, uint16_t exclude, uint8_t maxHops, uint16_t* nextHops, uint8_t* hopsLeft);
+
+	/**
+	 * @brief Get the node with the role assigned to a flow by weighted rendezvous hashing, to spread the flows of
+	 * different keys over the nodes with the role. The weight of a node is the inverse of the cost of its route,
+	 * reduced by its advertised gateway load. A flow keeps its node while the weights do not change, and when they
+	 * change only part of the flows move.
+	 * The candidates and their weights are cached until the routing table or the route costs change, so a call
+	 * does not scan the routing table.
+	 *
+	 * @param flowKey Key of the flow, for example the source address
+	 * @param role Role to be found
+	 * @return RouteNode* pointer to the RouteNode or nullptr
+	 */
+	static RouteNode* getNodeByRoleForFlow(uint16_t flowKey, uint8_t role = ROLE_GATEWAY);
+
 	/**
 	 * @brief Returns if address is inside the routing table
 	 *
@@ -88,13 +365,30 @@ public:
 	static bool hasAddressRoutingTable(uint16_t address);
 
 	/**
-	 * @brief Get the Next Hop address
+	 * @brief Get the Next Hop address. For a role address, the next hop to the best node with the role
 	 *
 	 * @param dst address of the next hop
 	 * @return uint16_t address of the next hop
 	 */
 	static uint16_t getNextHop(uint16_t dst);
 
+	/**
+	 * @brief Get the next hop from the latest snapshot, without taking the routing table mutex
+	 *
+	 * @param dst Destination
+	 * @return uint16_t Next hop or 0 if not found
+	 */
+	static uint16_t getSnapshotNextHop(uint16_t dst);
+
+	/**
+	 * @brief Get the route to an address from the latest snapshot, without taking the routing table mutex
+	 *
+	 * @param address Address of the route
+	 * @param route Route found
+	 * @return true If the address is in the snapshot
+	 */
+	static bool getSnapshotRoute(uint16_t address, RoutingTableSnapshot::Entry& route);
+
 	/**
 	 * @brief Get the Number Of Hops of the address inside the routing table
 	 *
@@ -132,6 +426,15 @@ public:
 	 */
 	static void resetReceiveSNRRoutePacket(uint16_t src, int8_t receivedSNR);
 
+	/**
+	 * @brief Get the lowest SNR of the route packets received from a neighbour
+	 *
+	 * @param address Address of the neighbour
+	 * @param snr Output lowest SNR in dB of the history
+	 * @return true If the node is a neighbour with SNR history
+	 */
+	static bool getNeighborMinSNR(uint16_t address, int8_t& snr);
+
 	/**
 	 * @brief Reset the SNR from the Route Node Sent
 	 *
@@ -140,6 +443,30 @@ public:
 	 */
 	static void resetSentSNRRoutePacket(uint16_t src, int8_t sentSNR);
 
+	/**
+	 * @brief Get the SNR at which a neighbour receives the route packets of this node, reported in its LinkSnrTrailer
+	 *
+	 * @param address Address of the neighbour
+	 * @param snr Output SNR in dB
+	 * @return true If the node is a neighbour that has reported it
+	 */
+	static bool getNeighborSentSNR(uint16_t address, int8_t& snr);
+
+	/**
+	 * @brief Fill a LinkSnrTrailer with the lowest SNR of the neighbours, LM_LINK_SNR_REPORTS of them in turns
+	 *
+	 * @param trailer Trailer of a HELLO
+	 */
+	static void fillLinkSnr(LinkSnrTrailer* trailer);
+
+	/**
+	 * @brief Keep the SNR reported for this node in the LinkSnrTrailer of a neighbour
+	 *
+	 * @param src Source of the HELLO
+	 * @param trailer Its trailer
+	 */
+	static void processLinkSnr(uint16_t src, LinkSnrTrailer* trailer);
+
 	/**
 	 * @brief Checks all the routing entries for a route timeout and remove the entry.
 	 *
@@ -153,10 +480,52 @@ public:
 	static void aMessageHasBeenReceivedBy(uint16_t address);
 
 	/**
-	 * @brief Set cost calculation callback for Protocol 3
-	 * @param callback Function pointer to cost calculation
+	 * @brief A frame transmitted by the address has been received, whoever it was for. It feeds the signal of the
+	 * frame to the NeighborTableService entry of the address and restarts the timeout of the route to it if it is a neighbor
+	 *
+	 * @param address Address of the transmitter
+	 * @param rssi RSSI of the frame in dBm
+	 * @param snr SNR of the frame in dB
+	 */
+	static void neighborHeard(uint16_t address, int16_t rssi, int8_t snr);
+
+	/**
+	 * @brief If the routes are selected by the cost of the LM_ROUTING_METRIC instead of the hops
+	 *
+	 */
+	static bool isCostRouting();
+
+	/**
+	 * @brief Set the hysteresis of the cost routing
+	 *
+	 * @param better A route must be this % cheaper than the current route to replace it
+	 * @param longer A route with more hops must be this % cheaper than the current route to replace it
+	 */
+	static void setRouteHysteresis(uint8_t better, uint8_t longer);
+
+	/**
+	 * @brief Cost of a route given by the LM_ROUTING_METRIC, memoised by (via, address, metric) when it is a cost routing metric
+	 *
+	 * @param metric Hops of the route
+	 * @param via Next hop of the route
+	 * @param address Destination of the route
+	 * @return RouteCost Cost of the route, LM_COST_SCALE is 1.0, lower is better
+	 */
+	static RouteCost getRouteCost(uint8_t metric, uint16_t via, uint16_t address);
+
+	/**
+	 * @brief Invalidate the memoised costs of the routes through a neighbor.
+	 * Call it every time the NeighborTableService entry of the neighbor changes
+	 *
+	 * @param neighbor Address of the neighbor
 	 */
-	static void setCostCalculationCallback(CostCalculationCallback callback);
+	static void invalidateLinkCost(uint16_t neighbor);
+
+	/**
+	 * @brief Invalidate all the memoised route costs, when the routing metric has TABLE_DEPENDENT_COSTS
+	 *
+	 */
+	static void invalidateRouteCosts();
 
 	/**
 	 * @brief Set callback for HELLO packet reception notification
@@ -169,6 +538,351 @@ public:
 
 private:
 
+	/**
+	 * @brief Removed route, to be advertised in the delta advertisement of its version
+	 *
+	 */
+	struct WithdrawnRoute {
+		uint16_t address;
+		uint8_t version;
+	};
+
+	static bool deltaAdvertisement;
+
+	static bool compactAdvertisement;
+
+	static bool triggeredWithdrawal;
+
+	/**
+	 * @brief Version of the next advertisement. The changed nodes are marked with it
+	 *
+	 */
+	static uint8_t tableVersion;
+
+	/**
+	 * @brief The next advertisement must be a full advertisement
+	 *
+	 */
+	static bool fullAdvertisementPending;
+
+	/**
+	 * @brief The next advertisement must request a full advertisement from the neighbors
+	 *
+	 */
+	static bool fullAdvertisementRequested;
+
+	static uint32_t lastFullAdvertisement;
+
+	static WithdrawnRoute withdrawnRoutes[LM_MAX_WITHDRAWN_ROUTES];
+
+	static uint8_t withdrawnRoutesIndex;
+
+	/**
+	 * @brief Memoised route cost
+	 *
+	 */
+	struct RouteCostEntry {
+		uint16_t via;
+		uint16_t address;
+		uint8_t metric;
+		bool valid;
+		RouteCost cost;
+	};
+
+	static RouteCostEntry routeCostCache[LM_ROUTE_COST_CACHE_SIZE];
+
+	/**
+	 * @brief Incremented by every invalidation, a cost calculated meanwhile is not stored
+	 *
+	 */
+	static uint32_t routeCostEpoch;
+
+	static portMUX_TYPE routeCostMux;
+
+	static size_t getRouteCostSlot(uint8_t metric, uint16_t via, uint16_t address);
+
+	/**
+	 * @brief Candidate of getNodeByRoleForFlow
+	 *
+	 */
+	struct FlowCandidate {
+		uint16_t address;
+		float weight;
+	};
+
+	static FlowCandidate flowCandidates[LM_FLOW_MAX_CANDIDATES];
+
+	static size_t flowCandidatesLength;
+
+	/**
+	 * @brief Role, snapshot version and route cost epoch of the flowCandidates
+	 *
+	 */
+	static uint8_t flowCandidatesRole;
+	static uint32_t flowCandidatesVersion;
+	static uint32_t flowCandidatesEpoch;
+	static bool flowCandidatesValid;
+
+	static portMUX_TYPE flowCandidatesMux;
+
+	/**
+	 * @brief Calculate the flowCandidates of a role if they are not up to date
+	 *
+	 */
+	static void updateFlowCandidates(uint8_t role);
+
+	/**
+	 * @brief Best node of a role, see getRoleRoute
+	 *
+	 */
+	struct RoleRoute {
+		uint8_t role;
+		bool found;
+		uint16_t address;
+		uint16_t via;
+		// Snapshot version and route cost epoch of the route
+		uint32_t version;
+		uint32_t epoch;
+		RouteCost cost;
+	};
+
+	static RoleRoute roleRoutes[LM_ROLE_ROUTE_CACHE_SIZE];
+
+	/**
+	 * @brief Alternate next hops of the routes enabled, see setMultipath
+	 *
+	 */
+	static bool multipath;
+
+	/**
+	 * @brief Reactive routes enabled, see setReactiveRoutes
+	 *
+	 */
+	static bool reactiveRoutes;
+
+	/**
+	 * @brief Bits of the cluster prefix of the addresses, 0 without clusters
+	 *
+	 */
+	static uint16_t clusterMask;
+
+	/**
+	 * @brief Aggregate an advertised route to a node of another cluster into the route to its cluster.
+	 * The nodes with a role keep their own route
+	 *
+	 * @param node Advertised route
+	 * @param delta If it comes from a delta advertisement
+	 * @return true If the route has to be processed, false for the own cluster or an aggregated withdrawal
+	 */
+	static bool aggregateClusterRoute(NetworkNode* node, bool delta);
+
+	/**
+	 * @brief If an address is a node or the address of a cluster other than the own cluster
+	 *
+	 */
+	static bool isOtherCluster(uint16_t address);
+
+	static uint32_t failoverCount;
+
+	static uint32_t missedAdvertisementCount;
+
+	/**
+	 * @brief Record the route to an address advertised by a neighbor as an alternate next hop, if it is loop free:
+	 * its metric is not higher than the one of the route. Its own next hop is removed from the alternates
+	 *
+	 * @param address Destination
+	 * @param via Neighbor that advertised the route
+	 * @param metric Metric of the route through the neighbor
+	 */
+	static void updateAlternates(uint16_t address, uint16_t via, uint8_t metric);
+
+	/**
+	 * @brief Add or refresh an alternate next hop of a route, or remove it if it is not loop free. The routing table must be in use
+	 *
+	 */
+	static void updateAlternate(RouteNode* node, uint16_t via, uint8_t metric);
+
+	static void removeAlternate(RouteNode* node, size_t index);
+
+	/**
+	 * @brief Best alternate next hop heard in the last DEFAULT_TIMEOUT s, the lowest metric and the latest heard
+	 *
+	 * @return int Index in the alternates or -1 if there is none
+	 */
+	static int getBestAlternate(RouteNode* node);
+
+	/**
+	 * @brief Make an alternate next hop the next hop of the route. The routing table must be in use
+	 *
+	 * @param node Route
+	 * @param index Index of the alternate
+	 * @param keepPrevious Keep the previous next hop as an alternate, false when it has failed
+	 */
+	static void switchToAlternate(RouteNode* node, size_t index, bool keepPrevious);
+
+	static size_t roleRoutesLength;
+
+	// Next entry replaced when the cache is full
+	static size_t roleRoutesNext;
+
+	// First neighbour reported in the next LinkSnrTrailer
+	static size_t linkSnrNext;
+
+	static portMUX_TYPE roleRoutesMux;
+
+	/**
+	 * @brief Routes changed or removed since the last published snapshot, guarded by the roleRoutesMux
+	 *
+	 */
+	static uint16_t roleChanges[LM_DIRTY_ROUTES];
+
+	static size_t roleChangesLength;
+
+	// More routes changed than the roleChanges can hold
+	static bool roleChangesOverflow;
+
+	/**
+	 * @brief Record a changed or removed route to be applied to the roleRoutes
+	 *
+	 * @param address Address of the route
+	 */
+	static void markRoleChange(uint16_t address);
+
+	/**
+	 * @brief Move the roleRoutes of the previous snapshot to a new one, evaluating only the changed routes.
+	 * The roles whose best node got worse or lost the role are left to be scanned again by getRoleRoute
+	 *
+	 * @param snapshot New snapshot, with a reference held by the caller
+	 * @param changes Routes changed since the previous snapshot
+	 * @param length Number of changes
+	 */
+	static void updateRoleRoutes(RoutingTableSnapshot* snapshot, const uint16_t* changes, size_t length);
+
+	static uint8_t routeHysteresis;
+
+	static uint8_t longerRouteHysteresis;
+
+	/**
+	 * @brief If the cost of a new route is cheaper than the current cost by more than the hysteresis
+	 *
+	 * @param newCost Cost of the new route
+	 * @param currentCost Cost of the current route
+	 * @param hysteresis Hysteresis in %
+	 */
+	static bool isCheaper(RouteCost newCost, RouteCost currentCost, uint8_t hysteresis) {
+		return (int64_t) newCost * 100 < (int64_t) currentCost * (100 - hysteresis);
+	}
+
+	/**
+	 * @brief Improvement in % of the new cost over the current cost
+	 *
+	 */
+	static int32_t getImprovement(RouteCost newCost, RouteCost currentCost) {
+		return currentCost == 0 ? 0 : (int32_t) ((int64_t) (currentCost - newCost) * 100 / currentCost);
+	}
+
+	/**
+	 * @brief Mark the node as changed, it will be inside the next delta advertisement
+	 *
+	 * @param node Route node changed
+	 */
+	static void markChanged(RouteNode* node);
+
+	static uint16_t dirtyRoutes[LM_DIRTY_ROUTES];
+
+	static size_t dirtyRoutesLength;
+
+	/**
+	 * @brief More destinations than LM_DIRTY_ROUTES changed since the last takeDirtyRoutes
+	 *
+	 */
+	static bool dirtyRoutesOverflow;
+
+	static uint32_t topologyChangeCount;
+
+	/**
+	 * @brief topologyChangeCount of the last topologyCallback
+	 *
+	 */
+	static uint32_t notifiedTopologyChangeCount;
+
+	/**
+	 * @brief Guards the dirty routes and the topology counters, they are changed with and without the routing table in use
+	 *
+	 */
+	static portMUX_TYPE dirtyRoutesMux;
+
+	/**
+	 * @brief Add the destination to the dirty routes
+	 *
+	 * @param address Destination
+	 * @param topologyChanged If the route has been added, removed or has a new next hop
+	 */
+	static void markDirty(uint16_t address, bool topologyChanged);
+
+	/**
+	 * @brief Call the topologyCallback if the topology changed since the last call
+	 *
+	 */
+	static void notifyTopologyChanged();
+
+	/**
+	 * @brief Latest published snapshot, it holds one reference
+	 *
+	 */
+	static RoutingTableSnapshot* currentSnapshot;
+
+	/**
+	 * @brief Released snapshot kept to be reused by the next publish
+	 *
+	 */
+	static RoutingTableSnapshot* spareSnapshot;
+
+	/**
+	 * @brief The routing table has changed since the last published snapshot
+	 *
+	 */
+	static bool snapshotChanged;
+
+	/**
+	 * @brief Changes of the routing table, returned by getChangeCount
+	 *
+	 */
+	static uint32_t changeCount;
+
+	static uint32_t snapshotVersion;
+
+	/**
+	 * @brief Guards the references of the snapshots, the currentSnapshot and the spareSnapshot
+	 *
+	 */
+	static portMUX_TYPE snapshotMux;
+
+	/**
+	 * @brief Check the table version of an advertisement and count the lost advertisements of the neighbor.
+	 * If a delta advertisement follows a lost one a full advertisement is requested
+	 *
+	 * @param p Route packet
+	 */
+	static void checkAdvertisementVersion(RoutePacket* p);
+
+	/**
+	 * @brief Remove the route to the address if its next hop is the via
+	 *
+	 * @param via Address of the node that removed the route
+	 * @param address Address of the removed route
+	 */
+	static void withdrawRoute(uint16_t via, uint16_t address);
+
+	/**
+	 * @brief Process a node advertised by a neighbor
+	 *
+	 * @param via Address of the neighbor
+	 * @param node Advertised node, the metric is incremented
+	 * @param delta If it is inside a delta advertisement
+	 */
+	static void processAdvertisedNode(uint16_t via, NetworkNode* node, bool delta);
+
 	/**
 	 * @brief process the network node, adds the node in the routing table if can
 	 *
@@ -216,4 +930,38 @@ private:
 	static uint8_t calculateMaximumMetricOfRoutingTable();
 };
 
+/**
+ * @brief Read only view of the latest routing table snapshot. It holds a reference to the snapshot
+ * while it exists, so the routes do not change and the routing table can be updated meanwhile.
+ *
+ * Example:
+ *   RoutingTableView view;
+ *   for (size_t i = 0; i < view.size(); i++)
+ *       Serial.println(view[i].networkNode.address);
+ */
+class RoutingTableView {
+public:
+	RoutingTableView() : snapshot(RoutingTableService::acquireSnapshot()) {};
+
+	~RoutingTableView() {
+		RoutingTableService::releaseSnapshot(snapshot);
+	}
+
+	RoutingTableView(const RoutingTableView&) = delete;
+	RoutingTableView& operator=(const RoutingTableView&) = delete;
+
+	size_t size() const { return snapshot->size; }
+
+	uint32_t getVersion() const { return snapshot->version; }
+
+	const RoutingTableSnapshot::Entry& operator[](size_t index) const { return snapshot->entries[index]; }
+
+	const RoutingTableSnapshot::Entry* begin() const { return snapshot->entries; }
+
+	const RoutingTableSnapshot::Entry* end() const { return snapshot->entries + snapshot->size; }
+
+private:
+	RoutingTableSnapshot* snapshot;
+};
+
 #endif
\ No newline at end of file
@@ -1,51 +1,69 @@
 #include "SimulatorService.h"
 
+#include "PacketPoolService.h"
+
+#include "utilities/Crc16.hpp"
+
+static_assert(sizeof(LM_State) <= UINT8_MAX, "The length of the streamed states is one byte");
+
 SimulatorService::SimulatorService() {
 
 }
 
 SimulatorService::~SimulatorService() {
-    clearStates();
-    delete statesList;
+    stopStreaming();
+    PacketPoolService::release(states, MEMORY_SIMULATOR);
 }
 
 void SimulatorService::addState(size_t receivedQueueSize, size_t sentQueueSize, size_t receivedUserQueueSize, size_t routingTableSize, size_t q_WRPSize, size_t q_WSPSize, LM_StateType type, Packet<uint8_t>* packet) {
     if (!isSimulating) {
         return;
     }
-    uint32_t freeHeap = getFreeHeap();
 
-    if (freeHeap < 10000) {
-        ESP_LOGW(LM_TAG, "Not enough memory to simulate. Free heap: %d", (int)freeHeap);
-        return;
-    }
+    LM_State state;
+    state.timestamp = millis();
+    state.receivedQueueSize = receivedQueueSize;
+    state.sentQueueSize = sentQueueSize;
+    state.receivedUserQueueSize = receivedUserQueueSize;
+    state.routingTableSize = routingTableSize;
+    state.q_WRPSize = q_WRPSize;
+    state.q_WSPSize = q_WSPSize;
+    state.type = type;
+    state.freeMemoryAllocation = getFreeHeap();
 
-    LM_State* state = new LM_State();
-    state->id = numberStates++;
-    state->receivedQueueSize = receivedQueueSize;
-    state->sentQueueSize = sentQueueSize;
-    state->receivedUserQueueSize = receivedUserQueueSize;
-    state->routingTableSize = routingTableSize;
-    state->q_WRPSize = q_WRPSize;
-    state->q_WSPSize = q_WSPSize;
-    state->type = type;
-    state->secondsSinceStart = millis() / 1000;
-    state->freeMemoryAllocation = freeHeap;
-
-    if (packet == nullptr) {
-        state->packetHeader = ControlPacket();
-        statesList->Append(state);
-        return;
+    if (packet != nullptr)
+        PacketService::getPacketHeader(packet, &state.packetHeader);
+
+    portENTER_CRITICAL(&statesMux);
+
+    state.id = numberStates++;
+
+    // Overwrite the oldest state
+    if (writeIndex - readIndex == LM_SIMULATOR_RING_SLOTS) {
+        readIndex++;
+        overwrittenStates++;
     }
 
-    ControlPacket* ctrlPacket = PacketService::getPacketHeader(packet);
-    memcpy(&state->packetHeader, ctrlPacket, sizeof(ControlPacket));
-    delete ctrlPacket;
+    memcpy(&states[writeIndex % LM_SIMULATOR_RING_SLOTS], &state, sizeof(LM_State));
+    writeIndex++;
+
+    bool halfFull = writeIndex - readIndex == LM_SIMULATOR_RING_SLOTS / 2;
+
+    portEXIT_CRITICAL(&statesMux);
 
-    statesList->Append(state);
+    if (halfFull && streamTask != nullptr)
+        xTaskNotifyGive(streamTask);
 }
 
 void SimulatorService::startSimulation() {
+    if (states == nullptr) {
+        states = static_cast<LM_State*>(PacketPoolService::allocateBulk(sizeof(LM_State) * LM_SIMULATOR_RING_SLOTS, MEMORY_SIMULATOR));
+        if (states == nullptr) {
+            ESP_LOGE(LM_TAG, "Simulator states ring not allocated");
+            return;
+        }
+    }
+
     isSimulating = true;
 }
 
@@ -54,5 +72,100 @@ void SimulatorService::stopSimulation() {
 }
 
 void SimulatorService::clearStates() {
-    statesList->Clear();
+    portENTER_CRITICAL(&statesMux);
+    readIndex = writeIndex;
+    portEXIT_CRITICAL(&statesMux);
+}
+
+size_t SimulatorService::readStates(LM_State* out, size_t maxStates) {
+    size_t read = 0;
+
+    portENTER_CRITICAL(&statesMux);
+
+    while (read < maxStates && readIndex != writeIndex) {
+        memcpy(&out[read++], &states[readIndex % LM_SIMULATOR_RING_SLOTS], sizeof(LM_State));
+        readIndex++;
+    }
+
+    portEXIT_CRITICAL(&statesMux);
+
+    return read;
+}
+
+size_t SimulatorService::getStatesLength() {
+    portENTER_CRITICAL(&statesMux);
+    size_t length = writeIndex - readIndex;
+    portEXIT_CRITICAL(&statesMux);
+
+    return length;
+}
+
+bool SimulatorService::startStreaming(LM_StateStreamSink sink, BaseType_t core, UBaseType_t priority) {
+    if (streamTask != nullptr || sink == nullptr)
+        return false;
+
+    streamSink = sink;
+    streaming = true;
+
+    BaseType_t res = xTaskCreatePinnedToCore(
+        streamRoutine,
+        "Simulator stream",
+        LM_SIMULATOR_STREAM_STACK_SIZE,
+        this,
+        priority,
+        &streamTask,
+        core);
+    if (res != pdPASS) {
+        ESP_LOGE(LM_TAG, "Simulator stream task creation gave error: %d", res);
+        streaming = false;
+        streamTask = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void SimulatorService::stopStreaming() {
+    if (streamTask == nullptr)
+        return;
+
+    streaming = false;
+    xTaskNotifyGive(streamTask);
+
+    // The task clears the handle when it has sent its last frames
+    while (streamTask != nullptr)
+        vTaskDelay(1);
+}
+
+void SimulatorService::streamRoutine(void* parameter) {
+    SimulatorService* service = static_cast<SimulatorService*>(parameter);
+    LM_State batch[LM_SIMULATOR_STREAM_BATCH];
+    uint8_t frames[LM_SIMULATOR_STREAM_BATCH * STREAM_FRAME_SIZE];
+
+    while (service->streaming) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LM_SIMULATOR_STREAM_PERIOD));
+
+        size_t read;
+        while (service->states != nullptr && (read = service->readStates(batch, LM_SIMULATOR_STREAM_BATCH)) > 0) {
+            for (size_t i = 0; i < read; i++)
+                encodeFrame(&batch[i], &frames[i * STREAM_FRAME_SIZE]);
+
+            service->streamSink(frames, read * STREAM_FRAME_SIZE);
+        }
+    }
+
+    service->streamTask = nullptr;
+    vTaskDelete(NULL);
+}
+
+void SimulatorService::encodeFrame(const LM_State* state, uint8_t* frame) {
+    frame[0] = 0xA5;
+    frame[1] = 0x5A;
+    frame[2] = STREAM_VERSION;
+    frame[3] = sizeof(LM_State);
+    memcpy(&frame[4], state, sizeof(LM_State));
+
+    uint16_t crc = LM_Crc16(&frame[2], 2 + sizeof(LM_State));
+    frame[4 + sizeof(LM_State)] = crc >> 8;
+    frame[5 + sizeof(LM_State)] = crc & 0xFF;
 }
@@ -4,10 +4,25 @@
 #include "entities/packets/ControlPacket.h"
 #include "entities/packets/Packet.h"
 #include "services/PacketService.h"
-#include "utilities/LinkedQueue.hpp"
 
 #include "BuildOptions.h"
 
+/**
+ * @brief Sink of the streamed states, it writes the frames to the serial port, an UDP socket...
+ *
+ * @param data Frames
+ * @param length Length in bytes
+ */
+typedef void (*LM_StateStreamSink)(const uint8_t* data, size_t length);
+
+/**
+ * @brief Records the states of LoRaMesher in a preallocated ring of LM_SIMULATOR_RING_SLOTS LM_State, overwriting the oldest
+ * ones, so recording does not allocate and can run for hours.
+ *
+ * The states are read with readStates or streamed by a background task to a LM_StateStreamSink. Every state is sent in one frame:
+ * | 0xA5 | 0x5A | version | length | LM_State, length bytes | CRC-16/CCITT-FALSE of version, length and LM_State, big endian |
+ * The identifiers of the states are consecutive, a gap is the number of states overwritten before being read.
+ */
 class SimulatorService {
 public:
     SimulatorService();
@@ -16,16 +31,106 @@ public:
     void addState(size_t receivedQueueSize, size_t sentQueueSize, size_t receivedUserQueueSize,
         size_t routingTableSize, size_t q_WRPSize, size_t q_WSPSize, LM_StateType type, Packet<uint8_t>* packet);
 
+    /**
+     * @brief Start recording, the ring is allocated the first time as a bulk buffer
+     *
+     */
     void startSimulation();
 
     void stopSimulation();
 
+    /**
+     * @brief Remove all the states not read
+     *
+     */
     void clearStates();
 
-    LM_LinkedList<LM_State>* statesList = new LM_LinkedList<LM_State>();
+    /**
+     * @brief Remove the oldest states of the ring
+     *
+     * @param states Array where the states are copied
+     * @param maxStates Size of the array
+     * @return size_t Number of states copied
+     */
+    size_t readStates(LM_State* states, size_t maxStates);
+
+    /**
+     * @brief Get the number of states not read
+     *
+     * @return size_t
+     */
+    size_t getStatesLength();
+
+    /**
+     * @brief Get the number of states overwritten before being read
+     *
+     * @return uint32_t
+     */
+    uint32_t getOverwrittenStatesNum() { return overwrittenStates; }
+
+    /**
+     * @brief Start the task that streams the states to the sink every LM_SIMULATOR_STREAM_PERIOD ms, or before when
+     * the ring is half full. It reads the states, readStates must not be used meanwhile
+     *
+     * @param sink Sink of the frames, called from the streaming task
+     * @param core Core of the task
+     * @param priority Priority of the task, below the LoRaMesher tasks
+     * @return true If the task has been created
+     * @return false If it is already streaming or there is no memory
+     */
+    bool startStreaming(LM_StateStreamSink sink, BaseType_t core = tskNO_AFFINITY, UBaseType_t priority = 1);
+
+    /**
+     * @brief Stop the streaming task, it waits for the frames being sent
+     *
+     */
+    void stopStreaming();
+
+    /**
+     * @brief Version of the streamed frames
+     *
+     */
+    static const uint8_t STREAM_VERSION = 1;
+
+    /**
+     * @brief Size in bytes of a streamed frame
+     *
+     */
+    static const size_t STREAM_FRAME_SIZE = 4 + sizeof(LM_State) + 2;
 
 private:
     bool isSimulating = false;
 
-    size_t numberStates = 0;
-};
\ No newline at end of file
+    uint32_t numberStates = 0;
+
+    LM_State* states = nullptr;
+
+    // Position of the next state written and of the oldest state not read
+    uint32_t writeIndex = 0;
+    uint32_t readIndex = 0;
+
+    uint32_t overwrittenStates = 0;
+
+    portMUX_TYPE statesMux = portMUX_INITIALIZER_UNLOCKED;
+
+    LM_StateStreamSink streamSink = nullptr;
+
+    TaskHandle_t streamTask = nullptr;
+
+    volatile bool streaming = false;
+
+    /**
+     * @brief Routine of the streaming task
+     *
+     * @param parameter The SimulatorService
+     */
+    static void streamRoutine(void* parameter);
+
+    /**
+     * @brief Write the frame of a state
+     *
+     * @param state State
+     * @param frame Buffer of STREAM_FRAME_SIZE bytes
+     */
+    static void encodeFrame(const LM_State* state, uint8_t* frame);
+};
@@ -0,0 +1,49 @@
+#include "SniffService.h"
+
+#include "NeighborTableService.h"
+
+void SniffService::process(uint16_t src, const SniffTrailer* trailer) {
+    if (trailer == nullptr && !neighborSniffing)
+        return;
+
+    uint16_t length = trailer != nullptr ? trailer->preambleLength : 0;
+
+    NeighborTableService::setInUse();
+    NeighborEntry* entry = length != 0 ? NeighborTableService::getOrCreate(src) : NeighborTableService::find(src);
+    if (entry != nullptr && entry->sniffPreambleLength != length) {
+        ESP_LOGI(LM_TAG, "Neighbor %X sniffing with a preamble of %d symbols", src, length);
+        entry->sniffPreambleLength = length;
+    }
+    NeighborTableService::releaseInUse();
+
+    if (length != 0)
+        neighborSniffing = true;
+}
+
+uint16_t SniffService::getLinkPreambleLength(uint16_t nextHop, uint16_t preambleLength) {
+    // The broadcasts of a sniffing node reach the other sniffing nodes before they know about each other
+    uint16_t length = nextHop == 0 && SniffService::preambleLength > preambleLength ? SniffService::preambleLength : preambleLength;
+    if (!neighborSniffing)
+        return length;
+
+    NeighborTableService::setInUse();
+
+    if (nextHop != 0) {
+        NeighborEntry* entry = NeighborTableService::find(nextHop);
+        if (entry != nullptr && entry->sniffPreambleLength > length)
+            length = entry->sniffPreambleLength;
+    }
+    else {
+        for (size_t i = 0; i < NeighborTableService::size(); i++) {
+            NeighborEntry* entry = NeighborTableService::getEntry(i);
+            if (entry->sniffPreambleLength > length)
+                length = entry->sniffPreambleLength;
+        }
+    }
+
+    NeighborTableService::releaseInUse();
+    return length;
+}
+
+uint16_t SniffService::preambleLength = 0;
+bool SniffService::neighborSniffing = false;
@@ -0,0 +1,62 @@
+#ifndef _LORAMESHER_SNIFF_SERVICE_H
+#define _LORAMESHER_SNIFF_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/RoutePacket.h"
+
+/**
+ * @brief Sniff mode, the hardware receive duty cycle of the SX126x, see LoraMesherConfig::sniffPreambleLength. The radio of a
+ * sniffing node sleeps and wakes for LM_SNIFF_MIN_SYMBOLS symbols, it only detects the frames with a preamble that covers
+ * a whole cycle. Its HELLOs have ROUTE_CAP_SNIFF and a SniffTrailer with that preamble length, kept in the NeighborEntry of the
+ * source. The frames to a sniffing neighbour are sent with its preamble, the broadcasts with the longest one around, the
+ * one of the node included.
+ *
+ */
+class SniffService {
+public:
+
+    /**
+     * @brief Set the sniff mode of the node
+     *
+     * @param preambleLength Preamble length in symbols of the frames to the node, 0 to listen continuously
+     */
+    static void init(uint16_t preambleLength) { SniffService::preambleLength = preambleLength; }
+
+    static bool isEnabled() { return preambleLength != 0; }
+
+    static uint16_t getPreambleLength() { return preambleLength; }
+
+    /**
+     * @brief Fill the trailer of a HELLO of the node
+     *
+     */
+    static void fill(SniffTrailer* trailer) { trailer->preambleLength = preambleLength; }
+
+    /**
+     * @brief Keep the sniff mode of the source of a HELLO
+     *
+     * @param src Source of the HELLO
+     * @param trailer Its trailer, nullptr if it listens continuously
+     */
+    static void process(uint16_t src, const SniffTrailer* trailer);
+
+    /**
+     * @brief Get the preamble length of a frame
+     *
+     * @param nextHop Neighbour of a unicast frame, 0 for the broadcasts
+     * @param preambleLength Preamble length of the configuration
+     * @return uint16_t The preamble length of the neighbour, or the longest of the neighbours and the node for a broadcast,
+     * if it is longer than the one of the configuration
+     */
+    static uint16_t getLinkPreambleLength(uint16_t nextHop, uint16_t preambleLength);
+
+private:
+
+    static uint16_t preambleLength;
+
+    // A sniffing neighbour has been heard, the neighbours are not searched before
+    static bool neighborSniffing;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include "SpoolService.h"
+
+#include <cstddef>
+
+#include "utilities/Crc16.hpp"
+
+static constexpr uint32_t SEGMENT_MAGIC = 0x50534D4C; // "LMSP"
+static constexpr uint16_t RECORD_FREE = 0xFFFF;
+static constexpr uint8_t RECORD_PENDING = 0xFF;
+static constexpr uint8_t RECORD_DRAINED = 0x00;
+
+#pragma pack(1)
+struct SpoolSegmentHeader {
+    uint32_t magic;
+    uint32_t sequence;
+};
+
+struct SpoolRecordHeader {
+    uint16_t length;
+    uint16_t crc;
+    uint8_t drained;
+    uint8_t reserved;
+};
+#pragma pack()
+
+static constexpr uint32_t FIRST_RECORD = sizeof(SpoolSegmentHeader);
+
+/**
+ * @brief Length of a record in the flash, aligned to 4 bytes
+ *
+ */
+static inline uint32_t getRecordLength(uint16_t length) {
+    return (sizeof(SpoolRecordHeader) + length + 3) & ~((uint32_t) 3);
+}
+
+static inline uint32_t getAddress(uint32_t segment, uint32_t offset) {
+    return segment * LM_SPOOL_SEGMENT_SIZE + offset;
+}
+
+bool SpoolService::init(const char* label) {
+    if (partition != nullptr) {
+        ESP_LOGW(LM_TAG, "Spool already initialized");
+        return true;
+    }
+
+    const esp_partition_t* found = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (found == nullptr) {
+        ESP_LOGE(LM_TAG, "Spool partition %s not found", label);
+        return false;
+    }
+
+    segments = found->size / LM_SPOOL_SEGMENT_SIZE;
+    if (segments < 2) {
+        ESP_LOGE(LM_TAG, "Spool partition %s too small, %d bytes", label, (int) found->size);
+        return false;
+    }
+
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL) {
+        ESP_LOGE(LM_TAG, "Spool semaphore not created");
+        return false;
+    }
+
+    partition = found;
+    recover();
+
+    ESP_LOGI(LM_TAG, "Spool of %d segments open, %d packets pending", (int) segments, (int) pending);
+    return true;
+}
+
+void SpoolService::recover() {
+    bool found = false;
+    uint32_t oldest = 0;
+
+    // The valid segments are the last ones opened, a run of the ring ending at the head
+    for (uint32_t segment = 0; segment < segments; segment++) {
+        SpoolSegmentHeader header;
+        if (esp_partition_read(partition, getAddress(segment, 0), &header, sizeof(header)) != ESP_OK ||
+            header.magic != SEGMENT_MAGIC)
+            continue;
+
+        if (!found || (int32_t) (header.sequence - sequence) > 0) {
+            sequence = header.sequence;
+            headSegment = segment;
+        }
+
+        if (!found || (int32_t) (header.sequence - oldest) < 0) {
+            oldest = header.sequence;
+            tailSegment = segment;
+        }
+
+        found = true;
+    }
+
+    pending = 0;
+
+    if (!found) {
+        // The first append opens the first segment
+        sequence = 0;
+        headSegment = segments - 1;
+        headOffset = LM_SPOOL_SEGMENT_SIZE;
+        tailSegment = headSegment;
+        tailOffset = headOffset;
+        return;
+    }
+
+    headOffset = FIRST_RECORD;
+
+    uint16_t length;
+    bool isPending;
+    while (readRecord(headSegment, headOffset, length, isPending))
+        headOffset += getRecordLength(length);
+
+    // Count the pending records from the oldest segment to the head
+    uint32_t segment = tailSegment;
+    for (;;) {
+        uint32_t offset = FIRST_RECORD;
+        while ((segment != headSegment || offset < headOffset) && readRecord(segment, offset, length, isPending)) {
+            if (isPending)
+                pending++;
+            offset += getRecordLength(length);
+        }
+
+        if (segment == headSegment)
+            break;
+
+        segment = (segment + 1) % segments;
+    }
+
+    tailOffset = FIRST_RECORD;
+    seekPending();
+}
+
+bool SpoolService::readRecord(uint32_t segment, uint32_t offset, uint16_t& length, bool& isPending) {
+    if (offset + sizeof(SpoolRecordHeader) > LM_SPOOL_SEGMENT_SIZE)
+        return false;
+
+    SpoolRecordHeader header;
+    if (esp_partition_read(partition, getAddress(segment, offset), &header, sizeof(header)) != ESP_OK)
+        return false;
+
+    // A free record or a header cut by a reset, the segment ends here
+    if (header.length == RECORD_FREE || header.length == 0 || offset + getRecordLength(header.length) > LM_SPOOL_SEGMENT_SIZE)
+        return false;
+
+    length = header.length;
+    isPending = header.drained == RECORD_PENDING;
+    return true;
+}
+
+void SpoolService::seekPending() {
+    for (;;) {
+        if (tailSegment == headSegment && tailOffset >= headOffset) {
+            tailOffset = headOffset;
+            return;
+        }
+
+        uint16_t length;
+        bool isPending;
+        if (!readRecord(tailSegment, tailOffset, length, isPending)) {
+            tailSegment = (tailSegment + 1) % segments;
+            tailOffset = FIRST_RECORD;
+            continue;
+        }
+
+        if (isPending)
+            return;
+
+        tailOffset += getRecordLength(length);
+    }
+}
+
+bool SpoolService::openSegment() {
+    uint32_t next = (headSegment + 1) % segments;
+
+    // The ring is full, the oldest segment is dropped with its pending packets
+    bool full = pending > 0 && next == tailSegment;
+    if (full) {
+        uint32_t droppedNow = 0;
+        uint16_t length;
+        bool isPending;
+        for (uint32_t offset = tailOffset; readRecord(next, offset, length, isPending); offset += getRecordLength(length))
+            if (isPending)
+                droppedNow++;
+
+        ESP_LOGW(LM_TAG, "Spool full, %d packets of the oldest segment dropped", (int) droppedNow);
+        pending -= droppedNow > pending ? pending : droppedNow;
+        dropped += droppedNow;
+    }
+
+    if (esp_partition_erase_range(partition, getAddress(next, 0), LM_SPOOL_SEGMENT_SIZE) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "Spool segment %d not erased", (int) next);
+        return false;
+    }
+
+    SpoolSegmentHeader header = {SEGMENT_MAGIC, sequence + 1};
+    if (esp_partition_write(partition, getAddress(next, 0), &header, sizeof(header)) != ESP_OK) {
+        ESP_LOGE(LM_TAG, "Spool segment %d not written", (int) next);
+        return false;
+    }
+
+    sequence++;
+    headSegment = next;
+    headOffset = FIRST_RECORD;
+
+    if (pending == 0) {
+        tailSegment = headSegment;
+        tailOffset = headOffset;
+    }
+    else if (full) {
+        tailSegment = (next + 1) % segments;
+        tailOffset = FIRST_RECORD;
+        seekPending();
+    }
+
+    return true;
+}
+
+bool SpoolService::append(Packet<uint8_t>* p) {
+    if (partition == nullptr)
+        return false;
+
+    uint16_t length = p->packetSize;
+    uint32_t recordLength = getRecordLength(length);
+    if (recordLength > LM_SPOOL_SEGMENT_SIZE - FIRST_RECORD)
+        return false;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if (headOffset + recordLength > LM_SPOOL_SEGMENT_SIZE && !openSegment()) {
+        xSemaphoreGive(mutex);
+        return false;
+    }
+
+    SpoolRecordHeader header = {length, LM_Crc16(reinterpret_cast<uint8_t*>(p), length), RECORD_PENDING, 0xFF};
+    uint32_t address = getAddress(headSegment, headOffset);
+
+    // A packet cut by a reset is dropped by its CRC
+    bool written = esp_partition_write(partition, address, &header, sizeof(header)) == ESP_OK &&
+        esp_partition_write(partition, address + sizeof(header), p, length) == ESP_OK;
+
+    if (written) {
+        if (pending == 0) {
+            tailSegment = headSegment;
+            tailOffset = headOffset;
+        }
+
+        pending++;
+    }
+    else
+        ESP_LOGE(LM_TAG, "Spool record not written");
+
+    // A failed record is skipped, the space may be partially written
+    headOffset += recordLength;
+
+    xSemaphoreGive(mutex);
+    return written;
+}
+
+Packet<uint8_t>* SpoolService::peek() {
+    if (partition == nullptr)
+        return nullptr;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    Packet<uint8_t>* p = nullptr;
+    while (pending > 0 && p == nullptr) {
+        uint32_t address = getAddress(tailSegment, tailOffset);
+
+        uint16_t length;
+        bool isPending;
+        SpoolRecordHeader header;
+        if (!readRecord(tailSegment, tailOffset, length, isPending) ||
+            esp_partition_read(partition, address, &header, sizeof(header)) != ESP_OK)
+            break;
+
+        p = static_cast<Packet<uint8_t>*>(PacketPoolService::allocate(header.length));
+        if (p == nullptr)
+            break;
+
+        if (esp_partition_read(partition, address + sizeof(header), p, header.length) == ESP_OK &&
+            LM_Crc16(reinterpret_cast<uint8_t*>(p), header.length) == header.crc && p->packetSize == header.length)
+            break;
+
+        ESP_LOGW(LM_TAG, "Spool record corrupted, dropped");
+        PacketPoolService::release(p);
+        p = nullptr;
+
+        uint8_t drained = RECORD_DRAINED;
+        esp_partition_write(partition, address + offsetof(SpoolRecordHeader, drained), &drained, 1);
+        pending--;
+        dropped++;
+        tailOffset += getRecordLength(header.length);
+        seekPending();
+    }
+
+    xSemaphoreGive(mutex);
+    return p;
+}
+
+void SpoolService::pop() {
+    if (partition == nullptr)
+        return;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    uint16_t length;
+    bool isPending;
+    if (pending > 0 && readRecord(tailSegment, tailOffset, length, isPending)) {
+        uint8_t drained = RECORD_DRAINED;
+        esp_partition_write(partition, getAddress(tailSegment, tailOffset) + offsetof(SpoolRecordHeader, drained), &drained, 1);
+        pending--;
+        tailOffset += getRecordLength(length);
+        seekPending();
+    }
+
+    xSemaphoreGive(mutex);
+}
+
+const esp_partition_t* SpoolService::partition = nullptr;
+SemaphoreHandle_t SpoolService::mutex = NULL;
+uint32_t SpoolService::segments = 0;
+uint32_t SpoolService::sequence = 0;
+uint32_t SpoolService::headSegment = 0;
+uint32_t SpoolService::headOffset = 0;
+uint32_t SpoolService::tailSegment = 0;
+uint32_t SpoolService::tailOffset = 0;
+uint32_t SpoolService::pending = 0;
+uint32_t SpoolService::dropped = 0;
@@ -0,0 +1,128 @@
+#ifndef _LORAMESHER_SPOOL_SERVICE_H
+#define _LORAMESHER_SPOOL_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include <freertos/semphr.h>
+#include <esp_partition.h>
+
+#include "entities/packets/Packet.h"
+
+/**
+ * @brief Store and forward spool of the data packets without a route, in a flash data partition, see
+ * LoraMesherConfig::spoolPartition. The partition is a ring of LM_SPOOL_SEGMENT_SIZE segments written as an append only log:
+ *
+ *   Segment: magic (4), sequence (4), records
+ *   Record: length (2), CRC-16 of the packet (2), drained flag (1), reserved (1), packet, padded to 4 bytes
+ *
+ * A new segment is erased when the head moves to it, so every segment is erased once per turn of the ring. When the ring
+ * is full the oldest segment is dropped with its pending packets. A drained packet clears its flag, the flash only changes
+ * the bits from 1 to 0, so the spool is found again after a reboot.
+ *
+ */
+class SpoolService {
+public:
+
+    /**
+     * @brief Open the spool in a data partition, the packets stored before are kept
+     *
+     * @param label Label of the partition, at least two segments
+     * @return true If the spool is open
+     */
+    static bool init(const char* label);
+
+    /**
+     * @brief Returns if the spool is open
+     *
+     */
+    static bool isEnabled() { return partition != nullptr; }
+
+    /**
+     * @brief Store a copy of a packet at the end of the spool
+     *
+     * @param p Packet, it is not deleted
+     * @return true If it has been stored
+     */
+    static bool append(Packet<uint8_t>* p);
+
+    /**
+     * @brief Read the oldest pending packet, it stays in the spool until pop. The corrupted records are dropped
+     *
+     * @return Packet<uint8_t>* New packet or nullptr if there is none
+     */
+    static Packet<uint8_t>* peek();
+
+    /**
+     * @brief Mark the oldest pending packet as drained
+     *
+     */
+    static void pop();
+
+    /**
+     * @brief Get the number of packets waiting in the spool
+     *
+     * @return uint32_t
+     */
+    static uint32_t getPendingNum() { return pending; }
+
+    /**
+     * @brief Get the number of packets dropped because the spool was full or the record was corrupted
+     *
+     * @return uint32_t
+     */
+    static uint32_t getDroppedNum() { return dropped; }
+
+private:
+
+    static const esp_partition_t* partition;
+
+    static SemaphoreHandle_t mutex;
+
+    static uint32_t segments;
+
+    static uint32_t sequence;
+
+    static uint32_t headSegment;
+
+    static uint32_t headOffset;
+
+    static uint32_t tailSegment;
+
+    static uint32_t tailOffset;
+
+    static uint32_t pending;
+
+    static uint32_t dropped;
+
+    /**
+     * @brief Find the head and the tail of the ring and count the pending packets
+     *
+     */
+    static void recover();
+
+    /**
+     * @brief Erase the next segment of the ring and move the head to it, dropping the oldest segment when the ring is full
+     *
+     * @return true If the segment has been opened
+     */
+    static bool openSegment();
+
+    /**
+     * @brief Move the tail to the first pending record from its position, the head if there is none
+     *
+     */
+    static void seekPending();
+
+    /**
+     * @brief Read the header of a record
+     *
+     * @param segment Segment
+     * @param offset Offset of the record in the segment
+     * @param length Length of the packet
+     * @param isPending If it has not been drained
+     * @return true If there is a record, false at the end of the segment
+     */
+    static bool readRecord(uint32_t segment, uint32_t offset, uint16_t& length, bool& isPending);
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "TdmaService.h"
+
+#include "AirtimeService.h"
+#include "PacketFactory.h"
+#include "TimeSyncService.h"
+#include "WiFiService.h"
+
+void TdmaService::init(uint8_t numOfSlots) {
+    portENTER_CRITICAL(&mux);
+
+    // One slot is the contention slot, a schedule needs another one
+    slots = numOfSlots < 2 ? 0 : numOfSlots > LM_TDMA_MAX_SLOTS ? LM_TDMA_MAX_SLOTS : numOfSlots;
+    slotLength = AirtimeService::getTimeOnAirMs(PacketFactory::getMaxPacketSize()) + 1 + LM_TDMA_GUARD;
+    own = 0;
+    active = 0;
+    demand = 0;
+    frameAirtime = 0;
+    frame = -1;
+    for (Neighbor& neighbor : neighbors)
+        neighbor.address = 0;
+
+    portEXIT_CRITICAL(&mux);
+
+    if (slots != 0)
+        ESP_LOGI(LM_TAG, "TDMA frame of %d slots of %d ms", slots, (int) slotLength);
+}
+
+int32_t TdmaService::getTransmitWait(uint32_t timeOnAir) {
+    if (slots == 0)
+        return -1;
+
+    int64_t time = getNetworkTime();
+    if (time < 0)
+        return -1;
+
+    uint32_t frameLength = slots * slotLength;
+    uint32_t position = time % frameLength;
+    uint8_t slot = position / slotLength;
+    uint32_t inSlot = position % slotLength;
+
+    portENTER_CRITICAL(&mux);
+    uint32_t usable = own & active;
+    portEXIT_CRITICAL(&mux);
+
+    if (usable == 0)
+        return slot == 0 ? -1 : frameLength - position;
+
+    // The transmissions start half a guard into the slot, the clocks of the neighbors can be that early or late
+    uint32_t start = LM_TDMA_GUARD / 2;
+    if ((usable >> slot) & 1) {
+        if (inSlot < start)
+            return start - inSlot;
+
+        if (inSlot + timeOnAir + start <= slotLength)
+            return 0;
+    }
+
+    for (uint8_t i = 1; i <= slots; i++) {
+        if ((usable >> ((slot + i) % slots)) & 1)
+            return i * slotLength - inSlot + start;
+    }
+
+    return -1;
+}
+
+void TdmaService::onSent(uint32_t timeOnAir) {
+    if (slots == 0)
+        return;
+
+    int64_t time = getNetworkTime();
+    if (time < 0)
+        return;
+
+    portENTER_CRITICAL(&mux);
+    updateDemand(time);
+    frameAirtime += timeOnAir;
+    portEXIT_CRITICAL(&mux);
+}
+
+void TdmaService::fill(TdmaTrailer* trailer) {
+    int64_t time = getNetworkTime();
+
+    portENTER_CRITICAL(&mux);
+
+    removeOldNeighbors();
+    leaveTakenSlots();
+
+    uint32_t neighborSlots = 0;
+    uint32_t twoHopSlots = 0;
+    uint32_t seen = own;
+    uint32_t conflicts = 0;
+    for (const Neighbor& neighbor : neighbors) {
+        if (neighbor.address == 0)
+            continue;
+
+        neighborSlots |= neighbor.own;
+        twoHopSlots |= neighbor.used;
+        conflicts |= seen & neighbor.own;
+        seen |= neighbor.own;
+    }
+
+    // The slots are only taken with the time of the network, they are kept while it is lost
+    if (time >= 0) {
+        updateDemand(time);
+
+        uint32_t divisor = LM_TDMA_DEMAND_WEIGHT * 100 * slotLength;
+        uint32_t wanted = ((uint64_t) demand * LM_TDMA_HEADROOM + divisor - 1) / divisor;
+        if (wanted < 1)
+            wanted = 1;
+        if (wanted > LM_TDMA_MAX_OWN_SLOTS)
+            wanted = LM_TDMA_MAX_OWN_SLOTS;
+
+        uint32_t free = getAllSlots() & ~1u & ~own & ~neighborSlots & ~twoHopSlots;
+        while (countSlots(own) < wanted && free != 0) {
+            // A random free slot, so the neighbors that take slots at the same time rarely take the same one
+            long n = random(0, countSlots(free));
+            uint32_t bits = free;
+            while (n-- > 0)
+                bits &= bits - 1;
+
+            uint32_t slot = bits & (~bits + 1);
+            own |= slot;
+            free &= ~slot;
+            slotChanges++;
+        }
+
+        while (countSlots(own) > wanted)
+            leave(31 - __builtin_clz(own));
+    }
+
+    trailer->own = own;
+    trailer->used = neighborSlots;
+    trailer->conflicts = conflicts;
+
+    // The slots announced are used from now on
+    active = own;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+void TdmaService::process(uint16_t src, const TdmaTrailer* trailer) {
+    portENTER_CRITICAL(&mux);
+
+    // The entry of the neighbor, a free one or the one heard the longest ago
+    Neighbor* entry = nullptr;
+    for (Neighbor& neighbor : neighbors) {
+        if (neighbor.address == src) {
+            entry = &neighbor;
+            break;
+        }
+
+        if (entry == nullptr || (entry->address != 0 && (neighbor.address == 0 || neighbor.lastHeard < entry->lastHeard)))
+            entry = &neighbor;
+    }
+
+    entry->address = src;
+    entry->own = trailer->own;
+    entry->used = trailer->used;
+    entry->conflicts = trailer->conflicts;
+    entry->lastHeard = millis();
+
+    leaveTakenSlots();
+
+    // Slots of this node owned by a two hop neighbor too, both owners leave it half of the time
+    uint32_t conflicts = trailer->conflicts & own & ~trailer->own;
+    while (conflicts != 0) {
+        uint8_t slot = __builtin_ctz(conflicts);
+        conflicts &= conflicts - 1;
+        if (random(0, 2) == 0)
+            leave(slot);
+    }
+
+    portEXIT_CRITICAL(&mux);
+}
+
+int64_t TdmaService::getNetworkTime() {
+    int64_t time;
+    if (!TimeSyncService::toSyncedTime(esp_timer_get_time(), time) || time < 0)
+        return -1;
+
+    return time / 1000;
+}
+
+void TdmaService::updateDemand(int64_t time) {
+    int64_t current = time / (slots * slotLength);
+    if (frame < 0 || current < frame) {
+        frame = current;
+        return;
+    }
+
+    if (current == frame)
+        return;
+
+    demand = demand - demand / LM_TDMA_DEMAND_WEIGHT + frameAirtime;
+    frameAirtime = 0;
+
+    // The frames without packets
+    for (int64_t i = frame + 1; i < current && demand != 0 && i - frame <= LM_TDMA_DEMAND_WEIGHT * 8; i++)
+        demand -= (demand + LM_TDMA_DEMAND_WEIGHT - 1) / LM_TDMA_DEMAND_WEIGHT;
+
+    frame = current;
+}
+
+void TdmaService::removeOldNeighbors() {
+    uint32_t now = millis();
+    for (Neighbor& neighbor : neighbors) {
+        if (neighbor.address != 0 && now - neighbor.lastHeard > LM_TDMA_TIMEOUT)
+            neighbor.address = 0;
+    }
+}
+
+void TdmaService::leaveTakenSlots() {
+    uint16_t localAddress = WiFiService::getLocalAddress();
+    for (const Neighbor& neighbor : neighbors) {
+        if (neighbor.address == 0 || neighbor.address > localAddress)
+            continue;
+
+        uint32_t taken = own & neighbor.own;
+        while (taken != 0) {
+            uint8_t slot = __builtin_ctz(taken);
+            taken &= taken - 1;
+            leave(slot);
+        }
+    }
+}
+
+void TdmaService::leave(uint8_t slot) {
+    own &= ~(1u << slot);
+    active &= ~(1u << slot);
+    slotChanges++;
+}
+
+uint32_t TdmaService::getAllSlots() {
+    return slots >= 32 ? UINT32_MAX : (1u << slots) - 1;
+}
+
+uint8_t TdmaService::countSlots(uint32_t bits) {
+    return __builtin_popcount(bits);
+}
+
+portMUX_TYPE TdmaService::mux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t TdmaService::slots = 0;
+uint32_t TdmaService::slotLength = 0;
+TdmaService::Neighbor TdmaService::neighbors[LM_TDMA_NEIGHBORS];
+uint32_t TdmaService::own = 0;
+uint32_t TdmaService::active = 0;
+uint32_t TdmaService::demand = 0;
+uint32_t TdmaService::frameAirtime = 0;
+int64_t TdmaService::frame = -1;
+uint32_t TdmaService::slotChanges = 0;
@@ -0,0 +1,162 @@
+#ifndef _LORAMESHER_TDMA_SERVICE_H
+#define _LORAMESHER_TDMA_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/RoutePacket.h"
+
+/**
+ * @brief Transmit slots of the TDMA mode, see LoraMesherConfig::tdmaSlots. The time of the network of TimeSyncService is
+ * divided into frames of slots, a slot fits the longest packet and a guard. Slot 0 is the contention slot: the nodes without
+ * a slot of their own send in it after the usual backoff, to join and to announce their first slots.
+ *
+ * Every node owns the slots of its demand, the airtime it sent in the last frames plus a headroom. The HELLOs carry a
+ * TdmaTrailer with the slots of the source and of its neighbors, so a node only takes the slots free within two hops.
+ * A new slot is used after it has been announced in a HELLO. When two neighbors own the same slot the one with the higher
+ * address leaves it, and when a neighbor reports a slot owned twice around it, each owner leaves it with a probability of
+ * one half. A node sends without backoff in its slots, the packets that do not fit in the rest of the slot wait for the next one.
+ *
+ */
+class TdmaService {
+public:
+
+    /**
+     * @brief Start the schedule, after the time on air of the radio is known
+     *
+     * @param slots Slots of a frame, 0 disables the TDMA mode
+     */
+    static void init(uint8_t slots);
+
+    static bool isEnabled() { return slots != 0; }
+
+    /**
+     * @brief Get when a packet can be sent
+     *
+     * @param timeOnAir Time on air of the packet in ms
+     * @return int32_t 0 to send it now in a slot of the node, the ms to wait until a slot where it can be sent or -1 to send
+     * it after a backoff: the node is not synchronized, or it does not have slots yet and it is the contention slot
+     */
+    static int32_t getTransmitWait(uint32_t timeOnAir);
+
+    /**
+     * @brief Count the airtime of a sent packet in the demand of the node
+     *
+     * @param timeOnAir Time on air in ms
+     */
+    static void onSent(uint32_t timeOnAir);
+
+    /**
+     * @brief Update the slots of the node and fill the trailer of a HELLO just before sending it
+     *
+     * @param trailer Trailer
+     */
+    static void fill(TdmaTrailer* trailer);
+
+    /**
+     * @brief Process the trailer of a received HELLO
+     *
+     * @param src Address of the neighbor
+     * @param trailer Trailer
+     */
+    static void process(uint16_t src, const TdmaTrailer* trailer);
+
+    /**
+     * @brief Slots of the node, bit n is the slot n
+     *
+     * @return uint32_t
+     */
+    static uint32_t getOwnSlots() { return own; }
+
+    /**
+     * @brief Length of a slot in ms
+     *
+     * @return uint32_t
+     */
+    static uint32_t getSlotLength() { return slotLength; }
+
+    /**
+     * @brief Get the number of slots taken and left by the node
+     *
+     * @return uint32_t
+     */
+    static uint32_t getSlotChangesNum() { return slotChanges; }
+
+private:
+
+    /**
+     * @brief Slots of a HELLO of a neighbor
+     *
+     */
+    struct Neighbor {
+        uint16_t address;
+        uint32_t own;
+        uint32_t used;
+        uint32_t conflicts;
+        uint32_t lastHeard;
+    };
+
+    static portMUX_TYPE mux;
+
+    static uint8_t slots;
+
+    static uint32_t slotLength;
+
+    static Neighbor neighbors[LM_TDMA_NEIGHBORS];
+
+    /**
+     * @brief Slots of the node, and the ones announced in a HELLO that can be used
+     *
+     */
+    static uint32_t own;
+
+    static uint32_t active;
+
+    /**
+     * @brief Demand, LM_TDMA_DEMAND_WEIGHT times the airtime in ms sent every frame, and the frame of the airtime being counted
+     *
+     */
+    static uint32_t demand;
+
+    static uint32_t frameAirtime;
+
+    static int64_t frame;
+
+    static uint32_t slotChanges;
+
+    /**
+     * @brief Time of the network in ms, outside of the mux
+     *
+     * @return int64_t Time or -1 if the node is not synchronized
+     */
+    static int64_t getNetworkTime();
+
+    /**
+     * @brief Close the frames until the frame of the time, protected by the mux
+     *
+     */
+    static void updateDemand(int64_t time);
+
+    /**
+     * @brief Forget the neighbors not heard for LM_TDMA_TIMEOUT ms, protected by the mux
+     *
+     */
+    static void removeOldNeighbors();
+
+    /**
+     * @brief Leave the slots owned by a neighbor with a lower address, protected by the mux
+     *
+     */
+    static void leaveTakenSlots();
+
+    /**
+     * @brief Leave a slot of the node, protected by the mux
+     *
+     */
+    static void leave(uint8_t slot);
+
+    static uint32_t getAllSlots();
+
+    static uint8_t countSlots(uint32_t bits);
+};
+
+#endif
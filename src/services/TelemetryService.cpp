@@ -0,0 +1,184 @@
+#include "TelemetryService.h"
+
+#include "WiFiService.h"
+
+void TelemetryService::init(uint16_t seconds) {
+    portENTER_CRITICAL(&mux);
+
+    interval = seconds;
+    lastOwn = 0;
+    lastAirtime = 0;
+    for (TelemetryRecord& record : relay)
+        record.address = 0;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+bool TelemetryService::isOwnDue() {
+    if (interval == 0)
+        return false;
+
+    return lastOwn == 0 || millis() - lastOwn >= (uint32_t) interval * 1000;
+}
+
+bool TelemetryService::hasRecord() {
+    if (interval == 0)
+        return false;
+
+    if (isOwnDue())
+        return true;
+
+    bool pending = false;
+    portENTER_CRITICAL(&mux);
+    for (const TelemetryRecord& record : relay) {
+        if (record.address != 0) {
+            pending = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+
+    return pending;
+}
+
+void TelemetryService::fill(TelemetryTrailer* trailer, uint8_t gatewayHops, const TelemetryRecord* own, uint64_t airtime) {
+    trailer->gatewayHops = gatewayHops;
+    memset(&trailer->record, 0, sizeof(TelemetryRecord));
+
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&mux);
+
+    if (own != nullptr) {
+        // The duty cycle since the previous record, since the boot for the first one
+        uint32_t elapsed = lastOwn == 0 ? now : now - lastOwn;
+        uint64_t used = airtime - lastAirtime;
+        uint64_t dutyCycle = elapsed == 0 ? 0 : used * 10000 / elapsed;
+
+        trailer->record = *own;
+        trailer->record.address = WiFiService::getLocalAddress();
+        trailer->record.sequence = ++sequence;
+        trailer->record.uptime = now / 1000;
+        trailer->record.dutyCycle = dutyCycle > UINT16_MAX ? UINT16_MAX : dutyCycle;
+
+        lastOwn = now == 0 ? 1 : now;
+        lastAirtime = airtime;
+    }
+    else {
+        for (TelemetryRecord& record : relay) {
+            if (record.address != 0) {
+                trailer->record = record;
+                record.address = 0;
+                break;
+            }
+        }
+    }
+
+    portEXIT_CRITICAL(&mux);
+}
+
+void TelemetryService::process(const TelemetryTrailer* trailer, uint8_t gatewayHops) {
+    if (interval == 0)
+        return;
+
+    const TelemetryRecord& record = trailer->record;
+    if (record.address == 0 || record.address == WiFiService::getLocalAddress())
+        return;
+
+    portENTER_CRITICAL(&mux);
+
+    if (gatewayHops == 0)
+        store(record);
+    // Only the records of the nodes farther from the gateways go up, so a record is not relayed back and forth
+    else if (gatewayHops != UINT8_MAX && trailer->gatewayHops > gatewayHops)
+        keepToRelay(record);
+
+    portEXIT_CRITICAL(&mux);
+}
+
+bool TelemetryService::getNode(uint16_t address, LM_Telemetry& telemetry) {
+    bool found = false;
+
+    portENTER_CRITICAL(&mux);
+    for (size_t i = 0; i < nodesLength; i++) {
+        if (nodes[i].record.address == address) {
+            telemetry = nodes[i];
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+
+    return found;
+}
+
+size_t TelemetryService::getNodes(LM_Telemetry* telemetry, size_t max) {
+    portENTER_CRITICAL(&mux);
+    size_t length = nodesLength < max ? nodesLength : max;
+    for (size_t i = 0; i < length; i++)
+        telemetry[i] = nodes[i];
+    portEXIT_CRITICAL(&mux);
+
+    return length;
+}
+
+void TelemetryService::store(const TelemetryRecord& record) {
+    if (nodes == nullptr) {
+        nodes = static_cast<LM_Telemetry*>(pvPortMalloc(LM_TELEMETRY_NODES * sizeof(LM_Telemetry)));
+        if (nodes == nullptr)
+            return;
+    }
+
+    // The entry of the node, a free one or the one heard the longest ago
+    LM_Telemetry* entry = nullptr;
+    for (size_t i = 0; i < nodesLength; i++) {
+        if (nodes[i].record.address == record.address) {
+            // A record relayed late by a slower path
+            if (!isNewer(record, nodes[i].record))
+                return;
+
+            entry = &nodes[i];
+            break;
+        }
+
+        if (entry == nullptr || nodes[i].receivedAt < entry->receivedAt)
+            entry = &nodes[i];
+    }
+
+    if (entry == nullptr || (entry->record.address != record.address && nodesLength < LM_TELEMETRY_NODES))
+        entry = &nodes[nodesLength++];
+
+    entry->record = record;
+    entry->receivedAt = millis();
+}
+
+void TelemetryService::keepToRelay(const TelemetryRecord& record) {
+    TelemetryRecord* slot = nullptr;
+    for (TelemetryRecord& waiting : relay) {
+        if (waiting.address == record.address) {
+            if (isNewer(record, waiting))
+                waiting = record;
+            return;
+        }
+
+        if (slot == nullptr && waiting.address == 0)
+            slot = &waiting;
+    }
+
+    if (slot == nullptr) {
+        relayDropped++;
+        return;
+    }
+
+    *slot = record;
+}
+
+portMUX_TYPE TelemetryService::mux = portMUX_INITIALIZER_UNLOCKED;
+uint16_t TelemetryService::interval = 0;
+uint32_t TelemetryService::lastOwn = 0;
+uint8_t TelemetryService::sequence = 0;
+uint64_t TelemetryService::lastAirtime = 0;
+TelemetryRecord TelemetryService::relay[LM_TELEMETRY_RELAY_SLOTS];
+uint32_t TelemetryService::relayDropped = 0;
+LM_Telemetry* TelemetryService::nodes = nullptr;
+size_t TelemetryService::nodesLength = 0;
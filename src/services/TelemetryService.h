@@ -0,0 +1,138 @@
+#ifndef _LORAMESHER_TELEMETRY_SERVICE_H
+#define _LORAMESHER_TELEMETRY_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include "entities/packets/RoutePacket.h"
+
+/**
+ * @brief Telemetry of a node in the table of a gateway
+ *
+ */
+struct LM_Telemetry {
+    TelemetryRecord record;
+    // millis() when the gateway received the record
+    uint32_t receivedAt;
+};
+
+/**
+ * @brief Health of the nodes carried by the HELLOs, see LoraMesherConfig::telemetryInterval. A HELLO carries one
+ * TelemetryTrailer: the record of its source every telemetryInterval seconds, else a record of a node farther from the
+ * gateways waiting to be relayed. A node keeps to relay the records of the HELLOs of the neighbors with more hops to
+ * their best gateway, so the records go up to the gateways hop by hop without packets of their own. The gateways keep
+ * the newest record of every node in a table of LM_TELEMETRY_NODES nodes.
+ *
+ */
+class TelemetryService {
+public:
+
+    /**
+     * @brief Set the interval of the records of the node
+     *
+     * @param seconds Seconds between two records, 0 disables the telemetry
+     */
+    static void init(uint16_t seconds);
+
+    static bool isEnabled() { return interval != 0; }
+
+    /**
+     * @brief Returns if the record of the node is due
+     *
+     */
+    static bool isOwnDue();
+
+    /**
+     * @brief Returns if a HELLO has a record to carry, the one of the node or one to relay
+     *
+     */
+    static bool hasRecord();
+
+    /**
+     * @brief Fill the trailer of a HELLO just before sending it
+     *
+     * @param trailer Trailer
+     * @param gatewayHops Hops of the node to its best gateway, 0 for a gateway and UINT8_MAX without a route
+     * @param own Counters, heap and queues of the record of the node if it is due, else nullptr to relay a record
+     * @param airtime Time on air sent since the boot in ms, for the duty cycle of the record of the node
+     */
+    static void fill(TelemetryTrailer* trailer, uint8_t gatewayHops, const TelemetryRecord* own, uint64_t airtime);
+
+    /**
+     * @brief Process the trailer of a received HELLO
+     *
+     * @param trailer Trailer
+     * @param gatewayHops Hops of the node to its best gateway, 0 for a gateway and UINT8_MAX without a route
+     */
+    static void process(const TelemetryTrailer* trailer, uint8_t gatewayHops);
+
+    /**
+     * @brief Get the telemetry of a node in the table of the gateway
+     *
+     * @param address Address of the node
+     * @param telemetry Telemetry
+     * @return true If the node is in the table
+     */
+    static bool getNode(uint16_t address, LM_Telemetry& telemetry);
+
+    /**
+     * @brief Copy the table of the gateway
+     *
+     * @param telemetry Output telemetry of the nodes
+     * @param max Maximum number of nodes to copy
+     * @return size_t Number of nodes copied
+     */
+    static size_t getNodes(LM_Telemetry* telemetry, size_t max);
+
+    /**
+     * @brief Get the number of records not relayed because the relay slots were full
+     *
+     * @return uint32_t
+     */
+    static uint32_t getRelayDroppedNum() { return relayDropped; }
+
+private:
+
+    static portMUX_TYPE mux;
+
+    static uint16_t interval;
+
+    static uint32_t lastOwn;
+
+    static uint8_t sequence;
+
+    static uint64_t lastAirtime;
+
+    static TelemetryRecord relay[LM_TELEMETRY_RELAY_SLOTS];
+
+    static uint32_t relayDropped;
+
+    /**
+     * @brief Table of the gateway, allocated with the first record it keeps
+     *
+     */
+    static LM_Telemetry* nodes;
+
+    static size_t nodesLength;
+
+    /**
+     * @brief Returns if a record is newer than another of the same node
+     *
+     */
+    static bool isNewer(const TelemetryRecord& record, const TelemetryRecord& than) {
+        return (int8_t) (record.sequence - than.sequence) > 0;
+    }
+
+    /**
+     * @brief Keep a record in the table of the gateway, protected by the mux
+     *
+     */
+    static void store(const TelemetryRecord& record);
+
+    /**
+     * @brief Keep a record to relay it, protected by the mux
+     *
+     */
+    static void keepToRelay(const TelemetryRecord& record);
+};
+
+#endif
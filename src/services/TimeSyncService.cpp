@@ -0,0 +1,182 @@
+#include "TimeSyncService.h"
+
+#include <cstdlib>
+
+#include "RoleService.h"
+#include "WiFiService.h"
+
+bool TimeSyncService::isSynced() {
+    portENTER_CRITICAL(&mux);
+    checkTimeout();
+    bool synced = isRoot() || entries > 0;
+    portEXIT_CRITICAL(&mux);
+    return synced;
+}
+
+uint8_t TimeSyncService::getLevel() {
+    portENTER_CRITICAL(&mux);
+    checkTimeout();
+    uint8_t result = isRoot() ? 0 : entries > 0 ? level : UINT8_MAX;
+    portEXIT_CRITICAL(&mux);
+    return result;
+}
+
+uint16_t TimeSyncService::getRootAddress() {
+    portENTER_CRITICAL(&mux);
+    checkTimeout();
+    uint16_t result = isRoot() ? WiFiService::getLocalAddress() : entries > 0 ? rootAddress : 0;
+    portEXIT_CRITICAL(&mux);
+    return result;
+}
+
+bool TimeSyncService::toSyncedTime(int64_t localTime, int64_t& time) {
+    portENTER_CRITICAL(&mux);
+    checkTimeout();
+    bool synced = isRoot() || entries > 0;
+    if (synced)
+        time = getTime(localTime);
+    portEXIT_CRITICAL(&mux);
+    return synced;
+}
+
+bool TimeSyncService::stamp(TimeSyncTrailer* trailer, uint32_t timeOnAir) {
+    portENTER_CRITICAL(&mux);
+    checkTimeout();
+
+    bool root = isRoot();
+    bool synced = root || entries > 0;
+    if (synced) {
+        // Every HELLO of the root starts a synchronization round
+        if (root) {
+            rootAddress = WiFiService::getLocalAddress();
+            rootSequence++;
+            level = 0;
+        }
+
+        int64_t time = getTime(esp_timer_get_time() + LM_TIME_SYNC_TX_DELAY + timeOnAir);
+        trailer->root = rootAddress;
+        trailer->sequence = rootSequence;
+        trailer->level = level;
+        trailer->timeMs = (uint32_t) (time / 1000);
+        trailer->timeUs = (uint16_t) (time % 1000);
+    }
+
+    portEXIT_CRITICAL(&mux);
+    return synced;
+}
+
+void TimeSyncService::process(uint16_t src, const TimeSyncTrailer* trailer, int64_t receivedAt) {
+    // Not stamped, sent inside an aggregate frame or when the neighbor lost its root
+    if (trailer->root == 0 || trailer->timeUs >= 1000)
+        return;
+
+    int64_t time = (int64_t) trailer->timeMs * 1000 + trailer->timeUs;
+
+    portENTER_CRITICAL(&mux);
+    checkTimeout();
+
+    bool accepted;
+    if (isRoot())
+        accepted = trailer->root < WiFiService::getLocalAddress();
+    else if (entries == 0 || trailer->root < rootAddress)
+        accepted = true;
+    else
+        accepted = trailer->root == rootAddress && (int8_t) (trailer->sequence - rootSequence) > 0;
+
+    if (accepted) {
+        if (trailer->root != rootAddress)
+            entries = 0;
+
+        rootAddress = trailer->root;
+        rootSequence = trailer->sequence;
+        level = trailer->level < UINT8_MAX - 1 ? trailer->level + 1 : UINT8_MAX - 1;
+        lastUpdate = millis();
+        updates++;
+
+        addEntry(receivedAt, time - receivedAt);
+    }
+
+    portEXIT_CRITICAL(&mux);
+
+    if (accepted)
+        ESP_LOGV(LM_TAG, "Time of root %X round %d from %X, level %d", trailer->root, trailer->sequence, src, level);
+}
+
+bool TimeSyncService::isRoot() {
+    return RoleService::isGateway() && (rootAddress == 0 || rootAddress == WiFiService::getLocalAddress());
+}
+
+void TimeSyncService::checkTimeout() {
+    if (rootAddress == 0)
+        return;
+
+    if (rootAddress == WiFiService::getLocalAddress()) {
+        if (!RoleService::isGateway())
+            rootAddress = 0;
+        return;
+    }
+
+    if (millis() - lastUpdate > LM_TIME_SYNC_TIMEOUT) {
+        rootAddress = 0;
+        entries = 0;
+    }
+}
+
+int64_t TimeSyncService::getTime(int64_t localTime) {
+    if (isRoot())
+        return localTime;
+
+    return localTime + referenceOffset + (int64_t) (drift * (double) (localTime - referenceLocal));
+}
+
+void TimeSyncService::addEntry(int64_t localTime, int64_t offset) {
+    // A jump of the clock of the root, or of this node, starts again
+    if (entries > 0 && llabs(getTime(localTime) - (localTime + offset)) > LM_TIME_SYNC_MAX_ERROR)
+        entries = 0;
+
+    if (entries == 0)
+        nextEntry = 0;
+
+    entryLocal[nextEntry] = localTime;
+    entryOffset[nextEntry] = offset;
+    nextEntry = (nextEntry + 1) % LM_TIME_SYNC_WINDOW;
+    if (entries < LM_TIME_SYNC_WINDOW)
+        entries++;
+
+    // Least squares line of the offsets, relative to the newest entry so the sums stay small
+    double meanLocal = 0;
+    double meanOffset = 0;
+    for (uint8_t i = 0; i < entries; i++) {
+        meanLocal += (double) (entryLocal[i] - localTime);
+        meanOffset += (double) (entryOffset[i] - offset);
+    }
+    meanLocal /= entries;
+    meanOffset /= entries;
+
+    double sumLocal = 0;
+    double sumProduct = 0;
+    for (uint8_t i = 0; i < entries; i++) {
+        double x = (double) (entryLocal[i] - localTime) - meanLocal;
+        double y = (double) (entryOffset[i] - offset) - meanOffset;
+        sumLocal += x * x;
+        sumProduct += x * y;
+    }
+
+    drift = sumLocal > 0 ? sumProduct / sumLocal : 0;
+    referenceLocal = localTime + (int64_t) meanLocal;
+    referenceOffset = offset + (int64_t) meanOffset;
+}
+
+portMUX_TYPE TimeSyncService::mux = portMUX_INITIALIZER_UNLOCKED;
+uint16_t TimeSyncService::rootAddress = 0;
+uint8_t TimeSyncService::rootSequence = 0;
+uint8_t TimeSyncService::level = UINT8_MAX;
+uint32_t TimeSyncService::lastUpdate = 0;
+uint32_t TimeSyncService::updates = 0;
+int64_t TimeSyncService::entryLocal[LM_TIME_SYNC_WINDOW];
+int64_t TimeSyncService::entryOffset[LM_TIME_SYNC_WINDOW];
+uint8_t TimeSyncService::entries = 0;
+uint8_t TimeSyncService::nextEntry = 0;
+int64_t TimeSyncService::referenceLocal = 0;
+int64_t TimeSyncService::referenceOffset = 0;
+double TimeSyncService::drift = 0;
@@ -0,0 +1,135 @@
+#ifndef _LORAMESHER_TIME_SYNC_SERVICE_H
+#define _LORAMESHER_TIME_SYNC_SERVICE_H
+
+#include "BuildOptions.h"
+
+#include <esp_timer.h>
+
+#include "entities/packets/RoutePacket.h"
+
+/**
+ * @brief Time of the network, the clock of a gateway, see LoraMesherConfig::timeSync. The HELLOs of the synchronized nodes
+ * carry a TimeSyncTrailer stamped just before they are sent, with the time of the network when the frame ends, so the
+ * time on air of every hop is corrected. The receiver takes the receive interrupt time of the frame as its local time.
+ *
+ * The root is the gateway with the lowest address: a gateway is the root until it hears a HELLO of a lower one. Every
+ * synchronization round of the root has a sequence number, and a node only takes the first HELLO of every round, so the
+ * rounds go down the mesh from the root and the loops are dropped. The last LM_TIME_SYNC_WINDOW offsets of the local clock
+ * are fitted with a linear regression, the slope is the drift of the local clock.
+ *
+ */
+class TimeSyncService {
+public:
+
+    /**
+     * @brief Returns if the node has the time of the network, or it is the root
+     *
+     */
+    static bool isSynced();
+
+    /**
+     * @brief Hops from the root, 0 for the root
+     *
+     * @return uint8_t Level or UINT8_MAX if the node is not synchronized
+     */
+    static uint8_t getLevel();
+
+    /**
+     * @brief Address of the root, 0 if the node is not synchronized
+     *
+     * @return uint16_t
+     */
+    static uint16_t getRootAddress();
+
+    /**
+     * @brief Time of the network at a time of the local clock
+     *
+     * @param localTime Time of esp_timer_get_time in us
+     * @param time Time of the network in us
+     * @return true If the node is synchronized
+     */
+    static bool toSyncedTime(int64_t localTime, int64_t& time);
+
+    /**
+     * @brief Stamp the trailer of a HELLO just before sending it
+     *
+     * @param trailer Trailer
+     * @param timeOnAir Time on air of the frame in us
+     * @return true If it has been stamped, the trailer is left empty if the node is not synchronized anymore
+     */
+    static bool stamp(TimeSyncTrailer* trailer, uint32_t timeOnAir);
+
+    /**
+     * @brief Process the trailer of a received HELLO
+     *
+     * @param src Address of the neighbor
+     * @param trailer Trailer
+     * @param receivedAt Time of esp_timer_get_time in us when the frame ended
+     */
+    static void process(uint16_t src, const TimeSyncTrailer* trailer, int64_t receivedAt);
+
+    /**
+     * @brief Get the number of synchronizations taken from the neighbors
+     *
+     * @return uint32_t
+     */
+    static uint32_t getUpdatesNum() { return updates; }
+
+private:
+
+    static portMUX_TYPE mux;
+
+    static uint16_t rootAddress;
+
+    static uint8_t rootSequence;
+
+    static uint8_t level;
+
+    static uint32_t lastUpdate;
+
+    static uint32_t updates;
+
+    static int64_t entryLocal[LM_TIME_SYNC_WINDOW];
+
+    static int64_t entryOffset[LM_TIME_SYNC_WINDOW];
+
+    static uint8_t entries;
+
+    static uint8_t nextEntry;
+
+    /**
+     * @brief Regression of the entries, offset = referenceOffset + drift * (local - referenceLocal)
+     *
+     */
+    static int64_t referenceLocal;
+
+    static int64_t referenceOffset;
+
+    static double drift;
+
+    /**
+     * @brief Returns if the node is the root, protected by the mux
+     *
+     */
+    static bool isRoot();
+
+    /**
+     * @brief Forget the root when it has not been heard for LM_TIME_SYNC_TIMEOUT ms, protected by the mux
+     *
+     */
+    static void checkTimeout();
+
+    /**
+     * @brief Time of the network at a time of the local clock, protected by the mux
+     *
+     */
+    static int64_t getTime(int64_t localTime);
+
+    /**
+     * @brief Add an offset to the entries and fit the regression again, protected by the mux
+     *
+     */
+    static void addEntry(int64_t localTime, int64_t offset);
+};
+
+#endif
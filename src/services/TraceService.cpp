@@ -0,0 +1,63 @@
+#include "TraceService.h"
+
+#include <stdio.h>
+
+void TraceService::record(uint8_t category, uint8_t id, uint16_t a, uint16_t b, uint16_t c, uint32_t d) {
+    uint32_t timestamp = micros();
+
+    portENTER_CRITICAL(&mux);
+
+    if (head - tail == SLOTS) {
+        tail++;
+        overwritten++;
+    }
+
+    LM_TraceEvent& event = ring[head % SLOTS];
+    event.timestamp = timestamp;
+    event.id = id;
+    event.category = category;
+    event.a = a;
+    event.b = b;
+    event.c = c;
+    event.d = d;
+    head++;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+size_t TraceService::read(LM_TraceEvent* events, size_t maxEvents) {
+    size_t length = 0;
+
+    portENTER_CRITICAL(&mux);
+    while (length < maxEvents && tail != head)
+        events[length++] = ring[tail++ % SLOTS];
+    portEXIT_CRITICAL(&mux);
+
+    return length;
+}
+
+int TraceService::format(const LM_TraceEvent& event, char* buffer, size_t size) {
+    switch (event.id) {
+        case TRACE_SEND:
+        case TRACE_RECEIVE:
+            return snprintf(buffer, size, "%lu %s Src: %X Dst: %X Id: %u Type: %u Size: %u",
+                (unsigned long) event.timestamp, event.id == TRACE_SEND ? "send" : "received", event.a, event.b, event.c,
+                (unsigned) (event.d >> 8), (unsigned) (event.d & 0xFF));
+        case TRACE_ENQUEUE:
+            return snprintf(buffer, size, "%lu enqueued Src: %X Dst: %X Id: %u Queue: %lu",
+                (unsigned long) event.timestamp, event.a, event.b, event.c, (unsigned long) event.d);
+        case TRACE_QUEUE_DROP:
+            return snprintf(buffer, size, "%lu dropped Src: %X Dst: %X Id: %u %s",
+                (unsigned long) event.timestamp, event.a, event.b, event.c, event.d == 0 ? "expired" : "queue full");
+        default:
+            return snprintf(buffer, size, "%lu event %u: %u %u %u %lu",
+                (unsigned long) event.timestamp, event.id, event.a, event.b, event.c, (unsigned long) event.d);
+    }
+}
+
+constexpr uint32_t TraceService::SLOTS;
+portMUX_TYPE TraceService::mux = portMUX_INITIALIZER_UNLOCKED;
+LM_TraceEvent TraceService::ring[SLOTS];
+uint32_t TraceService::head = 0;
+uint32_t TraceService::tail = 0;
+uint32_t TraceService::overwritten = 0;
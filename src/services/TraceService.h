@@ -0,0 +1,111 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Event recorded by the trace, see TraceService
+ *
+ */
+struct LM_TraceEvent {
+    // micros() when it was recorded
+    uint32_t timestamp;
+    // LM_TraceEventId
+    uint8_t id;
+    // LM_TRACE_TX, LM_TRACE_RX, LM_TRACE_QUEUE
+    uint8_t category;
+    // Arguments of the event, see LM_TraceEventId
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+    uint32_t d;
+};
+
+/**
+ * @brief Events of the trace and their arguments
+ *
+ */
+enum LM_TraceEventId : uint8_t {
+    // A frame starts on air: src, dst, id, type << 8 | size
+    TRACE_SEND = 1,
+    // A frame has been received: src, dst, id, type << 8 | size
+    TRACE_RECEIVE = 2,
+    // A packet has been added to the send queue: src, dst, id, queue length
+    TRACE_ENQUEUE = 3,
+    // A packet has been dropped from the send queue: src, dst, id, 0 if it expired and 1 if the queue was full
+    TRACE_QUEUE_DROP = 4,
+};
+
+/**
+ * @brief Record an event if its category and level are compiled, see LM_TRACE_CATEGORIES and LM_TRACE_LEVEL. The arguments
+ * of the events that are not compiled are not evaluated
+ *
+ */
+#define LM_TRACE(category, level, event, a, b, c, d) \
+    do { \
+        if ((LM_TRACE_CATEGORIES & (category)) != 0 && (level) <= LM_TRACE_LEVEL) \
+            TraceService::record(category, event, a, b, c, d); \
+    } while (0)
+
+/**
+ * @brief Trace of the send and receive paths in binary events of fixed size. Recording an event only copies its arguments
+ * to a ring of LM_TRACE_RING_SLOTS events, overwriting the oldest ones, the events are formatted later by the consumer that
+ * reads them. Without LM_TRACE_CATEGORIES the trace is compiled out.
+ *
+ */
+class TraceService {
+public:
+
+    /**
+     * @brief Record an event, use LM_TRACE
+     *
+     */
+    static void record(uint8_t category, uint8_t id, uint16_t a, uint16_t b, uint16_t c, uint32_t d);
+
+    /**
+     * @brief Remove the oldest events of the ring
+     *
+     * @param events Array where the events are copied
+     * @param maxEvents Size of the array
+     * @return size_t Number of events copied
+     */
+    static size_t read(LM_TraceEvent* events, size_t maxEvents);
+
+    /**
+     * @brief Format an event as text
+     *
+     * @param event Event
+     * @param buffer Buffer of the text
+     * @param size Size of the buffer
+     * @return int Length of the text, see snprintf
+     */
+    static int format(const LM_TraceEvent& event, char* buffer, size_t size);
+
+    /**
+     * @brief Get the number of events overwritten before being read
+     *
+     * @return uint32_t
+     */
+    static uint32_t getOverwrittenNum() { return overwritten; }
+
+private:
+
+    static portMUX_TYPE mux;
+
+    /**
+     * @brief One slot when the trace is compiled out
+     *
+     */
+    static constexpr uint32_t SLOTS = LM_TRACE_CATEGORIES != 0 ? LM_TRACE_RING_SLOTS : 1;
+
+    static LM_TraceEvent ring[SLOTS];
+
+    /**
+     * @brief Events recorded and read since the boot, the ring index is modulo SLOTS
+     *
+     */
+    static uint32_t head;
+
+    static uint32_t tail;
+
+    static uint32_t overwritten;
+};
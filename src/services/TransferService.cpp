@@ -0,0 +1,133 @@
+#include "TransferService.h"
+
+LM_TransferHandle TransferService::start(uint16_t dst, const LM_TransferOptions& options) {
+    portENTER_CRITICAL(&mux);
+
+    Transfer* slot = nullptr;
+    for (Transfer& transfer : transfers) {
+        if (transfer.handle == 0) {
+            slot = &transfer;
+            break;
+        }
+
+        if (transfer.info.status != TRANSFER_PENDING &&
+            (slot == nullptr || (int32_t) (transfer.info.completedAt - slot->info.completedAt) < 0))
+            slot = &transfer;
+    }
+
+    if (slot == nullptr) {
+        portEXIT_CRITICAL(&mux);
+        return 0;
+    }
+
+    if (++nextHandle == 0)
+        nextHandle = 1;
+
+    slot->handle = nextHandle;
+    slot->info = LM_TransferInfo();
+    slot->info.dst = dst;
+    slot->info.status = TRANSFER_PENDING;
+    slot->info.startedAt = millis();
+    slot->options = options;
+    slot->waiter = nullptr;
+
+    LM_TransferHandle handle = slot->handle;
+
+    portEXIT_CRITICAL(&mux);
+    return handle;
+}
+
+void TransferService::cancel(LM_TransferHandle handle) {
+    portENTER_CRITICAL(&mux);
+
+    Transfer* transfer = find(handle);
+    if (transfer != nullptr)
+        transfer->handle = 0;
+
+    portEXIT_CRITICAL(&mux);
+}
+
+void TransferService::complete(LM_TransferHandle handle, bool delivered) {
+    portENTER_CRITICAL(&mux);
+
+    Transfer* transfer = find(handle);
+    if (transfer == nullptr || transfer->info.status != TRANSFER_PENDING) {
+        portEXIT_CRITICAL(&mux);
+        return;
+    }
+
+    LM_TransferStatus status = delivered ? TRANSFER_DELIVERED : TRANSFER_FAILED;
+    transfer->info.status = status;
+    transfer->info.completedAt = millis();
+
+    uint16_t dst = transfer->info.dst;
+    LM_TransferOptions options = transfer->options;
+    TaskHandle_t waiter = transfer->waiter;
+    transfer->waiter = nullptr;
+
+    portEXIT_CRITICAL(&mux);
+
+    ESP_LOGI(LM_TAG, "Transfer %d to %X %s", handle, dst, delivered ? "delivered" : "failed");
+
+    if (waiter != nullptr)
+        xTaskNotifyGive(waiter);
+
+    if (options.notifyTask != nullptr)
+        xTaskNotify(options.notifyTask, handle, eSetValueWithOverwrite);
+
+    if (options.callback != nullptr)
+        options.callback(handle, status, options.context);
+}
+
+bool TransferService::getInfo(LM_TransferHandle handle, LM_TransferInfo& info) {
+    portENTER_CRITICAL(&mux);
+
+    Transfer* transfer = find(handle);
+    if (transfer != nullptr)
+        info = transfer->info;
+    else
+        info = LM_TransferInfo();
+
+    portEXIT_CRITICAL(&mux);
+    return transfer != nullptr;
+}
+
+LM_TransferStatus TransferService::wait(LM_TransferHandle handle, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;) {
+        portENTER_CRITICAL(&mux);
+
+        Transfer* transfer = find(handle);
+        LM_TransferStatus status = transfer != nullptr ? transfer->info.status : TRANSFER_UNKNOWN;
+        if (status == TRANSFER_PENDING)
+            transfer->waiter = xTaskGetCurrentTaskHandle();
+
+        portEXIT_CRITICAL(&mux);
+
+        if (status != TRANSFER_PENDING)
+            return status;
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout)
+            return TRANSFER_PENDING;
+
+        ulTaskNotifyTake(pdTRUE, timeout == portMAX_DELAY ? portMAX_DELAY : timeout - elapsed);
+    }
+}
+
+TransferService::Transfer* TransferService::find(LM_TransferHandle handle) {
+    if (handle == 0)
+        return nullptr;
+
+    for (Transfer& transfer : transfers) {
+        if (transfer.handle == handle)
+            return &transfer;
+    }
+
+    return nullptr;
+}
+
+portMUX_TYPE TransferService::mux = portMUX_INITIALIZER_UNLOCKED;
+TransferService::Transfer TransferService::transfers[LM_MAX_TRANSFERS] = {};
+LM_TransferHandle TransferService::nextHandle = 0;
@@ -0,0 +1,120 @@
+#ifndef _LORAMESHER_TRANSFER_SERVICE_H
+#define _LORAMESHER_TRANSFER_SERVICE_H
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Handle of a reliable transfer, see LoraMesher::sendReliablePacket. 0 is no transfer
+ *
+ */
+typedef uint16_t LM_TransferHandle;
+
+enum LM_TransferStatus : uint8_t {
+    // The handle is not tracked, or its slot has been reused by a newer transfer
+    TRANSFER_UNKNOWN,
+    // The sequence is being sent
+    TRANSFER_PENDING,
+    // The destination has acknowledged every packet
+    TRANSFER_DELIVERED,
+    // Not delivered: timeouts, the route lost or the sequence discarded
+    TRANSFER_FAILED,
+};
+
+/**
+ * @brief Completion callback of a transfer. It runs in the task that ends the sequence, holding the waiting send
+ * sequences, so it must return quickly and must not send
+ *
+ */
+typedef void (*LM_TransferCallback)(LM_TransferHandle handle, LM_TransferStatus status, void* context);
+
+/**
+ * @brief Notifications of the completion of a transfer, every one is optional
+ *
+ */
+struct LM_TransferOptions {
+    LM_TransferCallback callback = nullptr;
+    void* context = nullptr;
+    // Notified with the handle as value, eSetValueWithOverwrite
+    TaskHandle_t notifyTask = nullptr;
+};
+
+struct LM_TransferInfo {
+    uint16_t dst = 0;
+    LM_TransferStatus status = TRANSFER_UNKNOWN;
+    // millis() when the transfer was started and ended, 0 while pending
+    uint32_t startedAt = 0;
+    uint32_t completedAt = 0;
+};
+
+/**
+ * @brief Status of the last LM_MAX_TRANSFERS reliable transfers of the application. A finished transfer keeps its slot
+ * until a new one needs it, the oldest finished first
+ *
+ */
+class TransferService {
+public:
+
+    /**
+     * @brief Start tracking a transfer
+     *
+     * @param dst Destination
+     * @param options Notifications of its completion
+     * @return LM_TransferHandle 0 if LM_MAX_TRANSFERS transfers are pending
+     */
+    static LM_TransferHandle start(uint16_t dst, const LM_TransferOptions& options);
+
+    /**
+     * @brief Stop tracking a transfer whose sequence has not been started, without notifications
+     *
+     */
+    static void cancel(LM_TransferHandle handle);
+
+    /**
+     * @brief End a transfer and notify it
+     *
+     * @param handle Transfer
+     * @param delivered If every packet has been acknowledged
+     */
+    static void complete(LM_TransferHandle handle, bool delivered);
+
+    /**
+     * @brief Get the status of a transfer
+     *
+     * @return true If the handle is tracked
+     */
+    static bool getInfo(LM_TransferHandle handle, LM_TransferInfo& info);
+
+    /**
+     * @brief Block the calling task until the transfer ends
+     *
+     * @param handle Transfer
+     * @param timeout Ticks to wait
+     * @return LM_TransferStatus TRANSFER_PENDING if it has not ended before the timeout
+     */
+    static LM_TransferStatus wait(LM_TransferHandle handle, TickType_t timeout);
+
+private:
+
+    struct Transfer {
+        LM_TransferHandle handle;
+        LM_TransferInfo info;
+        LM_TransferOptions options;
+        // Task blocked in wait
+        TaskHandle_t waiter;
+    };
+
+    static portMUX_TYPE mux;
+
+    static Transfer transfers[LM_MAX_TRANSFERS];
+
+    static LM_TransferHandle nextHandle;
+
+    /**
+     * @brief Find the slot of a handle, protected by the mux
+     *
+     * @return Transfer* nullptr if it is not tracked
+     */
+    static Transfer* find(LM_TransferHandle handle);
+};
+
+#endif
@@ -18,6 +18,13 @@ public:
      */
     static uint16_t getLocalAddress();
 
+    /**
+     * @brief Set the Local Address instead of the one from the MAC
+     *
+     * @param address Local Address, below LM_MULTICAST_ADDRESS
+     */
+    static void setLocalAddress(uint16_t address);
+
 private:
 
     /**
@@ -15,6 +15,13 @@ void WiFiService::init() {
     efuse_hal_get_mac(mac);
 #endif
     localAddress = (mac[4] << 8) | mac[5];
+
+    //The role and multicast addresses are reserved, such a node uses the same address in 0xFC00 to 0xFDFF
+    if (localAddress >= LM_MULTICAST_ADDRESS) {
+        ESP_LOGW(LM_TAG, "Address %X from the MAC is reserved, using %X", localAddress, localAddress & ~0x0200);
+        localAddress &= ~0x0200;
+    }
+
     ESP_LOGI(LM_TAG, "Local LoRa address (from WiFi MAC): %X", localAddress);
 }
 
@@ -24,4 +31,14 @@ uint16_t WiFiService::getLocalAddress() {
     return localAddress;
 }
 
+void WiFiService::setLocalAddress(uint16_t address) {
+    if (address == 0 || address >= LM_MULTICAST_ADDRESS) {
+        ESP_LOGE(LM_TAG, "Address %X is reserved, not set", address);
+        return;
+    }
+
+    localAddress = address;
+    ESP_LOGI(LM_TAG, "Local LoRa address: %X", localAddress);
+}
+
 uint16_t WiFiService::localAddress = 0;
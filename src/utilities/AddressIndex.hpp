@@ -0,0 +1,152 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Open addressing hash index from a 16 bit address, or another integer key, to an element.
+ * Uses linear probing with backward shift deletion, so there are no tombstones
+ * and lookups stay short even after many insertions and removals.
+ *
+ * It does not own the elements and it is not thread safe, the caller must
+ * provide the locking (e.g. the mutex of the list that owns the elements).
+ *
+ * @tparam T Element type
+ * @tparam Bits Number of slots is 2^Bits, keep it at least twice the maximum number of elements
+ * @tparam Key Integer key type, up to 32 bits
+ */
+template <class T, uint8_t Bits, class Key = uint16_t>
+class LM_AddressIndex {
+    static_assert(sizeof(Key) <= sizeof(uint32_t), "The key must fit in 32 bits");
+
+public:
+    static constexpr size_t CAPACITY = (size_t) 1 << Bits;
+
+    LM_AddressIndex() {
+        clear();
+    }
+
+    /**
+     * @brief Find the element with the given address
+     *
+     * @param address Address to be found
+     * @return T* pointer to the element or nullptr
+     */
+    T* find(Key address) const {
+        size_t i = hash(address);
+
+        while (slots[i].element != nullptr) {
+            if (slots[i].address == address)
+                return slots[i].element;
+
+            i = (i + 1) & MASK;
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * @brief Insert or replace the element with the given address
+     *
+     * @param address Address of the element
+     * @param element Element, cannot be nullptr
+     * @return true If inserted or replaced
+     * @return false If the index is full
+     */
+    bool insert(Key address, T* element) {
+        size_t i = hash(address);
+
+        while (slots[i].element != nullptr) {
+            if (slots[i].address == address) {
+                slots[i].element = element;
+                return true;
+            }
+
+            i = (i + 1) & MASK;
+        }
+
+        // Always keep at least one empty slot to terminate the probes
+        if (length + 1 >= CAPACITY)
+            return false;
+
+        slots[i].address = address;
+        slots[i].element = element;
+        length++;
+        return true;
+    }
+
+    /**
+     * @brief Remove the element with the given address
+     *
+     * @param address Address of the element
+     * @return T* The element removed or nullptr if not found
+     */
+    T* remove(Key address) {
+        size_t i = hash(address);
+
+        while (slots[i].element != nullptr && slots[i].address != address)
+            i = (i + 1) & MASK;
+
+        T* removed = slots[i].element;
+        if (removed == nullptr)
+            return nullptr;
+
+        // Backward shift the following entries of the cluster into the hole
+        size_t hole = i;
+        size_t j = i;
+        for (;;) {
+            j = (j + 1) & MASK;
+            if (slots[j].element == nullptr)
+                break;
+
+            size_t home = hash(slots[j].address);
+            // Move the entry if its home slot is not between the hole and j (cyclically)
+            if (((j - home) & MASK) >= ((j - hole) & MASK)) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+
+        slots[hole].element = nullptr;
+        length--;
+        return removed;
+    }
+
+    /**
+     * @brief Remove all the entries
+     *
+     */
+    void clear() {
+        for (size_t i = 0; i < CAPACITY; i++)
+            slots[i].element = nullptr;
+
+        length = 0;
+    }
+
+    /**
+     * @brief Number of elements inside the index
+     *
+     * @return size_t
+     */
+    size_t getLength() const {
+        return length;
+    }
+
+private:
+    static constexpr size_t MASK = CAPACITY - 1;
+
+    struct Slot {
+        Key address;
+        T* element;
+    };
+
+    Slot slots[CAPACITY];
+    size_t length;
+
+    /**
+     * @brief Fibonacci hashing, spreads the sequential addresses over the table
+     *
+     */
+    static size_t hash(Key address) {
+        return (size_t) (((uint32_t) address * 2654435769u) >> (32 - Bits));
+    }
+};
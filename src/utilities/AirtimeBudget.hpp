@@ -0,0 +1,142 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Token bucket of airtime for a regulatory duty cycle limit over a window.
+ * The bucket holds the burst capacity and refills with the window budget minus that capacity, spread over the window,
+ * so the airtime of any window is at most the window budget.
+ *
+ * Every class of frames has a share of the capacity reserved for the higher classes, its frames cannot take the tokens
+ * below it. The highest classes reserve nothing.
+ *
+ * The tokens are kept in us of airtime multiplied by the window in ms, so the refill has no rounding.
+ * It is only used by the send task, it does not lock.
+ */
+class LM_AirtimeBudget {
+public:
+    static constexpr uint8_t MAX_CLASSES = 4;
+
+    /**
+     * @brief Configure the budget, the bucket is filled
+     *
+     * @param limitPerMille Airtime allowed in the window, in per mille. 0 disables the budget
+     * @param windowMs Regulatory window in ms
+     * @param capacityMs Burst capacity in ms of airtime, limited to half of the window budget
+     * @param reservedShares Percentage of the capacity that the frames of every class cannot take, by class
+     * @param classes Number of classes, up to MAX_CLASSES
+     * @param now Current time, millis()
+     */
+    void configure(uint16_t limitPerMille, uint32_t windowMs, uint32_t capacityMs, const uint8_t* reservedShares, uint8_t classes,
+        uint32_t now) {
+        window = windowMs;
+        if (limitPerMille == 0 || windowMs == 0) {
+            refillPerWindow = 0;
+            return;
+        }
+
+        // Airtime of the window, in us
+        uint64_t budget = (uint64_t) limitPerMille * windowMs;
+        uint64_t capacityUs = (uint64_t) capacityMs * 1000;
+        if (capacityUs > budget / 2)
+            capacityUs = budget / 2;
+
+        refillPerWindow = budget - capacityUs;
+        capacity = capacityUs * window;
+        for (uint8_t i = 0; i < MAX_CLASSES; i++) {
+            uint8_t share = i < classes ? reservedShares[i] : 0;
+            reserved[i] = capacity * (share > 100 ? 100 : share) / 100;
+        }
+        tokens = capacity;
+        lastRefill = now;
+    }
+
+    bool isEnabled() const { return refillPerWindow != 0; }
+
+    /**
+     * @brief Time until a frame can be sent
+     *
+     * @param now Current time, millis()
+     * @param airtimeMs Time on air of the frame
+     * @param trafficClass Class of the frame, it cannot use its reserved share
+     * @return uint32_t Time in ms until the tokens refill, 0 if it can be sent now
+     */
+    uint32_t getWaitTime(uint32_t now, uint32_t airtimeMs, uint8_t trafficClass) {
+        if (!isEnabled())
+            return 0;
+
+        refill(now);
+
+        uint64_t needed = (uint64_t) airtimeMs * 1000 * window + (trafficClass < MAX_CLASSES ? reserved[trafficClass] : 0);
+        if (tokens >= needed)
+            return 0;
+
+        // A frame larger than the bucket is sent when it is full
+        if (needed > capacity)
+            needed = capacity;
+
+        return (uint32_t) ((needed - tokens + refillPerWindow - 1) / refillPerWindow);
+    }
+
+    /**
+     * @brief Take the airtime of a frame that is being sent
+     *
+     * @param now Current time, millis()
+     * @param airtimeMs Time on air of the frame
+     */
+    void consume(uint32_t now, uint32_t airtimeMs) {
+        if (!isEnabled())
+            return;
+
+        refill(now);
+
+        uint64_t used = (uint64_t) airtimeMs * 1000 * window;
+        tokens = tokens > used ? tokens - used : 0;
+    }
+
+    /**
+     * @brief Airtime left in the bucket
+     *
+     * @return uint32_t Airtime in ms
+     */
+    uint32_t getAvailableMs() const {
+        return window == 0 ? 0 : (uint32_t) (tokens / window / 1000);
+    }
+
+    /**
+     * @brief Part of the burst capacity left
+     *
+     * @param now Current time, millis()
+     * @return uint8_t Percent, 100 if the budget is disabled
+     */
+    uint8_t getAvailablePercent(uint32_t now) {
+        if (!isEnabled() || capacity == 0)
+            return 100;
+
+        refill(now);
+        return (uint8_t) (tokens * 100 / capacity);
+    }
+
+private:
+    uint32_t window = 0;
+    uint64_t refillPerWindow = 0;
+    uint64_t capacity = 0;
+    uint64_t reserved[MAX_CLASSES] = {};
+    uint64_t tokens = 0;
+    uint32_t lastRefill = 0;
+
+    void refill(uint32_t now) {
+        uint32_t elapsed = now - lastRefill;
+        lastRefill = now;
+
+        // A long idle time fills the bucket, without overflowing the product
+        if (elapsed >= window) {
+            tokens = capacity;
+            return;
+        }
+
+        tokens += (uint64_t) elapsed * refillPerWindow;
+        if (tokens > capacity)
+            tokens = capacity;
+    }
+};
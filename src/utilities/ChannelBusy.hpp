@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Estimator of the fraction of time the channel is busy, as sensed by the node: its own frames, the frames it
+ * receives and the channel activity it detects without a frame. The busy time of every window of LM_CHANNEL_BUSY_WINDOW ms
+ * goes to an EWMA with alpha 1/LM_CHANNEL_BUSY_SMOOTHING, the windows without activity count as idle.
+ *
+ * The busy time is added when the activity is known, it may exceed the window or overlap, the fraction is capped.
+ * It does not lock, the owner calls it inside its critical section.
+ */
+class LM_ChannelBusy {
+public:
+    /**
+     * @brief Add busy time to the current window
+     *
+     * @param now Current time, millis()
+     * @param busyMs Busy time in ms
+     */
+    void add(uint32_t now, uint32_t busyMs) {
+        roll(now);
+        busy += busyMs;
+    }
+
+    /**
+     * @brief Get the estimate of the busy fraction
+     *
+     * @param now Current time, millis()
+     * @return uint16_t Per mille, the current window only until the first one ends
+     */
+    uint16_t getPerMille(uint32_t now) {
+        roll(now);
+        if (!started)
+            return getWindowPerMille(now - windowStart);
+
+        return (uint16_t) (ewma + 0.5f);
+    }
+
+private:
+    uint32_t windowStart = 0;
+    uint32_t busy = 0;
+    float ewma = 0;
+    bool initialized = false;
+    bool started = false;
+
+    uint16_t getWindowPerMille(uint32_t elapsed) const {
+        if (elapsed == 0)
+            return 0;
+
+        uint64_t perMille = (uint64_t) busy * 1000 / elapsed;
+        return perMille > 1000 ? 1000 : perMille;
+    }
+
+    void roll(uint32_t now) {
+        if (!initialized) {
+            windowStart = now;
+            initialized = true;
+            return;
+        }
+
+        while (now - windowStart >= LM_CHANNEL_BUSY_WINDOW) {
+            float window = getWindowPerMille(LM_CHANNEL_BUSY_WINDOW);
+            ewma = started ? ewma + (window - ewma) / LM_CHANNEL_BUSY_SMOOTHING : window;
+            started = true;
+
+            busy = busy > LM_CHANNEL_BUSY_WINDOW ? busy - LM_CHANNEL_BUSY_WINDOW : 0;
+            windowStart += LM_CHANNEL_BUSY_WINDOW;
+
+            // A long idle time decays the estimate to 0
+            if (busy == 0 && now - windowStart >= LM_CHANNEL_BUSY_WINDOW * LM_CHANNEL_BUSY_SMOOTHING * 4) {
+                ewma = 0;
+                windowStart = now - (now - windowStart) % LM_CHANNEL_BUSY_WINDOW;
+            }
+        }
+    }
+};
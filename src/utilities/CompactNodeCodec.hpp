@@ -0,0 +1,131 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+#include "entities/routingTable/NetworkNode.h"
+
+/**
+ * @brief Compact wire encoding of the network nodes of a RoutePacket with ROUTE_COMPACT_F.
+ * Every node starts with a header byte, followed by the optional fields:
+ *
+ *   bits 0-3 metric, COMPACT_METRIC_EXTENDED if the metric is in the next byte
+ *   bit 4    role byte present, the role is 0 otherwise
+ *   bit 5    gateway load byte present, it is 255 otherwise
+ *   bit 6    address as one byte increment of the previous address, two bytes otherwise
+ *
+ * The nodes are sorted by address, so most of the addresses only need the increment.
+ * The previous address of the first node of a packet is 0.
+ */
+class LM_CompactNodeCodec {
+public:
+    static constexpr uint8_t METRIC_MASK = 0x0F;
+    static constexpr uint8_t METRIC_EXTENDED = 0x0F;
+    static constexpr uint8_t HAS_ROLE = 0x10;
+    static constexpr uint8_t HAS_GATEWAY_LOAD = 0x20;
+    static constexpr uint8_t ADDRESS_INCREMENT = 0x40;
+
+    /**
+     * @brief Maximum size of an encoded node
+     *
+     */
+    static constexpr size_t MAX_NODE_SIZE = 1 + 2 + 1 + 1 + 1;
+
+    /**
+     * @brief Encode one node
+     *
+     * @param node Node to be encoded
+     * @param previousAddress Address of the previous node in the packet, 0 for the first one
+     * @param out Output buffer
+     * @param maxLength Space left in the output buffer
+     * @return size_t Bytes written or 0 if the node does not fit
+     */
+    static size_t encode(const NetworkNode& node, uint16_t previousAddress, uint8_t* out, size_t maxLength) {
+        uint8_t header = 0;
+        size_t length = 1;
+
+        bool increment = node.address > previousAddress && node.address - previousAddress <= UINT8_MAX;
+        if (increment)
+            header |= ADDRESS_INCREMENT;
+        length += increment ? 1 : 2;
+
+        bool extendedMetric = node.metric >= METRIC_EXTENDED;
+        header |= extendedMetric ? METRIC_EXTENDED : node.metric;
+        if (extendedMetric)
+            length++;
+
+        if (node.role != 0) {
+            header |= HAS_ROLE;
+            length++;
+        }
+
+        if (node.gatewayLoad != 255) {
+            header |= HAS_GATEWAY_LOAD;
+            length++;
+        }
+
+        if (length > maxLength)
+            return 0;
+
+        size_t i = 0;
+        out[i++] = header;
+
+        if (increment)
+            out[i++] = node.address - previousAddress;
+        else {
+            out[i++] = node.address & 0xFF;
+            out[i++] = node.address >> 8;
+        }
+
+        if (extendedMetric)
+            out[i++] = node.metric;
+
+        if (header & HAS_ROLE)
+            out[i++] = node.role;
+
+        if (header & HAS_GATEWAY_LOAD)
+            out[i++] = node.gatewayLoad;
+
+        return i;
+    }
+
+    /**
+     * @brief Decode one node
+     *
+     * @param in Input buffer
+     * @param length Bytes left in the input buffer
+     * @param previousAddress Address of the previous node in the packet, 0 for the first one
+     * @param node Output node
+     * @return size_t Bytes read or 0 if the node is truncated
+     */
+    static size_t decode(const uint8_t* in, size_t length, uint16_t previousAddress, NetworkNode& node) {
+        if (length == 0)
+            return 0;
+
+        uint8_t header = in[0];
+        size_t needed = 1 + ((header & ADDRESS_INCREMENT) ? 1 : 2) +
+            ((header & METRIC_MASK) == METRIC_EXTENDED ? 1 : 0) +
+            ((header & HAS_ROLE) ? 1 : 0) +
+            ((header & HAS_GATEWAY_LOAD) ? 1 : 0);
+
+        if (needed > length)
+            return 0;
+
+        size_t i = 1;
+
+        if (header & ADDRESS_INCREMENT)
+            node.address = previousAddress + in[i++];
+        else {
+            node.address = in[i] | (in[i + 1] << 8);
+            i += 2;
+        }
+
+        node.metric = header & METRIC_MASK;
+        if (node.metric == METRIC_EXTENDED)
+            node.metric = in[i++];
+
+        node.role = (header & HAS_ROLE) ? in[i++] : 0;
+        node.gatewayLoad = (header & HAS_GATEWAY_LOAD) ? in[i++] : 255;
+
+        return i;
+    }
+};
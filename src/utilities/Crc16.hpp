@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief CRC-16/CCITT-FALSE, polynomial 0x1021 and initial value 0xFFFF, of the streamed frames
+ *
+ * @param data Data
+ * @param length Length in bytes
+ * @param crc CRC of the previous data to continue it, 0xFFFF to start
+ * @return uint16_t CRC
+ */
+inline uint16_t LM_Crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Fixed size cache of recently seen packets with time based expiry.
+ * A packet is identified by (src, id, type) plus an optional hash of the payload.
+ * The cache is 4 way set associative: a lookup only checks the 4 entries of one set, so it is O(1).
+ * When a set is full the oldest entry is replaced. Every entry counts the copies seen after the first one.
+ *
+ * It is thread safe, it uses its own critical section.
+ *
+ * @tparam SetBits Number of sets is 2^SetBits, total entries 4 * 2^SetBits
+ */
+template <uint8_t SetBits>
+class LM_DuplicateCache {
+    static_assert(SetBits > 0 && SetBits <= 16, "SetBits must be between 1 and 16");
+
+public:
+    static constexpr uint8_t WAYS = 4;
+    static constexpr size_t NUM_SETS = (size_t) 1 << SetBits;
+
+    /**
+     * @brief Construct a new duplicate cache
+     *
+     * @param timeoutMs Time in ms an entry is remembered
+     */
+    LM_DuplicateCache(uint32_t timeoutMs): timeoutMs(timeoutMs) {
+        clear();
+    }
+
+    /**
+     * @brief Check if the packet has been seen and remember it if not
+     *
+     * @param src Source address
+     * @param id Id or sequence number of the packet
+     * @param type Type of the packet
+     * @param payloadHash Hash of the payload, see hashPayload
+     * @return true If the packet has been seen before the timeout, its copies are incremented
+     * @return false If it is a new packet, it is added to the cache
+     */
+    bool checkAndAdd(uint16_t src, uint16_t id, uint8_t type = 0, uint32_t payloadHash = 0) {
+        uint32_t now = millis();
+        Entry* set = &entries[getSet(src, id, type) * WAYS];
+        Entry* replace = &set[0];
+
+        portENTER_CRITICAL(&cacheMux);
+
+        for (uint8_t i = 0; i < WAYS; i++) {
+            Entry* entry = &set[i];
+            bool expired = !entry->valid || now - entry->timestamp >= timeoutMs;
+
+            if (!expired && entry->src == src && entry->id == id && entry->type == type && entry->hash == payloadHash) {
+                if (entry->copies < UINT8_MAX)
+                    entry->copies++;
+
+                // Remembered while the copies are heard
+                entry->timestamp = now;
+
+                portEXIT_CRITICAL(&cacheMux);
+                return true;
+            }
+
+            // Prefer expired entries, else the oldest one
+            if (expired) {
+                if (replace->valid && now - replace->timestamp < timeoutMs)
+                    replace = entry;
+            }
+            else if (replace->valid && now - entry->timestamp > now - replace->timestamp) {
+                replace = entry;
+            }
+        }
+
+        replace->src = src;
+        replace->id = id;
+        replace->type = type;
+        replace->hash = payloadHash;
+        replace->timestamp = now;
+        replace->copies = 0;
+        replace->valid = true;
+
+        portEXIT_CRITICAL(&cacheMux);
+        return false;
+    }
+
+    /**
+     * @brief Get the copies of a packet seen after the first one, see checkAndAdd
+     *
+     * @param src Source address
+     * @param id Id or sequence number of the packet
+     * @param type Type of the packet
+     * @param payloadHash Hash of the payload, see hashPayload
+     * @return uint8_t Copies, 0 if the packet is not in the cache
+     */
+    uint8_t getCopies(uint16_t src, uint16_t id, uint8_t type = 0, uint32_t payloadHash = 0) {
+        uint32_t now = millis();
+        Entry* set = &entries[getSet(src, id, type) * WAYS];
+        uint8_t copies = 0;
+
+        portENTER_CRITICAL(&cacheMux);
+
+        for (uint8_t i = 0; i < WAYS; i++) {
+            Entry* entry = &set[i];
+            if (entry->valid && now - entry->timestamp < timeoutMs && entry->src == src && entry->id == id &&
+                entry->type == type && entry->hash == payloadHash) {
+                copies = entry->copies;
+                break;
+            }
+        }
+
+        portEXIT_CRITICAL(&cacheMux);
+        return copies;
+    }
+
+    /**
+     * @brief Forget all the entries
+     *
+     */
+    void clear() {
+        for (size_t i = 0; i < NUM_SETS * WAYS; i++)
+            entries[i].valid = false;
+    }
+
+    /**
+     * @brief FNV-1a hash of a payload
+     *
+     * @param payload Payload
+     * @param length Length of the payload in bytes
+     * @return uint32_t Hash
+     */
+    static uint32_t hashPayload(const uint8_t* payload, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= payload[i];
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+private:
+    struct Entry {
+        uint32_t timestamp;
+        uint32_t hash;
+        uint16_t src;
+        uint16_t id;
+        uint8_t type;
+        uint8_t copies;
+        bool valid;
+    };
+
+    Entry entries[NUM_SETS * WAYS];
+    uint32_t timeoutMs;
+    portMUX_TYPE cacheMux = portMUX_INITIALIZER_UNLOCKED;
+
+    static size_t getSet(uint16_t src, uint16_t id, uint8_t type) {
+        uint32_t key = ((uint32_t) src << 16 | id) ^ ((uint32_t) type << 8);
+        return (size_t) ((key * 2654435769u) >> (32 - SetBits));
+    }
+};
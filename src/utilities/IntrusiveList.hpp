@@ -0,0 +1,199 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+#include "ListLock.hpp"
+
+/**
+ * @brief Iterator of a LM_IntrusiveList with its own cursor, it does not move the current element of the list
+ *
+ */
+template <class T>
+class LM_IntrusiveIterator {
+public:
+    explicit LM_IntrusiveIterator(T* element) : element(element) {}
+
+    T* operator*() const { return element; }
+
+    LM_IntrusiveIterator& operator++() {
+        element = element->listNext;
+        return *this;
+    }
+
+    bool operator!=(const LM_IntrusiveIterator& other) const { return element != other.element; }
+
+private:
+    T* element;
+};
+
+/**
+ * @brief Doubly linked list with the links inside the elements, adding an element does not allocate.
+ * The element type needs the fields T* listPrev and T* listNext, so an element can only be in one of these lists at a time.
+ *
+ * Same interface and locking convention as LM_LinkedList: setInUse to use the current element and modify the list,
+ * setInUseShared to read it with the iterators. Removing an element does not delete it.
+ *
+ * @tparam T Element type
+ */
+template <class T>
+class LM_IntrusiveList {
+private:
+    size_t length = 0;
+    T* head = nullptr;
+    T* tail = nullptr;
+    T* curr = nullptr;
+    LM_ListLock lock;
+
+    /**
+     * @brief Link the element before the given one, at the end if nullptr
+     *
+     */
+    void linkBefore(T* element, T* before) {
+        element->listNext = before;
+        element->listPrev = before != nullptr ? before->listPrev : tail;
+
+        if (element->listPrev != nullptr)
+            element->listPrev->listNext = element;
+        else
+            head = element;
+
+        if (before != nullptr)
+            before->listPrev = element;
+        else
+            tail = element;
+
+        length++;
+    }
+
+public:
+    LM_IntrusiveList() {}
+
+    LM_IntrusiveList(const LM_IntrusiveList&) = delete;
+    LM_IntrusiveList& operator=(const LM_IntrusiveList&) = delete;
+
+    ~LM_IntrusiveList() {
+        Clear();
+    }
+
+    T* getCurrent() { return curr; }
+
+    T* First() const { return head; }
+
+    T* Last() const { return tail; }
+
+    size_t getLength() { return length; }
+
+    void Append(T* element) {
+        linkBefore(element, nullptr);
+
+        if (length == 1)
+            curr = element;
+    }
+
+    /**
+     * @brief Add the element before the current one
+     *
+     */
+    void addCurrent(T* element) {
+        if (length == 0) {
+            Append(element);
+            return;
+        }
+
+        linkBefore(element, curr);
+    }
+
+    T* Pop() {
+        moveToStart();
+        T* element = getCurrent();
+        DeleteCurrent();
+        return element;
+    }
+
+    bool Search(T* element) {
+        for (curr = head; curr != nullptr; curr = curr->listNext) {
+            if (curr == element)
+                return true;
+        }
+
+        curr = head;
+        return false;
+    }
+
+    /**
+     * @brief Remove the current element, the next one becomes the current, or the previous one if it was the last
+     *
+     */
+    void DeleteCurrent() {
+        if (curr == nullptr)
+            return;
+
+        T* removed = curr;
+
+        if (removed->listPrev != nullptr)
+            removed->listPrev->listNext = removed->listNext;
+        else
+            head = removed->listNext;
+
+        if (removed->listNext != nullptr)
+            removed->listNext->listPrev = removed->listPrev;
+        else
+            tail = removed->listPrev;
+
+        curr = removed->listNext != nullptr ? removed->listNext : removed->listPrev;
+
+        removed->listPrev = nullptr;
+        removed->listNext = nullptr;
+        length--;
+    }
+
+    bool next() {
+        if (curr == nullptr || curr->listNext == nullptr)
+            return false;
+
+        curr = curr->listNext;
+        return true;
+    }
+
+    bool moveToStart() {
+        curr = head;
+        return length != 0;
+    }
+
+    bool prev() {
+        if (curr == nullptr || curr->listPrev == nullptr)
+            return false;
+
+        curr = curr->listPrev;
+        return true;
+    }
+
+    /**
+     * @brief Remove all the elements, they are not deleted
+     *
+     */
+    void Clear() {
+        T* element = head;
+        while (element != nullptr) {
+            T* nextElement = element->listNext;
+            element->listPrev = nullptr;
+            element->listNext = nullptr;
+            element = nextElement;
+        }
+
+        head = curr = tail = nullptr;
+        length = 0;
+    }
+
+    void setInUse() { lock.lock(); }
+
+    void releaseInUse() { lock.unlock(); }
+
+    void setInUseShared() { lock.lockShared(); }
+
+    void releaseInUseShared() { lock.unlockShared(); }
+
+    LM_IntrusiveIterator<T> begin() const { return LM_IntrusiveIterator<T>(head); }
+
+    LM_IntrusiveIterator<T> end() const { return LM_IntrusiveIterator<T>(nullptr); }
+};
@@ -4,6 +4,10 @@
 
 #include "BuildOptions.h"
 
+#include "ListLock.hpp"
+
+#include "services/MemoryService.h"
+
 template <class T>
 class LM_ListNode {
 public:
@@ -16,6 +20,42 @@ public:
     };
 };
 
+/**
+ * @brief Iterator of a LM_LinkedList with its own cursor, it does not move the current element of the list.
+ * Several tasks can iterate the list at the same time with the shared lock.
+ *
+ * Example:
+ *   list->setInUseShared();
+ *   for (RouteNode* node : *list)
+ *       ...
+ *   list->releaseInUseShared();
+ */
+template <class T>
+class LM_ListIterator {
+public:
+    explicit LM_ListIterator(LM_ListNode<T>* node) : node(node) {}
+
+    T* operator*() const { return node->element; }
+
+    LM_ListIterator& operator++() {
+        node = node->next;
+        return *this;
+    }
+
+    bool operator!=(const LM_ListIterator& other) const { return node != other.node; }
+
+private:
+    LM_ListNode<T>* node;
+};
+
+/**
+ * @brief Doubly linked list with a current element.
+ *
+ * Locking: setInUse takes the list for one task, it can use the current element and modify the list.
+ * setInUseShared takes it for reading, several tasks at the same time, they can only use the iterators and the
+ * functions that do not move the current element (First, Last, getLength). The writers wait for the readers,
+ * and the new readers wait for a waiting writer. The locks are not recursive.
+ */
 template <class T>
 class LM_LinkedList {
 private:
@@ -23,7 +63,7 @@ private:
     LM_ListNode<T>* head;
     LM_ListNode<T>* tail;
     LM_ListNode<T>* curr;
-    SemaphoreHandle_t xSemaphore;
+    LM_ListLock lock;
 public:
     LM_LinkedList();
     LM_LinkedList(LM_LinkedList<T>& list);
@@ -44,7 +84,11 @@ public:
     void Clear();
     void setInUse();
     void releaseInUse();
+    void setInUseShared();
+    void releaseInUseShared();
     void each(void (*func)(T*));
+    LM_ListIterator<T> begin() const { return LM_ListIterator<T>(head); }
+    LM_ListIterator<T> end() const { return LM_ListIterator<T>(nullptr); }
 };
 
 template <class T>
@@ -53,13 +97,6 @@ LM_LinkedList<T>::LM_LinkedList() {
     head = nullptr;
     tail = nullptr;
     curr = nullptr;
-
-    /* Attempt to create a semaphore. */
-    xSemaphore = xSemaphoreCreateMutex();
-
-    if (xSemaphore == NULL) {
-        ESP_LOGE(LM_TAG, "Semaphore in Linked List not created");
-    }
 }
 
 template<class T>
@@ -69,14 +106,6 @@ inline LM_LinkedList<T>::LM_LinkedList(LM_LinkedList<T>& list) {
     tail = nullptr;
     curr = nullptr;
 
-    /* Attempt to create a semaphore. */
-    xSemaphore = xSemaphoreCreateMutex();
-
-    if (xSemaphore == NULL) {
-        ESP_LOGE(LM_TAG, "Semaphore in Linked List not created");
-    }
-
-
     list.setInUse();
 
     if (list.moveToStart()) {
@@ -92,7 +121,6 @@ inline LM_LinkedList<T>::LM_LinkedList(LM_LinkedList<T>& list) {
 template <class T>
 LM_LinkedList<T>::~LM_LinkedList() {
     Clear();
-    vSemaphoreDelete(xSemaphore);
 }
 
 template<class T>
@@ -134,6 +162,7 @@ size_t LM_LinkedList<T>::getLength() {
 template <class T>
 void LM_LinkedList<T>::Append(T* element) {
     LM_ListNode<T>* node = new LM_ListNode<T>(element, tail, nullptr);
+    MemoryService::add(MEMORY_LISTS, sizeof(LM_ListNode<T>));
 
     if (length == 0)
         curr = tail = head = node;
@@ -158,6 +187,7 @@ void LM_LinkedList<T>::addCurrent(T* element) {
     }
 
     LM_ListNode<T>* node = new LM_ListNode<T>(element, curr->prev, curr);
+    MemoryService::add(MEMORY_LISTS, sizeof(LM_ListNode<T>));
 
     if (curr->prev != nullptr) {
         curr->prev->next = node;
@@ -248,6 +278,7 @@ void LM_LinkedList<T>::DeleteCurrent() {
         curr = curr->next;
 
     delete temp;
+    MemoryService::remove(MEMORY_LISTS, sizeof(LM_ListNode<T>));
 }
 
 template <class T>
@@ -259,6 +290,7 @@ void LM_LinkedList<T>::Clear() {
     while (temp != nullptr) {
         head = head->next;
         delete temp;
+        MemoryService::remove(MEMORY_LISTS, sizeof(LM_ListNode<T>));
         temp = head;
     }
 
@@ -269,14 +301,22 @@ void LM_LinkedList<T>::Clear() {
 
 template <class T>
 void LM_LinkedList<T>::setInUse() {
-    while (xSemaphoreTake(xSemaphore, (TickType_t) 10) != pdTRUE) {
-        ESP_LOGW(LM_TAG, "List in Use Alert");
-    }
+    lock.lock();
 }
 
 template <class T>
 void LM_LinkedList<T>::releaseInUse() {
-    xSemaphoreGive(xSemaphore);
+    lock.unlock();
+}
+
+template <class T>
+void LM_LinkedList<T>::setInUseShared() {
+    lock.lockShared();
+}
+
+template <class T>
+void LM_LinkedList<T>::releaseInUseShared() {
+    lock.unlockShared();
 }
 
 template <class T>
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Lock of the lists, exclusive for the writers and shared for the readers.
+ * A writer keeps the mutex while it waits for the current readers, so the new readers wait behind it.
+ * The last reader gives readersDone to the waiting writer. It is not recursive.
+ */
+class LM_ListLock {
+public:
+    LM_ListLock() {
+        /* Attempt to create a semaphore. */
+        mutex = xSemaphoreCreateMutex();
+        readersDone = xSemaphoreCreateBinary();
+
+        if (mutex == NULL || readersDone == NULL) {
+            ESP_LOGE(LM_TAG, "Semaphore in Linked List not created");
+        }
+    }
+
+    ~LM_ListLock() {
+        vSemaphoreDelete(mutex);
+        vSemaphoreDelete(readersDone);
+    }
+
+    LM_ListLock(const LM_ListLock&) = delete;
+    LM_ListLock& operator=(const LM_ListLock&) = delete;
+
+    /**
+     * @brief Take the lock for one task, it waits for the readers
+     *
+     */
+    void lock() {
+        takeMutex();
+
+        portENTER_CRITICAL(&readersMux);
+        bool wait = readers > 0;
+        writerWaiting = wait;
+        portEXIT_CRITICAL(&readersMux);
+
+        if (wait)
+            xSemaphoreTake(readersDone, portMAX_DELAY);
+    }
+
+    void unlock() {
+        xSemaphoreGive(mutex);
+    }
+
+    /**
+     * @brief Take the lock for reading, with the other readers
+     *
+     */
+    void lockShared() {
+        takeMutex();
+
+        portENTER_CRITICAL(&readersMux);
+        readers++;
+        portEXIT_CRITICAL(&readersMux);
+
+        xSemaphoreGive(mutex);
+    }
+
+    void unlockShared() {
+        portENTER_CRITICAL(&readersMux);
+        bool last = --readers == 0 && writerWaiting;
+        if (last)
+            writerWaiting = false;
+        portEXIT_CRITICAL(&readersMux);
+
+        if (last)
+            xSemaphoreGive(readersDone);
+    }
+
+private:
+    SemaphoreHandle_t mutex;
+    SemaphoreHandle_t readersDone;
+    size_t readers = 0;
+    bool writerWaiting = false;
+    portMUX_TYPE readersMux = portMUX_INITIALIZER_UNLOCKED;
+
+    void takeMutex() {
+        while (xSemaphoreTake(mutex, (TickType_t) 10) != pdTRUE) {
+            ESP_LOGW(LM_TAG, "List in Use Alert");
+        }
+    }
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Single producer, single consumer lock free ring of fixed packet slots.
+ * The producer writes the packet directly into a slot, so it never allocates nor waits for the consumer.
+ * When the ring is full the packet is dropped and the overflow counter incremented.
+ *
+ * Only one task can write and only one task can read.
+ *
+ * @tparam Slots Number of slots, power of two
+ * @tparam SlotSize Size in bytes of every slot
+ */
+template <size_t Slots, size_t SlotSize>
+class LM_PacketRing {
+    static_assert(Slots > 0 && (Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+
+public:
+    struct Slot {
+        size_t length;
+        int8_t rssi;
+        int8_t snr;
+        // micros() when the receive interrupt fired
+        uint32_t timestamp;
+        uint8_t data[SlotSize];
+    };
+
+    static constexpr size_t SLOT_SIZE = SlotSize;
+
+    /**
+     * @brief Get the slot to be written by the producer
+     *
+     * @return Slot* Free slot or nullptr if the ring is full, the overflow counter is incremented
+     */
+    Slot* acquireWrite() {
+        uint32_t head = writeIndex.load(std::memory_order_relaxed);
+        if (head - readIndex.load(std::memory_order_acquire) >= Slots) {
+            overflows++;
+            return nullptr;
+        }
+
+        return &slots[head & (Slots - 1)];
+    }
+
+    /**
+     * @brief Publish the slot given by acquireWrite to the consumer
+     *
+     */
+    void commitWrite() {
+        writeIndex.store(writeIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Get the oldest slot written, without removing it
+     *
+     * @return Slot* Slot or nullptr if the ring is empty
+     */
+    Slot* peekRead() {
+        uint32_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == writeIndex.load(std::memory_order_acquire))
+            return nullptr;
+
+        return &slots[tail & (Slots - 1)];
+    }
+
+    /**
+     * @brief Release the slot given by peekRead to the producer
+     *
+     */
+    void releaseRead() {
+        readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Number of slots written and not read yet
+     *
+     * @return size_t
+     */
+    size_t getLength() const {
+        // Read the consumer index first, the producer index can only be greater
+        uint32_t tail = readIndex.load(std::memory_order_acquire);
+        return writeIndex.load(std::memory_order_acquire) - tail;
+    }
+
+    /**
+     * @brief Number of packets dropped because the ring was full
+     *
+     * @return uint32_t
+     */
+    uint32_t getOverflows() const {
+        return overflows;
+    }
+
+private:
+    Slot slots[Slots];
+    std::atomic<uint32_t> writeIndex{0};
+    std::atomic<uint32_t> readIndex{0};
+    uint32_t overflows = 0;
+};
@@ -0,0 +1,468 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Priority queue with one FIFO bucket per priority, from 0 to MAX_PRIORITY.
+ * A bitmap of the non empty buckets gives the highest priority directly. A higher priority is popped first.
+ *
+ * Every element belongs to a flow, the next hop of the packet. Inside the highest priority the flows are served
+ * with deficit round robin, weighted by the airtime of the packets, so a burst to one next hop does not delay the
+ * other flows. Elements of the same flow and priority keep their insertion order.
+ * There are LM_SEND_FLOWS flows at a time, the elements of the flows that do not fit share the first flow.
+ *
+ * Add is O(1), Pop and Remove are linear in the number of elements with the same priority.
+ * RemoveOldest and RemoveLowerPriority make room in a bounded queue, they are O(1) in the number of elements.
+ *
+ * The element type needs a priority field and a packet with a packetSize. Priorities above MAX_PRIORITY are stored as MAX_PRIORITY.
+ * The links are fields of the element, T* queueNext, uint32_t queueOrder, uint8_t queueFlow and uint16_t queueKey, adding an
+ * element does not allocate. An element can only be in one of these queues at a time.
+ * Same locking convention as LM_LinkedList, the caller uses setInUse and releaseInUse.
+ *
+ * @tparam T Element type
+ */
+template <class T>
+class LM_PriorityQueue {
+private:
+    static_assert(MAX_PRIORITY < 64, "MAX_PRIORITY does not fit in the bucket bitmap");
+
+    static constexpr uint8_t NUM_BUCKETS = MAX_PRIORITY + 1;
+
+    // The elements are the nodes of the buckets
+    typedef T Node;
+
+    struct Flow {
+        uint16_t key;
+        uint16_t length;
+        uint32_t deficit;
+        bool fresh;
+    };
+
+    Node* heads[NUM_BUCKETS];
+    Node* tails[NUM_BUCKETS];
+    uint64_t nonEmptyBuckets;
+    size_t length;
+    Node* curr;
+    uint8_t currBucket;
+    Flow flows[LM_SEND_FLOWS];
+    uint8_t currFlow;
+    uint32_t nextOrder;
+    SemaphoreHandle_t xSemaphore;
+
+    static uint8_t getBucket(uint8_t priority) {
+        return priority > MAX_PRIORITY ? MAX_PRIORITY : priority;
+    }
+
+    /**
+     * @brief Returns the highest non empty bucket that is lower than the given limit
+     *
+     * @param limit Limit bucket, not included. NUM_BUCKETS to search in all the buckets
+     * @param bucket Output bucket
+     * @return true If there is a non empty bucket
+     */
+    bool highestBucketBelow(uint8_t limit, uint8_t& bucket) const {
+        uint64_t mask = nonEmptyBuckets & ((((uint64_t) 1) << limit) - 1);
+        if (mask == 0)
+            return false;
+
+        bucket = 63 - __builtin_clzll(mask);
+        return true;
+    }
+
+    /**
+     * @brief Returns the lowest non empty bucket
+     *
+     * @param bucket Output bucket
+     * @return true If the queue is not empty
+     */
+    bool lowestBucket(uint8_t& bucket) const {
+        if (nonEmptyBuckets == 0)
+            return false;
+
+        bucket = __builtin_ctzll(nonEmptyBuckets);
+        return true;
+    }
+
+    /**
+     * @brief Airtime cost of the element, the packet bytes plus the fixed overhead of a frame
+     *
+     */
+    static uint32_t getCost(T* element) {
+        return element->packet->packetSize + LM_DRR_FRAME_OVERHEAD;
+    }
+
+    /**
+     * @brief Get the flow with the key, or a free flow for it. The first flow if there is no free flow
+     *
+     */
+    uint8_t getFlow(uint16_t key) {
+        uint8_t freeFlow = LM_SEND_FLOWS;
+
+        for (uint8_t i = 0; i < LM_SEND_FLOWS; i++) {
+            if (flows[i].length > 0 && flows[i].key == key)
+                return i;
+
+            if (flows[i].length == 0 && freeFlow == LM_SEND_FLOWS)
+                freeFlow = i;
+        }
+
+        if (freeFlow == LM_SEND_FLOWS)
+            return 0;
+
+        flows[freeFlow].key = key;
+        flows[freeFlow].deficit = 0;
+        flows[freeFlow].fresh = true;
+        return freeFlow;
+    }
+
+    /**
+     * @brief Unlink the node from the bucket and return it
+     *
+     * @param bucket Bucket of the node
+     * @param previous Previous node in the bucket or nullptr if it is the head
+     * @param node Node to be removed
+     * @return T* Element of the node
+     */
+    T* unlink(uint8_t bucket, Node* previous, Node* node) {
+        if (previous == nullptr)
+            heads[bucket] = node->queueNext;
+        else
+            previous->queueNext = node->queueNext;
+
+        if (tails[bucket] == node)
+            tails[bucket] = previous;
+
+        if (heads[bucket] == nullptr)
+            nonEmptyBuckets &= ~(((uint64_t) 1) << bucket);
+
+        if (curr == node)
+            curr = nullptr;
+
+        Flow& flow = flows[node->queueFlow];
+        flow.length--;
+        if (flow.length == 0)
+            flow.deficit = 0;
+
+        node->queueNext = nullptr;
+        length--;
+        return node;
+    }
+
+public:
+    LM_PriorityQueue() {
+        for (uint8_t i = 0; i < NUM_BUCKETS; i++) {
+            heads[i] = nullptr;
+            tails[i] = nullptr;
+        }
+
+        for (uint8_t i = 0; i < LM_SEND_FLOWS; i++)
+            flows[i] = Flow{0, 0, 0, true};
+
+        nonEmptyBuckets = 0;
+        length = 0;
+        curr = nullptr;
+        currBucket = 0;
+        currFlow = 0;
+        nextOrder = 0;
+
+        /* Attempt to create a semaphore. */
+        xSemaphore = xSemaphoreCreateMutex();
+
+        if (xSemaphore == NULL) {
+            ESP_LOGE(LM_TAG, "Semaphore in Priority Queue not created");
+        }
+    }
+
+    ~LM_PriorityQueue() {
+        Clear();
+        vSemaphoreDelete(xSemaphore);
+    }
+
+    size_t getLength() {
+        return length;
+    }
+
+    /**
+     * @brief Add the element at the end of the bucket of its priority
+     *
+     * @param element Element to be added
+     * @param flowKey Flow of the element, the next hop of the packet
+     */
+    void Add(T* element, uint16_t flowKey = BROADCAST_ADDR) {
+        uint8_t bucket = getBucket(element->priority);
+        uint8_t flow = getFlow(flowKey);
+        Node* node = element;
+        node->queueNext = nullptr;
+        node->queueOrder = nextOrder++;
+        node->queueFlow = flow;
+        node->queueKey = flowKey;
+        flows[flow].length++;
+
+        if (tails[bucket] == nullptr)
+            heads[bucket] = node;
+        else
+            tails[bucket]->queueNext = node;
+
+        tails[bucket] = node;
+        nonEmptyBuckets |= ((uint64_t) 1) << bucket;
+        length++;
+    }
+
+    /**
+     * @brief Remove and return the next element of the highest priority, choosing the flow with deficit round robin
+     *
+     * @return T* Element or nullptr if empty
+     */
+    T* Pop() {
+        uint8_t bucket;
+        if (!highestBucketBelow(NUM_BUCKETS, bucket))
+            return nullptr;
+
+        // The quantum is at least the cost of any element, every flow with elements is served in one round
+        for (uint8_t visited = 0; visited <= LM_SEND_FLOWS; visited++) {
+            Flow& flow = flows[currFlow];
+
+            Node* previous = nullptr;
+            Node* node = flow.length > 0 ? heads[bucket] : nullptr;
+            while (node != nullptr && node->queueFlow != currFlow) {
+                previous = node;
+                node = node->queueNext;
+            }
+
+            if (node != nullptr) {
+                if (flow.fresh) {
+                    flow.deficit += LM_DRR_QUANTUM;
+                    flow.fresh = false;
+                }
+
+                uint32_t cost = getCost(node);
+                if (flow.deficit >= cost) {
+                    flow.deficit -= cost;
+                    return unlink(bucket, previous, node);
+                }
+            }
+            else
+                // A flow without elements in this priority does not keep the deficit
+                flow.deficit = 0;
+
+            flow.fresh = true;
+            currFlow = (currFlow + 1) % LM_SEND_FLOWS;
+        }
+
+        return unlink(bucket, nullptr, heads[bucket]);
+    }
+
+    /**
+     * @brief Remove the element from its bucket, the element is not deleted.
+     * The priority of the element must not have changed since it was added
+     *
+     * @param element Element to be removed
+     * @return true If the element was in the queue
+     */
+    bool Remove(T* element) {
+        uint8_t bucket = getBucket(element->priority);
+
+        Node* previous = nullptr;
+        Node* node = heads[bucket];
+        while (node != nullptr && node != element) {
+            previous = node;
+            node = node->queueNext;
+        }
+
+        if (node == nullptr)
+            return false;
+
+        unlink(bucket, previous, node);
+        return true;
+    }
+
+    /**
+     * @brief Remove the element added first, of any priority. The heads of the buckets are the oldest of every priority
+     *
+     * @return T* Element or nullptr if empty
+     */
+    T* RemoveOldest() {
+        uint8_t oldestBucket = NUM_BUCKETS;
+        uint64_t mask = nonEmptyBuckets;
+
+        while (mask != 0) {
+            uint8_t bucket = __builtin_ctzll(mask);
+            mask &= mask - 1;
+
+            if (oldestBucket == NUM_BUCKETS || (int32_t) (heads[bucket]->queueOrder - heads[oldestBucket]->queueOrder) < 0)
+                oldestBucket = bucket;
+        }
+
+        if (oldestBucket == NUM_BUCKETS)
+            return nullptr;
+
+        return unlink(oldestBucket, nullptr, heads[oldestBucket]);
+    }
+
+    /**
+     * @brief Remove the oldest element of the lowest priority, only if its priority is lower than the given one
+     *
+     * @param priority Priority of the element that needs the room
+     * @return T* Element or nullptr if there is no element with a lower priority
+     */
+    T* RemoveLowerPriority(uint8_t priority) {
+        uint8_t bucket;
+        if (!lowestBucket(bucket) || bucket >= getBucket(priority))
+            return nullptr;
+
+        return unlink(bucket, nullptr, heads[bucket]);
+    }
+
+    /**
+     * @brief Remove all the elements that match a predicate, the elements are not deleted
+     *
+     * @tparam P Predicate called with every T*
+     * @tparam F Function called with every T* removed
+     * @param matches Predicate
+     * @param onRemoved Function
+     * @return size_t Number of elements removed
+     */
+    template <typename P, typename F>
+    size_t RemoveMatching(P matches, F onRemoved) {
+        size_t removed = 0;
+
+        for (uint8_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            Node* previous = nullptr;
+            Node* node = heads[bucket];
+
+            while (node != nullptr) {
+                Node* nextNode = node->queueNext;
+
+                if (matches(node)) {
+                    onRemoved(unlink(bucket, previous, node));
+                    removed++;
+                }
+                else
+                    previous = node;
+
+                node = nextNode;
+            }
+        }
+
+        return removed;
+    }
+
+    /**
+     * @brief Remove all the elements added with a flow key, also the ones sharing the first flow, the elements are not
+     * deleted. The function must not add elements to the queue
+     *
+     * @tparam F Function called with every T* removed
+     * @param flowKey Flow to be removed
+     * @param onRemoved Function
+     * @return size_t Number of elements removed
+     */
+    template <typename F>
+    size_t RemoveFlow(uint16_t flowKey, F onRemoved) {
+        size_t removed = 0;
+
+        for (uint8_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            Node* previous = nullptr;
+            Node* node = heads[bucket];
+
+            while (node != nullptr) {
+                Node* nextNode = node->queueNext;
+
+                if (node->queueKey == flowKey) {
+                    onRemoved(unlink(bucket, previous, node));
+                    removed++;
+                }
+                else
+                    previous = node;
+
+                node = nextNode;
+            }
+        }
+
+        return removed;
+    }
+
+    /**
+     * @brief Move the iterator to the first element of the highest priority
+     *
+     * @return true If the queue is not empty
+     */
+    bool moveToStart() {
+        if (!highestBucketBelow(NUM_BUCKETS, currBucket)) {
+            curr = nullptr;
+            return false;
+        }
+
+        curr = heads[currBucket];
+        return true;
+    }
+
+    /**
+     * @brief Move the iterator to the next element, by priority and insertion order
+     *
+     * @return true If there is a next element
+     */
+    bool next() {
+        if (curr == nullptr)
+            return false;
+
+        if (curr->queueNext != nullptr) {
+            curr = curr->queueNext;
+            return true;
+        }
+
+        uint8_t bucket;
+        if (!highestBucketBelow(currBucket, bucket))
+            return false;
+
+        currBucket = bucket;
+        curr = heads[bucket];
+        return true;
+    }
+
+    T* getCurrent() {
+        return curr;
+    }
+
+    /**
+     * @brief Get the flow key of the current element
+     *
+     */
+    uint16_t getCurrentFlow() {
+        return curr ? flows[curr->queueFlow].key : 0;
+    }
+
+    /**
+     * @brief Remove all the elements, they are not deleted
+     *
+     */
+    void Clear() {
+        for (uint8_t i = 0; i < NUM_BUCKETS; i++) {
+            Node* node = heads[i];
+            while (node != nullptr) {
+                Node* nextNode = node->queueNext;
+                node->queueNext = nullptr;
+                node = nextNode;
+            }
+
+            heads[i] = nullptr;
+            tails[i] = nullptr;
+        }
+
+        for (uint8_t i = 0; i < LM_SEND_FLOWS; i++)
+            flows[i] = Flow{0, 0, 0, true};
+
+        nonEmptyBuckets = 0;
+        length = 0;
+        curr = nullptr;
+    }
+
+    void setInUse() {
+        while (xSemaphoreTake(xSemaphore, (TickType_t) 10) != pdTRUE) {
+            ESP_LOGW(LM_TAG, "Priority Queue in Use Alert");
+        }
+    }
+
+    void releaseInUse() {
+        xSemaphoreGive(xSemaphore);
+    }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+#include <math.h>
+
+/**
+ * @brief Weighted rendezvous (highest random weight) hashing.
+ * Every (key, node) pair has a pseudo random score scaled by the weight of the node, the key is assigned to the node
+ * with the highest score. Each node gets a share of the keys proportional to its weight, and when a weight changes or
+ * a node is added or removed only the keys of that share move.
+ *
+ * It has no state, it can be used from any task.
+ */
+class LM_Rendezvous {
+public:
+    /**
+     * @brief Score of a key in a node
+     *
+     * @param key Key, for example the source address of a flow
+     * @param node Address of the node
+     * @param weight Weight of the node, greater than 0
+     * @return float Score, the highest wins
+     */
+    static float score(uint16_t key, uint16_t node, float weight) {
+        // Uniform in (0, 1) with 24 bits, the precision of a float
+        float uniform = ((hash(key, node) >> 8) + 0.5f) / 16777216.0f;
+        return weight / -logf(uniform);
+    }
+
+    /**
+     * @brief 32 bits hash of (key, node), the finalizer of MurmurHash3
+     *
+     */
+    static uint32_t hash(uint16_t key, uint16_t node) {
+        uint32_t h = ((uint32_t) key << 16) | node;
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        return h;
+    }
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+class LM_TimerWheel;
+
+/**
+ * @brief Timer registered in a LM_TimerWheel. It is embedded in the object that expires, the context points to it.
+ * It is cancelled when deleted, so the object can be deleted without cancelling it before.
+ *
+ */
+class LM_Timer {
+public:
+    /**
+     * @brief Object that expires
+     *
+     */
+    void* context = nullptr;
+
+    LM_Timer(void* context_ = nullptr) : context(context_) {};
+
+    ~LM_Timer();
+
+    LM_Timer(const LM_Timer&) = delete;
+    LM_Timer& operator=(const LM_Timer&) = delete;
+
+    /**
+     * @brief Cancel the timer if it is armed
+     *
+     */
+    void cancel();
+
+    bool isArmed() const { return wheel != nullptr; }
+
+    uint32_t getDeadline() const { return deadline; }
+
+private:
+    friend class LM_TimerWheel;
+
+    LM_TimerWheel* wheel = nullptr;
+    LM_Timer* prev = nullptr;
+    LM_Timer* next = nullptr;
+    uint32_t deadline = 0;
+    uint32_t tick = 0;
+};
+
+/**
+ * @brief Hashed timer wheel of LM_TIMER_WHEEL_SLOTS slots of LM_TIMER_RESOLUTION_MS each.
+ * A timer is stored in the slot of its deadline, the timers further than one revolution wait their round in the slot.
+ * Arm and cancel are O(1). A bitmap of the non empty slots gives the next deadline without walking the empty slots.
+ *
+ * The owner of the timers calls expire with the lock of its objects taken, then it waits getTimeUntilNext ms.
+ * If a timer is armed before the deadline the owner is waiting for, the notify task is notified.
+ *
+ * It is thread safe, it uses its own critical section.
+ */
+class LM_TimerWheel {
+    static_assert(LM_TIMER_WHEEL_SLOTS == 64, "The slots bitmap is 64 bits");
+
+public:
+    /**
+     * @brief Set the task notified when a timer is armed before the next deadline
+     *
+     * @param task Task handle
+     * @param bits Bits set in the notification value of the task, 0 to increment it like xTaskNotifyGive
+     */
+    void setNotifyTask(TaskHandle_t task, uint32_t bits = 0) {
+        notifyTask = task;
+        notifyBits = bits;
+    }
+
+    /**
+     * @brief Arm the timer, if it was armed it is re armed with the new deadline
+     *
+     * @param timer Timer
+     * @param deadline Deadline in ms, in the millis() time base
+     */
+    void arm(LM_Timer* timer, uint32_t deadline) {
+        if (timer->wheel != this)
+            timer->cancel();
+
+        bool notify = false;
+
+        portENTER_CRITICAL(&wheelMux);
+
+        if (timer->wheel == this)
+            unlink(timer);
+
+        uint32_t tick = deadline / LM_TIMER_RESOLUTION_MS;
+        // A deadline in the past goes to the current slot, the next expire fires it
+        if ((int32_t) (tick - currentTick) < 0)
+            tick = currentTick;
+
+        uint8_t slot = tick % LM_TIMER_WHEEL_SLOTS;
+
+        timer->wheel = this;
+        timer->deadline = deadline;
+        timer->tick = tick;
+        timer->prev = nullptr;
+        timer->next = slots[slot];
+        if (slots[slot] != nullptr)
+            slots[slot]->prev = timer;
+        slots[slot] = timer;
+        nonEmptySlots |= ((uint64_t) 1) << slot;
+
+        if (waiting && (int32_t) (deadline - wakeTime) < 0) {
+            waiting = false;
+            notify = notifyTask != nullptr;
+        }
+
+        portEXIT_CRITICAL(&wheelMux);
+
+        if (notify && notifyBits != 0)
+            xTaskNotify(notifyTask, notifyBits, eSetBits);
+        else if (notify)
+            xTaskNotifyGive(notifyTask);
+    }
+
+    /**
+     * @brief Cancel the timer if it is armed in this wheel
+     *
+     * @param timer Timer
+     */
+    void cancel(LM_Timer* timer) {
+        portENTER_CRITICAL(&wheelMux);
+        if (timer->wheel == this)
+            unlink(timer);
+        portEXIT_CRITICAL(&wheelMux);
+    }
+
+    /**
+     * @brief Call the function for every timer with the deadline reached, they are disarmed before.
+     * The function can arm and cancel timers
+     *
+     * @tparam F Function called with the LM_Timer*
+     * @param now Current time, millis()
+     * @param onExpired Function
+     */
+    template <typename F>
+    void expire(uint32_t now, F onExpired) {
+        uint32_t nowTick = now / LM_TIMER_RESOLUTION_MS;
+
+        for (;;) {
+            portENTER_CRITICAL(&wheelMux);
+            LM_Timer* expired = popExpired(now, nowTick);
+            portEXIT_CRITICAL(&wheelMux);
+
+            if (expired == nullptr)
+                break;
+
+            onExpired(expired);
+        }
+    }
+
+    /**
+     * @brief Time until the next deadline. The task waiting it is notified if an earlier timer is armed meanwhile
+     *
+     * @param now Current time, millis()
+     * @return uint32_t Time in ms, UINT32_MAX if there are no timers
+     */
+    uint32_t getTimeUntilNext(uint32_t now) {
+        portENTER_CRITICAL(&wheelMux);
+
+        uint32_t timeUntilNext = UINT32_MAX;
+        if (nonEmptySlots != 0) {
+            wakeTime = getNextDeadline();
+            timeUntilNext = (int32_t) (wakeTime - now) > 0 ? wakeTime - now : 0;
+        }
+        else
+            // Any timer armed is earlier
+            wakeTime = now + INT32_MAX;
+
+        waiting = true;
+
+        portEXIT_CRITICAL(&wheelMux);
+
+        return timeUntilNext;
+    }
+
+private:
+    LM_Timer* slots[LM_TIMER_WHEEL_SLOTS] = {};
+    uint64_t nonEmptySlots = 0;
+    uint32_t currentTick = 0;
+    uint32_t wakeTime = 0;
+    bool waiting = false;
+    TaskHandle_t notifyTask = nullptr;
+    uint32_t notifyBits = 0;
+    portMUX_TYPE wheelMux = portMUX_INITIALIZER_UNLOCKED;
+
+    void unlink(LM_Timer* timer) {
+        uint8_t slot = timer->tick % LM_TIMER_WHEEL_SLOTS;
+
+        if (timer->prev != nullptr)
+            timer->prev->next = timer->next;
+        else
+            slots[slot] = timer->next;
+
+        if (timer->next != nullptr)
+            timer->next->prev = timer->prev;
+
+        if (slots[slot] == nullptr)
+            nonEmptySlots &= ~(((uint64_t) 1) << slot);
+
+        timer->wheel = nullptr;
+        timer->prev = nullptr;
+        timer->next = nullptr;
+    }
+
+    /**
+     * @brief Unlink and return one expired timer of the slots from the current tick to now
+     *
+     */
+    LM_Timer* popExpired(uint32_t now, uint32_t nowTick) {
+        uint32_t elapsed = nowTick - currentTick;
+        if ((int32_t) elapsed < 0)
+            return nullptr;
+
+        uint32_t slotsToCheck = elapsed >= LM_TIMER_WHEEL_SLOTS ? LM_TIMER_WHEEL_SLOTS : elapsed + 1;
+
+        for (uint32_t i = 0; i < slotsToCheck; i++) {
+            uint8_t slot = (currentTick + i) % LM_TIMER_WHEEL_SLOTS;
+            if ((nonEmptySlots & (((uint64_t) 1) << slot)) == 0)
+                continue;
+
+            for (LM_Timer* timer = slots[slot]; timer != nullptr; timer = timer->next) {
+                if ((int32_t) (timer->deadline - now) <= 0) {
+                    unlink(timer);
+                    return timer;
+                }
+            }
+        }
+
+        // All the timers until now have expired, the timers left are in a later tick
+        currentTick = nowTick;
+        return nullptr;
+    }
+
+    /**
+     * @brief Earliest deadline of the first slot with timers in this revolution.
+     * If all the timers are in a later revolution, the end of this revolution
+     *
+     */
+    uint32_t getNextDeadline() {
+        uint8_t currentSlot = currentTick % LM_TIMER_WHEEL_SLOTS;
+        uint64_t mask = nonEmptySlots;
+
+        while (mask != 0) {
+            // Next non empty slot, starting from the current slot
+            uint64_t rotated = currentSlot == 0 ? mask : (mask >> currentSlot) | (mask << (LM_TIMER_WHEEL_SLOTS - currentSlot));
+            uint8_t distance = __builtin_ctzll(rotated);
+            uint8_t slot = (currentSlot + distance) % LM_TIMER_WHEEL_SLOTS;
+
+            bool found = false;
+            uint32_t next = 0;
+            for (LM_Timer* timer = slots[slot]; timer != nullptr; timer = timer->next) {
+                if (timer->tick - currentTick == distance && (!found || (int32_t) (timer->deadline - next) < 0)) {
+                    next = timer->deadline;
+                    found = true;
+                }
+            }
+
+            if (found)
+                return next;
+
+            mask &= ~(((uint64_t) 1) << slot);
+        }
+
+        return (currentTick + LM_TIMER_WHEEL_SLOTS) * LM_TIMER_RESOLUTION_MS;
+    }
+};
+
+inline LM_Timer::~LM_Timer() {
+    cancel();
+}
+
+inline void LM_Timer::cancel() {
+    // The wheel checks that the timer is still armed in it inside its critical section
+    LM_TimerWheel* armedWheel = wheel;
+    if (armedWheel != nullptr)
+        armedWheel->cancel(this);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "BuildOptions.h"
+
+/**
+ * @brief Trickle timer (RFC 6206) of the HELLO packets.
+ * Every interval, of Imin to Imax ms, has a transmission point at a random time of its second half. At that point the
+ * HELLO is sent unless k consistent HELLOs have been heard in the interval. When the interval ends it is doubled up to Imax.
+ * An inconsistency starts again from Imin.
+ *
+ * The HELLOs also keep the routes alive, so a transmission is never suppressed twice in a row.
+ *
+ * It does not lock, the owner calls it inside its critical section.
+ */
+class LM_Trickle {
+public:
+    /**
+     * @brief Configure and start the timer, with an Imin interval unless firstIntervalMs is given
+     *
+     * @param intervalMinMs Imin in ms
+     * @param intervalMaxMs Imax in ms
+     * @param redundancy k, consistent HELLOs that suppress the transmission. 0 never suppresses
+     * @param now Current time, millis()
+     * @param firstIntervalMs Interval to start with, within Imin and Imax, like the one before a reboot. 0 starts with Imin
+     */
+    void start(uint32_t intervalMinMs, uint32_t intervalMaxMs, uint8_t redundancy, uint32_t now, uint32_t firstIntervalMs = 0) {
+        intervalMin = intervalMinMs > 0 ? intervalMinMs : 1;
+        intervalMax = intervalMaxMs > intervalMin ? intervalMaxMs : intervalMin;
+        k = redundancy;
+        suppressedLast = false;
+
+        uint32_t first = firstIntervalMs < intervalMin ? intervalMin : firstIntervalMs > intervalMax ? intervalMax : firstIntervalMs;
+        beginInterval(first, now);
+    }
+
+    /**
+     * @brief A HELLO that did not change the routing table has been heard
+     *
+     */
+    void heardConsistent() {
+        if (counter < UINT8_MAX)
+            counter++;
+    }
+
+    /**
+     * @brief The routing table has changed, the next interval is Imin
+     *
+     * @param now Current time, millis()
+     * @return true If the interval has been reset and the next transmission point is earlier
+     */
+    bool heardInconsistent(uint32_t now) {
+        if (interval == intervalMin)
+            return false;
+
+        beginInterval(intervalMin, now);
+        return true;
+    }
+
+    /**
+     * @brief Process the transmission point and the end of the interval if they have been reached
+     *
+     * @param now Current time, millis()
+     * @param timeUntilNext Time in ms until the next event
+     * @return true If the HELLO has to be sent now
+     */
+    bool poll(uint32_t now, uint32_t& timeUntilNext) {
+        bool transmit = false;
+
+        if (!transmissionDone && (int32_t) (now - transmissionTime) >= 0) {
+            transmissionDone = true;
+
+            if (k != 0 && counter >= k && !suppressedLast) {
+                suppressedLast = true;
+                suppressedNum++;
+            }
+            else {
+                suppressedLast = false;
+                transmit = true;
+            }
+        }
+
+        if (transmissionDone && (int32_t) (now - (intervalStart + interval)) >= 0)
+            beginInterval(interval >= intervalMax / 2 ? intervalMax : interval * 2, now);
+
+        uint32_t next = transmissionDone ? intervalStart + interval : transmissionTime;
+        timeUntilNext = (int32_t) (next - now) > 0 ? next - now : 0;
+
+        return transmit;
+    }
+
+    /**
+     * @brief Place the transmission point in a slot of the second half of the interval instead of at a random time.
+     * It is used from the next interval
+     *
+     * @param slotIndex Slot of the node, below slotsNum
+     * @param slotsNum Slots of the second half, 0 uses a random time
+     */
+    void setSlot(uint8_t slotIndex, uint8_t slotsNum) {
+        slot = slotIndex;
+        slots = slotsNum;
+    }
+
+    uint32_t getInterval() const { return interval; }
+
+    uint32_t getSuppressedNum() const { return suppressedNum; }
+
+private:
+    uint32_t intervalMin = 1;
+    uint32_t intervalMax = 1;
+    uint8_t k = 0;
+
+    uint32_t interval = 1;
+    uint32_t intervalStart = 0;
+    uint32_t transmissionTime = 0;
+    bool transmissionDone = false;
+    bool suppressedLast = false;
+    uint8_t counter = 0;
+    uint32_t suppressedNum = 0;
+    uint8_t slot = 0;
+    uint8_t slots = 0;
+
+    void beginInterval(uint32_t newInterval, uint32_t now) {
+        interval = newInterval;
+        intervalStart = now;
+        counter = 0;
+        transmissionDone = false;
+
+        uint32_t half = interval / 2;
+        if (slots == 0) {
+            transmissionTime = now + half + random(0, interval - half);
+            return;
+        }
+
+        uint32_t slotLength = (interval - half) / slots;
+        transmissionTime = now + half + slot * slotLength + random(0, slotLength * LM_HELLO_SLOT_JITTER / 100 + 1);
+    }
+};
@@ -0,0 +1,58 @@
+"""Read the pcap stream of a LoraMesher sniffer, see examples/Sniffer, from a serial port and write it to a file or to
+stdout, so it can be piped to Wireshark:
+
+    python3 utilities/snifferToPcap.py /dev/ttyUSB0 | wireshark -k -i -
+    python3 utilities/snifferToPcap.py COM5 -o capture.pcap
+
+The boot messages before the stream are skipped. The sniffer starts a new stream when it receives a byte, so the
+global header is requested again when the port is opened.
+"""
+import argparse
+import sys
+
+import serial
+
+PCAP_GLOBAL_HEADER = bytes.fromhex("d4c3b2a1" "0200" "0400")
+PCAP_GLOBAL_HEADER_LENGTH = 24
+
+
+def wait_for_header(port):
+    window = b""
+    while True:
+        data = port.read(1)
+        if not data:
+            continue
+
+        window = (window + data)[-len(PCAP_GLOBAL_HEADER):]
+        if window == PCAP_GLOBAL_HEADER:
+            return window + port.read(PCAP_GLOBAL_HEADER_LENGTH - len(PCAP_GLOBAL_HEADER))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stream the pcap capture of a LoraMesher sniffer")
+    parser.add_argument("port", help="Serial port of the sniffer")
+    parser.add_argument("-b", "--baudrate", type=int, default=921600, help="Baud rate (921600)")
+    parser.add_argument("-o", "--output", help="pcap file, stdout by default")
+    args = parser.parse_args()
+
+    output = open(args.output, "wb") if args.output else sys.stdout.buffer
+
+    with serial.Serial(args.port, args.baudrate, timeout=1) as port:
+        port.reset_input_buffer()
+        port.write(b"\n")
+
+        output.write(wait_for_header(port))
+        output.flush()
+
+        try:
+            while True:
+                data = port.read(port.in_waiting or 1)
+                if data:
+                    output.write(data)
+                    output.flush()
+        except (KeyboardInterrupt, BrokenPipeError):
+            pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,235 @@
+-- Wireshark dissector of the LoraMesher frames captured by a sniffer, see CaptureService and examples/Sniffer.
+-- Copy it to the personal plugins folder of Wireshark (Help > About > Folders) and open a capture of LINKTYPE_USER0 (147).
+-- The frames are dissected as sent without LM_COMPACT_HEADER.
+
+local radio = Proto("lmradio", "LoraMesher radio header")
+local mesh = Proto("loramesher", "LoraMesher")
+
+local packetTypes = {
+    [0x01] = "AGGREGATE_P",
+    [0x02] = "DATA_P",
+    [0x03] = "NEED_ACK_P",
+    [0x04] = "HELLO_P",
+    [0x0A] = "ACK_P",
+    [0x12] = "XL_DATA_P",
+    [0x22] = "LOST_P",
+    [0x42] = "SYNC_P",
+    [0x80] = "ROUTE_REQUEST_P",
+    [0x88] = "ROUTE_REPLY_P",
+    [0x82] = "TRACED_DATA_P",
+}
+
+local radioFields = {
+    version = ProtoField.uint8("lmradio.version", "Version"),
+    flags = ProtoField.uint8("lmradio.flags", "Flags", base.HEX),
+    crcError = ProtoField.bool("lmradio.flags.crc_error", "CRC error", 8, nil, 0x01),
+    secondary = ProtoField.bool("lmradio.flags.secondary", "Secondary receiver", 8, nil, 0x02),
+    rssi = ProtoField.int8("lmradio.rssi", "RSSI (dBm)"),
+    snr = ProtoField.int8("lmradio.snr", "SNR (dB)"),
+    frequency = ProtoField.uint32("lmradio.frequency", "Frequency (kHz)"),
+    bandwidth = ProtoField.uint16("lmradio.bandwidth", "Bandwidth (100 Hz)"),
+    sf = ProtoField.uint8("lmradio.sf", "Spreading factor"),
+    cr = ProtoField.uint8("lmradio.cr", "Coding rate 4/"),
+}
+radio.fields = radioFields
+
+local fields = {
+    dst = ProtoField.uint16("loramesher.dst", "Destination", base.HEX),
+    src = ProtoField.uint16("loramesher.src", "Source", base.HEX),
+    type = ProtoField.uint8("loramesher.type", "Type", base.HEX, packetTypes),
+    id = ProtoField.uint8("loramesher.id", "Id"),
+    size = ProtoField.uint8("loramesher.size", "Packet size"),
+    via = ProtoField.uint16("loramesher.via", "Via", base.HEX),
+    seqId = ProtoField.uint16("loramesher.seq_id", "Sequence id"),
+    number = ProtoField.uint16("loramesher.number", "Number"),
+    nodeRole = ProtoField.uint8("loramesher.hello.role", "Role", base.HEX),
+    gatewayLoad = ProtoField.uint8("loramesher.hello.gateway_load", "Gateway load"),
+    routeFlags = ProtoField.uint8("loramesher.hello.flags", "Route flags", base.HEX),
+    tableVersion = ProtoField.uint8("loramesher.hello.version", "Table version"),
+    capabilities = ProtoField.uint8("loramesher.hello.capabilities", "Capabilities", base.HEX),
+    nodeAddress = ProtoField.uint16("loramesher.hello.node.address", "Address", base.HEX),
+    nodeMetric = ProtoField.uint8("loramesher.hello.node.metric", "Metric"),
+    nodeRoleBits = ProtoField.uint8("loramesher.hello.node.role", "Role", base.HEX),
+    nodeGatewayLoad = ProtoField.uint8("loramesher.hello.node.gateway_load", "Gateway load"),
+    compactNodes = ProtoField.bytes("loramesher.hello.compact", "Compact nodes"),
+    trailers = ProtoField.bytes("loramesher.hello.trailers", "Trailers"),
+    sniffPreamble = ProtoField.uint16("loramesher.hello.sniff_preamble", "Sniff preamble"),
+    origin = ProtoField.uint16("loramesher.discovery.origin", "Origin", base.HEX),
+    target = ProtoField.uint16("loramesher.discovery.target", "Target", base.HEX),
+    requestId = ProtoField.uint8("loramesher.discovery.request_id", "Request id"),
+    hops = ProtoField.uint8("loramesher.discovery.hops", "Hops"),
+    traceCount = ProtoField.uint8("loramesher.trace.count", "Hop records", base.DEC, nil, 0x7F),
+    traceTruncated = ProtoField.bool("loramesher.trace.truncated", "Hops without record", 8, nil, 0x80),
+    hopAddress = ProtoField.uint16("loramesher.trace.hop.address", "Address", base.HEX),
+    hopQueueWait = ProtoField.uint16("loramesher.trace.hop.queue_wait", "Queue wait (ms)"),
+    hopDutyCycleWait = ProtoField.uint16("loramesher.trace.hop.duty_cycle_wait", "Duty cycle wait (ms)"),
+    hopBackoff = ProtoField.uint16("loramesher.trace.hop.backoff", "Backoff (ms)"),
+    hopTimeOnAir = ProtoField.uint16("loramesher.trace.hop.time_on_air", "Time on air (ms)"),
+    partLength = ProtoField.uint8("loramesher.aggregate.length", "Length"),
+    payload = ProtoField.bytes("loramesher.payload", "Payload"),
+}
+mesh.fields = fields
+
+-- Length of the trailers of a HELLO, see RoutePacket::getTrailerLength
+local function trailerLength(flags, capabilities)
+    local length = 0
+    if bit.band(capabilities, 0x01) ~= 0 then length = length + 2 end
+    if bit.band(capabilities, 0x02) ~= 0 then length = length + 12 end
+    if bit.band(flags, 0x10) ~= 0 then length = length + 12 end
+    if bit.band(flags, 0x20) ~= 0 then length = length + 3 end
+    if bit.band(flags, 0x40) ~= 0 then length = length + 20 end
+    if bit.band(flags, 0x08) ~= 0 then length = length + 10 end
+    return length
+end
+
+local function isControl(packetType)
+    return packetType ~= 0x01 and packetType ~= 0x02 and packetType ~= 0x82 and bit.band(packetType, 0x04) == 0 and packetType ~= 0x80 and
+        packetType ~= 0x88 and not (packetType < 0x80 and bit.band(packetType, 0x07) == 0)
+end
+
+local function dissectPacket(tvb, pinfo, tree)
+    if tvb:len() < 7 then
+        return
+    end
+
+    local packetType = tvb(4, 1):uint()
+    local name = packetTypes[packetType] or string.format("Custom 0x%02X", packetType)
+    local subtree = tree:add(mesh, tvb(), "LoraMesher " .. name)
+    subtree:add_le(fields.dst, tvb(0, 2))
+    subtree:add_le(fields.src, tvb(2, 2))
+    subtree:add(fields.type, tvb(4, 1))
+    subtree:add(fields.id, tvb(5, 1))
+    subtree:add(fields.size, tvb(6, 1))
+
+    pinfo.cols.src = string.format("%04X", tvb(2, 2):le_uint())
+    pinfo.cols.dst = string.format("%04X", tvb(0, 2):le_uint())
+    pinfo.cols.info:append(name .. " ")
+
+    local offset = 7
+    if packetType == 0x04 then
+        if tvb:len() < 12 then return end
+        subtree:add(fields.nodeRole, tvb(7, 1))
+        subtree:add(fields.gatewayLoad, tvb(8, 1))
+        subtree:add(fields.routeFlags, tvb(9, 1))
+        subtree:add(fields.tableVersion, tvb(10, 1))
+        subtree:add(fields.capabilities, tvb(11, 1))
+
+        local flags = tvb(9, 1):uint()
+        local nodesEnd = tvb:len() - trailerLength(flags, tvb(11, 1):uint())
+        offset = 12
+        if bit.band(flags, 0x04) ~= 0 then
+            if nodesEnd > offset then subtree:add(fields.compactNodes, tvb(offset, nodesEnd - offset)) end
+        else
+            while offset + 5 <= nodesEnd do
+                local node = subtree:add(mesh, tvb(offset, 5), string.format("Route to %04X, metric %d",
+                    tvb(offset, 2):le_uint(), tvb(offset + 2, 1):uint()))
+                node:add_le(fields.nodeAddress, tvb(offset, 2))
+                node:add(fields.nodeMetric, tvb(offset + 2, 1))
+                node:add(fields.nodeRoleBits, tvb(offset + 3, 1))
+                node:add(fields.nodeGatewayLoad, tvb(offset + 4, 1))
+                offset = offset + 5
+            end
+        end
+        if bit.band(tvb(11, 1):uint(), 0x01) ~= 0 and nodesEnd >= 12 and nodesEnd + 2 <= tvb:len() then
+            subtree:add_le(fields.sniffPreamble, tvb(nodesEnd, 2))
+        end
+        if nodesEnd < tvb:len() and nodesEnd >= 12 then subtree:add(fields.trailers, tvb(nodesEnd)) end
+        return
+    end
+
+    if packetType == 0x01 then
+        while offset < tvb:len() do
+            local length = tvb(offset, 1):uint()
+            if length == 0 or offset + 1 + length > tvb:len() then break end
+            subtree:add(fields.partLength, tvb(offset, 1))
+            dissectPacket(tvb(offset + 1, length):tvb(), pinfo, subtree)
+            offset = offset + 1 + length
+        end
+        return
+    end
+
+    if packetType == 0x80 or packetType == 0x88 then
+        if tvb:len() < 13 then return end
+        subtree:add_le(fields.origin, tvb(7, 2))
+        subtree:add_le(fields.target, tvb(9, 2))
+        subtree:add(fields.requestId, tvb(11, 1))
+        subtree:add(fields.hops, tvb(12, 1))
+        return
+    end
+
+    if bit.band(packetType, 0x02) ~= 0 then
+        if tvb:len() < 9 then return end
+        subtree:add_le(fields.via, tvb(7, 2))
+        offset = 9
+        if isControl(packetType) then
+            if tvb:len() < 13 then return end
+            subtree:add_le(fields.seqId, tvb(9, 2))
+            subtree:add_le(fields.number, tvb(11, 2))
+            offset = 13
+        end
+    end
+
+    -- The trace ends the payload, see HopTraceService
+    local payloadEnd = tvb:len()
+    if packetType == 0x82 and payloadEnd > offset then
+        local count = bit.band(tvb(payloadEnd - 1, 1):uint(), 0x7F)
+        local traceStart = payloadEnd - 1 - count * 10
+        if traceStart >= offset then
+            local trace = subtree:add(mesh, tvb(traceStart), string.format("Trace of %d hops", count))
+            for i = 0, count - 1 do
+                local record = traceStart + i * 10
+                local hop = trace:add(mesh, tvb(record, 10), string.format("Hop %04X", tvb(record, 2):le_uint()))
+                hop:add_le(fields.hopAddress, tvb(record, 2))
+                hop:add_le(fields.hopQueueWait, tvb(record + 2, 2))
+                hop:add_le(fields.hopDutyCycleWait, tvb(record + 4, 2))
+                hop:add_le(fields.hopBackoff, tvb(record + 6, 2))
+                hop:add_le(fields.hopTimeOnAir, tvb(record + 8, 2))
+            end
+            trace:add(fields.traceCount, tvb(payloadEnd - 1, 1))
+            trace:add(fields.traceTruncated, tvb(payloadEnd - 1, 1))
+            payloadEnd = traceStart
+        end
+    end
+
+    if offset < payloadEnd then
+        subtree:add(fields.payload, tvb(offset, payloadEnd - offset))
+    end
+end
+
+function mesh.dissector(tvb, pinfo, tree)
+    pinfo.cols.protocol = "LoraMesher"
+    dissectPacket(tvb, pinfo, tree)
+end
+
+function radio.dissector(tvb, pinfo, tree)
+    if tvb:len() < 12 then
+        return
+    end
+
+    local subtree = tree:add(radio, tvb(0, 12))
+    subtree:add(radioFields.version, tvb(0, 1))
+    local flags = subtree:add(radioFields.flags, tvb(1, 1))
+    flags:add(radioFields.crcError, tvb(1, 1))
+    flags:add(radioFields.secondary, tvb(1, 1))
+    subtree:add(radioFields.rssi, tvb(2, 1))
+    subtree:add(radioFields.snr, tvb(3, 1))
+    subtree:add_le(radioFields.frequency, tvb(4, 4))
+    subtree:add_le(radioFields.bandwidth, tvb(8, 2))
+    subtree:add(radioFields.sf, tvb(10, 1))
+    subtree:add(radioFields.cr, tvb(11, 1))
+
+    pinfo.cols.protocol = "LoraMesher"
+    pinfo.cols.info = string.format("SF%d %.3f MHz RSSI %d ", tvb(10, 1):uint(), tvb(4, 4):le_uint() / 1000, tvb(2, 1):int())
+
+    if bit.band(tvb(1, 1):uint(), 0x01) ~= 0 then
+        pinfo.cols.info:append("[CRC error] ")
+        subtree:add(fields.payload, tvb(12))
+        return
+    end
+
+    if tvb:len() > 12 then
+        mesh.dissector(tvb(12):tvb(), pinfo, tree)
+    end
+end
+
+DissectorTable.get("wtap_encap"):add(wtap.USER0, radio)